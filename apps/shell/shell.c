@@ -7,9 +7,13 @@
 #include "shell.h"
 #include "../../kernel/include/vga.h"
 #include "../../kernel/include/serial.h"
+#include "../../kernel/include/trace.h"
 #include "../../kernel/include/types.h"
 #include "../../kernel/arch/x86_64/io.h"
 #include "../../kernel/mm/pmm.h"
+#include "../../drivers/storage/blkdev.h"
+#include "../../drivers/storage/ramdisk.h"
+#include "../../drivers/storage/bio.h"
 #include "../../drivers/input/keyboard.h"
 
 /* ========== Forward Declarations ========== */
@@ -111,6 +115,9 @@ static const shell_command_t builtin_commands[] = {
     {"version",  "Show OS version",                      NULL,           cmd_version},
     {"date",     "Show current date/time",               NULL,           cmd_date},
     {"cpuinfo",  "Show CPU information",                 NULL,           cmd_cpuinfo},
+    {"trace",    "Control tracepoints",                  "[on|off <subsys>|dump [n]|clear]", cmd_trace},
+    {"iostat",   "Show block device I/O statistics",     "[device] [reset]", cmd_iostat},
+    {"ramdisk",  "Create, list and remove RAM disks",    "[create <MB>|destroy <name>]", cmd_ramdisk},
     {NULL, NULL, NULL, NULL}  /* Sentinel */
 };
 
@@ -561,6 +568,155 @@ int cmd_cpuinfo(int argc, char *argv[]) {
     return 0;
 }
 
+int cmd_trace(int argc, char *argv[]) {
+    if (argc < 2) {
+        vga_puts("Subsystem  State\n");
+        vga_puts("---------  -----\n");
+        for (int i = 0; i < TRACE_SUBSYS_COUNT; i++) {
+            vga_printf("%-10s %s\n", trace_subsys_name((trace_subsys_t)i),
+                       (trace_mask & (1U << i)) ? "on" : "off");
+        }
+        return 0;
+    }
+
+    if (shell_strcmp(argv[1], "on") == 0 || shell_strcmp(argv[1], "off") == 0) {
+        bool on = shell_strcmp(argv[1], "on") == 0;
+
+        if (argc < 3) {
+            vga_puts("Usage: trace on|off <subsys>|all\n");
+            return 1;
+        }
+
+        if (shell_strcmp(argv[2], "all") == 0) {
+            for (int i = 0; i < TRACE_SUBSYS_COUNT; i++) {
+                trace_enable((trace_subsys_t)i, on);
+            }
+            return 0;
+        }
+
+        int sys = trace_subsys_find(argv[2]);
+        if (sys < 0) {
+            vga_printf("Unknown subsystem: %s\n", argv[2]);
+            return 1;
+        }
+        trace_enable((trace_subsys_t)sys, on);
+        return 0;
+    }
+
+    if (shell_strcmp(argv[1], "dump") == 0) {
+        uint32_t max = 0;
+
+        if (argc > 2) {
+            for (const char *p = argv[2]; *p; p++) {
+                if (*p < '0' || *p > '9') {
+                    vga_printf("Invalid count: %s\n", argv[2]);
+                    return 1;
+                }
+                max = max * 10 + (uint32_t)(*p - '0');
+            }
+        }
+
+        trace_dump(max);
+        vga_puts("Trace records written to the serial console\n");
+        return 0;
+    }
+
+    if (shell_strcmp(argv[1], "clear") == 0) {
+        trace_clear();
+        return 0;
+    }
+
+    vga_printf("Unknown trace command: %s\n", argv[1]);
+    return 1;
+}
+
+int cmd_iostat(int argc, char *argv[]) {
+    static char text[BLK_STATS_TEXT_MAX];
+    block_device_t *only = NULL;
+    bool reset = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (shell_strcmp(argv[i], "reset") == 0) {
+            reset = true;
+        } else if ((only = blkdev_find(argv[i])) == NULL) {
+            vga_printf("Unknown block device: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    int shown = 0;
+    for (int i = 0; i < BLKDEV_MAX_DEVICES; i++) {
+        block_device_t *dev = blkdev_get(i);
+        if (!dev || !dev->queue || (only && dev != only)) {
+            continue;
+        }
+
+        if (reset) {
+            blk_reset_stats(dev);
+            vga_printf("%s: statistics reset\n", dev->name);
+        } else {
+            blk_stats_show(dev, text, sizeof(text));
+            vga_puts(text);
+        }
+        shown++;
+    }
+
+    if (shown == 0) {
+        vga_puts("No block devices\n");
+    }
+    return 0;
+}
+
+int cmd_ramdisk(int argc, char *argv[]) {
+    if (argc < 2) {
+        int shown = 0;
+        for (int i = 0; i < BLKDEV_MAX_DEVICES; i++) {
+            block_device_t *dev = blkdev_get(i);
+            uint64_t used;
+            if (!dev || ramdisk_get_usage(dev, &used) != BLKDEV_SUCCESS) {
+                continue;
+            }
+            vga_printf("%-6s %llu MB, %llu KB in use\n", dev->name,
+                       dev->sector_count * BLKDEV_SECTOR_SIZE / MB, used / KB);
+            shown++;
+        }
+        if (shown == 0) {
+            vga_puts("No RAM disks\n");
+        }
+        return 0;
+    }
+
+    if (shell_strcmp(argv[1], "create") == 0 && argc > 2) {
+        uint64_t mb = 0;
+        for (const char *p = argv[2]; *p; p++) {
+            if (*p < '0' || *p > '9') {
+                vga_printf("Invalid size: %s\n", argv[2]);
+                return 1;
+            }
+            mb = mb * 10 + (uint64_t)(*p - '0');
+        }
+
+        block_device_t *dev = ramdisk_create(NULL, mb * MB / BLKDEV_SECTOR_SIZE);
+        if (!dev) {
+            vga_puts("Could not create RAM disk\n");
+            return 1;
+        }
+        vga_printf("Created %s (%llu MB)\n", dev->name, mb);
+        return 0;
+    }
+
+    if (shell_strcmp(argv[1], "destroy") == 0 && argc > 2) {
+        if (ramdisk_destroy(blkdev_find(argv[2])) != BLKDEV_SUCCESS) {
+            vga_printf("Not a RAM disk: %s\n", argv[2]);
+            return 1;
+        }
+        return 0;
+    }
+
+    vga_puts("Usage: ramdisk [create <MB>|destroy <name>]\n");
+    return 1;
+}
+
 /* ========== Shell Core Functions ========== */
 
 void shell_init(void) {
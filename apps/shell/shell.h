@@ -174,4 +174,19 @@ int cmd_date(int argc, char *argv[]);
  */
 int cmd_cpuinfo(int argc, char *argv[]);
 
+/**
+ * trace - Enable tracepoints per subsystem and dump the trace buffer
+ */
+int cmd_trace(int argc, char *argv[]);
+
+/**
+ * iostat - Show block device counters and latency histograms
+ */
+int cmd_iostat(int argc, char *argv[]);
+
+/**
+ * ramdisk - Create, list and remove RAM disks
+ */
+int cmd_ramdisk(int argc, char *argv[]);
+
 #endif /* _AAAOS_SHELL_H */
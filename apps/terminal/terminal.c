@@ -1228,11 +1228,17 @@ void terminal_draw(terminal_t *term)
         }
     }
 
-    /* Draw all lines */
+    /* Draw all lines, damaging only the rows that changed */
     for (y = 0; y < term->height; y++) {
         if (term->needs_redraw || term->buffer[y].dirty) {
             terminal_draw_line(term, (int)y);
             term->buffer[y].dirty = false;
+
+            if (term->window && !term->needs_redraw) {
+                compositor_invalidate(term->window->x,
+                                      term->window->y + (int)y * TERMINAL_CHAR_HEIGHT,
+                                      term->window->width, TERMINAL_CHAR_HEIGHT);
+            }
         }
     }
 
@@ -1241,14 +1247,16 @@ void terminal_draw(terminal_t *term)
         terminal_draw_cursor(term);
     }
 
-    term->needs_redraw = false;
-
     /* Update display */
     if (term->window) {
-        compositor_invalidate(term->window->x, term->window->y,
-                              term->window->width, term->window->height);
+        if (term->needs_redraw) {
+            compositor_invalidate(term->window->x, term->window->y,
+                                  term->window->width, term->window->height);
+        }
         compositor_render();
     }
+
+    term->needs_redraw = false;
 }
 
 void terminal_draw_line(terminal_t *term, int line)
@@ -62,6 +62,16 @@ typedef uint32_t gid_t;         /* Group ID type */
 typedef int64_t off_t;          /* File offset type */
 typedef uint32_t mode_t;        /* File mode type */
 
+/**
+ * I/O vector segment for readv()/writev() (layout matches vfs_iovec_t)
+ */
+struct iovec {
+    void    *iov_base;          /* Segment start */
+    size_t  iov_len;            /* Segment length in bytes */
+};
+
+#define IOV_MAX         1024    /* Maximum segments per vectored call */
+
 /* ============================================================================
  * Process Control Functions
  * ============================================================================ */
@@ -262,6 +272,70 @@ int close(int fd);
  */
 off_t lseek(int fd, off_t offset, int whence);
 
+/* ============================================================================
+ * Positional and Vectored I/O
+ * ============================================================================ */
+
+/**
+ * Read from a file descriptor at a given offset
+ * The file offset is not used or changed.
+ * @param fd File descriptor
+ * @param buf Buffer to read into
+ * @param count Number of bytes to read
+ * @param offset File offset to read from
+ * @return Number of bytes read, 0 on EOF, -1 on error (errno set)
+ */
+ssize_t pread(int fd, void *buf, size_t count, off_t offset);
+
+/**
+ * Write to a file descriptor at a given offset
+ * The file offset is not used or changed.
+ * @param fd File descriptor
+ * @param buf Buffer to write from
+ * @param count Number of bytes to write
+ * @param offset File offset to write at
+ * @return Number of bytes written, -1 on error (errno set)
+ */
+ssize_t pwrite(int fd, const void *buf, size_t count, off_t offset);
+
+/**
+ * Read from a file descriptor into several buffers
+ * @param fd File descriptor
+ * @param iov Buffers to fill, in order
+ * @param iovcnt Number of buffers (at most IOV_MAX)
+ * @return Number of bytes read, 0 on EOF, -1 on error (errno set)
+ */
+ssize_t readv(int fd, const struct iovec *iov, int iovcnt);
+
+/**
+ * Write several buffers to a file descriptor
+ * @param fd File descriptor
+ * @param iov Buffers to write, in order
+ * @param iovcnt Number of buffers (at most IOV_MAX)
+ * @return Number of bytes written, -1 on error (errno set)
+ */
+ssize_t writev(int fd, const struct iovec *iov, int iovcnt);
+
+/**
+ * Read from a file descriptor into several buffers at a given offset
+ * @param fd File descriptor
+ * @param iov Buffers to fill, in order
+ * @param iovcnt Number of buffers (at most IOV_MAX)
+ * @param offset File offset to read from
+ * @return Number of bytes read, 0 on EOF, -1 on error (errno set)
+ */
+ssize_t preadv(int fd, const struct iovec *iov, int iovcnt, off_t offset);
+
+/**
+ * Write several buffers to a file descriptor at a given offset
+ * @param fd File descriptor
+ * @param iov Buffers to write, in order
+ * @param iovcnt Number of buffers (at most IOV_MAX)
+ * @param offset File offset to write at
+ * @return Number of bytes written, -1 on error (errno set)
+ */
+ssize_t pwritev(int fd, const struct iovec *iov, int iovcnt, off_t offset);
+
 /* ============================================================================
  * File Descriptor Duplication
  * ============================================================================ */
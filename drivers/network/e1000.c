@@ -7,6 +7,7 @@
 #include "e1000.h"
 #include "../../kernel/arch/x86_64/io.h"
 #include "../../kernel/include/serial.h"
+#include "../../kernel/include/trace.h"
 #include "../../kernel/mm/pmm.h"
 #include "../../kernel/mm/vmm.h"
 
@@ -421,8 +422,11 @@ bool e1000_init(void) {
         return false;
     }
 
-    /* Register interrupt handler */
-    idt_register_handler(IRQ_BASE + e1000_dev.irq, e1000_handler);
+    /* Register interrupt handler; INTx lines may be shared with other devices */
+    if (idt_register_shared_handler(IRQ_BASE + e1000_dev.irq, e1000_handler) != 0) {
+        kprintf("[e1000] ERROR: Cannot register handler for IRQ %d\n", e1000_dev.irq);
+        return false;
+    }
     kprintf("[e1000] Registered interrupt handler for IRQ %d (vector %d)\n",
             e1000_dev.irq, IRQ_BASE + e1000_dev.irq);
 
@@ -527,6 +531,8 @@ ssize_t e1000_send_packet(const void *data, size_t len) {
                 E1000_TXD_CMD_RS;      /* Report status */
     desc->status = 0;  /* Clear status */
 
+    TRACE(TRACE_E1000, TRACE_E1000_TX, cur, len, 0, 0);
+
     /* Advance tail pointer to trigger transmission */
     e1000_dev.tx_cur = (cur + 1) % E1000_NUM_TX_DESC;
     e1000_write_reg(E1000_TDT, e1000_dev.tx_cur);
@@ -581,6 +587,8 @@ ssize_t e1000_receive_packet(void *buf, size_t max_len) {
     /* Copy packet data */
     memcpy(buf, e1000_dev.rx_buffers[cur], len);
 
+    TRACE(TRACE_E1000, TRACE_E1000_RX, cur, len, 0, 0);
+
     /* Update statistics */
     e1000_dev.packets_received++;
     e1000_dev.bytes_received += len;
@@ -625,6 +633,8 @@ void e1000_handler(interrupt_frame_t *frame) {
         return;
     }
 
+    TRACE(TRACE_E1000, TRACE_E1000_IRQ, icr, 0, 0, 0);
+
     /* Handle link status change */
     if (icr & E1000_ICR_LSC) {
         uint32_t status = e1000_read_reg(E1000_STATUS);
@@ -633,12 +643,7 @@ void e1000_handler(interrupt_frame_t *frame) {
                 e1000_dev.link_up ? "UP" : "DOWN");
     }
 
-    /* Handle receive interrupt */
-    if (icr & (E1000_ICR_RXT0 | E1000_ICR_RXDMT0)) {
-        /* Packets are available - they will be handled by polling or a receive thread */
-        /* For now, just log it */
-        kprintf("[e1000] Receive interrupt (ICR=0x%x)\n", icr);
-    }
+    /* Received packets (RXT0/RXDMT0) are picked up by polling */
 
     /* Handle receive overrun */
     if (icr & E1000_ICR_RXO) {
@@ -0,0 +1,508 @@
+/**
+ * AAAos Network Driver - Virtio Network Device
+ *
+ * Receive buffers are posted to the device ahead of time and reposted as
+ * soon as their contents are copied out; with mergeable RX buffers a
+ * packet larger than one buffer arrives spread over several. Transmitted
+ * frames are copied behind a packet header into a buffer of their own,
+ * which is reclaimed lazily on later sends. Neither direction uses
+ * interrupts: receive is polled like the e1000 driver and the interrupt
+ * only reports link changes.
+ */
+
+#include "virtio_net.h"
+#include "../../kernel/include/serial.h"
+#include "../../kernel/include/trace.h"
+#include "../../kernel/mm/pmm.h"
+#include "../../kernel/mm/vmm.h"
+
+#define VIRTIO_NET_RFLAGS_IF        (1ULL << 9)
+#define VIRTIO_NET_HDR_LEN          sizeof(virtio_net_hdr_t)
+
+/**
+ * Receive/transmit virtqueue pair
+ */
+typedef struct {
+    virtqueue_t     rx;
+    virtqueue_t     tx;
+    volatile int    rx_lock;
+    volatile int    tx_lock;
+
+    /* Transmit buffers not owned by the device */
+    uint8_t         *tx_free[VIRTIO_NET_QUEUE_SIZE];
+    uint32_t        tx_free_count;
+} virtio_net_pair_t;
+
+/**
+ * virtio-net device state
+ */
+typedef struct {
+    virtio_device_t     vdev;
+    virtio_net_pair_t   pairs[VIRTIO_NET_MAX_PAIRS];
+    uint16_t            num_pairs;
+
+    uint8_t             mac[6];
+    bool                mergeable;      /* VIRTIO_NET_F_MRG_RXBUF negotiated */
+
+    /* Statistics */
+    uint64_t            packets_sent;
+    uint64_t            packets_received;
+    uint64_t            bytes_sent;
+    uint64_t            bytes_received;
+    uint64_t            errors;
+
+    /* State flags */
+    bool                initialized;
+    bool                link_up;
+} virtio_net_device_t;
+
+/* Global device state */
+static virtio_net_device_t virtio_net_dev;
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================ */
+
+static void *memcpy(void *dest, const void *src, size_t n) {
+    uint8_t *d = (uint8_t *)dest;
+    const uint8_t *s = (const uint8_t *)src;
+    while (n--) {
+        *d++ = *s++;
+    }
+    return dest;
+}
+
+static void *memset(void *s, int c, size_t n) {
+    uint8_t *p = (uint8_t *)s;
+    while (n--) {
+        *p++ = (uint8_t)c;
+    }
+    return s;
+}
+
+static inline uint64_t virtio_net_lock(volatile int *lock) {
+    uint64_t flags;
+    __asm__ __volatile__("pushfq; pop %0; cli" : "=r"(flags) : : "memory");
+    while (__sync_lock_test_and_set(lock, 1)) {
+        __asm__ __volatile__("pause");
+    }
+    return flags;
+}
+
+static inline void virtio_net_unlock(volatile int *lock, uint64_t flags) {
+    __sync_lock_release(lock);
+    if (flags & VIRTIO_NET_RFLAGS_IF) {
+        __asm__ __volatile__("sti");
+    }
+}
+
+/**
+ * Allocate buffers, two per page, from the physical map
+ * @return Number of buffers allocated (may fall short on low memory)
+ */
+static uint32_t virtio_net_alloc_buffers(uint8_t **bufs, uint32_t count) {
+    uint32_t per_page = PAGE_SIZE / VIRTIO_NET_BUFFER_SIZE;
+    uint32_t n = 0;
+
+    while (n < count) {
+        physaddr_t phys = pmm_alloc_page();
+        if (phys == 0) {
+            break;
+        }
+        for (uint32_t i = 0; i < per_page && n < count; i++) {
+            bufs[n++] = (uint8_t *)(VMM_KERNEL_PHYS_MAP + phys + i * VIRTIO_NET_BUFFER_SIZE);
+        }
+    }
+
+    return n;
+}
+
+static inline physaddr_t virtio_net_buf_phys(const uint8_t *buf) {
+    return (physaddr_t)((virtaddr_t)buf - VMM_KERNEL_PHYS_MAP);
+}
+
+/**
+ * Give a receive buffer to the device
+ */
+static void virtio_net_rx_post(virtio_net_pair_t *pair, uint8_t *buf) {
+    virtq_desc_t desc;
+
+    desc.addr = virtio_net_buf_phys(buf);
+    desc.len = VIRTIO_NET_BUFFER_SIZE;
+    desc.flags = VIRTQ_DESC_F_WRITE;
+    desc.next = 0;
+    virtqueue_add(&pair->rx, &desc, 0, 1, buf);
+}
+
+/**
+ * Take back transmit buffers the device has finished with
+ * Called with the transmit lock held.
+ */
+static void virtio_net_tx_reclaim(virtio_net_pair_t *pair) {
+    uint8_t *buf;
+
+    while ((buf = (uint8_t *)virtqueue_get_used(&pair->tx, NULL)) != NULL) {
+        pair->tx_free[pair->tx_free_count++] = buf;
+    }
+}
+
+/**
+ * Fill in a checksum the sender left partial (VIRTIO_NET_HDR_F_NEEDS_CSUM)
+ * The field already holds the pseudo-header sum, so summing from
+ * csum_start to the end of the packet gives the final value.
+ */
+static void virtio_net_complete_csum(uint8_t *pkt, size_t len, uint16_t start, uint16_t offset) {
+    if ((size_t)start + offset + 2 > len) {
+        return;
+    }
+
+    uint32_t sum = 0;
+    size_t i = start;
+    for (; i + 1 < len; i += 2) {
+        sum += ((uint32_t)pkt[i] << 8) | pkt[i + 1];
+    }
+    if (i < len) {
+        sum += (uint32_t)pkt[i] << 8;
+    }
+    while (sum >> 16) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+
+    uint16_t csum = (uint16_t)~sum;
+    pkt[start + offset] = (uint8_t)(csum >> 8);
+    pkt[start + offset + 1] = (uint8_t)(csum & 0xFF);
+}
+
+/**
+ * Re-read the link state from the device configuration
+ */
+static void virtio_net_update_link(void) {
+    if (virtio_has_feature(&virtio_net_dev.vdev, VIRTIO_NET_F_STATUS)) {
+        uint16_t status = virtio_cfg_read16(&virtio_net_dev.vdev, VIRTIO_NET_CFG_STATUS);
+        virtio_net_dev.link_up = (status & VIRTIO_NET_S_LINK_UP) != 0;
+    } else {
+        virtio_net_dev.link_up = true;
+    }
+}
+
+/**
+ * Interrupt callback from the virtio core
+ */
+static void virtio_net_irq(virtio_device_t *vdev, uint8_t isr) {
+    UNUSED(vdev);
+
+    if (isr & VIRTIO_ISR_CONFIG) {
+        bool was_up = virtio_net_dev.link_up;
+        virtio_net_update_link();
+        if (virtio_net_dev.link_up != was_up) {
+            kprintf("[virtio-net] Link status changed: %s\n",
+                    virtio_net_dev.link_up ? "UP" : "DOWN");
+        }
+    }
+}
+
+/**
+ * Set up a queue pair and its buffers
+ */
+static bool virtio_net_init_pair(uint16_t index) {
+    virtio_net_pair_t *pair = &virtio_net_dev.pairs[index];
+    virtio_device_t *vdev = &virtio_net_dev.vdev;
+
+    if (virtqueue_init(vdev, &pair->rx, (uint16_t)(2 * index), VIRTIO_NET_QUEUE_SIZE) != VIRTIO_SUCCESS ||
+        virtqueue_init(vdev, &pair->tx, (uint16_t)(2 * index + 1), VIRTIO_NET_QUEUE_SIZE) != VIRTIO_SUCCESS) {
+        kprintf("[virtio-net] ERROR: Failed to set up queue pair %u\n", index);
+        return false;
+    }
+
+    /* Fill the receive ring */
+    uint8_t *rx_bufs[VIRTIO_NET_QUEUE_SIZE];
+    uint32_t rx_count = virtio_net_alloc_buffers(rx_bufs, pair->rx.size);
+    if (rx_count == 0) {
+        kprintf("[virtio-net] ERROR: Failed to allocate RX buffers\n");
+        return false;
+    }
+    for (uint32_t i = 0; i < rx_count; i++) {
+        virtio_net_rx_post(pair, rx_bufs[i]);
+    }
+
+    pair->tx_free_count = virtio_net_alloc_buffers(pair->tx_free, pair->tx.size);
+    if (pair->tx_free_count == 0) {
+        kprintf("[virtio-net] ERROR: Failed to allocate TX buffers\n");
+        return false;
+    }
+
+    /* Receive is polled and transmit buffers are reclaimed on send */
+    virtqueue_disable_cb(&pair->rx);
+    virtqueue_disable_cb(&pair->tx);
+
+    return true;
+}
+
+/* ============================================================================
+ * Public API
+ * ============================================================================ */
+
+/**
+ * Initialize the virtio-net driver
+ */
+bool virtio_net_init(void) {
+    static const uint16_t ids[] = {
+        VIRTIO_PCI_DEVICE_MODERN_BASE + VIRTIO_ID_NET,
+        VIRTIO_PCI_DEVICE_NET_TRANS,
+    };
+
+    kprintf("[virtio-net] Initializing virtio network driver\n");
+
+    memset(&virtio_net_dev, 0, sizeof(virtio_net_dev));
+    virtio_device_t *vdev = &virtio_net_dev.vdev;
+
+    pci_device_t *pci = NULL;
+    for (size_t i = 0; i < sizeof(ids) / sizeof(ids[0]) && !pci; i++) {
+        pci = pci_find_device(VIRTIO_PCI_VENDOR, ids[i]);
+    }
+    if (!pci) {
+        kprintf("[virtio-net] No device found\n");
+        return false;
+    }
+
+    if (virtio_pci_init(vdev, pci) != VIRTIO_SUCCESS) {
+        return false;
+    }
+    vdev->driver = &virtio_net_dev;
+
+    /*
+     * The stack computes its own checksums and never builds frames above
+     * the MTU, so TX offloads stay off; RX accepts partial checksums
+     * (completed here) but not TSO, which would deliver frames larger
+     * than the receive interface's MTU-sized buffers.
+     */
+    uint64_t wanted = (1ULL << VIRTIO_F_VERSION_1) | (1ULL << VIRTIO_F_EVENT_IDX) |
+                      (1ULL << VIRTIO_NET_F_GUEST_CSUM) | (1ULL << VIRTIO_NET_F_MAC) |
+                      (1ULL << VIRTIO_NET_F_MRG_RXBUF) | (1ULL << VIRTIO_NET_F_STATUS);
+
+    if (virtio_set_features(vdev, virtio_get_device_features(vdev) & wanted) != VIRTIO_SUCCESS) {
+        kprintf("[virtio-net] ERROR: Feature negotiation failed\n");
+        virtio_fail(vdev);
+        return false;
+    }
+    virtio_net_dev.mergeable = virtio_has_feature(vdev, VIRTIO_NET_F_MRG_RXBUF);
+
+    if (virtio_has_feature(vdev, VIRTIO_NET_F_MAC)) {
+        for (int i = 0; i < 6; i++) {
+            virtio_net_dev.mac[i] = virtio_cfg_read8(vdev, VIRTIO_NET_CFG_MAC + i);
+        }
+    } else {
+        /* Locally administered address */
+        static const uint8_t fallback[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+        memcpy(virtio_net_dev.mac, fallback, 6);
+    }
+
+    virtio_net_dev.num_pairs = VIRTIO_NET_MAX_PAIRS;
+    for (uint16_t i = 0; i < virtio_net_dev.num_pairs; i++) {
+        if (!virtio_net_init_pair(i)) {
+            virtio_fail(vdev);
+            return false;
+        }
+    }
+
+    virtio_request_irq(vdev, virtio_net_irq);
+    virtio_driver_ok(vdev);
+
+    for (uint16_t i = 0; i < virtio_net_dev.num_pairs; i++) {
+        virtqueue_kick(&virtio_net_dev.pairs[i].rx);
+    }
+
+    uint8_t *mac = virtio_net_dev.mac;
+    kprintf("[virtio-net] MAC address: %02x:%02x:%02x:%02x:%02x:%02x\n",
+            mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    kprintf("[virtio-net] %u queue pair%s, %u RX buffers%s%s\n",
+            virtio_net_dev.num_pairs, virtio_net_dev.num_pairs == 1 ? "" : "s",
+            virtio_net_dev.pairs[0].rx.size - virtio_net_dev.pairs[0].rx.num_free,
+            virtio_net_dev.mergeable ? ", mergeable" : "",
+            virtio_has_feature(vdev, VIRTIO_NET_F_GUEST_CSUM) ? ", RX checksum offload" : "");
+
+    virtio_net_update_link();
+    kprintf("[virtio-net] Link %s\n", virtio_net_dev.link_up ? "UP" : "DOWN");
+
+    virtio_net_dev.initialized = true;
+    kprintf("[virtio-net] Driver initialized successfully\n");
+
+    return true;
+}
+
+/**
+ * Send a network packet
+ */
+ssize_t virtio_net_send_packet(const void *data, size_t len) {
+    if (!virtio_net_dev.initialized) {
+        kprintf("[virtio-net] ERROR: Driver not initialized\n");
+        return -1;
+    }
+
+    if (data == NULL || len == 0) {
+        return -1;
+    }
+
+    if (len > VIRTIO_NET_MAX_PACKET_SIZE) {
+        kprintf("[virtio-net] ERROR: Packet too large (%d > %d)\n",
+                (int)len, VIRTIO_NET_MAX_PACKET_SIZE);
+        return -1;
+    }
+
+    virtio_net_pair_t *pair = &virtio_net_dev.pairs[0];
+    uint64_t flags = virtio_net_lock(&pair->tx_lock);
+
+    if (pair->tx_free_count == 0) {
+        virtio_net_tx_reclaim(pair);
+    }
+    if (pair->tx_free_count == 0) {
+        virtio_net_unlock(&pair->tx_lock, flags);
+        virtio_net_dev.errors++;
+        return -1;
+    }
+
+    uint8_t *buf = pair->tx_free[--pair->tx_free_count];
+    memset(buf, 0, VIRTIO_NET_HDR_LEN);     /* No offloads requested */
+    memcpy(buf + VIRTIO_NET_HDR_LEN, data, len);
+
+    virtq_desc_t desc;
+    desc.addr = virtio_net_buf_phys(buf);
+    desc.len = (uint32_t)(VIRTIO_NET_HDR_LEN + len);
+    desc.flags = 0;
+    desc.next = 0;
+
+    virtqueue_add(&pair->tx, &desc, 0, 1, buf);
+    virtqueue_kick(&pair->tx);
+
+    virtio_net_dev.packets_sent++;
+    virtio_net_dev.bytes_sent += len;
+
+    virtio_net_unlock(&pair->tx_lock, flags);
+
+    TRACE(TRACE_VIRTIO_NET, TRACE_VNET_TX, 0, len, 0, 0);
+
+    return len;
+}
+
+/**
+ * Receive a network packet
+ */
+ssize_t virtio_net_receive_packet(void *buf, size_t max_len) {
+    if (!virtio_net_dev.initialized) {
+        return -1;
+    }
+
+    if (buf == NULL || max_len == 0) {
+        return -1;
+    }
+
+    virtio_net_pair_t *pair = &virtio_net_dev.pairs[0];
+    uint64_t flags = virtio_net_lock(&pair->rx_lock);
+
+    uint32_t used_len;
+    uint8_t *rx = (uint8_t *)virtqueue_get_used(&pair->rx, &used_len);
+    if (!rx) {
+        virtio_net_unlock(&pair->rx_lock, flags);
+        return 0;  /* No packet available */
+    }
+
+    virtio_net_hdr_t hdr;
+    memcpy(&hdr, rx, VIRTIO_NET_HDR_LEN);
+
+    uint16_t buffers = virtio_net_dev.mergeable ? hdr.num_buffers : 1;
+    if (buffers == 0) {
+        buffers = 1;
+    }
+
+    /* The first buffer starts with the header; the rest are all data */
+    size_t copied = 0;
+    size_t total = 0;
+    bool bad = used_len < VIRTIO_NET_HDR_LEN;
+    uint32_t offset = VIRTIO_NET_HDR_LEN;
+
+    for (uint16_t i = 0; i < buffers; i++) {
+        if (i > 0) {
+            rx = (uint8_t *)virtqueue_get_used(&pair->rx, &used_len);
+            if (!rx) {
+                bad = true;
+                break;
+            }
+            offset = 0;
+        }
+
+        if (!bad && used_len > offset) {
+            size_t chunk = used_len - offset;
+            size_t n = MIN(chunk, max_len - copied);
+            memcpy((uint8_t *)buf + copied, rx + offset, n);
+            copied += n;
+            total += chunk;
+        }
+
+        virtio_net_rx_post(pair, rx);
+    }
+
+    virtqueue_kick(&pair->rx);
+    virtio_net_unlock(&pair->rx_lock, flags);
+
+    if (bad) {
+        kprintf("[virtio-net] RX error: malformed packet\n");
+        virtio_net_dev.errors++;
+        return -1;
+    }
+
+    if ((hdr.flags & VIRTIO_NET_HDR_F_NEEDS_CSUM) && copied == total) {
+        virtio_net_complete_csum((uint8_t *)buf, copied, hdr.csum_start, hdr.csum_offset);
+    }
+
+    TRACE(TRACE_VIRTIO_NET, TRACE_VNET_RX, 0, total, buffers, 0);
+
+    /* Update statistics */
+    virtio_net_dev.packets_received++;
+    virtio_net_dev.bytes_received += copied;
+
+    return (ssize_t)copied;
+}
+
+/**
+ * Get the MAC address
+ */
+void virtio_net_get_mac(uint8_t mac[6]) {
+    if (mac == NULL) {
+        return;
+    }
+
+    for (int i = 0; i < 6; i++) {
+        mac[i] = virtio_net_dev.mac[i];
+    }
+}
+
+/**
+ * Check if link is up
+ */
+bool virtio_net_link_up(void) {
+    if (!virtio_net_dev.initialized) {
+        return false;
+    }
+
+    virtio_net_update_link();
+    return virtio_net_dev.link_up;
+}
+
+/**
+ * Get device statistics
+ */
+void virtio_net_get_stats(uint64_t *packets_sent, uint64_t *packets_received,
+                          uint64_t *bytes_sent, uint64_t *bytes_received) {
+    if (packets_sent) {
+        *packets_sent = virtio_net_dev.packets_sent;
+    }
+    if (packets_received) {
+        *packets_received = virtio_net_dev.packets_received;
+    }
+    if (bytes_sent) {
+        *bytes_sent = virtio_net_dev.bytes_sent;
+    }
+    if (bytes_received) {
+        *bytes_received = virtio_net_dev.bytes_received;
+    }
+}
@@ -0,0 +1,119 @@
+/**
+ * AAAos Network Driver - Virtio Network Device
+ *
+ * Driver for the paravirtual NIC of QEMU/KVM and other hypervisors
+ * (virtio 1.0 modern PCI). It has the same send/receive interface as the
+ * e1000 driver, but the device exchanges whole frames through shared
+ * virtqueues instead of emulated registers.
+ */
+
+#ifndef _AAAOS_DRIVERS_VIRTIO_NET_H
+#define _AAAOS_DRIVERS_VIRTIO_NET_H
+
+#include "../../kernel/include/types.h"
+#include "../virtio/virtio.h"
+
+/* Feature bits */
+#define VIRTIO_NET_F_CSUM           0       /* Device completes TX checksums */
+#define VIRTIO_NET_F_GUEST_CSUM     1       /* RX packets may carry partial checksums */
+#define VIRTIO_NET_F_MTU            3       /* mtu is valid */
+#define VIRTIO_NET_F_MAC            5       /* mac is valid */
+#define VIRTIO_NET_F_GUEST_TSO4     7       /* RX of TCPv4 segments larger than the MTU */
+#define VIRTIO_NET_F_GUEST_TSO6     8
+#define VIRTIO_NET_F_HOST_TSO4      11      /* Device segments large TCPv4 sends */
+#define VIRTIO_NET_F_HOST_TSO6      12
+#define VIRTIO_NET_F_MRG_RXBUF      15      /* RX packets may span several buffers */
+#define VIRTIO_NET_F_STATUS         16      /* status is valid */
+#define VIRTIO_NET_F_CTRL_VQ        17      /* Control virtqueue */
+#define VIRTIO_NET_F_MQ             22      /* Multiple queue pairs */
+
+/* Device configuration offsets */
+#define VIRTIO_NET_CFG_MAC          0       /* u8[6] */
+#define VIRTIO_NET_CFG_STATUS       6       /* u16 */
+#define VIRTIO_NET_CFG_MAX_PAIRS    8       /* u16, with VIRTIO_NET_F_MQ */
+#define VIRTIO_NET_CFG_MTU          10      /* u16, with VIRTIO_NET_F_MTU */
+
+/* Configuration status bits */
+#define VIRTIO_NET_S_LINK_UP        BIT(0)
+
+/* Packet header flags */
+#define VIRTIO_NET_HDR_F_NEEDS_CSUM BIT(0)  /* Checksum at csum_start/offset not filled in */
+#define VIRTIO_NET_HDR_F_DATA_VALID BIT(1)  /* Device verified the checksum */
+
+/* Packet header GSO types */
+#define VIRTIO_NET_HDR_GSO_NONE     0
+
+/* Queue layout: receiveq N is 2N, transmitq N is 2N + 1 */
+#define VIRTIO_NET_MAX_PAIRS        1       /* One pair per CPU */
+#define VIRTIO_NET_QUEUE_SIZE       256     /* Ring entries per virtqueue */
+
+/* Buffer sizes */
+#define VIRTIO_NET_BUFFER_SIZE      2048    /* RX and TX buffers (two per page) */
+#define VIRTIO_NET_MAX_PACKET_SIZE  1518    /* Ethernet MTU + headers */
+
+/**
+ * Header preceding every packet (virtio 1.0 layout, num_buffers included)
+ */
+typedef struct PACKED {
+    uint8_t     flags;          /* VIRTIO_NET_HDR_F_* */
+    uint8_t     gso_type;       /* VIRTIO_NET_HDR_GSO_* */
+    uint16_t    hdr_len;        /* Length of the headers to replicate per segment */
+    uint16_t    gso_size;       /* Segment payload size */
+    uint16_t    csum_start;     /* Offset where checksumming starts */
+    uint16_t    csum_offset;    /* Checksum position after csum_start */
+    uint16_t    num_buffers;    /* RX buffers used (mergeable buffers) */
+} virtio_net_hdr_t;
+
+/**
+ * Initialize the virtio network driver
+ * Finds the first virtio network device, negotiates features, fills the
+ * receive queue and brings the device up.
+ *
+ * @return true on success, false if no usable device was found
+ */
+bool virtio_net_init(void);
+
+/**
+ * Send a network packet
+ *
+ * @param data Pointer to packet data (Ethernet frame)
+ * @param len Length of packet in bytes
+ * @return Number of bytes sent, or -1 on error
+ */
+ssize_t virtio_net_send_packet(const void *data, size_t len);
+
+/**
+ * Receive a network packet
+ *
+ * @param buf Buffer to store received packet
+ * @param max_len Maximum buffer size (longer packets are truncated)
+ * @return Number of bytes received, 0 if no packet available, or -1 on error
+ */
+ssize_t virtio_net_receive_packet(void *buf, size_t max_len);
+
+/**
+ * Get the MAC address of the device
+ *
+ * @param mac Buffer to store 6-byte MAC address
+ */
+void virtio_net_get_mac(uint8_t mac[6]);
+
+/**
+ * Check if link is up
+ *
+ * @return true if link is up, false otherwise
+ */
+bool virtio_net_link_up(void);
+
+/**
+ * Get device statistics
+ *
+ * @param packets_sent Output: total packets sent
+ * @param packets_received Output: total packets received
+ * @param bytes_sent Output: total bytes sent
+ * @param bytes_received Output: total bytes received
+ */
+void virtio_net_get_stats(uint64_t *packets_sent, uint64_t *packets_received,
+                          uint64_t *bytes_sent, uint64_t *bytes_received);
+
+#endif /* _AAAOS_DRIVERS_VIRTIO_NET_H */
@@ -9,6 +9,7 @@
 #include "pci.h"
 #include "../../kernel/arch/x86_64/io.h"
 #include "../../kernel/include/serial.h"
+#include "../../kernel/mm/vmm.h"
 
 /* ============================================================================
  * Private Data
@@ -418,6 +419,35 @@ bool pci_bar_is_64bit(pci_device_t* dev, int bar) {
     return (bar_value & PCI_BAR_MEM_TYPE_MASK) == PCI_BAR_MEM_64BIT;
 }
 
+bool pci_bar_is_prefetchable(pci_device_t* dev, int bar) {
+    if (dev == NULL || bar < 0 || bar > 5) {
+        return false;
+    }
+
+    uint32_t bar_value = dev->bar[bar];
+    return !(bar_value & PCI_BAR_IO_SPACE) && (bar_value & PCI_BAR_PREFETCHABLE);
+}
+
+virtaddr_t pci_map_bar(pci_device_t* dev, int bar) {
+    if (dev == NULL || bar < 0 || bar > 5 || pci_bar_is_io(dev, bar)) {
+        return 0;
+    }
+
+    uint64_t phys = pci_get_bar(dev, bar);
+    uint64_t size = pci_get_bar_size(dev, bar);
+    if (phys == 0 || size == 0) {
+        return 0;
+    }
+
+    /* Register BARs must stay uncached: WC may merge or reorder stores */
+    uint64_t flags = VMM_FLAGS_MMIO;
+    if (dev->class_code == PCI_CLASS_DISPLAY && pci_bar_is_prefetchable(dev, bar)) {
+        flags = VMM_FLAGS_MMIO_WC;
+    }
+
+    return vmm_map_mmio(phys, size, flags);
+}
+
 void pci_enable_bus_mastering(pci_device_t* dev) {
     if (dev == NULL) {
         return;
@@ -496,6 +526,35 @@ void pci_disable_interrupts(pci_device_t* dev) {
             dev->bus, dev->device, dev->function);
 }
 
+uint8_t pci_find_capability(pci_device_t* dev, uint8_t cap_id, uint8_t start) {
+    if (dev == NULL) {
+        return 0;
+    }
+
+    uint16_t status = pci_read_config16(dev->bus, dev->device, dev->function, PCI_STATUS);
+    if (!(status & PCI_STATUS_CAP_LIST)) {
+        return 0;
+    }
+
+    uint8_t offset;
+    if (start == 0) {
+        offset = pci_read_config8(dev->bus, dev->device, dev->function, PCI_CAPABILITIES);
+    } else {
+        offset = pci_read_config8(dev->bus, dev->device, dev->function, start + 1);
+    }
+
+    /* The list lives above the standard header; bound the walk against loops */
+    for (int guard = 0; offset >= 0x40 && guard < 48; guard++) {
+        offset &= ~0x3;
+        if (pci_read_config8(dev->bus, dev->device, dev->function, offset) == cap_id) {
+            return offset;
+        }
+        offset = pci_read_config8(dev->bus, dev->device, dev->function, offset + 1);
+    }
+
+    return 0;
+}
+
 /* ============================================================================
  * Debug/Utility Functions
  * ============================================================================ */
@@ -56,6 +56,16 @@
 #define PCI_CMD_FAST_BTB        (1 << 9)    /* Fast back-to-back enable */
 #define PCI_CMD_INT_DISABLE     (1 << 10)   /* Interrupt disable */
 
+/* PCI Status Register bits */
+#define PCI_STATUS_CAP_LIST     (1 << 4)    /* Capabilities list present */
+
+/* PCI Capability IDs */
+#define PCI_CAP_ID_PM           0x01    /* Power management */
+#define PCI_CAP_ID_MSI          0x05    /* Message signalled interrupts */
+#define PCI_CAP_ID_VNDR         0x09    /* Vendor specific */
+#define PCI_CAP_ID_EXP          0x10    /* PCI Express */
+#define PCI_CAP_ID_MSIX         0x11    /* MSI-X */
+
 /* PCI Header Type bits */
 #define PCI_HEADER_TYPE_MASK    0x7F
 #define PCI_HEADER_TYPE_NORMAL  0x00
@@ -340,6 +350,24 @@ bool pci_bar_is_io(pci_device_t* dev, int bar);
  */
 bool pci_bar_is_64bit(pci_device_t* dev, int bar);
 
+/**
+ * Check if BAR is prefetchable memory
+ * @param dev   Pointer to PCI device
+ * @param bar   BAR index (0-5)
+ * @return      true if prefetchable memory BAR
+ */
+bool pci_bar_is_prefetchable(pci_device_t* dev, int bar);
+
+/**
+ * Map a memory BAR into the kernel's direct physical map
+ * Prefetchable BARs of display controllers (framebuffers, GPU VRAM
+ * apertures) are mapped write-combining, everything else uncached.
+ * @param dev   Pointer to PCI device
+ * @param bar   BAR index (0-5)
+ * @return      Virtual address of the BAR, or 0 for I/O or unmappable BARs
+ */
+virtaddr_t pci_map_bar(pci_device_t* dev, int bar);
+
 /**
  * Enable bus mastering for a device (required for DMA)
  * @param dev   Pointer to PCI device
@@ -376,6 +404,15 @@ void pci_enable_interrupts(pci_device_t* dev);
  */
 void pci_disable_interrupts(pci_device_t* dev);
 
+/**
+ * Find a capability in the device's capability list
+ * @param dev       Pointer to PCI device
+ * @param cap_id    Capability ID (PCI_CAP_ID_*)
+ * @param start     Continue after the capability at this offset (0 for first)
+ * @return          Configuration space offset of the capability, or 0 if none
+ */
+uint8_t pci_find_capability(pci_device_t* dev, uint8_t cap_id, uint8_t start);
+
 /* ============================================================================
  * Debug/Utility Functions
  * ============================================================================ */
@@ -6,10 +6,18 @@
  */
 
 #include "ahci.h"
+#include "blkdev.h"
+#include "bio.h"
 #include "../../kernel/include/serial.h"
+#include "../../kernel/include/trace.h"
 #include "../../kernel/mm/pmm.h"
 #include "../../kernel/mm/vmm.h"
+#include "../../kernel/mm/heap.h"
 #include "../../kernel/arch/x86_64/io.h"
+#include "../../kernel/arch/x86_64/include/idt.h"
+#include "../../kernel/sched/scheduler.h"
+#include "../../kernel/proc/process.h"
+#include "../timer/pit.h"
 
 /* Maximum number of AHCI controllers supported */
 #define AHCI_MAX_CONTROLLERS    4
@@ -18,6 +26,12 @@
 #define AHCI_CMD_TIMEOUT        5000
 #define AHCI_SPIN_TIMEOUT       1000000
 
+/* Command timeout in scheduler ticks, for the interrupt-driven path */
+#define AHCI_CMD_TIMEOUT_TICKS  ((AHCI_CMD_TIMEOUT * SCHEDULER_TICK_FREQUENCY) / 1000)
+
+/* RFLAGS interrupt enable bit */
+#define AHCI_RFLAGS_IF          (1 << 9)
+
 /* Memory allocation sizes */
 #define AHCI_CMD_LIST_SIZE      (sizeof(ahci_cmd_header_t) * AHCI_MAX_CMD_SLOTS)  /* 1KB */
 #define AHCI_FIS_SIZE           256
@@ -246,6 +260,15 @@ static int ahci_port_alloc_memory(ahci_controller_t* ctrl, int port) {
         info->cmd_list[i].ctbau = (uint32_t)(ct_phys >> 32);
     }
 
+    /* Until IDENTIFY reports NCQ, commands run one at a time */
+    info->ncq = false;
+    info->queue_depth = 1;
+    info->outstanding = 0;
+    info->exclusive = false;
+    info->pending_head = NULL;
+    info->pending_tail = NULL;
+    info->lock = 0;
+
     /* Clear interrupt status and error */
     pt->serr = (uint32_t)-1;    /* Clear all error bits */
     pt->is = (uint32_t)-1;      /* Clear all interrupt status bits */
@@ -260,88 +283,187 @@ static int ahci_port_alloc_memory(ahci_controller_t* ctrl, int port) {
     return AHCI_SUCCESS;
 }
 
+/* ============================================================================
+ * Command Queuing
+ * ============================================================================ */
+
 /**
- * Find a free command slot
+ * Take the port queue lock with interrupts disabled
+ * @return Saved RFLAGS for ahci_unlock
  */
-static int ahci_find_cmdslot(ahci_port_t* port, uint32_t num_slots) {
-    /* Slots in use are set in SACT and CI registers */
-    uint32_t slots = port->sact | port->ci;
+static inline uint64_t ahci_lock(ahci_port_info_t* info) {
+    uint64_t flags;
+    __asm__ __volatile__("pushfq; pop %0; cli" : "=r"(flags) : : "memory");
+    while (__sync_lock_test_and_set(&info->lock, 1)) {
+        __asm__ __volatile__("pause");
+    }
+    return flags;
+}
 
-    for (uint32_t i = 0; i < num_slots; i++) {
-        if ((slots & (1 << i)) == 0) {
-            return i;
-        }
+static inline void ahci_unlock(ahci_port_info_t* info, uint64_t flags) {
+    __sync_lock_release(&info->lock);
+    if (flags & AHCI_RFLAGS_IF) {
+        __asm__ __volatile__("sti");
     }
+}
 
-    return -1;  /* No free slot */
+/**
+ * Find the controller that owns a port
+ */
+static ahci_controller_t* ahci_find_controller(int port) {
+    for (int i = 0; i < ahci_controller_count; i++) {
+        if (ahci_controllers[i].ports_impl & (1 << port)) {
+            return &ahci_controllers[i];
+        }
+    }
+    return NULL;
 }
 
 /**
- * Wait for command completion
+ * Check whether a request is sent as an NCQ command
  */
-static int ahci_wait_cmd(ahci_port_t* port, int slot, int timeout_ms) {
-    uint32_t slot_bit = 1 << slot;
-    int spin = 0;
+static bool ahci_is_queued(ahci_port_info_t* info, ahci_request_t* req) {
+    return info->ncq && (req->op == AHCI_OP_READ || req->op == AHCI_OP_WRITE);
+}
 
-    /* Wait for completion */
-    while (1) {
-        /* Check if slot is clear (command completed) */
-        if ((port->ci & slot_bit) == 0) {
+/**
+ * Build the command FIS for a request
+ */
+static void ahci_build_fis(ahci_port_info_t* info, ahci_request_t* req, int slot,
+                           ahci_fis_reg_h2d_t* fis) {
+    ahci_memset(fis, 0, sizeof(*fis));
+    fis->fis_type = FIS_TYPE_REG_H2D;
+    fis->c = 1;  /* Command */
+
+    switch (req->op) {
+        case AHCI_OP_READ:
+        case AHCI_OP_WRITE:
+            /* LBA mode, 48-bit addressing */
+            fis->device = 1 << 6;
+
+            fis->lba0 = (uint8_t)(req->lba & 0xFF);
+            fis->lba1 = (uint8_t)((req->lba >> 8) & 0xFF);
+            fis->lba2 = (uint8_t)((req->lba >> 16) & 0xFF);
+            fis->lba3 = (uint8_t)((req->lba >> 24) & 0xFF);
+            fis->lba4 = (uint8_t)((req->lba >> 32) & 0xFF);
+            fis->lba5 = (uint8_t)((req->lba >> 40) & 0xFF);
+
+            if (ahci_is_queued(info, req)) {
+                /* Queued commands carry the count in FEATURES, the tag in COUNT */
+                fis->command = (req->op == AHCI_OP_WRITE) ?
+                               ATA_CMD_WRITE_FPDMA_QUEUED : ATA_CMD_READ_FPDMA_QUEUED;
+                fis->featurel = (uint8_t)(req->count & 0xFF);
+                fis->featureh = (uint8_t)((req->count >> 8) & 0xFF);
+                fis->countl = (uint8_t)(slot << 3);
+            } else {
+                fis->command = (req->op == AHCI_OP_WRITE) ?
+                               ATA_CMD_WRITE_DMA_EXT : ATA_CMD_READ_DMA_EXT;
+                fis->countl = (uint8_t)(req->count & 0xFF);
+                fis->counth = (uint8_t)((req->count >> 8) & 0xFF);
+            }
             break;
-        }
-
-        /* Check for errors */
-        if (port->is & AHCI_PORT_INT_TFES) {
-            kprintf("[AHCI] Task file error during command\n");
-            return AHCI_ERR_TASK_FILE;
-        }
 
-        spin++;
-        if (spin >= timeout_ms * 1000) {
-            kprintf("[AHCI] Command timeout\n");
-            return AHCI_ERR_TIMEOUT;
-        }
+        case AHCI_OP_FLUSH:
+            fis->command = ATA_CMD_FLUSH_CACHE_EXT;
+            break;
 
-        ahci_delay(1);
+        case AHCI_OP_IDENTIFY:
+            fis->command = (info->type == AHCI_DEV_SATAPI)
+                           ? ATA_CMD_IDENTIFY_PACKET : ATA_CMD_IDENTIFY;
+            break;
     }
+}
 
-    /* Check for errors after completion */
-    if (port->is & AHCI_PORT_INT_TFES) {
-        kprintf("[AHCI] Task file error after command\n");
-        return AHCI_ERR_TASK_FILE;
+/**
+ * Translate a kernel virtual address for DMA
+ * The physical map translates directly; anything else (heap, mapped
+ * pages) is looked up in the page tables.
+ * @return Physical address, or 0 if not mapped
+ */
+static physaddr_t ahci_dma_addr(virtaddr_t virt) {
+    if (virt >= VMM_KERNEL_PHYS_MAP && virt < VMM_KERNEL_BASE) {
+        return (physaddr_t)(virt - VMM_KERNEL_PHYS_MAP);
     }
-
-    return AHCI_SUCCESS;
+    return vmm_get_physical(virt);
 }
 
-/* ============================================================================
- * ATA Commands
- * ============================================================================ */
-
 /**
- * Issue an ATA command
+ * Build PRD entries for a segment list
+ * Segments are walked page by page and physically adjacent pages share
+ * one entry of up to AHCI_PRDT_MAX_BYTES.
+ * @param prdt Entries to fill, or NULL to only count them
+ * @return Number of entries, or -1 if a page is unmapped or misaligned or
+ *         more than AHCI_MAX_PRDT_ENTRIES entries would be needed
  */
-static int ahci_issue_cmd(ahci_controller_t* ctrl, int port_num,
-                          ahci_fis_reg_h2d_t* fis,
-                          void* buf, uint32_t buf_size,
-                          int write) {
-    ahci_port_t* port = ahci_get_port(ctrl, port_num);
-    ahci_port_info_t* info = &ctrl->port_info[port_num];
+static int ahci_prdt_walk(const ahci_sg_t* sg, uint32_t sg_count,
+                          ahci_prdt_entry_t* prdt) {
+    int n = 0;
+    physaddr_t start = 0;   /* Entry being built */
+    uint32_t len = 0;
+
+    for (uint32_t s = 0; s < sg_count; s++) {
+        virtaddr_t virt = (virtaddr_t)sg[s].buf;
+        uint32_t remaining = sg[s].size;
+
+        while (remaining > 0) {
+            /* The physical map is contiguous; elsewhere go a page at a time */
+            uint32_t chunk;
+            if (virt >= VMM_KERNEL_PHYS_MAP && virt < VMM_KERNEL_BASE) {
+                chunk = MIN(remaining, AHCI_PRDT_MAX_BYTES);
+            } else {
+                chunk = MIN(remaining, PAGE_SIZE - (uint32_t)(virt & (PAGE_SIZE - 1)));
+            }
 
-    if (!port || !info->present) {
-        return AHCI_ERR_NO_DEVICE;
-    }
+            physaddr_t phys = ahci_dma_addr(virt);
+            if (phys == 0 || (phys & 1)) {
+                return -1;
+            }
 
-    /* Clear interrupt status */
-    port->is = (uint32_t)-1;
+            if (len > 0 && start + len == phys && len + chunk <= AHCI_PRDT_MAX_BYTES) {
+                len += chunk;
+            } else {
+                if (len > 0) {
+                    if (n == AHCI_MAX_PRDT_ENTRIES) {
+                        return -1;
+                    }
+                    if (prdt) {
+                        prdt[n].dba = (uint32_t)(start & 0xFFFFFFFF);
+                        prdt[n].dbau = (uint32_t)(start >> 32);
+                        prdt[n].dbc = len - 1;  /* 0-based count */
+                    }
+                    n++;
+                }
+                start = phys;
+                len = chunk;
+            }
 
-    /* Find a free command slot */
-    int slot = ahci_find_cmdslot(port, ctrl->num_cmd_slots);
-    if (slot < 0) {
-        kprintf("[AHCI] No free command slot for port %d\n", port_num);
-        return AHCI_ERR_NOT_READY;
+            virt += chunk;
+            remaining -= chunk;
+        }
     }
 
+    if (len > 0) {
+        if (n == AHCI_MAX_PRDT_ENTRIES) {
+            return -1;
+        }
+        if (prdt) {
+            prdt[n].dba = (uint32_t)(start & 0xFFFFFFFF);
+            prdt[n].dbau = (uint32_t)(start >> 32);
+            prdt[n].dbc = len - 1;
+        }
+        n++;
+    }
+
+    return n;
+}
+
+/**
+ * Fill in the command header and table of a slot
+ */
+static void ahci_setup_cmd(ahci_port_info_t* info, int slot,
+                           ahci_fis_reg_h2d_t* fis,
+                           const ahci_sg_t* sg, uint32_t sg_count,
+                           int write) {
     /* Get command header and table */
     ahci_cmd_header_t* hdr = &info->cmd_list[slot];
     ahci_cmd_table_t* tbl = info->cmd_tables[slot];
@@ -364,43 +486,420 @@ static int ahci_issue_cmd(ahci_controller_t* ctrl, int port_num,
     /* Copy the FIS to command table */
     ahci_memcpy(tbl->cfis, fis, sizeof(ahci_fis_reg_h2d_t));
 
-    /* Set up PRDT if buffer provided */
-    if (buf && buf_size > 0) {
-        /* Get physical address of buffer */
-        physaddr_t buf_phys = (physaddr_t)((virtaddr_t)buf - VMM_KERNEL_PHYS_MAP);
+    /* Set up PRD entries (checked by ahci_submit) */
+    int prdt_count = ahci_prdt_walk(sg, sg_count, tbl->prdt_entry);
+
+    if (prdt_count > 0) {
+        tbl->prdt_entry[prdt_count - 1].i = 1;  /* Interrupt on last */
+        hdr->prdtl = prdt_count;
+    }
+}
+
+/**
+ * Issue pending requests to free slots (queue lock held)
+ */
+static void ahci_dispatch(ahci_controller_t* ctrl, int port_num) {
+    ahci_port_t* port = &ctrl->hba->ports[port_num];
+    ahci_port_info_t* info = &ctrl->port_info[port_num];
+
+    while (info->pending_head && !info->exclusive) {
+        ahci_request_t* req = info->pending_head;
+        bool queued = ahci_is_queued(info, req);
 
-        /* Calculate number of PRD entries needed */
-        uint32_t prdt_count = (buf_size + 0x3FFFFF) / 0x400000;  /* Max 4MB per entry */
-        if (prdt_count > AHCI_MAX_PRDT_ENTRIES) {
-            prdt_count = AHCI_MAX_PRDT_ENTRIES;
+        /* Non-queued commands may not overlap queued ones */
+        if (!queued && info->outstanding != 0) {
+            break;
         }
 
-        hdr->prdtl = prdt_count;
+        int slot = -1;
+        for (uint32_t i = 0; i < info->queue_depth; i++) {
+            if ((info->outstanding & (1U << i)) == 0) {
+                slot = i;
+                break;
+            }
+        }
+        if (slot < 0) {
+            break;
+        }
 
-        /* Set up PRD entries */
-        uint32_t remaining = buf_size;
-        physaddr_t addr = buf_phys;
+        info->pending_head = req->next;
+        if (!info->pending_head) {
+            info->pending_tail = NULL;
+        }
+        req->next = NULL;
+
+        /* A plain buffer is a single segment */
+        ahci_sg_t whole = { req->buf, 0 };
+        const ahci_sg_t* sg = &whole;
+        uint32_t sg_count = 1;
+
+        if (req->sg_count > 0) {
+            sg = req->sg;
+            sg_count = req->sg_count;
+        } else if (req->op == AHCI_OP_READ || req->op == AHCI_OP_WRITE) {
+            whole.size = req->count * AHCI_SECTOR_SIZE;
+        } else if (req->op == AHCI_OP_IDENTIFY) {
+            whole.size = AHCI_SECTOR_SIZE;
+        } else {
+            sg_count = 0;
+        }
 
-        for (uint32_t i = 0; i < prdt_count; i++) {
-            uint32_t chunk_size = (remaining > 0x400000) ? 0x400000 : remaining;
+        ahci_fis_reg_h2d_t fis;
+        ahci_build_fis(info, req, slot, &fis);
+        ahci_setup_cmd(info, slot, &fis, sg, sg_count, req->op == AHCI_OP_WRITE);
 
-            tbl->prdt_entry[i].dba = (uint32_t)(addr & 0xFFFFFFFF);
-            tbl->prdt_entry[i].dbau = (uint32_t)(addr >> 32);
-            tbl->prdt_entry[i].dbc = chunk_size - 1;  /* 0-based count */
-            tbl->prdt_entry[i].i = (i == prdt_count - 1) ? 1 : 0;  /* Interrupt on last */
+        uint32_t bit = 1U << slot;
+        info->slot_req[slot] = req;
+        info->outstanding |= bit;
+
+        if (queued) {
+            port->sact = bit;       /* SActive must be set before CI */
+        } else {
+            info->exclusive = true;
+        }
+        port->ci = bit;
+    }
+}
 
-            addr += chunk_size;
-            remaining -= chunk_size;
+/**
+ * Move finished slots onto a completion list (queue lock held)
+ */
+static ahci_request_t* ahci_collect(ahci_port_info_t* info, int port_num, uint32_t mask,
+                                    int status, ahci_request_t* list) {
+    for (int i = 0; i < AHCI_MAX_CMD_SLOTS; i++) {
+        if (!(mask & (1U << i)) || !info->slot_req[i]) {
+            continue;
         }
+
+        ahci_request_t* req = info->slot_req[i];
+        info->slot_req[i] = NULL;
+        req->status = status;
+        TRACE(TRACE_AHCI, TRACE_AHCI_COMPLETE, port_num, req->op, req->lba, (int64_t)status);
+        req->next = list;
+        list = req;
     }
 
-    /* Issue the command */
-    port->ci = 1 << slot;
+    info->outstanding &= ~mask;
+    if (info->outstanding == 0) {
+        info->exclusive = false;
+    }
+    return list;
+}
 
-    /* Wait for completion */
-    int result = ahci_wait_cmd(port, slot, AHCI_CMD_TIMEOUT);
+/**
+ * Restart a port after an error, dropping everything it had in flight
+ */
+static void ahci_port_recover(ahci_port_t* port) {
+    ahci_stop_cmd(port);
 
-    return result;
+    port->serr = (uint32_t)-1;
+    port->is = (uint32_t)-1;
+
+    /* A device left busy needs a Command List Override before restarting */
+    if (port->tfd & (AHCI_PORT_TFD_BSY | AHCI_PORT_TFD_DRQ)) {
+        port->cmd |= AHCI_PORT_CMD_CLO;
+        int timeout = AHCI_SPIN_TIMEOUT;
+        while ((port->cmd & AHCI_PORT_CMD_CLO) && --timeout) {
+            ahci_delay(1);
+        }
+    }
+
+    ahci_start_cmd(port);
+}
+
+/**
+ * Fail every outstanding command on a port and restart it (queue lock held)
+ */
+static ahci_request_t* ahci_port_abort(ahci_controller_t* ctrl, int port_num, int status,
+                                       ahci_request_t* list) {
+    ahci_port_info_t* info = &ctrl->port_info[port_num];
+
+    ahci_port_recover(&ctrl->hba->ports[port_num]);
+    list = ahci_collect(info, port_num, info->outstanding, status, list);
+    ahci_dispatch(ctrl, port_num);
+    return list;
+}
+
+/**
+ * Reap completed commands on a port (queue lock held)
+ * Completion is the SActive/CI difference against the issued slots.
+ * @return Finished requests, to be passed to ahci_finish() unlocked
+ */
+static ahci_request_t* ahci_port_reap(ahci_controller_t* ctrl, int port_num) {
+    ahci_port_t* port = &ctrl->hba->ports[port_num];
+    ahci_port_info_t* info = &ctrl->port_info[port_num];
+
+    uint32_t is = port->is;
+    port->is = is;  /* Acknowledge */
+
+    uint32_t done = info->outstanding & ~(port->sact | port->ci);
+    if (done) {
+        info->stall_ticks = 0;
+    }
+    ahci_request_t* list = ahci_collect(info, port_num, done, AHCI_SUCCESS, NULL);
+
+    if (is & (AHCI_PORT_INT_TFES | AHCI_PORT_INT_HBFS | AHCI_PORT_INT_HBDS |
+              AHCI_PORT_INT_IFS)) {
+        /* The failing NCQ tag is only known from the NCQ error log;
+         * fail everything still in flight and let callers retry. */
+        kprintf("[AHCI] Port %d: error (IS=0x%08x, TFD=0x%02x), aborting 0x%08x\n",
+                port_num, is, port->tfd & 0xFF, info->outstanding);
+        return ahci_port_abort(ctrl, port_num, AHCI_ERR_TASK_FILE, list);
+    }
+
+    ahci_dispatch(ctrl, port_num);
+    return list;
+}
+
+/**
+ * Wake a thread sleeping on a request
+ */
+static void ahci_wake(process_t* proc) {
+    if (proc->state == PROCESS_STATE_BLOCKED) {
+        process_set_state(proc, PROCESS_STATE_READY);
+        scheduler_add(proc);
+    }
+}
+
+/**
+ * Complete reaped requests: run callbacks and wake sleepers
+ */
+static void ahci_finish(ahci_request_t* list) {
+    while (list) {
+        ahci_request_t* req = list;
+        list = req->next;
+
+        /* The submitter may reuse the request once complete is set */
+        ahci_done_t done = req->done;
+        process_t* waiter = req->waiter;
+        req->next = NULL;
+        __sync_synchronize();
+        req->complete = true;
+
+        if (done) {
+            done(req);
+        }
+        if (waiter) {
+            ahci_wake(waiter);
+        }
+    }
+}
+
+/**
+ * Check whether the caller can sleep until a completion interrupt
+ */
+static bool ahci_can_sleep(ahci_controller_t* ctrl) {
+    uint64_t flags;
+    __asm__ __volatile__("pushfq; pop %0" : "=r"(flags));
+
+    return ctrl->irq_enabled && (flags & AHCI_RFLAGS_IF) &&
+           scheduler_is_running() && process_get_current() != NULL;
+}
+
+/**
+ * AHCI interrupt handler
+ */
+static void ahci_irq_handler(interrupt_frame_t* frame) {
+    uint8_t irq = (uint8_t)(frame->int_no - IRQ_BASE);
+
+    for (int c = 0; c < ahci_controller_count; c++) {
+        ahci_controller_t* ctrl = &ahci_controllers[c];
+        if (!ctrl->irq_enabled || ctrl->irq != irq) {
+            continue;
+        }
+
+        uint32_t is = ctrl->hba->is;
+        if (is == 0) {
+            continue;
+        }
+
+        for (int i = 0; i < AHCI_MAX_PORTS; i++) {
+            if (!(is & (1U << i))) {
+                continue;
+            }
+
+            ahci_port_info_t* info = &ctrl->port_info[i];
+            if (!info->present || !info->cmd_list) {
+                ctrl->hba->ports[i].is = (uint32_t)-1;
+                continue;
+            }
+
+            uint64_t flags = ahci_lock(info);
+            ahci_request_t* list = ahci_port_reap(ctrl, i);
+            ahci_unlock(info, flags);
+            ahci_finish(list);
+        }
+
+        ctrl->hba->is = is;
+    }
+}
+
+/**
+ * Command timeout watchdog, run on every timer tick
+ * Sleeping waiters rely on the completion interrupt; if a port makes no
+ * progress for AHCI_CMD_TIMEOUT, poll CI/SActive once more and abort what
+ * is still in flight, which wakes the waiters with AHCI_ERR_TIMEOUT.
+ */
+static void ahci_watchdog(interrupt_frame_t* frame) {
+    UNUSED(frame);
+
+    for (int c = 0; c < ahci_controller_count; c++) {
+        ahci_controller_t* ctrl = &ahci_controllers[c];
+        if (!ctrl->irq_enabled) {
+            continue;
+        }
+
+        for (int i = 0; i < AHCI_MAX_PORTS; i++) {
+            ahci_port_info_t* info = &ctrl->port_info[i];
+            if (!info->present || !info->cmd_list) {
+                continue;
+            }
+
+            ahci_request_t* list = NULL;
+            uint64_t flags = ahci_lock(info);
+            if (info->outstanding == 0) {
+                info->stall_ticks = 0;
+            } else if (++info->stall_ticks >= AHCI_CMD_TIMEOUT_TICKS) {
+                list = ahci_port_reap(ctrl, i);
+                if (!list && info->outstanding) {
+                    kprintf("[AHCI] Command timeout on port %d\n", i);
+                    list = ahci_port_abort(ctrl, i, AHCI_ERR_TIMEOUT, NULL);
+                }
+                info->stall_ticks = 0;
+            }
+            ahci_unlock(info, flags);
+            ahci_finish(list);
+        }
+    }
+}
+
+/**
+ * Chain ahci_irq_handler onto the controller's legacy interrupt line
+ */
+static void ahci_enable_irq(ahci_controller_t* ctrl) {
+    uint8_t irq = ctrl->pci_dev->interrupt_line;
+
+    if (irq == 0 || irq >= 16) {
+        kprintf("[AHCI] No usable IRQ line, completions will be polled\n");
+        return;
+    }
+
+    /* The line may be shared with other PCI devices, so chain onto it */
+    if (idt_register_shared_handler(IRQ_BASE + irq, ahci_irq_handler) != 0) {
+        kprintf("[AHCI] IRQ %d has no free handler slot, completions will be polled\n", irq);
+        return;
+    }
+
+    /* Without the watchdog a lost completion would leave sleepers blocked */
+    if (idt_register_shared_handler(IRQ_TIMER, ahci_watchdog) != 0) {
+        kprintf("[AHCI] No timer slot for the command watchdog, completions will be polled\n");
+        return;
+    }
+    ctrl->irq = irq;
+
+    /* Unmask the line (and the cascade for the slave PIC) */
+    if (irq < 8) {
+        outb(0x21, inb(0x21) & ~(1 << irq));
+    } else {
+        outb(0xA1, inb(0xA1) & ~(1 << (irq - 8)));
+        outb(0x21, inb(0x21) & ~(1 << 2));
+    }
+
+    ctrl->irq_enabled = true;
+    kprintf("[AHCI] Using IRQ %d for command completion\n", irq);
+}
+
+/**
+ * Submit a request to a port of a known controller
+ */
+static int ahci_submit_ctrl(ahci_controller_t* ctrl, int port_num, ahci_request_t* req) {
+    ahci_port_info_t* info = &ctrl->port_info[port_num];
+
+    if (!info->present || !info->cmd_list) {
+        return AHCI_ERR_NO_DEVICE;
+    }
+
+    req->status = AHCI_SUCCESS;
+    req->complete = false;
+    req->waiter = NULL;
+    req->next = NULL;
+
+    uint64_t flags = ahci_lock(info);
+    if (info->pending_tail) {
+        info->pending_tail->next = req;
+    } else {
+        info->pending_head = req;
+    }
+    info->pending_tail = req;
+    ahci_dispatch(ctrl, port_num);
+    ahci_unlock(info, flags);
+
+    return AHCI_SUCCESS;
+}
+
+/**
+ * Wait for a request, sleeping if possible and polling otherwise
+ * Both paths time out after AHCI_CMD_TIMEOUT without progress on the port:
+ * the polling path counts its own delays, a sleeper is woken by
+ * ahci_watchdog() aborting the port.
+ */
+static int ahci_wait_ctrl(ahci_controller_t* ctrl, int port_num, ahci_request_t* req) {
+    ahci_port_info_t* info = &ctrl->port_info[port_num];
+    int spin = 0;
+
+    while (!req->complete) {
+        if (ahci_can_sleep(ctrl)) {
+            /* Checked under the lock so the interrupt cannot slip in between */
+            uint64_t flags = ahci_lock(info);
+            if (!req->complete) {
+                req->waiter = process_get_current();
+                process_set_state(req->waiter, PROCESS_STATE_BLOCKED);
+            }
+            ahci_unlock(info, flags);
+            scheduler_yield();
+            continue;
+        }
+
+        /* No interrupt to rely on: reap completions here */
+        uint64_t flags = ahci_lock(info);
+        ahci_request_t* list = ahci_port_reap(ctrl, port_num);
+        if (!req->complete && !list && ++spin >= AHCI_CMD_TIMEOUT * 1000) {
+            kprintf("[AHCI] Command timeout on port %d\n", port_num);
+            list = ahci_port_abort(ctrl, port_num, AHCI_ERR_TIMEOUT, NULL);
+            spin = 0;
+        }
+        ahci_unlock(info, flags);
+        ahci_finish(list);
+
+        if (!req->complete) {
+            ahci_delay(1);
+        }
+    }
+
+    return req->status;
+}
+
+/**
+ * Submit a request and wait for it
+ */
+static int ahci_do_request(ahci_controller_t* ctrl, int port_num, ahci_request_t* req) {
+    int result = ahci_submit_ctrl(ctrl, port_num, req);
+    if (result != AHCI_SUCCESS) {
+        return result;
+    }
+    return ahci_wait_ctrl(ctrl, port_num, req);
+}
+
+/**
+ * Issue IDENTIFY on a port of a known controller
+ */
+static int ahci_identify_ctrl(ahci_controller_t* ctrl, int port_num, void* buf) {
+    ahci_request_t req;
+    ahci_memset(&req, 0, sizeof(req));
+    req.op = AHCI_OP_IDENTIFY;
+    req.buf = buf;
+
+    return ahci_do_request(ctrl, port_num, &req);
 }
 
 /* ============================================================================
@@ -444,11 +943,13 @@ static int ahci_init_controller(pci_device_t* pci_dev) {
     ctrl->num_ports = (cap & AHCI_CAP_NP_MASK) + 1;
     ctrl->num_cmd_slots = ((cap & AHCI_CAP_NCS_MASK) >> AHCI_CAP_NCS_SHIFT) + 1;
     ctrl->supports_64bit = (cap & AHCI_CAP_S64A) != 0;
+    ctrl->supports_ncq = (cap & AHCI_CAP_SNCQ) != 0;
     ctrl->ports_impl = ctrl->hba->pi;
 
-    kprintf("[AHCI] Capabilities: %d ports, %d cmd slots, 64-bit=%s\n",
+    kprintf("[AHCI] Capabilities: %d ports, %d cmd slots, 64-bit=%s, NCQ=%s\n",
             ctrl->num_ports, ctrl->num_cmd_slots,
-            ctrl->supports_64bit ? "yes" : "no");
+            ctrl->supports_64bit ? "yes" : "no",
+            ctrl->supports_ncq ? "yes" : "no");
     kprintf("[AHCI] Ports implemented: 0x%08x\n", ctrl->ports_impl);
 
     /* Print version */
@@ -519,7 +1020,7 @@ static int ahci_init_controller(pci_device_t* pci_dev) {
                             void* id_buf = (void*)(VMM_KERNEL_PHYS_MAP + id_phys);
                             ahci_memset(id_buf, 0, 512);
 
-                            if (ahci_identify(i, id_buf) == AHCI_SUCCESS) {
+                            if (ahci_identify_ctrl(ctrl, i, id_buf) == AHCI_SUCCESS) {
                                 uint16_t* id = (uint16_t*)id_buf;
 
                                 /* Get model string (words 27-46) */
@@ -541,11 +1042,23 @@ static int ahci_init_controller(pci_device_t* pci_dev) {
                                         ((uint32_t)id[61] << 16) | id[60];
                                 }
 
+                                /* Queue reads and writes if both ends support NCQ */
+                                if (ctrl->supports_ncq && (id[ATA_ID_SATA_CAP] & ATA_ID_SATA_CAP_NCQ)) {
+                                    ctrl->port_info[i].ncq = true;
+                                    ctrl->port_info[i].queue_depth =
+                                        MIN((uint32_t)(id[ATA_ID_QUEUE_DEPTH] & 0x1F) + 1,
+                                            ctrl->num_cmd_slots);
+                                }
+
                                 uint64_t size_mb = (ctrl->port_info[i].sector_count * 512) / (1024 * 1024);
                                 kprintf("[AHCI] Port %d: Model: %s\n", i, ctrl->port_info[i].model);
                                 kprintf("[AHCI] Port %d: Serial: %s\n", i, ctrl->port_info[i].serial);
                                 kprintf("[AHCI] Port %d: Capacity: %llu MB (%llu sectors)\n",
                                         i, size_mb, ctrl->port_info[i].sector_count);
+                                if (ctrl->port_info[i].ncq) {
+                                    kprintf("[AHCI] Port %d: NCQ, queue depth %u\n",
+                                            i, ctrl->port_info[i].queue_depth);
+                                }
                             }
 
                             pmm_free_page(id_phys);
@@ -561,6 +1074,9 @@ static int ahci_init_controller(pci_device_t* pci_dev) {
     kprintf("[AHCI] Controller initialized with %d device(s)\n", devices_found);
     ahci_controller_count++;
 
+    /* Identification above was polled; from here on completions interrupt */
+    ahci_enable_irq(ctrl);
+
     return devices_found;
 }
 
@@ -588,6 +1104,7 @@ int ahci_init(void) {
     } else {
         kprintf("[AHCI] Found %d AHCI controller(s) with %d device(s)\n",
                 ahci_controller_count, total_devices);
+        ahci_register_block_devices();
     }
 
     return ahci_controller_count;
@@ -631,92 +1148,118 @@ int ahci_identify(int port, void* buf) {
     }
 
     /* Find controller with this port */
-    ahci_controller_t* ctrl = NULL;
-    for (int i = 0; i < ahci_controller_count; i++) {
-        if (ahci_controllers[i].ports_impl & (1 << port)) {
-            ctrl = &ahci_controllers[i];
-            break;
-        }
-    }
-
+    ahci_controller_t* ctrl = ahci_find_controller(port);
     if (!ctrl || !ctrl->port_info[port].present) {
         return AHCI_ERR_NO_DEVICE;
     }
 
-    /* Build IDENTIFY DEVICE command */
-    ahci_fis_reg_h2d_t fis;
-    ahci_memset(&fis, 0, sizeof(fis));
-    fis.fis_type = FIS_TYPE_REG_H2D;
-    fis.c = 1;  /* This is a command */
-    fis.command = (ctrl->port_info[port].type == AHCI_DEV_SATAPI)
-                  ? ATA_CMD_IDENTIFY_PACKET : ATA_CMD_IDENTIFY;
-    fis.device = 0;
-
-    /* Issue command */
-    return ahci_issue_cmd(ctrl, port, &fis, buf, 512, 0);
+    return ahci_identify_ctrl(ctrl, port, buf);
 }
 
-int ahci_read_sectors(int port, uint64_t lba, uint32_t count, void* buf) {
-    if (port < 0 || port >= AHCI_MAX_PORTS || !buf || count == 0) {
-        return AHCI_ERR_INVALID_PORT;
-    }
-
-    if (count > 65535) {
-        kprintf("[AHCI] Read count %u exceeds maximum of 65535\n", count);
+int ahci_submit(int port, ahci_request_t* req) {
+    if (port < 0 || port >= AHCI_MAX_PORTS || !req) {
         return AHCI_ERR_INVALID_PORT;
     }
 
     /* Find controller with this port */
-    ahci_controller_t* ctrl = NULL;
-    for (int i = 0; i < ahci_controller_count; i++) {
-        if (ahci_controllers[i].ports_impl & (1 << port)) {
-            ctrl = &ahci_controllers[i];
-            break;
-        }
-    }
-
+    ahci_controller_t* ctrl = ahci_find_controller(port);
     if (!ctrl || !ctrl->port_info[port].present) {
         return AHCI_ERR_NO_DEVICE;
     }
 
-    if (ctrl->port_info[port].type != AHCI_DEV_SATA) {
+    if (req->op != AHCI_OP_IDENTIFY && ctrl->port_info[port].type != AHCI_DEV_SATA) {
         return AHCI_ERR_UNSUPPORTED;
     }
 
-    kprintf("[AHCI] Reading %u sectors from LBA %llu on port %d\n", count, lba, port);
+    if (req->op == AHCI_OP_READ || req->op == AHCI_OP_WRITE) {
+        if (req->count == 0 || req->count > 65535) {
+            return AHCI_ERR_INVALID_PORT;
+        }
 
-    /* Build READ DMA EXT command */
-    ahci_fis_reg_h2d_t fis;
-    ahci_memset(&fis, 0, sizeof(fis));
-    fis.fis_type = FIS_TYPE_REG_H2D;
-    fis.c = 1;  /* Command */
-    fis.command = ATA_CMD_READ_DMA_EXT;
+        ahci_sg_t whole = { req->buf, req->count * AHCI_SECTOR_SIZE };
+        const ahci_sg_t* sg = &whole;
+        uint32_t sg_count = 1;
 
-    /* LBA mode, 48-bit addressing */
-    fis.device = 1 << 6;  /* LBA mode */
+        if (req->sg_count > 0) {
+            /* Segments must add up to the transfer */
+            uint64_t bytes = 0;
+            if (!req->sg) {
+                return AHCI_ERR_INVALID_PORT;
+            }
+            for (uint32_t i = 0; i < req->sg_count; i++) {
+                if (!req->sg[i].buf || req->sg[i].size == 0 || (req->sg[i].size & 1)) {
+                    return AHCI_ERR_INVALID_PORT;
+                }
+                bytes += req->sg[i].size;
+            }
+            if (bytes != (uint64_t)req->count * AHCI_SECTOR_SIZE) {
+                return AHCI_ERR_INVALID_PORT;
+            }
+            sg = req->sg;
+            sg_count = req->sg_count;
+        } else if (!req->buf) {
+            return AHCI_ERR_INVALID_PORT;
+        }
 
-    /* Set LBA */
-    fis.lba0 = (uint8_t)(lba & 0xFF);
-    fis.lba1 = (uint8_t)((lba >> 8) & 0xFF);
-    fis.lba2 = (uint8_t)((lba >> 16) & 0xFF);
-    fis.lba3 = (uint8_t)((lba >> 24) & 0xFF);
-    fis.lba4 = (uint8_t)((lba >> 32) & 0xFF);
-    fis.lba5 = (uint8_t)((lba >> 40) & 0xFF);
+        /* Every page must be mapped and the whole list must fit the PRDT */
+        if (ahci_prdt_walk(sg, sg_count, NULL) < 0) {
+            kprintf("[AHCI] Buffer for LBA %llu cannot be mapped for DMA\n", req->lba);
+            return AHCI_ERR_INVALID_PORT;
+        }
+    } else if (req->op == AHCI_OP_IDENTIFY) {
+        ahci_sg_t whole = { req->buf, AHCI_SECTOR_SIZE };
+        if (!req->buf || ahci_prdt_walk(&whole, 1, NULL) < 0) {
+            return AHCI_ERR_INVALID_PORT;
+        }
+    }
 
-    /* Set sector count */
-    fis.countl = (uint8_t)(count & 0xFF);
-    fis.counth = (uint8_t)((count >> 8) & 0xFF);
+    TRACE(TRACE_AHCI, TRACE_AHCI_SUBMIT, port, req->op, req->lba, req->count);
+    return ahci_submit_ctrl(ctrl, port, req);
+}
 
-    /* Issue command */
-    int result = ahci_issue_cmd(ctrl, port, &fis, buf, count * AHCI_SECTOR_SIZE, 0);
+int ahci_wait(int port, ahci_request_t* req) {
+    if (port < 0 || port >= AHCI_MAX_PORTS || !req) {
+        return AHCI_ERR_INVALID_PORT;
+    }
 
-    if (result == AHCI_SUCCESS) {
-        kprintf("[AHCI] Read completed successfully\n");
-    } else {
-        kprintf("[AHCI] Read failed with error %d\n", result);
+    ahci_controller_t* ctrl = ahci_find_controller(port);
+    if (!ctrl) {
+        return AHCI_ERR_NO_DEVICE;
     }
 
-    return result;
+    return ahci_wait_ctrl(ctrl, port, req);
+}
+
+/**
+ * Submit a read or write and wait for it
+ */
+static int ahci_rw_sectors(int port, ahci_op_t op, uint64_t lba, uint32_t count, void* buf) {
+    ahci_request_t req;
+    ahci_memset(&req, 0, sizeof(req));
+    req.op = op;
+    req.lba = lba;
+    req.count = count;
+    req.buf = buf;
+
+    int result = ahci_submit(port, &req);
+    if (result != AHCI_SUCCESS) {
+        return result;
+    }
+
+    return ahci_wait(port, &req);
+}
+
+int ahci_read_sectors(int port, uint64_t lba, uint32_t count, void* buf) {
+    if (port < 0 || port >= AHCI_MAX_PORTS || !buf || count == 0) {
+        return AHCI_ERR_INVALID_PORT;
+    }
+
+    if (count > 65535) {
+        kprintf("[AHCI] Read count %u exceeds maximum of 65535\n", count);
+        return AHCI_ERR_INVALID_PORT;
+    }
+
+    return ahci_rw_sectors(port, AHCI_OP_READ, lba, count, buf);
 }
 
 int ahci_write_sectors(int port, uint64_t lba, uint32_t count, const void* buf) {
@@ -729,92 +1272,133 @@ int ahci_write_sectors(int port, uint64_t lba, uint32_t count, const void* buf)
         return AHCI_ERR_INVALID_PORT;
     }
 
-    /* Find controller with this port */
-    ahci_controller_t* ctrl = NULL;
-    for (int i = 0; i < ahci_controller_count; i++) {
-        if (ahci_controllers[i].ports_impl & (1 << port)) {
-            ctrl = &ahci_controllers[i];
-            break;
-        }
+    return ahci_rw_sectors(port, AHCI_OP_WRITE, lba, count, (void*)buf);
+}
+
+/**
+ * Submit a scatter-gather read or write and wait for it
+ */
+static int ahci_rw_vec(int port, ahci_op_t op, uint64_t lba,
+                       const ahci_sg_t* sg, uint32_t sg_count) {
+    if (!sg || sg_count == 0) {
+        return AHCI_ERR_INVALID_PORT;
     }
 
-    if (!ctrl || !ctrl->port_info[port].present) {
-        return AHCI_ERR_NO_DEVICE;
+    uint64_t bytes = 0;
+    for (uint32_t i = 0; i < sg_count; i++) {
+        bytes += sg[i].size;
+    }
+    if (bytes == 0 || bytes % AHCI_SECTOR_SIZE != 0 ||
+        bytes / AHCI_SECTOR_SIZE > 65535) {
+        return AHCI_ERR_INVALID_PORT;
     }
 
-    if (ctrl->port_info[port].type != AHCI_DEV_SATA) {
-        return AHCI_ERR_UNSUPPORTED;
+    ahci_request_t req;
+    ahci_memset(&req, 0, sizeof(req));
+    req.op = op;
+    req.lba = lba;
+    req.count = (uint32_t)(bytes / AHCI_SECTOR_SIZE);
+    req.sg = sg;
+    req.sg_count = sg_count;
+
+    int result = ahci_submit(port, &req);
+    if (result != AHCI_SUCCESS) {
+        return result;
     }
 
-    kprintf("[AHCI] Writing %u sectors to LBA %llu on port %d\n", count, lba, port);
+    return ahci_wait(port, &req);
+}
 
-    /* Build WRITE DMA EXT command */
-    ahci_fis_reg_h2d_t fis;
-    ahci_memset(&fis, 0, sizeof(fis));
-    fis.fis_type = FIS_TYPE_REG_H2D;
-    fis.c = 1;  /* Command */
-    fis.command = ATA_CMD_WRITE_DMA_EXT;
+int ahci_readv(int port, uint64_t lba, const ahci_sg_t* sg, uint32_t sg_count) {
+    return ahci_rw_vec(port, AHCI_OP_READ, lba, sg, sg_count);
+}
 
-    /* LBA mode, 48-bit addressing */
-    fis.device = 1 << 6;  /* LBA mode */
+int ahci_writev(int port, uint64_t lba, const ahci_sg_t* sg, uint32_t sg_count) {
+    return ahci_rw_vec(port, AHCI_OP_WRITE, lba, sg, sg_count);
+}
 
-    /* Set LBA */
-    fis.lba0 = (uint8_t)(lba & 0xFF);
-    fis.lba1 = (uint8_t)((lba >> 8) & 0xFF);
-    fis.lba2 = (uint8_t)((lba >> 16) & 0xFF);
-    fis.lba3 = (uint8_t)((lba >> 24) & 0xFF);
-    fis.lba4 = (uint8_t)((lba >> 32) & 0xFF);
-    fis.lba5 = (uint8_t)((lba >> 40) & 0xFF);
+int ahci_flush(int port) {
+    if (port < 0 || port >= AHCI_MAX_PORTS) {
+        return AHCI_ERR_INVALID_PORT;
+    }
 
-    /* Set sector count */
-    fis.countl = (uint8_t)(count & 0xFF);
-    fis.counth = (uint8_t)((count >> 8) & 0xFF);
+    TRACE(TRACE_AHCI, TRACE_AHCI_FLUSH, port, 0, 0, 0);
 
-    /* Issue command (write direction) */
-    int result = ahci_issue_cmd(ctrl, port, &fis, (void*)buf, count * AHCI_SECTOR_SIZE, 1);
+    ahci_request_t req;
+    ahci_memset(&req, 0, sizeof(req));
+    req.op = AHCI_OP_FLUSH;
 
-    if (result == AHCI_SUCCESS) {
-        kprintf("[AHCI] Write completed successfully\n");
-    } else {
-        kprintf("[AHCI] Write failed with error %d\n", result);
+    int result = ahci_submit(port, &req);
+    if (result != AHCI_SUCCESS) {
+        return result;
     }
 
-    return result;
+    return ahci_wait(port, &req);
 }
 
-int ahci_flush(int port) {
-    if (port < 0 || port >= AHCI_MAX_PORTS) {
-        return AHCI_ERR_INVALID_PORT;
+uint32_t ahci_benchmark(int port, uint32_t depth, uint32_t requests) {
+    ahci_port_info_t* info = ahci_get_port_info(port);
+    if (!info || info->type != AHCI_DEV_SATA || info->sector_count < 8 ||
+        depth == 0 || depth > AHCI_MAX_CMD_SLOTS || requests == 0) {
+        return 0;
     }
 
-    /* Find controller with this port */
-    ahci_controller_t* ctrl = NULL;
-    for (int i = 0; i < ahci_controller_count; i++) {
-        if (ahci_controllers[i].ports_impl & (1 << port)) {
-            ctrl = &ahci_controllers[i];
-            break;
+    ahci_request_t reqs[AHCI_MAX_CMD_SLOTS];
+    physaddr_t pages[AHCI_MAX_CMD_SLOTS];
+    uint64_t blocks = info->sector_count / 8;
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+    uint32_t issued = 0, completed = 0, failed = 0;
+
+    for (uint32_t i = 0; i < depth; i++) {
+        pages[i] = pmm_alloc_page();
+        if (!pages[i]) {
+            while (i--) {
+                pmm_free_page(pages[i]);
+            }
+            return 0;
         }
     }
 
-    if (!ctrl || !ctrl->port_info[port].present) {
-        return AHCI_ERR_NO_DEVICE;
-    }
+    uint64_t start = pit_get_uptime_ms();
 
-    if (ctrl->port_info[port].type != AHCI_DEV_SATA) {
-        return AHCI_ERR_UNSUPPORTED;
+    /* Keep depth random 4 KB reads in flight, refilling slots in turn */
+    for (uint32_t i = 0; i < depth + requests; i++) {
+        ahci_request_t* req = &reqs[i % depth];
+
+        if (i >= depth) {
+            if (ahci_wait(port, req) != AHCI_SUCCESS) {
+                failed++;
+            }
+            completed++;
+        }
+
+        if (issued < requests) {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+
+            ahci_memset(req, 0, sizeof(*req));
+            req->op = AHCI_OP_READ;
+            req->lba = ((seed >> 16) % blocks) * 8;
+            req->count = 8;
+            req->buf = (void*)(VMM_KERNEL_PHYS_MAP + pages[i % depth]);
+            if (ahci_submit(port, req) != AHCI_SUCCESS) {
+                break;
+            }
+            issued++;
+        } else if (completed == issued) {
+            break;
+        }
     }
 
-    kprintf("[AHCI] Flushing cache on port %d\n", port);
+    uint64_t elapsed = pit_get_uptime_ms() - start;
 
-    /* Build FLUSH CACHE EXT command */
-    ahci_fis_reg_h2d_t fis;
-    ahci_memset(&fis, 0, sizeof(fis));
-    fis.fis_type = FIS_TYPE_REG_H2D;
-    fis.c = 1;  /* Command */
-    fis.command = ATA_CMD_FLUSH_CACHE_EXT;
+    for (uint32_t i = 0; i < depth; i++) {
+        pmm_free_page(pages[i]);
+    }
 
-    /* Issue command (no data transfer) */
-    return ahci_issue_cmd(ctrl, port, &fis, NULL, 0, 0);
+    uint32_t iops = (uint32_t)((uint64_t)completed * 1000 / MAX(elapsed, 1));
+    kprintf("[AHCI] Port %d: QD%u, %u reads (%u failed) in %llu ms: %u IOPS\n",
+            port, depth, completed, failed, elapsed, iops);
+    return iops;
 }
 
 int ahci_get_controller_count(void) {
@@ -827,3 +1411,161 @@ ahci_controller_t* ahci_get_controller(int index) {
     }
     return &ahci_controllers[index];
 }
+
+/* ============================================================================
+ * Block Device Integration
+ * ============================================================================ */
+
+/*
+ * block_ops_t adapter: the device cookie is the port number.
+ */
+static int ahci_blk_read(void* device, uint64_t lba, uint32_t count, void* buffer) {
+    return ahci_read_sectors((int)(uintptr_t)device, lba, count, buffer);
+}
+
+static int ahci_blk_write(void* device, uint64_t lba, uint32_t count, const void* buffer) {
+    return ahci_write_sectors((int)(uintptr_t)device, lba, count, buffer);
+}
+
+static int ahci_blk_flush(void* device) {
+    return ahci_flush((int)(uintptr_t)device);
+}
+
+/*
+ * Requests from the block layer. Each port has one descriptor per request
+ * the block queue may have in flight; every bio becomes a data segment.
+ */
+typedef struct {
+    ahci_request_t req;
+    ahci_sg_t sg[BLK_MAX_SEGMENTS];
+    blk_request_t* rq;
+    volatile int in_use;
+} ahci_blk_req_t;
+
+static ahci_blk_req_t* ahci_blk_pool[AHCI_MAX_PORTS];
+
+static void ahci_blk_done(ahci_request_t* req) {
+    ahci_blk_req_t* br = (ahci_blk_req_t*)req->private;
+    blk_request_t* rq = br->rq;
+    int status = (req->status == AHCI_SUCCESS) ? BLKDEV_SUCCESS : BLKDEV_ERR_IO;
+
+    __sync_lock_release(&br->in_use);
+    blk_end_request(rq, status);
+}
+
+static int ahci_blk_submit(void* device, blk_request_t* rq) {
+    int port = (int)(uintptr_t)device;
+    ahci_blk_req_t* pool = ahci_blk_pool[port];
+    ahci_blk_req_t* br = NULL;
+
+    for (int i = 0; pool && i < BLK_QUEUE_DEPTH; i++) {
+        if (!__sync_lock_test_and_set(&pool[i].in_use, 1)) {
+            br = &pool[i];
+            break;
+        }
+    }
+    if (!br) {
+        return AHCI_ERR_NO_MEMORY;
+    }
+
+    /* One segment per bio, joining bios whose buffers are adjacent;
+     * the PRDT is built from the segments' pages */
+    uint32_t n = 0;
+    for (bio_t* bio = rq->bio; bio; bio = bio->next) {
+        uint32_t size = bio->count * AHCI_SECTOR_SIZE;
+
+        if (n > 0 &&
+            (uint8_t*)br->sg[n - 1].buf + br->sg[n - 1].size == (uint8_t*)bio->buf) {
+            br->sg[n - 1].size += size;
+        } else {
+            br->sg[n].buf = bio->buf;
+            br->sg[n].size = size;
+            n++;
+        }
+    }
+
+    ahci_memset(&br->req, 0, sizeof(br->req));
+    br->req.op = (rq->op == BIO_WRITE) ? AHCI_OP_WRITE : AHCI_OP_READ;
+    br->req.lba = rq->lba;
+    br->req.count = rq->count;
+    br->req.sg = br->sg;
+    br->req.sg_count = n;
+    br->req.done = ahci_blk_done;
+    br->req.private = br;
+    br->rq = rq;
+
+    int result = ahci_submit(port, &br->req);
+    if (result != AHCI_SUCCESS) {
+        __sync_lock_release(&br->in_use);
+    }
+    return result;
+}
+
+static bool ahci_blk_poll(void* device) {
+    int port = (int)(uintptr_t)device;
+    ahci_controller_t* ctrl = ahci_find_controller(port);
+    if (!ctrl) {
+        return false;
+    }
+
+    ahci_port_info_t* info = &ctrl->port_info[port];
+    uint64_t flags = ahci_lock(info);
+    ahci_request_t* list = ahci_port_reap(ctrl, port);
+    ahci_unlock(info, flags);
+    ahci_finish(list);
+
+    return !ctrl->irq_enabled;
+}
+
+#if BLK_MAX_SEGMENTS > AHCI_MAX_PRDT_ENTRIES
+#error "Block layer requests may have more segments than the PRDT holds"
+#endif
+
+static block_ops_t ahci_block_ops = {
+    .read_sectors   = ahci_blk_read,
+    .write_sectors  = ahci_blk_write,
+    .flush          = ahci_blk_flush,
+    .submit         = ahci_blk_submit,
+    .poll           = ahci_blk_poll,
+};
+
+/* Used if a port's request descriptors cannot be allocated */
+static block_ops_t ahci_block_ops_sync = {
+    .read_sectors   = ahci_blk_read,
+    .write_sectors  = ahci_blk_write,
+    .flush          = ahci_blk_flush,
+};
+
+int ahci_register_block_devices(void) {
+    int registered = 0;
+
+    for (int port = 0; port < AHCI_MAX_PORTS; port++) {
+        ahci_port_info_t* info = ahci_get_port_info(port);
+        if (!info || info->type != AHCI_DEV_SATA) {
+            continue;
+        }
+
+        char name[BLKDEV_NAME_MAX] = "sata";
+        int len = 4;
+        if (port >= 10) {
+            name[len++] = (char)('0' + port / 10);
+        }
+        name[len++] = (char)('0' + port % 10);
+        name[len] = '\0';
+
+        if (blkdev_find(name)) {
+            continue;
+        }
+
+        if (!ahci_blk_pool[port]) {
+            ahci_blk_pool[port] = kcalloc(BLK_QUEUE_DEPTH, sizeof(ahci_blk_req_t));
+        }
+        block_ops_t* ops = ahci_blk_pool[port] ? &ahci_block_ops : &ahci_block_ops_sync;
+
+        if (blkdev_register(name, ops, (void*)(uintptr_t)port, info->sector_count)) {
+            registered++;
+        }
+    }
+
+    return registered;
+}
@@ -125,6 +125,13 @@
 #define ATA_CMD_IDENTIFY        0xEC    /* Identify Device */
 #define ATA_CMD_IDENTIFY_PACKET 0xA1    /* Identify Packet Device (ATAPI) */
 #define ATA_CMD_FLUSH_CACHE_EXT 0xEA    /* Flush Cache Extended */
+#define ATA_CMD_READ_FPDMA_QUEUED   0x60    /* NCQ read */
+#define ATA_CMD_WRITE_FPDMA_QUEUED  0x61    /* NCQ write */
+
+/* IDENTIFY DEVICE words used for NCQ */
+#define ATA_ID_QUEUE_DEPTH      75      /* Bits 4:0 = maximum queue depth - 1 */
+#define ATA_ID_SATA_CAP         76      /* Serial ATA capabilities */
+#define ATA_ID_SATA_CAP_NCQ     (1 << 8)    /* Supports NCQ */
 
 /* ATA device types */
 typedef enum {
@@ -419,8 +426,64 @@ typedef struct PACKED ALIGNED(128) {
     ahci_prdt_entry_t prdt_entry[]; /* Physical Region Descriptor Table */
 } ahci_cmd_table_t;
 
-/* Maximum PRD entries per command (can be up to 65535) */
-#define AHCI_MAX_PRDT_ENTRIES   8
+/* Maximum PRD entries per command (can be up to 65535); fills the page-sized table */
+#define AHCI_MAX_PRDT_ENTRIES   248
+
+/* Largest data region a single PRD entry can describe */
+#define AHCI_PRDT_MAX_BYTES     0x400000
+
+/**
+ * Request operations
+ */
+typedef enum {
+    AHCI_OP_READ = 0,               /* Read sectors */
+    AHCI_OP_WRITE,                  /* Write sectors */
+    AHCI_OP_FLUSH,                  /* Flush the drive's write cache */
+    AHCI_OP_IDENTIFY                /* IDENTIFY (PACKET) DEVICE, 512 bytes */
+} ahci_op_t;
+
+struct ahci_request;
+struct process;
+
+/**
+ * Data segment of a scatter-gather request
+ * Segments are kernel virtual buffers (physical map, heap or any mapped
+ * page); the PRDT is built from their pages, so they need not be
+ * physically contiguous.
+ */
+typedef struct {
+    void* buf;                      /* Segment start (word aligned) */
+    uint32_t size;                  /* Bytes (even) */
+} ahci_sg_t;
+
+/**
+ * Request completion callback
+ * Runs in interrupt context, or in the thread that reaped the completion
+ * when the port is polled. It must not block.
+ */
+typedef void (*ahci_done_t)(struct ahci_request* req);
+
+/**
+ * I/O request
+ * A submitted request belongs to the driver until it completes; the
+ * callback (if any) is the last time the driver touches it.
+ */
+typedef struct ahci_request {
+    ahci_op_t op;                   /* Operation */
+    uint64_t lba;                   /* Starting sector (read/write) */
+    uint32_t count;                 /* Sector count (read/write, max 65535) */
+    void* buf;                      /* Data buffer (kernel virtual) */
+    const ahci_sg_t* sg;            /* Data segments, used instead of buf if sg_count */
+    uint32_t sg_count;              /* Number of segments */
+    ahci_done_t done;               /* Completion callback (optional) */
+    void* private;                  /* Caller cookie for the callback */
+    int status;                     /* Result, valid once complete */
+
+    /* Driver bookkeeping */
+    volatile bool complete;         /* Request has finished */
+    struct process* waiter;         /* Thread sleeping on the request */
+    struct ahci_request* next;      /* Pending queue link */
+} ahci_request_t;
 
 /**
  * Per-port driver state
@@ -434,6 +497,17 @@ typedef struct {
     uint64_t sector_count;          /* Total sectors (from IDENTIFY) */
     char model[41];                 /* Model string (from IDENTIFY) */
     char serial[21];                /* Serial number (from IDENTIFY) */
+
+    /* Command queuing */
+    bool ncq;                       /* Reads/writes use FPDMA QUEUED */
+    uint32_t queue_depth;           /* Command slots in use for this port */
+    uint32_t outstanding;           /* Slots issued to the HBA */
+    bool exclusive;                 /* A non-queued command owns the port */
+    ahci_request_t* slot_req[AHCI_MAX_CMD_SLOTS]; /* Request in each slot */
+    ahci_request_t* pending_head;   /* Requests waiting for a slot */
+    ahci_request_t* pending_tail;
+    uint32_t stall_ticks;           /* Timer ticks since the last completion */
+    volatile int lock;              /* Protects the queue state */
 } ahci_port_info_t;
 
 /**
@@ -446,6 +520,9 @@ typedef struct {
     uint32_t num_ports;             /* Number of implemented ports */
     uint32_t num_cmd_slots;         /* Number of command slots */
     bool supports_64bit;            /* 64-bit DMA addressing */
+    bool supports_ncq;              /* HBA supports NCQ */
+    uint8_t irq;                    /* Legacy IRQ line */
+    bool irq_enabled;               /* Completions are interrupt driven */
     ahci_port_info_t port_info[AHCI_MAX_PORTS]; /* Per-port info */
 } ahci_controller_t;
 
@@ -494,6 +571,57 @@ int ahci_read_sectors(int port, uint64_t lba, uint32_t count, void* buf);
  */
 int ahci_write_sectors(int port, uint64_t lba, uint32_t count, const void* buf);
 
+/**
+ * Read consecutive sectors into a list of buffers (scatter)
+ * Data is transferred directly into the buffers' pages.
+ * @param port Port number
+ * @param lba Starting Logical Block Address
+ * @param sg Buffers, filled in order (sizes must add up to whole sectors)
+ * @param sg_count Number of buffers
+ * @return 0 on success, negative error code on failure
+ */
+int ahci_readv(int port, uint64_t lba, const ahci_sg_t* sg, uint32_t sg_count);
+
+/**
+ * Write consecutive sectors from a list of buffers (gather)
+ * @param port Port number
+ * @param lba Starting Logical Block Address
+ * @param sg Buffers, written in order (sizes must add up to whole sectors)
+ * @param sg_count Number of buffers
+ * @return 0 on success, negative error code on failure
+ */
+int ahci_writev(int port, uint64_t lba, const ahci_sg_t* sg, uint32_t sg_count);
+
+/**
+ * Submit a request without waiting for it
+ * Reads and writes on NCQ drives are queued up to the drive's queue depth;
+ * other commands wait until the port is idle and run alone. Requests that
+ * find no free slot are issued as earlier ones complete.
+ * @param port Port number
+ * @param req Request (op, lba, count, buf or sg, done and private filled in)
+ * @return 0 if the request was accepted, negative error code otherwise
+ */
+int ahci_submit(int port, ahci_request_t* req);
+
+/**
+ * Wait for a submitted request to finish
+ * Sleeps until the completion interrupt when the scheduler is running,
+ * otherwise polls the port.
+ * @param port Port number
+ * @param req Request passed to ahci_submit (without a callback)
+ * @return Request status
+ */
+int ahci_wait(int port, ahci_request_t* req);
+
+/**
+ * Measure random 4 KB read throughput at a given queue depth
+ * @param port Port number
+ * @param depth Requests kept in flight (1-32)
+ * @param requests Total requests to issue
+ * @return Completed I/O operations per second, 0 on failure
+ */
+uint32_t ahci_benchmark(int port, uint32_t depth, uint32_t requests);
+
 /**
  * Get drive identification data (ATA IDENTIFY command)
  * @param port Port number
@@ -522,6 +650,14 @@ int ahci_get_controller_count(void);
  */
 ahci_controller_t* ahci_get_controller(int index);
 
+/**
+ * Register every present SATA drive with the block device layer
+ * Drives are named "sata<port>" and accessed through the buffer cache.
+ * Called by ahci_init.
+ * @return Number of block devices registered
+ */
+int ahci_register_block_devices(void);
+
 /* Error codes */
 #define AHCI_SUCCESS            0
 #define AHCI_ERR_NO_DEVICE      (-1)    /* No device on port */
@@ -0,0 +1,910 @@
+/**
+ * AAAos Kernel - Block Buffer Cache
+ *
+ * Implementation of the block-layer buffer cache.
+ */
+
+#include "bcache.h"
+#include "bio.h"
+#include "../../kernel/include/serial.h"
+#include "../../kernel/mm/pmm.h"
+#include "../../kernel/mm/vmm.h"
+#include "../../kernel/arch/x86_64/include/idt.h"
+#include "../../kernel/proc/process.h"
+#include "../../kernel/sched/scheduler.h"
+#include "../timer/pit.h"
+
+/* RFLAGS interrupt enable bit */
+#define BCACHE_RFLAGS_IF    (1 << 9)
+
+/**
+ * Cache block descriptor
+ */
+typedef struct bcache_buf {
+    block_device_t      *dev;           /* Owning device (NULL if free) */
+    uint64_t            block;          /* Block number on device */
+    uint8_t             *data;          /* Block data (kernel virtual) */
+    uint64_t            dirty_since;    /* Uptime (ms) when first dirtied */
+    uint32_t            nsect;          /* Sectors held (short at device end) */
+    bool                dirty;          /* Data differs from device */
+    bool                referenced;     /* CLOCK reference bit */
+    bool                loading;        /* Read in flight, data not valid yet */
+    bool                writing;        /* Write-back in flight, data must not change */
+    bool                waited;         /* A thread sleeps in bio_wait() on the read */
+    bio_t               bio;            /* Device I/O for this block */
+    struct bcache_buf   *hash_next;     /* Next in hash chain */
+} bcache_buf_t;
+
+/* Global state */
+static bcache_buf_t bcache_bufs[BCACHE_MAX_BLOCKS];
+static bcache_buf_t *bcache_hash[BCACHE_HASH_BUCKETS];
+static uint32_t bcache_nblocks = 0;
+static uint32_t bcache_hand = 0;
+static bool bcache_ready = false;
+static bool bcache_flusher_running = false;
+static bool bcache_writeback_active = false; /* A write-back pass is running */
+static int bcache_hook_running = -1;        /* Hook the flusher is calling */
+static bcache_stats_t bcache_stats;
+static uint32_t bcache_max_run = 1;        /* Blocks per read run */
+
+/* Write-back hooks, protected by bcache_lock */
+static struct {
+    bcache_hook_t   fn;
+    void            *ctx;
+} bcache_hooks[BCACHE_MAX_HOOKS];
+static volatile int bcache_lock = 0;
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================ */
+
+/**
+ * Acquire a spinlock
+ */
+static inline void spinlock_acquire(volatile int *lock) {
+    while (__sync_lock_test_and_set(lock, 1)) {
+        __asm__ __volatile__("pause");
+    }
+}
+
+/**
+ * Release a spinlock
+ */
+static inline void spinlock_release(volatile int *lock) {
+    __sync_lock_release(lock);
+}
+
+/**
+ * Simple memory copy
+ */
+static void bcache_memcpy(void *dest, const void *src, size_t size) {
+    uint8_t *d = (uint8_t *)dest;
+    const uint8_t *s = (const uint8_t *)src;
+    while (size--) {
+        *d++ = *s++;
+    }
+}
+
+/**
+ * Hash a (device, block) pair into a bucket index
+ */
+static inline uint32_t bcache_hash_fn(block_device_t *dev, uint64_t block) {
+    uint64_t h = ((uint64_t)(uintptr_t)dev >> 4) ^ (block * 0x9E3779B97F4A7C15ULL);
+    return (uint32_t)(h ^ (h >> 32)) & (BCACHE_HASH_BUCKETS - 1);
+}
+
+/**
+ * Number of sectors in a block, accounting for a short final block
+ */
+static uint32_t bcache_block_sectors(block_device_t *dev, uint64_t block) {
+    uint64_t first = block * BCACHE_SECTORS_PER_BLOCK;
+
+    if (dev->sector_count != 0 &&
+        first + BCACHE_SECTORS_PER_BLOCK > dev->sector_count) {
+        return (uint32_t)(dev->sector_count - first);
+    }
+    return BCACHE_SECTORS_PER_BLOCK;
+}
+
+/**
+ * Find a block in the hash, whether or not its data has arrived
+ * (lock must be held)
+ */
+static bcache_buf_t* bcache_find(block_device_t *dev, uint64_t block) {
+    bcache_buf_t *b = bcache_hash[bcache_hash_fn(dev, block)];
+
+    while (b) {
+        if (b->dev == dev && b->block == block) {
+            return b;
+        }
+        b = b->hash_next;
+    }
+    return NULL;
+}
+
+/**
+ * Remove a block from its hash chain and mark it free (lock must be held)
+ */
+static void bcache_release(bcache_buf_t *b) {
+    bcache_buf_t **pp = &bcache_hash[bcache_hash_fn(b->dev, b->block)];
+
+    while (*pp) {
+        if (*pp == b) {
+            *pp = b->hash_next;
+            break;
+        }
+        pp = &(*pp)->hash_next;
+    }
+
+    b->dev = NULL;
+    b->hash_next = NULL;
+    b->dirty = false;
+    b->referenced = false;
+    b->loading = false;
+    bcache_stats.used--;
+}
+
+/**
+ * Check whether the caller may yield the CPU
+ */
+static bool bcache_can_sleep(void) {
+    uint64_t flags;
+    __asm__ __volatile__("pushfq; pop %0" : "=r"(flags));
+
+    return (flags & BCACHE_RFLAGS_IF) && scheduler_is_running() &&
+           process_get_current() != NULL;
+}
+
+/**
+ * Let another thread finish its work on a block (lock held on entry and
+ * exit, dropped meanwhile; callers must look the block up again)
+ */
+static void bcache_relax(void) {
+    spinlock_release(&bcache_lock);
+    if (bcache_can_sleep()) {
+        scheduler_yield();
+    } else {
+        __asm__ __volatile__("pause");
+    }
+    spinlock_acquire(&bcache_lock);
+}
+
+/**
+ * Start reading a claimed block from its device (lock must be held)
+ */
+static int bcache_read_start(bcache_buf_t *b) {
+    bio_init(&b->bio, b->dev, BIO_READ, b->block * BCACHE_SECTORS_PER_BLOCK,
+             b->nsect, b->data);
+
+    int result = submit_bio(&b->bio);
+    if (result == BLKDEV_SUCCESS) {
+        b->loading = true;
+    }
+    return result;
+}
+
+/**
+ * Finish a block's read if the device has completed it (lock must be held)
+ * Whoever sees the completion first does this; a block whose read failed
+ * is dropped from the cache.
+ * @return BLKDEV_SUCCESS unless the read failed
+ */
+static int bcache_settle(bcache_buf_t *b) {
+    if (!b->loading || !b->bio.done) {
+        return BLKDEV_SUCCESS;
+    }
+
+    b->loading = false;
+    if (b->bio.status != BLKDEV_SUCCESS) {
+        kprintf("[BCACHE] Read of block %llu on %s failed (%d)\n",
+                b->block, b->dev->name, b->bio.status);
+        bcache_release(b);
+        return BLKDEV_ERR_IO;
+    }
+    return BLKDEV_SUCCESS;
+}
+
+/**
+ * Wait for a block's read (lock held on entry and exit, dropped meanwhile)
+ * A bio has room for one sleeper, so later waiters yield until the first
+ * one is done. CLOCK leaves a block alone while someone waits on it.
+ */
+static void bcache_wait_read(bcache_buf_t *b) {
+    if (b->waited) {
+        bcache_relax();
+        return;
+    }
+
+    b->waited = true;
+    spinlock_release(&bcache_lock);
+    bio_wait(&b->bio);
+    spinlock_acquire(&bcache_lock);
+    b->waited = false;
+}
+
+/**
+ * Find a cached block, waiting for it if it is still being read
+ * (lock held; dropped while waiting)
+ * @param result Set to BLKDEV_ERR_IO if the block's read failed
+ * @return Block with valid data, or NULL if not cached (or its read failed)
+ */
+static bcache_buf_t* bcache_lookup(block_device_t *dev, uint64_t block, int *result) {
+    for (;;) {
+        bcache_buf_t *b = bcache_find(dev, block);
+        if (!b || !b->loading) {
+            return b;
+        }
+
+        if (b->bio.done) {
+            if (bcache_settle(b) != BLKDEV_SUCCESS) {
+                *result = BLKDEV_ERR_IO;
+                return NULL;
+            }
+            return b;
+        }
+
+        /* The block may be gone or reused by the time we get the lock back */
+        bcache_wait_read(b);
+    }
+}
+
+/**
+ * Write back a device's dirty blocks of at least min_age_ms
+ * (lock held; dropped while the writes are in flight)
+ * The writes are queued under one plug so that adjacent blocks merge into
+ * large requests, and are then waited for together. Passes run one at a
+ * time, so every block marked writing belongs to the running pass; other
+ * threads leave those blocks' data alone until the pass clears the mark.
+ * @param result Set to BLKDEV_ERR_IO if any write fails
+ * @return Number of blocks written
+ */
+static uint32_t bcache_writeback_dev(block_device_t *dev, uint64_t now,
+                                     uint64_t min_age_ms, int *result) {
+    uint32_t queued = 0;
+    uint32_t written = 0;
+
+    while (bcache_writeback_active) {
+        bcache_relax();
+    }
+    bcache_writeback_active = true;
+
+    blk_plug(dev);
+    for (uint32_t i = 0; i < bcache_nblocks; i++) {
+        bcache_buf_t *b = &bcache_bufs[i];
+        if (b->dev != dev || !b->dirty || now - b->dirty_since < min_age_ms) {
+            continue;
+        }
+
+        bio_init(&b->bio, b->dev, BIO_WRITE, b->block * BCACHE_SECTORS_PER_BLOCK,
+                 b->nsect, b->data);
+        if (submit_bio(&b->bio) == BLKDEV_SUCCESS) {
+            b->writing = true;
+            queued++;
+        } else {
+            *result = BLKDEV_ERR_IO;
+        }
+    }
+    blk_unplug(dev);
+
+    for (uint32_t i = 0; i < bcache_nblocks && queued > 0; i++) {
+        bcache_buf_t *b = &bcache_bufs[i];
+        if (!b->writing) {
+            continue;
+        }
+
+        spinlock_release(&bcache_lock);
+        int status = bio_wait(&b->bio);
+        spinlock_acquire(&bcache_lock);
+
+        b->writing = false;
+        queued--;
+        if (status != BLKDEV_SUCCESS) {
+            kprintf("[BCACHE] Write-back of block %llu on %s failed (%d)\n",
+                    b->block, b->dev->name, status);
+            *result = BLKDEV_ERR_IO;
+            continue;
+        }
+
+        b->dirty = false;
+        bcache_stats.dirty--;
+        bcache_stats.writebacks++;
+        written++;
+    }
+
+    bcache_writeback_active = false;
+    return written;
+}
+
+/**
+ * Write back dirty blocks of every cached device
+ * (lock held; dropped while the writes are in flight)
+ * @param result Set to BLKDEV_ERR_IO if any write fails
+ * @return Number of blocks written
+ */
+static uint32_t bcache_writeback_all(uint64_t now, uint64_t min_age_ms, int *result) {
+    uint32_t written = 0;
+
+    for (int i = 0; i < BLKDEV_MAX_DEVICES && bcache_stats.dirty > 0; i++) {
+        block_device_t *d = blkdev_get(i);
+        if (d && d->cached) {
+            written += bcache_writeback_dev(d, now, min_age_ms, result);
+        }
+    }
+    return written;
+}
+
+/**
+ * Pick a victim block using CLOCK (lock must be held)
+ * Blocks with the reference bit set get a second chance. Blocks with I/O
+ * in flight and dirty blocks are skipped; bcache_make_room() cleans the
+ * latter when nothing else is left.
+ * @return Free block descriptor, or NULL if nothing could be reclaimed
+ */
+static bcache_buf_t* bcache_evict(void) {
+    for (uint32_t scanned = 0; scanned < bcache_nblocks * 2; scanned++) {
+        bcache_buf_t *b = &bcache_bufs[bcache_hand];
+        bcache_hand = (bcache_hand + 1) % bcache_nblocks;
+
+        /* Someone may still be asleep on the bio of a released block */
+        if (b->waited) {
+            continue;
+        }
+        if (!b->dev) {
+            return b;
+        }
+
+        /* Blocks still being read cannot be reclaimed yet */
+        if (b->loading) {
+            if (!b->bio.done) {
+                continue;
+            }
+            if (bcache_settle(b) != BLKDEV_SUCCESS) {
+                return b;
+            }
+        }
+
+        if (b->referenced) {
+            b->referenced = false;
+            continue;
+        }
+
+        if (b->dirty || b->writing) {
+            continue;
+        }
+
+        bcache_release(b);
+        bcache_stats.evictions++;
+        return b;
+    }
+
+    return NULL;
+}
+
+/**
+ * Write back every dirty block so that CLOCK can reclaim them
+ * (lock held; dropped while the writes are in flight)
+ * @return true if any block was written
+ */
+static bool bcache_make_room(void) {
+    int result = BLKDEV_SUCCESS;
+
+    if (bcache_stats.dirty == 0) {
+        return false;
+    }
+    return bcache_writeback_all(0, 0, &result) > 0;
+}
+
+/**
+ * Claim a free descriptor for (dev, block) and insert it in the hash
+ * (lock must be held). The data is not loaded.
+ * @return Cache block, or NULL if nothing could be reclaimed
+ */
+static bcache_buf_t* bcache_claim(block_device_t *dev, uint64_t block, bool referenced) {
+    bcache_buf_t *b = bcache_evict();
+    if (!b) {
+        return NULL;
+    }
+
+    b->dev = dev;
+    b->block = block;
+    b->nsect = bcache_block_sectors(dev, block);
+    b->dirty = false;
+    b->referenced = referenced;
+
+    uint32_t bucket = bcache_hash_fn(dev, block);
+    b->hash_next = bcache_hash[bucket];
+    bcache_hash[bucket] = b;
+    bcache_stats.used++;
+
+    return b;
+}
+
+/**
+ * Count consecutive uncached blocks starting at block (lock must be held)
+ * @param limit Maximum number of blocks to consider
+ */
+static uint32_t bcache_missing_run(block_device_t *dev, uint64_t block, uint64_t limit) {
+    uint32_t n = 0;
+
+    if (limit > bcache_max_run) {
+        limit = bcache_max_run;
+    }
+    while (n < limit && !bcache_find(dev, block + n)) {
+        n++;
+    }
+    return n;
+}
+
+/**
+ * Start loading a run of consecutive uncached blocks (lock must be held)
+ * Each block is read by its own bio under one plug, so the request queue
+ * merges the run into a single device request. The blocks stay loading
+ * until a lookup waits for them.
+ * @param n Number of blocks (at most bcache_max_run, all uncached)
+ * @param referenced Initial CLOCK reference bit
+ * @return BLKDEV_SUCCESS if at least the first block is loading,
+ *         BLKDEV_ERR_NO_MEMORY if nothing could be reclaimed
+ */
+static int bcache_fill_run(block_device_t *dev, uint64_t block, uint32_t n,
+                           bool referenced) {
+    uint32_t got = 0;
+
+    /* Loading blocks are skipped by CLOCK, so the run cannot evict itself */
+    blk_plug(dev);
+    while (got < n) {
+        bcache_buf_t *b = bcache_claim(dev, block + got, referenced);
+        if (!b) {
+            break;
+        }
+        if (bcache_read_start(b) != BLKDEV_SUCCESS) {
+            bcache_release(b);
+            break;
+        }
+        got++;
+    }
+    blk_unplug(dev);
+
+    if (got == 0) {
+        return BLKDEV_ERR_NO_MEMORY;
+    }
+
+    bcache_stats.misses += got;
+    return BLKDEV_SUCCESS;
+}
+
+/**
+ * Get the cache block for (dev, block) to modify it, loading it on a miss
+ * (lock held; dropped while waiting for I/O)
+ * The returned block has valid data and no write in flight.
+ * @param fill Read the block from the device if it is not cached
+ * @param result Output error code
+ * @return Cache block, or NULL on failure
+ */
+static bcache_buf_t* bcache_get(block_device_t *dev, uint64_t block, bool fill,
+                                int *result) {
+    bool loaded = false;
+
+    for (;;) {
+        bcache_buf_t *b = bcache_lookup(dev, block, result);
+        if (b) {
+            /* Changing data under a write-back would lose the change */
+            if (b->writing) {
+                bcache_relax();
+                continue;
+            }
+            b->referenced = true;
+            if (!loaded) {
+                bcache_stats.hits++;
+            }
+            return b;
+        }
+        if (*result != BLKDEV_SUCCESS) {
+            return NULL;
+        }
+
+        if (fill) {
+            *result = bcache_fill_run(dev, block, 1, true);
+            if (*result == BLKDEV_ERR_NO_MEMORY && bcache_make_room()) {
+                *result = BLKDEV_SUCCESS;
+                continue;
+            }
+            if (*result != BLKDEV_SUCCESS) {
+                return NULL;
+            }
+            loaded = true;
+            continue;
+        }
+
+        b = bcache_claim(dev, block, true);
+        if (b) {
+            bcache_stats.misses++;
+            return b;
+        }
+        /* Writing back may have dropped the lock: look the block up again */
+        if (!bcache_make_room()) {
+            *result = BLKDEV_ERR_NO_MEMORY;
+            return NULL;
+        }
+    }
+}
+
+/* ============================================================================
+ * Public API
+ * ============================================================================ */
+
+int bcache_init(uint32_t nblocks) {
+    if (bcache_ready) {
+        return (int)bcache_nblocks;
+    }
+
+    if (nblocks == 0) {
+        nblocks = BCACHE_DEFAULT_BLOCKS;
+    }
+    if (nblocks > BCACHE_MAX_BLOCKS) {
+        nblocks = BCACHE_MAX_BLOCKS;
+    }
+
+    for (uint32_t i = 0; i < BCACHE_HASH_BUCKETS; i++) {
+        bcache_hash[i] = NULL;
+    }
+
+    /* Allocate one physical page per block; settle for fewer if short */
+    uint32_t count = 0;
+    while (count < nblocks) {
+        physaddr_t phys = pmm_alloc_page();
+        if (phys == 0) {
+            break;
+        }
+
+        bcache_buf_t *b = &bcache_bufs[count];
+        b->dev = NULL;
+        b->block = 0;
+        b->data = (uint8_t *)(VMM_KERNEL_PHYS_MAP + phys);
+        b->dirty_since = 0;
+        b->nsect = 0;
+        b->dirty = false;
+        b->referenced = false;
+        b->loading = false;
+        b->writing = false;
+        b->waited = false;
+        b->hash_next = NULL;
+        count++;
+    }
+
+    if (count == 0) {
+        kprintf("[BCACHE] Failed to allocate cache memory\n");
+        return BLKDEV_ERR_NO_MEMORY;
+    }
+
+    /* Keep a single run from taking over a small cache */
+    bcache_max_run = MIN(BCACHE_MAX_RUN_BLOCKS, MAX(count / 4, 1));
+
+    bcache_nblocks = count;
+    bcache_hand = 0;
+    bcache_stats.hits = 0;
+    bcache_stats.misses = 0;
+    bcache_stats.evictions = 0;
+    bcache_stats.writebacks = 0;
+    bcache_stats.prefetched = 0;
+    bcache_stats.blocks = count;
+    bcache_stats.used = 0;
+    bcache_stats.dirty = 0;
+    bcache_ready = true;
+
+    kprintf("[BCACHE] Buffer cache: %u blocks (%u KB)\n",
+            count, (count * BCACHE_BLOCK_SIZE) / 1024);
+
+    return (int)count;
+}
+
+bool bcache_enabled(void) {
+    return bcache_ready;
+}
+
+int bcache_read(block_device_t *dev, uint64_t lba, uint32_t count, void *buf) {
+    if (!bcache_ready || !dev || !buf) {
+        return BLKDEV_ERR_INVALID;
+    }
+
+    uint8_t *out = (uint8_t *)buf;
+    int result = BLKDEV_SUCCESS;
+    uint64_t last_block = (lba + count - 1) / BCACHE_SECTORS_PER_BLOCK;
+
+    spinlock_acquire(&bcache_lock);
+
+    while (count > 0) {
+        uint64_t block = lba / BCACHE_SECTORS_PER_BLOCK;
+        uint32_t offset = (uint32_t)(lba % BCACHE_SECTORS_PER_BLOCK);
+        uint32_t n = MIN(count, BCACHE_SECTORS_PER_BLOCK - offset);
+
+        bcache_buf_t *b = bcache_lookup(dev, block, &result);
+        if (b) {
+            bcache_stats.hits++;
+        } else {
+            if (result != BLKDEV_SUCCESS) {
+                break;
+            }
+
+            /* Load this and the following missing blocks of the request */
+            uint32_t run = bcache_missing_run(dev, block, last_block - block + 1);
+            result = bcache_fill_run(dev, block, run, true);
+            if (result == BLKDEV_ERR_NO_MEMORY && bcache_make_room()) {
+                result = BLKDEV_SUCCESS;
+                continue;
+            }
+            if (result != BLKDEV_SUCCESS) {
+                break;
+            }
+
+            /* Evicted again while we slept: start over */
+            b = bcache_lookup(dev, block, &result);
+            if (!b) {
+                if (result != BLKDEV_SUCCESS) {
+                    break;
+                }
+                continue;
+            }
+        }
+        b->referenced = true;
+
+        bcache_memcpy(out, b->data + offset * BLKDEV_SECTOR_SIZE,
+                      n * BLKDEV_SECTOR_SIZE);
+
+        out += n * BLKDEV_SECTOR_SIZE;
+        lba += n;
+        count -= n;
+    }
+
+    spinlock_release(&bcache_lock);
+    return result;
+}
+
+int bcache_write(block_device_t *dev, uint64_t lba, uint32_t count, const void *buf) {
+    if (!bcache_ready || !dev || !buf) {
+        return BLKDEV_ERR_INVALID;
+    }
+
+    const uint8_t *in = (const uint8_t *)buf;
+    int result = BLKDEV_SUCCESS;
+    uint64_t now = pit_get_uptime_ms();
+
+    spinlock_acquire(&bcache_lock);
+
+    while (count > 0) {
+        uint64_t block = lba / BCACHE_SECTORS_PER_BLOCK;
+        uint32_t offset = (uint32_t)(lba % BCACHE_SECTORS_PER_BLOCK);
+        uint32_t n = MIN(count, BCACHE_SECTORS_PER_BLOCK - offset);
+
+        /* Partial block writes need the rest of the block from disk */
+        bool whole = (offset == 0 && n >= bcache_block_sectors(dev, block));
+
+        bcache_buf_t *b = bcache_get(dev, block, !whole, &result);
+        if (!b) {
+            break;
+        }
+
+        bcache_memcpy(b->data + offset * BLKDEV_SECTOR_SIZE, in,
+                      n * BLKDEV_SECTOR_SIZE);
+
+        if (!b->dirty) {
+            b->dirty = true;
+            b->dirty_since = now;
+            bcache_stats.dirty++;
+        }
+
+        in += n * BLKDEV_SECTOR_SIZE;
+        lba += n;
+        count -= n;
+    }
+
+    spinlock_release(&bcache_lock);
+    return result;
+}
+
+int bcache_prefetch(block_device_t *dev, uint64_t lba, uint32_t count) {
+    if (!bcache_ready || !dev || count == 0) {
+        return BLKDEV_ERR_INVALID;
+    }
+
+    uint64_t block = lba / BCACHE_SECTORS_PER_BLOCK;
+    uint64_t last_block = (lba + count - 1) / BCACHE_SECTORS_PER_BLOCK;
+    int result = BLKDEV_SUCCESS;
+
+    spinlock_acquire(&bcache_lock);
+
+    while (block <= last_block) {
+        uint32_t run = bcache_missing_run(dev, block, last_block - block + 1);
+        if (run == 0) {
+            block++;
+            continue;
+        }
+
+        /* Prefetched blocks must be used before their next CLOCK pass;
+         * the reads complete in the background */
+        result = bcache_fill_run(dev, block, run, false);
+        if (result != BLKDEV_SUCCESS) {
+            break;
+        }
+        bcache_stats.prefetched += run;
+        block += run;
+    }
+
+    spinlock_release(&bcache_lock);
+    return result;
+}
+
+int bcache_sync(block_device_t *dev) {
+    if (!bcache_ready) {
+        return BLKDEV_SUCCESS;
+    }
+
+    int result = BLKDEV_SUCCESS;
+
+    spinlock_acquire(&bcache_lock);
+
+    if (dev) {
+        bcache_writeback_dev(dev, 0, 0, &result);
+    } else {
+        bcache_writeback_all(0, 0, &result);
+    }
+
+    spinlock_release(&bcache_lock);
+    return result;
+}
+
+void bcache_invalidate(block_device_t *dev) {
+    if (!bcache_ready || !dev) {
+        return;
+    }
+
+    spinlock_acquire(&bcache_lock);
+
+    int result = BLKDEV_SUCCESS;
+    bcache_writeback_dev(dev, 0, 0, &result);
+
+    for (uint32_t i = 0; i < bcache_nblocks; i++) {
+        bcache_buf_t *b = &bcache_bufs[i];
+
+        /* Let reads and a concurrent write-back pass finish first */
+        while (b->dev == dev && (b->loading || b->writing)) {
+            if (b->loading && b->bio.done) {
+                bcache_settle(b);
+            } else if (b->loading) {
+                bcache_wait_read(b);
+            } else {
+                bcache_relax();
+            }
+        }
+
+        if (b->dev == dev) {
+            if (b->dirty) {
+                /* Data is lost; keep the dirty count consistent */
+                bcache_stats.dirty--;
+            }
+            bcache_release(b);
+        }
+    }
+
+    spinlock_release(&bcache_lock);
+}
+
+uint32_t bcache_writeback(uint64_t min_age_ms) {
+    if (!bcache_ready) {
+        return 0;
+    }
+
+    uint32_t written = 0;
+    uint64_t now = pit_get_uptime_ms();
+    int result = BLKDEV_SUCCESS;
+
+    spinlock_acquire(&bcache_lock);
+    written = bcache_writeback_all(now, min_age_ms, &result);
+    spinlock_release(&bcache_lock);
+    return written;
+}
+
+/**
+ * Call the registered write-back hooks, with the lock dropped around each
+ */
+static void bcache_run_hooks(void) {
+    spinlock_acquire(&bcache_lock);
+
+    for (int i = 0; i < BCACHE_MAX_HOOKS; i++) {
+        bcache_hook_t fn = bcache_hooks[i].fn;
+        void *ctx = bcache_hooks[i].ctx;
+        if (!fn) {
+            continue;
+        }
+
+        bcache_hook_running = i;
+        spinlock_release(&bcache_lock);
+        fn(ctx);
+        spinlock_acquire(&bcache_lock);
+        bcache_hook_running = -1;
+    }
+
+    spinlock_release(&bcache_lock);
+}
+
+/**
+ * Periodic write-back thread
+ */
+static void bcache_flusher_thread(void) {
+    uint64_t last = pit_get_uptime_ms();
+
+    for (;;) {
+        uint64_t now = pit_get_uptime_ms();
+        if (now - last >= BCACHE_WRITEBACK_INTERVAL_MS) {
+            bcache_run_hooks();
+            bcache_writeback(BCACHE_WRITEBACK_AGE_MS);
+            last = now;
+        }
+        scheduler_yield();
+    }
+}
+
+bool bcache_start_flusher(void) {
+    if (!bcache_ready) {
+        return false;
+    }
+    if (bcache_flusher_running) {
+        return true;
+    }
+
+    process_t *proc = process_create("bcache_flush", bcache_flusher_thread);
+    if (!proc || !scheduler_add(proc)) {
+        kprintf("[BCACHE] Failed to start write-back thread\n");
+        return false;
+    }
+
+    bcache_flusher_running = true;
+    return true;
+}
+
+bool bcache_add_writeback_hook(bcache_hook_t hook, void *ctx) {
+    bool added = false;
+
+    if (!hook) {
+        return false;
+    }
+
+    spinlock_acquire(&bcache_lock);
+    for (int i = 0; i < BCACHE_MAX_HOOKS && !added; i++) {
+        if (!bcache_hooks[i].fn) {
+            bcache_hooks[i].fn = hook;
+            bcache_hooks[i].ctx = ctx;
+            added = true;
+        }
+    }
+    spinlock_release(&bcache_lock);
+
+    return added;
+}
+
+void bcache_remove_writeback_hook(bcache_hook_t hook, void *ctx) {
+    spinlock_acquire(&bcache_lock);
+
+    for (int i = 0; i < BCACHE_MAX_HOOKS; i++) {
+        if (bcache_hooks[i].fn != hook || bcache_hooks[i].ctx != ctx) {
+            continue;
+        }
+
+        bcache_hooks[i].fn = NULL;
+        bcache_hooks[i].ctx = NULL;
+        while (bcache_hook_running == i) {
+            bcache_relax();
+        }
+    }
+
+    spinlock_release(&bcache_lock);
+}
+
+void bcache_get_stats(bcache_stats_t *stats) {
+    if (!stats) {
+        return;
+    }
+
+    spinlock_acquire(&bcache_lock);
+    *stats = bcache_stats;
+    spinlock_release(&bcache_lock);
+}
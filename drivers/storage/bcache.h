@@ -0,0 +1,151 @@
+/**
+ * AAAos Kernel - Block Buffer Cache
+ *
+ * Caches fixed-size blocks of registered block devices in RAM. Lookups are
+ * hashed by (device, block number), eviction uses the CLOCK algorithm and
+ * writes are held dirty in the cache until written back, either by an
+ * explicit sync or by the periodic write-back thread.
+ *
+ * Cache buffers are allocated from the PMM and accessed through the
+ * kernel physical map, so they are physically contiguous and can be
+ * handed directly to DMA-capable drivers. All device I/O is submitted as
+ * bios to the device's request queue (bio.h).
+ */
+
+#ifndef _AAAOS_BCACHE_H
+#define _AAAOS_BCACHE_H
+
+#include "../../kernel/include/types.h"
+#include "blkdev.h"
+
+/* Cache geometry */
+#define BCACHE_BLOCK_SIZE           PAGE_SIZE   /* Bytes per cache block */
+#define BCACHE_SECTORS_PER_BLOCK    (BCACHE_BLOCK_SIZE / BLKDEV_SECTOR_SIZE)
+#define BCACHE_DEFAULT_BLOCKS       1024        /* Default size (4 MB) */
+#define BCACHE_MAX_BLOCKS           8192        /* Upper bound (32 MB) */
+#define BCACHE_HASH_BUCKETS         1024        /* Hash table size (power of 2) */
+#define BCACHE_MAX_RUN_BLOCKS       32          /* Blocks per read run (128 KB) */
+
+/* Write-back policy */
+#define BCACHE_WRITEBACK_AGE_MS     5000        /* Write dirty blocks older than this */
+#define BCACHE_WRITEBACK_INTERVAL_MS 1000       /* Write-back thread period */
+#define BCACHE_MAX_HOOKS            8           /* Registered write-back hooks */
+
+/**
+ * Write-back hook
+ * Called by the write-back thread every BCACHE_WRITEBACK_INTERVAL_MS,
+ * before aged blocks are written, so that a filesystem can push data it
+ * holds back (such as delayed allocations) into the cache. Runs in the
+ * write-back thread with no cache lock held and may block.
+ */
+typedef void (*bcache_hook_t)(void *ctx);
+
+/**
+ * Cache statistics
+ */
+typedef struct {
+    uint64_t hits;              /* Block lookups served from cache */
+    uint64_t misses;            /* Block lookups that went to the device */
+    uint64_t evictions;         /* Blocks recycled by CLOCK */
+    uint64_t writebacks;        /* Dirty blocks written to the device */
+    uint64_t prefetched;        /* Blocks loaded by read-ahead */
+    uint32_t blocks;            /* Total cache blocks */
+    uint32_t used;              /* Blocks holding device data */
+    uint32_t dirty;             /* Blocks awaiting write-back */
+} bcache_stats_t;
+
+/**
+ * Initialize the buffer cache
+ * @param nblocks Number of cache blocks (0 for BCACHE_DEFAULT_BLOCKS)
+ * @return Number of blocks allocated, or negative error code on failure
+ */
+int bcache_init(uint32_t nblocks);
+
+/**
+ * Check whether the buffer cache is available
+ * @return true if bcache_init succeeded
+ */
+bool bcache_enabled(void);
+
+/**
+ * Read sectors through the cache
+ * @param dev Block device
+ * @param lba Starting sector
+ * @param count Number of sectors
+ * @param buf Destination buffer
+ * @return BLKDEV_SUCCESS on success, negative error code on failure
+ */
+int bcache_read(block_device_t *dev, uint64_t lba, uint32_t count, void *buf);
+
+/**
+ * Write sectors into the cache
+ * Data is marked dirty and written back later.
+ * @param dev Block device
+ * @param lba Starting sector
+ * @param count Number of sectors
+ * @param buf Source buffer
+ * @return BLKDEV_SUCCESS on success, negative error code on failure
+ */
+int bcache_write(block_device_t *dev, uint64_t lba, uint32_t count, const void *buf);
+
+/**
+ * Load sectors into the cache without copying them out (read-ahead)
+ * The reads are queued without waiting; consecutive uncached blocks are
+ * merged into one device request per run.
+ * @param dev Block device
+ * @param lba Starting sector
+ * @param count Number of sectors
+ * @return BLKDEV_SUCCESS on success, negative error code on failure
+ */
+int bcache_prefetch(block_device_t *dev, uint64_t lba, uint32_t count);
+
+/**
+ * Write back all dirty blocks of a device
+ * @param dev Block device, or NULL for all devices
+ * @return BLKDEV_SUCCESS on success, negative error code if any write failed
+ */
+int bcache_sync(block_device_t *dev);
+
+/**
+ * Drop all cached blocks of a device (dirty blocks are written back first)
+ * @param dev Block device
+ */
+void bcache_invalidate(block_device_t *dev);
+
+/**
+ * Write back dirty blocks that have been dirty for at least min_age_ms
+ * @param min_age_ms Minimum age in milliseconds
+ * @return Number of blocks written back
+ */
+uint32_t bcache_writeback(uint64_t min_age_ms);
+
+/**
+ * Start the periodic write-back kernel thread
+ * @return true on success
+ */
+bool bcache_start_flusher(void);
+
+/**
+ * Register a write-back hook
+ * @param hook Function to call
+ * @param ctx Argument passed to hook
+ * @return true on success, false if the hook table is full
+ */
+bool bcache_add_writeback_hook(bcache_hook_t hook, void *ctx);
+
+/**
+ * Unregister a write-back hook
+ * Waits for a call of the hook already in progress, so ctx may be freed
+ * once this returns.
+ * @param hook Function passed to bcache_add_writeback_hook()
+ * @param ctx Argument passed to bcache_add_writeback_hook()
+ */
+void bcache_remove_writeback_hook(bcache_hook_t hook, void *ctx);
+
+/**
+ * Get cache statistics
+ * @param stats Output statistics
+ */
+void bcache_get_stats(bcache_stats_t *stats);
+
+#endif /* _AAAOS_BCACHE_H */
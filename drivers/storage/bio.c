@@ -0,0 +1,630 @@
+/**
+ * AAAos Kernel - Block Request Layer
+ *
+ * Request queues, bio merging, plugging and completion.
+ */
+
+#include "bio.h"
+#include "../../kernel/include/serial.h"
+#include "../../kernel/include/trace.h"
+#include "../../kernel/arch/x86_64/include/idt.h"
+#include "../../kernel/sched/scheduler.h"
+#include "../../kernel/proc/process.h"
+#include "../timer/pit.h"
+
+/* RFLAGS interrupt enable bit */
+#define BLK_RFLAGS_IF           (1 << 9)
+
+/* One queue per registrable device */
+static blk_queue_t blk_queues[BLKDEV_MAX_DEVICES];
+
+/* Available schedulers; the first is the default */
+static const blk_sched_ops_t *blk_schedulers[] = {
+    &blk_sched_deadline,
+    &blk_sched_noop,
+};
+
+#define BLK_NUM_SCHEDULERS  (sizeof(blk_schedulers) / sizeof(blk_schedulers[0]))
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================ */
+
+/**
+ * Take the queue lock with interrupts disabled
+ * Completions may arrive from interrupt handlers.
+ * @return Saved RFLAGS for blk_unlock
+ */
+static inline uint64_t blk_lock(blk_queue_t *q) {
+    uint64_t flags;
+    __asm__ __volatile__("pushfq; pop %0; cli" : "=r"(flags) : : "memory");
+    while (__sync_lock_test_and_set(&q->lock, 1)) {
+        __asm__ __volatile__("pause");
+    }
+    return flags;
+}
+
+static inline void blk_unlock(blk_queue_t *q, uint64_t flags) {
+    __sync_lock_release(&q->lock);
+    if (flags & BLK_RFLAGS_IF) {
+        __asm__ __volatile__("sti");
+    }
+}
+
+/**
+ * Simple memory set
+ */
+static void blk_memset(void *dest, uint8_t val, size_t size) {
+    uint8_t *d = (uint8_t *)dest;
+    while (size--) {
+        *d++ = val;
+    }
+}
+
+/**
+ * Compare two strings
+ */
+static int blk_strcmp(const char *a, const char *b) {
+    while (*a && *a == *b) {
+        a++;
+        b++;
+    }
+    return (uint8_t)*a - (uint8_t)*b;
+}
+
+/**
+ * Check whether the caller can sleep until a completion wakes it
+ */
+static bool blk_can_sleep(void) {
+    uint64_t flags;
+    __asm__ __volatile__("pushfq; pop %0" : "=r"(flags));
+
+    return (flags & BLK_RFLAGS_IF) && scheduler_is_running() &&
+           process_get_current() != NULL;
+}
+
+/**
+ * Let the driver make progress while the caller cannot sleep
+ */
+static void blk_relax(block_device_t *dev) {
+    if (dev->ops->poll) {
+        dev->ops->poll(dev->data);
+    }
+    if (blk_can_sleep()) {
+        scheduler_yield();
+    } else {
+        __asm__ __volatile__("pause");
+    }
+}
+
+/**
+ * Wake a thread sleeping on a bio
+ */
+static void blk_wake(process_t *proc) {
+    if (proc->state == PROCESS_STATE_BLOCKED) {
+        process_set_state(proc, PROCESS_STATE_READY);
+        scheduler_add(proc);
+    }
+}
+
+/* ============================================================================
+ * Request Management
+ * ============================================================================ */
+
+/**
+ * Take a request descriptor from the free list (lock held)
+ */
+static blk_request_t* blk_request_alloc(blk_queue_t *q) {
+    blk_request_t *rq = q->free;
+    if (rq) {
+        q->free = rq->next;
+        rq->next = NULL;
+    }
+    return rq;
+}
+
+/**
+ * Return a request descriptor to the free list (lock held)
+ */
+static void blk_request_free(blk_queue_t *q, blk_request_t *rq) {
+    rq->bio = NULL;
+    rq->biotail = NULL;
+    rq->next = q->free;
+    q->free = rq;
+}
+
+/**
+ * Try to append or prepend a bio to a queued request (lock held)
+ * @return true if the bio was merged
+ */
+static bool blk_try_merge(blk_queue_t *q, bio_t *bio) {
+    for (blk_request_t *rq = q->queued; rq; rq = rq->next) {
+        if (rq->op != bio->op || rq->nr_bios >= BLK_MAX_SEGMENTS ||
+            rq->count + bio->count > BLK_MAX_SECTORS) {
+            continue;
+        }
+
+        if (rq->lba + rq->count == bio->lba) {
+            /* Back merge */
+            rq->biotail->next = bio;
+            rq->biotail = bio;
+        } else if (bio->lba + bio->count == rq->lba) {
+            /* Front merge */
+            bio->next = rq->bio;
+            rq->bio = bio;
+            rq->lba = bio->lba;
+        } else {
+            continue;
+        }
+
+        rq->count += bio->count;
+        rq->nr_bios++;
+        q->stats.dir[bio->op].merges++;
+        TRACE(TRACE_BLOCK, TRACE_BLK_MERGE, bio->op, bio->lba, bio->count, rq->lba);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Remove a request chosen by the scheduler from the merge list (lock held)
+ */
+static void blk_unlink_queued(blk_queue_t *q, blk_request_t *rq) {
+    blk_request_t **pp = &q->queued;
+
+    while (*pp) {
+        if (*pp == rq) {
+            *pp = rq->next;
+            break;
+        }
+        pp = &(*pp)->next;
+    }
+    rq->next = NULL;
+    q->nr_queued--;
+}
+
+/**
+ * Hand a request to the driver (queue lock not held)
+ * Drivers without a submit operation are called synchronously, once per
+ * run of bios whose buffers are contiguous in memory.
+ */
+static void blk_issue(blk_queue_t *q, blk_request_t *rq) {
+    block_device_t *dev = q->dev;
+
+    TRACE(TRACE_BLOCK, TRACE_BLK_ISSUE, rq->op, rq->lba, rq->count, rq->nr_bios);
+
+    if (dev->ops->submit) {
+        if (dev->ops->submit(dev->data, rq) != 0) {
+            blk_end_request(rq, BLKDEV_ERR_IO);
+        }
+        return;
+    }
+
+    int status = BLKDEV_SUCCESS;
+    bio_t *bio = rq->bio;
+
+    while (bio && status == BLKDEV_SUCCESS) {
+        bio_t *last = bio;
+        uint32_t count = bio->count;
+
+        while (last->next &&
+               (uint8_t *)last->next->buf ==
+               (uint8_t *)last->buf + last->count * BLKDEV_SECTOR_SIZE) {
+            last = last->next;
+            count += last->count;
+        }
+
+        int result;
+        if (rq->op == BIO_WRITE) {
+            result = dev->ops->write_sectors(dev->data, bio->lba, count, bio->buf);
+        } else {
+            result = dev->ops->read_sectors(dev->data, bio->lba, count, bio->buf);
+        }
+        if (result != 0) {
+            status = BLKDEV_ERR_IO;
+        }
+
+        bio = last->next;
+    }
+
+    blk_end_request(rq, status);
+}
+
+/**
+ * Dispatch requests until the queue is empty or the driver is full
+ * @param force Dispatch even if the queue is plugged
+ */
+static void blk_dispatch(blk_queue_t *q, bool force) {
+    uint64_t flags = blk_lock(q);
+
+    /* A single dispatcher at a time; it picks up whatever others queue */
+    if (q->dispatching) {
+        blk_unlock(q, flags);
+        return;
+    }
+    q->dispatching = true;
+
+    while (q->nr_queued > 0 && q->in_flight < q->depth) {
+        if (!force && q->plugged && q->nr_queued < BLK_PLUG_FLUSH) {
+            break;
+        }
+
+        blk_request_t *rq = q->sched->dispatch(q);
+        if (!rq) {
+            break;
+        }
+        blk_unlink_queued(q, rq);
+        rq->issued = trace_clock();
+        if (q->in_flight++ == 0) {
+            q->busy_since = rq->issued;
+        }
+        q->stats.dispatched++;
+
+        blk_unlock(q, flags);
+        blk_issue(q, rq);
+        flags = blk_lock(q);
+    }
+
+    q->dispatching = false;
+    blk_unlock(q, flags);
+}
+
+/**
+ * Wait until a queue has no queued (and optionally no in-flight) requests
+ */
+static void blk_drain(blk_queue_t *q, bool in_flight) {
+    for (;;) {
+        uint64_t flags = blk_lock(q);
+        bool idle = q->nr_queued == 0 && (!in_flight || q->in_flight == 0);
+        blk_unlock(q, flags);
+
+        if (idle) {
+            return;
+        }
+        blk_run_queue(q);
+        blk_relax(q->dev);
+    }
+}
+
+/* ============================================================================
+ * Public API
+ * ============================================================================ */
+
+blk_queue_t* blk_queue_init(block_device_t *dev) {
+    if (!dev || !dev->ops) {
+        return NULL;
+    }
+
+    for (int i = 0; i < BLKDEV_MAX_DEVICES; i++) {
+        blk_queue_t *q = &blk_queues[i];
+        if (q->dev) {
+            continue;
+        }
+
+        blk_memset(q, 0, sizeof(*q));
+        q->dev = dev;
+        q->sched = blk_schedulers[0];
+        q->depth = dev->ops->submit ? BLK_QUEUE_DEPTH : 1;
+        q->stats.since = trace_clock();
+
+        for (int r = BLK_QUEUE_REQUESTS - 1; r >= 0; r--) {
+            q->requests[r].queue = q;
+            blk_request_free(q, &q->requests[r]);
+        }
+
+        q->sched->init(q);
+        dev->queue = q;
+        return q;
+    }
+
+    kprintf("[BLK] No request queue left for %s\n", dev->name);
+    return NULL;
+}
+
+void blk_queue_release(block_device_t *dev) {
+    if (!dev || !dev->queue) {
+        return;
+    }
+
+    blk_queue_t *q = dev->queue;
+    blk_drain(q, true);
+
+    q->dev = NULL;
+    dev->queue = NULL;
+}
+
+int blk_set_scheduler(block_device_t *dev, const char *name) {
+    if (!dev || !dev->queue || !name) {
+        return BLKDEV_ERR_INVALID;
+    }
+
+    const blk_sched_ops_t *sched = NULL;
+    for (size_t i = 0; i < BLK_NUM_SCHEDULERS; i++) {
+        if (blk_strcmp(blk_schedulers[i]->name, name) == 0) {
+            sched = blk_schedulers[i];
+            break;
+        }
+    }
+    if (!sched) {
+        return BLKDEV_ERR_INVALID;
+    }
+
+    /* Requests the old scheduler holds must leave through it */
+    blk_queue_t *q = dev->queue;
+    for (;;) {
+        blk_drain(q, false);
+
+        uint64_t flags = blk_lock(q);
+        if (q->nr_queued == 0) {
+            q->sched = sched;
+            q->sched->init(q);
+            blk_unlock(q, flags);
+            break;
+        }
+        blk_unlock(q, flags);
+    }
+
+    kprintf("[BLK] %s: using %s scheduler\n", dev->name, sched->name);
+    return BLKDEV_SUCCESS;
+}
+
+void bio_init(bio_t *bio, block_device_t *dev, bio_op_t op, uint64_t lba,
+              uint32_t count, void *buf) {
+    blk_memset(bio, 0, sizeof(*bio));
+    bio->dev = dev;
+    bio->op = op;
+    bio->lba = lba;
+    bio->count = count;
+    bio->buf = buf;
+}
+
+int submit_bio(bio_t *bio) {
+    if (!bio || !bio->dev || !bio->dev->in_use || !bio->dev->queue || !bio->buf ||
+        bio->count == 0 || bio->count > BLK_MAX_SECTORS) {
+        return BLKDEV_ERR_INVALID;
+    }
+
+    block_device_t *dev = bio->dev;
+    if (dev->sector_count != 0 &&
+        (bio->lba >= dev->sector_count || bio->count > dev->sector_count - bio->lba)) {
+        return BLKDEV_ERR_RANGE;
+    }
+    if (bio->op == BIO_WRITE && !dev->ops->submit && !dev->ops->write_sectors) {
+        return BLKDEV_ERR_IO;
+    }
+
+    bio->status = BLKDEV_SUCCESS;
+    bio->done = false;
+    bio->waiter = NULL;
+    bio->next = NULL;
+
+    blk_queue_t *q = dev->queue;
+    uint64_t flags = blk_lock(q);
+    q->stats.bios++;
+
+    if (!blk_try_merge(q, bio)) {
+        blk_request_t *rq = blk_request_alloc(q);
+
+        /* Out of descriptors: push work to the driver until one frees up */
+        while (!rq) {
+            blk_unlock(q, flags);
+            blk_run_queue(q);
+            blk_relax(dev);
+            flags = blk_lock(q);
+            rq = blk_request_alloc(q);
+        }
+
+        rq->op = bio->op;
+        rq->lba = bio->lba;
+        rq->count = bio->count;
+        rq->bio = bio;
+        rq->biotail = bio;
+        rq->nr_bios = 1;
+        rq->deadline = pit_get_uptime_ms() +
+                       (bio->op == BIO_READ ? BLK_DEADLINE_READ_MS : BLK_DEADLINE_WRITE_MS);
+        rq->sort_next = NULL;
+        rq->fifo_next = NULL;
+
+        rq->next = q->queued;
+        q->queued = rq;
+        q->nr_queued++;
+        q->sched->add(q, rq);
+        TRACE(TRACE_BLOCK, TRACE_BLK_QUEUE, bio->op, bio->lba, bio->count, 0);
+    }
+
+    blk_unlock(q, flags);
+
+    blk_dispatch(q, false);
+    return BLKDEV_SUCCESS;
+}
+
+int bio_wait(bio_t *bio) {
+    if (!bio || !bio->dev || !bio->dev->queue) {
+        return BLKDEV_ERR_INVALID;
+    }
+
+    block_device_t *dev = bio->dev;
+    blk_queue_t *q = dev->queue;
+
+    /* Nothing will start a plugged bio while its submitter sleeps */
+    blk_run_queue(q);
+
+    while (!bio->done) {
+        bool must_poll = dev->ops->poll && dev->ops->poll(dev->data);
+        if (bio->done) {
+            break;
+        }
+
+        if (!must_poll && blk_can_sleep()) {
+            /* Checked under the lock so the completion cannot slip in between */
+            uint64_t flags = blk_lock(q);
+            if (!bio->done) {
+                bio->waiter = process_get_current();
+                process_set_state(bio->waiter, PROCESS_STATE_BLOCKED);
+            }
+            blk_unlock(q, flags);
+            scheduler_yield();
+            continue;
+        }
+
+        if (blk_can_sleep()) {
+            scheduler_yield();
+        } else {
+            __asm__ __volatile__("pause");
+        }
+    }
+
+    return bio->status;
+}
+
+int submit_bio_wait(bio_t *bio) {
+    if (bio) {
+        bio->end = NULL;
+    }
+
+    int result = submit_bio(bio);
+    if (result != BLKDEV_SUCCESS) {
+        return result;
+    }
+    return bio_wait(bio);
+}
+
+int blk_rw(block_device_t *dev, bio_op_t op, uint64_t lba, uint32_t count, void *buf) {
+    uint8_t *p = (uint8_t *)buf;
+
+    while (count > 0) {
+        uint32_t n = MIN(count, BLK_MAX_SECTORS);
+        bio_t bio;
+
+        bio_init(&bio, dev, op, lba, n, p);
+        int result = submit_bio_wait(&bio);
+        if (result != BLKDEV_SUCCESS) {
+            return result;
+        }
+
+        p += n * BLKDEV_SECTOR_SIZE;
+        lba += n;
+        count -= n;
+    }
+
+    return BLKDEV_SUCCESS;
+}
+
+void blk_plug(block_device_t *dev) {
+    if (!dev || !dev->queue) {
+        return;
+    }
+
+    blk_queue_t *q = dev->queue;
+    uint64_t flags = blk_lock(q);
+    q->plugged++;
+    blk_unlock(q, flags);
+}
+
+void blk_unplug(block_device_t *dev) {
+    if (!dev || !dev->queue) {
+        return;
+    }
+
+    blk_queue_t *q = dev->queue;
+    uint64_t flags = blk_lock(q);
+    if (q->plugged > 0) {
+        q->plugged--;
+    }
+    blk_unlock(q, flags);
+
+    blk_dispatch(q, false);
+}
+
+void blk_run_queue(blk_queue_t *q) {
+    if (q) {
+        blk_dispatch(q, true);
+    }
+}
+
+void blk_end_request(blk_request_t *rq, int status) {
+    blk_queue_t *q = rq->queue;
+    bio_t *bio = rq->bio;
+
+    TRACE(TRACE_BLOCK, TRACE_BLK_COMPLETE, rq->op, rq->lba, rq->count, (int64_t)status);
+
+    uint64_t now = trace_clock();
+    uint64_t lat = now - rq->issued;
+    uint32_t bucket = lat ? MIN(63 - __builtin_clzll(lat), BLK_LAT_BUCKETS - 1) : 0;
+
+    uint64_t flags = blk_lock(q);
+    blk_dir_stats_t *ds = &q->stats.dir[rq->op];
+    ds->ios++;
+    ds->sectors += rq->count;
+    ds->lat_total += lat;
+    ds->lat_max = MAX(ds->lat_max, lat);
+    ds->lat_hist[bucket]++;
+    if (status != BLKDEV_SUCCESS) {
+        ds->errors++;
+    }
+
+    if (--q->in_flight == 0) {
+        q->stats.busy += now - q->busy_since;
+    }
+    blk_request_free(q, rq);
+    blk_unlock(q, flags);
+
+    while (bio) {
+        bio_t *next = bio->next;
+        bio->next = NULL;
+        bio->status = status;
+
+        if (bio->end) {
+            /* The callback owns the bio from here on */
+            bio->end(bio);
+        } else {
+            flags = blk_lock(q);
+            process_t *waiter = bio->waiter;
+            bio->done = true;
+            blk_unlock(q, flags);
+
+            if (waiter) {
+                blk_wake(waiter);
+            }
+        }
+
+        bio = next;
+    }
+
+    /* Keep the device busy */
+    blk_run_queue(q);
+}
+
+int blk_get_stats(block_device_t *dev, blk_stats_t *out) {
+    if (!dev || !dev->queue || !out) {
+        return BLKDEV_ERR_INVALID;
+    }
+
+    blk_queue_t *q = dev->queue;
+    uint64_t flags = blk_lock(q);
+
+    *out = q->stats;
+    out->in_flight = q->in_flight;
+    out->queued = q->nr_queued;
+    if (q->in_flight > 0) {
+        out->busy += trace_clock() - q->busy_since;
+    }
+
+    blk_unlock(q, flags);
+    return BLKDEV_SUCCESS;
+}
+
+void blk_reset_stats(block_device_t *dev) {
+    if (!dev || !dev->queue) {
+        return;
+    }
+
+    blk_queue_t *q = dev->queue;
+    uint64_t flags = blk_lock(q);
+
+    blk_memset(&q->stats, 0, sizeof(q->stats));
+    q->stats.since = trace_clock();
+    q->busy_since = q->stats.since;
+
+    blk_unlock(q, flags);
+}
@@ -0,0 +1,313 @@
+/**
+ * AAAos Kernel - Block Request Layer
+ *
+ * Asynchronous I/O in front of block device drivers. Callers describe a
+ * transfer with a bio and submit it to the device's request queue, where:
+ * - bios for adjacent sectors are merged into one request
+ * - plugging holds requests back briefly so a batch can be merged
+ * - a pluggable I/O scheduler (noop or deadline) picks dispatch order
+ * - drivers with an asynchronous submit operation get up to
+ *   BLK_QUEUE_DEPTH requests at once; others are driven synchronously
+ *
+ * Completion is reported per bio, through an optional callback and by
+ * waking threads sleeping in bio_wait().
+ */
+
+#ifndef _AAAOS_BIO_H
+#define _AAAOS_BIO_H
+
+#include "../../kernel/include/types.h"
+#include "blkdev.h"
+
+/* Request queue limits */
+#define BLK_QUEUE_REQUESTS      64      /* Request descriptors per queue */
+#define BLK_QUEUE_DEPTH         32      /* Requests handed to a driver at once */
+#define BLK_MAX_SECTORS         1024    /* Sectors per merged request (512 KB) */
+#define BLK_MAX_SEGMENTS        32      /* bios per merged request */
+#define BLK_PLUG_FLUSH          16      /* Queued requests that force an unplug */
+
+/* Deadline scheduler tuning */
+#define BLK_DEADLINE_READ_MS    500     /* Read expiry */
+#define BLK_DEADLINE_WRITE_MS   5000    /* Write expiry */
+#define BLK_DEADLINE_BATCH      16      /* Requests per sweep in one direction */
+#define BLK_DEADLINE_STARVED    2       /* Read batches before writes must run */
+
+/* Latency histogram: bucket n counts requests that took [2^n, 2^(n+1)) TSC cycles */
+#define BLK_LAT_BUCKETS         40
+
+/* Size of the text produced by blk_stats_show() for one device */
+#define BLK_STATS_TEXT_MAX      8192
+
+/**
+ * Transfer direction
+ */
+typedef enum {
+    BIO_READ = 0,
+    BIO_WRITE = 1
+} bio_op_t;
+
+struct bio;
+struct blk_request;
+struct blk_queue;
+struct process;
+
+/**
+ * bio completion callback
+ * May run in interrupt context; it must not block. The callback takes the
+ * bio back from the block layer, so a bio with a callback is never marked
+ * done and cannot be passed to bio_wait().
+ */
+typedef void (*bio_end_t)(struct bio *bio);
+
+/**
+ * Block I/O descriptor: one contiguous buffer at one device location
+ * A submitted bio belongs to the block layer until it completes.
+ */
+typedef struct bio {
+    block_device_t      *dev;           /* Target device */
+    bio_op_t            op;             /* Direction */
+    uint64_t            lba;            /* Starting sector */
+    uint32_t            count;          /* Sector count */
+    void                *buf;           /* Data (kernel virtual) */
+    bio_end_t           end;            /* Completion callback (optional) */
+    void                *private;       /* Caller cookie */
+    int                 status;         /* Result, valid once done */
+
+    /* Block layer bookkeeping */
+    volatile bool       done;           /* bio has completed */
+    struct process      *waiter;        /* Thread sleeping in bio_wait */
+    struct bio          *next;          /* Next bio of the same request */
+} bio_t;
+
+/**
+ * Request: one or more bios covering consecutive sectors
+ */
+typedef struct blk_request {
+    struct blk_queue    *queue;         /* Owning queue */
+    bio_op_t            op;             /* Direction */
+    uint64_t            lba;            /* Starting sector */
+    uint32_t            count;          /* Total sectors */
+    bio_t               *bio;           /* First bio (lowest sector) */
+    bio_t               *biotail;       /* Last bio */
+    uint32_t            nr_bios;        /* Segments */
+    uint64_t            deadline;       /* Uptime (ms) by which to dispatch */
+    uint64_t            issued;         /* TSC when handed to the driver */
+
+    struct blk_request  *next;          /* Merge list / free list */
+    struct blk_request  *sort_next;     /* Scheduler sorted list */
+    struct blk_request  *fifo_next;     /* Scheduler FIFO */
+} blk_request_t;
+
+/**
+ * Scheduler state kept in the queue
+ * noop uses fifo[0] only; deadline keeps a sector-sorted list and an
+ * expiry FIFO per direction.
+ */
+typedef struct {
+    blk_request_t       *sort[2];       /* Sorted by lba, per direction */
+    blk_request_t       *fifo[2];       /* Oldest first, per direction */
+    blk_request_t       *fifo_tail[2];
+    uint32_t            batch;          /* Requests left in the current sweep */
+    bio_op_t            dir;            /* Direction of the current sweep */
+    uint64_t            next_lba;       /* Where the current sweep continues */
+    uint32_t            starved;        /* Read batches while writes waited */
+} blk_sched_data_t;
+
+/**
+ * I/O scheduler operations
+ */
+typedef struct blk_sched_ops {
+    const char          *name;
+
+    /**
+     * Reset the scheduler state of an empty queue
+     */
+    void (*init)(struct blk_queue *q);
+
+    /**
+     * Take ownership of a new request
+     */
+    void (*add)(struct blk_queue *q, blk_request_t *rq);
+
+    /**
+     * Remove and return the next request to dispatch
+     * @return Request, or NULL if none is queued
+     */
+    blk_request_t* (*dispatch)(struct blk_queue *q);
+} blk_sched_ops_t;
+
+/**
+ * Per-direction I/O statistics
+ */
+typedef struct {
+    uint64_t            ios;            /* Requests completed */
+    uint64_t            sectors;        /* Sectors transferred */
+    uint64_t            merges;         /* bios merged into a queued request */
+    uint64_t            errors;         /* Requests that failed */
+    uint64_t            lat_total;      /* Sum of issue-to-completion times (TSC) */
+    uint64_t            lat_max;        /* Slowest request (TSC) */
+    uint64_t            lat_hist[BLK_LAT_BUCKETS];  /* log2 latency histogram */
+} blk_dir_stats_t;
+
+/**
+ * Device I/O statistics
+ */
+typedef struct {
+    blk_dir_stats_t     dir[2];         /* Indexed by bio_op_t */
+    uint64_t            bios;           /* bios submitted */
+    uint64_t            dispatched;     /* Requests sent to the driver */
+    uint64_t            busy;           /* TSC cycles with requests in flight */
+    uint64_t            since;          /* TSC when counting started */
+    uint32_t            in_flight;      /* Requests owned by the driver */
+    uint32_t            queued;         /* Requests waiting to be dispatched */
+} blk_stats_t;
+
+/**
+ * Per-device request queue
+ */
+typedef struct blk_queue {
+    block_device_t          *dev;           /* Device served */
+    const blk_sched_ops_t   *sched;         /* I/O scheduler */
+    blk_sched_data_t        sd;             /* Scheduler state */
+
+    blk_request_t           *queued;        /* Undispatched requests (merge candidates) */
+    uint32_t                nr_queued;
+    uint32_t                in_flight;      /* Requests owned by the driver */
+    uint32_t                depth;          /* Driver concurrency limit */
+    uint32_t                plugged;        /* Plug nesting count */
+    bool                    dispatching;    /* Dispatch loop is running */
+
+    blk_request_t           requests[BLK_QUEUE_REQUESTS];
+    blk_request_t           *free;          /* Free request descriptors */
+
+    /* Statistics (in_flight and queued are filled in by blk_get_stats) */
+    blk_stats_t             stats;
+    uint64_t                busy_since;     /* TSC when in_flight became nonzero */
+
+    volatile int            lock;           /* Protects the queue */
+} blk_queue_t;
+
+/* Built-in schedulers */
+extern const blk_sched_ops_t blk_sched_noop;
+extern const blk_sched_ops_t blk_sched_deadline;
+
+/**
+ * Set up the request queue of a newly registered device
+ * @param dev Block device
+ * @return Queue, or NULL if none is available
+ */
+blk_queue_t* blk_queue_init(block_device_t *dev);
+
+/**
+ * Wait for all queued and in-flight requests of a device, then detach its queue
+ * @param dev Block device
+ */
+void blk_queue_release(block_device_t *dev);
+
+/**
+ * Select a device's I/O scheduler by name ("noop" or "deadline")
+ * Waits for queued requests to be dispatched first.
+ * @param dev Block device
+ * @param name Scheduler name
+ * @return BLKDEV_SUCCESS on success, BLKDEV_ERR_INVALID if unknown
+ */
+int blk_set_scheduler(block_device_t *dev, const char *name);
+
+/**
+ * Prepare a bio
+ * @param bio bio to initialize
+ * @param dev Target device
+ * @param op Direction
+ * @param lba Starting sector
+ * @param count Sector count
+ * @param buf Data buffer
+ */
+void bio_init(bio_t *bio, block_device_t *dev, bio_op_t op, uint64_t lba,
+              uint32_t count, void *buf);
+
+/**
+ * Submit a bio without waiting for it
+ * @param bio Initialized bio (end and private may be set)
+ * @return BLKDEV_SUCCESS if queued, negative error code otherwise
+ */
+int submit_bio(bio_t *bio);
+
+/**
+ * Wait for a submitted bio (one without a completion callback)
+ * Starts any plugged requests, then sleeps until completion (or polls the
+ * driver when sleeping is not possible).
+ * @param bio Submitted bio
+ * @return bio status
+ */
+int bio_wait(bio_t *bio);
+
+/**
+ * Submit a bio and wait for it
+ * @param bio Initialized bio (any completion callback is cleared)
+ * @return bio status
+ */
+int submit_bio_wait(bio_t *bio);
+
+/**
+ * Read or write sectors through the request queue and wait
+ * @param dev Block device
+ * @param op Direction
+ * @param lba Starting sector
+ * @param count Sector count
+ * @param buf Data buffer
+ * @return BLKDEV_SUCCESS on success, negative error code on failure
+ */
+int blk_rw(block_device_t *dev, bio_op_t op, uint64_t lba, uint32_t count, void *buf);
+
+/**
+ * Hold back dispatch so that following bios can be merged
+ * Plugs nest; dispatch resumes when the last one is removed.
+ * @param dev Block device
+ */
+void blk_plug(block_device_t *dev);
+
+/**
+ * Remove a plug and dispatch what has accumulated
+ * @param dev Block device
+ */
+void blk_unplug(block_device_t *dev);
+
+/**
+ * Dispatch queued requests to the driver, even if the queue is plugged
+ * @param q Request queue
+ */
+void blk_run_queue(blk_queue_t *q);
+
+/**
+ * Complete a request (called by drivers, possibly from interrupt context)
+ * @param rq Request handed to the driver's submit operation
+ * @param status BLKDEV_SUCCESS or a negative error code
+ */
+void blk_end_request(blk_request_t *rq, int status);
+
+/**
+ * Take a snapshot of a device's I/O statistics
+ * @param dev Block device
+ * @param out Destination
+ * @return BLKDEV_SUCCESS on success, BLKDEV_ERR_INVALID if dev has no queue
+ */
+int blk_get_stats(block_device_t *dev, blk_stats_t *out);
+
+/**
+ * Zero a device's I/O statistics
+ * @param dev Block device
+ */
+void blk_reset_stats(block_device_t *dev);
+
+/**
+ * Format a device's statistics and latency histograms as text
+ * Latencies are shown in microseconds once the TSC has been calibrated
+ * against the PIT, in TSC cycles otherwise.
+ * @param dev Block device
+ * @param buf Destination (NUL-terminated, truncated to fit)
+ * @param size Size of buf (BLK_STATS_TEXT_MAX is always enough)
+ * @return Length of the text
+ */
+size_t blk_stats_show(block_device_t *dev, char *buf, size_t size);
+
+#endif /* _AAAOS_BIO_H */
@@ -0,0 +1,229 @@
+/**
+ * AAAos Kernel - Block Device Layer
+ *
+ * Block device registry and cached I/O entry points. Uncached I/O goes
+ * straight to the device's request queue.
+ */
+
+#include "blkdev.h"
+#include "bcache.h"
+#include "bio.h"
+#include "../../kernel/include/serial.h"
+
+/* Global state */
+static block_device_t blkdev_table[BLKDEV_MAX_DEVICES];
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================ */
+
+/**
+ * Compare two strings
+ */
+static int blkdev_strcmp(const char *a, const char *b) {
+    while (*a && *a == *b) {
+        a++;
+        b++;
+    }
+    return (uint8_t)*a - (uint8_t)*b;
+}
+
+/**
+ * Copy a string with length limit (always NUL-terminates)
+ */
+static void blkdev_strncpy(char *dest, const char *src, size_t n) {
+    size_t i = 0;
+    while (i + 1 < n && src[i]) {
+        dest[i] = src[i];
+        i++;
+    }
+    dest[i] = '\0';
+}
+
+/**
+ * Validate a request against the device size
+ */
+static int blkdev_check_range(block_device_t *dev, uint64_t lba, uint32_t count) {
+    if (!dev || !dev->in_use || count == 0) {
+        return BLKDEV_ERR_INVALID;
+    }
+    if (dev->sector_count != 0 &&
+        (lba >= dev->sector_count || count > dev->sector_count - lba)) {
+        return BLKDEV_ERR_RANGE;
+    }
+    return BLKDEV_SUCCESS;
+}
+
+/* ============================================================================
+ * block_ops_t adapter
+ * ============================================================================ */
+
+static int blkdev_ops_read(void *device, uint64_t lba, uint32_t count, void *buffer) {
+    return blkdev_read((block_device_t *)device, lba, count, buffer);
+}
+
+static int blkdev_ops_write(void *device, uint64_t lba, uint32_t count, const void *buffer) {
+    return blkdev_write((block_device_t *)device, lba, count, buffer);
+}
+
+static int blkdev_ops_flush(void *device) {
+    return blkdev_flush((block_device_t *)device);
+}
+
+static int blkdev_ops_prefetch(void *device, uint64_t lba, uint32_t count) {
+    return blkdev_prefetch((block_device_t *)device, lba, count);
+}
+
+block_ops_t blkdev_ops = {
+    .read_sectors   = blkdev_ops_read,
+    .write_sectors  = blkdev_ops_write,
+    .flush          = blkdev_ops_flush,
+    .prefetch       = blkdev_ops_prefetch,
+};
+
+/* ============================================================================
+ * Public API
+ * ============================================================================ */
+
+block_device_t* blkdev_register(const char *name, block_ops_t *ops, void *data,
+                                uint64_t sector_count) {
+    if (!name || !ops || !ops->read_sectors) {
+        return NULL;
+    }
+
+    if (blkdev_find(name)) {
+        kprintf("[BLKDEV] Device %s already registered\n", name);
+        return NULL;
+    }
+
+    /* The buffer cache is brought up with the first device */
+    if (!bcache_enabled() && bcache_init(0) > 0) {
+        bcache_start_flusher();
+    }
+
+    for (int i = 0; i < BLKDEV_MAX_DEVICES; i++) {
+        block_device_t *dev = &blkdev_table[i];
+        if (!dev->in_use) {
+            blkdev_strncpy(dev->name, name, BLKDEV_NAME_MAX);
+            dev->ops = ops;
+            dev->data = data;
+            dev->sector_count = sector_count;
+            dev->cached = bcache_enabled();
+            dev->in_use = true;
+
+            if (!blk_queue_init(dev)) {
+                dev->in_use = false;
+                dev->ops = NULL;
+                dev->data = NULL;
+                return NULL;
+            }
+
+            kprintf("[BLKDEV] Registered %s (%llu sectors%s)\n",
+                    dev->name, sector_count, dev->cached ? ", cached" : "");
+            return dev;
+        }
+    }
+
+    kprintf("[BLKDEV] Device table full\n");
+    return NULL;
+}
+
+int blkdev_unregister(block_device_t *dev) {
+    if (!dev || !dev->in_use) {
+        return BLKDEV_ERR_INVALID;
+    }
+
+    if (dev->cached) {
+        bcache_invalidate(dev);
+    }
+    blk_queue_release(dev);
+    if (dev->ops->flush) {
+        dev->ops->flush(dev->data);
+    }
+
+    dev->in_use = false;
+    dev->ops = NULL;
+    dev->data = NULL;
+    return BLKDEV_SUCCESS;
+}
+
+block_device_t* blkdev_find(const char *name) {
+    if (!name) {
+        return NULL;
+    }
+
+    for (int i = 0; i < BLKDEV_MAX_DEVICES; i++) {
+        if (blkdev_table[i].in_use && blkdev_strcmp(blkdev_table[i].name, name) == 0) {
+            return &blkdev_table[i];
+        }
+    }
+    return NULL;
+}
+
+block_device_t* blkdev_get(int index) {
+    if (index < 0 || index >= BLKDEV_MAX_DEVICES || !blkdev_table[index].in_use) {
+        return NULL;
+    }
+    return &blkdev_table[index];
+}
+
+int blkdev_read(block_device_t *dev, uint64_t lba, uint32_t count, void *buf) {
+    int result = blkdev_check_range(dev, lba, count);
+    if (result != BLKDEV_SUCCESS || !buf) {
+        return buf ? result : BLKDEV_ERR_INVALID;
+    }
+
+    if (dev->cached) {
+        return bcache_read(dev, lba, count, buf);
+    }
+
+    return blk_rw(dev, BIO_READ, lba, count, buf);
+}
+
+int blkdev_write(block_device_t *dev, uint64_t lba, uint32_t count, const void *buf) {
+    int result = blkdev_check_range(dev, lba, count);
+    if (result != BLKDEV_SUCCESS || !buf) {
+        return buf ? result : BLKDEV_ERR_INVALID;
+    }
+
+    if (!dev->ops->write_sectors && !dev->ops->submit) {
+        return BLKDEV_ERR_IO;
+    }
+
+    if (dev->cached) {
+        return bcache_write(dev, lba, count, buf);
+    }
+
+    return blk_rw(dev, BIO_WRITE, lba, count, (void *)buf);
+}
+
+int blkdev_prefetch(block_device_t *dev, uint64_t lba, uint32_t count) {
+    int result = blkdev_check_range(dev, lba, count);
+    if (result != BLKDEV_SUCCESS) {
+        return result;
+    }
+
+    if (!dev->cached) {
+        return BLKDEV_SUCCESS;
+    }
+
+    return bcache_prefetch(dev, lba, count);
+}
+
+int blkdev_flush(block_device_t *dev) {
+    if (!dev || !dev->in_use) {
+        return BLKDEV_ERR_INVALID;
+    }
+
+    int result = BLKDEV_SUCCESS;
+
+    if (dev->cached) {
+        result = bcache_sync(dev);
+    }
+
+    if (dev->ops->flush && dev->ops->flush(dev->data) != 0) {
+        result = BLKDEV_ERR_IO;
+    }
+
+    return result;
+}
@@ -0,0 +1,182 @@
+/**
+ * AAAos Kernel - Block Device Layer
+ *
+ * Generic interface between filesystems and storage drivers.
+ * Drivers (AHCI, ...) register each disk as a block device with a set of
+ * sector-level operations. Filesystems mount a block device and access it
+ * through blkdev_ops, which routes I/O through the buffer cache and the
+ * device's request queue (bio.h).
+ */
+
+#ifndef _AAAOS_BLKDEV_H
+#define _AAAOS_BLKDEV_H
+
+#include "../../kernel/include/types.h"
+
+struct blk_request;
+struct blk_queue;
+
+/* Block device constants */
+#define BLKDEV_MAX_DEVICES      16      /* Maximum registered block devices */
+#define BLKDEV_NAME_MAX         16      /* Maximum device name length */
+#define BLKDEV_SECTOR_SIZE      512     /* Logical sector size */
+
+/* Error codes */
+#define BLKDEV_SUCCESS          0
+#define BLKDEV_ERR_INVALID      (-1)    /* Invalid argument */
+#define BLKDEV_ERR_IO           (-2)    /* Device I/O failed */
+#define BLKDEV_ERR_NO_MEMORY    (-3)    /* Out of memory */
+#define BLKDEV_ERR_FULL         (-4)    /* Device table full */
+#define BLKDEV_ERR_RANGE        (-5)    /* Access beyond end of device */
+
+/**
+ * Block device operations interface
+ * Abstraction layer for reading/writing sectors to storage
+ */
+typedef struct {
+    /**
+     * Read sectors from device
+     * @param device Device-specific data
+     * @param lba Logical Block Address (sector number)
+     * @param count Number of sectors to read
+     * @param buffer Buffer to read into
+     * @return 0 on success, negative error code on failure
+     */
+    int (*read_sectors)(void *device, uint64_t lba, uint32_t count, void *buffer);
+
+    /**
+     * Write sectors to device
+     * @param device Device-specific data
+     * @param lba Logical Block Address (sector number)
+     * @param count Number of sectors to write
+     * @param buffer Buffer to write from
+     * @return 0 on success, negative error code on failure
+     */
+    int (*write_sectors)(void *device, uint64_t lba, uint32_t count, const void *buffer);
+
+    /**
+     * Flush pending writes to device
+     * @param device Device-specific data
+     * @return 0 on success, negative error code on failure
+     */
+    int (*flush)(void *device);
+
+    /**
+     * Start loading sectors that will be read soon (optional)
+     * @param device Device-specific data
+     * @param lba Logical Block Address (sector number)
+     * @param count Number of sectors
+     * @return 0 on success, negative error code on failure
+     */
+    int (*prefetch)(void *device, uint64_t lba, uint32_t count);
+
+    /**
+     * Start a request from the block request layer (optional)
+     * The driver reports completion with blk_end_request(). Drivers
+     * without this operation are driven through read/write_sectors.
+     * @param device Device-specific data
+     * @param rq Request (a chain of bios covering consecutive sectors)
+     * @return 0 if started, negative error code on failure
+     */
+    int (*submit)(void *device, struct blk_request *rq);
+
+    /**
+     * Reap finished requests without waiting for an interrupt (optional)
+     * @param device Device-specific data
+     * @return true if completions are only found by polling, false if
+     *         the driver signals them by interrupt
+     */
+    bool (*poll)(void *device);
+} block_ops_t;
+
+/**
+ * Registered block device
+ */
+typedef struct block_device {
+    char            name[BLKDEV_NAME_MAX];  /* Device name (e.g., "sata0") */
+    block_ops_t     *ops;                   /* Driver operations */
+    void            *data;                  /* Driver cookie passed to ops */
+    uint64_t        sector_count;           /* Size in sectors (0 if unknown) */
+    struct blk_queue *queue;                /* Request queue (bio.h) */
+    bool            cached;                 /* Route I/O through buffer cache */
+    bool            in_use;                 /* Slot is in use */
+} block_device_t;
+
+/**
+ * Block operations for registered devices
+ * The device argument is a block_device_t pointer. Filesystems pass this
+ * table to their mount routine; reads and writes go through the cache.
+ */
+extern block_ops_t blkdev_ops;
+
+/**
+ * Register a block device
+ * @param name Device name
+ * @param ops Driver operations
+ * @param data Driver cookie passed as the device argument of ops
+ * @param sector_count Device size in sectors (0 if unknown)
+ * @return Registered device, or NULL on failure
+ */
+block_device_t* blkdev_register(const char *name, block_ops_t *ops, void *data,
+                                uint64_t sector_count);
+
+/**
+ * Unregister a block device
+ * Writes back and drops any cached blocks first.
+ * @param dev Device to unregister
+ * @return BLKDEV_SUCCESS on success, negative error code on failure
+ */
+int blkdev_unregister(block_device_t *dev);
+
+/**
+ * Find a block device by name
+ * @param name Device name
+ * @return Device, or NULL if not found
+ */
+block_device_t* blkdev_find(const char *name);
+
+/**
+ * Get a block device by index
+ * @param index Index into the device table
+ * @return Device, or NULL if the slot is empty or invalid
+ */
+block_device_t* blkdev_get(int index);
+
+/**
+ * Read sectors through the buffer cache
+ * @param dev Block device
+ * @param lba Starting sector
+ * @param count Number of sectors
+ * @param buf Destination buffer
+ * @return BLKDEV_SUCCESS on success, negative error code on failure
+ */
+int blkdev_read(block_device_t *dev, uint64_t lba, uint32_t count, void *buf);
+
+/**
+ * Write sectors through the buffer cache
+ * @param dev Block device
+ * @param lba Starting sector
+ * @param count Number of sectors
+ * @param buf Source buffer
+ * @return BLKDEV_SUCCESS on success, negative error code on failure
+ */
+int blkdev_write(block_device_t *dev, uint64_t lba, uint32_t count, const void *buf);
+
+/**
+ * Read sectors ahead of use into the buffer cache
+ * Does nothing for uncached devices.
+ * @param dev Block device
+ * @param lba Starting sector
+ * @param count Number of sectors
+ * @return BLKDEV_SUCCESS on success, negative error code on failure
+ */
+int blkdev_prefetch(block_device_t *dev, uint64_t lba, uint32_t count);
+
+/**
+ * Write back cached data and flush the device's write cache
+ * @param dev Block device
+ * @return BLKDEV_SUCCESS on success, negative error code on failure
+ */
+int blkdev_flush(block_device_t *dev);
+
+#endif /* _AAAOS_BLKDEV_H */
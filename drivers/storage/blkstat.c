@@ -0,0 +1,228 @@
+/**
+ * AAAos Kernel - Block Device Statistics
+ *
+ * Text formatting of the per-device counters and latency histograms kept
+ * by the request layer (bio.c). Latencies are measured in TSC cycles and
+ * converted to microseconds here, off the I/O path.
+ */
+
+#include "bio.h"
+#include "../../kernel/include/trace.h"
+#include "../timer/pit.h"
+
+#define BLK_HIST_BAR_WIDTH      32
+#define BLK_CALIBRATE_MS        20
+
+/**
+ * Text being built
+ */
+typedef struct {
+    char    *buf;
+    size_t  size;
+    size_t  len;
+} blk_text_t;
+
+/* TSC cycles per millisecond (0 until calibrated) */
+static uint64_t blk_tsc_khz = 0;
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================ */
+
+static void blk_text_putc(blk_text_t *t, char c) {
+    if (t->len + 1 < t->size) {
+        t->buf[t->len++] = c;
+        t->buf[t->len] = '\0';
+    }
+}
+
+static void blk_text_puts(blk_text_t *t, const char *s) {
+    while (*s) {
+        blk_text_putc(t, *s++);
+    }
+}
+
+/**
+ * Append an unsigned number, right-aligned in width columns
+ */
+static void blk_text_putu(blk_text_t *t, uint64_t value, int width) {
+    char tmp[24];
+    int n = 0;
+
+    do {
+        tmp[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+
+    while (width-- > n) {
+        blk_text_putc(t, ' ');
+    }
+    while (n > 0) {
+        blk_text_putc(t, tmp[--n]);
+    }
+}
+
+/**
+ * Measure the TSC rate against the PIT
+ * Needs the PIT interrupt running; gives up (returns 0) if uptime does
+ * not advance.
+ */
+static uint64_t blk_calibrate_tsc(void) {
+    if (blk_tsc_khz != 0) {
+        return blk_tsc_khz;
+    }
+
+    /* Start on a tick edge; about a second of cycles without one means
+     * the PIT is not ticking */
+    uint64_t limit = trace_clock() + (1ULL << 32);
+    uint64_t start_ms = pit_get_uptime_ms();
+    uint64_t ms;
+
+    while ((ms = pit_get_uptime_ms()) == start_ms) {
+        if (trace_clock() > limit) {
+            return 0;
+        }
+        __asm__ __volatile__("pause");
+    }
+
+    uint64_t start_tsc = trace_clock();
+    uint64_t end_ms = ms + BLK_CALIBRATE_MS;
+
+    while (pit_get_uptime_ms() < end_ms) {
+        __asm__ __volatile__("pause");
+    }
+
+    blk_tsc_khz = (trace_clock() - start_tsc) / BLK_CALIBRATE_MS;
+    return blk_tsc_khz;
+}
+
+/**
+ * Convert TSC cycles to the display unit
+ */
+static uint64_t blk_cycles_to_units(uint64_t cycles, uint64_t khz) {
+    return khz ? cycles * 1000 / khz : cycles;
+}
+
+/**
+ * Append one direction's counters and latency histogram
+ */
+static void blk_show_dir(blk_text_t *t, const char *name, const blk_dir_stats_t *ds,
+                         uint64_t khz) {
+    const char *unit = khz ? "us" : "cycles";
+
+    blk_text_puts(t, "  ");
+    blk_text_puts(t, name);
+    blk_text_puts(t, ": ");
+    blk_text_putu(t, ds->ios, 0);
+    blk_text_puts(t, " ios, ");
+    blk_text_putu(t, ds->sectors, 0);
+    blk_text_puts(t, " sectors, ");
+    blk_text_putu(t, ds->merges, 0);
+    blk_text_puts(t, " merges, ");
+    blk_text_putu(t, ds->errors, 0);
+    blk_text_puts(t, " errors\n");
+
+    if (ds->ios == 0) {
+        return;
+    }
+
+    blk_text_puts(t, "  ");
+    blk_text_puts(t, name);
+    blk_text_puts(t, " latency (");
+    blk_text_puts(t, unit);
+    blk_text_puts(t, "): avg ");
+    blk_text_putu(t, blk_cycles_to_units(ds->lat_total / ds->ios, khz), 0);
+    blk_text_puts(t, ", max ");
+    blk_text_putu(t, blk_cycles_to_units(ds->lat_max, khz), 0);
+    blk_text_putc(t, '\n');
+
+    int first = -1;
+    int last = -1;
+    uint64_t peak = 0;
+
+    for (int i = 0; i < BLK_LAT_BUCKETS; i++) {
+        if (ds->lat_hist[i] == 0) {
+            continue;
+        }
+        if (first < 0) {
+            first = i;
+        }
+        last = i;
+        peak = MAX(peak, ds->lat_hist[i]);
+    }
+
+    for (int i = first; i >= 0 && i <= last; i++) {
+        uint64_t count = ds->lat_hist[i];
+
+        blk_text_puts(t, "    ");
+        blk_text_putu(t, blk_cycles_to_units(1ULL << i, khz), 10);
+        blk_text_puts(t, " - ");
+        blk_text_putu(t, blk_cycles_to_units(1ULL << (i + 1), khz), 10);
+        blk_text_puts(t, " | ");
+        blk_text_putu(t, count, 8);
+        blk_text_putc(t, ' ');
+
+        uint64_t bar = (count * BLK_HIST_BAR_WIDTH + peak - 1) / peak;
+        while (bar-- > 0) {
+            blk_text_putc(t, '*');
+        }
+        blk_text_putc(t, '\n');
+    }
+}
+
+/* ============================================================================
+ * Public API
+ * ============================================================================ */
+
+size_t blk_stats_show(block_device_t *dev, char *buf, size_t size) {
+    blk_stats_t st;
+
+    if (!buf || size == 0) {
+        return 0;
+    }
+    buf[0] = '\0';
+
+    if (blk_get_stats(dev, &st) != BLKDEV_SUCCESS) {
+        return 0;
+    }
+
+    blk_text_t t = { buf, size, 0 };
+    uint64_t khz = blk_calibrate_tsc();
+    uint64_t elapsed = trace_clock() - st.since;
+
+    blk_text_puts(&t, dev->name);
+    blk_text_puts(&t, " (");
+    blk_text_puts(&t, dev->queue->sched->name);
+    blk_text_puts(&t, ")\n");
+
+    blk_show_dir(&t, "read", &st.dir[BIO_READ], khz);
+    blk_show_dir(&t, "write", &st.dir[BIO_WRITE], khz);
+
+    blk_text_puts(&t, "  bios ");
+    blk_text_putu(&t, st.bios, 0);
+    blk_text_puts(&t, ", dispatched ");
+    blk_text_putu(&t, st.dispatched, 0);
+    blk_text_puts(&t, ", in flight ");
+    blk_text_putu(&t, st.in_flight, 0);
+    blk_text_puts(&t, ", queued ");
+    blk_text_putu(&t, st.queued, 0);
+    blk_text_putc(&t, '\n');
+
+    blk_text_puts(&t, "  busy ");
+    if (khz) {
+        blk_text_putu(&t, st.busy / khz, 0);
+        blk_text_puts(&t, " of ");
+        blk_text_putu(&t, elapsed / khz, 0);
+        blk_text_puts(&t, " ms");
+    } else {
+        blk_text_putu(&t, st.busy, 0);
+        blk_text_puts(&t, " of ");
+        blk_text_putu(&t, elapsed, 0);
+        blk_text_puts(&t, " cycles");
+    }
+    blk_text_puts(&t, " (");
+    blk_text_putu(&t, elapsed ? st.busy * 100 / elapsed : 0, 0);
+    blk_text_puts(&t, "% utilized)\n");
+
+    return t.len;
+}
@@ -0,0 +1,191 @@
+/**
+ * AAAos Kernel - I/O Schedulers
+ *
+ * Dispatch ordering policies for block request queues:
+ * - noop: first in, first out; relies on merging alone
+ * - deadline: sweeps each direction in ascending sector order, preferring
+ *   reads, but serves a request first once it has waited past its expiry
+ *
+ * Scheduler callbacks run with the queue lock held.
+ */
+
+#include "bio.h"
+#include "../timer/pit.h"
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================ */
+
+/**
+ * Append a request to a direction's FIFO
+ */
+static void iosched_fifo_add(blk_sched_data_t *sd, int dir, blk_request_t *rq) {
+    rq->fifo_next = NULL;
+    if (sd->fifo_tail[dir]) {
+        sd->fifo_tail[dir]->fifo_next = rq;
+    } else {
+        sd->fifo[dir] = rq;
+    }
+    sd->fifo_tail[dir] = rq;
+}
+
+/**
+ * Unlink a request from a direction's FIFO
+ */
+static void iosched_fifo_remove(blk_sched_data_t *sd, int dir, blk_request_t *rq) {
+    blk_request_t *prev = NULL;
+
+    for (blk_request_t *it = sd->fifo[dir]; it; prev = it, it = it->fifo_next) {
+        if (it != rq) {
+            continue;
+        }
+        if (prev) {
+            prev->fifo_next = rq->fifo_next;
+        } else {
+            sd->fifo[dir] = rq->fifo_next;
+        }
+        if (sd->fifo_tail[dir] == rq) {
+            sd->fifo_tail[dir] = prev;
+        }
+        break;
+    }
+    rq->fifo_next = NULL;
+}
+
+/* ============================================================================
+ * noop
+ * ============================================================================ */
+
+static void noop_init(blk_queue_t *q) {
+    q->sd.fifo[0] = NULL;
+    q->sd.fifo_tail[0] = NULL;
+}
+
+static void noop_add(blk_queue_t *q, blk_request_t *rq) {
+    iosched_fifo_add(&q->sd, 0, rq);
+}
+
+static blk_request_t* noop_dispatch(blk_queue_t *q) {
+    blk_request_t *rq = q->sd.fifo[0];
+    if (rq) {
+        iosched_fifo_remove(&q->sd, 0, rq);
+    }
+    return rq;
+}
+
+const blk_sched_ops_t blk_sched_noop = {
+    .name       = "noop",
+    .init       = noop_init,
+    .add        = noop_add,
+    .dispatch   = noop_dispatch,
+};
+
+/* ============================================================================
+ * deadline
+ * ============================================================================ */
+
+static void deadline_init(blk_queue_t *q) {
+    blk_sched_data_t *sd = &q->sd;
+
+    for (int dir = 0; dir < 2; dir++) {
+        sd->sort[dir] = NULL;
+        sd->fifo[dir] = NULL;
+        sd->fifo_tail[dir] = NULL;
+    }
+    sd->batch = 0;
+    sd->dir = BIO_READ;
+    sd->next_lba = 0;
+    sd->starved = 0;
+}
+
+static void deadline_add(blk_queue_t *q, blk_request_t *rq) {
+    blk_sched_data_t *sd = &q->sd;
+    blk_request_t **pp = &sd->sort[rq->op];
+
+    while (*pp && (*pp)->lba < rq->lba) {
+        pp = &(*pp)->sort_next;
+    }
+    rq->sort_next = *pp;
+    *pp = rq;
+
+    iosched_fifo_add(sd, rq->op, rq);
+}
+
+/**
+ * Find the first request at or after the sweep position
+ */
+static blk_request_t* deadline_seek(blk_sched_data_t *sd, int dir) {
+    blk_request_t *rq = sd->sort[dir];
+
+    while (rq && rq->lba < sd->next_lba) {
+        rq = rq->sort_next;
+    }
+    return rq;
+}
+
+static void deadline_remove(blk_sched_data_t *sd, blk_request_t *rq) {
+    blk_request_t **pp = &sd->sort[rq->op];
+
+    while (*pp) {
+        if (*pp == rq) {
+            *pp = rq->sort_next;
+            break;
+        }
+        pp = &(*pp)->sort_next;
+    }
+    rq->sort_next = NULL;
+
+    iosched_fifo_remove(sd, rq->op, rq);
+}
+
+static blk_request_t* deadline_dispatch(blk_queue_t *q) {
+    blk_sched_data_t *sd = &q->sd;
+    blk_request_t *rq = NULL;
+
+    /* Continue the current sweep while the batch lasts */
+    if (sd->batch > 0) {
+        rq = deadline_seek(sd, sd->dir);
+    }
+
+    if (!rq) {
+        bool reads = sd->sort[BIO_READ] != NULL;
+        bool writes = sd->sort[BIO_WRITE] != NULL;
+
+        /* Reads go first, but writes get a batch every few read batches */
+        if (reads && (!writes || sd->starved < BLK_DEADLINE_STARVED)) {
+            sd->dir = BIO_READ;
+            if (writes) {
+                sd->starved++;
+            }
+        } else if (writes) {
+            sd->dir = BIO_WRITE;
+            sd->starved = 0;
+        } else {
+            return NULL;
+        }
+
+        /* Start at an expired request, else continue upwards and wrap */
+        blk_request_t *oldest = sd->fifo[sd->dir];
+        if (oldest && oldest->deadline <= pit_get_uptime_ms()) {
+            rq = oldest;
+        } else {
+            rq = deadline_seek(sd, sd->dir);
+            if (!rq) {
+                rq = sd->sort[sd->dir];
+            }
+        }
+        sd->batch = BLK_DEADLINE_BATCH;
+    }
+
+    sd->batch--;
+    sd->next_lba = rq->lba + rq->count;
+    deadline_remove(sd, rq);
+    return rq;
+}
+
+const blk_sched_ops_t blk_sched_deadline = {
+    .name       = "deadline",
+    .init       = deadline_init,
+    .add        = deadline_add,
+    .dispatch   = deadline_dispatch,
+};
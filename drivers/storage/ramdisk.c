@@ -0,0 +1,311 @@
+/**
+ * AAAos Kernel - RAM Disk
+ */
+
+#include "ramdisk.h"
+#include "../../kernel/include/serial.h"
+#include "../../kernel/mm/pmm.h"
+#include "../../kernel/mm/vmm.h"
+#include "../../kernel/mm/heap.h"
+
+#define RAMDISK_SECTORS_PER_PAGE    (PAGE_SIZE / BLKDEV_SECTOR_SIZE)
+
+/**
+ * RAM disk state
+ */
+typedef struct {
+    char                name[BLKDEV_NAME_MAX];
+    uint64_t            sectors;            /* Size in sectors */
+    physaddr_t          *pages;             /* Backing page per 4 KB, 0 if never written */
+    uint64_t            page_count;
+    volatile uint64_t   pages_used;         /* Backing pages allocated */
+    block_device_t      *blkdev;
+    bool                in_use;
+} ramdisk_t;
+
+static ramdisk_t ramdisks[RAMDISK_MAX_DEVICES];
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================ */
+
+/*
+ * Data is moved with rep movsb/stosb, which current CPUs run at cache-line
+ * granularity; the byte loops used elsewhere would cap the disk well below
+ * memory bandwidth.
+ */
+static inline void ramdisk_memcpy(void *dest, const void *src, size_t n) {
+    __asm__ __volatile__("rep movsb"
+                         : "+D"(dest), "+S"(src), "+c"(n)
+                         :
+                         : "memory");
+}
+
+static inline void ramdisk_memzero(void *dest, size_t n) {
+    __asm__ __volatile__("rep stosb"
+                         : "+D"(dest), "+c"(n)
+                         : "a"(0)
+                         : "memory");
+}
+
+static bool ramdisk_is_zero(const uint8_t *p, size_t n) {
+    const uint64_t *q = (const uint64_t *)p;
+    for (size_t i = 0; i < n / sizeof(uint64_t); i++) {
+        if (q[i] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static inline uint8_t* ramdisk_page_virt(physaddr_t phys) {
+    return (uint8_t *)(VMM_KERNEL_PHYS_MAP + phys);
+}
+
+/**
+ * Get the backing page for a page index, allocating it if needed
+ * Concurrent writers may both allocate; the loser frees its page.
+ * @return Physical address, or 0 if out of memory
+ */
+static physaddr_t ramdisk_get_page(ramdisk_t *rd, uint64_t index) {
+    physaddr_t phys = rd->pages[index];
+    if (phys) {
+        return phys;
+    }
+
+    phys = pmm_alloc_page();
+    if (!phys) {
+        return 0;
+    }
+    ramdisk_memzero(ramdisk_page_virt(phys), PAGE_SIZE);
+
+    if (!__sync_bool_compare_and_swap(&rd->pages[index], 0, phys)) {
+        pmm_free_page(phys);
+        return rd->pages[index];
+    }
+
+    __sync_fetch_and_add(&rd->pages_used, 1);
+    return phys;
+}
+
+static ramdisk_t* ramdisk_from_blkdev(block_device_t *dev) {
+    for (int i = 0; dev && i < RAMDISK_MAX_DEVICES; i++) {
+        if (ramdisks[i].in_use && ramdisks[i].blkdev == dev) {
+            return &ramdisks[i];
+        }
+    }
+    return NULL;
+}
+
+static void ramdisk_release(ramdisk_t *rd) {
+    if (rd->pages) {
+        for (uint64_t i = 0; i < rd->page_count; i++) {
+            if (rd->pages[i]) {
+                pmm_free_page(rd->pages[i]);
+            }
+        }
+        kfree(rd->pages);
+    }
+
+    rd->pages = NULL;
+    rd->page_count = 0;
+    rd->pages_used = 0;
+    rd->blkdev = NULL;
+    rd->in_use = false;
+}
+
+/* ============================================================================
+ * Block Device Integration
+ * ============================================================================ */
+
+static int ramdisk_read(void *device, uint64_t lba, uint32_t count, void *buffer) {
+    ramdisk_t *rd = (ramdisk_t *)device;
+    uint8_t *dst = (uint8_t *)buffer;
+
+    if (!buffer || lba + count > rd->sectors) {
+        return BLKDEV_ERR_RANGE;
+    }
+
+    uint64_t offset = lba * BLKDEV_SECTOR_SIZE;
+    uint64_t remaining = (uint64_t)count * BLKDEV_SECTOR_SIZE;
+
+    while (remaining > 0) {
+        uint64_t index = offset / PAGE_SIZE;
+        size_t in_page = (size_t)(offset % PAGE_SIZE);
+        size_t chunk = (size_t)MIN(remaining, PAGE_SIZE - in_page);
+        physaddr_t phys = rd->pages[index];
+
+        if (phys) {
+            ramdisk_memcpy(dst, ramdisk_page_virt(phys) + in_page, chunk);
+        } else {
+            ramdisk_memzero(dst, chunk);
+        }
+
+        dst += chunk;
+        offset += chunk;
+        remaining -= chunk;
+    }
+
+    return BLKDEV_SUCCESS;
+}
+
+static int ramdisk_write(void *device, uint64_t lba, uint32_t count, const void *buffer) {
+    ramdisk_t *rd = (ramdisk_t *)device;
+    const uint8_t *src = (const uint8_t *)buffer;
+
+    if (!buffer || lba + count > rd->sectors) {
+        return BLKDEV_ERR_RANGE;
+    }
+
+    uint64_t offset = lba * BLKDEV_SECTOR_SIZE;
+    uint64_t remaining = (uint64_t)count * BLKDEV_SECTOR_SIZE;
+
+    while (remaining > 0) {
+        uint64_t index = offset / PAGE_SIZE;
+        size_t in_page = (size_t)(offset % PAGE_SIZE);
+        size_t chunk = (size_t)MIN(remaining, PAGE_SIZE - in_page);
+
+        physaddr_t phys = ramdisk_get_page(rd, index);
+        if (!phys) {
+            return BLKDEV_ERR_NO_MEMORY;
+        }
+        ramdisk_memcpy(ramdisk_page_virt(phys) + in_page, src, chunk);
+
+        src += chunk;
+        offset += chunk;
+        remaining -= chunk;
+    }
+
+    return BLKDEV_SUCCESS;
+}
+
+static int ramdisk_flush(void *device) {
+    UNUSED(device);
+    return BLKDEV_SUCCESS;
+}
+
+static block_ops_t ramdisk_ops = {
+    .read_sectors   = ramdisk_read,
+    .write_sectors  = ramdisk_write,
+    .flush          = ramdisk_flush,
+};
+
+/* ============================================================================
+ * Public API
+ * ============================================================================ */
+
+block_device_t* ramdisk_create(const char *name, uint64_t sectors) {
+    if (sectors == 0 || sectors > RAMDISK_MAX_SIZE / BLKDEV_SECTOR_SIZE) {
+        kprintf("[RAMDISK] Invalid size: %llu sectors\n", sectors);
+        return NULL;
+    }
+
+    ramdisk_t *rd = NULL;
+    int slot = 0;
+    for (; slot < RAMDISK_MAX_DEVICES; slot++) {
+        if (!ramdisks[slot].in_use) {
+            rd = &ramdisks[slot];
+            break;
+        }
+    }
+    if (!rd) {
+        kprintf("[RAMDISK] Too many RAM disks\n");
+        return NULL;
+    }
+
+    /* Default names follow the slot, so they are reused after destroy */
+    int len = 0;
+    if (name) {
+        while (name[len] && len < BLKDEV_NAME_MAX - 1) {
+            rd->name[len] = name[len];
+            len++;
+        }
+    } else {
+        rd->name[len++] = 'r';
+        rd->name[len++] = 'a';
+        rd->name[len++] = 'm';
+        rd->name[len++] = (char)('0' + slot);
+    }
+    rd->name[len] = '\0';
+
+    rd->sectors = sectors;
+    rd->page_count = (sectors + RAMDISK_SECTORS_PER_PAGE - 1) / RAMDISK_SECTORS_PER_PAGE;
+    rd->pages = (physaddr_t *)kcalloc(rd->page_count, sizeof(physaddr_t));
+    rd->pages_used = 0;
+    if (!rd->pages) {
+        kprintf("[RAMDISK] Out of memory for the page table of %s\n", rd->name);
+        return NULL;
+    }
+    rd->in_use = true;
+
+    rd->blkdev = blkdev_register(rd->name, &ramdisk_ops, rd, sectors);
+    if (!rd->blkdev) {
+        kprintf("[RAMDISK] Could not register %s\n", rd->name);
+        ramdisk_release(rd);
+        return NULL;
+    }
+
+    kprintf("[RAMDISK] %s: %llu sectors (%llu MB)\n",
+            rd->name, sectors, sectors * BLKDEV_SECTOR_SIZE / MB);
+    return rd->blkdev;
+}
+
+block_device_t* ramdisk_create_from_image(const char *name, const void *image, size_t size) {
+    if (!image || size == 0) {
+        return NULL;
+    }
+
+    uint64_t sectors = (size + BLKDEV_SECTOR_SIZE - 1) / BLKDEV_SECTOR_SIZE;
+    block_device_t *dev = ramdisk_create(name, sectors);
+    if (!dev) {
+        return NULL;
+    }
+
+    ramdisk_t *rd = (ramdisk_t *)dev->data;
+    const uint8_t *src = (const uint8_t *)image;
+
+    for (uint64_t index = 0; index < rd->page_count; index++) {
+        size_t offset = (size_t)(index * PAGE_SIZE);
+        size_t chunk = MIN(size - offset, (size_t)PAGE_SIZE);
+
+        /* Empty regions stay unallocated */
+        if (chunk == PAGE_SIZE && ramdisk_is_zero(src + offset, chunk)) {
+            continue;
+        }
+
+        physaddr_t phys = ramdisk_get_page(rd, index);
+        if (!phys) {
+            kprintf("[RAMDISK] Out of memory loading the image of %s\n", rd->name);
+            ramdisk_destroy(dev);
+            return NULL;
+        }
+        ramdisk_memcpy(ramdisk_page_virt(phys), src + offset, chunk);
+    }
+
+    kprintf("[RAMDISK] %s: loaded %llu KB image (%llu KB stored)\n",
+            rd->name, (uint64_t)size / KB, rd->pages_used * PAGE_SIZE / KB);
+    return dev;
+}
+
+int ramdisk_destroy(block_device_t *dev) {
+    ramdisk_t *rd = ramdisk_from_blkdev(dev);
+    if (!rd) {
+        return BLKDEV_ERR_INVALID;
+    }
+
+    blkdev_unregister(dev);
+    ramdisk_release(rd);
+    return BLKDEV_SUCCESS;
+}
+
+int ramdisk_get_usage(block_device_t *dev, uint64_t *bytes_used) {
+    ramdisk_t *rd = ramdisk_from_blkdev(dev);
+    if (!rd) {
+        return BLKDEV_ERR_INVALID;
+    }
+
+    if (bytes_used) {
+        *bytes_used = rd->pages_used * PAGE_SIZE;
+    }
+    return BLKDEV_SUCCESS;
+}
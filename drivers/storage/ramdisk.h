@@ -0,0 +1,58 @@
+/**
+ * AAAos Kernel - RAM Disk
+ *
+ * Block devices backed by kernel memory, registered as "ram0", "ram1", ...
+ * They run the filesystems, the buffer cache and the request layer
+ * without any storage hardware: for benchmarking those layers in
+ * isolation and as fast scratch volumes.
+ *
+ * Backing pages are allocated on first write and unwritten sectors read
+ * as zeros, so a large, mostly empty disk costs little memory. A disk can
+ * be created empty or from an in-memory image (e.g. a preformatted FAT32
+ * volume); the image is copied, so it may be freed afterwards.
+ */
+
+#ifndef _AAAOS_RAMDISK_H
+#define _AAAOS_RAMDISK_H
+
+#include "../../kernel/include/types.h"
+#include "blkdev.h"
+
+#define RAMDISK_MAX_DEVICES     4
+#define RAMDISK_MAX_SIZE        (2ULL * GB)     /* Largest disk */
+
+/**
+ * Create an empty RAM disk
+ * @param name Device name, or NULL for the next "ramN"
+ * @param sectors Size in 512-byte sectors
+ * @return Registered block device, or NULL on failure
+ */
+block_device_t* ramdisk_create(const char *name, uint64_t sectors);
+
+/**
+ * Create a RAM disk holding a copy of an image
+ * The size is rounded up to whole sectors; all-zero pages of the image
+ * are not stored.
+ * @param name Device name, or NULL for the next "ramN"
+ * @param image Disk image
+ * @param size Image size in bytes
+ * @return Registered block device, or NULL on failure
+ */
+block_device_t* ramdisk_create_from_image(const char *name, const void *image, size_t size);
+
+/**
+ * Unregister a RAM disk and free its memory
+ * @param dev Device returned by ramdisk_create*
+ * @return BLKDEV_SUCCESS, or BLKDEV_ERR_INVALID if dev is not a RAM disk
+ */
+int ramdisk_destroy(block_device_t *dev);
+
+/**
+ * Get the memory backing a RAM disk
+ * @param dev Block device
+ * @param bytes_used Output: bytes of backing pages allocated (may be NULL)
+ * @return BLKDEV_SUCCESS, or BLKDEV_ERR_INVALID if dev is not a RAM disk
+ */
+int ramdisk_get_usage(block_device_t *dev, uint64_t *bytes_used);
+
+#endif /* _AAAOS_RAMDISK_H */
@@ -0,0 +1,666 @@
+/**
+ * AAAos Kernel - Virtio Block Driver
+ */
+
+#include "virtio_blk.h"
+#include "blkdev.h"
+#include "bio.h"
+#include "../../kernel/include/serial.h"
+#include "../../kernel/mm/pmm.h"
+#include "../../kernel/mm/vmm.h"
+#include "../../kernel/mm/heap.h"
+#include "../../kernel/arch/x86_64/include/idt.h"
+#include "../../kernel/sched/scheduler.h"
+#include "../../kernel/proc/process.h"
+
+#define VIRTIO_BLK_RFLAGS_IF        (1ULL << 9)
+#define VIRTIO_BLK_DEFAULT_SEG_SIZE (4 * MB)    /* Segment limit without SIZE_MAX */
+
+struct virtio_blk_dev;
+
+/**
+ * One request in flight
+ * Occupies a page of its own: the descriptor table comes first so it is
+ * suitably aligned, and header and status are reached by DMA at known
+ * offsets from the page's physical address.
+ */
+typedef struct virtio_blk_req {
+    virtq_desc_t            table[VIRTIO_BLK_REQ_DESCS];
+    virtio_blk_outhdr_t     hdr;            /* Device reads */
+    volatile uint8_t        status;         /* Device writes */
+
+    struct virtio_blk_dev   *dev;
+    physaddr_t              phys;           /* Physical address of this page */
+    uint16_t                ndesc;          /* Entries of table in use */
+    blk_request_t           *rq;            /* Block layer request (NULL if synchronous) */
+    process_t               *waiter;        /* Synchronous caller sleeping */
+    volatile bool           complete;
+    struct virtio_blk_req   *next;          /* Pending / completed list */
+    volatile int            in_use;         /* Pool slot taken */
+} virtio_blk_req_t;
+
+/**
+ * Virtqueue with its lock and the requests waiting for descriptors
+ */
+typedef struct {
+    virtqueue_t             vq;
+    virtio_blk_req_t        *pending;
+    virtio_blk_req_t        *pending_tail;
+    volatile int            lock;
+} virtio_blk_queue_t;
+
+/**
+ * Virtio disk
+ */
+typedef struct virtio_blk_dev {
+    virtio_device_t         vdev;
+    virtio_blk_queue_t      queues[VIRTIO_BLK_MAX_QUEUES];
+    uint16_t                num_queues;
+    volatile uint32_t       next_queue;     /* Round-robin cursor */
+
+    uint64_t                capacity;       /* 512-byte sectors */
+    uint32_t                seg_size;       /* Largest data descriptor */
+    uint32_t                max_segs;       /* Data descriptors per request */
+    bool                    readonly;
+
+    virtio_blk_req_t        *pool[BLK_QUEUE_DEPTH];
+    block_device_t          *blkdev;
+    char                    name[BLKDEV_NAME_MAX];
+} virtio_blk_dev_t;
+
+static virtio_blk_dev_t *virtio_blk_devices[VIRTIO_BLK_MAX_DEVICES];
+static int virtio_blk_device_count = 0;
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================ */
+
+static inline uint64_t virtio_blk_lock(virtio_blk_queue_t *q) {
+    uint64_t flags;
+    __asm__ __volatile__("pushfq; pop %0; cli" : "=r"(flags) : : "memory");
+    while (__sync_lock_test_and_set(&q->lock, 1)) {
+        __asm__ __volatile__("pause");
+    }
+    return flags;
+}
+
+static inline void virtio_blk_unlock(virtio_blk_queue_t *q, uint64_t flags) {
+    __sync_lock_release(&q->lock);
+    if (flags & VIRTIO_BLK_RFLAGS_IF) {
+        __asm__ __volatile__("sti");
+    }
+}
+
+static void virtio_blk_memset(void *dest, int val, size_t count) {
+    uint8_t *d = (uint8_t*)dest;
+    while (count--) {
+        *d++ = (uint8_t)val;
+    }
+}
+
+static void virtio_blk_delay(uint32_t microseconds) {
+    volatile uint32_t count = microseconds * 100;
+    while (count--) {
+        __asm__ __volatile__("pause");
+    }
+}
+
+/**
+ * Translate a kernel virtual address for DMA
+ * @return Physical address, or 0 if not mapped
+ */
+static physaddr_t virtio_blk_dma_addr(virtaddr_t virt) {
+    if (virt >= VMM_KERNEL_PHYS_MAP && virt < VMM_KERNEL_BASE) {
+        return (physaddr_t)(virt - VMM_KERNEL_PHYS_MAP);
+    }
+    return vmm_get_physical(virt);
+}
+
+/**
+ * Allocate a request page
+ */
+static virtio_blk_req_t* virtio_blk_req_alloc(virtio_blk_dev_t *dev) {
+    physaddr_t phys = pmm_alloc_page();
+    if (!phys) {
+        return NULL;
+    }
+
+    virtio_blk_req_t *req = (virtio_blk_req_t*)(VMM_KERNEL_PHYS_MAP + phys);
+    virtio_blk_memset(req, 0, sizeof(*req));
+    req->dev = dev;
+    req->phys = phys;
+    return req;
+}
+
+/**
+ * Physical address of a field of a request
+ */
+static inline physaddr_t virtio_blk_req_phys(virtio_blk_req_t *req, volatile void *field) {
+    return req->phys + ((virtaddr_t)field - (virtaddr_t)req);
+}
+
+static void virtio_blk_req_free(virtio_blk_req_t *req) {
+    pmm_free_page(req->phys);
+}
+
+/**
+ * Append a data buffer to a request's table
+ * Pages are translated one at a time and physically adjacent pages share
+ * a descriptor of up to dev->seg_size bytes.
+ * @return true on success, false if unmapped or out of descriptors
+ */
+static bool virtio_blk_add_buffer(virtio_blk_req_t *req, void *buf, uint32_t size, bool write) {
+    virtio_blk_dev_t *dev = req->dev;
+    virtaddr_t virt = (virtaddr_t)buf;
+    uint16_t first = req->ndesc;
+    uint16_t flags = write ? 0 : VIRTQ_DESC_F_WRITE;   /* Reads fill the buffer */
+
+    while (size > 0) {
+        uint32_t chunk;
+        if (virt >= VMM_KERNEL_PHYS_MAP && virt < VMM_KERNEL_BASE) {
+            chunk = MIN(size, dev->seg_size);
+        } else {
+            chunk = MIN(size, PAGE_SIZE - (uint32_t)(virt & (PAGE_SIZE - 1)));
+        }
+
+        physaddr_t phys = virtio_blk_dma_addr(virt);
+        if (phys == 0) {
+            return false;
+        }
+
+        virtq_desc_t *last = (req->ndesc > first) ? &req->table[req->ndesc - 1] : NULL;
+        if (last && last->addr + last->len == phys && last->len + chunk <= dev->seg_size) {
+            last->len += chunk;
+        } else {
+            if (req->ndesc - 1u >= dev->max_segs) {
+                return false;
+            }
+            virtq_desc_t *d = &req->table[req->ndesc++];
+            d->addr = phys;
+            d->len = chunk;
+            d->flags = flags;
+        }
+
+        virt += chunk;
+        size -= chunk;
+    }
+
+    return true;
+}
+
+/**
+ * Start a request's table: the header descriptor
+ */
+static void virtio_blk_req_start(virtio_blk_req_t *req, uint32_t type, uint64_t sector) {
+    req->hdr.type = type;
+    req->hdr.reserved = 0;
+    req->hdr.sector = sector;
+    req->status = 0xFF;
+    req->complete = false;
+    req->waiter = NULL;
+    req->next = NULL;
+
+    req->table[0].addr = virtio_blk_req_phys(req, &req->hdr);
+    req->table[0].len = sizeof(virtio_blk_outhdr_t);
+    req->table[0].flags = 0;
+    req->ndesc = 1;
+}
+
+/**
+ * Finish a request's table: the status descriptor
+ */
+static void virtio_blk_req_end(virtio_blk_req_t *req) {
+    virtq_desc_t *d = &req->table[req->ndesc++];
+    d->addr = virtio_blk_req_phys(req, &req->status);
+    d->len = 1;
+    d->flags = VIRTQ_DESC_F_WRITE;
+}
+
+/**
+ * Queue pending requests that now fit and notify the device
+ * Called with the queue lock held.
+ */
+static void virtio_blk_queue_run(virtio_blk_queue_t *q) {
+    while (q->pending) {
+        virtio_blk_req_t *req = q->pending;
+        if (virtqueue_add(&q->vq, req->table, req->phys, req->ndesc, req) != VIRTIO_SUCCESS) {
+            break;
+        }
+        q->pending = req->next;
+        req->next = NULL;
+    }
+    if (!q->pending) {
+        q->pending_tail = NULL;
+    }
+
+    virtqueue_kick(&q->vq);
+}
+
+/**
+ * Take finished requests off a queue and start waiting ones
+ * Called with the queue lock held.
+ * @return Finished requests, to be completed once the lock is dropped
+ */
+static virtio_blk_req_t* virtio_blk_queue_reap(virtio_blk_queue_t *q) {
+    virtio_blk_req_t *list = NULL;
+    virtio_blk_req_t *tail = NULL;
+    virtio_blk_req_t *req;
+
+    do {
+        while ((req = (virtio_blk_req_t*)virtqueue_get_used(&q->vq, NULL)) != NULL) {
+            req->next = NULL;
+            if (tail) {
+                tail->next = req;
+            } else {
+                list = req;
+            }
+            tail = req;
+        }
+    } while (q->vq.cb_enabled && !virtqueue_enable_cb(&q->vq));
+
+    if (list && q->pending) {
+        virtio_blk_queue_run(q);
+    }
+    return list;
+}
+
+/**
+ * Wake a thread sleeping on a request
+ */
+static void virtio_blk_wake(process_t *proc) {
+    if (proc->state == PROCESS_STATE_BLOCKED) {
+        process_set_state(proc, PROCESS_STATE_READY);
+        scheduler_add(proc);
+    }
+}
+
+/**
+ * Complete reaped requests: end block layer requests and wake sleepers
+ */
+static void virtio_blk_finish(virtio_blk_req_t *list) {
+    while (list) {
+        virtio_blk_req_t *req = list;
+        list = req->next;
+        req->next = NULL;
+
+        if (req->rq) {
+            blk_request_t *rq = req->rq;
+            int status = (req->status == VIRTIO_BLK_S_OK) ? BLKDEV_SUCCESS : BLKDEV_ERR_IO;
+
+            req->rq = NULL;
+            __sync_lock_release(&req->in_use);
+            blk_end_request(rq, status);
+            continue;
+        }
+
+        /* The synchronous submitter may free the request once complete is set */
+        process_t *waiter = req->waiter;
+        __sync_synchronize();
+        req->complete = true;
+        if (waiter) {
+            virtio_blk_wake(waiter);
+        }
+    }
+}
+
+/**
+ * Reap every queue of a disk
+ */
+static void virtio_blk_reap_all(virtio_blk_dev_t *dev) {
+    for (uint16_t i = 0; i < dev->num_queues; i++) {
+        virtio_blk_queue_t *q = &dev->queues[i];
+        uint64_t flags = virtio_blk_lock(q);
+        virtio_blk_req_t *list = virtio_blk_queue_reap(q);
+        virtio_blk_unlock(q, flags);
+        virtio_blk_finish(list);
+    }
+}
+
+/**
+ * Interrupt callback from the virtio core
+ */
+static void virtio_blk_irq(virtio_device_t *vdev, uint8_t isr) {
+    if (isr & VIRTIO_ISR_QUEUE) {
+        virtio_blk_reap_all((virtio_blk_dev_t*)vdev->driver);
+    }
+}
+
+/**
+ * Hand a built request to a virtqueue
+ * Queues are taken round-robin; a request that fits in none waits on
+ * its queue's pending list until completions free descriptors.
+ * @return The queue used
+ */
+static virtio_blk_queue_t* virtio_blk_queue_req(virtio_blk_dev_t *dev, virtio_blk_req_t *req) {
+    uint32_t start = __sync_fetch_and_add(&dev->next_queue, 1) % dev->num_queues;
+
+    for (uint16_t n = 0; n < dev->num_queues; n++) {
+        virtio_blk_queue_t *q = &dev->queues[(start + n) % dev->num_queues];
+        uint64_t flags = virtio_blk_lock(q);
+
+        if (!q->pending && virtqueue_can_add(&q->vq, req->ndesc)) {
+            virtqueue_add(&q->vq, req->table, req->phys, req->ndesc, req);
+            virtqueue_kick(&q->vq);
+            virtio_blk_unlock(q, flags);
+            return q;
+        }
+        virtio_blk_unlock(q, flags);
+    }
+
+    virtio_blk_queue_t *q = &dev->queues[start];
+    uint64_t flags = virtio_blk_lock(q);
+    if (q->pending_tail) {
+        q->pending_tail->next = req;
+    } else {
+        q->pending = req;
+    }
+    q->pending_tail = req;
+
+    /* Completions may have freed space since the check above */
+    virtio_blk_queue_run(q);
+    virtio_blk_unlock(q, flags);
+    return q;
+}
+
+/**
+ * Check whether the caller can sleep until a completion interrupt
+ */
+static bool virtio_blk_can_sleep(virtio_blk_dev_t *dev) {
+    uint64_t flags;
+    __asm__ __volatile__("pushfq; pop %0" : "=r"(flags));
+
+    return dev->vdev.irq_enabled && (flags & VIRTIO_BLK_RFLAGS_IF) &&
+           scheduler_is_running() && process_get_current() != NULL;
+}
+
+/**
+ * Run a request outside the block layer and wait for it
+ */
+static int virtio_blk_do_sync(virtio_blk_dev_t *dev, uint32_t type, uint64_t lba,
+                              uint32_t count, void *buf) {
+    if (count > 0 && lba + count > dev->capacity) {
+        return BLKDEV_ERR_RANGE;
+    }
+    if (type == VIRTIO_BLK_T_OUT && dev->readonly) {
+        return BLKDEV_ERR_IO;
+    }
+
+    virtio_blk_req_t *req = virtio_blk_req_alloc(dev);
+    if (!req) {
+        return BLKDEV_ERR_NO_MEMORY;
+    }
+
+    virtio_blk_req_start(req, type, lba);
+    if (count > 0 &&
+        !virtio_blk_add_buffer(req, buf, count * VIRTIO_BLK_SECTOR_SIZE,
+                               type == VIRTIO_BLK_T_OUT)) {
+        virtio_blk_req_free(req);
+        return BLKDEV_ERR_INVALID;
+    }
+    virtio_blk_req_end(req);
+
+    virtio_blk_queue_t *q = virtio_blk_queue_req(dev, req);
+
+    while (!req->complete) {
+        if (virtio_blk_can_sleep(dev)) {
+            /* Checked under the lock so the interrupt cannot slip in between */
+            uint64_t flags = virtio_blk_lock(q);
+            if (!req->complete) {
+                req->waiter = process_get_current();
+                process_set_state(req->waiter, PROCESS_STATE_BLOCKED);
+            }
+            virtio_blk_unlock(q, flags);
+            scheduler_yield();
+            continue;
+        }
+
+        virtio_blk_reap_all(dev);
+        if (!req->complete) {
+            virtio_blk_delay(1);
+        }
+    }
+
+    int result = (req->status == VIRTIO_BLK_S_OK) ? BLKDEV_SUCCESS : BLKDEV_ERR_IO;
+    virtio_blk_req_free(req);
+    return result;
+}
+
+/* ============================================================================
+ * Block Device Integration
+ * ============================================================================ */
+
+static int virtio_blk_read(void *device, uint64_t lba, uint32_t count, void *buffer) {
+    return virtio_blk_do_sync((virtio_blk_dev_t*)device, VIRTIO_BLK_T_IN, lba, count, buffer);
+}
+
+static int virtio_blk_write(void *device, uint64_t lba, uint32_t count, const void *buffer) {
+    return virtio_blk_do_sync((virtio_blk_dev_t*)device, VIRTIO_BLK_T_OUT, lba, count,
+                              (void*)buffer);
+}
+
+static int virtio_blk_flush(void *device) {
+    virtio_blk_dev_t *dev = (virtio_blk_dev_t*)device;
+
+    if (!virtio_has_feature(&dev->vdev, VIRTIO_BLK_F_FLUSH)) {
+        return BLKDEV_SUCCESS;      /* No volatile write cache */
+    }
+    return virtio_blk_do_sync(dev, VIRTIO_BLK_T_FLUSH, 0, 0, NULL);
+}
+
+static int virtio_blk_submit(void *device, blk_request_t *rq) {
+    virtio_blk_dev_t *dev = (virtio_blk_dev_t*)device;
+    virtio_blk_req_t *req = NULL;
+
+    if (rq->op == BIO_WRITE && dev->readonly) {
+        return BLKDEV_ERR_IO;
+    }
+
+    for (int i = 0; i < BLK_QUEUE_DEPTH; i++) {
+        if (!__sync_lock_test_and_set(&dev->pool[i]->in_use, 1)) {
+            req = dev->pool[i];
+            break;
+        }
+    }
+    if (!req) {
+        return BLKDEV_ERR_NO_MEMORY;
+    }
+
+    bool write = (rq->op == BIO_WRITE);
+    virtio_blk_req_start(req, write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN, rq->lba);
+
+    for (bio_t *bio = rq->bio; bio; bio = bio->next) {
+        if (!virtio_blk_add_buffer(req, bio->buf, bio->count * VIRTIO_BLK_SECTOR_SIZE, write)) {
+            __sync_lock_release(&req->in_use);
+            return BLKDEV_ERR_INVALID;
+        }
+    }
+    virtio_blk_req_end(req);
+
+    req->rq = rq;
+    virtio_blk_queue_req(dev, req);
+    return BLKDEV_SUCCESS;
+}
+
+static bool virtio_blk_poll(void *device) {
+    virtio_blk_dev_t *dev = (virtio_blk_dev_t*)device;
+
+    virtio_blk_reap_all(dev);
+    return !dev->vdev.irq_enabled;
+}
+
+static block_ops_t virtio_block_ops = {
+    .read_sectors   = virtio_blk_read,
+    .write_sectors  = virtio_blk_write,
+    .flush          = virtio_blk_flush,
+    .submit         = virtio_blk_submit,
+    .poll           = virtio_blk_poll,
+};
+
+/* Used if the request pool cannot be allocated */
+static block_ops_t virtio_block_ops_sync = {
+    .read_sectors   = virtio_blk_read,
+    .write_sectors  = virtio_blk_write,
+    .flush          = virtio_blk_flush,
+};
+
+/* ============================================================================
+ * Initialization
+ * ============================================================================ */
+
+/**
+ * Set up one disk
+ */
+static int virtio_blk_probe(pci_device_t *pci) {
+    if (virtio_blk_device_count >= VIRTIO_BLK_MAX_DEVICES) {
+        return VIRTIO_ERR_NO_DEVICE;
+    }
+
+    virtio_blk_dev_t *dev = (virtio_blk_dev_t*)kcalloc(1, sizeof(virtio_blk_dev_t));
+    if (!dev) {
+        return VIRTIO_ERR_NO_MEMORY;
+    }
+
+    virtio_device_t *vdev = &dev->vdev;
+    int result = virtio_pci_init(vdev, pci);
+    if (result != VIRTIO_SUCCESS) {
+        kfree(dev);
+        return result;
+    }
+    vdev->driver = dev;
+
+    uint64_t wanted = (1ULL << VIRTIO_F_VERSION_1) | (1ULL << VIRTIO_F_INDIRECT_DESC) |
+                      (1ULL << VIRTIO_F_EVENT_IDX) | (1ULL << VIRTIO_BLK_F_SIZE_MAX) |
+                      (1ULL << VIRTIO_BLK_F_SEG_MAX) | (1ULL << VIRTIO_BLK_F_RO) |
+                      (1ULL << VIRTIO_BLK_F_BLK_SIZE) | (1ULL << VIRTIO_BLK_F_FLUSH) |
+                      (1ULL << VIRTIO_BLK_F_MQ);
+
+    result = virtio_set_features(vdev, virtio_get_device_features(vdev) & wanted);
+    if (result != VIRTIO_SUCCESS) {
+        kprintf("[VIRTIO-BLK] Feature negotiation failed\n");
+        goto fail;
+    }
+
+    dev->capacity = virtio_cfg_read64(vdev, VIRTIO_BLK_CFG_CAPACITY);
+    dev->readonly = virtio_has_feature(vdev, VIRTIO_BLK_F_RO);
+
+    dev->seg_size = VIRTIO_BLK_DEFAULT_SEG_SIZE;
+    if (virtio_has_feature(vdev, VIRTIO_BLK_F_SIZE_MAX)) {
+        uint32_t size_max = virtio_cfg_read32(vdev, VIRTIO_BLK_CFG_SIZE_MAX);
+        if (size_max >= PAGE_SIZE) {
+            dev->seg_size = MIN(dev->seg_size, size_max);
+        }
+    }
+
+    /* Header and status take two of the table's entries */
+    dev->max_segs = VIRTIO_BLK_REQ_DESCS - 2;
+    if (virtio_has_feature(vdev, VIRTIO_BLK_F_SEG_MAX)) {
+        uint32_t seg_max = virtio_cfg_read32(vdev, VIRTIO_BLK_CFG_SEG_MAX);
+        if (seg_max > 0) {
+            dev->max_segs = MIN(dev->max_segs, seg_max);
+        }
+    }
+    if (!virtio_has_feature(vdev, VIRTIO_F_INDIRECT_DESC)) {
+        dev->max_segs = MIN(dev->max_segs, VIRTIO_BLK_QUEUE_SIZE - 2u);
+    }
+
+    uint16_t num_queues = 1;
+    if (virtio_has_feature(vdev, VIRTIO_BLK_F_MQ)) {
+        num_queues = virtio_cfg_read16(vdev, VIRTIO_BLK_CFG_NUM_QUEUES);
+    }
+    num_queues = MIN(num_queues, MIN(virtio_num_queues(vdev), VIRTIO_BLK_MAX_QUEUES));
+
+    for (uint16_t i = 0; i < num_queues; i++) {
+        if (virtqueue_init(vdev, &dev->queues[i].vq, i, VIRTIO_BLK_QUEUE_SIZE) != VIRTIO_SUCCESS) {
+            break;
+        }
+        dev->num_queues++;
+    }
+    if (dev->num_queues == 0) {
+        kprintf("[VIRTIO-BLK] Could not set up a virtqueue\n");
+        result = VIRTIO_ERR_NO_MEMORY;
+        goto fail;
+    }
+    if (dev->num_queues < num_queues) {
+        kprintf("[VIRTIO-BLK] Using %u of %u queues\n", dev->num_queues, num_queues);
+    }
+
+    bool pooled = true;
+    for (int i = 0; i < BLK_QUEUE_DEPTH; i++) {
+        dev->pool[i] = virtio_blk_req_alloc(dev);
+        if (!dev->pool[i]) {
+            pooled = false;
+            break;
+        }
+    }
+
+    if (!virtio_request_irq(vdev, virtio_blk_irq)) {
+        for (uint16_t i = 0; i < dev->num_queues; i++) {
+            virtqueue_disable_cb(&dev->queues[i].vq);
+        }
+    }
+
+    virtio_driver_ok(vdev);
+
+    dev->name[0] = 'v';
+    dev->name[1] = 'd';
+    dev->name[2] = (char)('a' + virtio_blk_device_count);
+    dev->name[3] = '\0';
+
+    dev->blkdev = blkdev_register(dev->name, pooled ? &virtio_block_ops : &virtio_block_ops_sync,
+                                  dev, dev->capacity);
+    if (!dev->blkdev) {
+        kprintf("[VIRTIO-BLK] Could not register %s\n", dev->name);
+    }
+
+    virtio_blk_devices[virtio_blk_device_count++] = dev;
+
+    kprintf("[VIRTIO-BLK] %s: %llu sectors (%llu MB)%s, %u queue%s, %s descriptors%s\n",
+            dev->name, dev->capacity, dev->capacity / 2048,
+            dev->readonly ? " read-only" : "",
+            dev->num_queues, dev->num_queues == 1 ? "" : "s",
+            virtio_has_feature(vdev, VIRTIO_F_INDIRECT_DESC) ? "indirect" : "chained",
+            virtio_has_feature(vdev, VIRTIO_F_EVENT_IDX) ? ", event index" : "");
+    if (virtio_has_feature(vdev, VIRTIO_BLK_F_BLK_SIZE)) {
+        uint32_t blk_size = virtio_cfg_read32(vdev, VIRTIO_BLK_CFG_BLK_SIZE);
+        if (blk_size != VIRTIO_BLK_SECTOR_SIZE) {
+            kprintf("[VIRTIO-BLK] %s: block size %u, unaligned I/O may be slow\n",
+                    dev->name, blk_size);
+        }
+    }
+
+    return VIRTIO_SUCCESS;
+
+fail:
+    virtio_fail(vdev);
+    for (uint16_t i = 0; i < dev->num_queues; i++) {
+        virtqueue_free(&dev->queues[i].vq);
+    }
+    kfree(dev);
+    return result;
+}
+
+int virtio_blk_init(void) {
+    static const uint16_t ids[] = {
+        VIRTIO_PCI_DEVICE_MODERN_BASE + VIRTIO_ID_BLOCK,
+        VIRTIO_PCI_DEVICE_BLK_TRANS,
+    };
+    int found = 0;
+
+    for (size_t i = 0; i < sizeof(ids) / sizeof(ids[0]); i++) {
+        pci_device_t *pci = NULL;
+        while ((pci = pci_find_device_next(VIRTIO_PCI_VENDOR, ids[i], pci)) != NULL) {
+            if (virtio_blk_probe(pci) == VIRTIO_SUCCESS) {
+                found++;
+            }
+        }
+    }
+
+    if (found == 0) {
+        kprintf("[VIRTIO-BLK] No devices found\n");
+    }
+    return found;
+}
+
+int virtio_blk_get_device_count(void) {
+    return virtio_blk_device_count;
+}
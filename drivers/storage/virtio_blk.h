@@ -0,0 +1,74 @@
+/**
+ * AAAos Kernel - Virtio Block Driver
+ *
+ * Disks exposed by a hypervisor as virtio 1.0 PCI block devices. Each
+ * disk is registered with the block layer as "vda", "vdb", ... and takes
+ * requests through its submit operation:
+ * - Up to VIRTIO_BLK_MAX_QUEUES virtqueues per disk (VIRTIO_BLK_F_MQ),
+ *   with requests spread across them
+ * - A request is a header, one descriptor per physically contiguous
+ *   piece of its bios, and a status byte, passed as one indirect
+ *   descriptor table when the device supports it
+ * - Completion by interrupt, with event-index suppression of both
+ *   interrupts and queue notifications
+ */
+
+#ifndef _AAAOS_VIRTIO_BLK_H
+#define _AAAOS_VIRTIO_BLK_H
+
+#include "../../kernel/include/types.h"
+#include "../virtio/virtio.h"
+
+/* Driver limits */
+#define VIRTIO_BLK_MAX_DEVICES      4
+#define VIRTIO_BLK_MAX_QUEUES       4       /* Virtqueues used per disk */
+#define VIRTIO_BLK_QUEUE_SIZE       128     /* Ring entries per virtqueue */
+#define VIRTIO_BLK_REQ_DESCS        240     /* Descriptor table entries per request */
+#define VIRTIO_BLK_SECTOR_SIZE      512     /* Unit of virtio-blk addressing */
+
+/* Feature bits */
+#define VIRTIO_BLK_F_SIZE_MAX       1       /* size_max is valid */
+#define VIRTIO_BLK_F_SEG_MAX        2       /* seg_max is valid */
+#define VIRTIO_BLK_F_RO             5       /* Read-only disk */
+#define VIRTIO_BLK_F_BLK_SIZE       6       /* blk_size is valid */
+#define VIRTIO_BLK_F_FLUSH          9       /* Cache flush command */
+#define VIRTIO_BLK_F_MQ             12      /* num_queues is valid */
+
+/* Device configuration offsets */
+#define VIRTIO_BLK_CFG_CAPACITY     0       /* u64, 512-byte sectors */
+#define VIRTIO_BLK_CFG_SIZE_MAX     8       /* u32, bytes per segment */
+#define VIRTIO_BLK_CFG_SEG_MAX      12      /* u32, segments per request */
+#define VIRTIO_BLK_CFG_BLK_SIZE     20      /* u32, logical block size */
+#define VIRTIO_BLK_CFG_NUM_QUEUES   34      /* u16 */
+
+/* Request types */
+#define VIRTIO_BLK_T_IN             0       /* Read */
+#define VIRTIO_BLK_T_OUT            1       /* Write */
+#define VIRTIO_BLK_T_FLUSH          4       /* Flush the write cache */
+
+/* Request status */
+#define VIRTIO_BLK_S_OK             0
+#define VIRTIO_BLK_S_IOERR          1
+#define VIRTIO_BLK_S_UNSUPP         2
+
+/**
+ * Request header (device-readable)
+ */
+typedef struct PACKED {
+    uint32_t    type;       /* VIRTIO_BLK_T_* */
+    uint32_t    reserved;
+    uint64_t    sector;     /* Starting 512-byte sector */
+} virtio_blk_outhdr_t;
+
+/**
+ * Probe for virtio block devices and register them with the block layer
+ * @return Number of disks registered
+ */
+int virtio_blk_init(void);
+
+/**
+ * Get the number of disks found by virtio_blk_init
+ */
+int virtio_blk_get_device_count(void);
+
+#endif /* _AAAOS_VIRTIO_BLK_H */
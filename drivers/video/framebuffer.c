@@ -5,7 +5,10 @@
  */
 
 #include "framebuffer.h"
+#include "pixel.h"
 #include "../../kernel/include/serial.h"
+#include "../../kernel/arch/x86_64/io.h"
+#include "../../kernel/mm/vmm.h"
 
 /* Global framebuffer state */
 static framebuffer_t fb_info = {
@@ -15,9 +18,15 @@ static framebuffer_t fb_info = {
     .pitch = 0,
     .bpp = 0,
     .size = 0,
+    .page_count = 0,
+    .front_page = 0,
     .initialized = false
 };
 
+/* First page of the framebuffer; further pages follow at size intervals */
+static uint32_t *fb_base = NULL;
+static bool fb_vsync_warned = false;
+
 /**
  * Basic 8x16 bitmap font (ASCII 32-126)
  * Each character is 8 pixels wide and 16 pixels tall.
@@ -311,6 +320,87 @@ static const uint8_t font_8x16[95][16] = {
       0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }
 };
 
+/**
+ * Helper: Access a Bochs/QEMU DISPI register
+ */
+static uint16_t fb_dispi_read(uint16_t index) {
+    outw(FB_DISPI_IOPORT_INDEX, index);
+    return inw(FB_DISPI_IOPORT_DATA);
+}
+
+static void fb_dispi_write(uint16_t index, uint16_t value) {
+    outw(FB_DISPI_IOPORT_INDEX, index);
+    outw(FB_DISPI_IOPORT_DATA, value);
+}
+
+/**
+ * Wait for the start of a vertical retrace
+ * A retrace already in progress is waited out first, so the caller gets
+ * a whole blanking interval.
+ * @return true if the display is now in vertical retrace, false if it
+ *         did not report one within FB_VSYNC_SPIN_LIMIT polls
+ */
+static bool fb_wait_retrace(void) {
+    uint32_t spin = 0;
+
+    while (inb(FB_VGA_INPUT_STATUS) & FB_VGA_STATUS_VRETRACE) {
+        if (++spin >= FB_VSYNC_SPIN_LIMIT) {
+            return false;
+        }
+        __asm__ __volatile__("pause");
+    }
+    while (!(inb(FB_VGA_INPUT_STATUS) & FB_VGA_STATUS_VRETRACE)) {
+        if (++spin >= FB_VSYNC_SPIN_LIMIT) {
+            return false;
+        }
+        __asm__ __volatile__("pause");
+    }
+    return true;
+}
+
+/**
+ * Set up page flipping on a Bochs/QEMU stdvga display
+ * The mode the bootloader set must be the DISPI mode, with a scanline of
+ * exactly pitch bytes. The virtual height is doubled so a second page
+ * lies below the visible one, and the Y offset selects the page scanned
+ * out. Ports that no device decodes read as 0xFFFF, which fails the ID
+ * check, so this is harmless on other hardware.
+ * @return Number of pages available (1 if flipping is not supported)
+ */
+static uint32_t fb_probe_page_flip(void) {
+    uint16_t id = fb_dispi_read(FB_DISPI_INDEX_ID);
+    if (id < FB_DISPI_ID_MIN || id > FB_DISPI_ID_MAX) {
+        return 1;
+    }
+
+    if (!(fb_dispi_read(FB_DISPI_INDEX_ENABLE) & FB_DISPI_ENABLED) ||
+        fb_dispi_read(FB_DISPI_INDEX_XRES) != fb_info.width ||
+        fb_dispi_read(FB_DISPI_INDEX_YRES) != fb_info.height ||
+        fb_dispi_read(FB_DISPI_INDEX_BPP) != fb_info.bpp ||
+        (uint32_t)fb_dispi_read(FB_DISPI_INDEX_VIRT_WIDTH) * (fb_info.bpp / 8) != fb_info.pitch) {
+        kprintf("[FB] DISPI mode does not match the boot framebuffer, no page flipping\n");
+        return 1;
+    }
+
+    uint64_t vram = (uint64_t)fb_dispi_read(FB_DISPI_INDEX_VIDEO_MEMORY) * 64 * KB;
+    if (vram < (uint64_t)fb_info.size * FB_MAX_PAGES) {
+        kprintf("[FB] %llu KB of VRAM is too small for page flipping\n", vram / KB);
+        return 1;
+    }
+
+    /* The device clamps the virtual height to what fits in VRAM */
+    fb_dispi_write(FB_DISPI_INDEX_VIRT_HEIGHT, (uint16_t)(fb_info.height * FB_MAX_PAGES));
+    fb_dispi_write(FB_DISPI_INDEX_X_OFFSET, 0);
+    fb_dispi_write(FB_DISPI_INDEX_Y_OFFSET, 0);
+    if (fb_dispi_read(FB_DISPI_INDEX_VIRT_HEIGHT) < fb_info.height * FB_MAX_PAGES) {
+        kprintf("[FB] Could not extend the virtual height, no page flipping\n");
+        return 1;
+    }
+
+    kprintf("[FB] Bochs DISPI %04x: %u pages, %llu KB VRAM\n", id, FB_MAX_PAGES, vram / KB);
+    return FB_MAX_PAGES;
+}
+
 /**
  * Initialize framebuffer from boot information
  */
@@ -339,6 +429,22 @@ int fb_init(boot_info_t *boot_info) {
     fb_info.pitch = boot_info->fb_pitch;
     fb_info.bpp = boot_info->fb_bpp;
     fb_info.size = fb_info.pitch * fb_info.height;
+    fb_info.front_page = 0;
+    fb_info.page_count = (fb_info.bpp == 32) ? fb_probe_page_flip() : 1;
+
+    /*
+     * Map every scanout page write-combining. Uncached, each pixel store
+     * is a separate bus transaction; WC merges them into bursts.
+     */
+    virtaddr_t wc = vmm_map_mmio(boot_info->framebuffer,
+                                 (size_t)fb_info.size * fb_info.page_count,
+                                 VMM_FLAGS_MMIO_WC);
+    if (wc) {
+        fb_info.address = (uint32_t *)wc;
+    } else {
+        kprintf("[FB] Warning: Could not map the framebuffer write-combining\n");
+    }
+    fb_base = fb_info.address;
     fb_info.initialized = true;
 
     kprintf("[FB] Framebuffer initialized:\n");
@@ -347,10 +453,68 @@ int fb_init(boot_info_t *boot_info) {
     kprintf("[FB]   Pitch: %u bytes\n", fb_info.pitch);
     kprintf("[FB]   BPP: %u\n", fb_info.bpp);
     kprintf("[FB]   Size: %u bytes\n", fb_info.size);
+    kprintf("[FB]   Pages: %u\n", fb_info.page_count);
+    kprintf("[FB]   Memory type: %s\n",
+            !wc ? "boot mapping" : vmm_pat_enabled() ? "write-combining" : "uncached");
 
     return 0;
 }
 
+/**
+ * Get the memory of a scanout page
+ */
+uint32_t *fb_get_page(uint32_t page) {
+    if (!fb_info.initialized || page >= fb_info.page_count) {
+        return NULL;
+    }
+    return (uint32_t *)((uint8_t *)fb_base + (size_t)page * fb_info.size);
+}
+
+/**
+ * Scan out a different page
+ */
+int fb_flip(uint32_t page) {
+    if (!fb_info.initialized || page >= fb_info.page_count) {
+        return -1;
+    }
+    if (page == fb_info.front_page) {
+        return 0;
+    }
+
+    uint16_t offset = (uint16_t)(page * fb_info.height);
+    bool synced = false;
+
+    /*
+     * Wait with interrupts on, then check again with them off so the
+     * write cannot slip past the end of the blanking interval.
+     */
+    for (int tries = 0; tries < FB_FLIP_TRIES && !synced; tries++) {
+        if (!fb_wait_retrace()) {
+            break;
+        }
+
+        uint64_t flags;
+        __asm__ __volatile__("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
+        if (inb(FB_VGA_INPUT_STATUS) & FB_VGA_STATUS_VRETRACE) {
+            fb_dispi_write(FB_DISPI_INDEX_Y_OFFSET, offset);
+            synced = true;
+        }
+        __asm__ __volatile__("push %0; popfq" :: "r"(flags) : "memory", "cc");
+    }
+
+    if (!synced) {
+        if (!fb_vsync_warned) {
+            kprintf("[FB] No vertical retrace reported, page flips may tear\n");
+            fb_vsync_warned = true;
+        }
+        fb_dispi_write(FB_DISPI_INDEX_Y_OFFSET, offset);
+    }
+
+    fb_info.front_page = page;
+    fb_info.address = fb_get_page(page);
+    return 0;
+}
+
 /**
  * Get framebuffer information
  */
@@ -414,10 +578,7 @@ void fb_draw_hline(int x, int y, int w, uint32_t color) {
 
     if (x_start >= x_end) return;
 
-    uint32_t *pixel = fb_pixel_addr(x_start, y);
-    for (int i = x_start; i < x_end; i++) {
-        *pixel++ = color;
-    }
+    pixel_fill_span(fb_pixel_addr(x_start, y), color, (size_t)(x_end - x_start));
 }
 
 /**
@@ -461,10 +622,7 @@ void fb_fill_rect(int x, int y, int w, int h, uint32_t color) {
 
     uint32_t *row_start = fb_pixel_addr(x_start, y_start);
     for (int row = y_start; row < y_end; row++) {
-        uint32_t *pixel = row_start;
-        for (int col = 0; col < row_width; col++) {
-            *pixel++ = color;
-        }
+        pixel_fill_span(row_start, color, (size_t)row_width);
         row_start += pitch_pixels;
     }
 }
@@ -597,13 +755,9 @@ void fb_clear(uint32_t color) {
 
     kprintf("[FB] Clearing screen with color 0x%08x\n", color);
 
-    /* Fast fill using 32-bit writes */
-    uint32_t *pixel = fb_info.address;
+    /* One span covering every scanline, padding included */
     uint32_t total_pixels = (fb_info.pitch / (fb_info.bpp / 8)) * fb_info.height;
-
-    for (uint32_t i = 0; i < total_pixels; i++) {
-        *pixel++ = color;
-    }
+    pixel_fill_span(fb_info.address, color, total_pixels);
 }
 
 /**
@@ -626,18 +780,14 @@ void fb_scroll(int lines) {
     /* Copy rows up */
     uint32_t rows_to_copy = fb_info.height - lines;
     for (uint32_t row = 0; row < rows_to_copy; row++) {
-        for (uint32_t col = 0; col < fb_info.width; col++) {
-            dst[col] = src[col];
-        }
+        pixel_copy_span(dst, src, fb_info.width);
         dst += pitch_pixels;
         src += pitch_pixels;
     }
 
     /* Clear the bottom lines */
     for (int row = 0; row < lines; row++) {
-        for (uint32_t col = 0; col < fb_info.width; col++) {
-            dst[col] = FB_COLOR_BLACK;
-        }
+        pixel_fill_span(dst, FB_COLOR_BLACK, fb_info.width);
         dst += pitch_pixels;
     }
 }
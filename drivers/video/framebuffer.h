@@ -24,6 +24,32 @@
 #define FB_COLOR_DARK_GRAY  0xFF404040
 #define FB_COLOR_LIGHT_GRAY 0xFFC0C0C0
 
+/* Bochs/QEMU stdvga display interface (DISPI) */
+#define FB_DISPI_IOPORT_INDEX       0x01CE
+#define FB_DISPI_IOPORT_DATA        0x01CF
+#define FB_DISPI_INDEX_ID           0x00
+#define FB_DISPI_INDEX_XRES         0x01
+#define FB_DISPI_INDEX_YRES         0x02
+#define FB_DISPI_INDEX_BPP          0x03
+#define FB_DISPI_INDEX_ENABLE       0x04
+#define FB_DISPI_INDEX_VIRT_WIDTH   0x06
+#define FB_DISPI_INDEX_VIRT_HEIGHT  0x07
+#define FB_DISPI_INDEX_X_OFFSET     0x08
+#define FB_DISPI_INDEX_Y_OFFSET     0x09
+#define FB_DISPI_INDEX_VIDEO_MEMORY 0x0A    /* VRAM size in 64 KB units */
+#define FB_DISPI_ID_MIN             0xB0C0
+#define FB_DISPI_ID_MAX             0xB0CF
+#define FB_DISPI_ENABLED            0x01
+
+/* VGA input status register 1: vertical retrace in progress */
+#define FB_VGA_INPUT_STATUS         0x03DA
+#define FB_VGA_STATUS_VRETRACE      0x08
+#define FB_VSYNC_SPIN_LIMIT         1000000     /* Status polls before giving up */
+#define FB_FLIP_TRIES               3           /* Retraces to try before flipping unsynced */
+
+/* Scanout pages (front + back when page flipping is available) */
+#define FB_MAX_PAGES        2
+
 /* Font dimensions */
 #define FB_FONT_WIDTH       8
 #define FB_FONT_HEIGHT      16
@@ -47,6 +73,8 @@ typedef struct {
     uint32_t pitch;         /* Bytes per scanline */
     uint32_t bpp;           /* Bits per pixel */
     uint32_t size;          /* Total framebuffer size in bytes */
+    uint32_t page_count;    /* Pages that can be scanned out (2 with page flipping) */
+    uint32_t front_page;    /* Page being scanned out; address points at it */
     bool initialized;       /* Framebuffer initialization status */
 } framebuffer_t;
 
@@ -69,6 +97,26 @@ const framebuffer_t *fb_get_info(void);
  */
 bool fb_is_initialized(void);
 
+/**
+ * Get the memory of a scanout page
+ * The drawing functions below always draw to the page on screen.
+ * @param page Page index (below page_count)
+ * @return Pointer to the first pixel of the page, or NULL if out of range
+ */
+uint32_t *fb_get_page(uint32_t page);
+
+/**
+ * Scan out a different page
+ * Waits for the vertical retrace and changes the scanout offset inside
+ * it, so the next frame is read entirely from the new page and the old
+ * page is off screen, free to be drawn, when this returns. A display that
+ * does not report retrace within FB_VSYNC_SPIN_LIMIT polls is flipped
+ * immediately, which may tear.
+ * @param page Page index (below page_count)
+ * @return 0 on success, negative error code on failure
+ */
+int fb_flip(uint32_t page);
+
 /**
  * Draw a single pixel
  * @param x X coordinate
@@ -0,0 +1,118 @@
+/**
+ * AAAos Kernel - Pixel Span Kernels
+ *
+ * Row primitives shared by the framebuffer driver and the compositor:
+ * copy, fill and alpha blend of 32-bit ARGB spans.
+ *
+ * The kernel is built without SSE and does not save FPU/vector state, so
+ * these use 64-bit integer operations. Copies and fills are string
+ * instructions moving two pixels per element, which the CPU turns into
+ * full cache-line transfers for long spans. Blending keeps all four
+ * channels of a pixel in one 64-bit register, one channel per 16-bit lane,
+ * and divides by 255 with the (x * a + 128) * 257 >> 16 approximation
+ * instead of three divides.
+ */
+
+#ifndef _AAAOS_PIXEL_H
+#define _AAAOS_PIXEL_H
+
+#include "../../kernel/include/types.h"
+
+#define PIXEL_LANE_MASK     0x00FF00FF00FF00FFULL   /* Low byte of each 16-bit lane */
+#define PIXEL_LANE_ROUND    0x0080008000800080ULL   /* +128 in each lane */
+
+/**
+ * Copy a span of pixels
+ * Copies forward, so dst may overlap src if it lies below it (scrolling up).
+ * @param dst Destination
+ * @param src Source
+ * @param count Number of pixels
+ */
+static inline void pixel_copy_span(uint32_t *dst, const uint32_t *src, size_t count) {
+    size_t pairs = count / 2;
+
+    __asm__ __volatile__("rep movsq"
+                         : "+D"(dst), "+S"(src), "+c"(pairs)
+                         :
+                         : "memory");
+    if (count & 1) {
+        *dst = *src;
+    }
+}
+
+/**
+ * Fill a span of pixels with one color
+ * @param dst Destination
+ * @param color Fill color (0xAARRGGBB)
+ * @param count Number of pixels
+ */
+static inline void pixel_fill_span(uint32_t *dst, uint32_t color, size_t count) {
+    uint64_t pattern = ((uint64_t)color << 32) | color;
+    size_t pairs = count / 2;
+
+    __asm__ __volatile__("rep stosq"
+                         : "+D"(dst), "+c"(pairs)
+                         : "a"(pattern)
+                         : "memory");
+    if (count & 1) {
+        *dst = color;
+    }
+}
+
+/**
+ * Spread the channels of a pixel over 16-bit lanes (0x00AA00RR00GG00BB)
+ */
+static inline uint64_t pixel_unpack(uint32_t color) {
+    uint64_t v = color;
+    v = (v | (v << 16)) & 0x0000FFFF0000FFFFULL;
+    return (v | (v << 8)) & PIXEL_LANE_MASK;
+}
+
+/**
+ * Collect the low byte of each 16-bit lane back into a pixel
+ */
+static inline uint32_t pixel_pack(uint64_t v) {
+    v &= PIXEL_LANE_MASK;
+    v = (v | (v >> 8)) & 0x0000FFFF0000FFFFULL;
+    return (uint32_t)(v | (v >> 16));
+}
+
+/**
+ * Blend a foreground pixel over a background pixel
+ * Each channel becomes (fg * a + bg * (255 - a)) / 255, rounded; a lane
+ * peaks at 65153 before the divide, so no carry crosses into the next one.
+ * @param fg Foreground color, alpha in the top byte
+ * @param bg Background color
+ * @return Blended color, fully opaque
+ */
+static inline uint32_t pixel_blend(uint32_t fg, uint32_t bg) {
+    uint32_t a = fg >> 24;
+    uint64_t t = pixel_unpack(fg) * a + pixel_unpack(bg) * (255 - a) + PIXEL_LANE_ROUND;
+
+    /* (t * 257) >> 16 per lane, as (t + (t >> 8)) >> 8 */
+    t = (t + ((t >> 8) & PIXEL_LANE_MASK)) >> 8;
+    return pixel_pack(t) | 0xFF000000;
+}
+
+/**
+ * Blend a span of pixels over a destination span
+ * Opaque source pixels are stored and fully transparent ones skipped
+ * without blending.
+ * @param dst Destination (background), updated in place
+ * @param src Source pixels with alpha
+ * @param count Number of pixels
+ */
+static inline void pixel_blend_span(uint32_t *dst, const uint32_t *src, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        uint32_t pixel = src[i];
+        uint32_t alpha = pixel >> 24;
+
+        if (alpha == 255) {
+            dst[i] = pixel;
+        } else if (alpha != 0) {
+            dst[i] = pixel_blend(pixel, dst[i]);
+        }
+    }
+}
+
+#endif /* _AAAOS_PIXEL_H */
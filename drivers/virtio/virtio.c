@@ -0,0 +1,533 @@
+/**
+ * AAAos Kernel - Virtio Transport and Split Virtqueues
+ */
+
+#include "virtio.h"
+#include "../../kernel/include/serial.h"
+#include "../../kernel/mm/pmm.h"
+#include "../../kernel/mm/vmm.h"
+#include "../../kernel/mm/heap.h"
+#include "../../kernel/arch/x86_64/io.h"
+#include "../../kernel/arch/x86_64/include/idt.h"
+
+/* Vendor capability layout (virtio 1.0, 4.1.4) */
+#define VIRTIO_CAP_CFG_TYPE     3
+#define VIRTIO_CAP_BAR          4
+#define VIRTIO_CAP_OFFSET       8
+#define VIRTIO_CAP_LENGTH       12
+#define VIRTIO_CAP_NOTIFY_MULT  16
+
+#define VIRTIO_RESET_TIMEOUT    1000000
+
+/* x86 keeps stores ordered with stores and loads with loads; only a
+ * store followed by a load of another location needs a fence */
+#define virtio_wmb()    __asm__ __volatile__("" ::: "memory")
+#define virtio_rmb()    __asm__ __volatile__("" ::: "memory")
+#define virtio_mb()     __sync_synchronize()
+
+/* Devices with interrupts routed, for the shared handler */
+static virtio_device_t *virtio_irq_devices[VIRTIO_MAX_DEVICES];
+static int virtio_irq_device_count = 0;
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================ */
+
+static void virtio_memset(void *dest, int val, size_t count) {
+    uint8_t *d = (uint8_t*)dest;
+    while (count--) {
+        *d++ = (uint8_t)val;
+    }
+}
+
+static uint32_t virtio_pci_read32(pci_device_t *pci, uint8_t offset) {
+    return pci_read_config32(pci->bus, pci->device, pci->function, offset);
+}
+
+static uint8_t virtio_pci_read8(pci_device_t *pci, uint8_t offset) {
+    return pci_read_config8(pci->bus, pci->device, pci->function, offset);
+}
+
+/**
+ * Map the region described by a virtio capability
+ * @return Kernel virtual address, or NULL if the BAR is unusable
+ */
+static volatile uint8_t* virtio_map_cap(pci_device_t *pci, uint8_t cap) {
+    uint8_t bar = virtio_pci_read8(pci, cap + VIRTIO_CAP_BAR);
+    uint32_t offset = virtio_pci_read32(pci, cap + VIRTIO_CAP_OFFSET);
+
+    if (bar > 5 || pci_bar_is_io(pci, bar)) {
+        return NULL;
+    }
+
+    uint64_t base = pci_get_bar(pci, bar);
+    if (base == 0) {
+        return NULL;
+    }
+
+    return (volatile uint8_t*)(VMM_KERNEL_PHYS_MAP + base + offset);
+}
+
+/**
+ * Decide whether the other side asked to be told about new entries
+ * True if event lies in [old, new) modulo 2^16.
+ */
+static inline bool vring_need_event(uint16_t event, uint16_t new_idx, uint16_t old_idx) {
+    return (uint16_t)(new_idx - event - 1) < (uint16_t)(new_idx - old_idx);
+}
+
+/* Event index fields trail the rings */
+static inline volatile uint16_t* virtq_used_event(virtqueue_t *vq) {
+    return (volatile uint16_t*)((virtaddr_t)vq->avail + sizeof(virtq_avail_t) +
+                                vq->size * sizeof(uint16_t));
+}
+
+static inline volatile uint16_t* virtq_avail_event(virtqueue_t *vq) {
+    return (volatile uint16_t*)((virtaddr_t)vq->used + sizeof(virtq_used_t) +
+                                vq->size * sizeof(virtq_used_elem_t));
+}
+
+/**
+ * Interrupt handler for every virtio device
+ * Chained onto each line a virtio device uses; other drivers may share
+ * the line, so only devices whose ISR status is set are serviced.
+ */
+static void virtio_irq_handler(interrupt_frame_t *frame) {
+    uint8_t irq = (uint8_t)(frame->int_no - IRQ_BASE);
+
+    for (int i = 0; i < virtio_irq_device_count; i++) {
+        virtio_device_t *vdev = virtio_irq_devices[i];
+        if (!vdev->irq_enabled || vdev->irq != irq) {
+            continue;
+        }
+
+        /* Reading the ISR status acknowledges the interrupt */
+        uint8_t isr = *vdev->isr;
+        if (isr != 0 && vdev->irq_handler) {
+            vdev->irq_handler(vdev, isr);
+        }
+    }
+}
+
+/* ============================================================================
+ * Device setup
+ * ============================================================================ */
+
+int virtio_pci_init(virtio_device_t *vdev, pci_device_t *pci) {
+    if (!vdev || !pci) {
+        return VIRTIO_ERR_INVALID;
+    }
+
+    virtio_memset(vdev, 0, sizeof(*vdev));
+    vdev->pci = pci;
+
+    pci_enable_memory_space(pci);
+    pci_enable_bus_mastering(pci);
+
+    /* Use the first capability of each type */
+    uint8_t cap = 0;
+    while ((cap = pci_find_capability(pci, PCI_CAP_ID_VNDR, cap)) != 0) {
+        uint8_t type = virtio_pci_read8(pci, cap + VIRTIO_CAP_CFG_TYPE);
+
+        switch (type) {
+            case VIRTIO_PCI_CAP_COMMON_CFG:
+                if (!vdev->common) {
+                    vdev->common = (volatile virtio_pci_common_cfg_t*)virtio_map_cap(pci, cap);
+                }
+                break;
+
+            case VIRTIO_PCI_CAP_NOTIFY_CFG:
+                if (!vdev->notify_base) {
+                    vdev->notify_base = virtio_map_cap(pci, cap);
+                    vdev->notify_mult = virtio_pci_read32(pci, cap + VIRTIO_CAP_NOTIFY_MULT);
+                }
+                break;
+
+            case VIRTIO_PCI_CAP_ISR_CFG:
+                if (!vdev->isr) {
+                    vdev->isr = virtio_map_cap(pci, cap);
+                }
+                break;
+
+            case VIRTIO_PCI_CAP_DEVICE_CFG:
+                if (!vdev->device_cfg) {
+                    vdev->device_cfg = virtio_map_cap(pci, cap);
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    if (!vdev->common || !vdev->notify_base || !vdev->isr) {
+        kprintf("[VIRTIO] %02x:%02x.%x has no modern interface\n",
+                pci->bus, pci->device, pci->function);
+        return VIRTIO_ERR_NO_DEVICE;
+    }
+
+    virtio_reset(vdev);
+    vdev->common->device_status = VIRTIO_STATUS_ACKNOWLEDGE;
+    vdev->common->device_status = VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER;
+
+    return VIRTIO_SUCCESS;
+}
+
+void virtio_reset(virtio_device_t *vdev) {
+    vdev->common->device_status = 0;
+
+    /* The reset is complete once the status reads back as 0 */
+    for (int i = 0; i < VIRTIO_RESET_TIMEOUT && vdev->common->device_status != 0; i++) {
+        __asm__ __volatile__("pause");
+    }
+}
+
+uint64_t virtio_get_device_features(virtio_device_t *vdev) {
+    vdev->common->device_feature_select = 0;
+    uint64_t lo = vdev->common->device_feature;
+    vdev->common->device_feature_select = 1;
+    uint64_t hi = vdev->common->device_feature;
+
+    return lo | (hi << 32);
+}
+
+int virtio_set_features(virtio_device_t *vdev, uint64_t features) {
+    if (!(features & (1ULL << VIRTIO_F_VERSION_1))) {
+        return VIRTIO_ERR_FEATURES;
+    }
+
+    vdev->common->driver_feature_select = 0;
+    vdev->common->driver_feature = (uint32_t)features;
+    vdev->common->driver_feature_select = 1;
+    vdev->common->driver_feature = (uint32_t)(features >> 32);
+
+    vdev->common->device_status |= VIRTIO_STATUS_FEATURES_OK;
+    if (!(vdev->common->device_status & VIRTIO_STATUS_FEATURES_OK)) {
+        return VIRTIO_ERR_FEATURES;
+    }
+
+    vdev->features = features;
+    return VIRTIO_SUCCESS;
+}
+
+void virtio_driver_ok(virtio_device_t *vdev) {
+    vdev->common->device_status |= VIRTIO_STATUS_DRIVER_OK;
+}
+
+void virtio_fail(virtio_device_t *vdev) {
+    vdev->common->device_status |= VIRTIO_STATUS_FAILED;
+}
+
+uint16_t virtio_num_queues(virtio_device_t *vdev) {
+    return vdev->common->num_queues;
+}
+
+uint8_t virtio_cfg_read8(virtio_device_t *vdev, uint32_t offset) {
+    return vdev->device_cfg ? vdev->device_cfg[offset] : 0;
+}
+
+uint16_t virtio_cfg_read16(virtio_device_t *vdev, uint32_t offset) {
+    return vdev->device_cfg ? *(volatile uint16_t*)(vdev->device_cfg + offset) : 0;
+}
+
+uint32_t virtio_cfg_read32(virtio_device_t *vdev, uint32_t offset) {
+    return vdev->device_cfg ? *(volatile uint32_t*)(vdev->device_cfg + offset) : 0;
+}
+
+uint64_t virtio_cfg_read64(virtio_device_t *vdev, uint32_t offset) {
+    uint8_t gen;
+    uint64_t lo, hi;
+
+    if (!vdev->device_cfg) {
+        return 0;
+    }
+
+    /* Two 32-bit reads; retry if the device changed the config between them */
+    do {
+        gen = vdev->common->config_generation;
+        lo = *(volatile uint32_t*)(vdev->device_cfg + offset);
+        hi = *(volatile uint32_t*)(vdev->device_cfg + offset + 4);
+    } while (gen != vdev->common->config_generation);
+
+    return lo | (hi << 32);
+}
+
+bool virtio_request_irq(virtio_device_t *vdev, virtio_irq_t handler) {
+    uint8_t irq = vdev->pci->interrupt_line;
+
+    if (irq == 0 || irq >= 16) {
+        kprintf("[VIRTIO] No usable IRQ line, completions will be polled\n");
+        return false;
+    }
+    if (virtio_irq_device_count >= VIRTIO_MAX_DEVICES) {
+        return false;
+    }
+
+    /* Joins the line's handler chain; a second device on it is a no-op */
+    if (idt_register_shared_handler(IRQ_BASE + irq, virtio_irq_handler) != 0) {
+        kprintf("[VIRTIO] IRQ %d has no free handler slot, completions will be polled\n", irq);
+        return false;
+    }
+
+    vdev->irq = irq;
+    vdev->irq_handler = handler;
+    virtio_irq_devices[virtio_irq_device_count++] = vdev;
+
+    /* Unmask the line (and the cascade for the slave PIC) */
+    if (irq < 8) {
+        outb(0x21, inb(0x21) & ~(1 << irq));
+    } else {
+        outb(0xA1, inb(0xA1) & ~(1 << (irq - 8)));
+        outb(0x21, inb(0x21) & ~(1 << 2));
+    }
+
+    pci_enable_interrupts(vdev->pci);
+    vdev->irq_enabled = true;
+    return true;
+}
+
+/* ============================================================================
+ * Virtqueues
+ * ============================================================================ */
+
+int virtqueue_init(virtio_device_t *vdev, virtqueue_t *vq, uint16_t index, uint16_t max_size) {
+    if (!vdev || !vq || max_size == 0) {
+        return VIRTIO_ERR_INVALID;
+    }
+
+    virtio_memset(vq, 0, sizeof(*vq));
+    vq->vdev = vdev;
+    vq->index = index;
+
+    vdev->common->queue_select = index;
+    uint16_t size = vdev->common->queue_size;
+    if (size == 0) {
+        return VIRTIO_ERR_NO_DEVICE;
+    }
+
+    size = MIN(size, MIN(max_size, VIRTQ_MAX_SIZE));
+    while (size & (size - 1)) {
+        size &= (uint16_t)(size - 1);
+    }
+    vq->size = size;
+
+    /* Descriptor table in one page, driver and device rings in another */
+    vq->desc_phys = pmm_alloc_page();
+    vq->ring_phys = pmm_alloc_page();
+    vq->cookies = (void**)kcalloc(size, sizeof(void*));
+    if (!vq->desc_phys || !vq->ring_phys || !vq->cookies) {
+        virtqueue_free(vq);
+        return VIRTIO_ERR_NO_MEMORY;
+    }
+
+    size_t used_offset = ALIGN_UP(sizeof(virtq_avail_t) + (size + 1) * sizeof(uint16_t), 4);
+
+    vq->desc = (virtq_desc_t*)(VMM_KERNEL_PHYS_MAP + vq->desc_phys);
+    vq->avail = (volatile virtq_avail_t*)(VMM_KERNEL_PHYS_MAP + vq->ring_phys);
+    vq->used = (volatile virtq_used_t*)(VMM_KERNEL_PHYS_MAP + vq->ring_phys + used_offset);
+    virtio_memset(vq->desc, 0, PAGE_SIZE);
+    virtio_memset((void*)vq->avail, 0, PAGE_SIZE);
+
+    for (uint16_t i = 0; i < size; i++) {
+        vq->desc[i].next = (uint16_t)(i + 1);
+    }
+    vq->free_head = 0;
+    vq->num_free = size;
+    vq->cb_enabled = true;
+
+    physaddr_t used_phys = vq->ring_phys + used_offset;
+    vdev->common->queue_size = size;
+    vdev->common->queue_desc_lo = (uint32_t)vq->desc_phys;
+    vdev->common->queue_desc_hi = (uint32_t)(vq->desc_phys >> 32);
+    vdev->common->queue_driver_lo = (uint32_t)vq->ring_phys;
+    vdev->common->queue_driver_hi = (uint32_t)(vq->ring_phys >> 32);
+    vdev->common->queue_device_lo = (uint32_t)used_phys;
+    vdev->common->queue_device_hi = (uint32_t)(used_phys >> 32);
+
+    vq->notify = (volatile uint16_t*)(vdev->notify_base +
+                                      (uint32_t)vdev->common->queue_notify_off * vdev->notify_mult);
+    vdev->common->queue_enable = 1;
+
+    return VIRTIO_SUCCESS;
+}
+
+void virtqueue_free(virtqueue_t *vq) {
+    if (!vq) {
+        return;
+    }
+
+    if (vq->desc_phys) {
+        pmm_free_page(vq->desc_phys);
+    }
+    if (vq->ring_phys) {
+        pmm_free_page(vq->ring_phys);
+    }
+    if (vq->cookies) {
+        kfree(vq->cookies);
+    }
+
+    vq->desc_phys = 0;
+    vq->ring_phys = 0;
+    vq->cookies = NULL;
+    vq->desc = NULL;
+    vq->avail = NULL;
+    vq->used = NULL;
+    vq->num_free = 0;
+}
+
+bool virtqueue_can_add(virtqueue_t *vq, uint16_t count) {
+    if (count > 1 && virtio_has_feature(vq->vdev, VIRTIO_F_INDIRECT_DESC)) {
+        count = 1;
+    }
+    return vq->num_free >= count;
+}
+
+int virtqueue_add(virtqueue_t *vq, virtq_desc_t *table, physaddr_t table_phys,
+                  uint16_t count, void *cookie) {
+    if (!vq || !table || count == 0 || !cookie) {
+        return VIRTIO_ERR_INVALID;
+    }
+
+    bool indirect = count > 1 && virtio_has_feature(vq->vdev, VIRTIO_F_INDIRECT_DESC);
+    uint16_t needed = indirect ? 1 : count;
+
+    if (vq->num_free < needed) {
+        return VIRTIO_ERR_FULL;
+    }
+
+    uint16_t head = vq->free_head;
+
+    if (indirect) {
+        /* Chain the table in place and hand it over as one descriptor */
+        for (uint16_t i = 0; i < count; i++) {
+            table[i].flags = (uint16_t)((table[i].flags & VIRTQ_DESC_F_WRITE) |
+                                        (i + 1 < count ? VIRTQ_DESC_F_NEXT : 0));
+            table[i].next = (uint16_t)(i + 1);
+        }
+
+        virtq_desc_t *d = &vq->desc[head];
+        d->addr = table_phys;
+        d->len = count * (uint32_t)sizeof(virtq_desc_t);
+        d->flags = VIRTQ_DESC_F_INDIRECT;
+        vq->free_head = d->next;
+    } else {
+        /* Copy into free ring descriptors; their next links already
+         * follow the free list */
+        uint16_t idx = head;
+        for (uint16_t i = 0; i < count; i++) {
+            virtq_desc_t *d = &vq->desc[idx];
+            d->addr = table[i].addr;
+            d->len = table[i].len;
+            d->flags = (uint16_t)((table[i].flags & VIRTQ_DESC_F_WRITE) |
+                                  (i + 1 < count ? VIRTQ_DESC_F_NEXT : 0));
+            idx = d->next;
+        }
+        vq->free_head = idx;
+    }
+
+    vq->num_free -= needed;
+    vq->cookies[head] = cookie;
+
+    /* Descriptors must be visible before the ring entry, and the entry
+     * before the index */
+    vq->avail->ring[vq->avail_idx & (vq->size - 1)] = head;
+    virtio_wmb();
+    vq->avail_idx++;
+    vq->avail->idx = vq->avail_idx;
+
+    return VIRTIO_SUCCESS;
+}
+
+void virtqueue_kick(virtqueue_t *vq) {
+    uint16_t old_idx = vq->kicked_idx;
+    uint16_t new_idx = vq->avail_idx;
+
+    if (old_idx == new_idx) {
+        return;
+    }
+    vq->kicked_idx = new_idx;
+
+    /* The index store must land before the device's suppression state is read */
+    virtio_mb();
+
+    bool notify;
+    if (virtio_has_feature(vq->vdev, VIRTIO_F_EVENT_IDX)) {
+        notify = vring_need_event(*virtq_avail_event(vq), new_idx, old_idx);
+    } else {
+        notify = !(vq->used->flags & VIRTQ_USED_F_NO_NOTIFY);
+    }
+
+    if (notify) {
+        *vq->notify = vq->index;
+    }
+}
+
+void* virtqueue_get_used(virtqueue_t *vq, uint32_t *len) {
+    if (vq->last_used == vq->used->idx) {
+        return NULL;
+    }
+
+    /* Read the entry only after seeing the index */
+    virtio_rmb();
+
+    volatile virtq_used_elem_t *elem = &vq->used->ring[vq->last_used & (vq->size - 1)];
+    uint32_t id = elem->id;
+
+    if (id >= vq->size || !vq->cookies[id]) {
+        kprintf("[VIRTIO] Queue %u: bad used id %u\n", vq->index, id);
+        vq->last_used++;
+        return NULL;
+    }
+
+    if (len) {
+        *len = elem->len;
+    }
+
+    void *cookie = vq->cookies[id];
+    vq->cookies[id] = NULL;
+
+    /* Return the chain to the free list */
+    uint16_t last = (uint16_t)id;
+    uint16_t freed = 1;
+    while (vq->desc[last].flags & VIRTQ_DESC_F_NEXT) {
+        last = vq->desc[last].next;
+        freed++;
+    }
+    vq->desc[last].next = vq->free_head;
+    vq->free_head = (uint16_t)id;
+    vq->num_free += freed;
+
+    vq->last_used++;
+
+    /* Ask for an interrupt on the next completion after this one */
+    if (vq->cb_enabled && virtio_has_feature(vq->vdev, VIRTIO_F_EVENT_IDX)) {
+        *virtq_used_event(vq) = vq->last_used;
+    }
+
+    return cookie;
+}
+
+void virtqueue_disable_cb(virtqueue_t *vq) {
+    vq->cb_enabled = false;
+
+    if (virtio_has_feature(vq->vdev, VIRTIO_F_EVENT_IDX)) {
+        /* Half the index space away: never reached before re-enabling */
+        *virtq_used_event(vq) = (uint16_t)(vq->last_used + 0x8000);
+    } else {
+        vq->avail->flags |= VIRTQ_AVAIL_F_NO_INTERRUPT;
+    }
+}
+
+bool virtqueue_enable_cb(virtqueue_t *vq) {
+    vq->cb_enabled = true;
+
+    if (virtio_has_feature(vq->vdev, VIRTIO_F_EVENT_IDX)) {
+        *virtq_used_event(vq) = vq->last_used;
+    } else {
+        vq->avail->flags &= (uint16_t)~VIRTQ_AVAIL_F_NO_INTERRUPT;
+    }
+
+    /* Completions posted before the device saw the update raise no interrupt */
+    virtio_mb();
+    return vq->used->idx == vq->last_used;
+}
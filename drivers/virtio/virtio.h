@@ -0,0 +1,333 @@
+/**
+ * AAAos Kernel - Virtio Transport and Split Virtqueues
+ *
+ * Common code for virtio 1.0 ("modern") PCI devices:
+ * - Locating the common, notify, ISR and device configuration structures
+ *   through the vendor-specific PCI capabilities
+ * - Device status handshake and feature negotiation
+ * - Split virtqueues with optional indirect descriptors and event-index
+ *   interrupt/notification suppression
+ * - Legacy INTx interrupts, shared between all virtio devices on a line
+ *
+ * Device drivers (virtio-blk, ...) build on this; a virtqueue does no
+ * locking of its own, so drivers serialize access to each queue.
+ */
+
+#ifndef _AAAOS_VIRTIO_H
+#define _AAAOS_VIRTIO_H
+
+#include "../../kernel/include/types.h"
+#include "../pci/pci.h"
+
+/* PCI identification */
+#define VIRTIO_PCI_VENDOR               0x1AF4
+#define VIRTIO_PCI_DEVICE_MODERN_BASE   0x1040  /* + virtio device ID */
+#define VIRTIO_PCI_DEVICE_NET_TRANS     0x1000  /* Transitional network device */
+#define VIRTIO_PCI_DEVICE_BLK_TRANS     0x1001  /* Transitional block device */
+
+/* Virtio device IDs */
+#define VIRTIO_ID_NET                   1
+#define VIRTIO_ID_BLOCK                 2
+
+/* Device status bits */
+#define VIRTIO_STATUS_ACKNOWLEDGE       0x01
+#define VIRTIO_STATUS_DRIVER            0x02
+#define VIRTIO_STATUS_DRIVER_OK         0x04
+#define VIRTIO_STATUS_FEATURES_OK       0x08
+#define VIRTIO_STATUS_NEEDS_RESET       0x40
+#define VIRTIO_STATUS_FAILED            0x80
+
+/* Device-independent feature bits */
+#define VIRTIO_F_INDIRECT_DESC          28
+#define VIRTIO_F_EVENT_IDX              29
+#define VIRTIO_F_VERSION_1              32
+
+/* PCI capability structure types */
+#define VIRTIO_PCI_CAP_COMMON_CFG       1
+#define VIRTIO_PCI_CAP_NOTIFY_CFG       2
+#define VIRTIO_PCI_CAP_ISR_CFG          3
+#define VIRTIO_PCI_CAP_DEVICE_CFG       4
+#define VIRTIO_PCI_CAP_PCI_CFG          5
+
+/* ISR status bits */
+#define VIRTIO_ISR_QUEUE                0x01
+#define VIRTIO_ISR_CONFIG               0x02
+
+/* Descriptor flags */
+#define VIRTQ_DESC_F_NEXT               1   /* Chained via next */
+#define VIRTQ_DESC_F_WRITE              2   /* Device writes (otherwise reads) */
+#define VIRTQ_DESC_F_INDIRECT           4   /* Buffer is a descriptor table */
+
+/* Ring flags (used when VIRTIO_F_EVENT_IDX is not negotiated) */
+#define VIRTQ_AVAIL_F_NO_INTERRUPT      1
+#define VIRTQ_USED_F_NO_NOTIFY          1
+
+/* Driver limits */
+#define VIRTIO_MAX_DEVICES              8
+#define VIRTQ_MAX_SIZE                  256     /* Ring entries (fits the rings in 2 pages) */
+
+/* Error codes */
+#define VIRTIO_SUCCESS                  0
+#define VIRTIO_ERR_NO_DEVICE            (-1)    /* Not a usable modern device */
+#define VIRTIO_ERR_FEATURES             (-2)    /* Feature negotiation failed */
+#define VIRTIO_ERR_NO_MEMORY            (-3)    /* Allocation failed */
+#define VIRTIO_ERR_FULL                 (-4)    /* Not enough free descriptors */
+#define VIRTIO_ERR_INVALID              (-5)    /* Invalid argument */
+
+/**
+ * Common configuration structure (virtio 1.0, 4.1.4.3)
+ * 64-bit queue addresses are written as two 32-bit halves.
+ */
+typedef struct PACKED {
+    uint32_t    device_feature_select;
+    uint32_t    device_feature;
+    uint32_t    driver_feature_select;
+    uint32_t    driver_feature;
+    uint16_t    msix_config;
+    uint16_t    num_queues;
+    uint8_t     device_status;
+    uint8_t     config_generation;
+
+    uint16_t    queue_select;
+    uint16_t    queue_size;
+    uint16_t    queue_msix_vector;
+    uint16_t    queue_enable;
+    uint16_t    queue_notify_off;
+    uint32_t    queue_desc_lo;
+    uint32_t    queue_desc_hi;
+    uint32_t    queue_driver_lo;
+    uint32_t    queue_driver_hi;
+    uint32_t    queue_device_lo;
+    uint32_t    queue_device_hi;
+} virtio_pci_common_cfg_t;
+
+/**
+ * Virtqueue descriptor
+ */
+typedef struct PACKED {
+    uint64_t    addr;       /* Guest physical address */
+    uint32_t    len;        /* Length in bytes */
+    uint16_t    flags;      /* VIRTQ_DESC_F_* */
+    uint16_t    next;       /* Next descriptor if F_NEXT */
+} virtq_desc_t;
+
+/**
+ * Driver ("available") ring
+ * ring[size] is followed by used_event.
+ */
+typedef struct PACKED {
+    uint16_t    flags;
+    uint16_t    idx;
+    uint16_t    ring[];
+} virtq_avail_t;
+
+/**
+ * Used ring element
+ */
+typedef struct PACKED {
+    uint32_t    id;         /* Head descriptor of the completed chain */
+    uint32_t    len;        /* Bytes written by the device */
+} virtq_used_elem_t;
+
+/**
+ * Device ("used") ring
+ * ring[size] is followed by avail_event.
+ */
+typedef struct PACKED {
+    uint16_t            flags;
+    uint16_t            idx;
+    virtq_used_elem_t   ring[];
+} virtq_used_t;
+
+struct virtio_device;
+
+/**
+ * Interrupt callback, called from the shared IRQ handler
+ * @param vdev Device that raised the interrupt
+ * @param isr ISR status (VIRTIO_ISR_*)
+ */
+typedef void (*virtio_irq_t)(struct virtio_device *vdev, uint8_t isr);
+
+/**
+ * Split virtqueue
+ */
+typedef struct virtqueue {
+    struct virtio_device    *vdev;
+    uint16_t                index;          /* Queue number */
+    uint16_t                size;           /* Ring entries (power of 2) */
+
+    virtq_desc_t            *desc;          /* Descriptor table */
+    volatile virtq_avail_t  *avail;         /* Driver ring */
+    volatile virtq_used_t   *used;          /* Device ring */
+    physaddr_t              desc_phys;      /* Page holding desc */
+    physaddr_t              ring_phys;      /* Page holding avail and used */
+    volatile uint16_t       *notify;        /* Queue notify register */
+
+    uint16_t                free_head;      /* First free descriptor */
+    uint16_t                num_free;       /* Free descriptors */
+    uint16_t                avail_idx;      /* Next avail->idx to publish */
+    uint16_t                kicked_idx;     /* avail->idx at the last notify */
+    uint16_t                last_used;      /* Next used entry to consume */
+    bool                    cb_enabled;     /* Interrupts wanted */
+
+    void                    **cookies;      /* Caller data per head descriptor */
+} virtqueue_t;
+
+/**
+ * Virtio PCI device
+ */
+typedef struct virtio_device {
+    pci_device_t                        *pci;
+    volatile virtio_pci_common_cfg_t    *common;
+    volatile uint8_t                    *notify_base;
+    uint32_t                            notify_mult;    /* Notify offset multiplier */
+    volatile uint8_t                    *isr;
+    volatile uint8_t                    *device_cfg;
+    uint64_t                            features;       /* Negotiated features */
+
+    uint8_t                             irq;            /* Legacy interrupt line */
+    bool                                irq_enabled;
+    virtio_irq_t                        irq_handler;
+    void                                *driver;        /* Driver cookie */
+} virtio_device_t;
+
+/* ============================================================================
+ * Device setup
+ * ============================================================================ */
+
+/**
+ * Find a modern virtio PCI device's structures and reset it
+ * Enables memory space and bus mastering and sets ACKNOWLEDGE | DRIVER.
+ * @param vdev Device to fill in
+ * @param pci PCI function
+ * @return VIRTIO_SUCCESS or VIRTIO_ERR_NO_DEVICE
+ */
+int virtio_pci_init(virtio_device_t *vdev, pci_device_t *pci);
+
+/**
+ * Get the features offered by the device
+ */
+uint64_t virtio_get_device_features(virtio_device_t *vdev);
+
+/**
+ * Accept features and complete negotiation (sets FEATURES_OK)
+ * VIRTIO_F_VERSION_1 is required and must be included.
+ * @param vdev Device
+ * @param features Subset of the device's features
+ * @return VIRTIO_SUCCESS or VIRTIO_ERR_FEATURES
+ */
+int virtio_set_features(virtio_device_t *vdev, uint64_t features);
+
+/**
+ * Check a negotiated feature
+ */
+static inline bool virtio_has_feature(virtio_device_t *vdev, uint32_t bit) {
+    return (vdev->features & (1ULL << bit)) != 0;
+}
+
+/**
+ * Finish initialization (sets DRIVER_OK); queues must be set up first
+ */
+void virtio_driver_ok(virtio_device_t *vdev);
+
+/**
+ * Give up on a device (sets FAILED)
+ */
+void virtio_fail(virtio_device_t *vdev);
+
+/**
+ * Reset a device, stopping all queues
+ */
+void virtio_reset(virtio_device_t *vdev);
+
+/**
+ * Get the number of queues the device supports
+ */
+uint16_t virtio_num_queues(virtio_device_t *vdev);
+
+/**
+ * Read device-specific configuration (consistent across config changes)
+ * @param vdev Device
+ * @param offset Offset into the device configuration (naturally aligned)
+ */
+uint8_t virtio_cfg_read8(virtio_device_t *vdev, uint32_t offset);
+uint16_t virtio_cfg_read16(virtio_device_t *vdev, uint32_t offset);
+uint32_t virtio_cfg_read32(virtio_device_t *vdev, uint32_t offset);
+uint64_t virtio_cfg_read64(virtio_device_t *vdev, uint32_t offset);
+
+/**
+ * Route the device's legacy interrupt to a handler
+ * Lines are shared: the handler runs when the device's ISR status is set.
+ * @param vdev Device
+ * @param handler Callback
+ * @return true if interrupts are enabled, false if the driver must poll
+ */
+bool virtio_request_irq(virtio_device_t *vdev, virtio_irq_t handler);
+
+/* ============================================================================
+ * Virtqueues
+ * ============================================================================ */
+
+/**
+ * Allocate and enable a virtqueue
+ * @param vdev Device (after feature negotiation, before virtio_driver_ok)
+ * @param vq Queue to set up
+ * @param index Queue number
+ * @param max_size Largest ring wanted (rounded down to a power of 2)
+ * @return VIRTIO_SUCCESS or a negative error code
+ */
+int virtqueue_init(virtio_device_t *vdev, virtqueue_t *vq, uint16_t index, uint16_t max_size);
+
+/**
+ * Release a virtqueue's memory (the device must be reset first)
+ */
+void virtqueue_free(virtqueue_t *vq);
+
+/**
+ * Queue a buffer described by a descriptor table
+ * With VIRTIO_F_INDIRECT_DESC the table itself is handed to the device and
+ * the request takes a single ring descriptor; otherwise the entries are
+ * copied into a chain of ring descriptors. The caller fills addr, len and
+ * flags (VIRTQ_DESC_F_WRITE) of each entry, device-readable entries first;
+ * chaining is filled in here. The table must stay untouched until the
+ * buffer is returned by virtqueue_get_used().
+ * @param vq Queue
+ * @param table Entries (physically contiguous, kernel virtual)
+ * @param table_phys Physical address of table
+ * @param count Number of entries
+ * @param cookie Returned with the buffer on completion (not NULL)
+ * @return VIRTIO_SUCCESS or VIRTIO_ERR_FULL
+ */
+int virtqueue_add(virtqueue_t *vq, virtq_desc_t *table, physaddr_t table_phys,
+                  uint16_t count, void *cookie);
+
+/**
+ * Check whether a buffer of count entries fits now
+ */
+bool virtqueue_can_add(virtqueue_t *vq, uint16_t count);
+
+/**
+ * Publish queued buffers and notify the device if it asked to be notified
+ */
+void virtqueue_kick(virtqueue_t *vq);
+
+/**
+ * Take the next completed buffer
+ * @param vq Queue
+ * @param len Bytes written by the device (may be NULL)
+ * @return Cookie given to virtqueue_add, or NULL if none is ready
+ */
+void* virtqueue_get_used(virtqueue_t *vq, uint32_t *len);
+
+/**
+ * Ask the device not to interrupt for this queue
+ */
+void virtqueue_disable_cb(virtqueue_t *vq);
+
+/**
+ * Ask the device to interrupt on the next completion
+ * @return false if completions arrived meanwhile (call get_used again)
+ */
+bool virtqueue_enable_cb(virtqueue_t *vq);
+
+#endif /* _AAAOS_VIRTIO_H */
@@ -7,6 +7,12 @@
 #include "fat32.h"
 #include "../../kernel/include/serial.h"
 #include "../../kernel/mm/pmm.h"
+#include "../../kernel/mm/vmm.h"
+#include "../../kernel/arch/x86_64/include/idt.h"
+#include "../../kernel/proc/process.h"
+#include "../../kernel/sched/scheduler.h"
+#include "../../drivers/timer/pit.h"
+#include "../../drivers/storage/bcache.h"
 
 /*============================================================================
  * Private Helper Functions - Forward Declarations
@@ -16,8 +22,18 @@ static int fat32_read_boot_sector(fat32_fs_t *fs);
 static int fat32_read_fsinfo(fat32_fs_t *fs);
 static int fat32_write_fsinfo(fat32_fs_t *fs);
 static int fat32_flush_fat_cache(fat32_fs_t *fs);
+static int fat32_fat_cache_init(fat32_fs_t *fs);
+static void fat32_fat_cache_destroy(fat32_fs_t *fs);
 static uint32_t fat32_read_fat_entry(fat32_fs_t *fs, uint32_t cluster);
 static int fat32_write_fat_entry(fat32_fs_t *fs, uint32_t cluster, uint32_t value);
+static void fat32_bitmap_init(fat32_fs_t *fs);
+static void fat32_bitmap_destroy(fat32_fs_t *fs);
+static void fat32_vol_lock(fat32_fs_t *fs);
+static void fat32_vol_unlock(fat32_fs_t *fs);
+static void fat32_dir_index_release(fat32_dir_index_t *idx);
+static bool fat32_delalloc_begin(fat32_file_t *file, size_t offset);
+static int fat32_delalloc_flush(fat32_file_t *file);
+static void fat32_writeback_hook(void *ctx);
 static int fat32_find_entry_in_dir(fat32_fs_t *fs, uint32_t dir_cluster,
                                    const char *name, fat32_dir_entry_t *out,
                                    uint32_t *out_entry_index);
@@ -28,6 +44,7 @@ static void fat32_memcpy(void *dest, const void *src, size_t n);
 static size_t fat32_strlen(const char *s);
 static int fat32_strncmp(const char *s1, const char *s2, size_t n);
 static char fat32_toupper(char c);
+static int fat32_stricmp(const char *s1, const char *s2);
 
 /*============================================================================
  * VFS Operations Table
@@ -38,8 +55,10 @@ static vfs_ops_t fat32_vfs_ops = {
     .close      = fat32_vfs_close,
     .read       = fat32_vfs_read,
     .write      = fat32_vfs_write,
-    .truncate   = NULL,     /* TODO: Implement */
-    .sync       = NULL,     /* TODO: Implement */
+    .readv      = fat32_vfs_readv,
+    .writev     = fat32_vfs_writev,
+    .truncate   = fat32_vfs_truncate,
+    .sync       = fat32_vfs_sync,
     .readdir    = fat32_vfs_readdir,
     .finddir    = fat32_vfs_finddir,
     .mkdir      = fat32_vfs_mkdir,
@@ -52,8 +71,8 @@ static vfs_ops_t fat32_vfs_ops = {
     .chown      = NULL,     /* FAT32 doesn't support ownership */
     .mount      = fat32_vfs_mount,
     .unmount    = fat32_vfs_unmount,
-    .sync_fs    = NULL,     /* TODO: Implement */
-    .statfs     = NULL      /* TODO: Implement */
+    .sync_fs    = fat32_vfs_sync_fs,
+    .statfs     = fat32_vfs_statfs
 };
 
 /*============================================================================
@@ -98,6 +117,14 @@ static char fat32_toupper(char c) {
     return c;
 }
 
+static int fat32_stricmp(const char *s1, const char *s2) {
+    while (*s1 && fat32_toupper(*s1) == fat32_toupper(*s2)) {
+        s1++;
+        s2++;
+    }
+    return (uint8_t)fat32_toupper(*s1) - (uint8_t)fat32_toupper(*s2);
+}
+
 /*============================================================================
  * FAT32 Core Initialization
  *============================================================================*/
@@ -129,7 +156,7 @@ fat32_fs_t* fat32_mount(void *device, fat32_block_ops_t *block_ops) {
     }
 
     /* Allocate filesystem state */
-    physaddr_t fs_phys = pmm_alloc_page();
+    physaddr_t fs_phys = pmm_alloc_pages(FAT32_FS_PAGES);
     if (!fs_phys) {
         kprintf("[FAT32] Failed to allocate filesystem state\n");
         return NULL;
@@ -143,7 +170,7 @@ fat32_fs_t* fat32_mount(void *device, fat32_block_ops_t *block_ops) {
     /* Read and validate boot sector */
     if (fat32_read_boot_sector(fs) != 0) {
         kprintf("[FAT32] Failed to read boot sector\n");
-        pmm_free_page(fs_phys);
+        pmm_free_pages(fs_phys, FAT32_FS_PAGES);
         return NULL;
     }
 
@@ -185,20 +212,30 @@ fat32_fs_t* fat32_mount(void *device, fat32_block_ops_t *block_ops) {
     physaddr_t cluster_buf_phys = pmm_alloc_pages(cluster_pages);
     if (!cluster_buf_phys) {
         kprintf("[FAT32] Failed to allocate cluster buffer\n");
-        pmm_free_page(fs_phys);
+        pmm_free_pages(fs_phys, FAT32_FS_PAGES);
         return NULL;
     }
     fs->cluster_buffer = (uint8_t *)(cluster_buf_phys + VMM_KERNEL_PHYS_MAP);
 
     /* Initialize FAT cache */
-    for (int i = 0; i < FAT32_FAT_CACHE_SIZE; i++) {
-        fs->fat_cache[i].valid = false;
-        fs->fat_cache[i].dirty = false;
+    if (fat32_fat_cache_init(fs) != 0) {
+        kprintf("[FAT32] Failed to allocate FAT cache\n");
+        pmm_free_pages(cluster_buf_phys, cluster_pages);
+        pmm_free_pages(fs_phys, FAT32_FS_PAGES);
+        return NULL;
     }
 
     fs->mounted = true;
     fs->readonly = false;
 
+    /* Build the free-cluster bitmap in the background */
+    fat32_bitmap_init(fs);
+
+    /* Have the cache's write-back thread age out delayed data */
+    if (!bcache_add_writeback_hook(fat32_writeback_hook, fs)) {
+        kprintf("[FAT32] No write-back hook slot, delayed data waits for the next access\n");
+    }
+
     kprintf("[FAT32] Volume mounted successfully\n");
     return fs;
 }
@@ -210,9 +247,23 @@ int fat32_unmount(fat32_fs_t *fs) {
 
     kprintf("[FAT32] Unmounting volume\n");
 
+    bcache_remove_writeback_hook(fat32_writeback_hook, fs);
+
+    /* Keep the background scanner out of the FAT cache from here on */
+    fat32_vol_lock(fs);
+
     /* Flush all dirty data */
     fat32_sync(fs);
 
+    fat32_bitmap_destroy(fs);
+    fat32_fat_cache_destroy(fs);
+    fat32_vol_unlock(fs);
+
+    /* Free directory indexes */
+    for (int i = 0; i < FAT32_DIR_INDEX_MAX; i++) {
+        fat32_dir_index_release(&fs->dir_index[i]);
+    }
+
     /* Free cluster buffer */
     if (fs->cluster_buffer) {
         size_t cluster_pages = (fs->bytes_per_cluster + PAGE_SIZE - 1) / PAGE_SIZE;
@@ -223,7 +274,7 @@ int fat32_unmount(fat32_fs_t *fs) {
     /* Free filesystem state */
     physaddr_t fs_phys = (physaddr_t)fs - VMM_KERNEL_PHYS_MAP;
     fs->mounted = false;
-    pmm_free_page(fs_phys);
+    pmm_free_pages(fs_phys, FAT32_FS_PAGES);
 
     kprintf("[FAT32] Volume unmounted successfully\n");
     return 0;
@@ -305,9 +356,21 @@ static int fat32_read_fsinfo(fat32_fs_t *fs) {
         return VFS_ERR_INVAL;
     }
 
+    /*
+     * The hints are whatever the last writer left, possibly a crashed or
+     * foreign system. They only seed allocation and the free count until
+     * the bitmap scan replaces them; values outside the volume are dropped.
+     */
     fs->free_clusters = fsinfo->free_count;
     fs->next_free_cluster = fsinfo->next_free;
 
+    if (fs->free_clusters > fs->total_clusters) {
+        fs->free_clusters = 0xFFFFFFFF;
+    }
+    if (!fat32_cluster_is_valid(fs, fs->next_free_cluster)) {
+        fs->next_free_cluster = FAT32_FIRST_DATA_CLUSTER;
+    }
+
     kprintf("[FAT32] FSInfo: %u free clusters, next free hint: %u\n",
             fs->free_clusters, fs->next_free_cluster);
 
@@ -346,48 +409,245 @@ static int fat32_write_fsinfo(fat32_fs_t *fs) {
  * FAT Table Operations
  *============================================================================*/
 
-static uint32_t fat32_read_fat_entry(fat32_fs_t *fs, uint32_t cluster) {
-    /* Calculate which FAT sector contains this entry */
-    uint32_t fat_offset = cluster * 4;  /* 4 bytes per FAT32 entry */
-    uint32_t fat_sector = fs->fat_start_sector + (fat_offset / fs->bpb.bytes_per_sector);
-    uint32_t entry_offset = fat_offset % fs->bpb.bytes_per_sector;
+/*
+ * FAT sectors are cached in a set-associative cache: sector N can only live
+ * in set N % FAT32_FAT_CACHE_SETS, and within a set the least recently used
+ * way is replaced. Dirty sectors reach the first FAT when evicted or on
+ * sync, where adjacent sectors are written with one command. Copies to the
+ * backup FATs are deferred: written sectors are recorded in a per-sector
+ * bitmap and mirrored in batches when the filesystem is synced.
+ */
+
+/**
+ * Allocate FAT cache buffers and the mirror bitmap
+ * @return 0 on success, negative error code on failure
+ */
+static int fat32_fat_cache_init(fat32_fs_t *fs) {
+    size_t flush_pages = (FAT32_FAT_FLUSH_SECTORS * FAT32_SECTOR_SIZE + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    physaddr_t data_phys = pmm_alloc_pages(FAT32_FAT_CACHE_PAGES);
+    if (!data_phys) {
+        return VFS_ERR_NOMEM;
+    }
+    fs->fat_cache_data = (uint8_t *)(data_phys + VMM_KERNEL_PHYS_MAP);
+
+    for (int i = 0; i < FAT32_FAT_CACHE_SIZE; i++) {
+        fs->fat_cache[i].valid = false;
+        fs->fat_cache[i].dirty = false;
+        fs->fat_cache[i].last_used = 0;
+        fs->fat_cache[i].data = fs->fat_cache_data + i * FAT32_SECTOR_SIZE;
+    }
+    fs->fat_cache_clock = 0;
+    fs->fat_cache_hits = 0;
+    fs->fat_cache_misses = 0;
+
+    /* Without these, FAT sectors are written (and mirrored) one at a time */
+    physaddr_t flush_phys = pmm_alloc_pages(flush_pages);
+    fs->fat_flush_buffer = flush_phys ? (uint8_t *)(flush_phys + VMM_KERNEL_PHYS_MAP) : NULL;
+
+    fs->fat_mirror_pending = NULL;
+    fs->mirror_dirty = false;
+    if (fs->bpb.num_fats > 1 && fs->fat_flush_buffer) {
+        size_t bitmap_bytes = ((fs->fat_sectors + 31) / 32) * sizeof(uint32_t);
+        size_t mirror_pages = (bitmap_bytes + PAGE_SIZE - 1) / PAGE_SIZE;
+        physaddr_t mirror_phys = pmm_alloc_pages(mirror_pages);
+        if (mirror_phys) {
+            fs->fat_mirror_pending = (uint32_t *)(mirror_phys + VMM_KERNEL_PHYS_MAP);
+            fs->mirror_pages = mirror_pages;
+            fat32_memset(fs->fat_mirror_pending, 0, mirror_pages * PAGE_SIZE);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Release FAT cache buffers (the cache must already be flushed)
+ */
+static void fat32_fat_cache_destroy(fat32_fs_t *fs) {
+    if (fs->fat_mirror_pending) {
+        pmm_free_pages((physaddr_t)fs->fat_mirror_pending - VMM_KERNEL_PHYS_MAP,
+                       fs->mirror_pages);
+        fs->fat_mirror_pending = NULL;
+    }
+
+    if (fs->fat_flush_buffer) {
+        size_t flush_pages = (FAT32_FAT_FLUSH_SECTORS * FAT32_SECTOR_SIZE + PAGE_SIZE - 1) / PAGE_SIZE;
+        pmm_free_pages((physaddr_t)fs->fat_flush_buffer - VMM_KERNEL_PHYS_MAP, flush_pages);
+        fs->fat_flush_buffer = NULL;
+    }
 
-    /* Check cache */
-    int cache_idx = -1;
-    int oldest_idx = 0;
+    if (fs->fat_cache_data) {
+        pmm_free_pages((physaddr_t)fs->fat_cache_data - VMM_KERNEL_PHYS_MAP,
+                       FAT32_FAT_CACHE_PAGES);
+        fs->fat_cache_data = NULL;
+    }
 
     for (int i = 0; i < FAT32_FAT_CACHE_SIZE; i++) {
-        if (fs->fat_cache[i].valid && fs->fat_cache[i].sector == fat_sector) {
-            cache_idx = i;
-            break;
+        fs->fat_cache[i].valid = false;
+        fs->fat_cache[i].data = NULL;
+    }
+}
+
+/**
+ * Write sectors to the first FAT and schedule (or perform) the mirror copy
+ * @param fs Filesystem state
+ * @param fat_sector Absolute sector number in the first FAT
+ * @param count Number of sectors
+ * @param data Sector data
+ * @return 0 on success, negative error code on failure
+ */
+static int fat32_fat_write_primary(fat32_fs_t *fs, uint32_t fat_sector, uint32_t count,
+                                   const void *data) {
+    fs->fat_writes++;
+    if (fs->block_ops->write_sectors(fs->device, fat_sector, count, data) != 0) {
+        kprintf("[FAT32] Failed to write FAT sector %u\n", fat_sector);
+        return VFS_ERR_IO;
+    }
+
+    if (fs->fat_mirror_pending) {
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t bit = fat_sector + i - fs->fat_start_sector;
+            fs->fat_mirror_pending[bit / 32] |= (1U << (bit % 32));
         }
-        if (!fs->fat_cache[i].valid) {
-            oldest_idx = i;
+        fs->mirror_dirty = true;
+    } else {
+        for (uint32_t f = 1; f < fs->bpb.num_fats; f++) {
+            fs->block_ops->write_sectors(fs->device, fat_sector + f * fs->fat_sectors,
+                                         count, data);
         }
     }
 
-    /* Cache miss - load sector */
-    if (cache_idx < 0) {
-        cache_idx = oldest_idx;
+    return 0;
+}
 
-        /* Flush if dirty */
-        if (fs->fat_cache[cache_idx].dirty) {
-            uint32_t old_sector = fs->fat_cache[cache_idx].sector;
-            fs->block_ops->write_sectors(fs->device, old_sector, 1,
-                                         fs->fat_cache[cache_idx].data);
-            fs->fat_cache[cache_idx].dirty = false;
+/**
+ * Copy FAT sectors written since the last mirror to the backup FATs
+ * Runs of pending sectors are read from the first FAT and written to
+ * each backup with one command per run.
+ * @return 0 on success, negative error code on failure
+ */
+static int fat32_mirror_fat(fat32_fs_t *fs) {
+    if (!fs->mirror_dirty) {
+        return 0;
+    }
+
+    uint32_t *pending = fs->fat_mirror_pending;
+    uint32_t words = (fs->fat_sectors + 31) / 32;
+    uint32_t bit = 0;
+    int status = 0;
+
+    while (bit < fs->fat_sectors) {
+        /* Skip clean words quickly */
+        if ((bit % 32) == 0 && pending[bit / 32] == 0) {
+            bit += 32;
+            continue;
+        }
+        if (!(pending[bit / 32] & (1U << (bit % 32)))) {
+            bit++;
+            continue;
+        }
+
+        /* Collect a run of pending sectors */
+        uint32_t run = 0;
+        while (bit + run < fs->fat_sectors && run < FAT32_FAT_FLUSH_SECTORS &&
+               (pending[(bit + run) / 32] & (1U << ((bit + run) % 32)))) {
+            run++;
+        }
+
+        uint32_t sector = fs->fat_start_sector + bit;
+        int result = fs->block_ops->read_sectors(fs->device, sector, run,
+                                                 fs->fat_flush_buffer);
+        for (uint32_t f = 1; result == 0 && f < fs->bpb.num_fats; f++) {
+            result = fs->block_ops->write_sectors(fs->device, sector + f * fs->fat_sectors,
+                                                  run, fs->fat_flush_buffer);
+        }
+
+        if (result != 0) {
+            kprintf("[FAT32] Failed to mirror FAT sectors %u-%u\n", sector, sector + run - 1);
+            status = VFS_ERR_IO;
+        } else {
+            for (uint32_t i = bit; i < bit + run; i++) {
+                pending[i / 32] &= ~(1U << (i % 32));
+            }
+        }
+        bit += run;
+    }
+
+    /* Failed runs stay pending for the next sync */
+    if (status == 0) {
+        fs->mirror_dirty = false;
+        for (uint32_t w = 0; w < words; w++) {
+            if (pending[w]) {
+                fs->mirror_dirty = true;
+                break;
+            }
+        }
+    }
+
+    return status;
+}
+
+/**
+ * Find or load a FAT sector in the FAT cache
+ * @param fs Filesystem state
+ * @param fat_sector Absolute sector number of the FAT sector
+ * @return Cache slot index, or negative error code on failure
+ */
+static int fat32_fat_cache_slot(fat32_fs_t *fs, uint32_t fat_sector) {
+    int set = (int)(fat_sector % FAT32_FAT_CACHE_SETS) * FAT32_FAT_CACHE_WAYS;
+    int victim = set;
+
+    for (int i = set; i < set + FAT32_FAT_CACHE_WAYS; i++) {
+        fat32_fat_cache_entry_t *slot = &fs->fat_cache[i];
+        if (slot->valid && slot->sector == fat_sector) {
+            slot->last_used = ++fs->fat_cache_clock;
+            fs->fat_cache_hits++;
+            return i;
+        }
+
+        /* Prefer an empty way, else the least recently used one */
+        fat32_fat_cache_entry_t *best = &fs->fat_cache[victim];
+        if (!slot->valid ? best->valid : (best->valid && slot->last_used < best->last_used)) {
+            victim = i;
         }
+    }
 
-        /* Read new sector */
-        int result = fs->block_ops->read_sectors(fs->device, fat_sector, 1,
-                                                 fs->fat_cache[cache_idx].data);
+    fs->fat_cache_misses++;
+    fat32_fat_cache_entry_t *slot = &fs->fat_cache[victim];
+
+    /* Write back the evicted sector */
+    if (slot->valid && slot->dirty) {
+        int result = fat32_fat_write_primary(fs, slot->sector, 1, slot->data);
         if (result != 0) {
-            kprintf("[FAT32] Failed to read FAT sector %u\n", fat_sector);
-            return FAT32_CLUSTER_BAD;
+            return result;
         }
+        slot->dirty = false;
+    }
+
+    /* Read new sector */
+    int result = fs->block_ops->read_sectors(fs->device, fat_sector, 1, slot->data);
+    if (result != 0) {
+        kprintf("[FAT32] Failed to read FAT sector %u\n", fat_sector);
+        slot->valid = false;
+        return VFS_ERR_IO;
+    }
+
+    slot->sector = fat_sector;
+    slot->valid = true;
+    slot->last_used = ++fs->fat_cache_clock;
+    return victim;
+}
+
+static uint32_t fat32_read_fat_entry(fat32_fs_t *fs, uint32_t cluster) {
+    /* Calculate which FAT sector contains this entry */
+    uint32_t fat_offset = cluster * 4;  /* 4 bytes per FAT32 entry */
+    uint32_t fat_sector = fs->fat_start_sector + (fat_offset / fs->bpb.bytes_per_sector);
+    uint32_t entry_offset = fat_offset % fs->bpb.bytes_per_sector;
 
-        fs->fat_cache[cache_idx].sector = fat_sector;
-        fs->fat_cache[cache_idx].valid = true;
+    int cache_idx = fat32_fat_cache_slot(fs, fat_sector);
+    if (cache_idx < 0) {
+        return FAT32_CLUSTER_BAD;
     }
 
     /* Read entry from cache */
@@ -404,50 +664,54 @@ static int fat32_write_fat_entry(fat32_fs_t *fs, uint32_t cluster, uint32_t valu
     uint32_t fat_sector = fs->fat_start_sector + (fat_offset / fs->bpb.bytes_per_sector);
     uint32_t entry_offset = fat_offset % fs->bpb.bytes_per_sector;
 
-    /* Find or load the sector in cache */
-    int cache_idx = -1;
-    int oldest_idx = 0;
+    int cache_idx = fat32_fat_cache_slot(fs, fat_sector);
+    if (cache_idx < 0) {
+        return cache_idx;
+    }
 
-    for (int i = 0; i < FAT32_FAT_CACHE_SIZE; i++) {
-        if (fs->fat_cache[i].valid && fs->fat_cache[i].sector == fat_sector) {
-            cache_idx = i;
-            break;
-        }
-        if (!fs->fat_cache[i].valid) {
-            oldest_idx = i;
-        }
+    /* Modify entry in cache */
+    uint32_t *entry = (uint32_t *)&fs->fat_cache[cache_idx].data[entry_offset];
+    *entry = (*entry & 0xF0000000) | (value & FAT32_CLUSTER_MASK);  /* Preserve high 4 bits */
+    fs->fat_cache[cache_idx].dirty = true;
+
+    return 0;
+}
+
+/**
+ * Link a run of consecutive clusters into a chain ending in EOF
+ * Entries sharing a FAT sector are updated with a single cache lookup.
+ * @param fs Filesystem state
+ * @param start First cluster of the run
+ * @param count Number of clusters
+ * @return 0 on success, negative error code on failure
+ */
+static int fat32_write_fat_run(fat32_fs_t *fs, uint32_t start, uint32_t count) {
+    if (fs->readonly) {
+        return VFS_ERR_ROFS;
     }
 
-    if (cache_idx < 0) {
-        cache_idx = oldest_idx;
+    uint32_t entries_per_sector = fs->bpb.bytes_per_sector / 4;
+    uint32_t cluster = start;
+    uint32_t end = start + count;
 
-        /* Flush if dirty */
-        if (fs->fat_cache[cache_idx].dirty) {
-            uint32_t old_sector = fs->fat_cache[cache_idx].sector;
-            int result = fs->block_ops->write_sectors(fs->device, old_sector, 1,
-                                                      fs->fat_cache[cache_idx].data);
-            if (result != 0) {
-                return VFS_ERR_IO;
-            }
-            fs->fat_cache[cache_idx].dirty = false;
+    while (cluster < end) {
+        uint32_t fat_sector = fs->fat_start_sector + cluster / entries_per_sector;
+        int cache_idx = fat32_fat_cache_slot(fs, fat_sector);
+        if (cache_idx < 0) {
+            return cache_idx;
         }
 
-        /* Read new sector */
-        int result = fs->block_ops->read_sectors(fs->device, fat_sector, 1,
-                                                 fs->fat_cache[cache_idx].data);
-        if (result != 0) {
-            return VFS_ERR_IO;
-        }
+        uint32_t *entries = (uint32_t *)fs->fat_cache[cache_idx].data;
+        uint32_t sector_end = (cluster / entries_per_sector + 1) * entries_per_sector;
 
-        fs->fat_cache[cache_idx].sector = fat_sector;
-        fs->fat_cache[cache_idx].valid = true;
+        for (; cluster < end && cluster < sector_end; cluster++) {
+            uint32_t value = (cluster + 1 < end) ? cluster + 1 : FAT32_CLUSTER_EOF;
+            uint32_t *entry = &entries[cluster % entries_per_sector];
+            *entry = (*entry & 0xF0000000) | value;
+        }
+        fs->fat_cache[cache_idx].dirty = true;
     }
 
-    /* Modify entry in cache */
-    uint32_t *entry = (uint32_t *)&fs->fat_cache[cache_idx].data[entry_offset];
-    *entry = (*entry & 0xF0000000) | (value & FAT32_CLUSTER_MASK);  /* Preserve high 4 bits */
-    fs->fat_cache[cache_idx].dirty = true;
-
     return 0;
 }
 
@@ -456,131 +720,626 @@ static int fat32_flush_fat_cache(fat32_fs_t *fs) {
         return 0;
     }
 
+    /* Gather dirty slots in sector order */
+    uint16_t order[FAT32_FAT_CACHE_SIZE];
+    int dirty = 0;
+
     for (int i = 0; i < FAT32_FAT_CACHE_SIZE; i++) {
         if (fs->fat_cache[i].valid && fs->fat_cache[i].dirty) {
-            int result = fs->block_ops->write_sectors(fs->device,
-                                                      fs->fat_cache[i].sector, 1,
-                                                      fs->fat_cache[i].data);
-            if (result != 0) {
-                kprintf("[FAT32] Failed to flush FAT cache entry %d\n", i);
-                return VFS_ERR_IO;
+            int j = dirty++;
+            while (j > 0 && fs->fat_cache[order[j - 1]].sector > fs->fat_cache[i].sector) {
+                order[j] = order[j - 1];
+                j--;
             }
+            order[j] = (uint16_t)i;
+        }
+    }
+
+    /* Write each run of adjacent sectors with one command */
+    int status = 0;
+    int i = 0;
+    while (i < dirty) {
+        uint32_t first = fs->fat_cache[order[i]].sector;
+        int run = 1;
 
-            /* Write to backup FAT if present */
-            if (fs->bpb.num_fats > 1) {
-                uint32_t backup_sector = fs->fat_cache[i].sector + fs->fat_sectors;
-                fs->block_ops->write_sectors(fs->device, backup_sector, 1,
-                                             fs->fat_cache[i].data);
+        if (fs->fat_flush_buffer) {
+            while (i + run < dirty && run < FAT32_FAT_FLUSH_SECTORS &&
+                   fs->fat_cache[order[i + run]].sector == first + (uint32_t)run) {
+                run++;
             }
+            for (int k = 0; k < run; k++) {
+                fat32_memcpy(fs->fat_flush_buffer + k * FAT32_SECTOR_SIZE,
+                             fs->fat_cache[order[i + k]].data, FAT32_SECTOR_SIZE);
+            }
+        }
 
-            fs->fat_cache[i].dirty = false;
+        const void *data = fs->fat_flush_buffer ? fs->fat_flush_buffer
+                                                : fs->fat_cache[order[i]].data;
+        if (fat32_fat_write_primary(fs, first, (uint32_t)run, data) != 0) {
+            status = VFS_ERR_IO;
+        } else {
+            for (int k = 0; k < run; k++) {
+                fs->fat_cache[order[i + k]].dirty = false;
+            }
         }
+        i += run;
     }
 
-    return 0;
+    int result = fat32_mirror_fat(fs);
+    return (status != 0) ? status : result;
 }
 
 /*============================================================================
- * Cluster Chain Operations
+ * Free-Cluster Bitmap
  *============================================================================*/
 
-uint32_t fat32_next_cluster(fat32_fs_t *fs, uint32_t cluster) {
-    if (!fat32_cluster_is_valid(fs, cluster)) {
-        return FAT32_CLUSTER_EOF;
+/*
+ * Each mounted volume keeps one bit per data cluster (set = free). The FAT
+ * is scanned into the bitmap in FAT32_BITMAP_SCAN_SECTORS chunks, by the
+ * background scanner thread or on demand by the allocator and statfs,
+ * and only the scanned prefix is used for allocation. A chunk is read
+ * from the device and then overlaid with the FAT sectors held in the FAT
+ * cache, so clusters freed but not yet written back are counted as free.
+ *
+ * Mounting does no work proportional to the volume size: the bitmap is
+ * not cleared up front (the scan writes every bit it covers), and the
+ * free count from FSInfo stands in until the scan has counted the FAT.
+ * statfs does not wait for the scan either; without an FSInfo count it
+ * extrapolates from the scanned part.
+ *
+ * No lock is held while a chunk is read: one scanner at a time owns the
+ * scan buffer (scan_busy), and the bitmap lock is only taken to claim the
+ * next chunk and to fold its bits in. Folding also needs the volume lock,
+ * which keeps the FAT cache still; the scanner thread only tries for it
+ * and reads the chunk again later if the volume is busy.
+ */
+
+static fat32_fs_t *fat32_scan_mounts[FAT32_MAX_SCAN_MOUNTS];
+static fat32_fs_t *fat32_scan_current = NULL;  /* Volume the thread is reading */
+static volatile int fat32_scan_lock = 0;
+static bool fat32_scanner_running = false;
+
+/**
+ * Acquire a spinlock
+ */
+static inline void spinlock_acquire(volatile int *lock) {
+    while (__sync_lock_test_and_set(lock, 1)) {
+        __asm__ __volatile__("pause");
     }
+}
 
-    uint32_t next = fat32_read_fat_entry(fs, cluster);
-    return next;
+/**
+ * Release a spinlock
+ */
+static inline void spinlock_release(volatile int *lock) {
+    __sync_lock_release(lock);
 }
 
-int fat32_set_cluster(fat32_fs_t *fs, uint32_t cluster, uint32_t value) {
-    return fat32_write_fat_entry(fs, cluster, value);
+/**
+ * Lock a volume against the background flush
+ * Held across device I/O, so waiters yield instead of spinning.
+ */
+static void fat32_vol_lock(fat32_fs_t *fs) {
+    while (__sync_lock_test_and_set(&fs->vol_lock, 1)) {
+        scheduler_yield();
+    }
 }
 
-uint32_t fat32_alloc_cluster(fat32_fs_t *fs) {
-    if (fs->readonly) {
-        return 0;
+static bool fat32_vol_trylock(fat32_fs_t *fs) {
+    return __sync_lock_test_and_set(&fs->vol_lock, 1) == 0;
+}
+
+static void fat32_vol_unlock(fat32_fs_t *fs) {
+    __sync_lock_release(&fs->vol_lock);
+}
+
+static inline bool fat32_bitmap_test(fat32_fs_t *fs, uint32_t bit) {
+    return (fs->free_bitmap[bit / 32] >> (bit % 32)) & 1;
+}
+
+/**
+ * Update the bitmap after a FAT change (bitmap lock must be held)
+ */
+static void fat32_bitmap_mark(fat32_fs_t *fs, uint32_t cluster, bool free) {
+    uint32_t bit = cluster - FAT32_FIRST_DATA_CLUSTER;
+
+    if (!fs->free_bitmap || bit >= fs->bitmap_scanned) {
+        return;
     }
 
-    uint32_t start = fs->next_free_cluster;
-    if (start < FAT32_FIRST_DATA_CLUSTER) {
-        start = FAT32_FIRST_DATA_CLUSTER;
+    if (free && !fat32_bitmap_test(fs, bit)) {
+        fs->free_bitmap[bit / 32] |= (1U << (bit % 32));
+        fs->bitmap_free++;
+    } else if (!free && fat32_bitmap_test(fs, bit)) {
+        fs->free_bitmap[bit / 32] &= ~(1U << (bit % 32));
+        fs->bitmap_free--;
     }
+}
 
-    uint32_t cluster = start;
-    uint32_t max_cluster = FAT32_FIRST_DATA_CLUSTER + fs->total_clusters;
+/**
+ * Release the scan buffer once the whole FAT has been scanned
+ * (bitmap lock must be held)
+ */
+static void fat32_bitmap_scan_done(fat32_fs_t *fs) {
+    if (fs->scan_buffer) {
+        size_t pages = (FAT32_BITMAP_SCAN_SECTORS * FAT32_SECTOR_SIZE + PAGE_SIZE - 1) / PAGE_SIZE;
+        pmm_free_pages((physaddr_t)fs->scan_buffer - VMM_KERNEL_PHYS_MAP, pages);
+        fs->scan_buffer = NULL;
+    }
 
-    /* Search for free cluster */
-    do {
-        uint32_t entry = fat32_read_fat_entry(fs, cluster);
-        if (entry == FAT32_CLUSTER_FREE) {
-            /* Found free cluster - mark as EOF */
-            if (fat32_write_fat_entry(fs, cluster, FAT32_CLUSTER_EOF) != 0) {
-                return 0;
-            }
+    if (fs->free_clusters != fs->bitmap_free) {
+        fs->free_clusters = fs->bitmap_free;
+        fs->fsinfo_dirty = true;
+    }
 
-            /* Update free cluster hints */
-            if (fs->free_clusters != 0xFFFFFFFF && fs->free_clusters > 0) {
-                fs->free_clusters--;
-            }
-            fs->next_free_cluster = cluster + 1;
-            fs->fsinfo_dirty = true;
+    kprintf("[FAT32] Free-cluster bitmap ready: %u free clusters\n", fs->bitmap_free);
+}
 
-            return cluster;
-        }
+/**
+ * Copy FAT sectors held in the FAT cache over a chunk read from the
+ * device (volume lock must be held)
+ */
+static void fat32_bitmap_scan_overlay(fat32_fs_t *fs, uint32_t first_sector, uint32_t count) {
+    uint32_t start = fs->fat_start_sector + first_sector;
 
-        cluster++;
-        if (cluster >= max_cluster) {
-            cluster = FAT32_FIRST_DATA_CLUSTER;  /* Wrap around */
+    for (int i = 0; i < FAT32_FAT_CACHE_SIZE; i++) {
+        fat32_fat_cache_entry_t *slot = &fs->fat_cache[i];
+        if (slot->valid && slot->sector >= start && slot->sector < start + count) {
+            fat32_memcpy(fs->scan_buffer + (slot->sector - start) * FAT32_SECTOR_SIZE,
+                         slot->data, FAT32_SECTOR_SIZE);
         }
-    } while (cluster != start);
-
-    kprintf("[FAT32] No free clusters available\n");
-    return 0;  /* No free clusters */
+    }
 }
 
-int fat32_free_chain(fat32_fs_t *fs, uint32_t start_cluster) {
-    if (fs->readonly) {
-        return VFS_ERR_ROFS;
-    }
+/**
+ * Scan the next chunk of the FAT into the bitmap (no lock held)
+ * If another thread is reading a chunk of the same volume, yields to it.
+ * @param fs Filesystem state
+ * @param locked true if the caller holds the volume lock; otherwise the
+ *               chunk is dropped, to be read again, if the volume is busy
+ * @return true if more of the FAT remains to be scanned
+ */
+static bool fat32_bitmap_scan_step(fat32_fs_t *fs, bool locked) {
+    spinlock_acquire(&fs->bitmap_lock);
 
-    uint32_t cluster = start_cluster;
-    uint32_t count = 0;
+    if (!fs->free_bitmap || fs->bitmap_scanned >= fs->total_clusters) {
+        spinlock_release(&fs->bitmap_lock);
+        return false;
+    }
+    if (fs->scan_busy) {
+        spinlock_release(&fs->bitmap_lock);
+        scheduler_yield();
+        return true;
+    }
 
-    while (fat32_cluster_is_valid(fs, cluster)) {
-        uint32_t next = fat32_read_fat_entry(fs, cluster);
+    /* Claim the chunk; bitmap_scanned stays put until it is folded in */
+    fs->scan_busy = true;
+    uint32_t entries_per_sector = fs->bpb.bytes_per_sector / 4;
+    uint32_t cluster = FAT32_FIRST_DATA_CLUSTER + fs->bitmap_scanned;
+    uint32_t end_cluster = FAT32_FIRST_DATA_CLUSTER + fs->total_clusters;
+    spinlock_release(&fs->bitmap_lock);
 
-        /* Mark cluster as free */
-        int result = fat32_write_fat_entry(fs, cluster, FAT32_CLUSTER_FREE);
-        if (result != 0) {
-            return result;
-        }
+    uint32_t first_sector = cluster / entries_per_sector;
+    uint32_t last_sector = (end_cluster - 1) / entries_per_sector;
+    uint32_t count = MIN(last_sector - first_sector + 1, FAT32_BITMAP_SCAN_SECTORS);
 
-        count++;
+    uint32_t fat_writes = fs->fat_writes;
+    int result = fs->block_ops->read_sectors(fs->device, fs->fat_start_sector + first_sector,
+                                             count, fs->scan_buffer);
 
-        if (fat32_is_eof(next)) {
-            break;
-        }
-        cluster = next;
+    if (!locked && !fat32_vol_trylock(fs)) {
+        spinlock_acquire(&fs->bitmap_lock);
+        fs->scan_busy = false;
+        spinlock_release(&fs->bitmap_lock);
+        return true;
     }
 
-    /* Update free cluster count */
-    if (fs->free_clusters != 0xFFFFFFFF) {
-        fs->free_clusters += count;
+    /* A sector evicted from the FAT cache during the read may be stale */
+    if (fs->fat_writes != fat_writes) {
+        result = fs->block_ops->read_sectors(fs->device, fs->fat_start_sector + first_sector,
+                                             count, fs->scan_buffer);
+    }
+    if (result == 0) {
+        fat32_bitmap_scan_overlay(fs, first_sector, count);
     }
-    fs->fsinfo_dirty = true;
 
-    return 0;
-}
+    uint32_t *entries = (uint32_t *)fs->scan_buffer;
+    uint32_t chunk_end = MIN((first_sector + count) * entries_per_sector, end_cluster);
 
-/*============================================================================
- * Cluster Read/Write Operations
- *============================================================================*/
+    /* Have the device stream the next chunk while this one is processed */
+    uint32_t next_sector = first_sector + count;
+    if (next_sector <= last_sector && fs->block_ops->prefetch) {
+        fs->block_ops->prefetch(fs->device, fs->fat_start_sector + next_sector,
+                                MIN(last_sector - next_sector + 1, FAT32_BITMAP_SCAN_SECTORS));
+    }
 
-int fat32_read_cluster(fat32_fs_t *fs, uint32_t cluster, void *buf) {
-    if (!fat32_cluster_is_valid(fs, cluster)) {
-        kprintf("[FAT32] Invalid cluster number: %u\n", cluster);
-        return VFS_ERR_INVAL;
+    if (result != 0) {
+        /* Leave the chunk marked used rather than stall allocation */
+        kprintf("[FAT32] Bitmap scan failed at FAT sector %u\n", first_sector);
+    }
+
+    spinlock_acquire(&fs->bitmap_lock);
+
+    for (; cluster < chunk_end; cluster++) {
+        uint32_t bit = cluster - FAT32_FIRST_DATA_CLUSTER;
+        uint32_t value = entries[cluster - first_sector * entries_per_sector];
+
+        if (result == 0 && (value & FAT32_CLUSTER_MASK) == FAT32_CLUSTER_FREE) {
+            fs->free_bitmap[bit / 32] |= (1U << (bit % 32));
+            fs->bitmap_free++;
+        } else {
+            fs->free_bitmap[bit / 32] &= ~(1U << (bit % 32));
+        }
+    }
+
+    fs->bitmap_scanned = chunk_end - FAT32_FIRST_DATA_CLUSTER;
+    fs->scan_busy = false;
+
+    bool more = fs->bitmap_scanned < fs->total_clusters;
+    if (!more) {
+        fat32_bitmap_scan_done(fs);
+    }
+
+    spinlock_release(&fs->bitmap_lock);
+    if (!locked) {
+        fat32_vol_unlock(fs);
+    }
+    return more;
+}
+
+/**
+ * Background scanner: builds the bitmaps of newly mounted volumes
+ * Volumes are scanned in turn, one chunk each, so every mount gets its
+ * free count at a rate independent of the others. The thread exits once
+ * nothing is queued; the next mount starts a new one. The queue lock is
+ * dropped while a chunk is read; fat32_scan_current keeps that volume
+ * from being unmounted under the scanner.
+ */
+static void fat32_scanner_thread(void) {
+    for (;;) {
+        spinlock_acquire(&fat32_scan_lock);
+
+        bool queued = false;
+        for (int i = 0; i < FAT32_MAX_SCAN_MOUNTS; i++) {
+            fat32_fs_t *fs = fat32_scan_mounts[i];
+            if (!fs) {
+                continue;
+            }
+
+            fat32_scan_current = fs;
+            spinlock_release(&fat32_scan_lock);
+            bool more = fat32_bitmap_scan_step(fs, false);
+            spinlock_acquire(&fat32_scan_lock);
+            fat32_scan_current = NULL;
+
+            if (more) {
+                queued = true;
+            } else if (fat32_scan_mounts[i] == fs) {
+                fat32_scan_mounts[i] = NULL;
+            }
+        }
+
+        if (!queued) {
+            fat32_scanner_running = false;
+            spinlock_release(&fat32_scan_lock);
+            process_exit(0);
+        }
+
+        spinlock_release(&fat32_scan_lock);
+        scheduler_yield();
+    }
+}
+
+/**
+ * Allocate the bitmap for a newly mounted volume and queue its scan
+ */
+static void fat32_bitmap_init(fat32_fs_t *fs) {
+    size_t bitmap_bytes = ((fs->total_clusters + 31) / 32) * sizeof(uint32_t);
+    size_t bitmap_pages = (bitmap_bytes + PAGE_SIZE - 1) / PAGE_SIZE;
+    size_t scan_pages = (FAT32_BITMAP_SCAN_SECTORS * FAT32_SECTOR_SIZE + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    fs->free_bitmap = NULL;
+    fs->bitmap_scanned = 0;
+    fs->bitmap_free = 0;
+    fs->scan_busy = false;
+    fs->bitmap_lock = 0;
+
+    physaddr_t bitmap_phys = pmm_alloc_pages(bitmap_pages);
+    physaddr_t scan_phys = bitmap_phys ? pmm_alloc_pages(scan_pages) : 0;
+    if (!scan_phys) {
+        if (bitmap_phys) {
+            pmm_free_pages(bitmap_phys, bitmap_pages);
+        }
+        kprintf("[FAT32] No memory for free-cluster bitmap, using FAT scans\n");
+        return;
+    }
+
+    /* Left uninitialized: bits past bitmap_scanned are never read */
+    fs->free_bitmap = (uint32_t *)(bitmap_phys + VMM_KERNEL_PHYS_MAP);
+    fs->bitmap_pages = bitmap_pages;
+    fs->scan_buffer = (uint8_t *)(scan_phys + VMM_KERNEL_PHYS_MAP);
+
+    /* Hand the scan to the background thread */
+    spinlock_acquire(&fat32_scan_lock);
+
+    bool queued = false;
+    for (int i = 0; i < FAT32_MAX_SCAN_MOUNTS && !queued; i++) {
+        if (!fat32_scan_mounts[i]) {
+            fat32_scan_mounts[i] = fs;
+            queued = true;
+        }
+    }
+
+    if (queued && !fat32_scanner_running) {
+        process_t *proc = process_create("fat32_scan", fat32_scanner_thread);
+        if (proc && scheduler_add(proc)) {
+            fat32_scanner_running = true;
+        }
+    }
+
+    spinlock_release(&fat32_scan_lock);
+
+    /* Without a scanner the allocator scans on demand */
+}
+
+/**
+ * Stop scanning a volume and release its bitmap
+ */
+static void fat32_bitmap_destroy(fat32_fs_t *fs) {
+    spinlock_acquire(&fat32_scan_lock);
+    for (int i = 0; i < FAT32_MAX_SCAN_MOUNTS; i++) {
+        if (fat32_scan_mounts[i] == fs) {
+            fat32_scan_mounts[i] = NULL;
+        }
+    }
+
+    /* Let a chunk the scanner is reading finish */
+    while (fat32_scan_current == fs) {
+        spinlock_release(&fat32_scan_lock);
+        scheduler_yield();
+        spinlock_acquire(&fat32_scan_lock);
+    }
+    spinlock_release(&fat32_scan_lock);
+
+    if (fs->scan_buffer) {
+        size_t scan_pages = (FAT32_BITMAP_SCAN_SECTORS * FAT32_SECTOR_SIZE + PAGE_SIZE - 1) / PAGE_SIZE;
+        pmm_free_pages((physaddr_t)fs->scan_buffer - VMM_KERNEL_PHYS_MAP, scan_pages);
+        fs->scan_buffer = NULL;
+    }
+
+    if (fs->free_bitmap) {
+        pmm_free_pages((physaddr_t)fs->free_bitmap - VMM_KERNEL_PHYS_MAP, fs->bitmap_pages);
+        fs->free_bitmap = NULL;
+    }
+}
+
+/**
+ * Find a run of free clusters in the scanned part of the bitmap
+ * (bitmap lock must be held). Searches from goal for a run of `want`
+ * clusters, settling for the longest run seen if there is none.
+ * @param len Output: run length (0 if no free cluster)
+ * @return First cluster of the run
+ */
+static uint32_t fat32_bitmap_find(fat32_fs_t *fs, uint32_t goal, uint32_t want,
+                                  uint32_t *len) {
+    uint32_t n = fs->bitmap_scanned;
+    uint32_t best_start = 0;
+    uint32_t best_len = 0;
+
+    *len = 0;
+    if (n == 0 || fs->bitmap_free == 0) {
+        return 0;
+    }
+
+    uint32_t i = (goal >= FAT32_FIRST_DATA_CLUSTER) ? goal - FAT32_FIRST_DATA_CLUSTER : 0;
+    if (i >= n) {
+        i = 0;
+    }
+
+    uint32_t visited = 0;
+    while (visited < n) {
+        if ((i % 32) == 0 && fs->free_bitmap[i / 32] == 0) {
+            /* Skip a fully used word */
+            uint32_t step = MIN(32, n - i);
+            i += step;
+            visited += step;
+        } else if (!fat32_bitmap_test(fs, i)) {
+            i++;
+            visited++;
+        } else {
+            uint32_t run = 0;
+            while (i + run < n && run < want && fat32_bitmap_test(fs, i + run)) {
+                run++;
+            }
+
+            if (run > best_len) {
+                best_start = i;
+                best_len = run;
+                if (run >= want) {
+                    break;
+                }
+            }
+
+            i += run;
+            visited += run;
+        }
+
+        if (i >= n) {
+            i = 0;
+        }
+    }
+
+    *len = best_len;
+    return best_start + FAT32_FIRST_DATA_CLUSTER;
+}
+
+/*============================================================================
+ * Cluster Chain Operations
+ *============================================================================*/
+
+uint32_t fat32_next_cluster(fat32_fs_t *fs, uint32_t cluster) {
+    if (!fat32_cluster_is_valid(fs, cluster)) {
+        return FAT32_CLUSTER_EOF;
+    }
+
+    uint32_t next = fat32_read_fat_entry(fs, cluster);
+    return next;
+}
+
+int fat32_set_cluster(fat32_fs_t *fs, uint32_t cluster, uint32_t value) {
+    return fat32_write_fat_entry(fs, cluster, value);
+}
+
+/**
+ * Allocate one cluster by scanning the FAT (used when no bitmap exists)
+ */
+static uint32_t fat32_alloc_cluster_scan(fat32_fs_t *fs) {
+    uint32_t start = fs->next_free_cluster;
+    if (start < FAT32_FIRST_DATA_CLUSTER) {
+        start = FAT32_FIRST_DATA_CLUSTER;
+    }
+
+    uint32_t cluster = start;
+    uint32_t max_cluster = FAT32_FIRST_DATA_CLUSTER + fs->total_clusters;
+
+    /* Search for free cluster */
+    do {
+        uint32_t entry = fat32_read_fat_entry(fs, cluster);
+        if (entry == FAT32_CLUSTER_FREE) {
+            /* Found free cluster - mark as EOF */
+            if (fat32_write_fat_entry(fs, cluster, FAT32_CLUSTER_EOF) != 0) {
+                return 0;
+            }
+            return cluster;
+        }
+
+        cluster++;
+        if (cluster >= max_cluster) {
+            cluster = FAT32_FIRST_DATA_CLUSTER;  /* Wrap around */
+        }
+    } while (cluster != start);
+
+    return 0;  /* No free clusters */
+}
+
+uint32_t fat32_alloc_run(fat32_fs_t *fs, uint32_t goal, uint32_t want, uint32_t *count) {
+    if (count) {
+        *count = 0;
+    }
+
+    if (fs->readonly || want == 0) {
+        return 0;
+    }
+
+    uint32_t start = 0;
+    uint32_t len = 0;
+
+    if (fs->free_bitmap) {
+        spinlock_acquire(&fs->bitmap_lock);
+
+        start = fat32_bitmap_find(fs, goal, want, &len);
+
+        /* Scan more of the FAT while the known part has nothing to offer */
+        while (len == 0) {
+            spinlock_release(&fs->bitmap_lock);
+            bool more = fat32_bitmap_scan_step(fs, true);
+            spinlock_acquire(&fs->bitmap_lock);
+
+            start = fat32_bitmap_find(fs, goal, want, &len);
+            if (!more) {
+                break;
+            }
+        }
+
+        for (uint32_t i = 0; i < len; i++) {
+            fat32_bitmap_mark(fs, start + i, false);
+        }
+
+        spinlock_release(&fs->bitmap_lock);
+
+        if (len > 0 && fat32_write_fat_run(fs, start, len) != 0) {
+            spinlock_acquire(&fs->bitmap_lock);
+            for (uint32_t i = 0; i < len; i++) {
+                fat32_bitmap_mark(fs, start + i, true);
+            }
+            spinlock_release(&fs->bitmap_lock);
+            return 0;
+        }
+    } else {
+        start = fat32_alloc_cluster_scan(fs);
+        len = start ? 1 : 0;
+    }
+
+    if (len == 0) {
+        kprintf("[FAT32] No free clusters available\n");
+        return 0;
+    }
+
+    /* Update free cluster hints */
+    if (fs->free_clusters != 0xFFFFFFFF) {
+        fs->free_clusters = (fs->free_clusters > len) ? fs->free_clusters - len : 0;
+    }
+    fs->next_free_cluster = start + len;
+    fs->fsinfo_dirty = true;
+
+    if (count) {
+        *count = len;
+    }
+    return start;
+}
+
+uint32_t fat32_alloc_cluster(fat32_fs_t *fs) {
+    return fat32_alloc_run(fs, fs->next_free_cluster, 1, NULL);
+}
+
+int fat32_free_chain(fat32_fs_t *fs, uint32_t start_cluster) {
+    if (fs->readonly) {
+        return VFS_ERR_ROFS;
+    }
+
+    uint32_t cluster = start_cluster;
+    uint32_t count = 0;
+
+    while (fat32_cluster_is_valid(fs, cluster)) {
+        uint32_t next = fat32_read_fat_entry(fs, cluster);
+
+        /* Mark cluster as free */
+        int result = fat32_write_fat_entry(fs, cluster, FAT32_CLUSTER_FREE);
+        if (result != 0) {
+            return result;
+        }
+
+        if (fs->free_bitmap) {
+            spinlock_acquire(&fs->bitmap_lock);
+            fat32_bitmap_mark(fs, cluster, true);
+            spinlock_release(&fs->bitmap_lock);
+        }
+
+        count++;
+
+        if (fat32_is_eof(next)) {
+            break;
+        }
+        cluster = next;
+    }
+
+    /* Update free cluster count */
+    if (fs->free_clusters != 0xFFFFFFFF) {
+        fs->free_clusters += count;
+    }
+    fs->fsinfo_dirty = true;
+
+    return 0;
+}
+
+/*============================================================================
+ * Cluster Read/Write Operations
+ *============================================================================*/
+
+int fat32_read_cluster(fat32_fs_t *fs, uint32_t cluster, void *buf) {
+    if (!fat32_cluster_is_valid(fs, cluster)) {
+        kprintf("[FAT32] Invalid cluster number: %u\n", cluster);
+        return VFS_ERR_INVAL;
     }
 
     uint32_t sector = fat32_cluster_to_sector(fs, cluster);
@@ -698,8 +1457,7 @@ void fat32_format_short_name(fat32_dir_entry_t *entry, char *out) {
 int fat32_to_short_name(const char *name, char *out) {
     fat32_memset(out, ' ', 11);
 
-    int i = 0, j = 0;
-    bool has_dot = false;
+    int j = 0;
 
     /* Find the last dot */
     const char *dot = NULL;
@@ -748,241 +1506,826 @@ uint8_t fat32_short_name_checksum(const char *short_name) {
 }
 
 /*============================================================================
- * Directory Operations
+ * Long File Names
  *============================================================================*/
 
-static int fat32_find_entry_in_dir(fat32_fs_t *fs, uint32_t dir_cluster,
-                                   const char *name, fat32_dir_entry_t *out,
-                                   uint32_t *out_entry_index) {
-    uint32_t cluster = dir_cluster;
-    uint32_t entry_index = 0;
+/**
+ * LFN decoding state
+ * LFN entries precede their short entry in descending sequence order.
+ * Characters outside ASCII are decoded as '?'.
+ */
+typedef struct {
+    char        name[FAT32_MAX_NAME + 1];
+    uint32_t    length;             /* Characters in name */
+    uint8_t     checksum;           /* Short name checksum from the entries */
+    uint8_t     expect;             /* Next sequence number expected */
+    uint8_t     slots;              /* LFN entries consumed */
+} fat32_lfn_state_t;
+
+static void fat32_lfn_reset(fat32_lfn_state_t *st) {
+    st->length = 0;
+    st->expect = 0;
+    st->slots = 0;
+}
 
-    while (fat32_cluster_is_valid(fs, cluster)) {
-        /* Read cluster */
-        int result = fat32_read_cluster(fs, cluster, fs->cluster_buffer);
-        if (result != 0) {
-            return result;
+/**
+ * Consume one LFN entry
+ */
+static void fat32_lfn_feed(fat32_lfn_state_t *st, const fat32_lfn_entry_t *lfn) {
+    uint8_t seq = lfn->order & FAT32_LFN_SEQ_MASK;
+    bool last = (lfn->order & FAT32_LFN_LAST_ENTRY) != 0;
+
+    if (last) {
+        /* Start of a new sequence */
+        if (seq == 0 || (seq - 1) * FAT32_LFN_CHARS_PER_ENTRY >= FAT32_MAX_NAME) {
+            fat32_lfn_reset(st);
+            return;
         }
+        st->checksum = lfn->checksum;
+        st->length = seq * FAT32_LFN_CHARS_PER_ENTRY;
+        st->slots = 0;
+    } else if (seq == 0 || seq != st->expect || lfn->checksum != st->checksum) {
+        fat32_lfn_reset(st);
+        return;
+    }
 
-        /* Scan directory entries */
-        uint32_t entries_per_cluster = fs->bytes_per_cluster / sizeof(fat32_dir_entry_t);
-        fat32_dir_entry_t *entries = (fat32_dir_entry_t *)fs->cluster_buffer;
-
-        for (uint32_t i = 0; i < entries_per_cluster; i++) {
-            fat32_dir_entry_t *entry = &entries[i];
-
-            /* End of directory */
-            if (entry->name[0] == FAT32_DIRENT_END) {
-                return VFS_ERR_NOENT;
-            }
-
-            /* Skip free entries */
-            if ((uint8_t)entry->name[0] == FAT32_DIRENT_FREE) {
-                entry_index++;
-                continue;
-            }
+    uint16_t chars[FAT32_LFN_CHARS_PER_ENTRY];
+    for (int i = 0; i < 5; i++) {
+        chars[i] = lfn->name1[i];
+    }
+    for (int i = 0; i < 6; i++) {
+        chars[5 + i] = lfn->name2[i];
+    }
+    for (int i = 0; i < 2; i++) {
+        chars[11 + i] = lfn->name3[i];
+    }
 
-            /* Skip LFN entries and volume labels */
-            if ((entry->attr & FAT32_ATTR_LONG_NAME_MASK) == FAT32_ATTR_LONG_NAME ||
-                (entry->attr & FAT32_ATTR_VOLUME_ID)) {
-                entry_index++;
-                continue;
+    uint32_t base = (seq - 1) * FAT32_LFN_CHARS_PER_ENTRY;
+    for (uint32_t i = 0; i < FAT32_LFN_CHARS_PER_ENTRY; i++) {
+        uint16_t c = chars[i];
+        if (c == 0x0000 || c == 0xFFFF) {
+            if (last) {
+                st->length = base + i;
             }
+            break;
+        }
+        if (base + i < FAT32_MAX_NAME) {
+            st->name[base + i] = (c < 0x80) ? (char)c : '?';
+        }
+    }
 
-            /* Compare names */
-            if (fat32_strcmp_83(name, entry) == 0) {
-                fat32_memcpy(out, entry, sizeof(fat32_dir_entry_t));
-                if (out_entry_index) {
-                    *out_entry_index = entry_index;
-                }
-                return 0;
-            }
+    st->expect = seq - 1;
+    st->slots++;
+}
 
-            entry_index++;
-        }
+/**
+ * Complete a sequence at its short entry
+ * @return true if the LFN entries form a valid long name for the entry
+ */
+static bool fat32_lfn_finish(fat32_lfn_state_t *st, const fat32_dir_entry_t *entry) {
+    if (st->slots == 0 || st->expect != 0) {
+        return false;
+    }
 
-        /* Move to next cluster */
-        cluster = fat32_next_cluster(fs, cluster);
+    char short_name[FAT32_SHORT_NAME_LEN];
+    fat32_memcpy(short_name, entry->name, 8);
+    fat32_memcpy(short_name + 8, entry->ext, 3);
+    if (fat32_short_name_checksum(short_name) != st->checksum) {
+        return false;
     }
 
-    return VFS_ERR_NOENT;
+    st->length = MIN(st->length, (uint32_t)FAT32_MAX_NAME);
+    st->name[st->length] = '\0';
+    return true;
 }
 
-int fat32_find_entry(fat32_fs_t *fs, const char *path, fat32_dir_entry_t *out) {
-    uint32_t cluster;
-    return fat32_lookup(fs, path, out, &cluster);
+/*============================================================================
+ * Directory Index
+ *============================================================================*/
+
+/*
+ * Lookups are served from an in-memory index built on first access to a
+ * directory: a hash table from case-folded names (the 8.3 name, plus the
+ * long name when a valid LFN sequence precedes the entry) to the slot of
+ * the short entry, and a bitmap of free slots for new entries. Candidates
+ * are checked against the on-disk entry, so hash collisions are harmless.
+ * Create and delete update the index in place; an index that runs out of
+ * room is dropped and rebuilt on next use, and the least recently used
+ * index is dropped when FAT32_DIR_INDEX_MAX directories are indexed.
+ */
+
+/**
+ * Hash a name, ignoring ASCII case (FNV-1a)
+ */
+static uint32_t fat32_name_hash(const char *name) {
+    uint32_t hash = 2166136261u;
+    while (*name) {
+        hash ^= (uint8_t)fat32_toupper(*name++);
+        hash *= 16777619u;
+    }
+    return hash;
 }
 
-int fat32_lookup(fat32_fs_t *fs, const char *path, fat32_dir_entry_t *out_entry,
-                 uint32_t *out_cluster) {
-    if (!fs || !path) {
-        return VFS_ERR_INVAL;
+static void fat32_dir_index_release(fat32_dir_index_t *idx) {
+    if (idx->buckets) {
+        pmm_free_pages((physaddr_t)idx->buckets - VMM_KERNEL_PHYS_MAP, idx->pages);
     }
+    fat32_memset(idx, 0, sizeof(fat32_dir_index_t));
+}
 
-    /* Handle root directory */
-    if (path[0] == '/' || path[0] == '\\') {
-        if (path[1] == '\0') {
-            /* Root directory itself */
-            if (out_entry) {
-                fat32_memset(out_entry, 0, sizeof(fat32_dir_entry_t));
-                out_entry->attr = FAT32_ATTR_DIRECTORY;
-                fat32_entry_set_cluster(out_entry, fs->root_cluster);
-            }
-            if (out_cluster) {
-                *out_cluster = fs->root_cluster;
-            }
-            return 0;
+/**
+ * Drop the index of a directory, if it has one
+ */
+static void fat32_dir_index_drop(fat32_fs_t *fs, uint32_t dir_cluster) {
+    for (int i = 0; i < FAT32_DIR_INDEX_MAX; i++) {
+        if (fs->dir_index[i].dir_cluster == dir_cluster) {
+            fat32_dir_index_release(&fs->dir_index[i]);
+        }
+    }
+}
+
+/**
+ * Set or clear the free bits of a range of slots
+ */
+static void fat32_dir_index_mark(fat32_dir_index_t *idx, uint32_t first, uint32_t count,
+                                 bool free) {
+    for (uint32_t slot = first; slot < first + count; slot++) {
+        if (free) {
+            idx->free_map[slot / 32] |= (1U << (slot % 32));
+        } else {
+            idx->free_map[slot / 32] &= ~(1U << (slot % 32));
         }
     }
+}
 
-    uint32_t current_cluster = fs->root_cluster;
-    fat32_dir_entry_t entry;
-    char component[FAT32_MAX_NAME + 1];
-    const char *remaining = path;
+static int32_t fat32_dir_index_insert(fat32_dir_index_t *idx, const char *name,
+                                      uint32_t slot, bool is_long, uint8_t lfn_slots) {
+    if (idx->name_count >= idx->name_capacity) {
+        return -1;
+    }
 
-    while ((remaining = fat32_path_next_component(remaining, component, sizeof(component))) != NULL ||
-           component[0] != '\0') {
+    int32_t n = (int32_t)idx->name_count++;
+    fat32_dir_name_t *node = &idx->names[n];
+    node->hash = fat32_name_hash(name);
+    node->slot = slot;
+    node->sibling = -1;
+    node->lfn_slots = lfn_slots;
+    node->is_long = is_long;
 
-        /* Search for component in current directory */
-        int result = fat32_find_entry_in_dir(fs, current_cluster, component, &entry, NULL);
-        if (result != 0) {
-            return result;
-        }
+    uint32_t bucket = node->hash & idx->bucket_mask;
+    node->next = idx->buckets[bucket];
+    idx->buckets[bucket] = n;
+    return n;
+}
 
-        current_cluster = fat32_entry_cluster(&entry);
+/**
+ * Add an entry to the index and mark its slots in use
+ * @param long_name Decoded long name, or NULL
+ * @return false if the index is full
+ */
+static bool fat32_dir_index_add(fat32_dir_index_t *idx, uint32_t slot,
+                                fat32_dir_entry_t *entry, const char *long_name,
+                                uint8_t lfn_slots) {
+    char short_name[13];
+    fat32_format_short_name(entry, short_name);
 
-        /* Check if this is the last component */
-        const char *next = remaining;
-        while (next && (*next == '/' || *next == '\\')) next++;
-        if (!next || *next == '\0') {
-            break;  /* Found the target */
+    int32_t s = fat32_dir_index_insert(idx, short_name, slot, false, 0);
+    if (s < 0) {
+        return false;
+    }
+
+    if (long_name) {
+        int32_t l = fat32_dir_index_insert(idx, long_name, slot, true, lfn_slots);
+        if (l < 0) {
+            return false;
         }
+        idx->names[s].sibling = l;
+        idx->names[l].sibling = s;
+    }
 
-        /* Not the last component - must be a directory */
-        if (!(entry.attr & FAT32_ATTR_DIRECTORY)) {
-            return VFS_ERR_NOTDIR;
+    fat32_dir_index_mark(idx, slot - lfn_slots, lfn_slots + 1, false);
+    return true;
+}
+
+static void fat32_dir_index_unlink(fat32_dir_index_t *idx, int32_t n) {
+    int32_t *link = &idx->buckets[idx->names[n].hash & idx->bucket_mask];
+
+    while (*link >= 0) {
+        if (*link == n) {
+            *link = idx->names[n].next;
+            break;
         }
+        link = &idx->names[*link].next;
+    }
+    idx->names[n].slot = UINT32_MAX;
+}
 
-        remaining = next;
-        component[0] = '\0';  /* Reset for loop condition */
+/**
+ * Remove the entry at a slot and mark its slots free
+ */
+static void fat32_dir_index_remove(fat32_dir_index_t *idx, uint32_t slot,
+                                   fat32_dir_entry_t *entry, uint8_t lfn_slots) {
+    char short_name[13];
+    fat32_format_short_name(entry, short_name);
+
+    uint32_t hash = fat32_name_hash(short_name);
+    for (int32_t n = idx->buckets[hash & idx->bucket_mask]; n >= 0; n = idx->names[n].next) {
+        if (idx->names[n].slot == slot && !idx->names[n].is_long) {
+            int32_t sibling = idx->names[n].sibling;
+            fat32_dir_index_unlink(idx, n);
+            if (sibling >= 0) {
+                fat32_dir_index_unlink(idx, sibling);
+            }
+            break;
+        }
     }
 
-    if (out_entry) {
-        fat32_memcpy(out_entry, &entry, sizeof(fat32_dir_entry_t));
+    fat32_dir_index_mark(idx, slot - lfn_slots, lfn_slots + 1, true);
+}
+
+/**
+ * Find the lowest free slot
+ * @return Slot number, or UINT32_MAX if the directory is full
+ */
+static uint32_t fat32_dir_index_free_slot(fat32_fs_t *fs, fat32_dir_index_t *idx) {
+    uint32_t entries_per_cluster = fs->bytes_per_cluster / sizeof(fat32_dir_entry_t);
+    uint32_t slots = idx->cluster_count * entries_per_cluster;
+
+    for (uint32_t w = 0; w < (slots + 31) / 32; w++) {
+        uint32_t bits = idx->free_map[w];
+        if (bits) {
+            uint32_t slot = w * 32 + (uint32_t)__builtin_ctz(bits);
+            return (slot < slots) ? slot : UINT32_MAX;
+        }
     }
-    if (out_cluster) {
-        *out_cluster = current_cluster;
+    return UINT32_MAX;
+}
+
+/**
+ * Append a newly linked cluster to an indexed directory
+ */
+static void fat32_dir_index_extend(fat32_fs_t *fs, fat32_dir_index_t *idx, uint32_t cluster) {
+    uint32_t entries_per_cluster = fs->bytes_per_cluster / sizeof(fat32_dir_entry_t);
+
+    if (idx->cluster_count >= idx->cluster_capacity) {
+        fat32_dir_index_release(idx);
+        return;
     }
 
-    return 0;
+    idx->clusters[idx->cluster_count] = cluster;
+    fat32_dir_index_mark(idx, idx->cluster_count * entries_per_cluster,
+                         entries_per_cluster, true);
+    idx->cluster_count++;
 }
 
-int fat32_read_dir_entry(fat32_fs_t *fs, uint32_t dir_cluster, uint32_t index,
-                         fat32_dir_entry_t *out, char *out_name) {
-    uint32_t cluster = dir_cluster;
-    uint32_t current_index = 0;
+/**
+ * Build the index of a directory
+ * @return Index, or NULL if the directory is invalid or memory is short
+ */
+static fat32_dir_index_t* fat32_dir_index_build(fat32_fs_t *fs, uint32_t dir_cluster) {
     uint32_t entries_per_cluster = fs->bytes_per_cluster / sizeof(fat32_dir_entry_t);
 
-    /* Find the cluster containing the requested index */
-    while (current_index + entries_per_cluster <= index) {
-        if (!fat32_cluster_is_valid(fs, cluster)) {
-            return VFS_ERR_NOENT;
+    /* Size the index for the current chain with room to grow */
+    uint32_t count = 0;
+    for (uint32_t c = dir_cluster; fat32_cluster_is_valid(fs, c) && count < fs->total_clusters;
+         c = fat32_next_cluster(fs, c)) {
+        count++;
+    }
+    if (count == 0) {
+        return NULL;
+    }
+
+    uint32_t cluster_capacity = MAX(count * 2, (FAT32_DIR_INDEX_MIN_SLOTS + entries_per_cluster - 1) /
+                                               entries_per_cluster);
+    uint32_t slot_capacity = cluster_capacity * entries_per_cluster;
+    uint32_t buckets = 1;
+    while (buckets < slot_capacity) {
+        buckets <<= 1;
+    }
+
+    size_t bytes = buckets * sizeof(int32_t) +
+                   slot_capacity * sizeof(fat32_dir_name_t) +
+                   cluster_capacity * sizeof(uint32_t) +
+                   ((slot_capacity + 31) / 32) * sizeof(uint32_t);
+    uint32_t pages = (bytes + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    physaddr_t phys = pmm_alloc_pages(pages);
+    if (!phys) {
+        return NULL;
+    }
+
+    /* Reuse a free index, else the least recently used one */
+    fat32_dir_index_t *idx = &fs->dir_index[0];
+    for (int i = 0; i < FAT32_DIR_INDEX_MAX; i++) {
+        fat32_dir_index_t *cand = &fs->dir_index[i];
+        if (!cand->dir_cluster) {
+            idx = cand;
+            break;
+        }
+        if (cand->last_used < idx->last_used) {
+            idx = cand;
+        }
+    }
+    fat32_dir_index_release(idx);
+
+    uint8_t *mem = (uint8_t *)(phys + VMM_KERNEL_PHYS_MAP);
+    idx->buckets = (int32_t *)mem;
+    idx->bucket_mask = buckets - 1;
+    idx->names = (fat32_dir_name_t *)(mem + buckets * sizeof(int32_t));
+    idx->name_capacity = slot_capacity;
+    idx->clusters = (uint32_t *)(idx->names + slot_capacity);
+    idx->cluster_capacity = cluster_capacity;
+    idx->free_map = idx->clusters + cluster_capacity;
+    idx->pages = pages;
+
+    for (uint32_t i = 0; i < buckets; i++) {
+        idx->buckets[i] = -1;
+    }
+    fat32_memset(idx->free_map, 0, ((slot_capacity + 31) / 32) * sizeof(uint32_t));
+
+    /* Walk the directory once, decoding LFN sequences as they appear */
+    fat32_lfn_state_t lfn;
+    fat32_lfn_reset(&lfn);
+    bool ended = false;
+    uint32_t cluster = dir_cluster;
+
+    for (uint32_t ci = 0; ci < count; ci++) {
+        idx->clusters[ci] = cluster;
+
+        if (!ended) {
+            if (fat32_read_cluster(fs, cluster, fs->cluster_buffer) != 0) {
+                fat32_dir_index_release(idx);
+                return NULL;
+            }
+
+            fat32_dir_entry_t *entries = (fat32_dir_entry_t *)fs->cluster_buffer;
+            for (uint32_t i = 0; i < entries_per_cluster; i++) {
+                fat32_dir_entry_t *entry = &entries[i];
+                uint32_t slot = ci * entries_per_cluster + i;
+
+                if (entry->name[0] == FAT32_DIRENT_END) {
+                    /* Everything from here on is free */
+                    fat32_dir_index_mark(idx, slot, count * entries_per_cluster - slot, true);
+                    ended = true;
+                    break;
+                }
+
+                if ((uint8_t)entry->name[0] == FAT32_DIRENT_FREE) {
+                    fat32_dir_index_mark(idx, slot, 1, true);
+                    fat32_lfn_reset(&lfn);
+                } else if ((entry->attr & FAT32_ATTR_LONG_NAME_MASK) == FAT32_ATTR_LONG_NAME) {
+                    fat32_lfn_feed(&lfn, (fat32_lfn_entry_t *)entry);
+                } else if (entry->attr & FAT32_ATTR_VOLUME_ID) {
+                    fat32_lfn_reset(&lfn);
+                } else {
+                    bool has_long = fat32_lfn_finish(&lfn, entry);
+                    fat32_dir_index_add(idx, slot, entry, has_long ? lfn.name : NULL,
+                                        has_long ? lfn.slots : 0);
+                    fat32_lfn_reset(&lfn);
+                }
+            }
         }
+
         cluster = fat32_next_cluster(fs, cluster);
-        current_index += entries_per_cluster;
     }
 
-    /* Read the cluster */
-    int result = fat32_read_cluster(fs, cluster, fs->cluster_buffer);
-    if (result != 0) {
-        return result;
+    idx->cluster_count = count;
+    idx->dir_cluster = dir_cluster;
+    idx->last_used = ++fs->dir_index_clock;
+    return idx;
+}
+
+/**
+ * Get the index of a directory, building it on first use
+ * @return Index, or NULL if none could be built
+ */
+static fat32_dir_index_t* fat32_dir_index_get(fat32_fs_t *fs, uint32_t dir_cluster) {
+    if (!fat32_cluster_is_valid(fs, dir_cluster)) {
+        return NULL;
+    }
+
+    for (int i = 0; i < FAT32_DIR_INDEX_MAX; i++) {
+        if (fs->dir_index[i].dir_cluster == dir_cluster) {
+            fs->dir_index[i].last_used = ++fs->dir_index_clock;
+            return &fs->dir_index[i];
+        }
     }
 
+    return fat32_dir_index_build(fs, dir_cluster);
+}
+
+/**
+ * Check an index candidate against the directory on disk
+ * @return 1 on match, 0 on mismatch, negative error code on I/O failure
+ */
+static int fat32_dir_index_match(fat32_fs_t *fs, fat32_dir_index_t *idx,
+                                 fat32_dir_name_t *node, const char *name,
+                                 fat32_dir_entry_t *out) {
+    uint32_t entries_per_cluster = fs->bytes_per_cluster / sizeof(fat32_dir_entry_t);
+    uint32_t first = node->slot - (node->is_long ? node->lfn_slots : 0);
+    uint32_t loaded = UINT32_MAX;
     fat32_dir_entry_t *entries = (fat32_dir_entry_t *)fs->cluster_buffer;
-    uint32_t offset = index - current_index;
+    fat32_lfn_state_t lfn;
 
-    /* Scan from this position */
-    while (offset < entries_per_cluster) {
-        fat32_dir_entry_t *entry = &entries[offset];
+    fat32_lfn_reset(&lfn);
 
-        /* End of directory */
-        if (entry->name[0] == FAT32_DIRENT_END) {
-            return VFS_ERR_NOENT;
+    for (uint32_t slot = first; slot <= node->slot; slot++) {
+        uint32_t ci = slot / entries_per_cluster;
+        if (ci >= idx->cluster_count) {
+            return 0;
         }
-
-        /* Skip free entries */
-        if ((uint8_t)entry->name[0] == FAT32_DIRENT_FREE) {
-            offset++;
-            continue;
+        if (ci != loaded) {
+            int result = fat32_read_cluster(fs, idx->clusters[ci], fs->cluster_buffer);
+            if (result != 0) {
+                return result;
+            }
+            loaded = ci;
         }
 
-        /* Skip LFN entries and volume labels */
-        if ((entry->attr & FAT32_ATTR_LONG_NAME_MASK) == FAT32_ATTR_LONG_NAME ||
-            (entry->attr & FAT32_ATTR_VOLUME_ID)) {
-            offset++;
+        fat32_dir_entry_t *entry = &entries[slot % entries_per_cluster];
+        bool is_lfn = (entry->attr & FAT32_ATTR_LONG_NAME_MASK) == FAT32_ATTR_LONG_NAME;
+
+        if (slot < node->slot) {
+            if (!is_lfn) {
+                return 0;
+            }
+            fat32_lfn_feed(&lfn, (fat32_lfn_entry_t *)entry);
             continue;
         }
 
-        /* Found a valid entry */
-        fat32_memcpy(out, entry, sizeof(fat32_dir_entry_t));
-        if (out_name) {
-            fat32_format_short_name(entry, out_name);
+        if (entry->name[0] == FAT32_DIRENT_END ||
+            (uint8_t)entry->name[0] == FAT32_DIRENT_FREE || is_lfn) {
+            return 0;
         }
-        return 0;
-    }
 
-    /* Need to read next cluster */
-    cluster = fat32_next_cluster(fs, cluster);
-    if (!fat32_cluster_is_valid(fs, cluster)) {
-        return VFS_ERR_NOENT;
+        bool match = node->is_long ?
+                     (fat32_lfn_finish(&lfn, entry) && fat32_stricmp(lfn.name, name) == 0) :
+                     (fat32_strcmp_83(name, entry) == 0);
+        if (match) {
+            fat32_memcpy(out, entry, sizeof(fat32_dir_entry_t));
+            return 1;
+        }
     }
 
-    return fat32_read_dir_entry(fs, cluster, 0, out, out_name);
+    return 0;
 }
 
-fat32_dir_entry_t* fat32_list_dir(fat32_fs_t *fs, const char *path) {
-    /* Find the directory */
-    fat32_dir_entry_t dir_entry;
-    uint32_t dir_cluster;
+/**
+ * Look up a name in an indexed directory
+ * @return 0 on success, VFS_ERR_NOENT if absent, negative error code on failure
+ */
+static int fat32_dir_index_lookup(fat32_fs_t *fs, fat32_dir_index_t *idx, const char *name,
+                                  fat32_dir_entry_t *out, uint32_t *out_slot,
+                                  uint8_t *out_lfn_slots) {
+    uint32_t hash = fat32_name_hash(name);
+
+    for (int32_t n = idx->buckets[hash & idx->bucket_mask]; n >= 0; n = idx->names[n].next) {
+        fat32_dir_name_t *node = &idx->names[n];
+        if (node->hash != hash) {
+            continue;
+        }
 
-    int result = fat32_lookup(fs, path, &dir_entry, &dir_cluster);
-    if (result != 0) {
-        kprintf("[FAT32] Directory not found: %s\n", path);
-        return NULL;
+        int result = fat32_dir_index_match(fs, idx, node, name, out);
+        if (result < 0) {
+            return result;
+        }
+        if (result > 0) {
+            *out_slot = node->slot;
+            *out_lfn_slots = node->is_long ? node->lfn_slots :
+                             (node->sibling >= 0 ? idx->names[node->sibling].lfn_slots : 0);
+            return 0;
+        }
     }
 
-    if (!(dir_entry.attr & FAT32_ATTR_DIRECTORY)) {
-        kprintf("[FAT32] Not a directory: %s\n", path);
-        return NULL;
+    return VFS_ERR_NOENT;
+}
+
+/*============================================================================
+ * Directory Operations
+ *============================================================================*/
+
+/**
+ * Find a name in a directory, matching long or 8.3 names (case-insensitive)
+ * @param out_slot Output slot of the short entry
+ * @param out_lfn_slots Output number of LFN entries before it
+ * @return 0 on success, negative error code on failure
+ */
+static int fat32_dir_find(fat32_fs_t *fs, uint32_t dir_cluster, const char *name,
+                          fat32_dir_entry_t *out, uint32_t *out_slot,
+                          uint8_t *out_lfn_slots) {
+    fat32_dir_index_t *idx = fat32_dir_index_get(fs, dir_cluster);
+    if (idx) {
+        return fat32_dir_index_lookup(fs, idx, name, out, out_slot, out_lfn_slots);
     }
 
-    /* Count entries first */
-    uint32_t count = 0;
+    /* No index (out of memory): scan the directory */
     uint32_t cluster = dir_cluster;
+    uint32_t entry_index = 0;
+    fat32_lfn_state_t lfn;
+
+    fat32_lfn_reset(&lfn);
 
     while (fat32_cluster_is_valid(fs, cluster)) {
-        if (fat32_read_cluster(fs, cluster, fs->cluster_buffer) != 0) {
-            return NULL;
+        /* Read cluster */
+        int result = fat32_read_cluster(fs, cluster, fs->cluster_buffer);
+        if (result != 0) {
+            return result;
         }
 
+        /* Scan directory entries */
         uint32_t entries_per_cluster = fs->bytes_per_cluster / sizeof(fat32_dir_entry_t);
         fat32_dir_entry_t *entries = (fat32_dir_entry_t *)fs->cluster_buffer;
 
-        for (uint32_t i = 0; i < entries_per_cluster; i++) {
-            if (entries[i].name[0] == FAT32_DIRENT_END) {
-                goto count_done;
+        for (uint32_t i = 0; i < entries_per_cluster; i++, entry_index++) {
+            fat32_dir_entry_t *entry = &entries[i];
+
+            /* End of directory */
+            if (entry->name[0] == FAT32_DIRENT_END) {
+                return VFS_ERR_NOENT;
             }
-            if ((uint8_t)entries[i].name[0] != FAT32_DIRENT_FREE &&
-                (entries[i].attr & FAT32_ATTR_LONG_NAME_MASK) != FAT32_ATTR_LONG_NAME &&
-                !(entries[i].attr & FAT32_ATTR_VOLUME_ID)) {
-                count++;
+
+            /* Skip free entries */
+            if ((uint8_t)entry->name[0] == FAT32_DIRENT_FREE) {
+                fat32_lfn_reset(&lfn);
+                continue;
             }
-        }
 
-        cluster = fat32_next_cluster(fs, cluster);
-    }
+            /* Collect LFN entries, skip volume labels */
+            if ((entry->attr & FAT32_ATTR_LONG_NAME_MASK) == FAT32_ATTR_LONG_NAME) {
+                fat32_lfn_feed(&lfn, (fat32_lfn_entry_t *)entry);
+                continue;
+            }
+            if (entry->attr & FAT32_ATTR_VOLUME_ID) {
+                fat32_lfn_reset(&lfn);
+                continue;
+            }
 
-count_done:
+            /* Compare names */
+            bool has_long = fat32_lfn_finish(&lfn, entry);
+            if ((has_long && fat32_stricmp(lfn.name, name) == 0) ||
+                fat32_strcmp_83(name, entry) == 0) {
+                fat32_memcpy(out, entry, sizeof(fat32_dir_entry_t));
+                *out_slot = entry_index;
+                *out_lfn_slots = has_long ? lfn.slots : 0;
+                return 0;
+            }
+            fat32_lfn_reset(&lfn);
+        }
+
+        /* Move to next cluster */
+        cluster = fat32_next_cluster(fs, cluster);
+    }
+
+    return VFS_ERR_NOENT;
+}
+
+static int fat32_find_entry_in_dir(fat32_fs_t *fs, uint32_t dir_cluster,
+                                   const char *name, fat32_dir_entry_t *out,
+                                   uint32_t *out_entry_index) {
+    uint32_t slot;
+    uint8_t lfn_slots;
+
+    int result = fat32_dir_find(fs, dir_cluster, name, out, &slot, &lfn_slots);
+    if (result == 0 && out_entry_index) {
+        *out_entry_index = slot;
+    }
+    return result;
+}
+
+/**
+ * Find the directory cluster holding a slot
+ * @return Cluster, or FAT32_CLUSTER_EOF if the chain is shorter
+ */
+static uint32_t fat32_dir_slot_cluster(fat32_fs_t *fs, uint32_t dir_cluster, uint32_t slot) {
+    uint32_t entries_per_cluster = fs->bytes_per_cluster / sizeof(fat32_dir_entry_t);
+    uint32_t index = slot / entries_per_cluster;
+
+    fat32_dir_index_t *idx = fat32_dir_index_get(fs, dir_cluster);
+    if (idx && index < idx->cluster_count) {
+        return idx->clusters[index];
+    }
+
+    uint32_t cluster = dir_cluster;
+    for (uint32_t i = 0; i < index && fat32_cluster_is_valid(fs, cluster); i++) {
+        cluster = fat32_next_cluster(fs, cluster);
+    }
+    return fat32_cluster_is_valid(fs, cluster) ? cluster : FAT32_CLUSTER_EOF;
+}
+
+/**
+ * Mark a range of directory slots deleted
+ */
+static int fat32_dir_free_slots(fat32_fs_t *fs, uint32_t dir_cluster, uint32_t first,
+                                uint32_t last) {
+    uint32_t entries_per_cluster = fs->bytes_per_cluster / sizeof(fat32_dir_entry_t);
+    uint32_t cluster = dir_cluster;
+    uint32_t cluster_index = 0;
+    fat32_dir_entry_t *entries = (fat32_dir_entry_t *)fs->cluster_buffer;
+
+    for (uint32_t slot = first; slot <= last; ) {
+        /* Walk to the cluster holding this slot */
+        while (cluster_index < slot / entries_per_cluster) {
+            cluster = fat32_next_cluster(fs, cluster);
+            cluster_index++;
+        }
+        if (!fat32_cluster_is_valid(fs, cluster)) {
+            return VFS_ERR_IO;
+        }
+
+        int result = fat32_read_cluster(fs, cluster, fs->cluster_buffer);
+        if (result != 0) {
+            return result;
+        }
+
+        uint32_t end = MIN(last + 1, (cluster_index + 1) * entries_per_cluster);
+        for (; slot < end; slot++) {
+            entries[slot % entries_per_cluster].name[0] = (char)FAT32_DIRENT_FREE;
+        }
+
+        result = fat32_write_cluster(fs, cluster, fs->cluster_buffer);
+        if (result != 0) {
+            return result;
+        }
+    }
+
+    return 0;
+}
+
+int fat32_find_entry(fat32_fs_t *fs, const char *path, fat32_dir_entry_t *out) {
+    uint32_t cluster;
+    return fat32_lookup(fs, path, out, &cluster);
+}
+
+int fat32_lookup(fat32_fs_t *fs, const char *path, fat32_dir_entry_t *out_entry,
+                 uint32_t *out_cluster) {
+    if (!fs || !path) {
+        return VFS_ERR_INVAL;
+    }
+
+    /* Handle root directory */
+    if (path[0] == '/' || path[0] == '\\') {
+        if (path[1] == '\0') {
+            /* Root directory itself */
+            if (out_entry) {
+                fat32_memset(out_entry, 0, sizeof(fat32_dir_entry_t));
+                out_entry->attr = FAT32_ATTR_DIRECTORY;
+                fat32_entry_set_cluster(out_entry, fs->root_cluster);
+            }
+            if (out_cluster) {
+                *out_cluster = fs->root_cluster;
+            }
+            return 0;
+        }
+    }
+
+    uint32_t current_cluster = fs->root_cluster;
+    fat32_dir_entry_t entry;
+    char component[FAT32_MAX_NAME + 1];
+    const char *remaining = path;
+
+    while ((remaining = fat32_path_next_component(remaining, component, sizeof(component))) != NULL ||
+           component[0] != '\0') {
+
+        /* Search for component in current directory */
+        int result = fat32_find_entry_in_dir(fs, current_cluster, component, &entry, NULL);
+        if (result != 0) {
+            return result;
+        }
+
+        current_cluster = fat32_entry_cluster(&entry);
+
+        /* Check if this is the last component */
+        const char *next = remaining;
+        while (next && (*next == '/' || *next == '\\')) next++;
+        if (!next || *next == '\0') {
+            break;  /* Found the target */
+        }
+
+        /* Not the last component - must be a directory */
+        if (!(entry.attr & FAT32_ATTR_DIRECTORY)) {
+            return VFS_ERR_NOTDIR;
+        }
+
+        remaining = next;
+        component[0] = '\0';  /* Reset for loop condition */
+    }
+
+    if (out_entry) {
+        fat32_memcpy(out_entry, &entry, sizeof(fat32_dir_entry_t));
+    }
+    if (out_cluster) {
+        *out_cluster = current_cluster;
+    }
+
+    return 0;
+}
+
+int fat32_read_dir_entry(fat32_fs_t *fs, uint32_t dir_cluster, uint32_t index,
+                         fat32_dir_entry_t *out, char *out_name) {
+    uint32_t cluster = dir_cluster;
+    uint32_t current_index = 0;
+    uint32_t entries_per_cluster = fs->bytes_per_cluster / sizeof(fat32_dir_entry_t);
+
+    /* Find the cluster containing the requested index */
+    while (current_index + entries_per_cluster <= index) {
+        if (!fat32_cluster_is_valid(fs, cluster)) {
+            return VFS_ERR_NOENT;
+        }
+        cluster = fat32_next_cluster(fs, cluster);
+        current_index += entries_per_cluster;
+    }
+
+    /* Read the cluster */
+    int result = fat32_read_cluster(fs, cluster, fs->cluster_buffer);
+    if (result != 0) {
+        return result;
+    }
+
+    fat32_dir_entry_t *entries = (fat32_dir_entry_t *)fs->cluster_buffer;
+    uint32_t offset = index - current_index;
+
+    /* Scan from this position */
+    while (offset < entries_per_cluster) {
+        fat32_dir_entry_t *entry = &entries[offset];
+
+        /* End of directory */
+        if (entry->name[0] == FAT32_DIRENT_END) {
+            return VFS_ERR_NOENT;
+        }
+
+        /* Skip free entries */
+        if ((uint8_t)entry->name[0] == FAT32_DIRENT_FREE) {
+            offset++;
+            continue;
+        }
+
+        /* Skip LFN entries and volume labels */
+        if ((entry->attr & FAT32_ATTR_LONG_NAME_MASK) == FAT32_ATTR_LONG_NAME ||
+            (entry->attr & FAT32_ATTR_VOLUME_ID)) {
+            offset++;
+            continue;
+        }
+
+        /* Found a valid entry */
+        fat32_memcpy(out, entry, sizeof(fat32_dir_entry_t));
+        if (out_name) {
+            fat32_format_short_name(entry, out_name);
+        }
+        return 0;
+    }
+
+    /* Need to read next cluster */
+    cluster = fat32_next_cluster(fs, cluster);
+    if (!fat32_cluster_is_valid(fs, cluster)) {
+        return VFS_ERR_NOENT;
+    }
+
+    return fat32_read_dir_entry(fs, cluster, 0, out, out_name);
+}
+
+fat32_dir_entry_t* fat32_list_dir(fat32_fs_t *fs, const char *path) {
+    /* Find the directory */
+    fat32_dir_entry_t dir_entry;
+    uint32_t dir_cluster;
+
+    int result = fat32_lookup(fs, path, &dir_entry, &dir_cluster);
+    if (result != 0) {
+        kprintf("[FAT32] Directory not found: %s\n", path);
+        return NULL;
+    }
+
+    if (!(dir_entry.attr & FAT32_ATTR_DIRECTORY)) {
+        kprintf("[FAT32] Not a directory: %s\n", path);
+        return NULL;
+    }
+
+    /* Count entries first */
+    uint32_t count = 0;
+    uint32_t cluster = dir_cluster;
+
+    while (fat32_cluster_is_valid(fs, cluster)) {
+        if (fat32_read_cluster(fs, cluster, fs->cluster_buffer) != 0) {
+            return NULL;
+        }
+
+        uint32_t entries_per_cluster = fs->bytes_per_cluster / sizeof(fat32_dir_entry_t);
+        fat32_dir_entry_t *entries = (fat32_dir_entry_t *)fs->cluster_buffer;
+
+        for (uint32_t i = 0; i < entries_per_cluster; i++) {
+            if (entries[i].name[0] == FAT32_DIRENT_END) {
+                goto count_done;
+            }
+            if ((uint8_t)entries[i].name[0] != FAT32_DIRENT_FREE &&
+                (entries[i].attr & FAT32_ATTR_LONG_NAME_MASK) != FAT32_ATTR_LONG_NAME &&
+                !(entries[i].attr & FAT32_ATTR_VOLUME_ID)) {
+                count++;
+            }
+        }
+
+        cluster = fat32_next_cluster(fs, cluster);
+    }
+
+count_done:
     /* Allocate array for entries (+1 for terminator) */
     size_t array_size = (count + 1) * sizeof(fat32_dir_entry_t);
     size_t pages_needed = (array_size + PAGE_SIZE - 1) / PAGE_SIZE;
@@ -994,453 +2337,1349 @@ count_done:
     fat32_dir_entry_t *array = (fat32_dir_entry_t *)(array_phys + VMM_KERNEL_PHYS_MAP);
     fat32_memset(array, 0, array_size);
 
-    /* Copy entries */
-    uint32_t idx = 0;
-    cluster = dir_cluster;
+    /* Copy entries */
+    uint32_t idx = 0;
+    cluster = dir_cluster;
+
+    while (fat32_cluster_is_valid(fs, cluster) && idx < count) {
+        if (fat32_read_cluster(fs, cluster, fs->cluster_buffer) != 0) {
+            pmm_free_pages(array_phys, pages_needed);
+            return NULL;
+        }
+
+        uint32_t entries_per_cluster = fs->bytes_per_cluster / sizeof(fat32_dir_entry_t);
+        fat32_dir_entry_t *entries = (fat32_dir_entry_t *)fs->cluster_buffer;
+
+        for (uint32_t i = 0; i < entries_per_cluster && idx < count; i++) {
+            if (entries[i].name[0] == FAT32_DIRENT_END) {
+                goto copy_done;
+            }
+            if ((uint8_t)entries[i].name[0] != FAT32_DIRENT_FREE &&
+                (entries[i].attr & FAT32_ATTR_LONG_NAME_MASK) != FAT32_ATTR_LONG_NAME &&
+                !(entries[i].attr & FAT32_ATTR_VOLUME_ID)) {
+                fat32_memcpy(&array[idx++], &entries[i], sizeof(fat32_dir_entry_t));
+            }
+        }
+
+        cluster = fat32_next_cluster(fs, cluster);
+    }
+
+copy_done:
+    /* Mark end with zero name */
+    array[idx].name[0] = FAT32_DIRENT_END;
+
+    return array;
+}
+
+int fat32_create_entry(fat32_fs_t *fs, uint32_t parent_cluster, const char *name,
+                       uint8_t attr, fat32_dir_entry_t *out_entry) {
+    if (fs->readonly) {
+        return VFS_ERR_ROFS;
+    }
+
+    /* Convert name to 8.3 format */
+    char short_name[11];
+    fat32_to_short_name(name, short_name);
+
+    /* Find a free entry in the directory */
+    uint32_t entries_per_cluster = fs->bytes_per_cluster / sizeof(fat32_dir_entry_t);
+    fat32_dir_index_t *idx = fat32_dir_index_get(fs, parent_cluster);
+    uint32_t cluster = parent_cluster;
+    uint32_t prev_cluster = 0;
+    uint32_t slot = 0;
+    uint32_t i = 0;
+    bool found = false;
+
+    if (idx) {
+        slot = fat32_dir_index_free_slot(fs, idx);
+        if (slot != UINT32_MAX) {
+            cluster = idx->clusters[slot / entries_per_cluster];
+            i = slot % entries_per_cluster;
+            found = true;
+        } else {
+            prev_cluster = idx->clusters[idx->cluster_count - 1];
+        }
+    } else {
+        while (!found && fat32_cluster_is_valid(fs, cluster)) {
+            int result = fat32_read_cluster(fs, cluster, fs->cluster_buffer);
+            if (result != 0) {
+                return result;
+            }
+
+            fat32_dir_entry_t *entries = (fat32_dir_entry_t *)fs->cluster_buffer;
+            for (i = 0; i < entries_per_cluster; i++) {
+                if (entries[i].name[0] == FAT32_DIRENT_END ||
+                    (uint8_t)entries[i].name[0] == FAT32_DIRENT_FREE) {
+                    found = true;
+                    break;
+                }
+            }
+
+            if (!found) {
+                prev_cluster = cluster;
+                cluster = fat32_next_cluster(fs, cluster);
+            }
+        }
+    }
+
+    if (found) {
+        int result = fat32_read_cluster(fs, cluster, fs->cluster_buffer);
+        if (result != 0) {
+            return result;
+        }
+        fat32_dir_entry_t *entries = (fat32_dir_entry_t *)fs->cluster_buffer;
+
+        /* Found a free slot - create entry */
+        fat32_memset(&entries[i], 0, sizeof(fat32_dir_entry_t));
+        fat32_memcpy(entries[i].name, short_name, 8);
+        fat32_memcpy(entries[i].ext, short_name + 8, 3);
+        entries[i].attr = attr;
+
+        /* Allocate first cluster if this is a directory */
+        if (attr & FAT32_ATTR_DIRECTORY) {
+            uint32_t new_cluster = fat32_alloc_cluster(fs);
+            if (!new_cluster) {
+                return VFS_ERR_NOSPC;
+            }
+            fat32_entry_set_cluster(&entries[i], new_cluster);
+
+            /* We need another buffer, so just write the current cluster first */
+            result = fat32_write_cluster(fs, cluster, fs->cluster_buffer);
+            if (result != 0) {
+                return result;
+            }
+
+            /* Create . and .. entries */
+            uint8_t *dir_buf = fs->cluster_buffer;
+            fat32_memset(dir_buf, 0, fs->bytes_per_cluster);
+
+            fat32_dir_entry_t *dot = (fat32_dir_entry_t *)dir_buf;
+            fat32_memset(dot->name, ' ', 11);
+            dot->name[0] = '.';
+            dot->attr = FAT32_ATTR_DIRECTORY;
+            fat32_entry_set_cluster(dot, new_cluster);
+
+            fat32_dir_entry_t *dotdot = (fat32_dir_entry_t *)(dir_buf + 32);
+            fat32_memset(dotdot->name, ' ', 11);
+            dotdot->name[0] = '.';
+            dotdot->name[1] = '.';
+            dotdot->attr = FAT32_ATTR_DIRECTORY;
+            fat32_entry_set_cluster(dotdot, parent_cluster);
+
+            result = fat32_write_cluster(fs, new_cluster, dir_buf);
+            if (result != 0) {
+                return result;
+            }
+
+            /* Re-read parent cluster for output */
+            fat32_read_cluster(fs, cluster, fs->cluster_buffer);
+        } else {
+            /* Write back modified cluster */
+            result = fat32_write_cluster(fs, cluster, fs->cluster_buffer);
+            if (result != 0) {
+                return result;
+            }
+        }
+
+        if (idx && !fat32_dir_index_add(idx, slot, &entries[i], NULL, 0)) {
+            fat32_dir_index_release(idx);
+        }
+
+        if (out_entry) {
+            fat32_memcpy(out_entry, &entries[i], sizeof(fat32_dir_entry_t));
+        }
+        return 0;
+    }
+
+    /* Need to allocate a new cluster for the directory */
+    uint32_t new_cluster = fat32_alloc_cluster(fs);
+    if (!new_cluster) {
+        return VFS_ERR_NOSPC;
+    }
+
+    /* Link new cluster to chain */
+    int result = fat32_set_cluster(fs, prev_cluster, new_cluster);
+    if (result != 0) {
+        return result;
+    }
+
+    /* Initialize new cluster and add entry */
+    fat32_memset(fs->cluster_buffer, 0, fs->bytes_per_cluster);
+    fat32_dir_entry_t *entries = (fat32_dir_entry_t *)fs->cluster_buffer;
+
+    fat32_memcpy(entries[0].name, short_name, 8);
+    fat32_memcpy(entries[0].ext, short_name + 8, 3);
+    entries[0].attr = attr;
+
+    if (attr & FAT32_ATTR_DIRECTORY) {
+        uint32_t dir_cluster = fat32_alloc_cluster(fs);
+        if (!dir_cluster) {
+            return VFS_ERR_NOSPC;
+        }
+        fat32_entry_set_cluster(&entries[0], dir_cluster);
+    }
+
+    result = fat32_write_cluster(fs, new_cluster, fs->cluster_buffer);
+    if (result != 0) {
+        return result;
+    }
+
+    if (idx) {
+        fat32_dir_index_extend(fs, idx, new_cluster);
+        if (idx->dir_cluster &&
+            !fat32_dir_index_add(idx, (idx->cluster_count - 1) * entries_per_cluster,
+                                 &entries[0], NULL, 0)) {
+            fat32_dir_index_release(idx);
+        }
+    }
+
+    if (out_entry) {
+        fat32_memcpy(out_entry, &entries[0], sizeof(fat32_dir_entry_t));
+    }
+
+    return 0;
+}
+
+int fat32_delete_entry(fat32_fs_t *fs, uint32_t parent_cluster, const char *name) {
+    if (fs->readonly) {
+        return VFS_ERR_ROFS;
+    }
+
+    fat32_dir_entry_t entry;
+    uint32_t slot;
+    uint8_t lfn_slots;
+
+    int result = fat32_dir_find(fs, parent_cluster, name, &entry, &slot, &lfn_slots);
+    if (result != 0) {
+        return result;
+    }
+
+    /* An open file keeps its clusters until its last close */
+    bool open = false;
+    if (!(entry.attr & FAT32_ATTR_DIRECTORY)) {
+        for (fat32_file_t *file = fs->open_files; file; file = file->next_open) {
+            if (file->parent_cluster == parent_cluster && file->entry_index == slot) {
+                file->unlinked = true;
+                open = true;
+            }
+        }
+    }
+
+    /* Free the cluster chain */
+    uint32_t file_cluster = fat32_entry_cluster(&entry);
+    if (file_cluster >= FAT32_FIRST_DATA_CLUSTER && !open) {
+        if (entry.attr & FAT32_ATTR_DIRECTORY) {
+            fat32_dir_index_drop(fs, file_cluster);
+        }
+        fat32_free_chain(fs, file_cluster);
+    }
+
+    /* Mark the entry and its long name entries as deleted */
+    result = fat32_dir_free_slots(fs, parent_cluster, slot - lfn_slots, slot);
+
+    for (int i = 0; i < FAT32_DIR_INDEX_MAX; i++) {
+        fat32_dir_index_t *idx = &fs->dir_index[i];
+        if (idx->dir_cluster == parent_cluster) {
+            if (result == 0) {
+                fat32_dir_index_remove(idx, slot, &entry, lfn_slots);
+            } else {
+                fat32_dir_index_release(idx);
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================
+ * Cluster Extent Map
+ *============================================================================*/
+
+/**
+ * Record that file cluster `index` lives at `cluster` and move the cursor
+ * there. The extent table only grows at its end, so entries describe a
+ * prefix of the chain; once it is full the cursor keeps walking alone.
+ */
+static void fat32_extent_record(fat32_extent_map_t *map, uint32_t index, uint32_t cluster) {
+    if (index == map->mapped) {
+        fat32_extent_t *last = map->count ? &map->extents[map->count - 1] : NULL;
+
+        if (last && last->physical + last->length == cluster) {
+            last->length++;
+            map->mapped++;
+        } else if (map->count < FAT32_EXTENT_MAX) {
+            map->extents[map->count].logical = index;
+            map->extents[map->count].physical = cluster;
+            map->extents[map->count].length = 1;
+            map->count++;
+            map->mapped++;
+        }
+    }
+
+    map->cursor_index = index;
+    map->cursor_cluster = cluster;
+}
+
+/**
+ * Reset an extent map to describe the chain starting at first_cluster
+ */
+static void fat32_extent_reset(fat32_fs_t *fs, fat32_extent_map_t *map, uint32_t first_cluster) {
+    map->count = 0;
+    map->mapped = 0;
+    map->first_cluster = first_cluster;
+    map->cursor_index = 0;
+    map->cursor_cluster = 0;
+    map->at_end = true;
+
+    if (fat32_cluster_is_valid(fs, first_cluster)) {
+        fat32_extent_record(map, 0, first_cluster);
+        map->at_end = false;
+    }
+}
+
+/**
+ * Move the cursor back to the last cluster covered by the extent table
+ */
+static void fat32_extent_rewind(fat32_extent_map_t *map) {
+    fat32_extent_t *last = &map->extents[map->count - 1];
+
+    map->cursor_index = map->mapped - 1;
+    map->cursor_cluster = last->physical + last->length - 1;
+    map->at_end = false;
+}
+
+/**
+ * Map a file cluster index to a disk cluster
+ * Indices inside the extent table are found by binary search; beyond it
+ * the chain is walked from the cursor and the table extended on the way.
+ * @param fs Filesystem state
+ * @param map Extent map
+ * @param first_cluster First cluster of the file (resets a stale map)
+ * @param index File cluster index
+ * @param run_left Output: clusters left in the physical run, including index
+ * @return Disk cluster, or FAT32_CLUSTER_EOF if the chain is shorter
+ */
+static uint32_t fat32_extent_lookup(fat32_fs_t *fs, fat32_extent_map_t *map,
+                                    uint32_t first_cluster, uint32_t index,
+                                    uint32_t *run_left) {
+    if (map->first_cluster != first_cluster) {
+        fat32_extent_reset(fs, map, first_cluster);
+    }
+
+    if (map->mapped == 0) {
+        return FAT32_CLUSTER_EOF;
+    }
+
+    if (index >= map->mapped) {
+        if (index < map->cursor_index) {
+            fat32_extent_rewind(map);
+        }
+
+        while (!map->at_end && map->cursor_index < index) {
+            uint32_t next = fat32_next_cluster(fs, map->cursor_cluster);
+            if (!fat32_cluster_is_valid(fs, next)) {
+                map->at_end = true;
+                break;
+            }
+            fat32_extent_record(map, map->cursor_index + 1, next);
+        }
+
+        if (map->cursor_index != index) {
+            return FAT32_CLUSTER_EOF;
+        }
+        if (index >= map->mapped) {
+            *run_left = 1;
+            return map->cursor_cluster;
+        }
+    }
+
+    /* Binary search the extent table */
+    uint32_t lo = 0;
+    uint32_t hi = map->count - 1;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi + 1) / 2;
+        if (map->extents[mid].logical <= index) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    fat32_extent_t *ext = &map->extents[lo];
+    *run_left = ext->logical + ext->length - index;
+    return ext->physical + (index - ext->logical);
+}
+
+/**
+ * Note that `cluster` was linked into the chain as file cluster `index`
+ */
+static void fat32_extent_append(fat32_extent_map_t *map, uint32_t index, uint32_t cluster) {
+    if (map->mapped > 0 && map->cursor_index + 1 == index) {
+        fat32_extent_record(map, index, cluster);
+    }
+    map->at_end = false;
+}
+
+/**
+ * Drop mappings for file clusters at or beyond `clusters`
+ */
+static void fat32_extent_truncate(fat32_extent_map_t *map, uint32_t clusters) {
+    while (map->count > 0 && map->extents[map->count - 1].logical >= clusters) {
+        map->count--;
+    }
+
+    if (map->count == 0) {
+        map->mapped = 0;
+        map->first_cluster = 0;
+        map->at_end = true;
+        return;
+    }
+
+    fat32_extent_t *last = &map->extents[map->count - 1];
+    if (last->logical + last->length > clusters) {
+        last->length = clusters - last->logical;
+    }
+    map->mapped = last->logical + last->length;
+    fat32_extent_rewind(map);
+}
+
+/*============================================================================
+ * File Read/Write Operations
+ *============================================================================*/
+
+/**
+ * Cursor over an I/O vector
+ * Lets a single pass over a file's clusters scatter into, or gather from,
+ * several caller buffers.
+ */
+typedef struct {
+    const vfs_iovec_t   *iov;
+    int                 count;          /* Segments in iov */
+    int                 index;          /* Current segment */
+    size_t              pos;            /* Offset within the current segment */
+} fat32_iov_iter_t;
+
+static void fat32_iov_iter_init(fat32_iov_iter_t *it, const vfs_iovec_t *iov, int count) {
+    it->iov = iov;
+    it->count = count;
+    it->index = 0;
+    it->pos = 0;
+}
+
+static size_t fat32_iov_length(const vfs_iovec_t *iov, int count) {
+    size_t total = 0;
+    for (int i = 0; i < count; i++) {
+        total += iov[i].iov_len;
+    }
+    return total;
+}
+
+/**
+ * Copy bytes into the segments at the cursor and advance it
+ */
+static void fat32_iov_copy_to(fat32_iov_iter_t *it, const uint8_t *src, size_t n) {
+    while (n > 0 && it->index < it->count) {
+        const vfs_iovec_t *seg = &it->iov[it->index];
+        size_t chunk = MIN(n, seg->iov_len - it->pos);
+
+        fat32_memcpy((uint8_t *)seg->iov_base + it->pos, src, chunk);
+        src += chunk;
+        n -= chunk;
+        it->pos += chunk;
+
+        if (it->pos == seg->iov_len) {
+            it->index++;
+            it->pos = 0;
+        }
+    }
+}
+
+/**
+ * Copy bytes out of the segments at the cursor and advance it
+ */
+static void fat32_iov_copy_from(fat32_iov_iter_t *it, uint8_t *dst, size_t n) {
+    while (n > 0 && it->index < it->count) {
+        const vfs_iovec_t *seg = &it->iov[it->index];
+        size_t chunk = MIN(n, seg->iov_len - it->pos);
+
+        fat32_memcpy(dst, (const uint8_t *)seg->iov_base + it->pos, chunk);
+        dst += chunk;
+        n -= chunk;
+        it->pos += chunk;
+
+        if (it->pos == seg->iov_len) {
+            it->index++;
+            it->pos = 0;
+        }
+    }
+}
+
+/**
+ * Ask the block layer to load file clusters [from, to) ahead of use
+ * Physically contiguous clusters are coalesced into one request each.
+ */
+static void fat32_prefetch_range(fat32_fs_t *fs, fat32_extent_map_t *map,
+                                 uint32_t first_cluster, uint32_t from, uint32_t to) {
+    uint32_t spc = fs->bpb.sectors_per_cluster;
+
+    while (from < to) {
+        uint32_t run;
+        uint32_t start = fat32_extent_lookup(fs, map, first_cluster, from, &run);
+        if (!fat32_cluster_is_valid(fs, start)) {
+            break;
+        }
+
+        uint32_t count = MIN(run, to - from);
+        while (from + count < to) {
+            uint32_t next = fat32_extent_lookup(fs, map, first_cluster, from + count, &run);
+            if (next != start + count) {
+                break;
+            }
+            count += MIN(run, to - from - count);
+        }
+
+        fs->block_ops->prefetch(fs->device, fat32_cluster_to_sector(fs, start),
+                                count * spc);
+        from += count;
+    }
+}
+
+/**
+ * Decide which file clusters to prefetch for a read
+ * @param fs Filesystem state
+ * @param ra Read-ahead state (NULL for a one-off read)
+ * @param offset Byte offset of the read
+ * @param first First file cluster index of the read
+ * @param end File cluster index just past the read
+ * @param limit Number of clusters in the file
+ * @param from Output: first cluster index to prefetch
+ * @param to Output: cluster index just past the prefetch range
+ */
+static void fat32_readahead_range(fat32_fs_t *fs, fat32_readahead_t *ra, size_t offset,
+                                  uint32_t first, uint32_t end, uint32_t limit,
+                                  uint32_t *from, uint32_t *to) {
+    *from = first;
+    *to = end;
+
+    if (!ra) {
+        return;
+    }
+
+    if (offset != ra->next_offset) {
+        /* Random access: load only what was asked for */
+        ra->window = 0;
+        ra->ra_end = end;
+        return;
+    }
+
+    uint32_t min_window = MAX(FAT32_RA_MIN_BYTES / fs->bytes_per_cluster, 1);
+    uint32_t max_window = MAX(FAT32_RA_MAX_BYTES / fs->bytes_per_cluster, 1);
+
+    *from = MAX(first, ra->ra_end);
+
+    /* Refill once less than half a window remains ahead of the reader */
+    if (ra->ra_end < end + ra->window / 2) {
+        ra->window = ra->window ? MIN(ra->window * 2, max_window) : min_window;
+        *to = end + ra->window;
+    }
+
+    if (*to > limit) {
+        *to = limit;
+    }
+    if (*to < *from) {
+        *to = *from;
+    }
+    ra->ra_end = MAX(ra->ra_end, *to);
+}
+
+/**
+ * Read file data through an extent map into an I/O vector, optionally
+ * driving read-ahead. Each cluster is read once and scattered across the
+ * segments it covers.
+ */
+static ssize_t fat32_read_file_iov(fat32_fs_t *fs, fat32_dir_entry_t *entry,
+                                   fat32_extent_map_t *map, fat32_readahead_t *ra,
+                                   fat32_iov_iter_t *dst, size_t offset, size_t len) {
+    if (!fs || !entry || !dst) {
+        return VFS_ERR_INVAL;
+    }
+
+    /* Check if it's a directory */
+    if (entry->attr & FAT32_ATTR_DIRECTORY) {
+        return VFS_ERR_ISDIR;
+    }
+
+    /* Bounds check */
+    if (offset >= entry->file_size) {
+        return 0;  /* EOF */
+    }
+
+    if (offset + len > entry->file_size) {
+        len = entry->file_size - offset;
+    }
+
+    if (len == 0) {
+        return 0;
+    }
+
+    uint32_t first_cluster = fat32_entry_cluster(entry);
+    uint32_t cluster_size = fs->bytes_per_cluster;
+    size_t bytes_read = 0;
+
+    uint32_t index = offset / cluster_size;
+    uint32_t offset_in_cluster = offset % cluster_size;
+
+    /* Load the request (and any read-ahead) in large contiguous runs */
+    if (fs->block_ops->prefetch) {
+        uint32_t end = (offset + len - 1) / cluster_size + 1;
+        uint32_t limit = (entry->file_size + cluster_size - 1) / cluster_size;
+        uint32_t from, to;
+
+        fat32_readahead_range(fs, ra, offset, index, end, limit, &from, &to);
+        fat32_prefetch_range(fs, map, first_cluster, from, to);
+    }
+
+    /* Read data */
+    uint32_t run_left = 0;
+    uint32_t cluster = 0;
+
+    while (len > 0) {
+        if (run_left == 0) {
+            cluster = fat32_extent_lookup(fs, map, first_cluster, index, &run_left);
+            if (!fat32_cluster_is_valid(fs, cluster)) {
+                break;
+            }
+        }
+
+        int result = fat32_read_cluster(fs, cluster, fs->cluster_buffer);
+        if (result != 0) {
+            return result;
+        }
+
+        size_t to_copy = cluster_size - offset_in_cluster;
+        if (to_copy > len) {
+            to_copy = len;
+        }
+
+        fat32_iov_copy_to(dst, fs->cluster_buffer + offset_in_cluster, to_copy);
+
+        bytes_read += to_copy;
+        len -= to_copy;
+        offset_in_cluster = 0;
+
+        index++;
+        cluster++;
+        run_left--;
+    }
+
+    if (ra) {
+        ra->next_offset = offset + bytes_read;
+    }
+
+    return bytes_read;
+}
+
+/**
+ * Read file data through an extent map into a single buffer
+ */
+static ssize_t fat32_read_file_map(fat32_fs_t *fs, fat32_dir_entry_t *entry,
+                                   fat32_extent_map_t *map, fat32_readahead_t *ra,
+                                   void *buf, size_t offset, size_t len) {
+    vfs_iovec_t iov = { .iov_base = buf, .iov_len = len };
+    fat32_iov_iter_t it;
+
+    if (!buf) {
+        return VFS_ERR_INVAL;
+    }
+
+    fat32_iov_iter_init(&it, &iov, 1);
+    return fat32_read_file_iov(fs, entry, map, ra, &it, offset, len);
+}
+
+ssize_t fat32_read_file(fat32_fs_t *fs, fat32_dir_entry_t *entry, void *buf,
+                        size_t offset, size_t len) {
+    fat32_extent_map_t map;
+    map.first_cluster = FAT32_CLUSTER_EOF;  /* Force a reset on first lookup */
+
+    return fat32_read_file_map(fs, entry, &map, NULL, buf, offset, len);
+}
+
+ssize_t fat32_file_read(fat32_file_t *file, void *buf, size_t offset, size_t len) {
+    if (!file) {
+        return VFS_ERR_INVAL;
+    }
+
+    /* Data still waiting for allocation has to reach the disk first */
+    fat32_delalloc_t *da = &file->delalloc;
+    if (da->length > 0 && offset + len > da->start) {
+        int result = fat32_delalloc_flush(file);
+        if (result != 0) {
+            return result;
+        }
+    }
+
+    return fat32_read_file_map(file->fs, &file->entry, &file->extents, &file->ra,
+                               buf, offset, len);
+}
+
+ssize_t fat32_file_readv(fat32_file_t *file, const vfs_iovec_t *iov, int count,
+                         size_t offset) {
+    if (!file || !iov || count <= 0) {
+        return VFS_ERR_INVAL;
+    }
+
+    size_t len = fat32_iov_length(iov, count);
+
+    fat32_delalloc_t *da = &file->delalloc;
+    if (da->length > 0 && offset + len > da->start) {
+        int result = fat32_delalloc_flush(file);
+        if (result != 0) {
+            return result;
+        }
+    }
+
+    fat32_iov_iter_t it;
+    fat32_iov_iter_init(&it, iov, count);
+    return fat32_read_file_iov(file->fs, &file->entry, &file->extents, &file->ra,
+                               &it, offset, len);
+}
+
+/**
+ * Write file data from an I/O vector through an extent map
+ * Each cluster is written once, gathered from the segments it covers.
+ */
+static ssize_t fat32_write_file_iov(fat32_fs_t *fs, fat32_dir_entry_t *entry,
+                                    fat32_extent_map_t *map, fat32_iov_iter_t *src,
+                                    size_t offset, size_t len) {
+    if (!fs || !entry || !src) {
+        return VFS_ERR_INVAL;
+    }
+
+    if (fs->readonly) {
+        return VFS_ERR_ROFS;
+    }
+
+    if (entry->attr & FAT32_ATTR_DIRECTORY) {
+        return VFS_ERR_ISDIR;
+    }
+
+    if (len == 0) {
+        return 0;
+    }
+
+    uint32_t first_cluster = fat32_entry_cluster(entry);
+    uint32_t cluster_size = fs->bytes_per_cluster;
+    size_t bytes_written = 0;
+
+    /* Clusters at or past this file index were allocated by this call */
+    uint32_t fresh_from = UINT32_MAX;
 
-    while (fat32_cluster_is_valid(fs, cluster) && idx < count) {
-        if (fat32_read_cluster(fs, cluster, fs->cluster_buffer) != 0) {
-            pmm_free_pages(array_phys, pages_needed);
-            return NULL;
+    /* Handle file with no clusters yet: allocate the whole write in one run */
+    if (first_cluster < FAT32_FIRST_DATA_CLUSTER) {
+        uint32_t want = (offset + len + cluster_size - 1) / cluster_size;
+        first_cluster = fat32_alloc_run(fs, fs->next_free_cluster, want, NULL);
+        if (!first_cluster) {
+            return VFS_ERR_NOSPC;
         }
+        fat32_entry_set_cluster(entry, first_cluster);
+        fresh_from = 0;
+    }
 
-        uint32_t entries_per_cluster = fs->bytes_per_cluster / sizeof(fat32_dir_entry_t);
-        fat32_dir_entry_t *entries = (fat32_dir_entry_t *)fs->cluster_buffer;
+    uint32_t index = offset / cluster_size;
+    uint32_t offset_in_cluster = offset % cluster_size;
+    uint32_t run_left = 0;
 
-        for (uint32_t i = 0; i < entries_per_cluster && idx < count; i++) {
-            if (entries[i].name[0] == FAT32_DIRENT_END) {
-                goto copy_done;
+    uint32_t cluster = fat32_extent_lookup(fs, map, first_cluster, index, &run_left);
+    if (!fat32_cluster_is_valid(fs, cluster)) {
+        /* Extend the file up to index; the cursor is at the tail */
+        while (map->cursor_index < index) {
+            uint32_t tail = map->cursor_cluster;
+            uint32_t want = index - map->cursor_index - 1 +
+                            (offset_in_cluster + len + cluster_size - 1) / cluster_size;
+            uint32_t got;
+            uint32_t new_cluster = fat32_alloc_run(fs, tail + 1, want, &got);
+            if (!new_cluster) {
+                return VFS_ERR_NOSPC;
             }
-            if ((uint8_t)entries[i].name[0] != FAT32_DIRENT_FREE &&
-                (entries[i].attr & FAT32_ATTR_LONG_NAME_MASK) != FAT32_ATTR_LONG_NAME &&
-                !(entries[i].attr & FAT32_ATTR_VOLUME_ID)) {
-                fat32_memcpy(&array[idx++], &entries[i], sizeof(fat32_dir_entry_t));
+            fat32_set_cluster(fs, tail, new_cluster);
+
+            fresh_from = MIN(fresh_from, map->cursor_index + 1);
+            for (uint32_t i = 0; i < got; i++) {
+                fat32_extent_append(map, map->cursor_index + 1, new_cluster + i);
             }
         }
 
-        cluster = fat32_next_cluster(fs, cluster);
+        /* The run may reach past index; continue from the mapped position */
+        cluster = fat32_extent_lookup(fs, map, first_cluster, index, &run_left);
     }
 
-copy_done:
-    /* Mark end with zero name */
-    array[idx].name[0] = FAT32_DIRENT_END;
-
-    return array;
-}
-
-int fat32_create_entry(fat32_fs_t *fs, uint32_t parent_cluster, const char *name,
-                       uint8_t attr, fat32_dir_entry_t *out_entry) {
-    if (fs->readonly) {
-        return VFS_ERR_ROFS;
+    /* New clusters in the hole before the write must read back as zeros */
+    if (fresh_from < index) {
+        fat32_memset(fs->cluster_buffer, 0, cluster_size);
+        for (uint32_t i = fresh_from; i < index; i++) {
+            uint32_t unused;
+            uint32_t hole = fat32_extent_lookup(fs, map, first_cluster, i, &unused);
+            fat32_write_cluster(fs, hole, fs->cluster_buffer);
+        }
     }
 
-    /* Convert name to 8.3 format */
-    char short_name[11];
-    fat32_to_short_name(name, short_name);
+    /* Write data */
+    while (len > 0) {
+        size_t to_copy = cluster_size - offset_in_cluster;
+        if (to_copy > len) {
+            to_copy = len;
+        }
 
-    /* Find a free entry in the directory */
-    uint32_t cluster = parent_cluster;
-    uint32_t prev_cluster = 0;
+        /* Partial writes merge with the current contents (zeros if new) */
+        int result = 0;
+        if (to_copy < cluster_size) {
+            if (index >= fresh_from) {
+                fat32_memset(fs->cluster_buffer, 0, cluster_size);
+            } else if (fat32_read_cluster(fs, cluster, fs->cluster_buffer) != 0) {
+                fat32_memset(fs->cluster_buffer, 0, cluster_size);
+            }
+        }
 
-    while (fat32_cluster_is_valid(fs, cluster)) {
-        int result = fat32_read_cluster(fs, cluster, fs->cluster_buffer);
+        fat32_iov_copy_from(src, fs->cluster_buffer + offset_in_cluster, to_copy);
+
+        result = fat32_write_cluster(fs, cluster, fs->cluster_buffer);
         if (result != 0) {
             return result;
         }
 
-        uint32_t entries_per_cluster = fs->bytes_per_cluster / sizeof(fat32_dir_entry_t);
-        fat32_dir_entry_t *entries = (fat32_dir_entry_t *)fs->cluster_buffer;
+        bytes_written += to_copy;
+        len -= to_copy;
+        offset_in_cluster = 0;
 
-        for (uint32_t i = 0; i < entries_per_cluster; i++) {
-            if (entries[i].name[0] == FAT32_DIRENT_END ||
-                (uint8_t)entries[i].name[0] == FAT32_DIRENT_FREE) {
-
-                /* Found a free slot - create entry */
-                fat32_memset(&entries[i], 0, sizeof(fat32_dir_entry_t));
-                fat32_memcpy(entries[i].name, short_name, 8);
-                fat32_memcpy(entries[i].ext, short_name + 8, 3);
-                entries[i].attr = attr;
-
-                /* Allocate first cluster if this is a directory */
-                if (attr & FAT32_ATTR_DIRECTORY) {
-                    uint32_t new_cluster = fat32_alloc_cluster(fs);
-                    if (!new_cluster) {
-                        return VFS_ERR_NOSPC;
-                    }
-                    fat32_entry_set_cluster(&entries[i], new_cluster);
-
-                    /* Initialize directory with . and .. entries */
-                    fat32_memset(fs->cluster_buffer + fs->bytes_per_cluster, 0,
-                                 fs->bytes_per_cluster);
-                    /* We need another buffer, so just write the current cluster first */
-                    result = fat32_write_cluster(fs, cluster, fs->cluster_buffer);
-                    if (result != 0) {
-                        return result;
-                    }
-
-                    /* Create . and .. entries */
-                    uint8_t *dir_buf = fs->cluster_buffer;
-                    fat32_memset(dir_buf, 0, fs->bytes_per_cluster);
-
-                    fat32_dir_entry_t *dot = (fat32_dir_entry_t *)dir_buf;
-                    fat32_memset(dot->name, ' ', 11);
-                    dot->name[0] = '.';
-                    dot->attr = FAT32_ATTR_DIRECTORY;
-                    fat32_entry_set_cluster(dot, new_cluster);
-
-                    fat32_dir_entry_t *dotdot = (fat32_dir_entry_t *)(dir_buf + 32);
-                    fat32_memset(dotdot->name, ' ', 11);
-                    dotdot->name[0] = '.';
-                    dotdot->name[1] = '.';
-                    dotdot->attr = FAT32_ATTR_DIRECTORY;
-                    fat32_entry_set_cluster(dotdot, parent_cluster);
-
-                    result = fat32_write_cluster(fs, new_cluster, dir_buf);
-                    if (result != 0) {
-                        return result;
-                    }
-
-                    /* Re-read parent cluster for output */
-                    fat32_read_cluster(fs, cluster, fs->cluster_buffer);
-                } else {
-                    /* Write back modified cluster */
-                    result = fat32_write_cluster(fs, cluster, fs->cluster_buffer);
-                    if (result != 0) {
-                        return result;
-                    }
-                }
+        if (len > 0) {
+            index++;
+
+            if (run_left > 1) {
+                cluster++;
+                run_left--;
+                continue;
+            }
 
-                if (out_entry) {
-                    fat32_memcpy(out_entry, &entries[i], sizeof(fat32_dir_entry_t));
+            uint32_t next = fat32_extent_lookup(fs, map, first_cluster, index, &run_left);
+            if (!fat32_cluster_is_valid(fs, next)) {
+                /* Need more clusters: allocate the rest of the write at once */
+                uint32_t want = (len + cluster_size - 1) / cluster_size;
+                uint32_t got;
+                uint32_t new_cluster = fat32_alloc_run(fs, cluster + 1, want, &got);
+                if (!new_cluster) {
+                    break;  /* Return partial write */
                 }
-                return 0;
+                fat32_set_cluster(fs, cluster, new_cluster);
+                fresh_from = MIN(fresh_from, index);
+                for (uint32_t i = 0; i < got; i++) {
+                    fat32_extent_append(map, index + i, new_cluster + i);
+                }
+                next = new_cluster;
+                run_left = got;
             }
-        }
 
-        prev_cluster = cluster;
-        cluster = fat32_next_cluster(fs, cluster);
+            cluster = next;
+        }
     }
 
-    /* Need to allocate a new cluster for the directory */
-    uint32_t new_cluster = fat32_alloc_cluster(fs);
-    if (!new_cluster) {
-        return VFS_ERR_NOSPC;
+    /* Update file size if necessary */
+    size_t new_end = offset + bytes_written;
+    if (new_end > entry->file_size) {
+        entry->file_size = (uint32_t)new_end;
     }
 
-    /* Link new cluster to chain */
-    int result = fat32_set_cluster(fs, prev_cluster, new_cluster);
-    if (result != 0) {
-        return result;
-    }
+    /* Note: Caller is responsible for updating the directory entry on disk */
 
-    /* Initialize new cluster and add entry */
-    fat32_memset(fs->cluster_buffer, 0, fs->bytes_per_cluster);
-    fat32_dir_entry_t *entries = (fat32_dir_entry_t *)fs->cluster_buffer;
+    return bytes_written;
+}
 
-    fat32_memcpy(entries[0].name, short_name, 8);
-    fat32_memcpy(entries[0].ext, short_name + 8, 3);
-    entries[0].attr = attr;
+/**
+ * Write file data from a single buffer through an extent map
+ */
+static ssize_t fat32_write_file_map(fat32_fs_t *fs, fat32_dir_entry_t *entry,
+                                    fat32_extent_map_t *map, const void *buf,
+                                    size_t offset, size_t len) {
+    vfs_iovec_t iov = { .iov_base = (void *)buf, .iov_len = len };
+    fat32_iov_iter_t it;
 
-    if (attr & FAT32_ATTR_DIRECTORY) {
-        uint32_t dir_cluster = fat32_alloc_cluster(fs);
-        if (!dir_cluster) {
-            return VFS_ERR_NOSPC;
-        }
-        fat32_entry_set_cluster(&entries[0], dir_cluster);
+    if (!buf) {
+        return VFS_ERR_INVAL;
     }
 
-    result = fat32_write_cluster(fs, new_cluster, fs->cluster_buffer);
-    if (result != 0) {
-        return result;
-    }
+    fat32_iov_iter_init(&it, &iov, 1);
+    return fat32_write_file_iov(fs, entry, map, &it, offset, len);
+}
 
-    if (out_entry) {
-        fat32_memcpy(out_entry, &entries[0], sizeof(fat32_dir_entry_t));
-    }
+ssize_t fat32_write_file(fat32_fs_t *fs, fat32_dir_entry_t *entry,
+                         uint32_t parent_cluster, const void *buf,
+                         size_t offset, size_t len) {
+    UNUSED(parent_cluster);
 
-    return 0;
+    fat32_extent_map_t map;
+    map.first_cluster = FAT32_CLUSTER_EOF;  /* Force a reset on first lookup */
+
+    return fat32_write_file_map(fs, entry, &map, buf, offset, len);
 }
 
-int fat32_delete_entry(fat32_fs_t *fs, uint32_t parent_cluster, const char *name) {
+ssize_t fat32_file_write(fat32_file_t *file, const void *buf, size_t offset, size_t len) {
+    if (!file || !buf) {
+        return VFS_ERR_INVAL;
+    }
+
+    fat32_fs_t *fs = file->fs;
+    fat32_delalloc_t *da = &file->delalloc;
+    uint32_t cluster_size = fs->bytes_per_cluster;
+    const uint8_t *src = (const uint8_t *)buf;
+    size_t done = 0;
+
     if (fs->readonly) {
         return VFS_ERR_ROFS;
     }
+    if (file->is_dir) {
+        return VFS_ERR_ISDIR;
+    }
+    if (len == 0) {
+        return 0;
+    }
 
-    uint32_t cluster = parent_cluster;
-
-    while (fat32_cluster_is_valid(fs, cluster)) {
-        int result = fat32_read_cluster(fs, cluster, fs->cluster_buffer);
+    /* Pending data can only be extended by an append that continues it */
+    if (da->length > 0 &&
+        (offset != da->start + da->length ||
+         pit_get_uptime_ms() - da->since >= FAT32_DELALLOC_AGE_MS)) {
+        int result = fat32_delalloc_flush(file);
         if (result != 0) {
             return result;
         }
+    }
 
-        uint32_t entries_per_cluster = fs->bytes_per_cluster / sizeof(fat32_dir_entry_t);
-        fat32_dir_entry_t *entries = (fat32_dir_entry_t *)fs->cluster_buffer;
-
-        for (uint32_t i = 0; i < entries_per_cluster; i++) {
-            if (entries[i].name[0] == FAT32_DIRENT_END) {
-                return VFS_ERR_NOENT;
+    if (da->length == 0) {
+        /* Only appends are delayed; everything else is written in place */
+        if (offset != file->entry.file_size || cluster_size > FAT32_DELALLOC_BYTES ||
+            FAT32_DELALLOC_BYTES % cluster_size != 0) {
+            ssize_t written = fat32_write_file_map(fs, &file->entry, &file->extents,
+                                                   buf, offset, len);
+            if (written > 0) {
+                file->dirty = true;
             }
+            return written;
+        }
 
-            if ((uint8_t)entries[i].name[0] == FAT32_DIRENT_FREE) {
-                continue;
+        /* Fill the partial tail cluster so pending data is cluster aligned */
+        size_t aligned = ((offset + cluster_size - 1) / cluster_size) * cluster_size;
+        if (aligned > offset) {
+            size_t head = MIN(len, aligned - offset);
+            ssize_t written = fat32_write_file_map(fs, &file->entry, &file->extents,
+                                                   src, offset, head);
+            if (written <= 0) {
+                return written;
             }
-
-            if ((entries[i].attr & FAT32_ATTR_LONG_NAME_MASK) == FAT32_ATTR_LONG_NAME) {
-                continue;
+            file->dirty = true;
+            done = (size_t)written;
+            if (done == len || done < head) {
+                return done;
             }
+        }
 
-            if (fat32_strcmp_83(name, &entries[i]) == 0) {
-                /* Free the cluster chain */
-                uint32_t file_cluster = fat32_entry_cluster(&entries[i]);
-                if (file_cluster >= FAT32_FIRST_DATA_CLUSTER) {
-                    fat32_free_chain(fs, file_cluster);
-                }
+        if (!fat32_delalloc_begin(file, offset + done)) {
+            ssize_t written = fat32_write_file_map(fs, &file->entry, &file->extents,
+                                                   src + done, offset + done, len - done);
+            return (written < 0) ? (done ? (ssize_t)done : written) : (ssize_t)(done + written);
+        }
+    }
 
-                /* Mark entry as deleted */
-                entries[i].name[0] = FAT32_DIRENT_FREE;
+    /* Buffer the data; clusters are allocated when the buffer is flushed */
+    while (done < len) {
+        size_t n = MIN(len - done, FAT32_DELALLOC_BYTES - da->length);
 
-                /* Write back */
-                return fat32_write_cluster(fs, cluster, fs->cluster_buffer);
-            }
+        fat32_memcpy(da->buffer + da->length, src + done, n);
+        da->length += n;
+        done += n;
+
+        if (da->start + da->length > file->entry.file_size) {
+            file->entry.file_size = da->start + da->length;
         }
 
-        cluster = fat32_next_cluster(fs, cluster);
+        if (da->length == FAT32_DELALLOC_BYTES) {
+            int result = fat32_delalloc_flush(file);
+            if (result != 0) {
+                return result;
+            }
+            if (done < len && !fat32_delalloc_begin(file, da->start)) {
+                ssize_t written = fat32_write_file_map(fs, &file->entry, &file->extents,
+                                                       src + done, offset + done, len - done);
+                return (written < 0) ? (ssize_t)done : (ssize_t)(done + written);
+            }
+        }
     }
 
-    return VFS_ERR_NOENT;
+    file->dirty = true;
+    return done;
 }
 
-/*============================================================================
- * File Read/Write Operations
- *============================================================================*/
-
-ssize_t fat32_read_file(fat32_fs_t *fs, fat32_dir_entry_t *entry, void *buf,
-                        size_t offset, size_t len) {
-    if (!fs || !entry || !buf) {
+ssize_t fat32_file_writev(fat32_file_t *file, const vfs_iovec_t *iov, int count,
+                          size_t offset) {
+    if (!file || !iov || count <= 0) {
         return VFS_ERR_INVAL;
     }
 
-    /* Check if it's a directory */
-    if (entry->attr & FAT32_ATTR_DIRECTORY) {
-        return VFS_ERR_ISDIR;
-    }
-
-    /* Bounds check */
-    if (offset >= entry->file_size) {
-        return 0;  /* EOF */
+    fat32_fs_t *fs = file->fs;
+    if (fs->readonly) {
+        return VFS_ERR_ROFS;
     }
-
-    if (offset + len > entry->file_size) {
-        len = entry->file_size - offset;
+    if (file->is_dir) {
+        return VFS_ERR_ISDIR;
     }
 
+    size_t len = fat32_iov_length(iov, count);
     if (len == 0) {
         return 0;
     }
 
-    uint32_t cluster = fat32_entry_cluster(entry);
-    uint32_t cluster_size = fs->bytes_per_cluster;
-    size_t bytes_read = 0;
-    uint8_t *dest = (uint8_t *)buf;
-
-    /* Skip to starting cluster */
-    uint32_t clusters_to_skip = offset / cluster_size;
-    uint32_t offset_in_cluster = offset % cluster_size;
+    /* Appends go through the delayed-allocation buffer segment by segment */
+    if (offset == file->entry.file_size) {
+        size_t done = 0;
+        for (int i = 0; i < count; i++) {
+            if (iov[i].iov_len == 0) {
+                continue;
+            }
 
-    while (clusters_to_skip > 0 && fat32_cluster_is_valid(fs, cluster)) {
-        cluster = fat32_next_cluster(fs, cluster);
-        clusters_to_skip--;
+            ssize_t written = fat32_file_write(file, iov[i].iov_base, offset + done,
+                                               iov[i].iov_len);
+            if (written < 0) {
+                return done ? (ssize_t)done : written;
+            }
+            done += (size_t)written;
+            if ((size_t)written < iov[i].iov_len) {
+                break;
+            }
+        }
+        return done;
     }
 
-    /* Read data */
-    while (len > 0 && fat32_cluster_is_valid(fs, cluster)) {
-        int result = fat32_read_cluster(fs, cluster, fs->cluster_buffer);
+    /* In-place writes: settle pending data, then write all segments in one pass */
+    if (file->delalloc.length > 0) {
+        int result = fat32_delalloc_flush(file);
         if (result != 0) {
             return result;
         }
+    }
 
-        size_t to_copy = cluster_size - offset_in_cluster;
-        if (to_copy > len) {
-            to_copy = len;
+    fat32_iov_iter_t it;
+    fat32_iov_iter_init(&it, iov, count);
+    ssize_t written = fat32_write_file_iov(fs, &file->entry, &file->extents, &it,
+                                           offset, len);
+    if (written > 0) {
+        file->dirty = true;
+    }
+    return written;
+}
+
+/**
+ * Truncate a file through an extent map
+ */
+static int fat32_truncate_file_map(fat32_fs_t *fs, fat32_dir_entry_t *entry,
+                                   fat32_extent_map_t *map, uint32_t new_size) {
+    if (fs->readonly) {
+        return VFS_ERR_ROFS;
+    }
+
+    uint32_t old_size = entry->file_size;
+    uint32_t cluster_size = fs->bytes_per_cluster;
+
+    if (new_size == old_size) {
+        return 0;
+    }
+
+    uint32_t cluster = fat32_entry_cluster(entry);
+
+    if (new_size == 0) {
+        /* Free all clusters */
+        if (cluster >= FAT32_FIRST_DATA_CLUSTER) {
+            fat32_free_chain(fs, cluster);
         }
+        fat32_entry_set_cluster(entry, 0);
+        fat32_extent_truncate(map, 0);
+        entry->file_size = 0;
+        return 0;
+    }
 
-        fat32_memcpy(dest, fs->cluster_buffer + offset_in_cluster, to_copy);
+    if (new_size < old_size) {
+        /* Shrinking - free excess clusters */
+        uint32_t clusters_needed = (new_size + cluster_size - 1) / cluster_size;
+        uint32_t run_left;
+        uint32_t last = fat32_extent_lookup(fs, map, cluster, clusters_needed - 1, &run_left);
 
-        dest += to_copy;
-        bytes_read += to_copy;
-        len -= to_copy;
-        offset_in_cluster = 0;
+        if (fat32_cluster_is_valid(fs, last)) {
+            uint32_t excess = fat32_next_cluster(fs, last);
 
-        cluster = fat32_next_cluster(fs, cluster);
+            if (fat32_cluster_is_valid(fs, excess)) {
+                /* Mark end of chain */
+                fat32_set_cluster(fs, last, FAT32_CLUSTER_EOF);
+
+                /* Free remaining clusters */
+                fat32_free_chain(fs, excess);
+            }
+        }
+
+        fat32_extent_truncate(map, clusters_needed);
     }
+    /* Extending is handled by write operations */
 
-    return bytes_read;
+    entry->file_size = new_size;
+    return 0;
 }
 
-ssize_t fat32_write_file(fat32_fs_t *fs, fat32_dir_entry_t *entry,
-                         uint32_t parent_cluster, const void *buf,
-                         size_t offset, size_t len) {
-    if (fs->readonly) {
-        return VFS_ERR_ROFS;
+int fat32_truncate_file(fat32_fs_t *fs, fat32_dir_entry_t *entry,
+                        uint32_t parent_cluster, uint32_t new_size) {
+    UNUSED(parent_cluster);
+
+    fat32_extent_map_t map;
+    map.first_cluster = FAT32_CLUSTER_EOF;  /* Force a reset on first lookup */
+
+    return fat32_truncate_file_map(fs, entry, &map, new_size);
+}
+
+int fat32_file_truncate(fat32_file_t *file, uint32_t new_size) {
+    if (!file) {
+        return VFS_ERR_INVAL;
+    }
+
+    int result = fat32_delalloc_flush(file);
+    if (result != 0) {
+        return result;
     }
 
-    if (!fs || !entry || !buf) {
-        return VFS_ERR_INVAL;
+    result = fat32_truncate_file_map(file->fs, &file->entry, &file->extents, new_size);
+    if (result == 0) {
+        file->dirty = true;
     }
+    return result;
+}
 
-    if (entry->attr & FAT32_ATTR_DIRECTORY) {
-        return VFS_ERR_ISDIR;
-    }
+/*============================================================================
+ * Delayed Allocation
+ *============================================================================*/
 
-    if (len == 0) {
-        return 0;
-    }
+/*
+ * Appends to an open file are collected in a per-file buffer of
+ * FAT32_DELALLOC_BYTES without allocating clusters. When the buffer fills,
+ * or the file is read, closed or synced, the whole buffer is written with
+ * one contiguous cluster allocation. Data older than FAT32_DELALLOC_AGE_MS
+ * is also flushed by the next append, and in the background by the block
+ * cache's write-back thread, which calls fat32_writeback_hook() every
+ * interval and syncs the volume once some file's data has aged. The data
+ * then sits dirty in the block buffer cache until write-back or a sync
+ * writes it to the device. A file unlinked while open drops its pending
+ * data at its last close, along with its clusters.
+ */
 
-    uint32_t cluster = fat32_entry_cluster(entry);
-    uint32_t cluster_size = fs->bytes_per_cluster;
-    size_t bytes_written = 0;
-    const uint8_t *src = (const uint8_t *)buf;
+/**
+ * Start buffering appends at a cluster-aligned offset
+ * @return false if no buffer or tracking slot is available
+ */
+static bool fat32_delalloc_begin(fat32_file_t *file, size_t offset) {
+    fat32_fs_t *fs = file->fs;
+    fat32_delalloc_t *da = &file->delalloc;
 
-    /* Handle file with no clusters yet */
-    if (cluster < FAT32_FIRST_DATA_CLUSTER) {
-        cluster = fat32_alloc_cluster(fs);
-        if (!cluster) {
-            return VFS_ERR_NOSPC;
+    if (!da->buffer) {
+        physaddr_t phys = pmm_alloc_pages(FAT32_DELALLOC_BYTES / PAGE_SIZE);
+        if (!phys) {
+            return false;
         }
-        fat32_entry_set_cluster(entry, cluster);
+        da->buffer = (uint8_t *)(phys + VMM_KERNEL_PHYS_MAP);
     }
 
-    /* Skip to starting cluster */
-    uint32_t clusters_to_skip = offset / cluster_size;
-    uint32_t offset_in_cluster = offset % cluster_size;
-    uint32_t prev_cluster = 0;
+    /* Track the file so a filesystem sync can find its pending data */
+    int slot = -1;
+    for (int i = 0; i < FAT32_DELALLOC_MAX_FILES; i++) {
+        if (fs->delalloc_files[i] == file) {
+            slot = i;
+            break;
+        }
+        if (slot < 0 && !fs->delalloc_files[i]) {
+            slot = i;
+        }
+    }
+    if (slot < 0) {
+        return false;
+    }
 
-    while (clusters_to_skip > 0) {
-        prev_cluster = cluster;
-        uint32_t next = fat32_next_cluster(fs, cluster);
+    fs->delalloc_files[slot] = file;
+    da->start = (uint32_t)offset;
+    da->length = 0;
+    da->since = pit_get_uptime_ms();
+    return true;
+}
 
-        if (fat32_is_eof(next) || !fat32_cluster_is_valid(fs, next)) {
-            /* Need to extend the file */
-            uint32_t new_cluster = fat32_alloc_cluster(fs);
-            if (!new_cluster) {
-                return VFS_ERR_NOSPC;
-            }
-            fat32_set_cluster(fs, cluster, new_cluster);
-            next = new_cluster;
+/**
+ * Allocate clusters for and write out a file's pending data
+ * @return 0 on success, negative error code on failure
+ */
+static int fat32_delalloc_flush(fat32_file_t *file) {
+    fat32_fs_t *fs = file->fs;
+    fat32_delalloc_t *da = &file->delalloc;
 
-            /* Zero out new cluster */
-            fat32_memset(fs->cluster_buffer, 0, cluster_size);
-            fat32_write_cluster(fs, new_cluster, fs->cluster_buffer);
+    for (int i = 0; i < FAT32_DELALLOC_MAX_FILES; i++) {
+        if (fs->delalloc_files[i] == file) {
+            fs->delalloc_files[i] = NULL;
         }
+    }
 
-        cluster = next;
-        clusters_to_skip--;
+    if (da->length == 0) {
+        return 0;
     }
 
-    /* Write data */
-    while (len > 0) {
-        /* Read current cluster content for partial writes */
-        int result = fat32_read_cluster(fs, cluster, fs->cluster_buffer);
-        if (result != 0) {
-            fat32_memset(fs->cluster_buffer, 0, cluster_size);
-        }
+    uint32_t start = da->start;
+    uint32_t length = da->length;
+    da->start += length;
+    da->length = 0;
 
-        size_t to_copy = cluster_size - offset_in_cluster;
-        if (to_copy > len) {
-            to_copy = len;
-        }
+    ssize_t written = fat32_write_file_map(fs, &file->entry, &file->extents,
+                                           da->buffer, start, length);
+    file->dirty = true;
 
-        fat32_memcpy(fs->cluster_buffer + offset_in_cluster, src, to_copy);
+    if (written < (ssize_t)length) {
+        /* Pending data that found no space is lost; trim the size to match */
+        file->entry.file_size = start + (written > 0 ? (uint32_t)written : 0);
+        kprintf("[FAT32] Delayed write of %u bytes failed\n", length);
+        return (written < 0) ? (int)written : VFS_ERR_NOSPC;
+    }
 
-        result = fat32_write_cluster(fs, cluster, fs->cluster_buffer);
-        if (result != 0) {
-            return result;
-        }
+    return 0;
+}
 
-        src += to_copy;
-        bytes_written += to_copy;
-        len -= to_copy;
-        offset_in_cluster = 0;
+/**
+ * Release a file's delayed-allocation buffer (pending data must be flushed)
+ */
+static void fat32_delalloc_release(fat32_file_t *file) {
+    fat32_delalloc_t *da = &file->delalloc;
 
-        if (len > 0) {
-            prev_cluster = cluster;
-            uint32_t next = fat32_next_cluster(fs, cluster);
+    if (da->buffer && da->length == 0) {
+        pmm_free_pages((physaddr_t)da->buffer - VMM_KERNEL_PHYS_MAP,
+                       FAT32_DELALLOC_BYTES / PAGE_SIZE);
+        da->buffer = NULL;
+    }
+}
 
-            if (fat32_is_eof(next) || !fat32_cluster_is_valid(fs, next)) {
-                /* Need more clusters */
-                uint32_t new_cluster = fat32_alloc_cluster(fs);
-                if (!new_cluster) {
-                    break;  /* Return partial write */
-                }
-                fat32_set_cluster(fs, cluster, new_cluster);
-                next = new_cluster;
-            }
+/**
+ * Throw away a file's pending data and release its buffer
+ */
+static void fat32_delalloc_discard(fat32_file_t *file) {
+    fat32_fs_t *fs = file->fs;
 
-            cluster = next;
+    for (int i = 0; i < FAT32_DELALLOC_MAX_FILES; i++) {
+        if (fs->delalloc_files[i] == file) {
+            fs->delalloc_files[i] = NULL;
         }
     }
 
-    /* Update file size if necessary */
-    size_t new_end = offset + bytes_written;
-    if (new_end > entry->file_size) {
-        entry->file_size = (uint32_t)new_end;
+    file->delalloc.length = 0;
+    fat32_delalloc_release(file);
+}
+
+/**
+ * Sync the volume if any open file's delayed data is min_age_ms old
+ * (volume lock must be held)
+ */
+static int fat32_delalloc_expire(fat32_fs_t *fs, uint64_t min_age_ms) {
+    uint64_t now = pit_get_uptime_ms();
+
+    for (int i = 0; i < FAT32_DELALLOC_MAX_FILES; i++) {
+        fat32_file_t *file = fs->delalloc_files[i];
+        if (file && file->delalloc.length > 0 &&
+            now - file->delalloc.since >= min_age_ms) {
+            return fat32_sync(fs);
+        }
     }
+    return 0;
+}
 
-    /* Note: Caller is responsible for updating the directory entry on disk */
+/**
+ * Write-back hook: flush delayed data that has aged out
+ * Skips a round rather than wait behind an operation on the volume.
+ */
+static void fat32_writeback_hook(void *ctx) {
+    fat32_fs_t *fs = (fat32_fs_t *)ctx;
 
-    return bytes_written;
+    if (!fat32_vol_trylock(fs)) {
+        return;
+    }
+    fat32_delalloc_expire(fs, FAT32_DELALLOC_AGE_MS);
+    fat32_vol_unlock(fs);
 }
 
-int fat32_truncate_file(fat32_fs_t *fs, fat32_dir_entry_t *entry,
-                        uint32_t parent_cluster, uint32_t new_size) {
-    if (fs->readonly) {
-        return VFS_ERR_ROFS;
+int fat32_writeback(fat32_fs_t *fs, uint64_t min_age_ms) {
+    if (!fs || !fs->mounted) {
+        return VFS_ERR_INVAL;
     }
 
-    uint32_t old_size = entry->file_size;
-    uint32_t cluster_size = fs->bytes_per_cluster;
+    fat32_vol_lock(fs);
+    int result = fat32_delalloc_expire(fs, min_age_ms);
+    fat32_vol_unlock(fs);
+    return result;
+}
 
-    if (new_size == old_size) {
-        return 0;
+/**
+ * Write a directory entry back to the slot it was found in
+ * Entries never move, and unlinking an open file marks it, so the slot
+ * recorded at lookup still belongs to the file.
+ * @param cluster Directory cluster holding the slot
+ * @param index Slot number in the directory
+ */
+static int fat32_update_dir_entry(fat32_fs_t *fs, uint32_t cluster, uint32_t index,
+                                  fat32_dir_entry_t *entry) {
+    uint32_t entries_per_cluster = fs->bytes_per_cluster / sizeof(fat32_dir_entry_t);
+
+    if (!fat32_cluster_is_valid(fs, cluster)) {
+        return VFS_ERR_NOENT;
     }
 
-    uint32_t cluster = fat32_entry_cluster(entry);
+    int result = fat32_read_cluster(fs, cluster, fs->cluster_buffer);
+    if (result != 0) {
+        return result;
+    }
 
-    if (new_size == 0) {
-        /* Free all clusters */
-        if (cluster >= FAT32_FIRST_DATA_CLUSTER) {
-            fat32_free_chain(fs, cluster);
-        }
-        fat32_entry_set_cluster(entry, 0);
-        entry->file_size = 0;
-        return 0;
+    fat32_dir_entry_t *slot = (fat32_dir_entry_t *)fs->cluster_buffer +
+                              (index % entries_per_cluster);
+    fat32_memcpy(slot, entry, sizeof(fat32_dir_entry_t));
+    return fat32_write_cluster(fs, cluster, fs->cluster_buffer);
+}
+
+int fat32_file_flush(fat32_file_t *file) {
+    if (!file) {
+        return VFS_ERR_INVAL;
     }
 
-    if (new_size < old_size) {
-        /* Shrinking - free excess clusters */
-        uint32_t clusters_needed = (new_size + cluster_size - 1) / cluster_size;
-        uint32_t count = 1;
-        uint32_t prev_cluster = 0;
+    int result = fat32_delalloc_flush(file);
 
-        while (count < clusters_needed && fat32_cluster_is_valid(fs, cluster)) {
-            prev_cluster = cluster;
-            cluster = fat32_next_cluster(fs, cluster);
-            count++;
+    /* An unlinked file has no directory entry left to update */
+    if (file->unlinked) {
+        file->dirty = false;
+    }
+
+    /* Persist the new size and first cluster in the directory entry */
+    if (file->dirty && file->parent_cluster >= FAT32_FIRST_DATA_CLUSTER) {
+        int update = fat32_update_dir_entry(file->fs, file->entry_cluster,
+                                            file->entry_index, &file->entry);
+        if (update == 0) {
+            file->dirty = false;
+        } else if (result == 0) {
+            result = update;
         }
+    }
 
-        if (prev_cluster && fat32_cluster_is_valid(fs, cluster)) {
-            /* Mark end of chain */
-            fat32_set_cluster(fs, prev_cluster, FAT32_CLUSTER_EOF);
+    return result;
+}
 
-            /* Free remaining clusters */
-            fat32_free_chain(fs, cluster);
-        }
+int fat32_file_sync(fat32_file_t *file) {
+    if (!file) {
+        return VFS_ERR_INVAL;
     }
-    /* Extending is handled by write operations */
 
-    entry->file_size = new_size;
-    return 0;
+    int result = fat32_file_flush(file);
+    int sync = fat32_sync(file->fs);
+
+    return (result != 0) ? result : sync;
 }
 
 /*============================================================================
@@ -1452,6 +3691,13 @@ int fat32_sync(fat32_fs_t *fs) {
         return VFS_ERR_INVAL;
     }
 
+    /* Allocate and write out data delayed in open files */
+    for (int i = 0; i < FAT32_DELALLOC_MAX_FILES; i++) {
+        if (fs->delalloc_files[i]) {
+            fat32_file_flush(fs->delalloc_files[i]);
+        }
+    }
+
     int result = fat32_flush_fat_cache(fs);
     if (result != 0) {
         return result;
@@ -1471,31 +3717,66 @@ int fat32_sync(fat32_fs_t *fs) {
     return 0;
 }
 
-int fat32_statfs(fat32_fs_t *fs, uint64_t *total_bytes, uint64_t *free_bytes) {
-    if (!fs || !fs->mounted) {
+int fat32_statfs(fat32_fs_t *fs, fat32_statfs_t *stats) {
+    if (!fs || !fs->mounted || !stats) {
         return VFS_ERR_INVAL;
     }
 
-    if (total_bytes) {
-        *total_bytes = (uint64_t)fs->total_clusters * fs->bytes_per_cluster;
-    }
+    stats->cluster_size = fs->bytes_per_cluster;
+    stats->total_bytes = (uint64_t)fs->total_clusters * fs->bytes_per_cluster;
+
+    if (fs->free_bitmap) {
+        /*
+         * Do not wait for the scan: until it has counted the whole FAT,
+         * report the FSInfo count kept up to date by the allocator, or
+         * without one extrapolate from the part scanned so far.
+         */
+        uint32_t scanned = 0;
+        uint32_t counted = 0;
+
+        for (;;) {
+            spinlock_acquire(&fs->bitmap_lock);
+            scanned = fs->bitmap_scanned;
+            counted = fs->bitmap_free;
+            spinlock_release(&fs->bitmap_lock);
+
+            /* Scan one chunk for a sample if nothing has been counted */
+            if (scanned > 0 || fs->free_clusters != 0xFFFFFFFF ||
+                !fat32_bitmap_scan_step(fs, true)) {
+                break;
+            }
+        }
 
-    if (free_bytes) {
-        if (fs->free_clusters != 0xFFFFFFFF) {
-            *free_bytes = (uint64_t)fs->free_clusters * fs->bytes_per_cluster;
+        uint64_t free_count;
+        if (scanned >= fs->total_clusters) {
+            free_count = counted;
+        } else if (fs->free_clusters != 0xFFFFFFFF) {
+            free_count = fs->free_clusters;
+        } else if (scanned > 0) {
+            free_count = counted + ((uint64_t)(fs->total_clusters - scanned) * counted) / scanned;
         } else {
-            /* Count free clusters manually */
-            uint32_t free_count = 0;
-            for (uint32_t i = FAT32_FIRST_DATA_CLUSTER;
-                 i < FAT32_FIRST_DATA_CLUSTER + fs->total_clusters; i++) {
-                if (fat32_read_fat_entry(fs, i) == FAT32_CLUSTER_FREE) {
-                    free_count++;
-                }
+            free_count = 0;
+        }
+        stats->free_bytes = free_count * fs->bytes_per_cluster;
+    } else if (fs->free_clusters != 0xFFFFFFFF) {
+        stats->free_bytes = (uint64_t)fs->free_clusters * fs->bytes_per_cluster;
+    } else {
+        /* Count free clusters manually */
+        uint32_t free_count = 0;
+        for (uint32_t i = FAT32_FIRST_DATA_CLUSTER;
+             i < FAT32_FIRST_DATA_CLUSTER + fs->total_clusters; i++) {
+            if (fat32_read_fat_entry(fs, i) == FAT32_CLUSTER_FREE) {
+                free_count++;
             }
-            *free_bytes = (uint64_t)free_count * fs->bytes_per_cluster;
         }
+        stats->free_bytes = (uint64_t)free_count * fs->bytes_per_cluster;
     }
 
+    uint64_t lookups = fs->fat_cache_hits + fs->fat_cache_misses;
+    stats->fat_cache_hits = fs->fat_cache_hits;
+    stats->fat_cache_misses = fs->fat_cache_misses;
+    stats->fat_cache_hit_pct = lookups ? (uint32_t)((fs->fat_cache_hits * 100) / lookups) : 0;
+
     return 0;
 }
 
@@ -1514,24 +3795,155 @@ int fat32_vfs_open(vfs_node_t *node, int flags) {
         return VFS_ERR_ROFS;
     }
 
-    /* Node already has fs_data pointing to fat32_file_t */
+    /* Node already has fs_data pointing to fat32_file_t; track it as open */
+    fat32_file_t *file = (fat32_file_t *)node->fs_data;
+    if (file) {
+        fat32_vol_lock(fs);
+        if (file->open_count++ == 0) {
+            file->next_open = fs->open_files;
+            fs->open_files = file;
+        }
+        fat32_vol_unlock(fs);
+    }
     return VFS_OK;
 }
 
+/**
+ * Take a file off the open list after its last close (volume lock held)
+ * An unlinked file's pending data is dropped and its clusters freed,
+ * unless another open node still uses the same chain.
+ */
+static void fat32_file_last_close(fat32_file_t *file) {
+    fat32_fs_t *fs = file->fs;
+
+    for (fat32_file_t **link = &fs->open_files; *link; link = &(*link)->next_open) {
+        if (*link == file) {
+            *link = file->next_open;
+            break;
+        }
+    }
+    file->next_open = NULL;
+
+    if (!file->unlinked) {
+        return;
+    }
+
+    fat32_delalloc_discard(file);
+
+    uint32_t cluster = fat32_entry_cluster(&file->entry);
+    if (cluster < FAT32_FIRST_DATA_CLUSTER) {
+        return;
+    }
+    for (fat32_file_t *other = fs->open_files; other; other = other->next_open) {
+        if (other->unlinked && fat32_entry_cluster(&other->entry) == cluster) {
+            return;
+        }
+    }
+
+    fat32_free_chain(fs, cluster);
+    fat32_entry_set_cluster(&file->entry, 0);
+    fat32_extent_truncate(&file->extents, 0);
+    file->entry.file_size = 0;
+}
+
 int fat32_vfs_close(vfs_node_t *node) {
     if (!node) {
         return VFS_ERR_INVAL;
     }
 
+    /* Write out delayed data and the updated directory entry */
+    fat32_file_t *file = (fat32_file_t *)node->fs_data;
+    fat32_fs_t *fs = file ? file->fs : NULL;
+    if (!fs && node->mount) {
+        fs = (fat32_fs_t *)node->mount->fs_data;
+    }
+    if (!fs) {
+        return VFS_OK;
+    }
+
+    fat32_vol_lock(fs);
+
+    if (file && file->open_count > 0 && --file->open_count == 0) {
+        fat32_file_last_close(file);
+    }
+
+    if (file && !file->is_dir) {
+        fat32_file_flush(file);
+        fat32_delalloc_release(file);
+    }
+
     /* Sync if dirty */
-    if (node->dirty && node->mount) {
-        fat32_fs_t *fs = (fat32_fs_t *)node->mount->fs_data;
+    if (node->dirty) {
         fat32_sync(fs);
     }
 
+    fat32_vol_unlock(fs);
+
     return VFS_OK;
 }
 
+int fat32_vfs_truncate(vfs_node_t *node, uint64_t size) {
+    if (!node || node->type != VFS_NODE_FILE) {
+        return VFS_ERR_INVAL;
+    }
+
+    fat32_file_t *file = (fat32_file_t *)node->fs_data;
+    if (!file) {
+        return VFS_ERR_INVAL;
+    }
+    if (size > 0xFFFFFFFF) {
+        return VFS_ERR_FBIG;
+    }
+
+    fat32_vol_lock(file->fs);
+    int result = fat32_file_truncate(file, (uint32_t)size);
+    fat32_vol_unlock(file->fs);
+    if (result == 0) {
+        node->size = size;
+    }
+    return result;
+}
+
+int fat32_vfs_sync(vfs_node_t *node) {
+    if (!node) {
+        return VFS_ERR_INVAL;
+    }
+
+    fat32_file_t *file = (fat32_file_t *)node->fs_data;
+    if (!file) {
+        return VFS_ERR_INVAL;
+    }
+
+    fat32_vol_lock(file->fs);
+    int result = fat32_file_sync(file);
+    fat32_vol_unlock(file->fs);
+    return result;
+}
+
+int fat32_vfs_sync_fs(vfs_mount_t *mount) {
+    if (!mount || !mount->fs_data) {
+        return VFS_ERR_INVAL;
+    }
+
+    fat32_fs_t *fs = (fat32_fs_t *)mount->fs_data;
+    fat32_vol_lock(fs);
+    int result = fat32_sync(fs);
+    fat32_vol_unlock(fs);
+    return result;
+}
+
+int fat32_vfs_statfs(vfs_mount_t *mount, void *buf) {
+    if (!mount || !mount->fs_data || !buf) {
+        return VFS_ERR_INVAL;
+    }
+
+    fat32_fs_t *fs = (fat32_fs_t *)mount->fs_data;
+    fat32_vol_lock(fs);
+    int result = fat32_statfs(fs, (fat32_statfs_t *)buf);
+    fat32_vol_unlock(fs);
+    return result;
+}
+
 ssize_t fat32_vfs_read(vfs_node_t *node, void *buf, size_t size, uint64_t offset) {
     if (!node || !buf) {
         return VFS_ERR_INVAL;
@@ -1542,7 +3954,10 @@ ssize_t fat32_vfs_read(vfs_node_t *node, void *buf, size_t size, uint64_t offset
         return VFS_ERR_INVAL;
     }
 
-    return fat32_read_file(file->fs, &file->entry, buf, (size_t)offset, size);
+    fat32_vol_lock(file->fs);
+    ssize_t result = fat32_file_read(file, buf, (size_t)offset, size);
+    fat32_vol_unlock(file->fs);
+    return result;
 }
 
 ssize_t fat32_vfs_write(vfs_node_t *node, const void *buf, size_t size, uint64_t offset) {
@@ -1555,12 +3970,48 @@ ssize_t fat32_vfs_write(vfs_node_t *node, const void *buf, size_t size, uint64_t
         return VFS_ERR_INVAL;
     }
 
-    /* Get parent cluster from path (simplified - assumes file->path is set) */
-    /* In a full implementation, we'd track the parent cluster */
-    fat32_fs_t *fs = file->fs;
+    fat32_vol_lock(file->fs);
+    ssize_t result = fat32_file_write(file, buf, (size_t)offset, size);
+    fat32_vol_unlock(file->fs);
+    if (result > 0) {
+        node->size = file->entry.file_size;
+        node->dirty = true;
+    }
+
+    return result;
+}
+
+ssize_t fat32_vfs_readv(vfs_node_t *node, const vfs_iovec_t *iov, int iovcnt,
+                        uint64_t offset) {
+    if (!node || !iov) {
+        return VFS_ERR_INVAL;
+    }
+
+    fat32_file_t *file = (fat32_file_t *)node->fs_data;
+    if (!file) {
+        return VFS_ERR_INVAL;
+    }
+
+    fat32_vol_lock(file->fs);
+    ssize_t result = fat32_file_readv(file, iov, iovcnt, (size_t)offset);
+    fat32_vol_unlock(file->fs);
+    return result;
+}
+
+ssize_t fat32_vfs_writev(vfs_node_t *node, const vfs_iovec_t *iov, int iovcnt,
+                         uint64_t offset) {
+    if (!node || !iov) {
+        return VFS_ERR_INVAL;
+    }
+
+    fat32_file_t *file = (fat32_file_t *)node->fs_data;
+    if (!file) {
+        return VFS_ERR_INVAL;
+    }
 
-    ssize_t result = fat32_write_file(fs, &file->entry, fs->root_cluster, buf,
-                                      (size_t)offset, size);
+    fat32_vol_lock(file->fs);
+    ssize_t result = fat32_file_writev(file, iov, iovcnt, (size_t)offset);
+    fat32_vol_unlock(file->fs);
     if (result > 0) {
         node->size = file->entry.file_size;
         node->dirty = true;
@@ -1585,13 +4036,22 @@ vfs_dirent_t* fat32_vfs_readdir(vfs_node_t *dir, uint32_t index) {
     fat32_dir_entry_t entry;
     char name[FAT32_MAX_NAME + 1];
 
-    /* Skip . and .. entries (index 0 and 1 often) */
+    /*
+     * Every directory but the root starts with "." and "..", which are not
+     * reported. The VFS advances the index by one per entry returned, so
+     * they are stepped over here rather than consumed by the index.
+     */
     uint32_t actual_index = index;
+    if (file->first_cluster != file->fs->root_cluster) {
+        actual_index += 2;
+    }
     int result;
 
     do {
+        fat32_vol_lock(file->fs);
         result = fat32_read_dir_entry(file->fs, file->first_cluster, actual_index,
                                       &entry, name);
+        fat32_vol_unlock(file->fs);
         if (result != 0) {
             return NULL;
         }
@@ -1633,8 +4093,17 @@ vfs_node_t* fat32_vfs_finddir(vfs_node_t *dir, const char *name) {
 
     fat32_fs_t *fs = dir_file->fs;
     fat32_dir_entry_t entry;
+    uint32_t entry_index;
+
+    uint32_t entry_cluster = FAT32_CLUSTER_EOF;
 
-    int result = fat32_find_entry_in_dir(fs, dir_file->first_cluster, name, &entry, NULL);
+    fat32_vol_lock(fs);
+    int result = fat32_find_entry_in_dir(fs, dir_file->first_cluster, name, &entry,
+                                         &entry_index);
+    if (result == 0) {
+        entry_cluster = fat32_dir_slot_cluster(fs, dir_file->first_cluster, entry_index);
+    }
+    fat32_vol_unlock(fs);
     if (result != 0) {
         return NULL;
     }
@@ -1646,7 +4115,7 @@ vfs_node_t* fat32_vfs_finddir(vfs_node_t *dir, const char *name) {
     }
 
     /* Allocate FAT32 file handle */
-    physaddr_t file_phys = pmm_alloc_page();
+    physaddr_t file_phys = pmm_alloc_pages(FAT32_FILE_PAGES);
     if (!file_phys) {
         vfs_free_node(node);
         return NULL;
@@ -1659,6 +4128,9 @@ vfs_node_t* fat32_vfs_finddir(vfs_node_t *dir, const char *name) {
     file->first_cluster = fat32_entry_cluster(&entry);
     file->current_cluster = file->first_cluster;
     file->is_dir = (entry.attr & FAT32_ATTR_DIRECTORY) != 0;
+    file->parent_cluster = dir_file->first_cluster;
+    file->entry_index = entry_index;
+    file->entry_cluster = entry_cluster;
 
     /* Fill in node */
     char formatted_name[13];
@@ -1731,8 +4203,10 @@ int fat32_vfs_mkdir(vfs_node_t *parent, const char *name, uint32_t permissions)
     }
 
     fat32_dir_entry_t entry;
+    fat32_vol_lock(parent_file->fs);
     int result = fat32_create_entry(parent_file->fs, parent_file->first_cluster,
                                     name, FAT32_ATTR_DIRECTORY, &entry);
+    fat32_vol_unlock(parent_file->fs);
     if (result != 0) {
         return result;
     }
@@ -1754,8 +4228,10 @@ int fat32_vfs_create(vfs_node_t *parent, const char *name, uint32_t permissions)
     }
 
     fat32_dir_entry_t entry;
+    fat32_vol_lock(parent_file->fs);
     int result = fat32_create_entry(parent_file->fs, parent_file->first_cluster,
                                     name, FAT32_ATTR_ARCHIVE, &entry);
+    fat32_vol_unlock(parent_file->fs);
     if (result != 0) {
         return result;
     }
@@ -1774,7 +4250,9 @@ int fat32_vfs_unlink(vfs_node_t *parent, const char *name) {
         return VFS_ERR_INVAL;
     }
 
+    fat32_vol_lock(parent_file->fs);
     int result = fat32_delete_entry(parent_file->fs, parent_file->first_cluster, name);
+    fat32_vol_unlock(parent_file->fs);
     if (result != 0) {
         return result;
     }
@@ -1790,10 +4268,8 @@ int fat32_vfs_mount(vfs_mount_t *mount, void *device) {
 
     kprintf("[FAT32] VFS mount request for %s\n", mount->path);
 
-    /* Device should provide block_ops - for now, cast it */
-    fat32_block_ops_t *block_ops = (fat32_block_ops_t *)device;
-
-    fat32_fs_t *fs = fat32_mount(device, block_ops);
+    /* Device is a registered block device; I/O goes through the buffer cache */
+    fat32_fs_t *fs = fat32_mount(device, &blkdev_ops);
     if (!fs) {
         return VFS_ERR_IO;
     }
@@ -1810,7 +4286,7 @@ int fat32_vfs_mount(vfs_mount_t *mount, void *device) {
     }
 
     /* Allocate file handle for root */
-    physaddr_t file_phys = pmm_alloc_page();
+    physaddr_t file_phys = pmm_alloc_pages(FAT32_FILE_PAGES);
     if (!file_phys) {
         vfs_free_node(root);
         fat32_unmount(fs);
@@ -1852,7 +4328,7 @@ int fat32_vfs_unmount(vfs_mount_t *mount) {
     /* Free root node file handle */
     if (mount->root && mount->root->fs_data) {
         physaddr_t file_phys = (physaddr_t)mount->root->fs_data - VMM_KERNEL_PHYS_MAP;
-        pmm_free_page(file_phys);
+        pmm_free_pages(file_phys, FAT32_FILE_PAGES);
     }
 
     /* Free root node */
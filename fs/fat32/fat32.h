@@ -19,6 +19,7 @@
 
 #include "../../kernel/include/types.h"
 #include "../vfs/vfs.h"
+#include "../../drivers/storage/blkdev.h"
 
 /*============================================================================
  * FAT32 Constants
@@ -73,8 +74,32 @@
 #define FAT32_MAX_NAME              255
 #define FAT32_SHORT_NAME_LEN        11
 
-/* FAT cache size (number of sectors to cache) */
-#define FAT32_FAT_CACHE_SIZE        16
+/* FAT sector cache geometry (set-associative, LRU within a set) */
+#define FAT32_FAT_CACHE_SETS        64          /* Sets (power of 2) */
+#define FAT32_FAT_CACHE_WAYS        4           /* Sectors per set */
+#define FAT32_FAT_CACHE_SIZE        (FAT32_FAT_CACHE_SETS * FAT32_FAT_CACHE_WAYS)
+#define FAT32_FAT_CACHE_PAGES       ((FAT32_FAT_CACHE_SIZE * FAT32_SECTOR_SIZE + PAGE_SIZE - 1) / PAGE_SIZE)
+#define FAT32_FAT_FLUSH_SECTORS     64          /* Sectors per batched FAT write */
+
+/* Sequential read-ahead window limits (bytes) */
+#define FAT32_RA_MIN_BYTES          (16 * 1024)
+#define FAT32_RA_MAX_BYTES          (512 * 1024)
+
+/* Free-cluster bitmap */
+#define FAT32_BITMAP_SCAN_SECTORS   256         /* FAT sectors scanned per step (128 KB) */
+#define FAT32_MAX_SCAN_MOUNTS       8           /* Volumes queued for scanning */
+
+/* Per-file cluster extent table size */
+#define FAT32_EXTENT_MAX            32
+
+/* Directory name index */
+#define FAT32_DIR_INDEX_MAX         8           /* Indexed directories per volume */
+#define FAT32_DIR_INDEX_MIN_SLOTS   256         /* Minimum slot capacity of an index */
+
+/* Delayed allocation of appended data */
+#define FAT32_DELALLOC_BYTES        (256 * 1024)    /* Per-file append buffer */
+#define FAT32_DELALLOC_AGE_MS       5000        /* Write-back flushes pending data older than this */
+#define FAT32_DELALLOC_MAX_FILES    16          /* Files with pending data per volume */
 
 /*============================================================================
  * FAT32 On-Disk Structures
@@ -178,47 +203,68 @@ typedef struct PACKED {
 
 /**
  * Block device operations interface
- * Abstraction layer for reading/writing sectors to storage
+ * FAT32 uses the generic block layer interface (see blkdev.h)
  */
-typedef struct {
-    /**
-     * Read sectors from device
-     * @param device Device-specific data
-     * @param lba Logical Block Address (sector number)
-     * @param count Number of sectors to read
-     * @param buffer Buffer to read into
-     * @return 0 on success, negative error code on failure
-     */
-    int (*read_sectors)(void *device, uint64_t lba, uint32_t count, void *buffer);
-
-    /**
-     * Write sectors to device
-     * @param device Device-specific data
-     * @param lba Logical Block Address (sector number)
-     * @param count Number of sectors to write
-     * @param buffer Buffer to write from
-     * @return 0 on success, negative error code on failure
-     */
-    int (*write_sectors)(void *device, uint64_t lba, uint32_t count, const void *buffer);
-
-    /**
-     * Flush pending writes to device
-     * @param device Device-specific data
-     * @return 0 on success, negative error code on failure
-     */
-    int (*flush)(void *device);
-} fat32_block_ops_t;
+typedef block_ops_t fat32_block_ops_t;
 
 /**
  * FAT cache entry
+ * Sector N lives in set (N % FAT32_FAT_CACHE_SETS), so a run of
+ * consecutive FAT sectors spreads over all sets.
  */
 typedef struct {
     uint32_t    sector;             /* Cached FAT sector number */
+    uint32_t    last_used;          /* LRU stamp (fs->fat_cache_clock) */
     bool        dirty;              /* Cache entry has been modified */
     bool        valid;              /* Cache entry contains valid data */
-    uint8_t     data[FAT32_SECTOR_SIZE]; /* Cached sector data */
+    uint8_t     *data;              /* Cached sector data (FAT32_SECTOR_SIZE) */
 } fat32_fat_cache_entry_t;
 
+/**
+ * Directory index name node
+ * Each indexed entry has a node for its 8.3 name and, if it has a valid
+ * LFN sequence, a second node for the long name.
+ */
+typedef struct {
+    uint32_t    hash;               /* Case-folded name hash */
+    uint32_t    slot;               /* Slot of the short entry (UINT32_MAX = removed) */
+    int32_t     next;               /* Next node in the bucket, -1 ends */
+    int32_t     sibling;            /* Other node of the same entry, -1 if none */
+    uint8_t     lfn_slots;          /* LFN entries before the short entry */
+    bool        is_long;            /* Node holds the long name */
+} fat32_dir_name_t;
+
+/**
+ * In-memory index of one directory
+ * Slots are numbered across the directory's cluster chain, 32 bytes each.
+ */
+typedef struct {
+    uint32_t            dir_cluster;        /* First cluster (0 = unused) */
+    uint32_t            last_used;          /* LRU stamp */
+    int32_t             *buckets;           /* Hash heads, -1 = empty */
+    uint32_t            bucket_mask;
+    fat32_dir_name_t    *names;             /* Name nodes */
+    uint32_t            name_count;
+    uint32_t            name_capacity;
+    uint32_t            *clusters;          /* Directory chain in order */
+    uint32_t            cluster_count;
+    uint32_t            cluster_capacity;
+    uint32_t            *free_map;          /* One bit per slot, set = free */
+    uint32_t            pages;              /* Pages backing the index */
+} fat32_dir_index_t;
+
+/**
+ * Filesystem statistics
+ */
+typedef struct {
+    uint64_t    total_bytes;        /* Size of the data area */
+    uint64_t    free_bytes;         /* Free space */
+    uint32_t    cluster_size;       /* Bytes per cluster */
+    uint64_t    fat_cache_hits;     /* FAT sector lookups served from cache */
+    uint64_t    fat_cache_misses;   /* FAT sector lookups that read the disk */
+    uint32_t    fat_cache_hit_pct;  /* Hit rate in percent */
+} fat32_statfs_t;
+
 /**
  * FAT32 Filesystem State
  * Main structure holding all mount-related information
@@ -246,10 +292,43 @@ typedef struct {
 
     /* FAT cache */
     fat32_fat_cache_entry_t fat_cache[FAT32_FAT_CACHE_SIZE];
+    uint8_t                 *fat_cache_data;    /* Sector buffers for fat_cache */
+    uint8_t                 *fat_flush_buffer;  /* Staging for batched FAT writes */
+    uint32_t                fat_cache_clock;    /* LRU stamp source */
+    volatile uint32_t       fat_writes;         /* Writes to the first FAT, for the scanner */
+    uint64_t                fat_cache_hits;
+    uint64_t                fat_cache_misses;
+
+    /* FAT sectors written to the first FAT but not yet to the backups */
+    uint32_t                *fat_mirror_pending;    /* One bit per FAT sector */
+    uint32_t                mirror_pages;       /* Pages backing fat_mirror_pending */
+    bool                    mirror_dirty;       /* Any bit set */
 
     /* Cluster buffer (for reading full clusters) */
     uint8_t                 *cluster_buffer;
 
+    /* Free-cluster bitmap (bit set = free), built in the background */
+    uint32_t                *free_bitmap;       /* One bit per data cluster */
+    uint32_t                bitmap_pages;       /* Pages backing free_bitmap */
+    uint32_t                bitmap_scanned;     /* Data clusters scanned so far */
+    uint32_t                bitmap_free;        /* Free clusters in scanned range */
+    uint8_t                 *scan_buffer;       /* FAT chunk buffer for the scan */
+    bool                    scan_busy;          /* A chunk is being read into scan_buffer */
+    volatile int            bitmap_lock;        /* Protects the bitmap */
+
+    /* Directory name indexes */
+    fat32_dir_index_t       dir_index[FAT32_DIR_INDEX_MAX];
+    uint32_t                dir_index_clock;    /* LRU stamp source */
+
+    /* Open files holding appended data not yet allocated on disk */
+    struct fat32_file       *delalloc_files[FAT32_DELALLOC_MAX_FILES];
+
+    /* Files with open descriptors, linked through next_open */
+    struct fat32_file       *open_files;
+
+    /* Serializes VFS operations with the background delayed-data flush */
+    volatile int            vol_lock;
+
     /* Mount state */
     bool                    mounted;
     bool                    readonly;
@@ -258,11 +337,62 @@ typedef struct {
     vfs_mount_t             *vfs_mount;         /* Associated VFS mount */
 } fat32_fs_t;
 
+/* Pages needed for a fat32_fs_t */
+#define FAT32_FS_PAGES      ((sizeof(fat32_fs_t) + PAGE_SIZE - 1) / PAGE_SIZE)
+
+/**
+ * Per-file read-ahead state
+ * A read that starts where the previous one ended is sequential; the
+ * window then doubles up to FAT32_RA_MAX_BYTES. Any other offset resets it.
+ */
+typedef struct {
+    uint64_t            next_offset;        /* Offset that continues the last read */
+    uint32_t            window;             /* Read-ahead window in clusters */
+    uint32_t            ra_end;             /* First file cluster not yet prefetched */
+} fat32_readahead_t;
+
+/**
+ * Physically contiguous run of file clusters
+ */
+typedef struct {
+    uint32_t            logical;            /* First file cluster index */
+    uint32_t            physical;           /* First disk cluster */
+    uint32_t            length;             /* Number of clusters */
+} fat32_extent_t;
+
+/**
+ * Per-file cluster extent map
+ * Built lazily while the chain is walked. The table describes file
+ * clusters [0, mapped); beyond it a cursor remembers the furthest
+ * position reached so sequential access never rewalks the chain.
+ */
+typedef struct {
+    fat32_extent_t      extents[FAT32_EXTENT_MAX];
+    uint32_t            count;              /* Extents in use */
+    uint32_t            mapped;             /* File clusters covered by extents */
+    uint32_t            first_cluster;      /* Chain the map describes */
+    uint32_t            cursor_index;       /* Furthest file cluster walked */
+    uint32_t            cursor_cluster;     /* Disk cluster at cursor_index */
+    bool                at_end;             /* Cursor is the last cluster */
+} fat32_extent_map_t;
+
+/**
+ * Delayed-allocation buffer
+ * Holds data appended at [start, start + length) whose clusters have not
+ * been allocated yet. start is always cluster aligned.
+ */
+typedef struct {
+    uint8_t             *buffer;            /* FAT32_DELALLOC_BYTES, allocated on use */
+    uint32_t            start;              /* File offset of buffer[0] */
+    uint32_t            length;             /* Bytes pending */
+    uint64_t            since;              /* Uptime (ms) when buffering started */
+} fat32_delalloc_t;
+
 /**
  * FAT32 file handle
  * Used internally to track open files
  */
-typedef struct {
+typedef struct fat32_file {
     fat32_fs_t          *fs;                /* Filesystem reference */
     fat32_dir_entry_t   entry;              /* Copy of directory entry */
     uint32_t            first_cluster;      /* First cluster of file */
@@ -272,8 +402,20 @@ typedef struct {
     char                path[VFS_PATH_MAX]; /* Full path to file */
     bool                dirty;              /* File has been modified */
     bool                is_dir;             /* Is a directory */
+    fat32_readahead_t   ra;                 /* Sequential read-ahead state */
+    fat32_extent_map_t  extents;            /* Cluster chain extent map */
+    fat32_delalloc_t    delalloc;           /* Appended data awaiting allocation */
+    uint32_t            parent_cluster;     /* Directory holding the entry */
+    uint32_t            entry_index;        /* Entry slot in that directory */
+    uint32_t            entry_cluster;      /* Directory cluster holding that slot */
+    uint32_t            open_count;         /* Open descriptors */
+    bool                unlinked;           /* Entry deleted while open; chain freed on last close */
+    struct fat32_file   *next_open;         /* Next in fs->open_files */
 } fat32_file_t;
 
+/* Pages needed for a fat32_file_t */
+#define FAT32_FILE_PAGES    ((sizeof(fat32_file_t) + PAGE_SIZE - 1) / PAGE_SIZE)
+
 /*============================================================================
  * FAT32 Core Functions
  *============================================================================*/
@@ -342,6 +484,17 @@ int fat32_set_cluster(fat32_fs_t *fs, uint32_t cluster, uint32_t value);
  */
 uint32_t fat32_alloc_cluster(fat32_fs_t *fs);
 
+/**
+ * Allocate a run of contiguous free clusters linked into a chain
+ * The run ends in EOF; the caller links it after an existing cluster.
+ * @param fs Filesystem state
+ * @param goal Preferred first cluster (e.g. the one after a file's tail)
+ * @param want Number of clusters wanted
+ * @param count Output: clusters allocated (may be fewer than want)
+ * @return First cluster of the run, or 0 on failure (no free clusters)
+ */
+uint32_t fat32_alloc_run(fat32_fs_t *fs, uint32_t goal, uint32_t want, uint32_t *count);
+
 /**
  * Free a cluster chain
  * @param fs Filesystem state
@@ -432,6 +585,28 @@ int fat32_delete_entry(fat32_fs_t *fs, uint32_t parent_cluster, const char *name
 ssize_t fat32_read_file(fat32_fs_t *fs, fat32_dir_entry_t *entry, void *buf,
                         size_t offset, size_t len);
 
+/**
+ * Read data from an open file with sequential read-ahead
+ * @param file Open file handle
+ * @param buf Buffer to read into
+ * @param offset Byte offset within file
+ * @param len Number of bytes to read
+ * @return Number of bytes read, or negative error code on failure
+ */
+ssize_t fat32_file_read(fat32_file_t *file, void *buf, size_t offset, size_t len);
+
+/**
+ * Read data from an open file into several buffers
+ * The clusters covered are read once and scattered across the segments.
+ * @param file Open file handle
+ * @param iov Segments to fill, in order
+ * @param count Number of segments
+ * @param offset Byte offset within file
+ * @return Number of bytes read, or negative error code on failure
+ */
+ssize_t fat32_file_readv(fat32_file_t *file, const vfs_iovec_t *iov, int count,
+                         size_t offset);
+
 /**
  * Write data to a file
  * @param fs Filesystem state
@@ -446,6 +621,29 @@ ssize_t fat32_write_file(fat32_fs_t *fs, fat32_dir_entry_t *entry,
                          uint32_t parent_cluster, const void *buf,
                          size_t offset, size_t len);
 
+/**
+ * Write data to an open file, keeping its extent map current
+ * @param file Open file handle (entry is updated)
+ * @param buf Buffer to write from
+ * @param offset Byte offset within file
+ * @param len Number of bytes to write
+ * @return Number of bytes written, or negative error code on failure
+ */
+ssize_t fat32_file_write(fat32_file_t *file, const void *buf, size_t offset, size_t len);
+
+/**
+ * Write several buffers to an open file
+ * Appends are buffered like fat32_file_write(); other writes gather each
+ * cluster from the segments and write it once.
+ * @param file Open file handle (entry is updated)
+ * @param iov Segments to write, in order
+ * @param count Number of segments
+ * @param offset Byte offset within file
+ * @return Number of bytes written, or negative error code on failure
+ */
+ssize_t fat32_file_writev(fat32_file_t *file, const vfs_iovec_t *iov, int count,
+                          size_t offset);
+
 /**
  * Truncate or extend a file
  * @param fs Filesystem state
@@ -457,6 +655,30 @@ ssize_t fat32_write_file(fat32_fs_t *fs, fat32_dir_entry_t *entry,
 int fat32_truncate_file(fat32_fs_t *fs, fat32_dir_entry_t *entry,
                         uint32_t parent_cluster, uint32_t new_size);
 
+/**
+ * Truncate an open file, keeping its extent map current
+ * @param file Open file handle (entry is updated)
+ * @param new_size New file size
+ * @return 0 on success, negative error code on failure
+ */
+int fat32_file_truncate(fat32_file_t *file, uint32_t new_size);
+
+/**
+ * Write out an open file's delayed data and its directory entry
+ * Blocks may remain dirty in the buffer cache.
+ * @param file Open file handle
+ * @return 0 on success, negative error code on failure
+ */
+int fat32_file_flush(fat32_file_t *file);
+
+/**
+ * Make an open file durable (fsync)
+ * Flushes the file, then the FAT, FSInfo and the block device.
+ * @param file Open file handle
+ * @return 0 on success, negative error code on failure
+ */
+int fat32_file_sync(fat32_file_t *file);
+
 /*============================================================================
  * FAT32 VFS Integration
  *============================================================================*/
@@ -471,6 +693,26 @@ int fat32_vfs_open(vfs_node_t *node, int flags);
  */
 int fat32_vfs_close(vfs_node_t *node);
 
+/**
+ * VFS truncate callback
+ */
+int fat32_vfs_truncate(vfs_node_t *node, uint64_t size);
+
+/**
+ * VFS sync callback (fsync)
+ */
+int fat32_vfs_sync(vfs_node_t *node);
+
+/**
+ * VFS filesystem sync callback
+ */
+int fat32_vfs_sync_fs(vfs_mount_t *mount);
+
+/**
+ * VFS statfs callback (buf is a fat32_statfs_t)
+ */
+int fat32_vfs_statfs(vfs_mount_t *mount, void *buf);
+
 /**
  * VFS read callback
  */
@@ -481,6 +723,18 @@ ssize_t fat32_vfs_read(vfs_node_t *node, void *buf, size_t size, uint64_t offset
  */
 ssize_t fat32_vfs_write(vfs_node_t *node, const void *buf, size_t size, uint64_t offset);
 
+/**
+ * VFS vectored read callback
+ */
+ssize_t fat32_vfs_readv(vfs_node_t *node, const vfs_iovec_t *iov, int iovcnt,
+                        uint64_t offset);
+
+/**
+ * VFS vectored write callback
+ */
+ssize_t fat32_vfs_writev(vfs_node_t *node, const vfs_iovec_t *iov, int iovcnt,
+                         uint64_t offset);
+
 /**
  * VFS readdir callback
  */
@@ -605,13 +859,23 @@ uint8_t fat32_short_name_checksum(const char *short_name);
  */
 int fat32_sync(fat32_fs_t *fs);
 
+/**
+ * Write out delayed data that has been pending for at least min_age_ms
+ * If any open file's delayed data is that old, the volume is synced.
+ * The block cache's write-back thread does this every interval with
+ * FAT32_DELALLOC_AGE_MS.
+ * @param fs Filesystem state
+ * @param min_age_ms Minimum age of the pending data in milliseconds
+ * @return 0 on success, negative error code on failure
+ */
+int fat32_writeback(fat32_fs_t *fs, uint64_t min_age_ms);
+
 /**
  * Get filesystem information
  * @param fs Filesystem state
- * @param total_bytes Output total size in bytes
- * @param free_bytes Output free space in bytes
+ * @param stats Output statistics (sizes and FAT cache counters)
  * @return 0 on success, negative error code on failure
  */
-int fat32_statfs(fat32_fs_t *fs, uint64_t *total_bytes, uint64_t *free_bytes);
+int fat32_statfs(fat32_fs_t *fs, fat32_statfs_t *stats);
 
 #endif /* _AAAOS_FAT32_H */
@@ -0,0 +1,466 @@
+/**
+ * AAAos procfs - Kernel Information Filesystem Implementation
+ *
+ * A single flat directory of generated files. File text is allocated from
+ * the kernel heap when a file is opened and freed on the last close.
+ */
+
+#include "procfs.h"
+#include "../../kernel/include/serial.h"
+#include "../../kernel/mm/heap.h"
+#include "../../drivers/storage/blkdev.h"
+#include "../../drivers/storage/bio.h"
+
+/*============================================================================
+ * VFS Operations Table
+ *============================================================================*/
+
+static vfs_ops_t procfs_vfs_ops = {
+    .open       = procfs_vfs_open,
+    .close      = procfs_vfs_close,
+    .read       = procfs_vfs_read,
+    .write      = NULL,     /* Read-only */
+    .truncate   = NULL,
+    .sync       = NULL,
+    .readdir    = procfs_vfs_readdir,
+    .finddir    = procfs_vfs_finddir,
+    .mkdir      = NULL,
+    .rmdir      = NULL,
+    .create     = NULL,
+    .unlink     = NULL,
+    .rename     = NULL,
+    .stat       = procfs_vfs_stat,
+    .chmod      = NULL,
+    .chown      = NULL,
+    .mount      = procfs_vfs_mount,
+    .unmount    = procfs_vfs_unmount,
+    .sync_fs    = NULL,
+    .statfs     = NULL
+};
+
+/* Root directory is inode 1, files follow */
+#define PROCFS_ROOT_INO     1
+
+static procfs_entry_t procfs_entries[PROCFS_MAX_ENTRIES];
+static uint64_t procfs_next_ino = PROCFS_ROOT_INO + 1;
+static volatile int procfs_lock = 0;
+
+/*============================================================================
+ * String/Memory Utility Functions
+ *============================================================================*/
+
+static void procfs_memset(void *dest, uint8_t val, size_t n) {
+    uint8_t *d = (uint8_t *)dest;
+    while (n--) {
+        *d++ = val;
+    }
+}
+
+static void procfs_memcpy(void *dest, const void *src, size_t n) {
+    uint8_t *d = (uint8_t *)dest;
+    const uint8_t *s = (const uint8_t *)src;
+    while (n--) {
+        *d++ = *s++;
+    }
+}
+
+static size_t procfs_strlen(const char *s) {
+    size_t len = 0;
+    while (*s++) len++;
+    return len;
+}
+
+static int procfs_strcmp(const char *s1, const char *s2) {
+    while (*s1 && (*s1 == *s2)) {
+        s1++;
+        s2++;
+    }
+    return *(unsigned char *)s1 - *(unsigned char *)s2;
+}
+
+/*============================================================================
+ * Locking
+ *============================================================================*/
+
+static inline void spinlock_acquire(volatile int *lock) {
+    while (__sync_lock_test_and_set(lock, 1)) {
+        __asm__ volatile("pause");
+    }
+}
+
+static inline void spinlock_release(volatile int *lock) {
+    __sync_lock_release(lock);
+}
+
+/*============================================================================
+ * Built-in Files
+ *============================================================================*/
+
+/**
+ * diskstats: statistics of every registered block device
+ */
+static size_t procfs_show_diskstats(void *data, char *buf, size_t size) {
+    UNUSED(data);
+    size_t len = 0;
+
+    buf[0] = '\0';
+    for (int i = 0; i < BLKDEV_MAX_DEVICES && len + 1 < size; i++) {
+        block_device_t *dev = blkdev_get(i);
+        if (!dev || !dev->queue) {
+            continue;
+        }
+        len += blk_stats_show(dev, buf + len, size - len);
+    }
+    return len;
+}
+
+/*============================================================================
+ * Helper Functions
+ *============================================================================*/
+
+/**
+ * Find a registered file (lock held)
+ */
+static procfs_entry_t* procfs_find(const char *name) {
+    for (int i = 0; i < PROCFS_MAX_ENTRIES; i++) {
+        if (procfs_entries[i].in_use && procfs_strcmp(procfs_entries[i].name, name) == 0) {
+            return &procfs_entries[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Run a file's show callback, growing the buffer until the text fits
+ */
+static int procfs_generate(procfs_entry_t *entry, char **text, size_t *len) {
+    size_t size = PAGE_SIZE;
+
+    for (;;) {
+        char *buf = kmalloc(size);
+        if (!buf) {
+            return VFS_ERR_NOMEM;
+        }
+
+        size_t n = entry->show(entry->data, buf, size);
+        if (n + 1 < size || size >= PROCFS_MAX_SIZE) {
+            *text = buf;
+            *len = MIN(n, size - 1);
+            return VFS_OK;
+        }
+
+        kfree(buf);
+        size *= 2;
+    }
+}
+
+/*============================================================================
+ * Public API
+ *============================================================================*/
+
+int procfs_init(void) {
+    int result = vfs_register_fs("procfs", &procfs_vfs_ops);
+    if (result != VFS_OK) {
+        kprintf("[PROCFS] Failed to register with VFS: %d\n", result);
+        return result;
+    }
+
+    procfs_register("diskstats", procfs_show_diskstats, NULL);
+
+    kprintf("[PROCFS] procfs driver registered successfully\n");
+    return VFS_OK;
+}
+
+int procfs_mount_proc(void) {
+    return vfs_mount(PROCFS_MOUNT_POINT, "procfs", NULL);
+}
+
+int procfs_register(const char *name, procfs_show_t show, void *data) {
+    if (!name || !show) {
+        return VFS_ERR_INVAL;
+    }
+
+    size_t len = procfs_strlen(name);
+    if (len == 0 || len >= PROCFS_NAME_MAX) {
+        return VFS_ERR_INVAL;
+    }
+
+    spinlock_acquire(&procfs_lock);
+
+    if (procfs_find(name)) {
+        spinlock_release(&procfs_lock);
+        return VFS_ERR_EXIST;
+    }
+
+    /* Slots of removed files stay busy while their snapshot is open */
+    for (int i = 0; i < PROCFS_MAX_ENTRIES; i++) {
+        procfs_entry_t *entry = &procfs_entries[i];
+        if (entry->in_use || entry->open_count > 0) {
+            continue;
+        }
+
+        procfs_memset(entry, 0, sizeof(*entry));
+        procfs_memcpy(entry->name, name, len + 1);
+        entry->show = show;
+        entry->data = data;
+        entry->ino = procfs_next_ino++;
+        entry->in_use = true;
+
+        spinlock_release(&procfs_lock);
+        return VFS_OK;
+    }
+
+    spinlock_release(&procfs_lock);
+    return VFS_ERR_NOSPC;
+}
+
+int procfs_unregister(const char *name) {
+    if (!name) {
+        return VFS_ERR_INVAL;
+    }
+
+    spinlock_acquire(&procfs_lock);
+
+    procfs_entry_t *entry = procfs_find(name);
+    if (!entry) {
+        spinlock_release(&procfs_lock);
+        return VFS_ERR_NOENT;
+    }
+
+    entry->in_use = false;
+    char *text = NULL;
+    if (entry->open_count == 0) {
+        text = entry->text;
+        entry->text = NULL;
+    }
+
+    spinlock_release(&procfs_lock);
+
+    if (text) {
+        kfree(text);
+    }
+    return VFS_OK;
+}
+
+/*============================================================================
+ * VFS Integration Callbacks
+ *============================================================================*/
+
+int procfs_vfs_open(vfs_node_t *node, int flags) {
+    if (!node) {
+        return VFS_ERR_INVAL;
+    }
+
+    procfs_entry_t *entry = (procfs_entry_t *)node->fs_data;
+    if (!entry) {
+        return VFS_OK;      /* Root directory */
+    }
+
+    if ((flags & VFS_O_RDWR) != VFS_O_RDONLY) {
+        return VFS_ERR_ROFS;
+    }
+
+    spinlock_acquire(&procfs_lock);
+    if (!entry->in_use) {
+        spinlock_release(&procfs_lock);
+        return VFS_ERR_NOENT;
+    }
+    bool first = entry->open_count++ == 0;
+    spinlock_release(&procfs_lock);
+
+    /* The first opener takes the snapshot; later ones share it */
+    if (first) {
+        char *text = NULL;
+        size_t len = 0;
+        int result = procfs_generate(entry, &text, &len);
+
+        spinlock_acquire(&procfs_lock);
+        if (result != VFS_OK) {
+            entry->open_count--;
+            spinlock_release(&procfs_lock);
+            return result;
+        }
+        char *old = entry->text;
+        entry->text = text;
+        entry->len = len;
+        spinlock_release(&procfs_lock);
+
+        if (old) {
+            kfree(old);
+        }
+    }
+
+    node->size = entry->len;
+    return VFS_OK;
+}
+
+int procfs_vfs_close(vfs_node_t *node) {
+    if (!node) {
+        return VFS_ERR_INVAL;
+    }
+
+    procfs_entry_t *entry = (procfs_entry_t *)node->fs_data;
+    if (!entry) {
+        return VFS_OK;
+    }
+
+    char *text = NULL;
+
+    spinlock_acquire(&procfs_lock);
+    if (entry->open_count > 0 && --entry->open_count == 0) {
+        text = entry->text;
+        entry->text = NULL;
+        entry->len = 0;
+    }
+    spinlock_release(&procfs_lock);
+
+    if (text) {
+        kfree(text);
+    }
+    return VFS_OK;
+}
+
+ssize_t procfs_vfs_read(vfs_node_t *node, void *buf, size_t size, uint64_t offset) {
+    if (!node || !buf) {
+        return VFS_ERR_INVAL;
+    }
+
+    procfs_entry_t *entry = (procfs_entry_t *)node->fs_data;
+    if (!entry) {
+        return VFS_ERR_ISDIR;
+    }
+
+    spinlock_acquire(&procfs_lock);
+
+    if (!entry->text || offset >= entry->len) {
+        spinlock_release(&procfs_lock);
+        return 0;
+    }
+
+    size = MIN(size, entry->len - offset);
+    procfs_memcpy(buf, entry->text + offset, size);
+
+    spinlock_release(&procfs_lock);
+    return size;
+}
+
+vfs_dirent_t* procfs_vfs_readdir(vfs_node_t *dir, uint32_t index) {
+    if (!dir || dir->fs_data || dir->type != VFS_NODE_DIRECTORY) {
+        return NULL;
+    }
+
+    static vfs_dirent_t dirent;
+    vfs_dirent_t *result = NULL;
+
+    spinlock_acquire(&procfs_lock);
+
+    for (int i = 0; i < PROCFS_MAX_ENTRIES; i++) {
+        procfs_entry_t *entry = &procfs_entries[i];
+        if (!entry->in_use) {
+            continue;
+        }
+        if (index-- > 0) {
+            continue;
+        }
+
+        dirent.d_ino = entry->ino;
+        dirent.d_type = VFS_NODE_FILE;
+        procfs_memcpy(dirent.d_name, entry->name, procfs_strlen(entry->name) + 1);
+        result = &dirent;
+        break;
+    }
+
+    spinlock_release(&procfs_lock);
+    return result;
+}
+
+vfs_node_t* procfs_vfs_finddir(vfs_node_t *dir, const char *name) {
+    if (!dir || !name || dir->fs_data || dir->type != VFS_NODE_DIRECTORY) {
+        return NULL;
+    }
+
+    spinlock_acquire(&procfs_lock);
+    procfs_entry_t *entry = procfs_find(name);
+    spinlock_release(&procfs_lock);
+
+    if (!entry) {
+        return NULL;
+    }
+
+    vfs_node_t *node = vfs_alloc_node();
+    if (!node) {
+        return NULL;
+    }
+
+    size_t len = procfs_strlen(name);
+    procfs_memcpy(node->name, name, len + 1);
+    node->type = VFS_NODE_FILE;
+    node->permissions = VFS_S_IRUSR | VFS_S_IRGRP | VFS_S_IROTH;
+    node->inode = entry->ino;
+    node->size = 0;         /* Known once opened */
+    node->nlink = 1;
+    node->mount = dir->mount;
+    node->parent = dir;
+    node->fs_data = entry;
+
+    return node;
+}
+
+int procfs_vfs_stat(vfs_node_t *node, vfs_stat_t *stat) {
+    if (!node || !stat) {
+        return VFS_ERR_INVAL;
+    }
+
+    procfs_memset(stat, 0, sizeof(vfs_stat_t));
+    stat->st_ino = node->inode;
+    stat->st_mode = node->permissions;
+    stat->st_nlink = node->nlink;
+    stat->st_size = node->size;
+    stat->st_blksize = PAGE_SIZE;
+    stat->st_type = node->type;
+
+    return VFS_OK;
+}
+
+int procfs_vfs_mount(vfs_mount_t *mount, void *device) {
+    UNUSED(device);
+
+    if (!mount) {
+        return VFS_ERR_INVAL;
+    }
+
+    vfs_node_t *root = vfs_alloc_node();
+    if (!root) {
+        return VFS_ERR_NOMEM;
+    }
+
+    root->name[0] = '/';
+    root->name[1] = '\0';
+    root->type = VFS_NODE_DIRECTORY;
+    root->permissions = VFS_S_IRUSR | VFS_S_IXUSR | VFS_S_IRGRP | VFS_S_IXGRP |
+                        VFS_S_IROTH | VFS_S_IXOTH;
+    root->inode = PROCFS_ROOT_INO;
+    root->nlink = 2;
+    root->mount = mount;
+    root->fs_data = NULL;
+
+    mount->root = root;
+    mount->fs_data = NULL;
+    mount->readonly = true;
+
+    kprintf("[PROCFS] Mounted at %s\n", mount->path);
+    return VFS_OK;
+}
+
+int procfs_vfs_unmount(vfs_mount_t *mount) {
+    if (!mount) {
+        return VFS_ERR_INVAL;
+    }
+
+    if (mount->root) {
+        vfs_free_node(mount->root);
+        mount->root = NULL;
+    }
+
+    return VFS_OK;
+}
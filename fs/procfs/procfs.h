@@ -0,0 +1,141 @@
+/**
+ * AAAos procfs - Kernel Information Filesystem
+ *
+ * A read-only filesystem registered with the VFS as "procfs" and usually
+ * mounted at /proc. Each file is backed by a show callback that formats
+ * kernel state as text:
+ * - The text is generated when the file is first opened and kept until
+ *   the last handle is closed, so reads see one consistent snapshot
+ * - Subsystems add files with procfs_register()
+ *
+ * Built-in files:
+ *   diskstats   Block device I/O counters and latency histograms
+ */
+
+#ifndef _AAAOS_PROCFS_H
+#define _AAAOS_PROCFS_H
+
+#include "../../kernel/include/types.h"
+#include "../vfs/vfs.h"
+
+/*============================================================================
+ * procfs Constants
+ *============================================================================*/
+
+/* Default mount point */
+#define PROCFS_MOUNT_POINT          "/proc"
+
+#define PROCFS_MAX_ENTRIES          32      /* Files in the procfs root */
+#define PROCFS_NAME_MAX             32      /* File name length */
+#define PROCFS_MAX_SIZE             (256 * KB)  /* Largest file text */
+
+/*============================================================================
+ * procfs Structures
+ *============================================================================*/
+
+/**
+ * Format a file's contents
+ * @param data Cookie given to procfs_register
+ * @param buf Destination (must be NUL-terminated, truncated to fit)
+ * @param size Size of buf
+ * @return Length of the text; a result of size - 1 or more is taken as
+ *         truncated and the callback is retried with a larger buffer
+ */
+typedef size_t (*procfs_show_t)(void *data, char *buf, size_t size);
+
+/**
+ * procfs file
+ */
+typedef struct procfs_entry {
+    char                    name[PROCFS_NAME_MAX];
+    procfs_show_t           show;           /* Content generator */
+    void                    *data;          /* Cookie for show */
+    uint64_t                ino;            /* Inode number */
+
+    /* Snapshot shared by all open handles */
+    char                    *text;
+    size_t                  len;
+    uint32_t                open_count;
+
+    bool                    in_use;
+} procfs_entry_t;
+
+/*============================================================================
+ * procfs Public API
+ *============================================================================*/
+
+/**
+ * Register the procfs filesystem type and the built-in files
+ * @return VFS_OK on success, negative error code on failure
+ */
+int procfs_init(void);
+
+/**
+ * Mount procfs at PROCFS_MOUNT_POINT
+ * @return VFS_OK on success, negative error code on failure
+ */
+int procfs_mount_proc(void);
+
+/**
+ * Add a file to the procfs root
+ * @param name File name
+ * @param show Content generator
+ * @param data Cookie passed to show
+ * @return VFS_OK on success, VFS_ERR_EXIST if the name is taken,
+ *         VFS_ERR_NOSPC if the table is full, VFS_ERR_INVAL otherwise
+ */
+int procfs_register(const char *name, procfs_show_t show, void *data);
+
+/**
+ * Remove a file from the procfs root
+ * Open handles keep their snapshot until closed.
+ * @param name File name
+ * @return VFS_OK on success, VFS_ERR_NOENT if not found
+ */
+int procfs_unregister(const char *name);
+
+/*============================================================================
+ * procfs VFS Integration
+ *============================================================================*/
+
+/**
+ * VFS open callback (generates the file's snapshot)
+ */
+int procfs_vfs_open(vfs_node_t *node, int flags);
+
+/**
+ * VFS close callback
+ */
+int procfs_vfs_close(vfs_node_t *node);
+
+/**
+ * VFS read callback
+ */
+ssize_t procfs_vfs_read(vfs_node_t *node, void *buf, size_t size, uint64_t offset);
+
+/**
+ * VFS readdir callback
+ */
+vfs_dirent_t* procfs_vfs_readdir(vfs_node_t *dir, uint32_t index);
+
+/**
+ * VFS finddir callback
+ */
+vfs_node_t* procfs_vfs_finddir(vfs_node_t *dir, const char *name);
+
+/**
+ * VFS stat callback
+ */
+int procfs_vfs_stat(vfs_node_t *node, vfs_stat_t *stat);
+
+/**
+ * VFS mount callback (device is unused)
+ */
+int procfs_vfs_mount(vfs_mount_t *mount, void *device);
+
+/**
+ * VFS unmount callback
+ */
+int procfs_vfs_unmount(vfs_mount_t *mount);
+
+#endif /* _AAAOS_PROCFS_H */
@@ -0,0 +1,880 @@
+/**
+ * AAAos tmpfs - In-Memory Filesystem Implementation
+ *
+ * Inodes and directory entries come from the kernel heap; file data pages
+ * come from the PMM and are accessed through the kernel physical map.
+ */
+
+#include "tmpfs.h"
+#include "../../kernel/include/serial.h"
+#include "../../kernel/mm/pmm.h"
+#include "../../kernel/mm/vmm.h"
+#include "../../kernel/mm/heap.h"
+
+/*============================================================================
+ * VFS Operations Table
+ *============================================================================*/
+
+static vfs_ops_t tmpfs_vfs_ops = {
+    .open       = tmpfs_vfs_open,
+    .close      = tmpfs_vfs_close,
+    .read       = tmpfs_vfs_read,
+    .write      = tmpfs_vfs_write,
+    .truncate   = tmpfs_vfs_truncate,
+    .sync       = NULL,     /* Nothing to write back */
+    .readdir    = tmpfs_vfs_readdir,
+    .finddir    = tmpfs_vfs_finddir,
+    .mkdir      = tmpfs_vfs_mkdir,
+    .rmdir      = tmpfs_vfs_rmdir,
+    .create     = tmpfs_vfs_create,
+    .unlink     = tmpfs_vfs_unlink,
+    .rename     = tmpfs_vfs_rename,
+    .stat       = tmpfs_vfs_stat,
+    .chmod      = tmpfs_vfs_chmod,
+    .chown      = NULL,
+    .release    = tmpfs_vfs_release,
+    .mount      = tmpfs_vfs_mount,
+    .unmount    = tmpfs_vfs_unmount,
+    .sync_fs    = NULL,
+    .statfs     = tmpfs_vfs_statfs
+};
+
+/*============================================================================
+ * String/Memory Utility Functions
+ *============================================================================*/
+
+static void tmpfs_memset(void *dest, uint8_t val, size_t n) {
+    uint8_t *d = (uint8_t *)dest;
+    while (n--) {
+        *d++ = val;
+    }
+}
+
+static void tmpfs_memcpy(void *dest, const void *src, size_t n) {
+    uint8_t *d = (uint8_t *)dest;
+    const uint8_t *s = (const uint8_t *)src;
+    while (n--) {
+        *d++ = *s++;
+    }
+}
+
+static size_t tmpfs_strlen(const char *s) {
+    size_t len = 0;
+    while (*s++) len++;
+    return len;
+}
+
+static int tmpfs_strcmp(const char *s1, const char *s2) {
+    while (*s1 && (*s1 == *s2)) {
+        s1++;
+        s2++;
+    }
+    return *(unsigned char *)s1 - *(unsigned char *)s2;
+}
+
+/*============================================================================
+ * Locking
+ *============================================================================*/
+
+static inline void spinlock_acquire(volatile int *lock) {
+    while (__sync_lock_test_and_set(lock, 1)) {
+        __asm__ volatile("pause");
+    }
+}
+
+static inline void spinlock_release(volatile int *lock) {
+    __sync_lock_release(lock);
+}
+
+/*============================================================================
+ * Inode Management
+ *============================================================================*/
+
+static tmpfs_inode_t* tmpfs_alloc_inode(tmpfs_sb_t *sb, vfs_node_type_t type,
+                                        uint32_t permissions) {
+    if (sb->used_inodes >= sb->max_inodes) {
+        return NULL;
+    }
+
+    tmpfs_inode_t *inode = kmalloc(sizeof(tmpfs_inode_t));
+    if (!inode) {
+        return NULL;
+    }
+
+    tmpfs_memset(inode, 0, sizeof(tmpfs_inode_t));
+    inode->ino = sb->next_ino++;
+    inode->type = type;
+    inode->permissions = permissions;
+    inode->sb = sb;
+    sb->used_inodes++;
+
+    return inode;
+}
+
+/**
+ * Release data pages from page index `first` onwards
+ */
+static void tmpfs_free_pages_from(tmpfs_inode_t *inode, uint32_t first) {
+    for (uint32_t i = first; i < inode->page_slots; i++) {
+        if (inode->pages[i]) {
+            pmm_free_page((physaddr_t)inode->pages[i] - VMM_KERNEL_PHYS_MAP);
+            inode->pages[i] = NULL;
+            inode->page_count--;
+            inode->sb->used_pages--;
+        }
+    }
+}
+
+/**
+ * Free an inode once it is neither linked, open nor named by a VFS node
+ */
+static void tmpfs_put_inode(tmpfs_inode_t *inode) {
+    if (inode->nlink > 0 || inode->open_count > 0 || inode->node_count > 0) {
+        return;
+    }
+
+    tmpfs_free_pages_from(inode, 0);
+    if (inode->pages) {
+        kfree(inode->pages);
+    }
+
+    inode->sb->used_pages -= inode->table_pages;
+    inode->sb->used_inodes--;
+    kfree(inode);
+}
+
+/**
+ * Make sure the page table covers page index `index`
+ *
+ * The table is charged to the mount in whole pages, so a sparse file with
+ * a far offset cannot grow it past the limit without allocating any data.
+ * @return true on success
+ */
+static bool tmpfs_reserve_slots(tmpfs_inode_t *inode, uint32_t index) {
+    tmpfs_sb_t *sb = inode->sb;
+
+    if (index < inode->page_slots) {
+        return true;
+    }
+
+    uint32_t slots = inode->page_slots ? inode->page_slots : 16;
+    while (slots <= index) {
+        slots *= 2;
+    }
+
+    uint32_t table_pages = (uint32_t)((slots * sizeof(uint8_t *) + PAGE_SIZE - 1) / PAGE_SIZE);
+    if (sb->used_pages - inode->table_pages + table_pages > sb->max_pages) {
+        return false;
+    }
+
+    uint8_t **pages = kmalloc(slots * sizeof(uint8_t *));
+    if (!pages) {
+        return false;
+    }
+
+    tmpfs_memset(pages, 0, slots * sizeof(uint8_t *));
+    if (inode->pages) {
+        tmpfs_memcpy(pages, inode->pages, inode->page_slots * sizeof(uint8_t *));
+        kfree(inode->pages);
+    }
+
+    inode->pages = pages;
+    inode->page_slots = slots;
+    sb->used_pages += table_pages - inode->table_pages;
+    inode->table_pages = table_pages;
+    return true;
+}
+
+/**
+ * Get the data page at `index`, allocating it if it is a hole
+ * @return Page, or NULL if the mount limit is reached or memory is short
+ */
+static uint8_t* tmpfs_get_page(tmpfs_inode_t *inode, uint32_t index) {
+    tmpfs_sb_t *sb = inode->sb;
+
+    if (!tmpfs_reserve_slots(inode, index)) {
+        return NULL;
+    }
+    if (inode->pages[index]) {
+        return inode->pages[index];
+    }
+
+    if (sb->used_pages >= sb->max_pages) {
+        return NULL;
+    }
+
+    physaddr_t phys = pmm_alloc_page();
+    if (!phys) {
+        return NULL;
+    }
+
+    uint8_t *page = (uint8_t *)(phys + VMM_KERNEL_PHYS_MAP);
+    tmpfs_memset(page, 0, PAGE_SIZE);
+    inode->pages[index] = page;
+    inode->page_count++;
+    sb->used_pages++;
+    return page;
+}
+
+/**
+ * Change a file's size, releasing pages past the new end
+ */
+static void tmpfs_resize(tmpfs_inode_t *inode, uint64_t size) {
+    if (size < inode->size) {
+        uint32_t keep = (uint32_t)((size + PAGE_SIZE - 1) / PAGE_SIZE);
+        tmpfs_free_pages_from(inode, keep);
+
+        /* Zero the tail of the last page so a later extension reads zeros */
+        uint32_t tail = size % PAGE_SIZE;
+        if (tail && keep - 1 < inode->page_slots && inode->pages[keep - 1]) {
+            tmpfs_memset(inode->pages[keep - 1] + tail, 0, PAGE_SIZE - tail);
+        }
+    }
+
+    inode->size = size;
+}
+
+/**
+ * Free a directory tree (unmount)
+ */
+static void tmpfs_destroy_tree(tmpfs_inode_t *dir) {
+    tmpfs_dirent_t *entry = dir->entries;
+
+    while (entry) {
+        tmpfs_dirent_t *next = entry->next;
+        tmpfs_inode_t *inode = entry->inode;
+
+        if (inode->type == VFS_NODE_DIRECTORY) {
+            tmpfs_destroy_tree(inode);
+        }
+        inode->nlink = 0;
+        inode->open_count = 0;
+        inode->node_count = 0;
+        tmpfs_put_inode(inode);
+        kfree(entry);
+        entry = next;
+    }
+
+    dir->entries = NULL;
+    dir->entry_count = 0;
+}
+
+/*============================================================================
+ * Directory Operations
+ *============================================================================*/
+
+static tmpfs_dirent_t* tmpfs_find_entry(tmpfs_inode_t *dir, const char *name,
+                                        tmpfs_dirent_t **out_prev) {
+    tmpfs_dirent_t *prev = NULL;
+
+    for (tmpfs_dirent_t *entry = dir->entries; entry; entry = entry->next) {
+        if (tmpfs_strcmp(entry->name, name) == 0) {
+            if (out_prev) {
+                *out_prev = prev;
+            }
+            return entry;
+        }
+        prev = entry;
+    }
+
+    return NULL;
+}
+
+static void tmpfs_unlink_entry(tmpfs_inode_t *dir, tmpfs_dirent_t *entry,
+                               tmpfs_dirent_t *prev) {
+    if (prev) {
+        prev->next = entry->next;
+    } else {
+        dir->entries = entry->next;
+    }
+    dir->entry_count--;
+}
+
+static void tmpfs_link_entry(tmpfs_inode_t *dir, tmpfs_dirent_t *entry) {
+    entry->next = dir->entries;
+    dir->entries = entry;
+    dir->entry_count++;
+}
+
+/**
+ * Create a new inode and link it into a directory
+ */
+static int tmpfs_create_node(vfs_node_t *parent, const char *name, vfs_node_type_t type,
+                             uint32_t permissions) {
+    if (!parent || !name || !parent->fs_data || parent->type != VFS_NODE_DIRECTORY) {
+        return VFS_ERR_INVAL;
+    }
+
+    size_t len = tmpfs_strlen(name);
+    if (len == 0) {
+        return VFS_ERR_INVAL;
+    }
+    if (len > VFS_NAME_MAX) {
+        return VFS_ERR_NAMETOOLONG;
+    }
+
+    tmpfs_inode_t *dir = (tmpfs_inode_t *)parent->fs_data;
+    tmpfs_sb_t *sb = dir->sb;
+    int result = VFS_OK;
+
+    spinlock_acquire(&sb->lock);
+
+    if (tmpfs_find_entry(dir, name, NULL)) {
+        result = VFS_ERR_EXIST;
+        goto out;
+    }
+
+    tmpfs_dirent_t *entry = kmalloc(sizeof(tmpfs_dirent_t));
+    if (!entry) {
+        result = VFS_ERR_NOMEM;
+        goto out;
+    }
+
+    tmpfs_inode_t *inode = tmpfs_alloc_inode(sb, type, permissions);
+    if (!inode) {
+        kfree(entry);
+        result = VFS_ERR_NOSPC;
+        goto out;
+    }
+
+    tmpfs_memcpy(entry->name, name, len + 1);
+    entry->inode = inode;
+    inode->nlink = 1;
+    inode->parent = (type == VFS_NODE_DIRECTORY) ? dir : NULL;
+    tmpfs_link_entry(dir, entry);
+
+out:
+    spinlock_release(&sb->lock);
+    return result;
+}
+
+/*============================================================================
+ * Public API
+ *============================================================================*/
+
+int tmpfs_init(void) {
+    int result = vfs_register_fs("tmpfs", &tmpfs_vfs_ops);
+    if (result != VFS_OK) {
+        kprintf("[TMPFS] Failed to register with VFS: %d\n", result);
+        return result;
+    }
+
+    kprintf("[TMPFS] tmpfs driver registered successfully\n");
+    return VFS_OK;
+}
+
+int tmpfs_mount_tmp(void) {
+    return vfs_mount(TMPFS_MOUNT_POINT, "tmpfs", NULL);
+}
+
+/*============================================================================
+ * VFS Integration Callbacks
+ *============================================================================*/
+
+int tmpfs_vfs_open(vfs_node_t *node, int flags) {
+    UNUSED(flags);
+
+    if (!node || !node->fs_data) {
+        return VFS_ERR_INVAL;
+    }
+
+    tmpfs_inode_t *inode = (tmpfs_inode_t *)node->fs_data;
+    spinlock_acquire(&inode->sb->lock);
+    inode->open_count++;
+    node->size = inode->size;
+    spinlock_release(&inode->sb->lock);
+
+    return VFS_OK;
+}
+
+int tmpfs_vfs_close(vfs_node_t *node) {
+    if (!node || !node->fs_data) {
+        return VFS_ERR_INVAL;
+    }
+
+    tmpfs_inode_t *inode = (tmpfs_inode_t *)node->fs_data;
+    tmpfs_sb_t *sb = inode->sb;
+
+    spinlock_acquire(&sb->lock);
+    if (inode->open_count > 0) {
+        inode->open_count--;
+    }
+
+    /* An unlinked file outlives its last close until its nodes are released */
+    tmpfs_put_inode(inode);
+    spinlock_release(&sb->lock);
+
+    return VFS_OK;
+}
+
+ssize_t tmpfs_vfs_read(vfs_node_t *node, void *buf, size_t size, uint64_t offset) {
+    if (!node || !buf || !node->fs_data) {
+        return VFS_ERR_INVAL;
+    }
+
+    tmpfs_inode_t *inode = (tmpfs_inode_t *)node->fs_data;
+    if (inode->type != VFS_NODE_FILE) {
+        return VFS_ERR_ISDIR;
+    }
+
+    spinlock_acquire(&inode->sb->lock);
+
+    if (offset >= inode->size) {
+        spinlock_release(&inode->sb->lock);
+        return 0;
+    }
+
+    size = MIN(size, inode->size - offset);
+    uint8_t *dst = (uint8_t *)buf;
+    size_t done = 0;
+
+    while (done < size) {
+        uint64_t pos = offset + done;
+        uint32_t index = (uint32_t)(pos / PAGE_SIZE);
+        uint32_t page_off = pos % PAGE_SIZE;
+        size_t chunk = MIN(size - done, (size_t)(PAGE_SIZE - page_off));
+
+        /* Holes read as zeros */
+        if (index < inode->page_slots && inode->pages[index]) {
+            tmpfs_memcpy(dst + done, inode->pages[index] + page_off, chunk);
+        } else {
+            tmpfs_memset(dst + done, 0, chunk);
+        }
+        done += chunk;
+    }
+
+    spinlock_release(&inode->sb->lock);
+    return done;
+}
+
+ssize_t tmpfs_vfs_write(vfs_node_t *node, const void *buf, size_t size, uint64_t offset) {
+    if (!node || !buf || !node->fs_data) {
+        return VFS_ERR_INVAL;
+    }
+
+    tmpfs_inode_t *inode = (tmpfs_inode_t *)node->fs_data;
+    if (inode->type != VFS_NODE_FILE) {
+        return VFS_ERR_ISDIR;
+    }
+    if (offset >= TMPFS_MAX_FILE_SIZE) {
+        return VFS_ERR_FBIG;
+    }
+
+    size = MIN(size, TMPFS_MAX_FILE_SIZE - offset);
+    const uint8_t *src = (const uint8_t *)buf;
+    size_t done = 0;
+
+    spinlock_acquire(&inode->sb->lock);
+
+    while (done < size) {
+        uint64_t pos = offset + done;
+        uint32_t page_off = pos % PAGE_SIZE;
+        size_t chunk = MIN(size - done, (size_t)(PAGE_SIZE - page_off));
+
+        uint8_t *page = tmpfs_get_page(inode, (uint32_t)(pos / PAGE_SIZE));
+        if (!page) {
+            break;
+        }
+
+        tmpfs_memcpy(page + page_off, src + done, chunk);
+        done += chunk;
+    }
+
+    if (offset + done > inode->size) {
+        inode->size = offset + done;
+    }
+    node->size = inode->size;
+
+    spinlock_release(&inode->sb->lock);
+
+    if (done == 0 && size > 0) {
+        return VFS_ERR_NOSPC;
+    }
+    return done;
+}
+
+int tmpfs_vfs_truncate(vfs_node_t *node, uint64_t size) {
+    if (!node || !node->fs_data) {
+        return VFS_ERR_INVAL;
+    }
+
+    tmpfs_inode_t *inode = (tmpfs_inode_t *)node->fs_data;
+    if (inode->type != VFS_NODE_FILE) {
+        return VFS_ERR_ISDIR;
+    }
+    if (size > TMPFS_MAX_FILE_SIZE) {
+        return VFS_ERR_FBIG;
+    }
+
+    /* Growing only moves the end; the new range is a hole */
+    spinlock_acquire(&inode->sb->lock);
+    tmpfs_resize(inode, size);
+    node->size = size;
+    spinlock_release(&inode->sb->lock);
+
+    return VFS_OK;
+}
+
+vfs_dirent_t* tmpfs_vfs_readdir(vfs_node_t *dir, uint32_t index) {
+    if (!dir || !dir->fs_data || dir->type != VFS_NODE_DIRECTORY) {
+        return NULL;
+    }
+
+    static vfs_dirent_t dirent;
+
+    tmpfs_inode_t *inode = (tmpfs_inode_t *)dir->fs_data;
+    vfs_dirent_t *result = NULL;
+
+    spinlock_acquire(&inode->sb->lock);
+
+    tmpfs_dirent_t *entry = inode->entries;
+    while (entry && index > 0) {
+        entry = entry->next;
+        index--;
+    }
+
+    if (entry) {
+        dirent.d_ino = entry->inode->ino;
+        dirent.d_type = entry->inode->type;
+        tmpfs_memcpy(dirent.d_name, entry->name, tmpfs_strlen(entry->name) + 1);
+        result = &dirent;
+    }
+
+    spinlock_release(&inode->sb->lock);
+    return result;
+}
+
+vfs_node_t* tmpfs_vfs_finddir(vfs_node_t *dir, const char *name) {
+    if (!dir || !name || !dir->fs_data || dir->type != VFS_NODE_DIRECTORY) {
+        return NULL;
+    }
+
+    tmpfs_inode_t *parent = (tmpfs_inode_t *)dir->fs_data;
+    tmpfs_sb_t *sb = parent->sb;
+
+    spinlock_acquire(&sb->lock);
+    tmpfs_dirent_t *entry = tmpfs_find_entry(parent, name, NULL);
+    tmpfs_inode_t *inode = entry ? entry->inode : NULL;
+    if (inode) {
+        inode->node_count++;
+    }
+    spinlock_release(&sb->lock);
+
+    if (!inode) {
+        return NULL;
+    }
+
+    vfs_node_t *node = vfs_alloc_node();
+    if (!node) {
+        spinlock_acquire(&sb->lock);
+        inode->node_count--;
+        tmpfs_put_inode(inode);
+        spinlock_release(&sb->lock);
+        return NULL;
+    }
+
+    size_t len = tmpfs_strlen(name);
+    tmpfs_memcpy(node->name, name, len + 1);
+    node->type = inode->type;
+    node->permissions = inode->permissions;
+    node->inode = inode->ino;
+    node->size = inode->size;
+    node->nlink = inode->nlink;
+    node->mount = dir->mount;
+    node->parent = dir;
+    node->fs_data = inode;
+
+    return node;
+}
+
+int tmpfs_vfs_mkdir(vfs_node_t *parent, const char *name, uint32_t permissions) {
+    return tmpfs_create_node(parent, name, VFS_NODE_DIRECTORY, permissions);
+}
+
+int tmpfs_vfs_create(vfs_node_t *parent, const char *name, uint32_t permissions) {
+    return tmpfs_create_node(parent, name, VFS_NODE_FILE, permissions);
+}
+
+/**
+ * Remove a directory entry of the given kind
+ */
+static int tmpfs_remove(vfs_node_t *parent, const char *name, bool want_dir) {
+    if (!parent || !name || !parent->fs_data || parent->type != VFS_NODE_DIRECTORY) {
+        return VFS_ERR_INVAL;
+    }
+
+    tmpfs_inode_t *dir = (tmpfs_inode_t *)parent->fs_data;
+    tmpfs_sb_t *sb = dir->sb;
+    tmpfs_dirent_t *prev = NULL;
+    int result = VFS_OK;
+
+    spinlock_acquire(&sb->lock);
+
+    tmpfs_dirent_t *entry = tmpfs_find_entry(dir, name, &prev);
+    if (!entry) {
+        result = VFS_ERR_NOENT;
+        goto out;
+    }
+
+    tmpfs_inode_t *inode = entry->inode;
+    if (want_dir && inode->type != VFS_NODE_DIRECTORY) {
+        result = VFS_ERR_NOTDIR;
+        goto out;
+    }
+    if (!want_dir && inode->type == VFS_NODE_DIRECTORY) {
+        result = VFS_ERR_ISDIR;
+        goto out;
+    }
+    if (want_dir && inode->entry_count > 0) {
+        result = VFS_ERR_NOTEMPTY;
+        goto out;
+    }
+
+    tmpfs_unlink_entry(dir, entry, prev);
+    kfree(entry);
+    inode->nlink--;
+    tmpfs_put_inode(inode);
+
+out:
+    spinlock_release(&sb->lock);
+    return result;
+}
+
+int tmpfs_vfs_rmdir(vfs_node_t *parent, const char *name) {
+    return tmpfs_remove(parent, name, true);
+}
+
+int tmpfs_vfs_unlink(vfs_node_t *parent, const char *name) {
+    return tmpfs_remove(parent, name, false);
+}
+
+int tmpfs_vfs_rename(vfs_node_t *old_parent, const char *old_name,
+                     vfs_node_t *new_parent, const char *new_name) {
+    if (!old_parent || !new_parent || !old_name || !new_name ||
+        !old_parent->fs_data || !new_parent->fs_data) {
+        return VFS_ERR_INVAL;
+    }
+
+    size_t len = tmpfs_strlen(new_name);
+    if (len == 0) {
+        return VFS_ERR_INVAL;
+    }
+    if (len > VFS_NAME_MAX) {
+        return VFS_ERR_NAMETOOLONG;
+    }
+
+    tmpfs_inode_t *old_dir = (tmpfs_inode_t *)old_parent->fs_data;
+    tmpfs_inode_t *new_dir = (tmpfs_inode_t *)new_parent->fs_data;
+    tmpfs_sb_t *sb = old_dir->sb;
+    tmpfs_dirent_t *prev = NULL;
+    int result = VFS_OK;
+
+    spinlock_acquire(&sb->lock);
+
+    tmpfs_dirent_t *entry = tmpfs_find_entry(old_dir, old_name, &prev);
+    if (!entry) {
+        result = VFS_ERR_NOENT;
+        goto out;
+    }
+
+    tmpfs_inode_t *inode = entry->inode;
+
+    /* A directory cannot move below itself */
+    if (inode->type == VFS_NODE_DIRECTORY) {
+        for (tmpfs_inode_t *d = new_dir; d; d = d->parent) {
+            if (d == inode) {
+                result = VFS_ERR_INVAL;
+                goto out;
+            }
+        }
+    }
+
+    /* Replace an existing target of the same kind */
+    tmpfs_dirent_t *target_prev = NULL;
+    tmpfs_dirent_t *target = tmpfs_find_entry(new_dir, new_name, &target_prev);
+    if (target == entry) {
+        goto out;
+    }
+    if (target) {
+        tmpfs_inode_t *victim = target->inode;
+        if (victim->type == VFS_NODE_DIRECTORY) {
+            if (inode->type != VFS_NODE_DIRECTORY) {
+                result = VFS_ERR_ISDIR;
+                goto out;
+            }
+            if (victim->entry_count > 0) {
+                result = VFS_ERR_NOTEMPTY;
+                goto out;
+            }
+        } else if (inode->type == VFS_NODE_DIRECTORY) {
+            result = VFS_ERR_NOTDIR;
+            goto out;
+        }
+
+        tmpfs_unlink_entry(new_dir, target, target_prev);
+        kfree(target);
+        victim->nlink--;
+        tmpfs_put_inode(victim);
+
+        /* The source may have shared a list position with the target */
+        tmpfs_find_entry(old_dir, old_name, &prev);
+    }
+
+    /* Move the entry; the inode and its data stay where they are */
+    tmpfs_unlink_entry(old_dir, entry, prev);
+    tmpfs_memcpy(entry->name, new_name, len + 1);
+    tmpfs_link_entry(new_dir, entry);
+    if (inode->type == VFS_NODE_DIRECTORY) {
+        inode->parent = new_dir;
+    }
+
+out:
+    spinlock_release(&sb->lock);
+    return result;
+}
+
+int tmpfs_vfs_stat(vfs_node_t *node, vfs_stat_t *stat) {
+    if (!node || !stat || !node->fs_data) {
+        return VFS_ERR_INVAL;
+    }
+
+    tmpfs_inode_t *inode = (tmpfs_inode_t *)node->fs_data;
+
+    tmpfs_memset(stat, 0, sizeof(vfs_stat_t));
+    stat->st_ino = inode->ino;
+    stat->st_mode = inode->permissions;
+    stat->st_nlink = inode->nlink;
+    stat->st_uid = node->uid;
+    stat->st_gid = node->gid;
+    stat->st_size = inode->size;
+    stat->st_blksize = PAGE_SIZE;
+    stat->st_blocks = (uint64_t)inode->page_count * (PAGE_SIZE / 512);
+    stat->st_type = inode->type;
+    stat->st_atime = node->atime;
+    stat->st_mtime = node->mtime;
+    stat->st_ctime = node->ctime;
+
+    return VFS_OK;
+}
+
+int tmpfs_vfs_chmod(vfs_node_t *node, uint32_t mode) {
+    if (!node || !node->fs_data) {
+        return VFS_ERR_INVAL;
+    }
+
+    tmpfs_inode_t *inode = (tmpfs_inode_t *)node->fs_data;
+    inode->permissions = mode;
+    node->permissions = mode;
+    return VFS_OK;
+}
+
+void tmpfs_vfs_release(vfs_node_t *node) {
+    /* Nodes outliving an unmount point at inodes that are already gone */
+    if (!node || !node->fs_data || !node->mount->fs_data) {
+        return;
+    }
+
+    tmpfs_inode_t *inode = (tmpfs_inode_t *)node->fs_data;
+    tmpfs_sb_t *sb = inode->sb;
+
+    spinlock_acquire(&sb->lock);
+    node->fs_data = NULL;
+    if (inode->node_count > 0) {
+        inode->node_count--;
+    }
+    tmpfs_put_inode(inode);
+    spinlock_release(&sb->lock);
+}
+
+int tmpfs_vfs_mount(vfs_mount_t *mount, void *device) {
+    if (!mount) {
+        return VFS_ERR_INVAL;
+    }
+
+    tmpfs_options_t *options = (tmpfs_options_t *)device;
+    uint64_t max_bytes = (options && options->max_bytes) ? options->max_bytes
+                                                         : TMPFS_DEFAULT_MAX_BYTES;
+    uint32_t max_inodes = (options && options->max_inodes) ? options->max_inodes
+                                                           : TMPFS_DEFAULT_MAX_INODES;
+
+    tmpfs_sb_t *sb = kmalloc(sizeof(tmpfs_sb_t));
+    if (!sb) {
+        return VFS_ERR_NOMEM;
+    }
+
+    tmpfs_memset(sb, 0, sizeof(tmpfs_sb_t));
+    sb->max_pages = max_bytes / PAGE_SIZE;
+    sb->max_inodes = max_inodes;
+    sb->next_ino = 1;
+    sb->vfs_mount = mount;
+
+    sb->root = tmpfs_alloc_inode(sb, VFS_NODE_DIRECTORY,
+                                 VFS_S_IRUSR | VFS_S_IWUSR | VFS_S_IXUSR |
+                                 VFS_S_IRGRP | VFS_S_IWGRP | VFS_S_IXGRP |
+                                 VFS_S_IROTH | VFS_S_IWOTH | VFS_S_IXOTH);
+    vfs_node_t *root = sb->root ? vfs_alloc_node() : NULL;
+    if (!root) {
+        if (sb->root) {
+            kfree(sb->root);
+        }
+        kfree(sb);
+        return VFS_ERR_NOMEM;
+    }
+    sb->root->nlink = 1;
+    sb->root->node_count = 1;
+
+    root->name[0] = '/';
+    root->name[1] = '\0';
+    root->type = VFS_NODE_DIRECTORY;
+    root->permissions = sb->root->permissions;
+    root->mount = mount;
+    root->fs_data = sb->root;
+    root->inode = sb->root->ino;
+
+    mount->root = root;
+    mount->fs_data = sb;
+
+    kprintf("[TMPFS] Mounted at %s (%llu KB, %u inodes)\n",
+            mount->path, max_bytes / KB, max_inodes);
+    return VFS_OK;
+}
+
+int tmpfs_vfs_unmount(vfs_mount_t *mount) {
+    if (!mount || !mount->fs_data) {
+        return VFS_ERR_INVAL;
+    }
+
+    tmpfs_sb_t *sb = (tmpfs_sb_t *)mount->fs_data;
+
+    spinlock_acquire(&sb->lock);
+    tmpfs_destroy_tree(sb->root);
+    spinlock_release(&sb->lock);
+
+    kfree(sb->root);
+    kfree(sb);
+    mount->fs_data = NULL;
+
+    if (mount->root) {
+        vfs_free_node(mount->root);
+        mount->root = NULL;
+    }
+
+    return VFS_OK;
+}
+
+int tmpfs_vfs_statfs(vfs_mount_t *mount, void *buf) {
+    if (!mount || !mount->fs_data || !buf) {
+        return VFS_ERR_INVAL;
+    }
+
+    tmpfs_sb_t *sb = (tmpfs_sb_t *)mount->fs_data;
+    tmpfs_statfs_t *stats = (tmpfs_statfs_t *)buf;
+
+    stats->total_bytes = sb->max_pages * PAGE_SIZE;
+    stats->used_bytes = sb->used_pages * PAGE_SIZE;
+    stats->free_bytes = stats->total_bytes - stats->used_bytes;
+    stats->total_inodes = sb->max_inodes;
+    stats->used_inodes = sb->used_inodes;
+
+    return VFS_OK;
+}
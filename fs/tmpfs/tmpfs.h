@@ -0,0 +1,221 @@
+/**
+ * AAAos tmpfs - In-Memory Filesystem
+ *
+ * A RAM-backed filesystem registered with the VFS as "tmpfs":
+ * - File data lives in page-sized chunks allocated from the PMM
+ * - Files are sparse: pages are only allocated when written
+ * - Each mount has hard limits on its size (data and page tables) and inode count
+ * - Rename only relinks a directory entry, no data is copied
+ *
+ * Nothing stored in tmpfs ever reaches a disk; it is meant for /tmp,
+ * build artifacts and other scratch data.
+ */
+
+#ifndef _AAAOS_TMPFS_H
+#define _AAAOS_TMPFS_H
+
+#include "../../kernel/include/types.h"
+#include "../vfs/vfs.h"
+
+/*============================================================================
+ * tmpfs Constants
+ *============================================================================*/
+
+/* Default mount point */
+#define TMPFS_MOUNT_POINT           "/tmp"
+
+/* Default per-mount limits */
+#define TMPFS_DEFAULT_MAX_BYTES     (64 * MB)
+#define TMPFS_DEFAULT_MAX_INODES    4096
+
+/* Largest file size accepted (files may be sparse up to this) */
+#define TMPFS_MAX_FILE_SIZE         (4ULL * GB)
+
+/*============================================================================
+ * tmpfs Structures
+ *============================================================================*/
+
+struct tmpfs_sb;
+struct tmpfs_dirent;
+
+/**
+ * tmpfs inode
+ */
+typedef struct tmpfs_inode {
+    uint64_t                ino;            /* Inode number */
+    vfs_node_type_t         type;           /* VFS_NODE_FILE or VFS_NODE_DIRECTORY */
+    uint32_t                permissions;    /* Access permissions */
+    uint32_t                nlink;          /* Directory entries naming this inode */
+    uint32_t                open_count;     /* Open handles */
+    uint32_t                node_count;     /* VFS nodes pointing here */
+    uint64_t                size;           /* Size in bytes */
+
+    /* Regular files: page table, NULL entries are holes */
+    uint8_t                 **pages;        /* Page pointers (kernel virtual) */
+    uint32_t                page_slots;     /* Entries in pages */
+    uint32_t                page_count;     /* Pages allocated */
+    uint32_t                table_pages;    /* Pages charged for the page table */
+
+    /* Directories */
+    struct tmpfs_dirent     *entries;       /* Child entries */
+    uint32_t                entry_count;
+    struct tmpfs_inode      *parent;        /* Parent directory */
+
+    struct tmpfs_sb         *sb;            /* Owning superblock */
+} tmpfs_inode_t;
+
+/**
+ * tmpfs directory entry
+ */
+typedef struct tmpfs_dirent {
+    char                    name[VFS_NAME_MAX + 1];
+    tmpfs_inode_t           *inode;
+    struct tmpfs_dirent     *next;
+} tmpfs_dirent_t;
+
+/**
+ * tmpfs mount options (passed as the device argument of vfs_mount)
+ * A zero field selects the default.
+ */
+typedef struct {
+    uint64_t                max_bytes;      /* Size limit, page tables included */
+    uint32_t                max_inodes;     /* Inode limit */
+} tmpfs_options_t;
+
+/**
+ * tmpfs superblock (per mount)
+ */
+typedef struct tmpfs_sb {
+    tmpfs_inode_t           *root;          /* Root directory */
+    uint64_t                max_pages;      /* Page limit (data and page tables) */
+    uint64_t                used_pages;     /* Pages charged against max_pages */
+    uint32_t                max_inodes;     /* Inode limit */
+    uint32_t                used_inodes;    /* Inodes allocated */
+    uint64_t                next_ino;       /* Next inode number */
+    volatile int            lock;           /* Protects the whole tree */
+    vfs_mount_t             *vfs_mount;     /* Associated VFS mount */
+} tmpfs_sb_t;
+
+/**
+ * tmpfs statistics (filled by the VFS statfs callback)
+ */
+typedef struct {
+    uint64_t                total_bytes;    /* Size limit, page tables included */
+    uint64_t                used_bytes;     /* Bytes in data and page-table pages */
+    uint64_t                free_bytes;
+    uint32_t                total_inodes;
+    uint32_t                used_inodes;
+} tmpfs_statfs_t;
+
+/*============================================================================
+ * tmpfs Public API
+ *============================================================================*/
+
+/**
+ * Register the tmpfs filesystem type with the VFS
+ * @return VFS_OK on success, negative error code on failure
+ */
+int tmpfs_init(void);
+
+/**
+ * Mount a tmpfs instance at TMPFS_MOUNT_POINT with default limits
+ * @return VFS_OK on success, negative error code on failure
+ */
+int tmpfs_mount_tmp(void);
+
+/*============================================================================
+ * tmpfs VFS Integration
+ *============================================================================*/
+
+/**
+ * VFS open callback
+ */
+int tmpfs_vfs_open(vfs_node_t *node, int flags);
+
+/**
+ * VFS close callback
+ */
+int tmpfs_vfs_close(vfs_node_t *node);
+
+/**
+ * VFS read callback
+ */
+ssize_t tmpfs_vfs_read(vfs_node_t *node, void *buf, size_t size, uint64_t offset);
+
+/**
+ * VFS write callback
+ */
+ssize_t tmpfs_vfs_write(vfs_node_t *node, const void *buf, size_t size, uint64_t offset);
+
+/**
+ * VFS truncate callback
+ */
+int tmpfs_vfs_truncate(vfs_node_t *node, uint64_t size);
+
+/**
+ * VFS readdir callback
+ */
+vfs_dirent_t* tmpfs_vfs_readdir(vfs_node_t *dir, uint32_t index);
+
+/**
+ * VFS finddir callback
+ */
+vfs_node_t* tmpfs_vfs_finddir(vfs_node_t *dir, const char *name);
+
+/**
+ * VFS mkdir callback
+ */
+int tmpfs_vfs_mkdir(vfs_node_t *parent, const char *name, uint32_t permissions);
+
+/**
+ * VFS rmdir callback
+ */
+int tmpfs_vfs_rmdir(vfs_node_t *parent, const char *name);
+
+/**
+ * VFS create callback
+ */
+int tmpfs_vfs_create(vfs_node_t *parent, const char *name, uint32_t permissions);
+
+/**
+ * VFS unlink callback
+ */
+int tmpfs_vfs_unlink(vfs_node_t *parent, const char *name);
+
+/**
+ * VFS rename callback
+ */
+int tmpfs_vfs_rename(vfs_node_t *old_parent, const char *old_name,
+                     vfs_node_t *new_parent, const char *new_name);
+
+/**
+ * VFS stat callback
+ */
+int tmpfs_vfs_stat(vfs_node_t *node, vfs_stat_t *stat);
+
+/**
+ * VFS chmod callback
+ */
+int tmpfs_vfs_chmod(vfs_node_t *node, uint32_t mode);
+
+/**
+ * VFS release callback (a node pointing at an inode is freed)
+ */
+void tmpfs_vfs_release(vfs_node_t *node);
+
+/**
+ * VFS mount callback (device is an optional tmpfs_options_t)
+ */
+int tmpfs_vfs_mount(vfs_mount_t *mount, void *device);
+
+/**
+ * VFS unmount callback
+ */
+int tmpfs_vfs_unmount(vfs_mount_t *mount);
+
+/**
+ * VFS statfs callback (buf is a tmpfs_statfs_t)
+ */
+int tmpfs_vfs_statfs(vfs_mount_t *mount, void *buf);
+
+#endif /* _AAAOS_TMPFS_H */
@@ -378,7 +378,10 @@ static vfs_fstype_t* vfs_find_fstype(const char *name) {
 static vfs_node_t vfs_node_pool[VFS_NODE_POOL_SIZE];
 static bool vfs_node_used[VFS_NODE_POOL_SIZE];
 
-vfs_node_t* vfs_alloc_node(void) {
+/* Number of dentries evicted per retry when the node pool is exhausted */
+#define VFS_DCACHE_SHRINK_BATCH 64
+
+static vfs_node_t* vfs_try_alloc_node(void) {
     for (int i = 0; i < VFS_NODE_POOL_SIZE; i++) {
         if (!vfs_node_used[i]) {
             vfs_node_used[i] = true;
@@ -387,13 +390,30 @@ vfs_node_t* vfs_alloc_node(void) {
             return &vfs_node_pool[i];
         }
     }
-    kprintf("[VFS] alloc_node: Out of nodes\n");
     return NULL;
 }
 
+vfs_node_t* vfs_alloc_node(void) {
+    vfs_node_t *node = vfs_try_alloc_node();
+
+    /* Under pressure, give back nodes pinned only by the dcache */
+    while (!node && vfs_dcache_shrink(VFS_DCACHE_SHRINK_BATCH) > 0) {
+        node = vfs_try_alloc_node();
+    }
+
+    if (!node) {
+        kprintf("[VFS] alloc_node: Out of nodes\n");
+    }
+    return node;
+}
+
 void vfs_free_node(vfs_node_t *node) {
     if (!node) return;
 
+    if (node->fs_data && node->mount && node->mount->ops && node->mount->ops->release) {
+        node->mount->ops->release(node);
+    }
+
     for (int i = 0; i < VFS_NODE_POOL_SIZE; i++) {
         if (&vfs_node_pool[i] == node) {
             vfs_node_used[i] = false;
@@ -420,20 +440,266 @@ void vfs_unref_node(vfs_node_t *node) {
     }
 }
 
+/*============================================================================
+ * Directory entry cache
+ *
+ * Maps (parent node, component name) to the node finddir() returned, or to
+ * "does not exist" for negative entries. Each dentry holds a reference on
+ * its parent and child, so a cached parent pointer can never be recycled
+ * by the node pool while it is still used as a key.
+ *============================================================================*/
+
+typedef struct vfs_dentry {
+    vfs_node_t          *parent;                /* Directory the name lives in */
+    vfs_node_t          *node;                  /* Resolved node, NULL if negative */
+    uint32_t            hash;                   /* Hash of (parent, name) */
+    bool                in_use;                 /* Slot is in use */
+    struct vfs_dentry   *hash_next;             /* Next entry in hash chain */
+    struct vfs_dentry   *lru_prev;              /* More recently used entry */
+    struct vfs_dentry   *lru_next;              /* Less recently used entry */
+    char                name[VFS_NAME_MAX + 1]; /* Component name */
+} vfs_dentry_t;
+
+static vfs_dentry_t vfs_dentry_pool[VFS_DCACHE_SIZE];
+static vfs_dentry_t *vfs_dcache_hash[VFS_DCACHE_BUCKETS];
+static vfs_dentry_t *vfs_dcache_lru_head = NULL;   /* Most recently used */
+static vfs_dentry_t *vfs_dcache_lru_tail = NULL;   /* Least recently used */
+static vfs_dcache_stats_t vfs_dcache_stats;
+
+/**
+ * FNV-1a hash over the parent pointer and the component name
+ */
+static uint32_t vfs_dcache_hash_key(vfs_node_t *parent, const char *name) {
+    uint32_t hash = 2166136261u;
+    uintptr_t p = (uintptr_t)parent;
+
+    for (int i = 0; i < 8; i++) {
+        hash ^= (uint8_t)(p >> (i * 8));
+        hash *= 16777619u;
+    }
+    while (*name) {
+        hash ^= (uint8_t)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void vfs_dcache_lru_unlink(vfs_dentry_t *d) {
+    if (d->lru_prev) {
+        d->lru_prev->lru_next = d->lru_next;
+    } else {
+        vfs_dcache_lru_head = d->lru_next;
+    }
+    if (d->lru_next) {
+        d->lru_next->lru_prev = d->lru_prev;
+    } else {
+        vfs_dcache_lru_tail = d->lru_prev;
+    }
+    d->lru_prev = NULL;
+    d->lru_next = NULL;
+}
+
+static void vfs_dcache_lru_push(vfs_dentry_t *d) {
+    d->lru_prev = NULL;
+    d->lru_next = vfs_dcache_lru_head;
+    if (vfs_dcache_lru_head) {
+        vfs_dcache_lru_head->lru_prev = d;
+    }
+    vfs_dcache_lru_head = d;
+    if (!vfs_dcache_lru_tail) {
+        vfs_dcache_lru_tail = d;
+    }
+}
+
+/**
+ * Remove a dentry from the cache and drop its node references
+ */
+static void vfs_dcache_remove(vfs_dentry_t *d) {
+    vfs_dentry_t **link = &vfs_dcache_hash[d->hash & (VFS_DCACHE_BUCKETS - 1)];
+
+    while (*link && *link != d) {
+        link = &(*link)->hash_next;
+    }
+    if (*link) {
+        *link = d->hash_next;
+    }
+    vfs_dcache_lru_unlink(d);
+
+    d->in_use = false;
+    d->hash_next = NULL;
+    vfs_dcache_stats.entries--;
+
+    if (d->node) {
+        vfs_unref_node(d->node);
+    }
+    vfs_unref_node(d->parent);
+}
+
+/**
+ * Find a cached dentry and mark it most recently used
+ */
+static vfs_dentry_t* vfs_dcache_find(vfs_node_t *parent, const char *name) {
+    uint32_t hash = vfs_dcache_hash_key(parent, name);
+    vfs_dentry_t *d = vfs_dcache_hash[hash & (VFS_DCACHE_BUCKETS - 1)];
+
+    while (d) {
+        if (d->hash == hash && d->parent == parent && vfs_strcmp(d->name, name) == 0) {
+            if (d != vfs_dcache_lru_head) {
+                vfs_dcache_lru_unlink(d);
+                vfs_dcache_lru_push(d);
+            }
+            return d;
+        }
+        d = d->hash_next;
+    }
+    return NULL;
+}
+
+/**
+ * Cache the result of a finddir() call
+ * @param node Resolved node, or NULL to record a negative entry
+ */
+static void vfs_dcache_insert(vfs_node_t *parent, const char *name, vfs_node_t *node) {
+    vfs_dentry_t *d = NULL;
+
+    if (vfs_strlen(name) > VFS_NAME_MAX) {
+        return;
+    }
+
+    for (int i = 0; i < VFS_DCACHE_SIZE; i++) {
+        if (!vfs_dentry_pool[i].in_use) {
+            d = &vfs_dentry_pool[i];
+            break;
+        }
+    }
+
+    /* Cache full - recycle the least recently used entry */
+    if (!d) {
+        d = vfs_dcache_lru_tail;
+        if (!d) {
+            return;
+        }
+        vfs_dcache_remove(d);
+        vfs_dcache_stats.evictions++;
+    }
+
+    vfs_memset(d, 0, sizeof(*d));
+    vfs_strcpy(d->name, name);
+    d->parent = parent;
+    d->node = node;
+    d->hash = vfs_dcache_hash_key(parent, name);
+    d->in_use = true;
+
+    vfs_ref_node(parent);
+    if (node) {
+        vfs_ref_node(node);
+    }
+
+    uint32_t bucket = d->hash & (VFS_DCACHE_BUCKETS - 1);
+    d->hash_next = vfs_dcache_hash[bucket];
+    vfs_dcache_hash[bucket] = d;
+    vfs_dcache_lru_push(d);
+    vfs_dcache_stats.entries++;
+}
+
+/**
+ * Drop every dentry that resolves to, or lives under, a node
+ * This only finds aliases that share the node. Filesystems that build a
+ * new node per lookup (FAT32) cache each spelling of a case-insensitive
+ * name with its own node, so removals also drop the whole parent with
+ * vfs_dcache_invalidate(parent, NULL).
+ */
+static void vfs_dcache_invalidate_node(vfs_node_t *node) {
+    for (int i = 0; i < VFS_DCACHE_SIZE; i++) {
+        vfs_dentry_t *d = &vfs_dentry_pool[i];
+        if (d->in_use && (d->node == node || d->parent == node)) {
+            vfs_dcache_remove(d);
+            vfs_dcache_stats.invalidations++;
+        }
+    }
+}
+
+/**
+ * Drop negative dentries under a directory
+ * Used when a name is created, since the filesystem may match it under
+ * a spelling the dcache does not know about.
+ */
+static void vfs_dcache_invalidate_negative(vfs_node_t *parent) {
+    for (int i = 0; i < VFS_DCACHE_SIZE; i++) {
+        vfs_dentry_t *d = &vfs_dentry_pool[i];
+        if (d->in_use && d->parent == parent && !d->node) {
+            vfs_dcache_remove(d);
+            vfs_dcache_stats.invalidations++;
+        }
+    }
+}
+
+/**
+ * Drop every dentry belonging to a mount (before it is unmounted)
+ */
+static void vfs_dcache_invalidate_mount(vfs_mount_t *mount) {
+    for (int i = 0; i < VFS_DCACHE_SIZE; i++) {
+        vfs_dentry_t *d = &vfs_dentry_pool[i];
+        if (d->in_use && d->parent->mount == mount) {
+            vfs_dcache_remove(d);
+            vfs_dcache_stats.invalidations++;
+        }
+    }
+}
+
+void vfs_dcache_invalidate(vfs_node_t *parent, const char *name) {
+    if (!parent) return;
+
+    if (!name) {
+        for (int i = 0; i < VFS_DCACHE_SIZE; i++) {
+            vfs_dentry_t *d = &vfs_dentry_pool[i];
+            if (d->in_use && d->parent == parent) {
+                vfs_dcache_remove(d);
+                vfs_dcache_stats.invalidations++;
+            }
+        }
+        return;
+    }
+
+    vfs_dentry_t *d = vfs_dcache_find(parent, name);
+    if (d) {
+        vfs_node_t *node = d->node;
+        vfs_dcache_remove(d);
+        vfs_dcache_stats.invalidations++;
+        if (node) {
+            vfs_dcache_invalidate_node(node);
+        }
+    }
+}
+
+uint32_t vfs_dcache_shrink(uint32_t count) {
+    uint32_t evicted = 0;
+
+    while (evicted < count && vfs_dcache_lru_tail) {
+        vfs_dcache_remove(vfs_dcache_lru_tail);
+        vfs_dcache_stats.evictions++;
+        evicted++;
+    }
+    return evicted;
+}
+
+void vfs_dcache_get_stats(vfs_dcache_stats_t *stats) {
+    if (stats) {
+        vfs_memcpy(stats, &vfs_dcache_stats, sizeof(*stats));
+    }
+}
+
 /*============================================================================
  * Mount management
  *============================================================================*/
 
-vfs_mount_t* vfs_get_mount(const char *path) {
-    char *normalized;
+/**
+ * Find the mount for an already-normalized path
+ */
+static vfs_mount_t* vfs_find_mount(const char *normalized) {
     size_t best_len = 0;
     vfs_mount_t *best_mount = NULL;
 
-    if (!path) return NULL;
-
-    normalized = vfs_normalize_path(path);
-    if (!normalized) return NULL;
-
     /* Find the longest matching mount point */
     for (uint32_t i = 0; i < vfs_mount_count; i++) {
         if (!vfs_mounts[i].active) continue;
@@ -457,6 +723,17 @@ vfs_mount_t* vfs_get_mount(const char *path) {
     return best_mount;
 }
 
+vfs_mount_t* vfs_get_mount(const char *path) {
+    char *normalized;
+
+    if (!path) return NULL;
+
+    normalized = vfs_normalize_path(path);
+    if (!normalized) return NULL;
+
+    return vfs_find_mount(normalized);
+}
+
 int vfs_mount(const char *path, const char *type, void *device) {
     vfs_mount_t *mount;
     vfs_fstype_t *fstype;
@@ -585,6 +862,9 @@ int vfs_unmount(const char *path) {
         }
     }
 
+    /* Release cached dentries (and their node references) first */
+    vfs_dcache_invalidate_mount(mount);
+
     /* Call filesystem-specific unmount */
     if (mount->ops && mount->ops->unmount) {
         result = mount->ops->unmount(mount);
@@ -632,7 +912,7 @@ vfs_node_t* vfs_lookup(const char *path) {
     }
 
     /* Find the mount point for this path */
-    mount = vfs_get_mount(normalized);
+    mount = vfs_find_mount(normalized);
     if (!mount) {
         vfs_set_error(VFS_ERR_NOENT);
         return NULL;
@@ -684,11 +964,25 @@ vfs_node_t* vfs_lookup(const char *path) {
             return NULL;
         }
 
-        /* Look up the component */
-        if (mount->ops && mount->ops->finddir) {
-            next = mount->ops->finddir(node, component);
+        /* Look up the component, trying the dcache first */
+        vfs_dentry_t *dentry = vfs_dcache_find(node, component);
+        if (dentry) {
+            if (dentry->node) {
+                vfs_dcache_stats.hits++;
+                next = dentry->node;
+                vfs_ref_node(next);
+            } else {
+                vfs_dcache_stats.negative_hits++;
+                next = NULL;
+            }
         } else {
-            next = NULL;
+            vfs_dcache_stats.misses++;
+            if (mount->ops && mount->ops->finddir) {
+                next = mount->ops->finddir(node, component);
+            } else {
+                next = NULL;
+            }
+            vfs_dcache_insert(node, component, next);
         }
 
         vfs_unref_node(node);
@@ -749,6 +1043,8 @@ vfs_file_t* vfs_open(const char *path, int flags) {
         mount = parent_node->mount;
         if (mount && mount->ops && mount->ops->create) {
             result = mount->ops->create(parent_node, name, VFS_S_IRUSR | VFS_S_IWUSR);
+            vfs_dcache_invalidate(parent_node, name);
+            vfs_dcache_invalidate_negative(parent_node);
             vfs_unref_node(parent_node);
 
             if (result != VFS_OK) {
@@ -987,6 +1283,261 @@ ssize_t vfs_write(vfs_file_t *file, const void *buf, size_t size) {
     return bytes_written;
 }
 
+/*============================================================================
+ * Positional and vectored I/O
+ *============================================================================*/
+
+/**
+ * Validate an I/O vector and compute its total length
+ * @return Total length in bytes, or VFS_ERR_INVAL
+ */
+static ssize_t vfs_iov_length(const vfs_iovec_t *iov, int iovcnt) {
+    size_t total = 0;
+
+    if (!iov || iovcnt <= 0 || iovcnt > VFS_IOV_MAX) {
+        return VFS_ERR_INVAL;
+    }
+
+    for (int i = 0; i < iovcnt; i++) {
+        if (!iov[i].iov_base && iov[i].iov_len > 0) {
+            return VFS_ERR_INVAL;
+        }
+        if (iov[i].iov_len > (size_t)INT64_MAX - total) {
+            return VFS_ERR_INVAL;
+        }
+        total += iov[i].iov_len;
+    }
+
+    return (ssize_t)total;
+}
+
+/**
+ * Check that an open file can be read
+ */
+static int vfs_check_readable(vfs_file_t *file) {
+    if (!file || !file->in_use) {
+        return VFS_ERR_INVAL;
+    }
+    if (!file->node) {
+        return VFS_ERR_BADF;
+    }
+    if ((file->flags & VFS_O_RDWR) == VFS_O_WRONLY) {
+        return VFS_ERR_ACCES;
+    }
+    if (file->node->type == VFS_NODE_DIRECTORY) {
+        return VFS_ERR_ISDIR;
+    }
+
+    vfs_mount_t *mount = file->node->mount;
+    if (!mount || !mount->ops || (!mount->ops->readv && !mount->ops->read)) {
+        return VFS_ERR_NOSYS;
+    }
+    return VFS_OK;
+}
+
+/**
+ * Check that an open file can be written
+ */
+static int vfs_check_writable(vfs_file_t *file) {
+    if (!file || !file->in_use) {
+        return VFS_ERR_INVAL;
+    }
+    if (!file->node) {
+        return VFS_ERR_BADF;
+    }
+    if ((file->flags & (VFS_O_WRONLY | VFS_O_RDWR)) == 0) {
+        return VFS_ERR_ACCES;
+    }
+    if (file->node->type == VFS_NODE_DIRECTORY) {
+        return VFS_ERR_ISDIR;
+    }
+
+    vfs_mount_t *mount = file->node->mount;
+    if (mount && mount->readonly) {
+        return VFS_ERR_ROFS;
+    }
+    if (!mount || !mount->ops || (!mount->ops->writev && !mount->ops->write)) {
+        return VFS_ERR_NOSYS;
+    }
+    return VFS_OK;
+}
+
+/**
+ * Read into an I/O vector at an offset without touching the file position
+ */
+static ssize_t vfs_do_preadv(vfs_file_t *file, const vfs_iovec_t *iov, int iovcnt,
+                             uint64_t offset) {
+    int result = vfs_check_readable(file);
+    if (result != VFS_OK) {
+        vfs_set_error(result);
+        return result;
+    }
+
+    ssize_t total = vfs_iov_length(iov, iovcnt);
+    if (total < 0) {
+        vfs_set_error((int)total);
+        return total;
+    }
+
+    vfs_node_t *node = file->node;
+    if (offset >= node->size || total == 0) {
+        return 0;
+    }
+
+    /* Segments starting at or past EOF cannot receive data */
+    uint64_t remaining = node->size - offset;
+    int count = 0;
+    for (uint64_t seen = 0; count < iovcnt && seen < remaining; count++) {
+        seen += iov[count].iov_len;
+    }
+
+    vfs_ops_t *ops = node->mount->ops;
+    if (ops->readv) {
+        return ops->readv(node, iov, count, offset);
+    }
+
+    /* Fallback: one read per segment, stopping at the first short one */
+    size_t done = 0;
+    for (int i = 0; i < count; i++) {
+        size_t len = MIN(iov[i].iov_len, remaining - done);
+        if (len == 0) {
+            continue;
+        }
+
+        ssize_t n = ops->read(node, iov[i].iov_base, len, offset + done);
+        if (n < 0) {
+            return done ? (ssize_t)done : n;
+        }
+        done += (size_t)n;
+        if ((size_t)n < len) {
+            break;
+        }
+    }
+
+    return (ssize_t)done;
+}
+
+/**
+ * Write an I/O vector at an offset without touching the file position
+ */
+static ssize_t vfs_do_pwritev(vfs_file_t *file, const vfs_iovec_t *iov, int iovcnt,
+                              uint64_t offset) {
+    int result = vfs_check_writable(file);
+    if (result != VFS_OK) {
+        vfs_set_error(result);
+        return result;
+    }
+
+    ssize_t total = vfs_iov_length(iov, iovcnt);
+    if (total < 0) {
+        vfs_set_error((int)total);
+        return total;
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    vfs_node_t *node = file->node;
+    vfs_ops_t *ops = node->mount->ops;
+    ssize_t done = 0;
+
+    if (ops->writev) {
+        done = ops->writev(node, iov, iovcnt, offset);
+    } else {
+        /* Fallback: one write per segment, stopping at the first short one */
+        for (int i = 0; i < iovcnt; i++) {
+            if (iov[i].iov_len == 0) {
+                continue;
+            }
+
+            ssize_t n = ops->write(node, iov[i].iov_base, iov[i].iov_len,
+                                   offset + (uint64_t)done);
+            if (n < 0) {
+                if (done == 0) {
+                    done = n;
+                }
+                break;
+            }
+            done += n;
+            if ((size_t)n < iov[i].iov_len) {
+                break;
+            }
+        }
+    }
+
+    if (done > 0) {
+        if (offset + (uint64_t)done > node->size) {
+            node->size = offset + (uint64_t)done;
+        }
+        node->dirty = true;
+    }
+
+    return done;
+}
+
+ssize_t vfs_pread(vfs_file_t *file, void *buf, size_t size, uint64_t offset) {
+    vfs_iovec_t iov = { .iov_base = buf, .iov_len = size };
+
+    if (!buf) {
+        vfs_set_error(VFS_ERR_INVAL);
+        return VFS_ERR_INVAL;
+    }
+
+    return vfs_do_preadv(file, &iov, 1, offset);
+}
+
+ssize_t vfs_pwrite(vfs_file_t *file, const void *buf, size_t size, uint64_t offset) {
+    vfs_iovec_t iov = { .iov_base = (void *)buf, .iov_len = size };
+
+    if (!buf) {
+        vfs_set_error(VFS_ERR_INVAL);
+        return VFS_ERR_INVAL;
+    }
+
+    return vfs_do_pwritev(file, &iov, 1, offset);
+}
+
+ssize_t vfs_preadv(vfs_file_t *file, const vfs_iovec_t *iov, int iovcnt, uint64_t offset) {
+    return vfs_do_preadv(file, iov, iovcnt, offset);
+}
+
+ssize_t vfs_pwritev(vfs_file_t *file, const vfs_iovec_t *iov, int iovcnt, uint64_t offset) {
+    return vfs_do_pwritev(file, iov, iovcnt, offset);
+}
+
+ssize_t vfs_readv(vfs_file_t *file, const vfs_iovec_t *iov, int iovcnt) {
+    if (!file || !file->in_use) {
+        vfs_set_error(VFS_ERR_INVAL);
+        return VFS_ERR_INVAL;
+    }
+
+    ssize_t bytes_read = vfs_do_preadv(file, iov, iovcnt, file->offset);
+    if (bytes_read > 0) {
+        file->offset += bytes_read;
+    }
+
+    return bytes_read;
+}
+
+ssize_t vfs_writev(vfs_file_t *file, const vfs_iovec_t *iov, int iovcnt) {
+    if (!file || !file->in_use || !file->node) {
+        vfs_set_error(VFS_ERR_INVAL);
+        return VFS_ERR_INVAL;
+    }
+
+    /* Handle append mode */
+    if (file->flags & VFS_O_APPEND) {
+        file->offset = file->node->size;
+    }
+
+    ssize_t bytes_written = vfs_do_pwritev(file, iov, iovcnt, file->offset);
+    if (bytes_written > 0) {
+        file->offset += bytes_written;
+    }
+
+    return bytes_written;
+}
+
 int64_t vfs_seek(vfs_file_t *file, int64_t offset, int whence) {
     int64_t new_offset;
 
@@ -1222,6 +1773,8 @@ int vfs_mkdir(const char *path, uint32_t mode) {
     }
 
     result = mount->ops->mkdir(parent, name, mode);
+    vfs_dcache_invalidate(parent, name);
+    vfs_dcache_invalidate_negative(parent);
     vfs_unref_node(parent);
 
     if (result == VFS_OK) {
@@ -1277,6 +1830,8 @@ int vfs_rmdir(const char *path) {
     }
 
     result = mount->ops->rmdir(parent, name);
+    /* Every entry under parent: other spellings of name may be cached */
+    vfs_dcache_invalidate(parent, NULL);
     vfs_unref_node(parent);
 
     return result;
@@ -1336,6 +1891,8 @@ int vfs_create(const char *path, uint32_t mode) {
     }
 
     result = mount->ops->create(parent, name, mode);
+    vfs_dcache_invalidate(parent, name);
+    vfs_dcache_invalidate_negative(parent);
     vfs_unref_node(parent);
 
     return result;
@@ -1370,32 +1927,37 @@ int vfs_unlink(const char *path) {
         return VFS_ERR_ISDIR;
     }
 
-    vfs_unref_node(node);
-
     /* Get parent directory */
     parent_path = vfs_parent_path(path);
     name = vfs_basename(path);
 
     parent = vfs_lookup(parent_path);
     if (!parent) {
+        vfs_unref_node(node);
         vfs_set_error(VFS_ERR_NOENT);
         return VFS_ERR_NOENT;
     }
 
     mount = parent->mount;
     if (!mount || !mount->ops || !mount->ops->unlink) {
+        vfs_unref_node(node);
         vfs_unref_node(parent);
         vfs_set_error(VFS_ERR_NOSYS);
         return VFS_ERR_NOSYS;
     }
 
     if (mount->readonly) {
+        vfs_unref_node(node);
         vfs_unref_node(parent);
         vfs_set_error(VFS_ERR_ROFS);
         return VFS_ERR_ROFS;
     }
 
     result = mount->ops->unlink(parent, name);
+    /* Every entry under parent: other spellings of name may be cached */
+    vfs_dcache_invalidate(parent, NULL);
+    vfs_dcache_invalidate_node(node);
+    vfs_unref_node(node);
     vfs_unref_node(parent);
 
     return result;
@@ -1404,6 +1966,7 @@ int vfs_unlink(const char *path) {
 int vfs_rename(const char *oldpath, const char *newpath) {
     vfs_node_t *old_parent;
     vfs_node_t *new_parent;
+    vfs_node_t *node;
     vfs_mount_t *mount;
     char *old_parent_path;
     char *new_parent_path;
@@ -1460,7 +2023,19 @@ int vfs_rename(const char *oldpath, const char *newpath) {
         return VFS_ERR_ROFS;
     }
 
+    /* Resolve the source so every cached alias of it can be dropped */
+    node = vfs_lookup(oldpath);
+
     result = mount->ops->rename(old_parent, old_name, new_parent, new_name);
+    /* Both directories entirely: either name may be cached under another spelling */
+    vfs_dcache_invalidate(old_parent, NULL);
+    if (new_parent != old_parent) {
+        vfs_dcache_invalidate(new_parent, NULL);
+    }
+    if (node) {
+        vfs_dcache_invalidate_node(node);
+        vfs_unref_node(node);
+    }
     vfs_unref_node(old_parent);
     vfs_unref_node(new_parent);
 
@@ -1592,6 +2167,13 @@ int vfs_init(void) {
     vfs_memset(vfs_node_pool, 0, sizeof(vfs_node_pool));
     vfs_memset(vfs_node_used, 0, sizeof(vfs_node_used));
 
+    /* Initialize directory entry cache */
+    vfs_memset(vfs_dentry_pool, 0, sizeof(vfs_dentry_pool));
+    vfs_memset(vfs_dcache_hash, 0, sizeof(vfs_dcache_hash));
+    vfs_memset(&vfs_dcache_stats, 0, sizeof(vfs_dcache_stats));
+    vfs_dcache_lru_head = NULL;
+    vfs_dcache_lru_tail = NULL;
+
     /* Initialize filesystem types list */
     vfs_fs_types = NULL;
 
@@ -1604,6 +2186,7 @@ int vfs_init(void) {
     kprintf("[VFS]   Max open files: %d\n", VFS_MAX_OPEN_FILES);
     kprintf("[VFS]   Max mounts: %d\n", VFS_MAX_MOUNTS);
     kprintf("[VFS]   Max path length: %d\n", VFS_PATH_MAX);
+    kprintf("[VFS]   Dentry cache: %d entries\n", VFS_DCACHE_SIZE);
 
     return VFS_OK;
 }
@@ -21,6 +21,13 @@
 /* Maximum number of mounted filesystems */
 #define VFS_MAX_MOUNTS      64
 
+/* Directory entry cache (dcache) configuration */
+#define VFS_DCACHE_SIZE     512     /* Maximum cached dentries */
+#define VFS_DCACHE_BUCKETS  256     /* Hash buckets (power of 2) */
+
+/* Maximum segments in a vectored I/O request */
+#define VFS_IOV_MAX         1024
+
 /* File types */
 typedef enum {
     VFS_NODE_FILE       = 0x01,     /* Regular file */
@@ -95,6 +102,14 @@ typedef struct vfs_dirent vfs_dirent_t;
 typedef struct vfs_stat vfs_stat_t;
 typedef struct vfs_ops vfs_ops_t;
 
+/**
+ * I/O vector segment for vectored reads and writes
+ */
+typedef struct vfs_iovec {
+    void            *iov_base;      /* Segment start */
+    size_t          iov_len;        /* Segment length in bytes */
+} vfs_iovec_t;
+
 /**
  * File/directory statistics
  */
@@ -158,6 +173,8 @@ struct vfs_ops {
     int     (*close)(vfs_node_t *node);
     ssize_t (*read)(vfs_node_t *node, void *buf, size_t size, uint64_t offset);
     ssize_t (*write)(vfs_node_t *node, const void *buf, size_t size, uint64_t offset);
+    ssize_t (*readv)(vfs_node_t *node, const vfs_iovec_t *iov, int iovcnt, uint64_t offset);
+    ssize_t (*writev)(vfs_node_t *node, const vfs_iovec_t *iov, int iovcnt, uint64_t offset);
     int     (*truncate)(vfs_node_t *node, uint64_t size);
     int     (*sync)(vfs_node_t *node);
 
@@ -175,6 +192,7 @@ struct vfs_ops {
     int     (*stat)(vfs_node_t *node, vfs_stat_t *stat);
     int     (*chmod)(vfs_node_t *node, uint32_t mode);
     int     (*chown)(vfs_node_t *node, uint32_t uid, uint32_t gid);
+    void    (*release)(vfs_node_t *node);   /* Node is being freed */
 
     /* Filesystem operations */
     int     (*mount)(vfs_mount_t *mount, void *device);
@@ -219,6 +237,18 @@ typedef struct vfs_dir {
     bool            in_use;                     /* Handle is in use */
 } vfs_dir_t;
 
+/**
+ * Directory entry cache statistics
+ */
+typedef struct vfs_dcache_stats {
+    uint64_t        hits;                       /* Positive entry hits */
+    uint64_t        negative_hits;              /* Negative entry hits */
+    uint64_t        misses;                     /* Lookups sent to finddir */
+    uint64_t        evictions;                  /* Entries evicted by LRU */
+    uint64_t        invalidations;              /* Entries dropped by updates */
+    uint32_t        entries;                    /* Entries currently cached */
+} vfs_dcache_stats_t;
+
 /**
  * Filesystem type registration
  */
@@ -302,6 +332,68 @@ ssize_t vfs_read(vfs_file_t *file, void *buf, size_t size);
  */
 ssize_t vfs_write(vfs_file_t *file, const void *buf, size_t size);
 
+/**
+ * Read from a file at a given offset
+ * The file position is neither used nor changed.
+ * @param file File handle
+ * @param buf Buffer to read into
+ * @param size Number of bytes to read
+ * @param offset File offset to read from
+ * @return Number of bytes read, or negative error code
+ */
+ssize_t vfs_pread(vfs_file_t *file, void *buf, size_t size, uint64_t offset);
+
+/**
+ * Write to a file at a given offset
+ * The file position is neither used nor changed; VFS_O_APPEND is ignored.
+ * @param file File handle
+ * @param buf Buffer to write from
+ * @param size Number of bytes to write
+ * @param offset File offset to write at
+ * @return Number of bytes written, or negative error code
+ */
+ssize_t vfs_pwrite(vfs_file_t *file, const void *buf, size_t size, uint64_t offset);
+
+/**
+ * Read from a file into several buffers at the file position
+ * @param file File handle
+ * @param iov Segments to fill, in order
+ * @param iovcnt Number of segments (at most VFS_IOV_MAX)
+ * @return Number of bytes read, or negative error code
+ */
+ssize_t vfs_readv(vfs_file_t *file, const vfs_iovec_t *iov, int iovcnt);
+
+/**
+ * Write several buffers to a file at the file position
+ * @param file File handle
+ * @param iov Segments to write, in order
+ * @param iovcnt Number of segments (at most VFS_IOV_MAX)
+ * @return Number of bytes written, or negative error code
+ */
+ssize_t vfs_writev(vfs_file_t *file, const vfs_iovec_t *iov, int iovcnt);
+
+/**
+ * Read from a file into several buffers at a given offset
+ * Uses the filesystem's readv operation, or falls back to one read per segment.
+ * @param file File handle
+ * @param iov Segments to fill, in order
+ * @param iovcnt Number of segments (at most VFS_IOV_MAX)
+ * @param offset File offset to read from
+ * @return Number of bytes read, or negative error code
+ */
+ssize_t vfs_preadv(vfs_file_t *file, const vfs_iovec_t *iov, int iovcnt, uint64_t offset);
+
+/**
+ * Write several buffers to a file at a given offset
+ * Uses the filesystem's writev operation, or falls back to one write per segment.
+ * @param file File handle
+ * @param iov Segments to write, in order
+ * @param iovcnt Number of segments (at most VFS_IOV_MAX)
+ * @param offset File offset to write at
+ * @return Number of bytes written, or negative error code
+ */
+ssize_t vfs_pwritev(vfs_file_t *file, const vfs_iovec_t *iov, int iovcnt, uint64_t offset);
+
 /**
  * Seek within a file
  * @param file File handle
@@ -454,7 +546,7 @@ vfs_mount_t* vfs_get_mount(const char *path);
 vfs_node_t* vfs_alloc_node(void);
 
 /**
- * Free a VFS node
+ * Free a VFS node, letting its filesystem drop fs_data first
  * @param node Node to free
  */
 void vfs_free_node(vfs_node_t *node);
@@ -471,6 +563,28 @@ void vfs_ref_node(vfs_node_t *node);
  */
 void vfs_unref_node(vfs_node_t *node);
 
+/**
+ * Drop cached directory entries for a name in a directory
+ * Filesystems that change a directory behind the VFS must call this.
+ * @param parent Directory node
+ * @param name Entry name (NULL drops every entry under parent)
+ */
+void vfs_dcache_invalidate(vfs_node_t *parent, const char *name);
+
+/**
+ * Evict least recently used directory entries
+ * Called when the node pool runs dry; releases the cache's node references.
+ * @param count Maximum number of entries to evict
+ * @return Number of entries evicted
+ */
+uint32_t vfs_dcache_shrink(uint32_t count);
+
+/**
+ * Get directory entry cache statistics
+ * @param stats Statistics buffer
+ */
+void vfs_dcache_get_stats(vfs_dcache_stats_t *stats);
+
 /**
  * Get last error code
  * @return Last VFS error code
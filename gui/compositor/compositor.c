@@ -7,6 +7,7 @@
 
 #include "compositor.h"
 #include "../../drivers/video/framebuffer.h"
+#include "../../drivers/video/pixel.h"
 #include "../../kernel/include/serial.h"
 #include "../../kernel/mm/heap.h"
 #include "../../lib/libc/string.h"
@@ -14,16 +15,31 @@
 /* Global compositor state */
 static compositor_t g_compositor;
 
+/**
+ * Set of disjoint rectangles, used for the visible part of a window
+ */
+typedef struct compositor_region {
+    dirty_rect_t rects[COMPOSITOR_MAX_REGION_RECTS];
+    uint32_t count;
+} compositor_region_t;
+
 /* Forward declarations for internal functions */
-static void compositor_draw_desktop_background(void);
-static void compositor_draw_window(window_t *win);
-static void compositor_draw_window_decorations(window_t *win);
-static void compositor_blit_window_buffer(window_t *win);
+static void compositor_draw_desktop_background(const dirty_rect_t *clip);
+static void compositor_draw_window(window_t *win, const dirty_rect_t *clip);
+static void compositor_draw_window_decorations(window_t *win, const dirty_rect_t *clip);
+static void compositor_blit_window_buffer(window_t *win, const dirty_rect_t *clip);
+static void compositor_fill_rect(int x, int y, int w, int h, uint32_t color,
+                                 const dirty_rect_t *clip);
 static void compositor_swap_buffers(void);
+static void compositor_window_bounds(window_t *win, dirty_rect_t *bounds);
+static void compositor_invalidate_window(window_t *win);
+static void compositor_add_damage(dirty_rect_t rect);
+static void compositor_visible_region(const dirty_rect_t *area, window_t *above,
+                                      compositor_region_t *region);
+static bool compositor_rect_clip(int *x, int *y, int *w, int *h, const dirty_rect_t *clip);
 static void compositor_unlink_window(window_t *win);
 static void compositor_link_window(window_t *win);
 static void compositor_reorder_windows(void);
-static uint32_t alpha_blend(uint32_t fg, uint32_t bg);
 
 /**
  * Initialize the compositor
@@ -62,6 +78,11 @@ int compositor_init(uint32_t width, uint32_t height) {
         return -2;
     }
     g_compositor.front_buffer = fb->address;
+    g_compositor.front_pitch = fb->pitch / sizeof(uint32_t);
+    g_compositor.page_flip = fb->page_count > 1;
+    if (g_compositor.page_flip) {
+        kprintf("[COMPOSITOR] Presenting by page flip (%u pages)\n", fb->page_count);
+    }
 
     /* Initialize state */
     g_compositor.window_list = NULL;
@@ -70,11 +91,10 @@ int compositor_init(uint32_t width, uint32_t height) {
     g_compositor.window_count = 0;
     g_compositor.next_window_id = 1;
     g_compositor.next_z_order = 0;
-    g_compositor.needs_full_redraw = true;
     g_compositor.initialized = true;
 
-    /* Clear dirty region */
-    g_compositor.dirty_region.valid = false;
+    /* First frame paints everything */
+    compositor_invalidate_all();
 
     kprintf("[COMPOSITOR] Initialization complete\n");
     return 0;
@@ -149,9 +169,7 @@ window_t *compositor_create_window(int x, int y, int w, int h, const char *title
     }
 
     /* Clear buffer to white */
-    for (int i = 0; i < w * h; i++) {
-        win->buffer[i] = 0xFFFFFFFF;
-    }
+    pixel_fill_span(win->buffer, 0xFFFFFFFF, (size_t)w * h);
 
     /* Initialize window properties */
     win->x = x;
@@ -205,9 +223,7 @@ void compositor_destroy_window(window_t *win) {
     kprintf("[COMPOSITOR] Destroying window %u: \"%s\"\n", win->id, win->title);
 
     /* Mark dirty region where window was */
-    int total_w, total_h;
-    compositor_get_window_total_size(win, &total_w, &total_h);
-    compositor_invalidate(win->x, win->y, total_w, total_h);
+    compositor_invalidate_window(win);
 
     /* Unlink from list */
     compositor_unlink_window(win);
@@ -244,16 +260,14 @@ void compositor_move_window(window_t *win, int x, int y) {
     }
 
     /* Mark old position dirty */
-    int total_w, total_h;
-    compositor_get_window_total_size(win, &total_w, &total_h);
-    compositor_invalidate(win->x, win->y, total_w, total_h);
+    compositor_invalidate_window(win);
 
     /* Update position */
     win->x = x;
     win->y = y;
 
     /* Mark new position dirty */
-    compositor_invalidate(win->x, win->y, total_w, total_h);
+    compositor_invalidate_window(win);
 }
 
 /**
@@ -275,9 +289,7 @@ int compositor_resize_window(window_t *win, int w, int h) {
     }
 
     /* Mark old area dirty */
-    int total_w, total_h;
-    compositor_get_window_total_size(win, &total_w, &total_h);
-    compositor_invalidate(win->x, win->y, total_w, total_h);
+    compositor_invalidate_window(win);
 
     /* Allocate new buffer */
     size_t new_size = (size_t)w * h * sizeof(uint32_t);
@@ -288,17 +300,13 @@ int compositor_resize_window(window_t *win, int w, int h) {
     }
 
     /* Clear new buffer */
-    for (int i = 0; i < w * h; i++) {
-        new_buffer[i] = 0xFFFFFFFF;
-    }
+    pixel_fill_span(new_buffer, 0xFFFFFFFF, (size_t)w * h);
 
     /* Copy old content (as much as fits) */
     int copy_w = MIN(win->width, w);
     int copy_h = MIN(win->height, h);
     for (int row = 0; row < copy_h; row++) {
-        memcpy(&new_buffer[row * w],
-               &win->buffer[row * win->width],
-               copy_w * sizeof(uint32_t));
+        pixel_copy_span(&new_buffer[row * w], &win->buffer[row * win->width], (size_t)copy_w);
     }
 
     /* Free old buffer and update */
@@ -308,8 +316,7 @@ int compositor_resize_window(window_t *win, int w, int h) {
     win->height = h;
 
     /* Mark new area dirty */
-    compositor_get_window_total_size(win, &total_w, &total_h);
-    compositor_invalidate(win->x, win->y, total_w, total_h);
+    compositor_invalidate_window(win);
 
     kprintf("[COMPOSITOR] Resized window %u to %d x %d\n", win->id, w, h);
     return 0;
@@ -337,9 +344,7 @@ void compositor_raise_window(window_t *win) {
     compositor_set_active_window(win);
 
     /* Mark window area dirty */
-    int total_w, total_h;
-    compositor_get_window_total_size(win, &total_w, &total_h);
-    compositor_invalidate(win->x, win->y, total_w, total_h);
+    compositor_invalidate_window(win);
 
     kprintf("[COMPOSITOR] Raised window %u to front (z=%d)\n", win->id, win->z_order);
 }
@@ -390,11 +395,7 @@ void compositor_set_active_window(window_t *win) {
         g_compositor.active_window->flags &= ~WINDOW_FLAG_ACTIVE;
 
         /* Mark old active window dirty (title bar changed) */
-        int total_w, total_h;
-        compositor_get_window_total_size(g_compositor.active_window, &total_w, &total_h);
-        compositor_invalidate(g_compositor.active_window->x,
-                             g_compositor.active_window->y,
-                             total_w, total_h);
+        compositor_invalidate_window(g_compositor.active_window);
     }
 
     /* Activate new window */
@@ -403,9 +404,7 @@ void compositor_set_active_window(window_t *win) {
         win->flags |= WINDOW_FLAG_ACTIVE;
 
         /* Mark new active window dirty */
-        int total_w, total_h;
-        compositor_get_window_total_size(win, &total_w, &total_h);
-        compositor_invalidate(win->x, win->y, total_w, total_h);
+        compositor_invalidate_window(win);
     }
 }
 
@@ -424,23 +423,54 @@ void compositor_render(void) {
         return;
     }
 
-    /* Draw desktop background */
-    compositor_draw_desktop_background();
+    /* Windows flagged dirty repaint their content area */
+    for (window_t *win = g_compositor.window_list; win; win = win->next) {
+        if (win->flags & WINDOW_FLAG_DIRTY) {
+            win->flags &= ~WINDOW_FLAG_DIRTY;
+            compositor_invalidate(win->x, win->y, win->width, win->height);
+        }
+    }
 
-    /* Draw windows from back to front (lowest z_order first) */
-    window_t *win = g_compositor.window_list;
-    while (win) {
-        if (win->flags & WINDOW_FLAG_VISIBLE && !(win->flags & WINDOW_FLAG_MINIMIZED)) {
-            compositor_draw_window(win);
+    if (g_compositor.damage_count == 0) {
+        return;
+    }
+
+    /*
+     * Each damage rectangle is recomposited from the background up, back
+     * to front (lowest z_order first). Every layer is drawn only where no
+     * opaque window above it covers the rectangle, so each pixel is
+     * written once unless a transparent window lies over it.
+     */
+    compositor_region_t region;
+    for (uint32_t i = 0; i < g_compositor.damage_count; i++) {
+        const dirty_rect_t *clip = &g_compositor.damage[i];
+
+        compositor_visible_region(clip, g_compositor.window_list, &region);
+        for (uint32_t r = 0; r < region.count; r++) {
+            compositor_draw_desktop_background(&region.rects[r]);
+        }
+
+        window_t *win = g_compositor.window_list;
+        while (win) {
+            if (win->flags & WINDOW_FLAG_VISIBLE && !(win->flags & WINDOW_FLAG_MINIMIZED)) {
+                dirty_rect_t area;
+                compositor_window_bounds(win, &area);
+                if (compositor_rect_clip(&area.x, &area.y, &area.width, &area.height, clip)) {
+                    compositor_visible_region(&area, win->next, &region);
+                    for (uint32_t r = 0; r < region.count; r++) {
+                        compositor_draw_window(win, &region.rects[r]);
+                    }
+                }
+            }
+            win = win->next;
         }
-        win = win->next;
     }
 
-    /* Swap buffers (copy back buffer to front buffer) */
+    /* Copy the damaged regions of the back buffer to the front buffer */
     compositor_swap_buffers();
 
-    /* Clear dirty region */
-    g_compositor.dirty_region.valid = false;
+    /* Clear damage */
+    g_compositor.damage_count = 0;
     g_compositor.needs_full_redraw = false;
 
     g_compositor.frame_count++;
@@ -468,23 +498,8 @@ void compositor_invalidate(int x, int y, int w, int h) {
         return;
     }
 
-    /* Merge with existing dirty region */
-    if (g_compositor.dirty_region.valid) {
-        int x1 = MIN(g_compositor.dirty_region.x, x);
-        int y1 = MIN(g_compositor.dirty_region.y, y);
-        int x2 = MAX(g_compositor.dirty_region.x + g_compositor.dirty_region.width, x + w);
-        int y2 = MAX(g_compositor.dirty_region.y + g_compositor.dirty_region.height, y + h);
-        g_compositor.dirty_region.x = x1;
-        g_compositor.dirty_region.y = y1;
-        g_compositor.dirty_region.width = x2 - x1;
-        g_compositor.dirty_region.height = y2 - y1;
-    } else {
-        g_compositor.dirty_region.x = x;
-        g_compositor.dirty_region.y = y;
-        g_compositor.dirty_region.width = w;
-        g_compositor.dirty_region.height = h;
-        g_compositor.dirty_region.valid = true;
-    }
+    dirty_rect_t rect = { .x = x, .y = y, .width = w, .height = h, .valid = true };
+    compositor_add_damage(rect);
 }
 
 /**
@@ -492,11 +507,12 @@ void compositor_invalidate(int x, int y, int w, int h) {
  */
 void compositor_invalidate_all(void) {
     g_compositor.needs_full_redraw = true;
-    g_compositor.dirty_region.x = 0;
-    g_compositor.dirty_region.y = 0;
-    g_compositor.dirty_region.width = g_compositor.screen_width;
-    g_compositor.dirty_region.height = g_compositor.screen_height;
-    g_compositor.dirty_region.valid = true;
+    g_compositor.damage[0].x = 0;
+    g_compositor.damage[0].y = 0;
+    g_compositor.damage[0].width = g_compositor.screen_width;
+    g_compositor.damage[0].height = g_compositor.screen_height;
+    g_compositor.damage[0].valid = true;
+    g_compositor.damage_count = 1;
 }
 
 /**
@@ -563,13 +579,7 @@ void compositor_set_window_visible(window_t *win, bool visible) {
     }
 
     /* Mark window area dirty */
-    int total_w, total_h;
-    compositor_get_window_total_size(win, &total_w, &total_h);
-    int win_y = win->y;
-    if (win->flags & WINDOW_FLAG_DECORATED) {
-        win_y -= WINDOW_TITLE_BAR_HEIGHT;
-    }
-    compositor_invalidate(win->x, win_y, total_w, total_h);
+    compositor_invalidate_window(win);
 }
 
 /**
@@ -711,48 +721,297 @@ void compositor_get_window_content_pos(window_t *win, int *content_x, int *conte
  * ============================================================================ */
 
 /**
- * Draw desktop background
+ * Get the screen rectangle covering everything drawn for a window
+ * The title bar sits above (x, y) and the left border left of x, so this
+ * is wider and taller than compositor_get_window_total_size() at (x, y).
  */
-static void compositor_draw_desktop_background(void) {
-    uint32_t *buffer = g_compositor.back_buffer;
-    uint32_t width = g_compositor.screen_width;
-    uint32_t height = g_compositor.screen_height;
+static void compositor_window_bounds(window_t *win, dirty_rect_t *bounds) {
+    bounds->x = win->x;
+    bounds->y = win->y;
+    bounds->width = win->width;
+    bounds->height = win->height;
+    bounds->valid = true;
 
-    /* Fill with solid color for now */
-    for (uint32_t i = 0; i < width * height; i++) {
-        buffer[i] = DESKTOP_BACKGROUND_COLOR;
+    if (win->flags & WINDOW_FLAG_DECORATED) {
+        /* Left border at x - border, title bar out to x + width + 2 * border */
+        bounds->x -= WINDOW_BORDER_WIDTH;
+        bounds->y -= WINDOW_TITLE_BAR_HEIGHT;
+        bounds->width += 3 * WINDOW_BORDER_WIDTH;
+        bounds->height += WINDOW_TITLE_BAR_HEIGHT + WINDOW_BORDER_WIDTH;
     }
 }
 
+/**
+ * Mark everything a window draws dirty
+ */
+static void compositor_invalidate_window(window_t *win) {
+    dirty_rect_t bounds;
+    compositor_window_bounds(win, &bounds);
+    compositor_invalidate(bounds.x, bounds.y, bounds.width, bounds.height);
+}
+
+/**
+ * Number of pixels a rectangle covers
+ */
+static inline int64_t compositor_rect_area(const dirty_rect_t *r) {
+    return (int64_t)r->width * r->height;
+}
+
+/**
+ * Bounding box of two rectangles
+ * @return Pixels the bounding box covers that neither rectangle does
+ */
+static int64_t compositor_rect_union(const dirty_rect_t *a, const dirty_rect_t *b,
+                                     dirty_rect_t *out) {
+    int x1 = MIN(a->x, b->x);
+    int y1 = MIN(a->y, b->y);
+    int x2 = MAX(a->x + a->width, b->x + b->width);
+    int y2 = MAX(a->y + a->height, b->y + b->height);
+
+    out->x = x1;
+    out->y = y1;
+    out->width = x2 - x1;
+    out->height = y2 - y1;
+    out->valid = true;
+
+    /* Pixels both cover are painted once by the union, twice separately */
+    int64_t overlap = 0;
+    int ix1 = MAX(a->x, b->x);
+    int iy1 = MAX(a->y, b->y);
+    int ix2 = MIN(a->x + a->width, b->x + b->width);
+    int iy2 = MIN(a->y + a->height, b->y + b->height);
+    if (ix2 > ix1 && iy2 > iy1) {
+        overlap = (int64_t)(ix2 - ix1) * (iy2 - iy1);
+    }
+
+    return compositor_rect_area(out) -
+           (compositor_rect_area(a) + compositor_rect_area(b) - overlap);
+}
+
+/**
+ * Add a clipped rectangle to the damage list
+ *
+ * Every rectangle costs a pass over the window list and a run of short
+ * row copies, so a rectangle is folded into the existing one whose
+ * bounding box wastes the fewest pixels, as long as that waste stays
+ * within COMPOSITOR_DAMAGE_MERGE_SLACK; a rectangle inside another one
+ * merges for free. The grown rectangle is tried against the rest again.
+ * When the list is full the cheapest merge is taken whatever it costs.
+ */
+static void compositor_add_damage(dirty_rect_t rect) {
+    for (;;) {
+        int best = -1;
+        int64_t best_waste = 0;
+        dirty_rect_t best_union;
+
+        for (uint32_t i = 0; i < g_compositor.damage_count; i++) {
+            dirty_rect_t merged;
+            int64_t waste = compositor_rect_union(&g_compositor.damage[i], &rect, &merged);
+            if (best < 0 || waste < best_waste) {
+                best = (int)i;
+                best_waste = waste;
+                best_union = merged;
+            }
+        }
+
+        if (best < 0 ||
+            (best_waste > COMPOSITOR_DAMAGE_MERGE_SLACK &&
+             g_compositor.damage_count < COMPOSITOR_MAX_DAMAGE_RECTS)) {
+            break;
+        }
+
+        /* Take the entry out and retry with the union */
+        rect = best_union;
+        g_compositor.damage[best] = g_compositor.damage[--g_compositor.damage_count];
+    }
+
+    g_compositor.damage[g_compositor.damage_count++] = rect;
+}
+
+/**
+ * Intersect two rectangles
+ * @return false if they do not overlap
+ */
+static bool compositor_rect_clip(int *x, int *y, int *w, int *h, const dirty_rect_t *clip) {
+    int x1 = MAX(*x, clip->x);
+    int y1 = MAX(*y, clip->y);
+    int x2 = MIN(*x + *w, clip->x + clip->width);
+    int y2 = MIN(*y + *h, clip->y + clip->height);
+
+    if (x2 <= x1 || y2 <= y1) {
+        return false;
+    }
+
+    *x = x1;
+    *y = y1;
+    *w = x2 - x1;
+    *h = y2 - y1;
+    return true;
+}
+
+/**
+ * Get the parts of a window that are always drawn opaque
+ * The title bar and the borders around the content form two rectangles;
+ * the corners of compositor_window_bounds() beside the title bar are
+ * never drawn. Transparent windows cover nothing.
+ * @return Number of rectangles stored in opaque (0 to 2)
+ */
+static int compositor_window_opaque(window_t *win, dirty_rect_t opaque[2]) {
+    if (!(win->flags & WINDOW_FLAG_VISIBLE) || (win->flags & WINDOW_FLAG_MINIMIZED) ||
+        (win->flags & WINDOW_FLAG_TRANSPARENT)) {
+        return 0;
+    }
+
+    opaque[0].x = win->x;
+    opaque[0].y = win->y;
+    opaque[0].width = win->width;
+    opaque[0].height = win->height;
+    opaque[0].valid = true;
+
+    if (!(win->flags & WINDOW_FLAG_DECORATED)) {
+        return 1;
+    }
+
+    /* Content with left, right and bottom borders */
+    opaque[0].x -= WINDOW_BORDER_WIDTH;
+    opaque[0].width += 2 * WINDOW_BORDER_WIDTH;
+    opaque[0].height += WINDOW_BORDER_WIDTH;
+
+    /* Title bar */
+    opaque[1].x = win->x;
+    opaque[1].y = win->y - WINDOW_TITLE_BAR_HEIGHT;
+    opaque[1].width = win->width + 2 * WINDOW_BORDER_WIDTH;
+    opaque[1].height = WINDOW_TITLE_BAR_HEIGHT;
+    opaque[1].valid = true;
+    return 2;
+}
+
+/**
+ * Remove a rectangle from a region
+ * Each overlapped rectangle is split into the parts above, below, left
+ * and right of the hole. If the pieces do not fit, the rectangle is kept
+ * whole: the region then over-covers, which costs overdraw but is still
+ * correct because the windows above are drawn afterwards.
+ */
+static void compositor_region_subtract(compositor_region_t *region, const dirty_rect_t *hole) {
+    uint32_t i = 0;
+    while (i < region->count) {
+        dirty_rect_t r = region->rects[i];
+        int x = hole->x;
+        int y = hole->y;
+        int w = hole->width;
+        int h = hole->height;
+
+        if (!compositor_rect_clip(&x, &y, &w, &h, &r)) {
+            i++;
+            continue;
+        }
+
+        dirty_rect_t pieces[4] = {
+            { r.x, r.y, r.width, y - r.y, true },                          /* Above */
+            { r.x, y + h, r.width, r.y + r.height - (y + h), true },       /* Below */
+            { r.x, y, x - r.x, h, true },                                  /* Left */
+            { x + w, y, r.x + r.width - (x + w), h, true },                /* Right */
+        };
+
+        uint32_t needed = 0;
+        for (int p = 0; p < 4; p++) {
+            if (pieces[p].width > 0 && pieces[p].height > 0) {
+                needed++;
+            }
+        }
+        if (region->count - 1 + needed > COMPOSITOR_MAX_REGION_RECTS) {
+            i++;
+            continue;
+        }
+
+        /* Replace the rectangle with its pieces; they miss the hole */
+        region->rects[i] = region->rects[--region->count];
+        for (int p = 0; p < 4; p++) {
+            if (pieces[p].width > 0 && pieces[p].height > 0) {
+                region->rects[region->count++] = pieces[p];
+            }
+        }
+    }
+}
+
+/**
+ * Compute the part of an area not covered by opaque windows
+ * @param area Screen rectangle, already clipped to the damage
+ * @param above First window whose opaque parts are removed; it and every
+ *        window after it in the list (all higher in Z-order) are applied
+ * @param region Output region
+ */
+static void compositor_visible_region(const dirty_rect_t *area, window_t *above,
+                                      compositor_region_t *region) {
+    region->rects[0] = *area;
+    region->count = 1;
+
+    for (window_t *win = above; win && region->count > 0; win = win->next) {
+        dirty_rect_t opaque[2];
+        int n = compositor_window_opaque(win, opaque);
+        for (int i = 0; i < n; i++) {
+            compositor_region_subtract(region, &opaque[i]);
+        }
+    }
+}
+
+/**
+ * Fill a rectangle of the back buffer, clipped to a damage rectangle
+ */
+static void compositor_fill_rect(int x, int y, int w, int h, uint32_t color,
+                                 const dirty_rect_t *clip) {
+    if (!compositor_rect_clip(&x, &y, &w, &h, clip)) {
+        return;
+    }
+
+    int screen_w = (int)g_compositor.screen_width;
+    for (int row = y; row < y + h; row++) {
+        pixel_fill_span(&g_compositor.back_buffer[row * screen_w + x], color, (size_t)w);
+    }
+}
+
+/**
+ * Draw desktop background
+ */
+static void compositor_draw_desktop_background(const dirty_rect_t *clip) {
+    /* Fill with solid color for now */
+    compositor_fill_rect(clip->x, clip->y, clip->width, clip->height,
+                         DESKTOP_BACKGROUND_COLOR, clip);
+}
+
 /**
  * Draw a single window (decorations + content)
  */
-static void compositor_draw_window(window_t *win) {
+static void compositor_draw_window(window_t *win, const dirty_rect_t *clip) {
     if (!win) {
         return;
     }
 
+    /* Skip windows outside the damage rectangle */
+    dirty_rect_t bounds;
+    compositor_window_bounds(win, &bounds);
+    if (!compositor_rect_clip(&bounds.x, &bounds.y, &bounds.width, &bounds.height, clip)) {
+        return;
+    }
+
     /* Draw decorations first (below content) */
     if (win->flags & WINDOW_FLAG_DECORATED) {
-        compositor_draw_window_decorations(win);
+        compositor_draw_window_decorations(win, clip);
     }
 
     /* Then blit window buffer */
-    compositor_blit_window_buffer(win);
+    compositor_blit_window_buffer(win, clip);
 }
 
 /**
  * Draw window decorations (title bar, borders)
  */
-static void compositor_draw_window_decorations(window_t *win) {
+static void compositor_draw_window_decorations(window_t *win, const dirty_rect_t *clip) {
     if (!win || !(win->flags & WINDOW_FLAG_DECORATED)) {
         return;
     }
 
-    uint32_t *buffer = g_compositor.back_buffer;
-    int screen_w = (int)g_compositor.screen_width;
-    int screen_h = (int)g_compositor.screen_height;
-
     int total_w, total_h;
     compositor_get_window_total_size(win, &total_w, &total_h);
 
@@ -769,13 +1028,7 @@ static void compositor_draw_window_decorations(window_t *win) {
                             WINDOW_BORDER_ACTIVE : WINDOW_BORDER_COLOR;
 
     /* Draw title bar */
-    for (int y = title_y; y < title_y + title_h; y++) {
-        if (y < 0 || y >= screen_h) continue;
-        for (int x = title_x; x < title_x + title_w; x++) {
-            if (x < 0 || x >= screen_w) continue;
-            buffer[y * screen_w + x] = title_color;
-        }
-    }
+    compositor_fill_rect(title_x, title_y, title_w, title_h, title_color, clip);
 
     /* Draw title text */
     if (win->title[0] != '\0') {
@@ -785,14 +1038,7 @@ static void compositor_draw_window_decorations(window_t *win) {
         /* Simple text rendering - each character is 8 pixels wide */
         for (int i = 0; win->title[i] && text_x < title_x + title_w - 60; i++) {
             /* Draw character placeholder (actual font rendering would go here) */
-            for (int cy = 0; cy < 12 && text_y + cy < screen_h; cy++) {
-                if (text_y + cy < 0) continue;
-                for (int cx = 0; cx < 7 && text_x + cx < screen_w; cx++) {
-                    if (text_x + cx < 0) continue;
-                    /* Simple character representation */
-                    buffer[(text_y + cy) * screen_w + (text_x + cx)] = WINDOW_TITLE_TEXT_COLOR;
-                }
-            }
+            compositor_fill_rect(text_x, text_y, 7, 12, WINDOW_TITLE_TEXT_COLOR, clip);
             text_x += 8;
         }
     }
@@ -800,118 +1046,114 @@ static void compositor_draw_window_decorations(window_t *win) {
     /* Draw window close button (red X in top-right) */
     int btn_x = title_x + title_w - WINDOW_BUTTON_SIZE - WINDOW_BUTTON_PADDING;
     int btn_y = title_y + (WINDOW_TITLE_BAR_HEIGHT - WINDOW_BUTTON_SIZE) / 2;
-
-    for (int y = btn_y; y < btn_y + WINDOW_BUTTON_SIZE && y < screen_h; y++) {
-        if (y < 0) continue;
-        for (int x = btn_x; x < btn_x + WINDOW_BUTTON_SIZE && x < screen_w; x++) {
-            if (x < 0) continue;
-            buffer[y * screen_w + x] = 0xFFFF4444;  /* Red */
-        }
-    }
+    compositor_fill_rect(btn_x, btn_y, WINDOW_BUTTON_SIZE, WINDOW_BUTTON_SIZE,
+                         0xFFFF4444, clip);  /* Red */
 
     /* Draw left border */
-    for (int y = win->y; y < win->y + win->height + WINDOW_BORDER_WIDTH && y < screen_h; y++) {
-        if (y < 0) continue;
-        for (int x = win->x - WINDOW_BORDER_WIDTH; x < win->x && x < screen_w; x++) {
-            if (x < 0) continue;
-            buffer[y * screen_w + x] = border_color;
-        }
-    }
+    compositor_fill_rect(win->x - WINDOW_BORDER_WIDTH, win->y,
+                         WINDOW_BORDER_WIDTH, win->height + WINDOW_BORDER_WIDTH,
+                         border_color, clip);
 
     /* Draw right border */
-    for (int y = win->y; y < win->y + win->height + WINDOW_BORDER_WIDTH && y < screen_h; y++) {
-        if (y < 0) continue;
-        for (int x = win->x + win->width; x < win->x + win->width + WINDOW_BORDER_WIDTH && x < screen_w; x++) {
-            if (x < 0) continue;
-            buffer[y * screen_w + x] = border_color;
-        }
-    }
+    compositor_fill_rect(win->x + win->width, win->y,
+                         WINDOW_BORDER_WIDTH, win->height + WINDOW_BORDER_WIDTH,
+                         border_color, clip);
 
     /* Draw bottom border */
-    for (int y = win->y + win->height; y < win->y + win->height + WINDOW_BORDER_WIDTH && y < screen_h; y++) {
-        if (y < 0) continue;
-        for (int x = win->x - WINDOW_BORDER_WIDTH; x < win->x + win->width + WINDOW_BORDER_WIDTH && x < screen_w; x++) {
-            if (x < 0) continue;
-            buffer[y * screen_w + x] = border_color;
-        }
-    }
+    compositor_fill_rect(win->x - WINDOW_BORDER_WIDTH, win->y + win->height,
+                         win->width + 2 * WINDOW_BORDER_WIDTH, WINDOW_BORDER_WIDTH,
+                         border_color, clip);
 }
 
 /**
  * Blit window buffer to back buffer with optional alpha blending
  */
-static void compositor_blit_window_buffer(window_t *win) {
+static void compositor_blit_window_buffer(window_t *win, const dirty_rect_t *clip) {
     if (!win || !win->buffer) {
         return;
     }
 
-    uint32_t *dst = g_compositor.back_buffer;
-    uint32_t *src = win->buffer;
-    int screen_w = (int)g_compositor.screen_width;
-    int screen_h = (int)g_compositor.screen_height;
+    int x = win->x;
+    int y = win->y;
+    int w = win->width;
+    int h = win->height;
+    if (!compositor_rect_clip(&x, &y, &w, &h, clip)) {
+        return;
+    }
 
+    int screen_w = (int)g_compositor.screen_width;
     bool use_alpha = (win->flags & WINDOW_FLAG_TRANSPARENT) != 0;
 
-    for (int row = 0; row < win->height; row++) {
-        int dst_y = win->y + row;
-        if (dst_y < 0 || dst_y >= screen_h) continue;
+    for (int row = y; row < y + h; row++) {
+        uint32_t *dst = &g_compositor.back_buffer[row * screen_w + x];
+        const uint32_t *src = &win->buffer[(row - win->y) * win->width + (x - win->x)];
 
-        for (int col = 0; col < win->width; col++) {
-            int dst_x = win->x + col;
-            if (dst_x < 0 || dst_x >= screen_w) continue;
-
-            uint32_t pixel = src[row * win->width + col];
-            int dst_idx = dst_y * screen_w + dst_x;
+        if (use_alpha) {
+            pixel_blend_span(dst, src, (size_t)w);
+        } else {
+            pixel_copy_span(dst, src, (size_t)w);
+        }
+    }
+}
 
-            if (use_alpha) {
-                uint8_t alpha = FB_GET_ALPHA(pixel);
-                if (alpha == 255) {
-                    dst[dst_idx] = pixel;
-                } else if (alpha > 0) {
-                    dst[dst_idx] = alpha_blend(pixel, dst[dst_idx]);
-                }
-                /* alpha == 0: fully transparent, don't draw */
-            } else {
-                dst[dst_idx] = pixel;
-            }
+/**
+ * Copy rectangles of the back buffer to a framebuffer page
+ */
+static void compositor_copy_rects(uint32_t *dst, const dirty_rect_t *rects, uint32_t count) {
+    uint32_t screen_w = g_compositor.screen_width;
+    uint32_t pitch = g_compositor.front_pitch;
+
+    for (uint32_t i = 0; i < count; i++) {
+        const dirty_rect_t *r = &rects[i];
+        for (int row = r->y; row < r->y + r->height; row++) {
+            pixel_copy_span(&dst[(uint32_t)row * pitch + r->x],
+                            &g_compositor.back_buffer[(uint32_t)row * screen_w + r->x],
+                            (size_t)r->width);
         }
+        g_compositor.pixels_presented += (uint64_t)compositor_rect_area(r);
     }
 }
 
 /**
- * Swap back buffer to front buffer
+ * Present the damaged regions of the back buffer
  */
 static void compositor_swap_buffers(void) {
     if (!g_compositor.back_buffer || !g_compositor.front_buffer) {
         return;
     }
 
-    /* Copy entire back buffer to front buffer */
-    size_t buffer_size = g_compositor.screen_width * g_compositor.screen_height * sizeof(uint32_t);
-    memcpy(g_compositor.front_buffer, g_compositor.back_buffer, buffer_size);
-}
+    if (!g_compositor.page_flip) {
+        compositor_copy_rects(g_compositor.front_buffer,
+                              g_compositor.damage, g_compositor.damage_count);
+        return;
+    }
 
-/**
- * Alpha blend foreground over background
- * Returns blended color
- */
-static uint32_t alpha_blend(uint32_t fg, uint32_t bg) {
-    uint8_t fg_a = FB_GET_ALPHA(fg);
-    uint8_t fg_r = FB_GET_RED(fg);
-    uint8_t fg_g = FB_GET_GREEN(fg);
-    uint8_t fg_b = FB_GET_BLUE(fg);
+    /*
+     * The page off screen was presented two frames ago, so it also lacks
+     * what the previous frame changed. Bring both up to date there, then
+     * scan it out. fb_flip() switches pages inside the vertical retrace,
+     * so the page left behind is off screen by the time the next frame
+     * is copied into it.
+     */
+    const framebuffer_t *fb = fb_get_info();
+    uint32_t hidden = (fb->front_page + 1) % fb->page_count;
+    uint32_t *page = fb_get_page(hidden);
+    if (!page) {
+        return;
+    }
 
-    uint8_t bg_r = FB_GET_RED(bg);
-    uint8_t bg_g = FB_GET_GREEN(bg);
-    uint8_t bg_b = FB_GET_BLUE(bg);
+    compositor_copy_rects(page, g_compositor.flip_damage, g_compositor.flip_damage_count);
+    compositor_copy_rects(page, g_compositor.damage, g_compositor.damage_count);
 
-    /* Standard alpha blending: out = fg * alpha + bg * (1 - alpha) */
-    uint8_t inv_a = 255 - fg_a;
-    uint8_t out_r = (fg_r * fg_a + bg_r * inv_a) / 255;
-    uint8_t out_g = (fg_g * fg_a + bg_g * inv_a) / 255;
-    uint8_t out_b = (fg_b * fg_a + bg_b * inv_a) / 255;
+    if (fb_flip(hidden) == 0) {
+        g_compositor.front_buffer = page;
+        g_compositor.page_flips++;
+    }
 
-    return FB_MAKE_COLOR(255, out_r, out_g, out_b);
+    for (uint32_t i = 0; i < g_compositor.damage_count; i++) {
+        g_compositor.flip_damage[i] = g_compositor.damage[i];
+    }
+    g_compositor.flip_damage_count = g_compositor.damage_count;
 }
 
 /**
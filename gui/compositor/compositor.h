@@ -29,6 +29,11 @@
 #define WINDOW_BORDER_COLOR         0xFF404040  /* Dark gray border */
 #define WINDOW_BORDER_ACTIVE        0xFF5588FF  /* Highlighted border for active */
 
+/* Damage tracking */
+#define COMPOSITOR_MAX_DAMAGE_RECTS 16      /* Damage rectangles kept per frame */
+#define COMPOSITOR_DAMAGE_MERGE_SLACK 4096  /* Overdraw (pixels) worth saving a rectangle */
+#define COMPOSITOR_MAX_REGION_RECTS 32      /* Rectangles in a visible region */
+
 /* Desktop background color */
 #define DESKTOP_BACKGROUND_COLOR    0xFF2B5278  /* Dark blue */
 
@@ -103,7 +108,12 @@ typedef struct compositor {
     uint32_t next_window_id;                /* Next available window ID */
     int32_t next_z_order;                   /* Next available Z-order value */
 
-    dirty_rect_t dirty_region;              /* Current dirty region */
+    dirty_rect_t damage[COMPOSITOR_MAX_DAMAGE_RECTS]; /* Regions to repaint next frame */
+    uint32_t damage_count;                  /* Valid entries in damage[] */
+    uint32_t front_pitch;                   /* Front buffer scanline in pixels */
+    bool page_flip;                         /* Present by flipping framebuffer pages */
+    dirty_rect_t flip_damage[COMPOSITOR_MAX_DAMAGE_RECTS]; /* Last frame's damage */
+    uint32_t flip_damage_count;             /* Valid entries in flip_damage[] */
     bool needs_full_redraw;                 /* Flag for full screen redraw */
     bool initialized;                       /* Compositor initialization status */
 
@@ -111,6 +121,8 @@ typedef struct compositor {
     uint64_t frame_count;                   /* Number of frames rendered */
     uint64_t windows_created;               /* Total windows created */
     uint64_t windows_destroyed;             /* Total windows destroyed */
+    uint64_t pixels_presented;              /* Pixels copied to the front buffer */
+    uint64_t page_flips;                    /* Frames presented by page flip */
 } compositor_t;
 
 /**
@@ -186,12 +198,18 @@ window_t *compositor_get_active_window(void);
 
 /**
  * Render all windows to the screen
- * Performs compositing and copies back buffer to front buffer
+ * Only the damaged regions are recomposited and copied from the back
+ * buffer to the front buffer; with no damage this does nothing. If the
+ * framebuffer has two pages they go to the page off screen, which is
+ * then flipped to.
  */
 void compositor_render(void);
 
 /**
  * Mark a rectangular region as dirty (needs redraw)
+ * The region joins the damage list, merged with an existing rectangle
+ * when the union repaints at most COMPOSITOR_DAMAGE_MERGE_SLACK pixels
+ * that neither covers.
  * @param x Region X coordinate
  * @param y Region Y coordinate
  * @param w Region width
@@ -17,6 +17,9 @@ static idt_descriptor_t idt_descriptor;
 /* Registered interrupt handlers */
 static interrupt_handler_t handlers[IDT_ENTRIES];
 
+/* Handlers chained on the legacy IRQ lines, which PCI devices may share */
+static interrupt_handler_t shared_handlers[IRQ_LINES][IDT_MAX_SHARED_HANDLERS];
+
 /* Exception messages */
 static const char *exception_messages[] = {
     "Division By Zero",
@@ -160,6 +163,11 @@ void idt_init(void) {
     for (int i = 0; i < IDT_ENTRIES; i++) {
         handlers[i] = NULL;
     }
+    for (int i = 0; i < IRQ_LINES; i++) {
+        for (int j = 0; j < IDT_MAX_SHARED_HANDLERS; j++) {
+            shared_handlers[i][j] = NULL;
+        }
+    }
 
     /* Set up CPU exception handlers (ISRs 0-31) */
     idt_set_gate(0, (uint64_t)isr0, GDT_KERNEL_CODE, IDT_GATE_INTERRUPT);
@@ -234,12 +242,46 @@ void idt_register_handler(uint8_t vector, interrupt_handler_t handler) {
     handlers[vector] = handler;
 }
 
+/**
+ * Add a handler to the chain of a shared IRQ line
+ */
+int idt_register_shared_handler(uint8_t vector, interrupt_handler_t handler) {
+    if (vector < IRQ_BASE || vector >= IRQ_BASE + IRQ_LINES || handler == NULL) {
+        return -1;
+    }
+
+    interrupt_handler_t *chain = shared_handlers[vector - IRQ_BASE];
+    for (int i = 0; i < IDT_MAX_SHARED_HANDLERS; i++) {
+        if (chain[i] == handler) {
+            return 0;
+        }
+    }
+    for (int i = 0; i < IDT_MAX_SHARED_HANDLERS; i++) {
+        if (chain[i] == NULL) {
+            chain[i] = handler;
+            return 0;
+        }
+    }
+
+    kprintf("[IDT] No free shared handler slot on IRQ %d\n", vector - IRQ_BASE);
+    return -1;
+}
+
 /**
  * Common interrupt handler (called from assembly)
  */
 void interrupt_handler(interrupt_frame_t *frame) {
     uint64_t int_no = frame->int_no;
 
+    /* Shared handlers first: every device on the line checks its own
+     * status, and they run before an exclusive handler can switch away */
+    if (int_no >= IRQ_BASE && int_no < IRQ_BASE + IRQ_LINES) {
+        interrupt_handler_t *chain = shared_handlers[int_no - IRQ_BASE];
+        for (int i = 0; i < IDT_MAX_SHARED_HANDLERS && chain[i] != NULL; i++) {
+            chain[i](frame);
+        }
+    }
+
     /* Call registered handler if present */
     if (handlers[int_no] != NULL) {
         handlers[int_no](frame);
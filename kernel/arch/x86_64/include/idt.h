@@ -49,6 +49,10 @@
 #define IRQ_FPU         (IRQ_BASE + 13)
 #define IRQ_ATA1        (IRQ_BASE + 14)
 #define IRQ_ATA2        (IRQ_BASE + 15)
+#define IRQ_LINES       16
+
+/* Devices that can share one legacy IRQ line (PCI INTx) */
+#define IDT_MAX_SHARED_HANDLERS 4
 
 /* IDT gate types */
 #define IDT_GATE_INTERRUPT  0x8E    /* P=1, DPL=0, Interrupt gate */
@@ -113,6 +117,16 @@ void idt_init(void);
  */
 void idt_register_handler(uint8_t vector, interrupt_handler_t handler);
 
+/**
+ * Add a handler to a hardware IRQ line shared with other devices
+ * Every handler on the line runs on each interrupt, so each must check
+ * whether its own device raised it. Registering a handler twice is a no-op.
+ * @param vector Interrupt vector number (IRQ_BASE to IRQ_BASE + 15)
+ * @param handler Function to call when the line fires
+ * @return 0 on success, -1 if the vector is not an IRQ or the line is full
+ */
+int idt_register_shared_handler(uint8_t vector, interrupt_handler_t handler);
+
 /**
  * Enable/disable interrupts
  */
@@ -0,0 +1,196 @@
+/**
+ * AAAos Kernel - Static Tracepoints
+ *
+ * Hot-path events (block I/O, packets) are recorded as fixed-size binary
+ * records in a ring buffer instead of being printed to the serial port.
+ * Every tracepoint is compiled in and enabled at runtime per subsystem;
+ * a disabled tracepoint costs one load and a not-taken branch.
+ *
+ * Records are only formatted when the buffer is dumped, using the
+ * event's format string:
+ *   %u  unsigned decimal      %d  signed decimal
+ *   %x  hexadecimal           %I  IPv4 address (host order)
+ *   %M  MAC address (6 bytes packed into the low 48 bits, first byte highest)
+ */
+
+#ifndef _AAAOS_TRACE_H
+#define _AAAOS_TRACE_H
+
+#include "types.h"
+
+/* Ring buffer size in records (power of 2) */
+#define TRACE_BUFFER_RECORDS    4096
+#define TRACE_MAX_ARGS          4
+
+/**
+ * Subsystems, each enabled independently
+ */
+typedef enum {
+    TRACE_AHCI = 0,
+    TRACE_BLOCK,
+    TRACE_E1000,
+    TRACE_VIRTIO_NET,
+    TRACE_ETH,
+    TRACE_ARP,
+    TRACE_IP,
+    TRACE_UDP,
+    TRACE_TCP,
+    TRACE_SUBSYS_COUNT
+} trace_subsys_t;
+
+/**
+ * Tracepoints
+ * Names and format strings live in trace.c, in the same order.
+ */
+typedef enum {
+    /* AHCI */
+    TRACE_AHCI_SUBMIT = 0,          /* port, op, lba, count */
+    TRACE_AHCI_COMPLETE,            /* port, op, lba, status */
+    TRACE_AHCI_FLUSH,               /* port */
+
+    /* Block layer */
+    TRACE_BLK_QUEUE,                /* op, lba, count */
+    TRACE_BLK_MERGE,                /* op, lba, count, request lba */
+    TRACE_BLK_ISSUE,                /* op, lba, count, segments */
+    TRACE_BLK_COMPLETE,             /* op, lba, count, status */
+
+    /* e1000 */
+    TRACE_E1000_TX,                 /* descriptor, length */
+    TRACE_E1000_RX,                 /* descriptor, length */
+    TRACE_E1000_IRQ,                /* ICR */
+
+    /* virtio-net */
+    TRACE_VNET_TX,                  /* queue pair, length */
+    TRACE_VNET_RX,                  /* queue pair, length, buffers */
+
+    /* Ethernet */
+    TRACE_ETH_TX,                   /* destination, type, length */
+    TRACE_ETH_RX,                   /* source, type, length */
+    TRACE_ETH_DROP,                 /* destination */
+
+    /* ARP */
+    TRACE_ARP_RX,                   /* operation, sender IP, sender MAC */
+    TRACE_ARP_REQUEST,              /* target IP */
+    TRACE_ARP_REPLY,                /* target IP, our MAC */
+    TRACE_ARP_UPDATE,               /* IP, MAC */
+
+    /* IPv4 */
+    TRACE_IP_TX,                    /* source, destination, protocol, length */
+    TRACE_IP_RX,                    /* source, destination, protocol, length */
+    TRACE_IP_DROP,                  /* destination */
+    TRACE_IP_ARP_WAIT,              /* next hop */
+
+    /* UDP */
+    TRACE_UDP_TX,                   /* destination, port, source port, length */
+    TRACE_UDP_RX,                   /* source, port, destination port, length */
+    TRACE_UDP_NO_SOCKET,            /* port */
+
+    /* TCP */
+    TRACE_TCP_RX,                   /* source, port, destination port, flags */
+    TRACE_TCP_DATA,                 /* bytes */
+    TRACE_TCP_RETRANSMIT,           /* attempt */
+
+    TRACE_EVENT_COUNT
+} trace_event_t;
+
+/**
+ * Trace record (48 bytes)
+ */
+typedef struct {
+    uint64_t    tsc;                        /* Timestamp counter */
+    uint16_t    event;                      /* trace_event_t */
+    uint16_t    seq;                        /* Low bits of the record number */
+    uint32_t    reserved;
+    uint64_t    args[TRACE_MAX_ARGS];
+} trace_record_t;
+
+/* Bit per enabled subsystem (read inline by every tracepoint) */
+extern volatile uint32_t trace_mask;
+
+/**
+ * Read the CPU timestamp counter
+ */
+static inline uint64_t trace_clock(void) {
+    uint32_t lo, hi;
+    __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/**
+ * Pack a MAC address into a trace argument (for %M)
+ */
+static inline uint64_t trace_mac(const uint8_t *mac) {
+    uint64_t v = 0;
+    for (int i = 0; i < 6; i++) {
+        v = (v << 8) | mac[i];
+    }
+    return v;
+}
+
+/**
+ * Check whether a subsystem is being traced
+ */
+#define TRACE_ON(sys)   __builtin_expect((trace_mask & (1U << (sys))) != 0, 0)
+
+/**
+ * Record an event if its subsystem is enabled
+ * Unused arguments may be given as 0. Safe in interrupt context.
+ */
+#define TRACE(sys, event, a0, a1, a2, a3)                                   \
+    do {                                                                    \
+        if (TRACE_ON(sys)) {                                                \
+            trace_record((event), (uint64_t)(a0), (uint64_t)(a1),           \
+                         (uint64_t)(a2), (uint64_t)(a3));                   \
+        }                                                                   \
+    } while (0)
+
+/**
+ * Append a record to the ring buffer (use the TRACE macro)
+ */
+void trace_record(trace_event_t event, uint64_t a0, uint64_t a1,
+                  uint64_t a2, uint64_t a3);
+
+/**
+ * Enable or disable tracing of a subsystem
+ * @param sys Subsystem
+ * @param on New state
+ */
+void trace_enable(trace_subsys_t sys, bool on);
+
+/**
+ * Look up a subsystem by name ("ahci", "block", "e1000", "eth", "arp",
+ * "ip", "udp", "tcp")
+ * @param name Subsystem name
+ * @return Subsystem, or -1 if unknown
+ */
+int trace_subsys_find(const char *name);
+
+/**
+ * Get the name of a subsystem
+ * @param sys Subsystem
+ * @return Name, or "?" if out of range
+ */
+const char* trace_subsys_name(trace_subsys_t sys);
+
+/**
+ * Discard all buffered records
+ */
+void trace_clear(void);
+
+/**
+ * Copy raw records out of the ring buffer, oldest first
+ * @param pos In: first record number wanted; out: next record number
+ *            (records overwritten in the meantime are skipped)
+ * @param out Destination
+ * @param max Capacity of out in records
+ * @return Number of records copied
+ */
+uint32_t trace_read(uint64_t *pos, trace_record_t *out, uint32_t max);
+
+/**
+ * Format the newest records to the serial console
+ * @param max Maximum number of records (0 for the whole buffer)
+ */
+void trace_dump(uint32_t max);
+
+#endif /* _AAAOS_TRACE_H */
@@ -14,17 +14,33 @@
 /* Kernel PML4 (root of kernel page tables) */
 static physaddr_t kernel_pml4_phys = 0;
 
+/* PAT programmed with VMM_PAT_KERNEL */
+static bool vmm_pat_ready = false;
+
 /* Simple spinlock for VMM operations */
 static volatile int vmm_lock = 0;
 
-static inline void vmm_acquire_lock(void) {
+/* RFLAGS interrupt enable bit */
+#define VMM_RFLAGS_IF           (1 << 9)
+
+/*
+ * The lock is taken with interrupts disabled: drivers translate DMA
+ * buffers with vmm_get_physical() from their completion handlers.
+ */
+static inline uint64_t vmm_acquire_lock(void) {
+    uint64_t flags;
+    __asm__ __volatile__("pushfq; pop %0; cli" : "=r"(flags) : : "memory");
     while (__sync_lock_test_and_set(&vmm_lock, 1)) {
         __asm__ __volatile__("pause");
     }
+    return flags;
 }
 
-static inline void vmm_release_lock(void) {
+static inline void vmm_release_lock(uint64_t flags) {
     __sync_lock_release(&vmm_lock);
+    if (flags & VMM_RFLAGS_IF) {
+        __asm__ __volatile__("sti");
+    }
 }
 
 /**
@@ -50,6 +66,45 @@ static inline void invlpg(virtaddr_t addr) {
     __asm__ __volatile__("invlpg (%0)" :: "r"(addr) : "memory");
 }
 
+/**
+ * Read/write a model-specific register
+ */
+static inline uint64_t vmm_rdmsr(uint32_t msr) {
+    uint32_t lo, hi;
+    __asm__ __volatile__("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void vmm_wrmsr(uint32_t msr, uint64_t value) {
+    __asm__ __volatile__("wrmsr" :: "c"(msr), "a"((uint32_t)value),
+                         "d"((uint32_t)(value >> 32)) : "memory");
+}
+
+/**
+ * Program the PAT so VMM_FLAG_WRITECOMBINE selects write-combining
+ * Only entry 4 changes, and no mapping uses it before this runs (the PAT
+ * bit is never set before), so the caches need no flush; the TLB flush
+ * drops any translation cached with the old attributes.
+ */
+static void vmm_init_pat(void) {
+    uint32_t eax, ebx, ecx, edx;
+    __asm__ __volatile__("cpuid"
+                         : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx)
+                         : "a"(1));
+    if (!(edx & BIT(16))) {
+        kprintf("[VMM] No PAT support, write-combining mappings will be uncached\n");
+        return;
+    }
+
+    uint64_t old_pat = vmm_rdmsr(VMM_MSR_PAT);
+    vmm_wrmsr(VMM_MSR_PAT, VMM_PAT_KERNEL);
+    write_cr3(read_cr3());
+    vmm_pat_ready = true;
+
+    kprintf("[VMM] PAT 0x%016llx -> 0x%016llx (entry 4 write-combining)\n",
+            old_pat, (uint64_t)VMM_PAT_KERNEL);
+}
+
 /**
  * Convert physical address to virtual address (direct mapping)
  * In the kernel, we use a direct mapping region where:
@@ -176,6 +231,9 @@ static pte_t* vmm_walk(physaddr_t pml4_phys, virtaddr_t virt,
 void vmm_init(void) {
     kprintf("[VMM] Initializing Virtual Memory Manager...\n");
 
+    /* Memory types first, so every mapping below can use them */
+    vmm_init_pat();
+
     /* Allocate kernel PML4 */
     kernel_pml4_phys = alloc_page_table();
     if (kernel_pml4_phys == 0) {
@@ -232,12 +290,17 @@ bool vmm_map_page(virtaddr_t virt, physaddr_t phys, uint64_t flags) {
         pml4 = read_cr3() & VMM_ADDR_MASK;
     }
 
-    vmm_acquire_lock();
+    /* Without the kernel PAT, entry 4 is WB: fall back to UC- */
+    if ((flags & VMM_FLAG_WRITECOMBINE) && !vmm_pat_ready) {
+        flags = (flags & ~VMM_FLAG_WRITECOMBINE) | VMM_FLAG_NOCACHE;
+    }
+
+    uint64_t lock_flags = vmm_acquire_lock();
 
     /* Walk page tables, creating as needed */
     pte_t *pte = vmm_walk(pml4, virt, true, flags);
     if (pte == NULL) {
-        vmm_release_lock();
+        vmm_release_lock(lock_flags);
         kprintf("[VMM] Error: Failed to walk/create page tables for 0x%llx\n",
                 (uint64_t)virt);
         return false;
@@ -255,7 +318,7 @@ bool vmm_map_page(virtaddr_t virt, physaddr_t phys, uint64_t flags) {
     /* Set the page table entry */
     *pte = (phys & VMM_ADDR_MASK) | (flags & ~VMM_ADDR_MASK) | VMM_FLAG_PRESENT;
 
-    vmm_release_lock();
+    vmm_release_lock(lock_flags);
 
     /* Invalidate TLB for this page */
     invlpg(virt);
@@ -282,6 +345,34 @@ bool vmm_map_pages(virtaddr_t virt, physaddr_t phys, size_t count, uint64_t flag
     return true;
 }
 
+/**
+ * Map device memory into the direct physical map
+ */
+virtaddr_t vmm_map_mmio(physaddr_t phys, size_t size, uint64_t flags) {
+    if (size == 0) {
+        return 0;
+    }
+
+    physaddr_t start = ALIGN_DOWN(phys, VMM_PAGE_SIZE);
+    physaddr_t end = ALIGN_UP(phys + size, VMM_PAGE_SIZE);
+    size_t count = (end - start) / VMM_PAGE_SIZE;
+
+    if (!vmm_map_pages(VMM_KERNEL_PHYS_MAP + start, start, count, flags)) {
+        kprintf("[VMM] Error: Failed to map MMIO 0x%llx (%llu bytes)\n",
+                (uint64_t)phys, (uint64_t)size);
+        return 0;
+    }
+
+    return VMM_KERNEL_PHYS_MAP + phys;
+}
+
+/**
+ * Check whether the PAT holds the kernel's memory types
+ */
+bool vmm_pat_enabled(void) {
+    return vmm_pat_ready;
+}
+
 /**
  * Unmap a virtual page
  */
@@ -297,12 +388,12 @@ physaddr_t vmm_unmap_page(virtaddr_t virt) {
         pml4 = read_cr3() & VMM_ADDR_MASK;
     }
 
-    vmm_acquire_lock();
+    uint64_t lock_flags = vmm_acquire_lock();
 
     /* Walk page tables without creating */
     pte_t *pte = vmm_walk(pml4, virt, false, 0);
     if (pte == NULL || !(*pte & VMM_FLAG_PRESENT)) {
-        vmm_release_lock();
+        vmm_release_lock(lock_flags);
         return 0;  /* Not mapped */
     }
 
@@ -312,7 +403,7 @@ physaddr_t vmm_unmap_page(virtaddr_t virt) {
     /* Clear the entry */
     *pte = 0;
 
-    vmm_release_lock();
+    vmm_release_lock(lock_flags);
 
     /* Invalidate TLB */
     invlpg(virt);
@@ -329,11 +420,11 @@ physaddr_t vmm_get_physical(virtaddr_t virt) {
         pml4 = read_cr3() & VMM_ADDR_MASK;
     }
 
-    vmm_acquire_lock();
+    uint64_t lock_flags = vmm_acquire_lock();
 
     pte_t *pte = vmm_walk(pml4, virt, false, 0);
 
-    vmm_release_lock();
+    vmm_release_lock(lock_flags);
 
     if (pte == NULL || !(*pte & VMM_FLAG_PRESENT)) {
         return 0;  /* Not mapped */
@@ -438,7 +529,7 @@ void vmm_destroy_address_space(physaddr_t pml4_phys) {
 
     kprintf("[VMM] Destroying address space at 0x%llx\n", (uint64_t)pml4_phys);
 
-    vmm_acquire_lock();
+    uint64_t lock_flags = vmm_acquire_lock();
 
     /* Free user-space page tables (first 256 entries only) */
     /* Don't free kernel mappings as they're shared */
@@ -447,7 +538,7 @@ void vmm_destroy_address_space(physaddr_t pml4_phys) {
     /* Free the PML4 itself */
     pmm_free_page(pml4_phys);
 
-    vmm_release_lock();
+    vmm_release_lock(lock_flags);
 }
 
 /**
@@ -497,11 +588,11 @@ bool vmm_is_mapped(virtaddr_t virt) {
         pml4 = read_cr3() & VMM_ADDR_MASK;
     }
 
-    vmm_acquire_lock();
+    uint64_t lock_flags = vmm_acquire_lock();
 
     pte_t *pte = vmm_walk(pml4, virt, false, 0);
 
-    vmm_release_lock();
+    vmm_release_lock(lock_flags);
 
     return (pte != NULL) && (*pte & VMM_FLAG_PRESENT);
 }
@@ -29,6 +29,7 @@
 #define VMM_FLAG_ACCESSED       BIT(5)   /* Page has been accessed */
 #define VMM_FLAG_DIRTY          BIT(6)   /* Page has been written to */
 #define VMM_FLAG_HUGE           BIT(7)   /* Huge page (2MB in PD, 1GB in PDPT) */
+#define VMM_FLAG_PAT            BIT(7)   /* PAT index bit 2 (4KB PTE, same bit as HUGE) */
 #define VMM_FLAG_GLOBAL         BIT(8)   /* Global page (not flushed on CR3 switch) */
 #define VMM_FLAG_NX             BIT(63)  /* No-execute (requires NX bit enabled) */
 
@@ -38,6 +39,29 @@
 #define VMM_FLAGS_USER          (VMM_FLAG_PRESENT | VMM_FLAG_WRITE | VMM_FLAG_USER)
 #define VMM_FLAGS_USER_RO       (VMM_FLAG_PRESENT | VMM_FLAG_USER)
 #define VMM_FLAGS_MMIO          (VMM_FLAG_PRESENT | VMM_FLAG_WRITE | VMM_FLAG_NOCACHE)
+#define VMM_FLAGS_MMIO_WC       (VMM_FLAG_PRESENT | VMM_FLAG_WRITE | VMM_FLAG_WRITECOMBINE)
+
+/*
+ * Memory types. PWT, PCD and PAT select one of eight PAT entries. The
+ * kernel keeps entries 0-3 at their reset values (WB, WT, UC-, UC), so
+ * VMM_FLAG_WRITETHROUGH and VMM_FLAG_NOCACHE mean what they always did,
+ * and sets entry 4 to write-combining. Stores to WC pages are buffered
+ * and sent as bursts; use it for framebuffers and prefetchable BARs,
+ * never for device registers.
+ */
+#define VMM_FLAG_WRITECOMBINE   VMM_FLAG_PAT    /* PAT entry 4: write-combining */
+
+#define VMM_MSR_PAT             0x277
+#define VMM_PAT_UC              0x00
+#define VMM_PAT_WC              0x01
+#define VMM_PAT_WT              0x04
+#define VMM_PAT_WB              0x06
+#define VMM_PAT_UC_MINUS        0x07
+#define VMM_PAT_ENTRY(i, type)  ((uint64_t)(type) << ((i) * 8))
+#define VMM_PAT_KERNEL          (VMM_PAT_ENTRY(0, VMM_PAT_WB) | VMM_PAT_ENTRY(1, VMM_PAT_WT) | \
+                                 VMM_PAT_ENTRY(2, VMM_PAT_UC_MINUS) | VMM_PAT_ENTRY(3, VMM_PAT_UC) | \
+                                 VMM_PAT_ENTRY(4, VMM_PAT_WC) | VMM_PAT_ENTRY(5, VMM_PAT_WT) | \
+                                 VMM_PAT_ENTRY(6, VMM_PAT_UC_MINUS) | VMM_PAT_ENTRY(7, VMM_PAT_UC))
 
 /* Page table constants */
 #define VMM_PAGE_SIZE           4096
@@ -80,11 +104,19 @@ typedef struct ALIGNED(VMM_PAGE_SIZE) {
 
 /**
  * Initialize the Virtual Memory Manager
- * Sets up kernel page tables with identity mapping for low memory
- * and higher-half mapping for kernel.
+ * Programs the PAT, then sets up kernel page tables with identity mapping
+ * for low memory and higher-half mapping for kernel.
  */
 void vmm_init(void);
 
+/**
+ * Check whether the PAT holds the kernel's memory types
+ * If not, VMM_FLAG_WRITECOMBINE mappings are made uncached (UC-) instead;
+ * a WC range in the MTRRs still makes them write-combining.
+ * @return true if VMM_FLAG_WRITECOMBINE gives write-combining pages
+ */
+bool vmm_pat_enabled(void);
+
 /**
  * Map a virtual page to a physical page
  * @param virt Virtual address (page-aligned)
@@ -104,6 +136,18 @@ bool vmm_map_page(virtaddr_t virt, physaddr_t phys, uint64_t flags);
  */
 bool vmm_map_pages(virtaddr_t virt, physaddr_t phys, size_t count, uint64_t flags);
 
+/**
+ * Map device memory into the direct physical map
+ * The range lands at VMM_KERNEL_PHYS_MAP + phys, like other physical
+ * memory the kernel touches.
+ * @param phys Physical address (need not be page-aligned)
+ * @param size Size in bytes
+ * @param flags VMM_FLAGS_MMIO for registers, VMM_FLAGS_MMIO_WC for
+ *        framebuffers and prefetchable BARs
+ * @return Virtual address of phys, or 0 on failure
+ */
+virtaddr_t vmm_map_mmio(physaddr_t phys, size_t size, uint64_t flags);
+
 /**
  * Unmap a virtual page
  * @param virt Virtual address to unmap (page-aligned)
@@ -113,6 +157,7 @@ physaddr_t vmm_unmap_page(virtaddr_t virt);
 
 /**
  * Get physical address for a virtual address
+ * Safe to call from interrupt handlers.
  * @param virt Virtual address to translate
  * @return Physical address, or 0 if not mapped
  */
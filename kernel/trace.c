@@ -0,0 +1,316 @@
+/**
+ * AAAos Kernel - Static Tracepoints
+ *
+ * Binary ring buffer and the decoder used to print it.
+ */
+
+#include "include/trace.h"
+#include "include/serial.h"
+
+#define TRACE_BUFFER_MASK   (TRACE_BUFFER_RECORDS - 1)
+#define TRACE_LINE_MAX      160
+
+/**
+ * Static description of a tracepoint
+ */
+typedef struct {
+    const char  *name;
+    const char  *format;
+} trace_event_info_t;
+
+/* Global state */
+volatile uint32_t trace_mask = 0;
+
+static trace_record_t trace_buffer[TRACE_BUFFER_RECORDS];
+static volatile uint64_t trace_head = 0;    /* Records ever written */
+
+static const char *trace_subsys_names[TRACE_SUBSYS_COUNT] = {
+    [TRACE_AHCI]          = "ahci",
+    [TRACE_BLOCK]         = "block",
+    [TRACE_E1000]         = "e1000",
+    [TRACE_VIRTIO_NET]    = "virtio_net",
+    [TRACE_ETH]           = "eth",
+    [TRACE_ARP]           = "arp",
+    [TRACE_IP]            = "ip",
+    [TRACE_UDP]           = "udp",
+    [TRACE_TCP]           = "tcp",
+};
+
+static const trace_event_info_t trace_events[TRACE_EVENT_COUNT] = {
+    [TRACE_AHCI_SUBMIT]     = { "ahci_submit",     "port=%u op=%u lba=%u count=%u" },
+    [TRACE_AHCI_COMPLETE]   = { "ahci_complete",   "port=%u op=%u lba=%u status=%d" },
+    [TRACE_AHCI_FLUSH]      = { "ahci_flush",      "port=%u" },
+
+    [TRACE_BLK_QUEUE]       = { "blk_queue",       "op=%u lba=%u count=%u" },
+    [TRACE_BLK_MERGE]       = { "blk_merge",       "op=%u lba=%u count=%u into=%u" },
+    [TRACE_BLK_ISSUE]       = { "blk_issue",       "op=%u lba=%u count=%u segs=%u" },
+    [TRACE_BLK_COMPLETE]    = { "blk_complete",    "op=%u lba=%u count=%u status=%d" },
+
+    [TRACE_E1000_TX]        = { "e1000_tx",        "desc=%u len=%u" },
+    [TRACE_E1000_RX]        = { "e1000_rx",        "desc=%u len=%u" },
+    [TRACE_E1000_IRQ]       = { "e1000_irq",       "icr=%x" },
+
+    [TRACE_VNET_TX]         = { "vnet_tx",         "pair=%u len=%u" },
+    [TRACE_VNET_RX]         = { "vnet_rx",         "pair=%u len=%u bufs=%u" },
+
+    [TRACE_ETH_TX]          = { "eth_tx",          "dst=%M type=%x len=%u" },
+    [TRACE_ETH_RX]          = { "eth_rx",          "src=%M type=%x len=%u" },
+    [TRACE_ETH_DROP]        = { "eth_drop",        "dst=%M" },
+
+    [TRACE_ARP_RX]          = { "arp_rx",          "op=%u spa=%I sha=%M" },
+    [TRACE_ARP_REQUEST]     = { "arp_request",     "tpa=%I" },
+    [TRACE_ARP_REPLY]       = { "arp_reply",       "tpa=%I sha=%M" },
+    [TRACE_ARP_UPDATE]      = { "arp_update",      "ip=%I mac=%M" },
+
+    [TRACE_IP_TX]           = { "ip_tx",           "%I -> %I proto=%u len=%u" },
+    [TRACE_IP_RX]           = { "ip_rx",           "%I -> %I proto=%u len=%u" },
+    [TRACE_IP_DROP]         = { "ip_drop",         "dst=%I" },
+    [TRACE_IP_ARP_WAIT]     = { "ip_arp_wait",     "next_hop=%I" },
+
+    [TRACE_UDP_TX]          = { "udp_tx",          "dst=%I:%u sport=%u len=%u" },
+    [TRACE_UDP_RX]          = { "udp_rx",          "src=%I:%u dport=%u len=%u" },
+    [TRACE_UDP_NO_SOCKET]   = { "udp_no_socket",   "port=%u" },
+
+    [TRACE_TCP_RX]          = { "tcp_rx",          "src=%I:%u dport=%u flags=%x" },
+    [TRACE_TCP_DATA]        = { "tcp_data",        "bytes=%u" },
+    [TRACE_TCP_RETRANSMIT]  = { "tcp_retransmit",  "attempt=%u" },
+};
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================ */
+
+static int trace_strcmp(const char *a, const char *b) {
+    while (*a && *a == *b) {
+        a++;
+        b++;
+    }
+    return (uint8_t)*a - (uint8_t)*b;
+}
+
+/**
+ * Line buffer for decoding a record
+ */
+typedef struct {
+    char    buf[TRACE_LINE_MAX];
+    size_t  len;
+} trace_line_t;
+
+static void trace_putc(trace_line_t *line, char c) {
+    if (line->len + 1 < TRACE_LINE_MAX) {
+        line->buf[line->len++] = c;
+    }
+}
+
+static void trace_put_unsigned(trace_line_t *line, uint64_t value, unsigned base,
+                               int min_digits) {
+    static const char digits[] = "0123456789abcdef";
+    char tmp[24];
+    int n = 0;
+
+    do {
+        tmp[n++] = digits[value % base];
+        value /= base;
+    } while (value != 0 && n < (int)sizeof(tmp));
+
+    while (n < min_digits) {
+        tmp[n++] = '0';
+    }
+    while (n > 0) {
+        trace_putc(line, tmp[--n]);
+    }
+}
+
+/**
+ * Format a record's arguments with its event's format string
+ */
+static void trace_format(trace_line_t *line, const char *fmt, const uint64_t *args) {
+    int arg = 0;
+
+    for (; *fmt; fmt++) {
+        if (*fmt != '%' || fmt[1] == '\0') {
+            trace_putc(line, *fmt);
+            continue;
+        }
+
+        fmt++;
+        uint64_t v = (arg < TRACE_MAX_ARGS) ? args[arg++] : 0;
+
+        switch (*fmt) {
+            case 'u':
+                trace_put_unsigned(line, v, 10, 1);
+                break;
+
+            case 'd':
+                if ((int64_t)v < 0) {
+                    trace_putc(line, '-');
+                    v = (uint64_t)(-(int64_t)v);
+                }
+                trace_put_unsigned(line, v, 10, 1);
+                break;
+
+            case 'x':
+                trace_putc(line, '0');
+                trace_putc(line, 'x');
+                trace_put_unsigned(line, v, 16, 1);
+                break;
+
+            case 'I':
+                for (int i = 3; i >= 0; i--) {
+                    trace_put_unsigned(line, (v >> (i * 8)) & 0xFF, 10, 1);
+                    if (i > 0) {
+                        trace_putc(line, '.');
+                    }
+                }
+                break;
+
+            case 'M':
+                for (int i = 5; i >= 0; i--) {
+                    trace_put_unsigned(line, (v >> (i * 8)) & 0xFF, 16, 2);
+                    if (i > 0) {
+                        trace_putc(line, ':');
+                    }
+                }
+                break;
+
+            default:
+                trace_putc(line, '%');
+                trace_putc(line, *fmt);
+                arg--;
+                break;
+        }
+    }
+
+    line->buf[line->len] = '\0';
+}
+
+/* ============================================================================
+ * Public API
+ * ============================================================================ */
+
+void trace_record(trace_event_t event, uint64_t a0, uint64_t a1,
+                  uint64_t a2, uint64_t a3) {
+    uint64_t n = __sync_fetch_and_add(&trace_head, 1);
+    trace_record_t *r = &trace_buffer[n & TRACE_BUFFER_MASK];
+
+    /* Mark the slot invalid while it is rewritten */
+    r->event = TRACE_EVENT_COUNT;
+    __asm__ __volatile__("" ::: "memory");
+
+    r->tsc = trace_clock();
+    r->args[0] = a0;
+    r->args[1] = a1;
+    r->args[2] = a2;
+    r->args[3] = a3;
+    r->seq = (uint16_t)n;
+    __asm__ __volatile__("" ::: "memory");
+    r->event = (uint16_t)event;
+}
+
+void trace_enable(trace_subsys_t sys, bool on) {
+    if ((unsigned)sys >= TRACE_SUBSYS_COUNT) {
+        return;
+    }
+
+    if (on) {
+        __sync_fetch_and_or(&trace_mask, 1U << sys);
+    } else {
+        __sync_fetch_and_and(&trace_mask, ~(1U << sys));
+    }
+}
+
+int trace_subsys_find(const char *name) {
+    if (!name) {
+        return -1;
+    }
+
+    for (int i = 0; i < TRACE_SUBSYS_COUNT; i++) {
+        if (trace_strcmp(trace_subsys_names[i], name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+const char* trace_subsys_name(trace_subsys_t sys) {
+    if ((unsigned)sys >= TRACE_SUBSYS_COUNT) {
+        return "?";
+    }
+    return trace_subsys_names[sys];
+}
+
+void trace_clear(void) {
+    /* Advancing past every slot makes old records unreadable */
+    uint64_t head = trace_head;
+    for (uint32_t i = 0; i < TRACE_BUFFER_RECORDS; i++) {
+        trace_buffer[i].event = TRACE_EVENT_COUNT;
+    }
+    __sync_fetch_and_add(&trace_head, TRACE_BUFFER_RECORDS - (head & TRACE_BUFFER_MASK));
+}
+
+uint32_t trace_read(uint64_t *pos, trace_record_t *out, uint32_t max) {
+    if (!pos || !out) {
+        return 0;
+    }
+
+    uint64_t head = trace_head;
+    uint64_t oldest = (head > TRACE_BUFFER_RECORDS) ? head - TRACE_BUFFER_RECORDS : 0;
+    uint32_t n = 0;
+
+    if (*pos < oldest) {
+        *pos = oldest;
+    }
+
+    while (*pos < head && n < max) {
+        trace_record_t r = trace_buffer[*pos & TRACE_BUFFER_MASK];
+
+        /* Skip slots being rewritten or already reused */
+        if (r.event < TRACE_EVENT_COUNT && r.seq == (uint16_t)*pos) {
+            out[n++] = r;
+        }
+        (*pos)++;
+    }
+
+    return n;
+}
+
+void trace_dump(uint32_t max) {
+    uint64_t head = trace_head;
+    uint64_t pos = 0;
+
+    if (max == 0 || max > TRACE_BUFFER_RECORDS) {
+        max = TRACE_BUFFER_RECORDS;
+    }
+    if (head > max) {
+        pos = head - max;
+    }
+
+    kprintf("[TRACE] Enabled:");
+    for (int i = 0; i < TRACE_SUBSYS_COUNT; i++) {
+        if (trace_mask & (1U << i)) {
+            kprintf(" %s", trace_subsys_names[i]);
+        }
+    }
+    kprintf("%s\n", trace_mask ? "" : " none");
+
+    trace_record_t batch[16];
+    uint64_t base = 0;
+    bool first = true;
+    uint32_t got;
+
+    while (pos < head && (got = trace_read(&pos, batch, 16)) > 0) {
+        for (uint32_t i = 0; i < got; i++) {
+            const trace_event_info_t *info = &trace_events[batch[i].event];
+            trace_line_t line;
+            line.len = 0;
+
+            if (first) {
+                base = batch[i].tsc;
+                first = false;
+            }
+
+            trace_format(&line, info->format, batch[i].args);
+            kprintf("[TRACE] +%llu %s %s\n", batch[i].tsc - base, info->name, line.buf);
+        }
+    }
+}
@@ -4,6 +4,7 @@
 
 #include "arp.h"
 #include "../../kernel/include/serial.h"
+#include "../../kernel/include/trace.h"
 #include "../../lib/libc/string.h"
 #include "../ip/ip.h"
 
@@ -54,10 +55,6 @@ int arp_lookup(uint32_t ip, uint8_t mac_out[ETH_ALEN]) {
     }
 
     /* Not found - send ARP request */
-    kprintf("[ARP] Cache miss for %u.%u.%u.%u, sending request\n",
-            ip_octet(ip, 0), ip_octet(ip, 1),
-            ip_octet(ip, 2), ip_octet(ip, 3));
-
     /* Create pending entry */
     if (entry == NULL) {
         entry = arp_cache_alloc();
@@ -103,11 +100,7 @@ int arp_request(uint32_t ip) {
     memset(pkt.tha, 0, ETH_ALEN);  /* Unknown */
     pkt.tpa = htonl(ip);
 
-    kprintf("[ARP] Request: Who has %u.%u.%u.%u? Tell %u.%u.%u.%u\n",
-            ip_octet(ip, 0), ip_octet(ip, 1),
-            ip_octet(ip, 2), ip_octet(ip, 3),
-            ip_octet(our_ip, 0), ip_octet(our_ip, 1),
-            ip_octet(our_ip, 2), ip_octet(our_ip, 3));
+    TRACE(TRACE_ARP, TRACE_ARP_REQUEST, ip, 0, 0, 0);
 
     /* Send as broadcast */
     return eth_send(broadcast_mac, ETH_TYPE_ARP, &pkt, sizeof(pkt));
@@ -141,11 +134,7 @@ int arp_reply(uint32_t dest_ip, const uint8_t dest_mac[ETH_ALEN]) {
     eth_mac_copy(pkt.tha, dest_mac);
     pkt.tpa = htonl(dest_ip);
 
-    kprintf("[ARP] Reply: %u.%u.%u.%u is at %02x:%02x:%02x:%02x:%02x:%02x\n",
-            ip_octet(our_ip, 0), ip_octet(our_ip, 1),
-            ip_octet(our_ip, 2), ip_octet(our_ip, 3),
-            our_mac[0], our_mac[1], our_mac[2],
-            our_mac[3], our_mac[4], our_mac[5]);
+    TRACE(TRACE_ARP, TRACE_ARP_REPLY, dest_ip, trace_mac(our_mac), 0, 0);
 
     /* Send directly to requester */
     return eth_send(dest_mac, ETH_TYPE_ARP, &pkt, sizeof(pkt));
@@ -183,12 +172,7 @@ int arp_receive(const void *packet, size_t len) {
     tpa = ntohl(pkt->tpa);
     our_ip = ip_get_addr();
 
-    kprintf("[ARP] RX: op=%u spa=%u.%u.%u.%u sha=%02x:%02x:%02x:%02x:%02x:%02x\n",
-            op,
-            ip_octet(spa, 0), ip_octet(spa, 1),
-            ip_octet(spa, 2), ip_octet(spa, 3),
-            pkt->sha[0], pkt->sha[1], pkt->sha[2],
-            pkt->sha[3], pkt->sha[4], pkt->sha[5]);
+    TRACE(TRACE_ARP, TRACE_ARP_RX, op, spa, trace_mac(pkt->sha), 0);
 
     /* Update cache with sender's info (if we already have an entry) */
     arp_entry_t *entry = arp_cache_find(spa);
@@ -202,18 +186,11 @@ int arp_receive(const void *packet, size_t len) {
         case ARP_OP_REQUEST:
             /* Is this for us? */
             if (tpa == our_ip) {
-                kprintf("[ARP] Request for our IP, sending reply\n");
                 return arp_reply(spa, pkt->sha);
             }
             break;
 
         case ARP_OP_REPLY:
-            kprintf("[ARP] Reply received: %u.%u.%u.%u is at "
-                    "%02x:%02x:%02x:%02x:%02x:%02x\n",
-                    ip_octet(spa, 0), ip_octet(spa, 1),
-                    ip_octet(spa, 2), ip_octet(spa, 3),
-                    pkt->sha[0], pkt->sha[1], pkt->sha[2],
-                    pkt->sha[3], pkt->sha[4], pkt->sha[5]);
             /* Cache was already updated above */
             break;
 
@@ -257,11 +234,7 @@ int arp_cache_add(uint32_t ip, const uint8_t mac[ETH_ALEN]) {
     entry->timestamp = arp_time;
     entry->retries = 0;
 
-    kprintf("[ARP] Cache updated: %u.%u.%u.%u -> "
-            "%02x:%02x:%02x:%02x:%02x:%02x\n",
-            ip_octet(ip, 0), ip_octet(ip, 1),
-            ip_octet(ip, 2), ip_octet(ip, 3),
-            mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    TRACE(TRACE_ARP, TRACE_ARP_UPDATE, ip, trace_mac(mac), 0, 0);
 
     return 0;
 }
@@ -4,6 +4,7 @@
 
 #include "ethernet.h"
 #include "../../kernel/include/serial.h"
+#include "../../kernel/include/trace.h"
 #include "../../lib/libc/string.h"
 #include "../arp/arp.h"
 #include "../ip/ip.h"
@@ -80,13 +81,7 @@ int eth_send(const uint8_t dest_mac[ETH_ALEN], uint16_t ethertype,
         frame_len = ETH_FRAME_MIN;
     }
 
-    kprintf("[ETH] TX: %02x:%02x:%02x:%02x:%02x:%02x -> "
-            "%02x:%02x:%02x:%02x:%02x:%02x type=0x%04x len=%u\n",
-            local_mac[0], local_mac[1], local_mac[2],
-            local_mac[3], local_mac[4], local_mac[5],
-            dest_mac[0], dest_mac[1], dest_mac[2],
-            dest_mac[3], dest_mac[4], dest_mac[5],
-            ethertype, (uint32_t)frame_len);
+    TRACE(TRACE_ETH, TRACE_ETH_TX, trace_mac(dest_mac), ethertype, frame_len, 0);
 
     /* Send via hardware driver */
     return eth_hw_send(frame, frame_len);
@@ -129,13 +124,7 @@ int eth_send_buf(netbuf_t *buf, const uint8_t dest_mac[ETH_ALEN],
     eth_mac_copy(buf->dst_mac, dest_mac);
     buf->protocol = ethertype;
 
-    kprintf("[ETH] TX: %02x:%02x:%02x:%02x:%02x:%02x -> "
-            "%02x:%02x:%02x:%02x:%02x:%02x type=0x%04x len=%u\n",
-            local_mac[0], local_mac[1], local_mac[2],
-            local_mac[3], local_mac[4], local_mac[5],
-            dest_mac[0], dest_mac[1], dest_mac[2],
-            dest_mac[3], dest_mac[4], dest_mac[5],
-            ethertype, (uint32_t)buf->len);
+    TRACE(TRACE_ETH, TRACE_ETH_TX, trace_mac(dest_mac), ethertype, buf->len, 0);
 
     /* Send via hardware driver */
     return eth_hw_send(buf->data, buf->len);
@@ -162,19 +151,13 @@ int eth_receive(const void *packet, size_t len) {
     payload = (const uint8_t *)packet + ETH_HLEN;
     payload_len = len - ETH_HLEN;
 
-    kprintf("[ETH] RX: %02x:%02x:%02x:%02x:%02x:%02x -> "
-            "%02x:%02x:%02x:%02x:%02x:%02x type=0x%04x len=%u\n",
-            hdr->src_mac[0], hdr->src_mac[1], hdr->src_mac[2],
-            hdr->src_mac[3], hdr->src_mac[4], hdr->src_mac[5],
-            hdr->dest_mac[0], hdr->dest_mac[1], hdr->dest_mac[2],
-            hdr->dest_mac[3], hdr->dest_mac[4], hdr->dest_mac[5],
-            ethertype, (uint32_t)len);
+    TRACE(TRACE_ETH, TRACE_ETH_RX, trace_mac(hdr->src_mac), ethertype, len, 0);
 
     /* Check if frame is for us */
     if (!eth_is_broadcast(hdr->dest_mac) &&
         !eth_mac_equal(hdr->dest_mac, local_mac)) {
         /* Not for us - in promiscuous mode we might still process it */
-        kprintf("[ETH] Frame not for us, dropping\n");
+        TRACE(TRACE_ETH, TRACE_ETH_DROP, trace_mac(hdr->dest_mac), 0, 0, 0);
         return 0;
     }
 
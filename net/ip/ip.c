@@ -4,6 +4,7 @@
 
 #include "ip.h"
 #include "../../kernel/include/serial.h"
+#include "../../kernel/include/trace.h"
 #include "../../lib/libc/string.h"
 #include "../ethernet/ethernet.h"
 #include "../arp/arp.h"
@@ -146,12 +147,7 @@ int ip_send(uint32_t dest_ip, uint8_t protocol, const void *data, size_t len) {
         memcpy(packet + IP_HEADER_MIN, data, len);
     }
 
-    kprintf("[IP] TX: %u.%u.%u.%u -> %u.%u.%u.%u proto=%u len=%u\n",
-            ip_octet(local_ip, 0), ip_octet(local_ip, 1),
-            ip_octet(local_ip, 2), ip_octet(local_ip, 3),
-            ip_octet(dest_ip, 0), ip_octet(dest_ip, 1),
-            ip_octet(dest_ip, 2), ip_octet(dest_ip, 3),
-            protocol, (uint32_t)total_len);
+    TRACE(TRACE_IP, TRACE_IP_TX, local_ip, dest_ip, protocol, total_len);
 
     /* Determine next hop */
     if (ip_is_broadcast(dest_ip)) {
@@ -173,9 +169,7 @@ int ip_send(uint32_t dest_ip, uint8_t protocol, const void *data, size_t len) {
     /* Look up MAC address */
     if (arp_lookup(next_hop, dest_mac) != 0) {
         /* ARP not resolved yet - packet will need to be retried */
-        kprintf("[IP] Waiting for ARP resolution of %u.%u.%u.%u\n",
-                ip_octet(next_hop, 0), ip_octet(next_hop, 1),
-                ip_octet(next_hop, 2), ip_octet(next_hop, 3));
+        TRACE(TRACE_IP, TRACE_IP_ARP_WAIT, next_hop, 0, 0, 0);
         return -1;
     }
 
@@ -229,12 +223,7 @@ int ip_send_buf(netbuf_t *buf, uint32_t dest_ip, uint8_t protocol) {
     buf->dst_ip = dest_ip;
     buf->protocol = protocol;
 
-    kprintf("[IP] TX: %u.%u.%u.%u -> %u.%u.%u.%u proto=%u len=%u\n",
-            ip_octet(local_ip, 0), ip_octet(local_ip, 1),
-            ip_octet(local_ip, 2), ip_octet(local_ip, 3),
-            ip_octet(dest_ip, 0), ip_octet(dest_ip, 1),
-            ip_octet(dest_ip, 2), ip_octet(dest_ip, 3),
-            protocol, (uint32_t)total_len);
+    TRACE(TRACE_IP, TRACE_IP_TX, local_ip, dest_ip, protocol, total_len);
 
     /* Determine next hop */
     if (ip_is_broadcast(dest_ip)) {
@@ -252,9 +241,7 @@ int ip_send_buf(netbuf_t *buf, uint32_t dest_ip, uint8_t protocol) {
 
     /* Look up MAC address */
     if (arp_lookup(next_hop, dest_mac) != 0) {
-        kprintf("[IP] Waiting for ARP resolution of %u.%u.%u.%u\n",
-                ip_octet(next_hop, 0), ip_octet(next_hop, 1),
-                ip_octet(next_hop, 2), ip_octet(next_hop, 3));
+        TRACE(TRACE_IP, TRACE_IP_ARP_WAIT, next_hop, 0, 0, 0);
         return -1;
     }
 
@@ -312,18 +299,13 @@ int ip_receive(const void *packet, size_t len) {
     src_ip = ntohl(hdr->src_addr);
     dst_ip = ntohl(hdr->dst_addr);
 
-    kprintf("[IP] RX: %u.%u.%u.%u -> %u.%u.%u.%u proto=%u len=%u\n",
-            ip_octet(src_ip, 0), ip_octet(src_ip, 1),
-            ip_octet(src_ip, 2), ip_octet(src_ip, 3),
-            ip_octet(dst_ip, 0), ip_octet(dst_ip, 1),
-            ip_octet(dst_ip, 2), ip_octet(dst_ip, 3),
-            hdr->protocol, total_len);
+    TRACE(TRACE_IP, TRACE_IP_RX, src_ip, dst_ip, hdr->protocol, total_len);
 
     /* Check if packet is for us */
     if (dst_ip != local_ip &&
         !ip_is_broadcast(dst_ip) &&
         !ip_is_multicast(dst_ip)) {
-        kprintf("[IP] Packet not for us, dropping\n");
+        TRACE(TRACE_IP, TRACE_IP_DROP, dst_ip, 0, 0, 0);
         return 0;
     }
 
@@ -14,6 +14,7 @@
 #include "../ip/ip.h"
 #include "../ethernet/ethernet.h"
 #include "../../kernel/include/serial.h"
+#include "../../kernel/include/trace.h"
 #include "../../kernel/mm/heap.h"
 #include "../../lib/libc/string.h"
 #include "../../drivers/timer/pit.h"
@@ -964,10 +965,7 @@ int tcp_receive(const void *packet, size_t len, uint32_t src_ip, uint32_t dst_ip
 
     tcp_stats.packets_received++;
 
-    kprintf("[TCP] Received: %d.%d.%d.%d:%d -> port %d, seq=%u, ack=%u, flags=%02X\n",
-            (src_ip >> 24) & 0xFF, (src_ip >> 16) & 0xFF,
-            (src_ip >> 8) & 0xFF, src_ip & 0xFF,
-            src_port, dst_port, seq, ack, flags);
+    TRACE(TRACE_TCP, TRACE_TCP_RX, src_ip, src_port, dst_port, flags);
 
     /* Find matching socket */
     tcp_socket_t *sock = tcp_find_socket(dst_ip, dst_port, src_ip, src_port);
@@ -1108,7 +1106,7 @@ int tcp_receive(const void *packet, size_t len, uint32_t src_ip, uint32_t dst_ip
                     /* Send ACK */
                     tcp_send_segment(sock, TCP_FLAG_ACK, NULL, 0);
 
-                    kprintf("[TCP] Received %zu bytes of data\n", written);
+                    TRACE(TRACE_TCP, TRACE_TCP_DATA, written, 0, 0, 0);
                 } else {
                     /* Out of order - send duplicate ACK */
                     tcp_send_segment(sock, TCP_FLAG_ACK, NULL, 0);
@@ -1242,7 +1240,7 @@ void tcp_timer_tick(void) {
                             sock->snd_nxt = sock->iss;
                             tcp_send_segment(sock, TCP_FLAG_SYN | TCP_FLAG_ACK, NULL, 0);
                         }
-                        kprintf("[TCP] Retransmit #%d\n", sock->retries);
+                        TRACE(TRACE_TCP, TRACE_TCP_RETRANSMIT, sock->retries, 0, 0, 0);
                     }
                 }
                 break;
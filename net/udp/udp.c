@@ -7,6 +7,7 @@
 #include "udp.h"
 #include "../ip/ip.h"
 #include "../../kernel/include/serial.h"
+#include "../../kernel/include/trace.h"
 
 /* Forward declarations for memory functions */
 extern void *kmalloc(size_t size);
@@ -452,11 +453,7 @@ ssize_t udp_send(uint32_t dest_ip, uint16_t dest_port, uint16_t src_port,
         hdr->checksum = 0xFFFF;
     }
 
-    kprintf("[UDP] Sending %zu bytes to %u.%u.%u.%u:%u from port %u\n",
-            len,
-            (dest_ip >> 24) & 0xFF, (dest_ip >> 16) & 0xFF,
-            (dest_ip >> 8) & 0xFF, dest_ip & 0xFF,
-            dest_port, src_port);
+    TRACE(TRACE_UDP, TRACE_UDP_TX, dest_ip, dest_port, src_port, len);
 
     /* Send via IP layer */
     int result = ip_send(dest_ip, IP_PROTO_UDP, packet, udp_len);
@@ -588,16 +585,12 @@ int udp_input(uint32_t src_ip, const void *packet, size_t len) {
         }
     }
 
-    kprintf("[UDP] Received %u bytes from %u.%u.%u.%u:%u to port %u\n",
-            udp_len - UDP_HEADER_LEN,
-            (src_ip >> 24) & 0xFF, (src_ip >> 16) & 0xFF,
-            (src_ip >> 8) & 0xFF, src_ip & 0xFF,
-            src_port, dst_port);
+    TRACE(TRACE_UDP, TRACE_UDP_RX, src_ip, src_port, dst_port, udp_len - UDP_HEADER_LEN);
 
     /* Find socket for destination port */
     udp_socket_t *sock = udp_find_socket(dst_port);
     if (!sock) {
-        kprintf("[UDP] No socket bound to port %u\n", dst_port);
+        TRACE(TRACE_UDP, TRACE_UDP_NO_SOCKET, dst_port, 0, 0, 0);
         udp_stats.port_unreachable++;
         /* Could send ICMP Port Unreachable here */
         return UDP_ERR_NOTBOUND;
@@ -0,0 +1,87 @@
+/**
+ * AAAos AHCI Host Harness
+ *
+ * Usage: ahci_host [-v] <command> ...
+ *   test                   Run the test suite
+ *   bench [options]        Run the benchmark
+ */
+
+#include "ahci_host.h"
+
+static int cmd_bench(int argc, char **argv) {
+    ahci_bench_params_t params = {
+        .latency_us     = 100,
+        .mb_per_s       = 550,
+        .random_ops     = 4000,
+        .seq_bytes      = 32 * MB,
+        .seq_size       = 128 * KB,
+    };
+
+    for (int i = 0; i < argc; i++) {
+        unsigned long long v;
+        if (argv[i][0] != '-' || i + 1 >= argc || host_parse_size(argv[i + 1], &v) != 0) {
+            host_print("bench: bad option %s\n", argv[i]);
+            return 2;
+        }
+
+        switch (argv[i][1]) {
+            case 'l': params.latency_us = (uint32_t)v; break;
+            case 'm': params.mb_per_s = (uint32_t)v; break;
+            case 'r': params.random_ops = (uint32_t)v; break;
+            case 's': params.seq_bytes = v; break;
+            case 'b': params.seq_size = (uint32_t)v; break;
+            default:
+                host_print("bench: unknown option %s\n", argv[i]);
+                return 2;
+        }
+        i++;
+    }
+
+    if (params.random_ops == 0 || params.seq_size == 0 ||
+        params.seq_size % AHCI_SECTOR_SIZE != 0 ||
+        params.seq_size / AHCI_SECTOR_SIZE > 65535 ||
+        params.seq_bytes < params.seq_size ||
+        params.seq_bytes > AHCI_HOST_SECTORS * AHCI_SECTOR_SIZE) {
+        host_print("bench: bad sizes\n");
+        return 2;
+    }
+
+    return ahci_host_run_bench(&params) == 0 ? 0 : 1;
+}
+
+static void usage(void) {
+    host_print("usage: ahci_host [-v] <command> ...\n"
+               "  test                          run the test suite\n"
+               "  bench [options]               run the benchmark\n"
+               "      -l latency-us  -m link-MB/s (0: unlimited)  -r random-ops\n"
+               "      -s seq-bytes  -b seq-io-size\n");
+}
+
+int main(int argc, char **argv) {
+    int arg = 1;
+    if (arg < argc && host_strcmp(argv[arg], "-v") == 0) {
+        fat32_host_verbose = true;
+        arg++;
+    }
+    if (arg >= argc) {
+        usage();
+        return 2;
+    }
+
+    const char *cmd = argv[arg++];
+    int nargs = argc - arg;
+    char **args = argv + arg;
+
+    if (host_strcmp(cmd, "test") == 0 || host_strcmp(cmd, "bench") == 0) {
+        if (ahci_host_attach() != 0) {
+            return 1;
+        }
+        if (cmd[0] == 't') {
+            return ahci_host_run_tests() == 0 ? 0 : 1;
+        }
+        return cmd_bench(nargs, args);
+    }
+
+    usage();
+    return 2;
+}
@@ -0,0 +1,134 @@
+/**
+ * AAAos AHCI Host Harness
+ *
+ * Runs the kernel's AHCI driver as an ordinary Linux process against a
+ * model of an AHCI 1.3 HBA with one SATA drive behind it. The model sees
+ * every register store the driver makes (host_mmio.h), fetches commands
+ * from the command list, moves data through the PRDT to and from an
+ * in-memory disk, and completes commands the way an NCQ drive does:
+ * queued commands leave PxCI when accepted and PxSACT when done, others
+ * leave PxCI when done.
+ *
+ * Commands take a configurable access latency and share a link of
+ * configurable bandwidth, and the model can hang or fail commands, so the
+ * driver's queuing, completion, error and timeout paths all run here.
+ * Interrupts and timer ticks are delivered only when a test asks for
+ * them; otherwise the driver polls, as it does before interrupts are up.
+ */
+
+#ifndef _AAAOS_TESTS_AHCI_HOST_H
+#define _AAAOS_TESTS_AHCI_HOST_H
+
+#include "../../kernel/include/types.h"
+#include "../../drivers/storage/ahci.h"
+#include "../fat32/host_io.h"
+
+#define AHCI_HOST_PORT          0
+#define AHCI_HOST_SECTORS       (64ULL * MB / AHCI_SECTOR_SIZE)
+#define AHCI_HOST_IRQ           11
+
+/* No injected failure */
+#define HBA_MODEL_NO_FAULT      ((uint64_t)-1)
+
+/**
+ * Device model counters
+ */
+typedef struct {
+    uint64_t    commands;           /* Commands fetched */
+    uint64_t    queued;             /* ... of which FPDMA QUEUED */
+    uint64_t    completed;          /* Commands completed successfully */
+    uint64_t    errors;             /* Commands failed by an injected fault */
+    uint64_t    aborted;            /* Commands dropped by stopping the port */
+    uint32_t    max_in_flight;      /* Most commands outstanding at once */
+    uint32_t    protocol_errors;    /* Driver broke an AHCI/NCQ rule */
+} hba_model_stats_t;
+
+/* Print kernel log messages ("[TAG] ..." lines), shared with the FAT32 shims */
+extern bool fat32_host_verbose;
+
+/**
+ * Create the HBA registers and the disk
+ * @param sectors Disk size in sectors
+ * @return 0 on success, -1 on error
+ */
+int hba_model_init(uint64_t sectors);
+
+/**
+ * Physical address of the HBA registers (PCI BAR5)
+ */
+uint64_t hba_model_abar(void);
+
+/**
+ * Set command timing
+ * @param latency_us Access time of every command
+ * @param mb_per_s Link bandwidth data transfers queue for (0: unlimited)
+ */
+void hba_model_set_timing(uint32_t latency_us, uint32_t mb_per_s);
+
+/**
+ * Accept commands but never complete them
+ */
+void hba_model_set_hang(bool hang);
+
+/**
+ * Fail the command covering a sector with a task file error (ABRT); the
+ * port then halts, as an HBA does, until software restarts it
+ * @param lba Sector, or HBA_MODEL_NO_FAULT
+ */
+void hba_model_fail_lba(uint64_t lba);
+
+/**
+ * Complete every command whose time has come
+ * Also runs after each register store, so a polling driver drives it.
+ */
+void hba_model_poll(void);
+
+/**
+ * Disk contents (AHCI_HOST_SECTORS sectors)
+ */
+uint8_t* hba_model_disk(void);
+
+void hba_model_stats(hba_model_stats_t *stats);
+void hba_model_reset_stats(void);
+
+/**
+ * Register the model as a PCI AHCI controller and run ahci_init()
+ * @return 0 on success, -1 on error
+ */
+int ahci_host_attach(void);
+
+/**
+ * Raise the controller's interrupt if the HBA has one pending
+ * @return true if the interrupt handler ran
+ */
+bool ahci_host_interrupt(void);
+
+/**
+ * Deliver timer ticks (the command watchdog runs on each)
+ */
+void ahci_host_tick(uint32_t ticks);
+
+/**
+ * Run the test suite
+ * @return Number of failed tests
+ */
+int ahci_host_run_tests(void);
+
+/**
+ * Benchmark parameters
+ */
+typedef struct {
+    uint32_t    latency_us;         /* Modelled access time */
+    uint32_t    mb_per_s;           /* Modelled link bandwidth */
+    uint32_t    random_ops;         /* Requests per random phase */
+    uint64_t    seq_bytes;          /* Bytes per sequential phase */
+    uint32_t    seq_size;           /* Bytes per sequential request */
+} ahci_bench_params_t;
+
+/**
+ * Run the benchmark
+ * @return 0 on success, -1 if a phase failed
+ */
+int ahci_host_run_bench(const ahci_bench_params_t *params);
+
+#endif /* _AAAOS_TESTS_AHCI_HOST_H */
@@ -0,0 +1,128 @@
+/**
+ * AAAos AHCI Host Harness - Kernel Shims
+ *
+ * PCI, interrupt and paging stand-ins for the AHCI driver, on top of the
+ * FAT32 harness shims (console, pages, heap, scheduler, time). The bus
+ * holds one device, the HBA model, wired to AHCI_HOST_IRQ. Handlers the
+ * driver chains onto an interrupt vector are kept here and run only from
+ * ahci_host_interrupt() and ahci_host_tick().
+ */
+
+#include "ahci_host.h"
+#include "../../kernel/mm/vmm.h"
+#include "../../kernel/mm/heap.h"
+#include "../../kernel/arch/x86_64/include/idt.h"
+
+#define SHIM_MAX_SHARED     4   /* Handlers per vector */
+
+static pci_device_t shim_hba = {
+    .vendor_id      = 0x8086,
+    .device_id      = 0x2922,   /* ICH9 AHCI */
+    .class_code     = PCI_CLASS_STORAGE,
+    .subclass       = PCI_SUBCLASS_SATA,
+    .prog_if        = AHCI_PROG_IF,
+    .header_type    = 0,
+    .interrupt_line = AHCI_HOST_IRQ,
+    .interrupt_pin  = 1,
+    .present        = true,
+};
+
+static interrupt_handler_t shim_handlers[IDT_ENTRIES][SHIM_MAX_SHARED];
+
+/* ============================================================================
+ * PCI
+ * ============================================================================ */
+
+pci_device_t* pci_find_class_next(uint8_t class_code, uint8_t subclass, pci_device_t* start) {
+    if (start || class_code != shim_hba.class_code || subclass != shim_hba.subclass) {
+        return NULL;
+    }
+    return &shim_hba;
+}
+
+uint64_t pci_get_bar(pci_device_t* dev, int bar) {
+    return (dev == &shim_hba && bar == 5) ? hba_model_abar() : 0;
+}
+
+void pci_enable_bus_mastering(pci_device_t* dev) {
+    UNUSED(dev);
+}
+
+void pci_enable_memory_space(pci_device_t* dev) {
+    UNUSED(dev);
+}
+
+/* ============================================================================
+ * Interrupts
+ * ============================================================================ */
+
+int idt_register_shared_handler(uint8_t vector, interrupt_handler_t handler) {
+    for (int i = 0; i < SHIM_MAX_SHARED; i++) {
+        if (!shim_handlers[vector][i]) {
+            shim_handlers[vector][i] = handler;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static void shim_raise(uint8_t vector) {
+    interrupt_frame_t frame = { 0 };
+    frame.int_no = vector;
+
+    for (int i = 0; i < SHIM_MAX_SHARED && shim_handlers[vector][i]; i++) {
+        shim_handlers[vector][i](&frame);
+    }
+}
+
+bool ahci_host_interrupt(void) {
+    ahci_controller_t *ctrl = ahci_get_controller(0);
+
+    hba_model_poll();
+    if (!ctrl || !ctrl->irq_enabled || ctrl->hba->is == 0) {
+        return false;
+    }
+    shim_raise(IRQ_BASE + AHCI_HOST_IRQ);
+    return true;
+}
+
+void ahci_host_tick(uint32_t ticks) {
+    while (ticks--) {
+        shim_raise(IRQ_TIMER);
+    }
+}
+
+/* ============================================================================
+ * Memory
+ * ============================================================================ */
+
+/* All harness memory is host heap, which the phys map arithmetic covers */
+physaddr_t vmm_get_physical(virtaddr_t virt) {
+    return (physaddr_t)(virt - VMM_KERNEL_PHYS_MAP);
+}
+
+void *kcalloc(size_t count, size_t size) {
+    uint8_t *ptr = kmalloc(count * size);
+    if (ptr) {
+        for (size_t i = 0; i < count * size; i++) {
+            ptr[i] = 0;
+        }
+    }
+    return ptr;
+}
+
+/* ============================================================================
+ * Attach
+ * ============================================================================ */
+
+int ahci_host_attach(void) {
+    if (hba_model_init(AHCI_HOST_SECTORS) != 0) {
+        host_print("ahci_host: cannot create the HBA model\n");
+        return -1;
+    }
+    if (ahci_init() != 1) {
+        host_print("ahci_host: driver did not find the controller\n");
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,164 @@
+/**
+ * AAAos AHCI Host Harness - Benchmark
+ *
+ * Random 4 KB reads through ahci_benchmark() and sequential reads and
+ * writes through ahci_submit()/ahci_wait(), each at queue depth 1 and
+ * with the queue full. The HBA model gives every command the configured
+ * access latency and serialises data on a link of the configured
+ * bandwidth, so the figures show how well the driver overlaps commands
+ * against a drive of that shape. With both set to 0 they show the
+ * harness's own ceiling: every register store the driver makes is a
+ * trapped page fault here, a few microseconds that real MMIO does not
+ * cost, so latencies much below that cap the queue depth reached.
+ * Timings are host wall-clock time.
+ */
+
+#include "ahci_host.h"
+
+#define BENCH_MAX_DEPTH     32
+
+/**
+ * Phase measurement
+ */
+typedef struct {
+    const char  *name;
+    uint32_t    depth;
+    uint64_t    start_ns;
+    uint64_t    ops;
+    uint64_t    bytes;
+    uint32_t    failed;
+} bench_phase_t;
+
+/* ============================================================================
+ * Helpers
+ * ============================================================================ */
+
+static void bench_begin(bench_phase_t *phase, const char *name, uint32_t depth) {
+    hba_model_reset_stats();
+
+    phase->name = name;
+    phase->depth = depth;
+    phase->ops = 0;
+    phase->bytes = 0;
+    phase->failed = 0;
+    phase->start_ns = host_now_ns();
+}
+
+static void bench_end(bench_phase_t *phase) {
+    uint64_t ns = host_now_ns() - phase->start_ns;
+    uint64_t us = ns / 1000 ? ns / 1000 : 1;
+
+    hba_model_stats_t st;
+    hba_model_stats(&st);
+
+    host_print("%-12s %5u %8llu %5llu.%03llu %9llu %8llu %6u %6u\n",
+               phase->name, phase->depth, phase->ops,
+               ns / 1000000000ULL, (ns / 1000000ULL) % 1000,
+               phase->ops * 1000000ULL / us,
+               phase->bytes * 1000000ULL / us / MB,
+               st.max_in_flight, phase->failed + st.protocol_errors);
+}
+
+/* ============================================================================
+ * Phases
+ * ============================================================================ */
+
+/**
+ * Random 4 KB reads, the driver's own benchmark loop
+ */
+static int bench_random(uint32_t depth, uint32_t ops) {
+    bench_phase_t phase;
+    bench_begin(&phase, "rand-read", depth);
+
+    if (ahci_benchmark(AHCI_HOST_PORT, depth, ops) == 0) {
+        host_print("bench: random reads at QD%u failed\n", depth);
+        return -1;
+    }
+
+    phase.ops = ops;
+    phase.bytes = (uint64_t)ops * 4 * KB;
+    bench_end(&phase);
+    return 0;
+}
+
+/**
+ * Sequential transfer of seq_bytes, depth requests in flight
+ */
+static int bench_seq(const char *name, ahci_op_t op, uint32_t depth,
+                     const ahci_bench_params_t *params, uint8_t *bufs) {
+    ahci_request_t reqs[BENCH_MAX_DEPTH];
+    uint32_t count = params->seq_size / AHCI_SECTOR_SIZE;
+    uint64_t requests = params->seq_bytes / params->seq_size;
+    uint64_t issued = 0;
+
+    bench_phase_t phase;
+    bench_begin(&phase, name, depth);
+
+    /* Keep depth requests in flight, refilling slots in turn */
+    for (uint64_t i = 0; i < requests + depth; i++) {
+        ahci_request_t *req = &reqs[i % depth];
+
+        if (i >= depth && i - depth < issued) {
+            if (ahci_wait(AHCI_HOST_PORT, req) != AHCI_SUCCESS) {
+                phase.failed++;
+            }
+            phase.ops++;
+            phase.bytes += params->seq_size;
+        }
+
+        if (issued < requests) {
+            *req = (ahci_request_t){ 0 };
+            req->op = op;
+            req->lba = issued * count;
+            req->count = count;
+            req->buf = bufs + (i % depth) * params->seq_size;
+            if (ahci_submit(AHCI_HOST_PORT, req) != AHCI_SUCCESS) {
+                host_print("bench: %s submit failed\n", name);
+                return -1;
+            }
+            issued++;
+        }
+    }
+
+    bench_end(&phase);
+    return phase.failed ? -1 : 0;
+}
+
+/* ============================================================================
+ * Runner
+ * ============================================================================ */
+
+int ahci_host_run_bench(const ahci_bench_params_t *params) {
+    static const uint32_t depths[] = { 1, 4, BENCH_MAX_DEPTH };
+    uint64_t pages = ((uint64_t)BENCH_MAX_DEPTH * params->seq_size + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint8_t *bufs = host_alloc_pages(pages);
+    int result = 0;
+
+    if (!bufs) {
+        host_print("bench: out of memory\n");
+        return -1;
+    }
+
+    hba_model_set_timing(params->latency_us, params->mb_per_s);
+    host_print("HBA model: %u us access latency, ", params->latency_us);
+    if (params->mb_per_s) {
+        host_print("%u MB/s link\n", params->mb_per_s);
+    } else {
+        host_print("unlimited link\n");
+    }
+    host_print("%-12s %5s %8s %9s %9s %8s %6s %6s\n",
+               "phase", "depth", "ops", "seconds", "IOPS", "MB/s", "max-qd", "errors");
+
+    for (size_t i = 0; i < ARRAY_SIZE(depths) && result == 0; i++) {
+        result = bench_random(depths[i], params->random_ops);
+    }
+    for (size_t i = 0; i < ARRAY_SIZE(depths) && result == 0; i++) {
+        result = bench_seq("seq-write", AHCI_OP_WRITE, depths[i], params, bufs);
+    }
+    for (size_t i = 0; i < ARRAY_SIZE(depths) && result == 0; i++) {
+        result = bench_seq("seq-read", AHCI_OP_READ, depths[i], params, bufs);
+    }
+
+    host_free(bufs);
+    return result;
+}
@@ -0,0 +1,461 @@
+/**
+ * AAAos AHCI Host Harness - HBA Model
+ *
+ * One port with a SATA drive, 32 command slots and NCQ. Register stores
+ * arrive through host_mmio with the semantics of AHCI 1.3:
+ * - PxIS, PxSERR and IS are write-1-to-clear
+ * - PxCI and PxSACT are write-1-to-set; PxCI bits start commands
+ * - PxCMD.CR and PxCMD.FR follow ST and FRE; clearing ST drops every
+ *   command in flight and clears PxCI and PxSACT
+ * - GHC.HR resets the HBA and reads back as 0
+ * Commands are fetched when issued and completed by hba_model_poll(),
+ * which every store also runs.
+ *
+ * The model also checks the driver: a queued command issued without its
+ * PxSACT bit, a tag that differs from the slot, a non-queued command
+ * overlapping any other or a transfer that does not match the PRDT is
+ * counted as a protocol error.
+ */
+
+#include "ahci_host.h"
+#include "host_mmio.h"
+#include "../../kernel/mm/vmm.h"
+
+#define HBA_MODEL_SLOTS         32
+
+/* ATA status and error register values */
+#define ATA_STATUS_READY        0x50    /* DRDY | DSC */
+#define ATA_STATUS_ERROR        0x51    /* DRDY | DSC | ERR */
+#define ATA_ERROR_ABRT          0x04
+
+#define HBA_REG(field)          __builtin_offsetof(ahci_hba_t, field)
+#define PORT_REG(field)         __builtin_offsetof(ahci_port_t, field)
+
+/**
+ * Command fetched from a slot
+ */
+typedef struct {
+    bool        busy;
+    bool        queued;             /* FPDMA QUEUED */
+    bool        write;              /* Data flows to the disk */
+    uint8_t     command;
+    uint64_t    lba;
+    uint32_t    count;              /* Sectors transferred */
+    uint64_t    due_ns;             /* Completion time */
+} hba_cmd_t;
+
+static struct {
+    ahci_hba_t          *regs;      /* Driver view */
+    ahci_hba_t          *hw;        /* Model view */
+    uint8_t             *disk;
+    uint64_t            sectors;
+    uint16_t            identify[256];
+
+    hba_cmd_t           cmd[HBA_MODEL_SLOTS];
+    uint32_t            in_flight;
+    bool                halted;     /* Stopped on an error until ST is cleared */
+
+    uint64_t            latency_ns;
+    uint32_t            mb_per_s;
+    uint64_t            link_free_ns;   /* When the link finishes its last transfer */
+
+    bool                hang;
+    uint64_t            fail_lba;
+
+    hba_model_stats_t   stats;
+} hba;
+
+/* ============================================================================
+ * Helpers
+ * ============================================================================ */
+
+static void* hba_model_virt(uint32_t lo, uint32_t hi) {
+    return (void *)(uintptr_t)((((uint64_t)hi << 32) | lo) + VMM_KERNEL_PHYS_MAP);
+}
+
+static void hba_model_copy(void *dest, const void *src, size_t n) {
+    uint8_t *d = dest;
+    const uint8_t *s = src;
+    while (n--) {
+        *d++ = *s++;
+    }
+}
+
+/**
+ * Store an ATA string: two characters per word, high byte first
+ */
+static void hba_model_ata_string(uint16_t *words, const char *s, int nwords) {
+    for (int i = 0; i < nwords * 2; i++) {
+        char c = *s ? *s++ : ' ';
+        if (i & 1) {
+            words[i / 2] |= (uint8_t)c;
+        } else {
+            words[i / 2] = (uint16_t)((uint8_t)c << 8);
+        }
+    }
+}
+
+static void hba_model_build_identify(void) {
+    uint16_t *id = hba.identify;
+    uint64_t lba28 = MIN(hba.sectors, 0x0FFFFFFFULL);
+
+    hba_model_ata_string(&id[10], "HBAMODEL0001", 10);
+    hba_model_ata_string(&id[27], "AAAos HBA model", 20);
+    id[60] = (uint16_t)lba28;
+    id[61] = (uint16_t)(lba28 >> 16);
+    id[ATA_ID_QUEUE_DEPTH] = HBA_MODEL_SLOTS - 1;
+    id[ATA_ID_SATA_CAP] = ATA_ID_SATA_CAP_NCQ;
+    id[83] = 1 << 10;   /* 48-bit LBA */
+    for (int i = 0; i < 4; i++) {
+        id[100 + i] = (uint16_t)(hba.sectors >> (16 * i));
+    }
+}
+
+/* ============================================================================
+ * Commands
+ * ============================================================================ */
+
+/**
+ * Drop every command on the port (ST cleared or HBA reset)
+ */
+static void hba_model_stop(ahci_port_t *port) {
+    for (int i = 0; i < HBA_MODEL_SLOTS; i++) {
+        if (hba.cmd[i].busy) {
+            hba.cmd[i].busy = false;
+            hba.stats.aborted++;
+        }
+    }
+    hba.in_flight = 0;
+    hba.halted = false;
+    port->ci = 0;
+    port->sact = 0;
+}
+
+/**
+ * Fetch newly issued commands
+ */
+static void hba_model_issue(ahci_port_t *port, uint32_t bits) {
+    if (!(port->cmd & AHCI_PORT_CMD_ST)) {
+        hba.stats.protocol_errors++;
+        return;
+    }
+
+    ahci_cmd_header_t *list = hba_model_virt(port->clb, port->clbu);
+    uint64_t now = host_now_ns();
+
+    for (int slot = 0; slot < HBA_MODEL_SLOTS; slot++) {
+        uint32_t bit = 1U << slot;
+        if (!(bits & bit)) {
+            continue;
+        }
+
+        ahci_cmd_table_t *tbl = hba_model_virt(list[slot].ctba, list[slot].ctbau);
+        ahci_fis_reg_h2d_t *fis = (ahci_fis_reg_h2d_t *)tbl->cfis;
+        hba_cmd_t *c = &hba.cmd[slot];
+
+        c->command = fis->command;
+        c->lba = (uint64_t)fis->lba0 | ((uint64_t)fis->lba1 << 8) |
+                 ((uint64_t)fis->lba2 << 16) | ((uint64_t)fis->lba3 << 24) |
+                 ((uint64_t)fis->lba4 << 32) | ((uint64_t)fis->lba5 << 40);
+        c->queued = false;
+        c->write = false;
+
+        switch (fis->command) {
+            case ATA_CMD_WRITE_FPDMA_QUEUED:
+                c->write = true;
+                /* fall through */
+            case ATA_CMD_READ_FPDMA_QUEUED:
+                c->queued = true;
+                c->count = fis->featurel | (fis->featureh << 8);
+                if ((fis->countl >> 3) != slot || !(port->sact & bit)) {
+                    hba.stats.protocol_errors++;
+                }
+                break;
+            case ATA_CMD_WRITE_DMA_EXT:
+                c->write = true;
+                /* fall through */
+            case ATA_CMD_READ_DMA_EXT:
+                c->count = fis->countl | (fis->counth << 8);
+                break;
+            case ATA_CMD_IDENTIFY:
+                c->lba = 0;
+                c->count = 1;
+                break;
+            default:
+                c->count = 0;
+                break;
+        }
+        if ((fis->command == ATA_CMD_READ_FPDMA_QUEUED || fis->command == ATA_CMD_READ_DMA_EXT ||
+             fis->command == ATA_CMD_WRITE_FPDMA_QUEUED || fis->command == ATA_CMD_WRITE_DMA_EXT) &&
+            c->count == 0) {
+            c->count = 65536;
+        }
+        if (list[slot].w != c->write) {
+            hba.stats.protocol_errors++;
+        }
+
+        /* A non-queued command must run alone */
+        bool other_unqueued = false;
+        for (int i = 0; i < HBA_MODEL_SLOTS; i++) {
+            if (hba.cmd[i].busy && !hba.cmd[i].queued) {
+                other_unqueued = true;
+            }
+        }
+        if (other_unqueued || (!c->queued && hba.in_flight > 0)) {
+            hba.stats.protocol_errors++;
+        }
+
+        /* Access time, then the data waits its turn on the link */
+        c->due_ns = now + hba.latency_ns;
+        if (hba.mb_per_s && c->count) {
+            uint64_t start = MAX(c->due_ns, hba.link_free_ns);
+            c->due_ns = start + (uint64_t)c->count * AHCI_SECTOR_SIZE * 1000000000ULL /
+                                ((uint64_t)hba.mb_per_s * MB);
+            hba.link_free_ns = c->due_ns;
+        }
+
+        c->busy = true;
+        hba.in_flight++;
+        hba.stats.max_in_flight = MAX(hba.stats.max_in_flight, hba.in_flight);
+        hba.stats.commands++;
+        if (c->queued) {
+            hba.stats.queued++;
+            port->ci &= ~bit;   /* Accepted: the drive owns the tag now */
+        }
+    }
+}
+
+/**
+ * Fail a command with ABRT and halt the port
+ */
+static void hba_model_fail(ahci_port_t *port) {
+    port->tfd = (ATA_ERROR_ABRT << 8) | ATA_STATUS_ERROR;
+    port->is |= AHCI_PORT_INT_TFES;
+    hba.hw->is |= 1;
+    hba.halted = true;
+    hba.stats.errors++;
+}
+
+static void hba_model_complete(ahci_port_t *port, int slot) {
+    hba_cmd_t *c = &hba.cmd[slot];
+    bool data = c->command != ATA_CMD_FLUSH_CACHE_EXT && c->command != ATA_CMD_IDENTIFY;
+
+    if (data && (c->lba + c->count > hba.sectors ||
+                 (hba.fail_lba >= c->lba && hba.fail_lba < c->lba + c->count))) {
+        hba_model_fail(port);
+        return;
+    }
+
+    /* Move the data through the PRDT */
+    ahci_cmd_header_t *hdr = &((ahci_cmd_header_t *)hba_model_virt(port->clb, port->clbu))[slot];
+    ahci_cmd_table_t *tbl = hba_model_virt(hdr->ctba, hdr->ctbau);
+    uint8_t *media = (c->command == ATA_CMD_IDENTIFY) ? (uint8_t *)hba.identify
+                                                      : hba.disk + c->lba * AHCI_SECTOR_SIZE;
+    uint64_t left = (uint64_t)c->count * AHCI_SECTOR_SIZE;
+
+    for (uint32_t i = 0; i < hdr->prdtl; i++) {
+        ahci_prdt_entry_t *e = &tbl->prdt_entry[i];
+        uint8_t *buf = hba_model_virt(e->dba, e->dbau);
+        uint64_t len = MIN((uint64_t)e->dbc + 1, left);
+
+        if (c->write) {
+            hba_model_copy(media, buf, len);
+        } else {
+            hba_model_copy(buf, media, len);
+        }
+        media += len;
+        left -= len;
+    }
+    if (left != 0) {
+        hba.stats.protocol_errors++;
+    }
+    hdr->prdbc = (uint32_t)((uint64_t)c->count * AHCI_SECTOR_SIZE - left);
+
+    c->busy = false;
+    hba.in_flight--;
+    hba.stats.completed++;
+
+    uint32_t bit = 1U << slot;
+    if (c->queued) {
+        port->sact &= ~bit;
+        port->is |= AHCI_PORT_INT_SDBS;
+    } else {
+        port->ci &= ~bit;
+        port->is |= AHCI_PORT_INT_DHRS;
+    }
+    port->tfd = ATA_STATUS_READY;
+    if (port->is & port->ie) {
+        hba.hw->is |= 1;
+    }
+}
+
+void hba_model_poll(void) {
+    if (!hba.hw || hba.hang) {
+        return;
+    }
+
+    ahci_port_t *port = &hba.hw->ports[0];
+    uint64_t now = host_now_ns();
+
+    for (int slot = 0; slot < HBA_MODEL_SLOTS && !hba.halted; slot++) {
+        if (hba.cmd[slot].busy && hba.cmd[slot].due_ns <= now) {
+            hba_model_complete(port, slot);
+        }
+    }
+}
+
+/* ============================================================================
+ * Registers
+ * ============================================================================ */
+
+static void hba_model_reset(void) {
+    ahci_port_t *port = &hba.hw->ports[0];
+
+    hba_model_stop(port);
+    port->cmd = 0;
+    port->is = 0;
+    port->ie = 0;
+    port->serr = 0;
+    port->tfd = ATA_STATUS_READY;
+    hba.hw->is = 0;
+    hba.hw->ghc = 0;
+}
+
+static void hba_model_port_write(ahci_port_t *port, unsigned long reg,
+                                 uint32_t old, uint32_t value) {
+    switch (reg) {
+        case PORT_REG(is):
+        case PORT_REG(serr):
+            *(volatile uint32_t *)((uint8_t *)port + reg) = old & ~value;
+            break;
+
+        case PORT_REG(cmd): {
+            uint32_t cmd = value & ~(AHCI_PORT_CMD_CR | AHCI_PORT_CMD_FR | AHCI_PORT_CMD_CLO);
+            if (value & AHCI_PORT_CMD_ST) {
+                cmd |= AHCI_PORT_CMD_CR;
+            } else if (old & AHCI_PORT_CMD_ST) {
+                hba_model_stop(port);
+            }
+            if (value & AHCI_PORT_CMD_FRE) {
+                cmd |= AHCI_PORT_CMD_FR;
+            }
+            if (value & AHCI_PORT_CMD_CLO) {
+                port->tfd &= ~(AHCI_PORT_TFD_BSY | AHCI_PORT_TFD_DRQ);
+            }
+            port->cmd = cmd;
+            break;
+        }
+
+        case PORT_REG(sact):
+            port->sact = old | value;
+            break;
+
+        case PORT_REG(ci):
+            port->ci = old | value;
+            hba_model_issue(port, value & ~old);
+            break;
+
+        case PORT_REG(tfd):
+        case PORT_REG(sig):
+        case PORT_REG(ssts):
+            *(volatile uint32_t *)((uint8_t *)port + reg) = old;
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void hba_model_write(unsigned long offset, unsigned int old, unsigned int value) {
+    if (offset >= HBA_REG(ports)) {
+        unsigned long off = offset - HBA_REG(ports);
+        hba_model_port_write(&hba.hw->ports[off / sizeof(ahci_port_t)],
+                             off % sizeof(ahci_port_t), old, value);
+    } else {
+        switch (offset) {
+            case HBA_REG(ghc):
+                if (value & AHCI_GHC_HR) {
+                    hba_model_reset();
+                }
+                break;
+            case HBA_REG(is):
+                hba.hw->is = old & ~value;
+                break;
+            case HBA_REG(cap):
+            case HBA_REG(pi):
+            case HBA_REG(vs):
+            case HBA_REG(cap2):
+                *(volatile uint32_t *)((uint8_t *)hba.hw + offset) = old;
+                break;
+            default:
+                break;
+        }
+    }
+
+    hba_model_poll();
+}
+
+/* ============================================================================
+ * Public API
+ * ============================================================================ */
+
+int hba_model_init(uint64_t sectors) {
+    void *hw = NULL;
+    void *regs = host_mmio_map(sizeof(ahci_hba_t), &hw, hba_model_write);
+    if (!regs) {
+        return -1;
+    }
+
+    hba.regs = regs;
+    hba.hw = hw;
+    hba.sectors = sectors;
+    hba.fail_lba = HBA_MODEL_NO_FAULT;
+    hba.disk = host_alloc(sectors * AHCI_SECTOR_SIZE);
+    if (!hba.disk) {
+        return -1;
+    }
+    for (uint64_t i = 0; i < sectors * AHCI_SECTOR_SIZE; i++) {
+        hba.disk[i] = 0;
+    }
+    hba_model_build_identify();
+
+    hba.hw->cap = AHCI_CAP_S64A | AHCI_CAP_SNCQ | AHCI_CAP_SCLO |
+                  ((HBA_MODEL_SLOTS - 1) << AHCI_CAP_NCS_SHIFT);  /* One port */
+    hba.hw->pi = 1;
+    hba.hw->vs = 0x00010300;
+    hba.hw->ports[0].sig = AHCI_SIG_ATA;
+    hba.hw->ports[0].ssts = AHCI_PORT_DET_PHY | (AHCI_PORT_IPM_ACTIVE << 8);
+    hba.hw->ports[0].tfd = ATA_STATUS_READY;
+    return 0;
+}
+
+uint64_t hba_model_abar(void) {
+    return (uint64_t)(uintptr_t)hba.regs - VMM_KERNEL_PHYS_MAP;
+}
+
+void hba_model_set_timing(uint32_t latency_us, uint32_t mb_per_s) {
+    hba.latency_ns = (uint64_t)latency_us * 1000;
+    hba.mb_per_s = mb_per_s;
+    hba.link_free_ns = 0;
+}
+
+void hba_model_set_hang(bool hang) {
+    hba.hang = hang;
+}
+
+void hba_model_fail_lba(uint64_t lba) {
+    hba.fail_lba = lba;
+}
+
+uint8_t* hba_model_disk(void) {
+    return hba.disk;
+}
+
+void hba_model_stats(hba_model_stats_t *stats) {
+    *stats = hba.stats;
+}
+
+void hba_model_reset_stats(void) {
+    hba_model_stats_t zero = { 0 };
+    hba.stats = zero;
+}
@@ -0,0 +1,116 @@
+/**
+ * AAAos AHCI Host Harness - Emulated MMIO
+ */
+
+#define _GNU_SOURCE
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include "host_mmio.h"
+
+/* RFLAGS trap flag: single-step the faulting store */
+#define HOST_MMIO_RFLAGS_TF 0x100
+
+static struct {
+    uint8_t             *driver;        /* Read-only view */
+    uint8_t             *device;        /* Writable view */
+    unsigned long       size;
+    host_mmio_write_t   write;
+
+    /* Store being single-stepped */
+    int                 pending;
+    unsigned long       offset;
+    unsigned int        old;
+} mmio;
+
+static void host_mmio_protect(int prot) {
+    if (mprotect(mmio.driver, mmio.size, prot) != 0) {
+        static const char msg[] = "host_mmio: mprotect failed\n";
+        if (write(2, msg, sizeof(msg) - 1) < 0) {
+            /* Nothing left to report to */
+        }
+        _exit(2);
+    }
+}
+
+/**
+ * A store hit the read-only view: open it and step over the store
+ */
+static void host_mmio_segv(int sig, siginfo_t *si, void *ctx) {
+    ucontext_t *uc = ctx;
+    uint8_t *addr = si->si_addr;
+
+    if (mmio.pending || addr < mmio.driver || addr >= mmio.driver + mmio.size) {
+        /* A real crash: fault again with the default action */
+        signal(sig, SIG_DFL);
+        return;
+    }
+
+    mmio.offset = (unsigned long)(addr - mmio.driver) & ~3UL;
+    memcpy(&mmio.old, mmio.device + mmio.offset, sizeof(mmio.old));
+    mmio.pending = 1;
+
+    host_mmio_protect(PROT_READ | PROT_WRITE);
+    uc->uc_mcontext.gregs[REG_EFL] |= HOST_MMIO_RFLAGS_TF;
+}
+
+/**
+ * The store has executed: close the view and let the model apply it
+ */
+static void host_mmio_trap(int sig, siginfo_t *si, void *ctx) {
+    ucontext_t *uc = ctx;
+    (void)si;
+
+    if (!mmio.pending) {
+        signal(sig, SIG_DFL);
+        return;
+    }
+
+    uc->uc_mcontext.gregs[REG_EFL] &= ~HOST_MMIO_RFLAGS_TF;
+    host_mmio_protect(PROT_READ);
+    mmio.pending = 0;
+
+    unsigned int value;
+    memcpy(&value, mmio.device + mmio.offset, sizeof(value));
+    mmio.write(mmio.offset, mmio.old, value);
+}
+
+void* host_mmio_map(unsigned long size, void **device, host_mmio_write_t write_cb) {
+    long page = sysconf(_SC_PAGESIZE);
+    size = (size + page - 1) & ~(unsigned long)(page - 1);
+
+    int fd = memfd_create("host_mmio", 0);
+    if (fd < 0 || ftruncate(fd, (off_t)size) != 0) {
+        perror("host_mmio: memfd");
+        return NULL;
+    }
+
+    void *driver = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    void *dev = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (driver == MAP_FAILED || dev == MAP_FAILED) {
+        perror("host_mmio: mmap");
+        return NULL;
+    }
+
+    mmio.driver = driver;
+    mmio.device = dev;
+    mmio.size = size;
+    mmio.write = write_cb;
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_flags = SA_SIGINFO;
+    sa.sa_sigaction = host_mmio_segv;
+    sigaction(SIGSEGV, &sa, NULL);
+    sa.sa_sigaction = host_mmio_trap;
+    sigaction(SIGTRAP, &sa, NULL);
+
+    *device = dev;
+    return driver;
+}
@@ -0,0 +1,36 @@
+/**
+ * AAAos AHCI Host Harness - Emulated MMIO
+ *
+ * Device registers are ordinary memory mapped twice: read-only for the
+ * driver and writable for the device model. A store from the driver
+ * faults, is single-stepped on a briefly writable page and is then handed
+ * to the model, which decides what the register really holds afterwards
+ * (write-1-to-clear, write-1-to-set, read-only, side effects). Loads are
+ * not trapped.
+ *
+ * Only the thread that maps the region may store to it; the model runs in
+ * the signal handler on that thread, synchronously with the store.
+ */
+
+#ifndef _AAAOS_TESTS_AHCI_HOST_MMIO_H
+#define _AAAOS_TESTS_AHCI_HOST_MMIO_H
+
+/**
+ * Register store callback
+ * @param offset Register offset (4-byte aligned)
+ * @param old Value before the store
+ * @param value Value the store left in memory
+ * The callback writes the register's final value through the device view.
+ */
+typedef void (*host_mmio_write_t)(unsigned long offset, unsigned int old, unsigned int value);
+
+/**
+ * Map a register region
+ * @param size Bytes (rounded up to pages)
+ * @param device Receives the device model's writable view
+ * @param write Called after every store through the returned view
+ * @return Driver view, or NULL on error
+ */
+void* host_mmio_map(unsigned long size, void **device, host_mmio_write_t write);
+
+#endif /* _AAAOS_TESTS_AHCI_HOST_MMIO_H */
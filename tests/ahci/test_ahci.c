@@ -0,0 +1,350 @@
+/**
+ * AAAos AHCI Host Harness - Tests
+ *
+ * Driver tests against the HBA model: identification, data transfer,
+ * NCQ queueing, interrupt completion and the error paths, where a task
+ * file error or a hung drive must fail what is in flight, restart the
+ * port and leave queued requests and later I/O working. Every test puts
+ * the model back to zero latency with no faults.
+ */
+
+#include "ahci_host.h"
+#include "../framework/test.h"
+#include "../../kernel/arch/x86_64/include/idt.h"
+#include "../../kernel/sched/scheduler.h"
+
+#define TEST_SECTORS        64
+#define TEST_REQUESTS       48                  /* More than the queue depth */
+#define TEST_BLOCK          (4 * KB)
+
+/* AHCI_CMD_TIMEOUT_TICKS in ahci.c: 5 s of scheduler ticks */
+#define TEST_TIMEOUT_TICKS  ((5000 * SCHEDULER_TICK_FREQUENCY) / 1000)
+
+static uint8_t test_wbuf[TEST_SECTORS * AHCI_SECTOR_SIZE] ALIGNED(PAGE_SIZE);
+static uint8_t test_rbuf[TEST_SECTORS * AHCI_SECTOR_SIZE] ALIGNED(PAGE_SIZE);
+static uint8_t test_blocks[TEST_REQUESTS][TEST_BLOCK] ALIGNED(PAGE_SIZE);
+static ahci_request_t test_reqs[TEST_REQUESTS];
+static uint32_t test_done_calls;
+
+/* ============================================================================
+ * Helpers
+ * ============================================================================ */
+
+/**
+ * Fill a buffer with a reproducible pattern
+ */
+static void test_pattern(uint8_t *buf, size_t len, uint32_t seed) {
+    uint32_t x = seed * 2654435761u + 1;
+    for (size_t i = 0; i < len; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        buf[i] = (uint8_t)x;
+    }
+}
+
+static void test_model_defaults(void) {
+    hba_model_set_timing(0, 0);
+    hba_model_set_hang(false);
+    hba_model_fail_lba(HBA_MODEL_NO_FAULT);
+    hba_model_reset_stats();
+    test_done_calls = 0;
+
+    /* Polled completions leave the HBA interrupt status set */
+    ahci_host_interrupt();
+}
+
+static void test_done(ahci_request_t *req) {
+    UNUSED(req);
+    test_done_calls++;
+}
+
+/**
+ * Submit a 4 KB read of block i into its own buffer
+ */
+static int test_submit_read(int i, uint64_t lba) {
+    ahci_request_t *req = &test_reqs[i];
+    *req = (ahci_request_t){ 0 };
+    req->op = AHCI_OP_READ;
+    req->lba = lba;
+    req->count = TEST_BLOCK / AHCI_SECTOR_SIZE;
+    req->buf = test_blocks[i];
+    req->done = test_done;
+    return ahci_submit(AHCI_HOST_PORT, req);
+}
+
+/**
+ * Busy-wait without touching the HBA, so nothing gets polled
+ */
+static void test_spin_us(uint64_t us) {
+    uint64_t end = host_now_ns() + us * 1000;
+    while (host_now_ns() < end) {
+        __asm__ __volatile__("pause");
+    }
+}
+
+/**
+ * Check the port still works: write, read back, compare
+ */
+static bool test_port_works(uint64_t lba) {
+    test_pattern(test_wbuf, AHCI_SECTOR_SIZE, (uint32_t)lba);
+    return ahci_write_sectors(AHCI_HOST_PORT, lba, 1, test_wbuf) == AHCI_SUCCESS &&
+           ahci_read_sectors(AHCI_HOST_PORT, lba, 1, test_rbuf) == AHCI_SUCCESS &&
+           __builtin_memcmp(test_wbuf, test_rbuf, AHCI_SECTOR_SIZE) == 0;
+}
+
+/* ============================================================================
+ * Identification and Transfers
+ * ============================================================================ */
+
+TEST_CASE(test_ahci_identify) {
+    ahci_port_info_t *info = ahci_get_port_info(AHCI_HOST_PORT);
+    TEST_ASSERT_NOT_NULL(info);
+    TEST_ASSERT(info->present);
+    TEST_ASSERT_EQ(info->type, AHCI_DEV_SATA);
+    TEST_ASSERT_EQ(info->sector_count, AHCI_HOST_SECTORS);
+    TEST_ASSERT_STR_EQ(info->model, "AAAos HBA model");
+    TEST_ASSERT(info->ncq);
+    TEST_ASSERT_EQ(info->queue_depth, 32);
+
+    uint16_t *id = (uint16_t *)test_rbuf;
+    TEST_ASSERT_EQ(ahci_identify(AHCI_HOST_PORT, id), AHCI_SUCCESS);
+    TEST_ASSERT(id[ATA_ID_SATA_CAP] & ATA_ID_SATA_CAP_NCQ);
+    TEST_PASS();
+}
+
+TEST_CASE(test_ahci_read_write) {
+    test_model_defaults();
+    test_pattern(test_wbuf, sizeof(test_wbuf), 1);
+
+    TEST_ASSERT_EQ(ahci_write_sectors(AHCI_HOST_PORT, 1000, TEST_SECTORS, test_wbuf),
+                   AHCI_SUCCESS);
+    TEST_ASSERT_MEM_EQ(hba_model_disk() + 1000 * AHCI_SECTOR_SIZE, test_wbuf, sizeof(test_wbuf));
+    TEST_ASSERT_EQ(ahci_read_sectors(AHCI_HOST_PORT, 1000, TEST_SECTORS, test_rbuf),
+                   AHCI_SUCCESS);
+    TEST_ASSERT_MEM_EQ(test_rbuf, test_wbuf, sizeof(test_wbuf));
+
+    /* Past the end of the disk the drive aborts the command */
+    TEST_ASSERT_EQ(ahci_read_sectors(AHCI_HOST_PORT, AHCI_HOST_SECTORS - 1, 2, test_rbuf),
+                   AHCI_ERR_TASK_FILE);
+    TEST_ASSERT(test_port_works(1000));
+
+    hba_model_stats_t st;
+    hba_model_stats(&st);
+    TEST_ASSERT_EQ(st.protocol_errors, 0);
+    TEST_PASS();
+}
+
+TEST_CASE(test_ahci_scatter_gather) {
+    test_model_defaults();
+    test_pattern(test_wbuf, 8 * AHCI_SECTOR_SIZE, 2);
+
+    /* Unaligned segment boundaries, reassembled by the PRDT */
+    ahci_sg_t out[3] = {
+        { test_wbuf, 512 },
+        { test_wbuf + 512, 1536 },
+        { test_wbuf + 2048, 2048 },
+    };
+    TEST_ASSERT_EQ(ahci_writev(AHCI_HOST_PORT, 2000, out, 3), AHCI_SUCCESS);
+    TEST_ASSERT_MEM_EQ(hba_model_disk() + 2000 * AHCI_SECTOR_SIZE, test_wbuf, 4096);
+
+    ahci_sg_t in[2] = {
+        { test_rbuf + 4096, 1000 },
+        { test_rbuf, 3096 },
+    };
+    TEST_ASSERT_EQ(ahci_readv(AHCI_HOST_PORT, 2000, in, 2), AHCI_SUCCESS);
+    TEST_ASSERT_MEM_EQ(test_rbuf + 4096, test_wbuf, 1000);
+    TEST_ASSERT_MEM_EQ(test_rbuf, test_wbuf + 1000, 3096);
+
+    hba_model_stats_t st;
+    hba_model_stats(&st);
+    TEST_ASSERT_EQ(st.protocol_errors, 0);
+    TEST_PASS();
+}
+
+/* ============================================================================
+ * Queueing and Completion
+ * ============================================================================ */
+
+TEST_CASE(test_ahci_ncq_depth) {
+    test_model_defaults();
+    hba_model_set_timing(2000, 0);
+
+    for (int i = 0; i < TEST_REQUESTS; i++) {
+        TEST_ASSERT_EQ(test_submit_read(i, (uint64_t)i * 8), AHCI_SUCCESS);
+    }
+    for (int i = 0; i < TEST_REQUESTS; i++) {
+        TEST_ASSERT_EQ(ahci_wait(AHCI_HOST_PORT, &test_reqs[i]), AHCI_SUCCESS);
+    }
+
+    hba_model_stats_t st;
+    hba_model_stats(&st);
+    TEST_ASSERT_EQ(test_done_calls, TEST_REQUESTS);
+    TEST_ASSERT_EQ(st.queued, TEST_REQUESTS);
+    TEST_ASSERT_EQ(st.max_in_flight, 32);
+    TEST_ASSERT_EQ(st.protocol_errors, 0);
+    test_model_defaults();
+    TEST_PASS();
+}
+
+TEST_CASE(test_ahci_flush_runs_alone) {
+    test_model_defaults();
+    hba_model_set_timing(500, 0);
+
+    ahci_request_t flush = { 0 };
+    flush.op = AHCI_OP_FLUSH;
+
+    for (int i = 0; i < 8; i++) {
+        TEST_ASSERT_EQ(test_submit_read(i, (uint64_t)i * 8), AHCI_SUCCESS);
+    }
+    TEST_ASSERT_EQ(ahci_submit(AHCI_HOST_PORT, &flush), AHCI_SUCCESS);
+    for (int i = 8; i < 16; i++) {
+        TEST_ASSERT_EQ(test_submit_read(i, (uint64_t)i * 8), AHCI_SUCCESS);
+    }
+
+    for (int i = 0; i < 16; i++) {
+        TEST_ASSERT_EQ(ahci_wait(AHCI_HOST_PORT, &test_reqs[i]), AHCI_SUCCESS);
+    }
+    TEST_ASSERT_EQ(ahci_wait(AHCI_HOST_PORT, &flush), AHCI_SUCCESS);
+
+    /* The model counts a non-queued command overlapping others */
+    hba_model_stats_t st;
+    hba_model_stats(&st);
+    TEST_ASSERT_EQ(st.commands, 17);
+    TEST_ASSERT_EQ(st.protocol_errors, 0);
+    test_model_defaults();
+    TEST_PASS();
+}
+
+TEST_CASE(test_ahci_interrupt_completion) {
+    test_model_defaults();
+    hba_model_set_timing(1000, 0);
+
+    TEST_ASSERT_EQ(test_submit_read(0, 4096), AHCI_SUCCESS);
+    test_spin_us(2000);
+
+    /* Done on the drive, but nobody has looked yet */
+    TEST_ASSERT(!test_reqs[0].complete);
+    TEST_ASSERT(ahci_host_interrupt());
+    TEST_ASSERT(test_reqs[0].complete);
+    TEST_ASSERT_EQ(test_reqs[0].status, AHCI_SUCCESS);
+    TEST_ASSERT_EQ(test_done_calls, 1);
+
+    /* The handler acknowledged it */
+    TEST_ASSERT(!ahci_host_interrupt());
+    test_model_defaults();
+    TEST_PASS();
+}
+
+/* ============================================================================
+ * Error Handling
+ * ============================================================================ */
+
+/*
+ * A task file error halts the port with the other queued commands still
+ * in flight. ahci_port_reap() must take the ones completed before it,
+ * then ahci_port_abort() fails the rest, restarts the port and issues
+ * what was waiting for a slot.
+ */
+TEST_CASE(test_ahci_task_file_error_aborts_port) {
+    const int bad = 5;
+
+    test_model_defaults();
+    hba_model_set_timing(5000, 0);
+    hba_model_fail_lba((uint64_t)bad * 8 + 3);
+
+    for (int i = 0; i < 40; i++) {
+        TEST_ASSERT_EQ(test_submit_read(i, (uint64_t)i * 8), AHCI_SUCCESS);
+    }
+
+    /* Let the drive finish the first commands and stop on the bad one
+     * before the driver looks, so nothing is reissued in between */
+    test_spin_us(6000);
+    hba_model_poll();
+    for (int i = 0; i < 40; i++) {
+        int status = ahci_wait(AHCI_HOST_PORT, &test_reqs[i]);
+        if (i < bad || i >= 32) {
+            TEST_ASSERT_EQ(status, AHCI_SUCCESS);       /* Before the error, or queued */
+        } else {
+            TEST_ASSERT_EQ(status, AHCI_ERR_TASK_FILE); /* Failing or in flight */
+        }
+    }
+    TEST_ASSERT_EQ(test_done_calls, 40);
+
+    hba_model_stats_t st;
+    hba_model_stats(&st);
+    TEST_ASSERT_EQ(st.errors, 1);
+    TEST_ASSERT_EQ(st.aborted, 32 - bad);        /* Dropped by the port restart */
+    TEST_ASSERT_EQ(st.protocol_errors, 0);
+
+    hba_model_fail_lba(HBA_MODEL_NO_FAULT);
+    TEST_ASSERT(test_port_works(100));
+    test_model_defaults();
+    TEST_PASS();
+}
+
+/*
+ * A drive that stops answering: sleepers rely on ahci_watchdog(), which
+ * must give up after AHCI_CMD_TIMEOUT and not a tick earlier.
+ */
+TEST_CASE(test_ahci_watchdog_timeout) {
+    test_model_defaults();
+    hba_model_set_hang(true);
+
+    TEST_ASSERT_EQ(test_submit_read(0, 0), AHCI_SUCCESS);
+    TEST_ASSERT_EQ(test_submit_read(1, 8), AHCI_SUCCESS);
+
+    ahci_host_tick(TEST_TIMEOUT_TICKS - 1);
+    TEST_ASSERT(!ahci_host_interrupt());
+    TEST_ASSERT(!test_reqs[0].complete);
+    TEST_ASSERT(!test_reqs[1].complete);
+
+    ahci_host_tick(1);
+    TEST_ASSERT(test_reqs[0].complete);
+    TEST_ASSERT(test_reqs[1].complete);
+    TEST_ASSERT_EQ(test_reqs[0].status, AHCI_ERR_TIMEOUT);
+    TEST_ASSERT_EQ(test_reqs[1].status, AHCI_ERR_TIMEOUT);
+    TEST_ASSERT_EQ(test_done_calls, 2);
+
+    hba_model_stats_t st;
+    hba_model_stats(&st);
+    TEST_ASSERT_EQ(st.aborted, 2);
+
+    hba_model_set_hang(false);
+    TEST_ASSERT(test_port_works(200));
+    test_model_defaults();
+    TEST_PASS();
+}
+
+/*
+ * A completion whose interrupt never arrives is picked up by the
+ * watchdog's final reap instead of being failed.
+ */
+TEST_CASE(test_ahci_watchdog_lost_interrupt) {
+    test_model_defaults();
+
+    TEST_ASSERT_EQ(test_submit_read(0, 64), AHCI_SUCCESS);
+    hba_model_poll();
+
+    ahci_host_tick(TEST_TIMEOUT_TICKS - 1);
+    TEST_ASSERT(!test_reqs[0].complete);
+
+    ahci_host_tick(1);
+    TEST_ASSERT(test_reqs[0].complete);
+    TEST_ASSERT_EQ(test_reqs[0].status, AHCI_SUCCESS);
+
+    hba_model_stats_t st;
+    hba_model_stats(&st);
+    TEST_ASSERT_EQ(st.aborted, 0);
+    TEST_ASSERT_EQ(st.completed, 1);
+    test_model_defaults();
+    TEST_PASS();
+}
+
+/* ============================================================================
+ * Runner
+ * ============================================================================ */
+
+int ahci_host_run_tests(void) {
+    return (int)test_run_all();
+}
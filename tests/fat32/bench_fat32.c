@@ -0,0 +1,342 @@
+/**
+ * AAAos FAT32 Host Harness - Benchmark
+ *
+ * Each phase starts from a cold buffer cache and ends with the filesystem
+ * and the cache written back, so the block I/O counts include the
+ * metadata and data writes the phase caused, not just what happened to
+ * miss the cache. Timings are host wall-clock time and only comparable
+ * between runs on the same machine; the I/O counts are exact and
+ * reproducible.
+ */
+
+#include "fat32_host.h"
+
+#define BENCH_MAX_IO        (1 * MB)
+#define BENCH_DIR           "/bench"
+#define BENCH_SEQ_FILE      "/bench/seq.dat"
+#define BENCH_PATH_MAX      1024
+
+static uint8_t bench_buf[BENCH_MAX_IO];
+static uint64_t bench_rng = 0x9E3779B97F4A7C15ULL;
+
+/**
+ * Phase measurement
+ */
+typedef struct {
+    const char  *name;
+    uint64_t    start_ns;
+    uint64_t    ops;
+    uint64_t    bytes;
+} bench_phase_t;
+
+/* ============================================================================
+ * Helpers
+ * ============================================================================ */
+
+static uint64_t bench_random(void) {
+    bench_rng ^= bench_rng << 13;
+    bench_rng ^= bench_rng >> 7;
+    bench_rng ^= bench_rng << 17;
+    return bench_rng;
+}
+
+static void bench_begin(bench_phase_t *phase, const char *name) {
+    fat32_host_sync(true);
+    fat32_host_io_reset();
+
+    phase->name = name;
+    phase->ops = 0;
+    phase->bytes = 0;
+    phase->start_ns = host_now_ns();
+}
+
+/**
+ * Finish a phase: write everything back and print its line
+ */
+static void bench_end(bench_phase_t *phase) {
+    fat32_host_sync(false);
+    uint64_t ns = host_now_ns() - phase->start_ns;
+
+    fat32_host_io_stats_t io;
+    fat32_host_io_stats(&io);
+
+    uint64_t ops = phase->ops ? phase->ops : 1;
+    uint64_t us = ns / 1000 ? ns / 1000 : 1;
+
+    /* Per-operation figures in hundredths */
+    uint64_t reads = io.reads * 100 / ops;
+    uint64_t writes = io.writes * 100 / ops;
+    uint64_t sectors = (io.sectors_read + io.sectors_written) * 100 / ops;
+
+    host_print("%-14s %8llu %9llu.%03llu %10llu %6llu.%02llu %6llu.%02llu %8llu.%02llu",
+               phase->name, phase->ops, ns / 1000000000ULL, (ns / 1000000ULL) % 1000,
+               phase->ops * 1000000ULL / us,
+               reads / 100, reads % 100, writes / 100, writes % 100,
+               sectors / 100, sectors % 100);
+    if (phase->bytes) {
+        host_print(" %8llu", phase->bytes * 1000000ULL / us / KB);
+    }
+    host_print("\n");
+}
+
+static void bench_file_name(char *buf, size_t size, uint32_t index) {
+    host_snprintf(buf, size, BENCH_DIR "/files/f%06u.dat", index);
+}
+
+/* ============================================================================
+ * Phases
+ * ============================================================================ */
+
+static int bench_create(const fat32_bench_params_t *p) {
+    bench_phase_t phase;
+    char path[BENCH_PATH_MAX];
+
+    if (vfs_mkdir(BENCH_DIR "/files", 0755) != VFS_OK) {
+        return -1;
+    }
+
+    /* Files of one small write each, like a source tree checkout */
+    bench_begin(&phase, "create");
+    for (uint32_t i = 0; i < p->files; i++) {
+        bench_file_name(path, sizeof(path), i);
+        vfs_file_t *file = vfs_open(path, VFS_O_WRONLY | VFS_O_CREAT | VFS_O_TRUNC);
+        if (!file || vfs_write(file, bench_buf, 1000) != 1000) {
+            host_print("bench: create %s failed\n", path);
+            if (file) {
+                vfs_close(file);
+            }
+            return -1;
+        }
+        vfs_close(file);
+        phase.ops++;
+    }
+    bench_end(&phase);
+
+    bench_begin(&phase, "stat");
+    for (uint32_t i = 0; i < p->files; i++) {
+        vfs_stat_t st;
+        bench_file_name(path, sizeof(path), (uint32_t)(bench_random() % p->files));
+        if (vfs_stat(path, &st) != VFS_OK) {
+            return -1;
+        }
+        phase.ops++;
+    }
+    bench_end(&phase);
+
+    bench_begin(&phase, "readdir");
+    vfs_dir_t *dir = vfs_opendir(BENCH_DIR "/files");
+    if (!dir) {
+        return -1;
+    }
+    while (vfs_readdir(dir) != NULL) {
+        phase.ops++;
+    }
+    vfs_closedir(dir);
+    bench_end(&phase);
+    return 0;
+}
+
+static int bench_unlink(const fat32_bench_params_t *p) {
+    bench_phase_t phase;
+    char path[BENCH_PATH_MAX];
+
+    bench_begin(&phase, "unlink");
+    for (uint32_t i = 0; i < p->files; i++) {
+        bench_file_name(path, sizeof(path), i);
+        if (vfs_unlink(path) != VFS_OK) {
+            host_print("bench: unlink %s failed\n", path);
+            return -1;
+        }
+        phase.ops++;
+    }
+    bench_end(&phase);
+    return 0;
+}
+
+static int bench_sequential(const fat32_bench_params_t *p) {
+    bench_phase_t phase;
+
+    bench_begin(&phase, "seq-write");
+    vfs_file_t *file = vfs_open(BENCH_SEQ_FILE, VFS_O_WRONLY | VFS_O_CREAT | VFS_O_TRUNC);
+    if (!file) {
+        return -1;
+    }
+    for (uint64_t off = 0; off < p->seq_bytes; off += p->io_size) {
+        size_t n = (size_t)MIN((uint64_t)p->io_size, p->seq_bytes - off);
+        if (vfs_write(file, bench_buf, n) != (ssize_t)n) {
+            vfs_close(file);
+            return -1;
+        }
+        phase.ops++;
+        phase.bytes += n;
+    }
+    vfs_close(file);
+    bench_end(&phase);
+
+    bench_begin(&phase, "seq-read");
+    file = vfs_open(BENCH_SEQ_FILE, VFS_O_RDONLY);
+    if (!file) {
+        return -1;
+    }
+    ssize_t n;
+    while ((n = vfs_read(file, bench_buf, p->io_size)) > 0) {
+        phase.ops++;
+        phase.bytes += (uint64_t)n;
+    }
+    vfs_close(file);
+    bench_end(&phase);
+
+    return phase.bytes == p->seq_bytes ? 0 : -1;
+}
+
+static int bench_random_io(const fat32_bench_params_t *p) {
+    bench_phase_t phase;
+    uint64_t blocks = p->seq_bytes / p->random_size;
+
+    if (blocks == 0) {
+        return 0;
+    }
+
+    vfs_file_t *file = vfs_open(BENCH_SEQ_FILE, VFS_O_RDWR);
+    if (!file) {
+        return -1;
+    }
+
+    bench_begin(&phase, "rand-read");
+    for (uint32_t i = 0; i < p->random_ops; i++) {
+        uint64_t off = (bench_random() % blocks) * p->random_size;
+        if (vfs_pread(file, bench_buf, p->random_size, off) != (ssize_t)p->random_size) {
+            vfs_close(file);
+            return -1;
+        }
+        phase.ops++;
+        phase.bytes += p->random_size;
+    }
+    bench_end(&phase);
+
+    bench_begin(&phase, "rand-write");
+    for (uint32_t i = 0; i < p->random_ops; i++) {
+        uint64_t off = (bench_random() % blocks) * p->random_size;
+        if (vfs_pwrite(file, bench_buf, p->random_size, off) != (ssize_t)p->random_size) {
+            vfs_close(file);
+            return -1;
+        }
+        phase.ops++;
+        phase.bytes += p->random_size;
+    }
+    vfs_close(file);
+    bench_end(&phase);
+    return 0;
+}
+
+static int bench_deep_lookup(const fat32_bench_params_t *p) {
+    bench_phase_t phase;
+    char path[BENCH_PATH_MAX];
+    size_t len = 0;
+
+    len += (size_t)host_snprintf(path, sizeof(path), BENCH_DIR "/deep");
+    if (vfs_mkdir(path, 0755) != VFS_OK) {
+        return -1;
+    }
+
+    bench_begin(&phase, "mkdir-deep");
+    for (uint32_t i = 0; i < p->depth && len + 16 < sizeof(path); i++) {
+        len += (size_t)host_snprintf(path + len, sizeof(path) - len, "/d%u", i);
+        if (vfs_mkdir(path, 0755) != VFS_OK) {
+            host_print("bench: mkdir %s failed\n", path);
+            return -1;
+        }
+        phase.ops++;
+    }
+    host_snprintf(path + len, sizeof(path) - len, "/leaf.txt");
+    if (vfs_create(path, 0644) != VFS_OK) {
+        return -1;
+    }
+    bench_end(&phase);
+
+    /* The first lookup walks the disk; the rest show the cached cost */
+    bench_begin(&phase, "lookup-deep");
+    for (uint32_t i = 0; i < p->lookups; i++) {
+        vfs_stat_t st;
+        if (vfs_stat(path, &st) != VFS_OK) {
+            return -1;
+        }
+        phase.ops++;
+    }
+    bench_end(&phase);
+    return 0;
+}
+
+/**
+ * Cold mount, then the first free-space query, which answers from FSInfo
+ * without waiting for the background scan of the FAT
+ */
+static int bench_mount(void) {
+    bench_phase_t phase;
+
+    if (fat32_host_unmount() != VFS_OK) {
+        return -1;
+    }
+
+    bench_begin(&phase, "mount");
+    if (fat32_host_mount() != VFS_OK) {
+        return -1;
+    }
+    phase.ops++;
+    bench_end(&phase);
+
+    bench_begin(&phase, "statfs");
+    fat32_statfs_t st;
+    if (fat32_statfs((fat32_fs_t *)vfs_get_mount(FAT32_HOST_MOUNT)->fs_data, &st) != 0) {
+        return -1;
+    }
+    phase.ops++;
+    bench_end(&phase);
+    return 0;
+}
+
+/* ============================================================================
+ * Runner
+ * ============================================================================ */
+
+int fat32_host_run_bench(const char *path, uint64_t size, const fat32_bench_params_t *params) {
+    fat32_bench_params_t p = *params;
+    p.io_size = MIN(p.io_size, (uint32_t)BENCH_MAX_IO);
+    p.random_size = MIN(p.random_size, (uint32_t)BENCH_MAX_IO);
+
+    if (!fat32_host_attach(path, size)) {
+        return -1;
+    }
+    if (fat32_host_mkfs(0) != 0 || fat32_host_mount() != VFS_OK ||
+        vfs_mkdir(BENCH_DIR, 0755) != VFS_OK) {
+        host_print("bench: cannot format and mount %s\n", path);
+        fat32_host_detach();
+        return -1;
+    }
+
+    for (size_t i = 0; i < sizeof(bench_buf); i++) {
+        bench_buf[i] = (uint8_t)bench_random();
+    }
+
+    fat32_statfs_t st;
+    fat32_statfs((fat32_fs_t *)vfs_get_mount(FAT32_HOST_MOUNT)->fs_data, &st);
+    host_print("FAT32 benchmark: %llu MB image, %u byte clusters, %u files, "
+               "%llu KB sequential file\n",
+               size / MB, st.cluster_size, p.files, p.seq_bytes / KB);
+    host_print("%-14s %8s %13s %10s %9s %9s %11s %8s\n",
+               "phase", "ops", "seconds", "ops/s", "reads/op", "writes/op",
+               "sectors/op", "KB/s");
+
+    int result = 0;
+    if (bench_create(&p) != 0 || bench_sequential(&p) != 0 ||
+        bench_random_io(&p) != 0 || bench_deep_lookup(&p) != 0 ||
+        bench_mount() != 0 || bench_unlink(&p) != 0) {
+        host_print("bench: phase failed\n");
+        result = -1;
+    }
+
+    fat32_host_unmount();
+    fat32_host_detach();
+    host_unlink(path);
+    return result;
+}
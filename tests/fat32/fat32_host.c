@@ -0,0 +1,601 @@
+/**
+ * AAAos FAT32 Host Harness
+ *
+ * Image-backed block device, formatter and command line.
+ *
+ * Usage: fat32_host [-v] <command> ...
+ *   test [image]                       Run the test suite on a scratch image
+ *   bench [options] [image]            Run the benchmark on a scratch image
+ *   mkfs <image> <size> [spc]          Create and format an image
+ *   ls <image> <path>                  List a directory
+ *   get <image> <path> <hostfile>      Copy a file out of an image
+ *   put <image> <hostfile> <path>      Copy a file into an image
+ *   mkdir <image> <path>               Create a directory
+ *   rm <image> <path>                  Delete a file
+ *   df <image>                         Show space usage
+ */
+
+#include "fat32_host.h"
+#include "../../drivers/storage/bcache.h"
+#include "../../drivers/storage/bio.h"
+
+#define FAT32_HOST_DEFAULT_IMAGE    "fat32_host.img"
+#define FAT32_HOST_COPY_CHUNK       (64 * KB)
+
+/* Formatter defaults (mkfs.fat) */
+#define MKFS_RESERVED_SECTORS       32
+#define MKFS_NUM_FATS               2
+#define MKFS_FSINFO_SECTOR          1
+#define MKFS_BACKUP_BOOT_SECTOR     6
+#define MKFS_MEDIA_FIXED            0xF8
+#define MKFS_ZERO_CHUNK             128         /* Sectors written at a time */
+
+/**
+ * Image device state
+ */
+typedef struct {
+    int                     fd;
+    uint64_t                sectors;
+    block_device_t          *blkdev;
+    fat32_host_io_stats_t   stats;
+} fat32_host_image_t;
+
+static fat32_host_image_t image = { .fd = -1 };
+
+/* ============================================================================
+ * Image Block Device
+ * ============================================================================ */
+
+static int image_read(void *device, uint64_t lba, uint32_t count, void *buffer) {
+    fat32_host_image_t *img = (fat32_host_image_t *)device;
+
+    if (lba + count > img->sectors) {
+        return BLKDEV_ERR_RANGE;
+    }
+    if (host_pread(img->fd, buffer, (unsigned long)count * BLKDEV_SECTOR_SIZE,
+                   lba * BLKDEV_SECTOR_SIZE) != 0) {
+        return BLKDEV_ERR_IO;
+    }
+
+    img->stats.reads++;
+    img->stats.sectors_read += count;
+    return BLKDEV_SUCCESS;
+}
+
+static int image_write(void *device, uint64_t lba, uint32_t count, const void *buffer) {
+    fat32_host_image_t *img = (fat32_host_image_t *)device;
+
+    if (lba + count > img->sectors) {
+        return BLKDEV_ERR_RANGE;
+    }
+    if (host_pwrite(img->fd, buffer, (unsigned long)count * BLKDEV_SECTOR_SIZE,
+                    lba * BLKDEV_SECTOR_SIZE) != 0) {
+        return BLKDEV_ERR_IO;
+    }
+
+    img->stats.writes++;
+    img->stats.sectors_written += count;
+    return BLKDEV_SUCCESS;
+}
+
+/*
+ * Requests are taken whole, as a scatter-gather controller takes them, so
+ * the counters show one I/O per merged request rather than one per
+ * buffer-cache page. They complete before submit returns.
+ */
+static int image_submit(void *device, blk_request_t *rq) {
+    fat32_host_image_t *img = (fat32_host_image_t *)device;
+    int status = BLKDEV_SUCCESS;
+
+    for (bio_t *bio = rq->bio; bio && status == BLKDEV_SUCCESS; bio = bio->next) {
+        unsigned long len = (unsigned long)bio->count * BLKDEV_SECTOR_SIZE;
+        uint64_t offset = bio->lba * BLKDEV_SECTOR_SIZE;
+
+        if (bio->lba + bio->count > img->sectors) {
+            status = BLKDEV_ERR_RANGE;
+        } else if (rq->op == BIO_WRITE) {
+            status = host_pwrite(img->fd, bio->buf, len, offset) ? BLKDEV_ERR_IO : BLKDEV_SUCCESS;
+        } else {
+            status = host_pread(img->fd, bio->buf, len, offset) ? BLKDEV_ERR_IO : BLKDEV_SUCCESS;
+        }
+    }
+
+    if (rq->op == BIO_WRITE) {
+        img->stats.writes++;
+        img->stats.sectors_written += rq->count;
+    } else {
+        img->stats.reads++;
+        img->stats.sectors_read += rq->count;
+    }
+
+    blk_end_request(rq, status);
+    return BLKDEV_SUCCESS;
+}
+
+/*
+ * Cache flushes are counted but do not fsync the image: the harness
+ * measures what the filesystem asks of the disk, and host writeback would
+ * only add noise to the timings.
+ */
+static int image_flush(void *device) {
+    fat32_host_image_t *img = (fat32_host_image_t *)device;
+    img->stats.flushes++;
+    return BLKDEV_SUCCESS;
+}
+
+static block_ops_t image_ops = {
+    .read_sectors   = image_read,
+    .write_sectors  = image_write,
+    .flush          = image_flush,
+    .submit         = image_submit,
+};
+
+/* ============================================================================
+ * Public API
+ * ============================================================================ */
+
+block_device_t* fat32_host_attach(const char *path, uint64_t create_size) {
+    if (image.fd >= 0) {
+        return NULL;
+    }
+
+    image.fd = host_open_image(path, create_size);
+    if (image.fd < 0) {
+        return NULL;
+    }
+
+    image.sectors = host_image_size(image.fd) / BLKDEV_SECTOR_SIZE;
+    __builtin_memset(&image.stats, 0, sizeof(image.stats));
+
+    image.blkdev = blkdev_register(FAT32_HOST_DEVICE, &image_ops, &image, image.sectors);
+    if (!image.blkdev) {
+        host_close(image.fd);
+        image.fd = -1;
+        return NULL;
+    }
+    return image.blkdev;
+}
+
+void fat32_host_detach(void) {
+    if (image.fd < 0) {
+        return;
+    }
+
+    blkdev_flush(image.blkdev);
+    blkdev_unregister(image.blkdev);
+    host_close(image.fd);
+
+    image.blkdev = NULL;
+    image.fd = -1;
+}
+
+int fat32_host_mount(void) {
+    if (!image.blkdev) {
+        return VFS_ERR_NXIO;
+    }
+    return vfs_mount(FAT32_HOST_MOUNT, "fat32", image.blkdev);
+}
+
+int fat32_host_unmount(void) {
+    int result = vfs_unmount(FAT32_HOST_MOUNT);
+
+    if (image.blkdev) {
+        blkdev_flush(image.blkdev);
+        bcache_invalidate(image.blkdev);
+    }
+    return result;
+}
+
+void fat32_host_sync(bool drop) {
+    vfs_mount_t *mount = vfs_get_mount(FAT32_HOST_MOUNT);
+    if (mount && mount->active && mount->ops && mount->ops->sync_fs) {
+        mount->ops->sync_fs(mount);
+    }
+
+    if (image.blkdev) {
+        blkdev_flush(image.blkdev);
+        if (drop) {
+            bcache_invalidate(image.blkdev);
+        }
+    }
+}
+
+void fat32_host_io_stats(fat32_host_io_stats_t *stats) {
+    *stats = image.stats;
+}
+
+void fat32_host_io_reset(void) {
+    __builtin_memset(&image.stats, 0, sizeof(image.stats));
+}
+
+/* ============================================================================
+ * Formatter
+ * ============================================================================ */
+
+/**
+ * Cluster size mkfs.fat picks for a FAT32 volume
+ */
+static uint32_t mkfs_default_cluster(uint64_t sectors) {
+    uint64_t bytes = sectors * BLKDEV_SECTOR_SIZE;
+
+    if (bytes <= 260ULL * MB) {
+        return 1;
+    }
+    if (bytes <= 8ULL * GB) {
+        return 8;
+    }
+    if (bytes <= 16ULL * GB) {
+        return 16;
+    }
+    if (bytes <= 32ULL * GB) {
+        return 32;
+    }
+    return 64;
+}
+
+static int mkfs_write(uint64_t lba, uint32_t count, const void *buf) {
+    return host_pwrite(image.fd, buf, (unsigned long)count * BLKDEV_SECTOR_SIZE,
+                       lba * BLKDEV_SECTOR_SIZE);
+}
+
+int fat32_host_mkfs(uint32_t sectors_per_cluster) {
+    if (image.fd < 0 || image.sectors > UINT32_MAX) {
+        return -1;
+    }
+
+    uint32_t total = (uint32_t)image.sectors;
+    uint32_t spc = sectors_per_cluster ? sectors_per_cluster : mkfs_default_cluster(total);
+    if (spc == 0 || (spc & (spc - 1)) != 0 || spc > 128 ||
+        total < MKFS_RESERVED_SECTORS + 64 * spc) {
+        host_print("mkfs: invalid geometry (%u sectors, %u per cluster)\n", total, spc);
+        return -1;
+    }
+
+    /* FAT size as in the FAT specification; may round up by a sector */
+    uint32_t tmp1 = total - MKFS_RESERVED_SECTORS;
+    uint32_t tmp2 = (256 * spc + MKFS_NUM_FATS) / 2;
+    uint32_t fat_size = (tmp1 + tmp2 - 1) / tmp2;
+    uint32_t data_start = MKFS_RESERVED_SECTORS + MKFS_NUM_FATS * fat_size;
+    uint32_t clusters = (total - data_start) / spc;
+
+    if (clusters < 65525) {
+        host_print("mkfs: warning: %u clusters is below the FAT32 minimum\n", clusters);
+    }
+
+    /* Clear the reserved area, the FATs and the root directory */
+    uint8_t *zero = host_alloc(MKFS_ZERO_CHUNK * BLKDEV_SECTOR_SIZE);
+    if (!zero) {
+        return -1;
+    }
+    __builtin_memset(zero, 0, MKFS_ZERO_CHUNK * BLKDEV_SECTOR_SIZE);
+
+    uint32_t end = data_start + spc;
+    for (uint32_t lba = 0; lba < end; lba += MKFS_ZERO_CHUNK) {
+        if (mkfs_write(lba, MIN(MKFS_ZERO_CHUNK, end - lba), zero) != 0) {
+            host_free(zero);
+            return -1;
+        }
+    }
+    host_free(zero);
+
+    /* Boot sector, with its backup */
+    fat32_bpb_t bpb;
+    __builtin_memset(&bpb, 0, sizeof(bpb));
+    bpb.jmp_boot[0] = 0xEB;
+    bpb.jmp_boot[1] = 0x58;
+    bpb.jmp_boot[2] = 0x90;
+    __builtin_memcpy(bpb.oem_name, "MSWIN4.1", 8);
+    bpb.bytes_per_sector = BLKDEV_SECTOR_SIZE;
+    bpb.sectors_per_cluster = (uint8_t)spc;
+    bpb.reserved_sectors = MKFS_RESERVED_SECTORS;
+    bpb.num_fats = MKFS_NUM_FATS;
+    bpb.media_type = MKFS_MEDIA_FIXED;
+    bpb.sectors_per_track = 32;
+    bpb.num_heads = 64;
+    bpb.total_sectors_32 = total;
+    bpb.fat_size_32 = fat_size;
+    bpb.root_cluster = FAT32_FIRST_DATA_CLUSTER;
+    bpb.fs_info_sector = MKFS_FSINFO_SECTOR;
+    bpb.backup_boot_sector = MKFS_BACKUP_BOOT_SECTOR;
+    bpb.drive_number = 0x80;
+    bpb.boot_signature = 0x29;
+    bpb.volume_id = (uint32_t)host_now_ns();
+    __builtin_memcpy(bpb.volume_label, "NO NAME    ", 11);
+    __builtin_memcpy(bpb.fs_type, "FAT32   ", 8);
+    bpb.boot_sector_sig = FAT32_BOOT_SIGNATURE;
+
+    /* FSInfo, with its backup */
+    fat32_fsinfo_t fsinfo;
+    __builtin_memset(&fsinfo, 0, sizeof(fsinfo));
+    fsinfo.lead_sig = FAT32_FSINFO_LEAD_SIG;
+    fsinfo.struc_sig = FAT32_FSINFO_STRUC_SIG;
+    fsinfo.free_count = clusters - 1;
+    fsinfo.next_free = FAT32_FIRST_DATA_CLUSTER + 1;
+    fsinfo.trail_sig = FAT32_FSINFO_TRAIL_SIG;
+
+    /* Media descriptor, reserved entry and the root directory's chain */
+    uint32_t fat[BLKDEV_SECTOR_SIZE / sizeof(uint32_t)];
+    __builtin_memset(fat, 0, sizeof(fat));
+    fat[0] = 0x0FFFFF00 | MKFS_MEDIA_FIXED;
+    fat[1] = FAT32_CLUSTER_EOF;
+    fat[2] = FAT32_CLUSTER_EOF;
+
+    if (mkfs_write(0, 1, &bpb) != 0 ||
+        mkfs_write(MKFS_BACKUP_BOOT_SECTOR, 1, &bpb) != 0 ||
+        mkfs_write(MKFS_FSINFO_SECTOR, 1, &fsinfo) != 0 ||
+        mkfs_write(MKFS_BACKUP_BOOT_SECTOR + MKFS_FSINFO_SECTOR, 1, &fsinfo) != 0) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < MKFS_NUM_FATS; i++) {
+        if (mkfs_write(MKFS_RESERVED_SECTORS + i * fat_size, 1, fat) != 0) {
+            return -1;
+        }
+    }
+
+    /* Nothing of the old contents may survive in the buffer cache */
+    if (image.blkdev) {
+        bcache_invalidate(image.blkdev);
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * Commands
+ * ============================================================================ */
+
+static int cmd_mkfs(int argc, char **argv) {
+    unsigned long long size;
+    unsigned long long spc = 0;
+
+    if (argc < 2 || host_parse_size(argv[1], &size) != 0 ||
+        (argc > 2 && host_parse_size(argv[2], &spc) != 0)) {
+        host_print("usage: mkfs <image> <size> [sectors-per-cluster]\n");
+        return 2;
+    }
+
+    if (!fat32_host_attach(argv[0], size)) {
+        return 1;
+    }
+    int result = fat32_host_mkfs((uint32_t)spc);
+    fat32_host_detach();
+    return result == 0 ? 0 : 1;
+}
+
+static int cmd_ls(const char *path) {
+    vfs_dir_t *dir = vfs_opendir(path);
+    if (!dir) {
+        host_print("ls: %s: %s\n", path, vfs_strerror(vfs_get_error()));
+        return 1;
+    }
+
+    vfs_dirent_t *ent;
+    while ((ent = vfs_readdir(dir)) != NULL) {
+        if (host_strcmp(ent->d_name, ".") == 0 || host_strcmp(ent->d_name, "..") == 0) {
+            continue;
+        }
+
+        if (ent->d_type == VFS_NODE_DIRECTORY) {
+            host_print("%s/\n", ent->d_name);
+            continue;
+        }
+
+        char full[VFS_PATH_MAX];
+        vfs_stat_t st;
+        host_snprintf(full, sizeof(full), "%s/%s", path, ent->d_name);
+        if (vfs_stat(full, &st) != VFS_OK) {
+            st.st_size = 0;
+        }
+        host_print("%s %llu\n", ent->d_name, st.st_size);
+    }
+
+    vfs_closedir(dir);
+    return 0;
+}
+
+static int cmd_get(const char *path, const char *host_path) {
+    vfs_stat_t st;
+    if (vfs_stat(path, &st) != VFS_OK) {
+        host_print("get: %s: %s\n", path, vfs_strerror(vfs_get_error()));
+        return 1;
+    }
+
+    uint8_t *data = host_alloc(st.st_size ? st.st_size : 1);
+    vfs_file_t *file = vfs_open(path, VFS_O_RDONLY);
+    if (!data || !file) {
+        host_free(data);
+        host_print("get: %s: cannot open\n", path);
+        return 1;
+    }
+
+    ssize_t n = vfs_read(file, data, st.st_size);
+    vfs_close(file);
+
+    int result = 1;
+    if (n == (ssize_t)st.st_size) {
+        result = host_write_file(host_path, data, st.st_size) == 0 ? 0 : 1;
+    } else {
+        host_print("get: %s: short read (%lld of %llu bytes)\n",
+                   path, (long long)n, st.st_size);
+    }
+    host_free(data);
+    return result;
+}
+
+static int cmd_put(const char *host_path, const char *path) {
+    void *data;
+    unsigned long len;
+    if (host_read_file(host_path, &data, &len) != 0) {
+        return 1;
+    }
+
+    vfs_file_t *file = vfs_open(path, VFS_O_WRONLY | VFS_O_CREAT | VFS_O_TRUNC);
+    if (!file) {
+        host_print("put: %s: %s\n", path, vfs_strerror(vfs_get_error()));
+        host_free(data);
+        return 1;
+    }
+
+    /* Written in chunks, as a program copying a file would */
+    int result = 0;
+    for (unsigned long off = 0; off < len; off += FAT32_HOST_COPY_CHUNK) {
+        size_t chunk = MIN(len - off, (unsigned long)FAT32_HOST_COPY_CHUNK);
+        if (vfs_write(file, (uint8_t *)data + off, chunk) != (ssize_t)chunk) {
+            host_print("put: %s: write failed\n", path);
+            result = 1;
+            break;
+        }
+    }
+
+    vfs_close(file);
+    host_free(data);
+    return result;
+}
+
+static int cmd_df(void) {
+    vfs_mount_t *mount = vfs_get_mount(FAT32_HOST_MOUNT);
+    fat32_statfs_t st;
+    if (!mount || fat32_statfs((fat32_fs_t *)mount->fs_data, &st) != 0) {
+        return 1;
+    }
+
+    host_print("total %llu\nfree %llu\ncluster %u\n",
+               st.total_bytes, st.free_bytes, st.cluster_size);
+    return 0;
+}
+
+/**
+ * Run a command on a mounted image
+ */
+static int cmd_image(const char *cmd, int argc, char **argv) {
+    if (argc < 1) {
+        host_print("%s: missing image\n", cmd);
+        return 2;
+    }
+    if (!fat32_host_attach(argv[0], 0)) {
+        return 1;
+    }
+    if (fat32_host_mount() != VFS_OK) {
+        host_print("%s: %s: not a FAT32 image\n", cmd, argv[0]);
+        fat32_host_detach();
+        return 1;
+    }
+
+    int result = 2;
+    if (host_strcmp(cmd, "ls") == 0 && argc == 2) {
+        result = cmd_ls(argv[1]);
+    } else if (host_strcmp(cmd, "get") == 0 && argc == 3) {
+        result = cmd_get(argv[1], argv[2]);
+    } else if (host_strcmp(cmd, "put") == 0 && argc == 3) {
+        result = cmd_put(argv[1], argv[2]);
+    } else if (host_strcmp(cmd, "mkdir") == 0 && argc == 2) {
+        result = vfs_mkdir(argv[1], 0755) == VFS_OK ? 0 : 1;
+    } else if (host_strcmp(cmd, "rm") == 0 && argc == 2) {
+        result = vfs_unlink(argv[1]) == VFS_OK ? 0 : 1;
+    } else if (host_strcmp(cmd, "df") == 0 && argc == 1) {
+        result = cmd_df();
+    } else {
+        host_print("%s: wrong number of arguments\n", cmd);
+    }
+
+    if (fat32_host_unmount() != VFS_OK && result == 0) {
+        result = 1;
+    }
+    fat32_host_detach();
+    return result;
+}
+
+static int cmd_bench(int argc, char **argv) {
+    fat32_bench_params_t params = {
+        .files          = 1000,
+        .seq_bytes      = 16 * MB,
+        .io_size        = 64 * KB,
+        .random_ops     = 2000,
+        .random_size    = 4 * KB,
+        .depth          = 16,
+        .lookups        = 10000,
+    };
+    unsigned long long size = FAT32_HOST_DEFAULT_SIZE;
+    const char *path = FAT32_HOST_DEFAULT_IMAGE;
+
+    for (int i = 0; i < argc; i++) {
+        unsigned long long v;
+        if (argv[i][0] != '-') {
+            path = argv[i];
+            continue;
+        }
+        if (i + 1 >= argc || host_parse_size(argv[i + 1], &v) != 0 || v == 0) {
+            host_print("bench: bad value for %s\n", argv[i]);
+            return 2;
+        }
+
+        switch (argv[i][1]) {
+            case 'n': params.files = (uint32_t)v; break;
+            case 's': params.seq_bytes = v; break;
+            case 'b': params.io_size = (uint32_t)v; break;
+            case 'r': params.random_ops = (uint32_t)v; break;
+            case 'R': params.random_size = (uint32_t)v; break;
+            case 'd': params.depth = (uint32_t)v; break;
+            case 'l': params.lookups = (uint32_t)v; break;
+            case 'S': size = v; break;
+            default:
+                host_print("bench: unknown option %s\n", argv[i]);
+                return 2;
+        }
+        i++;
+    }
+
+    return fat32_host_run_bench(path, size, &params) == 0 ? 0 : 1;
+}
+
+static void usage(void) {
+    host_print("usage: fat32_host [-v] <command> ...\n"
+               "  test [image]                  run the test suite on a scratch image\n"
+               "  bench [options] [image]       run the benchmark on a scratch image\n"
+               "      -n files  -s seq-bytes  -b seq-io-size  -r random-ops\n"
+               "      -R random-io-size  -d depth  -l lookups  -S image-size\n"
+               "  mkfs <image> <size> [spc]     create and format an image\n"
+               "  ls <image> <path>             list a directory\n"
+               "  get <image> <path> <file>     copy a file out of an image\n"
+               "  put <image> <file> <path>     copy a file into an image\n"
+               "  mkdir <image> <path>          create a directory\n"
+               "  rm <image> <path>             delete a file\n"
+               "  df <image>                    show space usage\n");
+}
+
+int main(int argc, char **argv) {
+    int arg = 1;
+    if (arg < argc && host_strcmp(argv[arg], "-v") == 0) {
+        fat32_host_verbose = true;
+        arg++;
+    }
+    if (arg >= argc) {
+        usage();
+        return 2;
+    }
+
+    vfs_init();
+    fat32_init();
+    tmpfs_init();
+
+    const char *cmd = argv[arg++];
+    int nargs = argc - arg;
+    char **args = argv + arg;
+
+    if (host_strcmp(cmd, "test") == 0) {
+        return fat32_host_run_tests(nargs > 0 ? args[0] : FAT32_HOST_DEFAULT_IMAGE) == 0 ? 0 : 1;
+    }
+    if (host_strcmp(cmd, "bench") == 0) {
+        return cmd_bench(nargs, args);
+    }
+    if (host_strcmp(cmd, "mkfs") == 0) {
+        return cmd_mkfs(nargs, args);
+    }
+    if (host_strcmp(cmd, "ls") == 0 || host_strcmp(cmd, "get") == 0 ||
+        host_strcmp(cmd, "put") == 0 || host_strcmp(cmd, "mkdir") == 0 ||
+        host_strcmp(cmd, "rm") == 0 || host_strcmp(cmd, "df") == 0) {
+        return cmd_image(cmd, nargs, args);
+    }
+
+    usage();
+    return 2;
+}
@@ -0,0 +1,125 @@
+/**
+ * AAAos FAT32 Host Harness
+ *
+ * Runs the kernel's FAT32 driver, VFS and block layer (buffer cache,
+ * request queues, I/O scheduler) as an ordinary Linux process on top of a
+ * disk image file. The image is registered as block device "img0" and
+ * mounted at "/" exactly as the kernel mounts a disk, so everything from
+ * vfs_open() down to the sector requests is the code that ships.
+ *
+ * tmpfs is registered as well, so its tests run in the same suite on
+ * mounts beside the image.
+ *
+ * Every request reaching the image is counted; the test suite checks
+ * behaviour and the benchmark reports throughput together with block I/Os
+ * per operation, which is the number most filesystem changes move.
+ */
+
+#ifndef _AAAOS_TESTS_FAT32_HOST_H
+#define _AAAOS_TESTS_FAT32_HOST_H
+
+#include "../../kernel/include/types.h"
+#include "../../fs/vfs/vfs.h"
+#include "../../fs/fat32/fat32.h"
+#include "../../fs/tmpfs/tmpfs.h"
+#include "../../drivers/storage/blkdev.h"
+#include "host_io.h"
+
+#define FAT32_HOST_DEVICE       "img0"
+#define FAT32_HOST_MOUNT        "/"
+#define FAT32_HOST_DEFAULT_SIZE (64ULL * MB)
+
+/**
+ * Requests that reached the image file
+ */
+typedef struct {
+    uint64_t    reads;              /* Read requests */
+    uint64_t    writes;             /* Write requests */
+    uint64_t    sectors_read;
+    uint64_t    sectors_written;
+    uint64_t    flushes;
+} fat32_host_io_stats_t;
+
+/* Print kernel log messages ("[TAG] ..." lines) */
+extern bool fat32_host_verbose;
+
+/**
+ * Open an image file and register it as FAT32_HOST_DEVICE
+ * @param path Image file
+ * @param create_size If nonzero, create the image with this size in bytes
+ * @return Block device, or NULL on error
+ */
+block_device_t* fat32_host_attach(const char *path, uint64_t create_size);
+
+/**
+ * Write back cached blocks, unregister the device and close the image
+ */
+void fat32_host_detach(void);
+
+/**
+ * Mount the attached image at FAT32_HOST_MOUNT
+ * @return VFS_OK or a negative VFS error
+ */
+int fat32_host_mount(void);
+
+/**
+ * Sync and unmount the filesystem
+ * The buffer cache is written back and emptied, so the next mount starts
+ * cold and sees only what reached the image.
+ * @return VFS_OK or a negative VFS error
+ */
+int fat32_host_unmount(void);
+
+/**
+ * Write back the filesystem and the buffer cache without unmounting
+ * @param drop Also empty the buffer cache
+ */
+void fat32_host_sync(bool drop);
+
+/**
+ * Get or reset the image request counters
+ */
+void fat32_host_io_stats(fat32_host_io_stats_t *stats);
+void fat32_host_io_reset(void);
+
+/**
+ * Format the attached image as FAT32
+ * Follows the layout mkfs.fat produces: 32 reserved sectors with the
+ * FSInfo sector at 1 and a backup boot sector at 6, two FATs, and the
+ * root directory in cluster 2.
+ * @param sectors_per_cluster Cluster size in sectors, or 0 to pick one by
+ *        volume size as mkfs.fat does
+ * @return 0 on success, -1 on error
+ */
+int fat32_host_mkfs(uint32_t sectors_per_cluster);
+
+/**
+ * Run the test suite against a freshly formatted image
+ * @param path Scratch image file
+ * @return Number of failed tests
+ */
+int fat32_host_run_tests(const char *path);
+
+/**
+ * Benchmark parameters
+ */
+typedef struct {
+    uint32_t    files;              /* Files for the create/lookup/unlink phases */
+    uint64_t    seq_bytes;          /* File size for the sequential phases */
+    uint32_t    io_size;            /* Bytes per sequential request */
+    uint32_t    random_ops;         /* Requests per random phase */
+    uint32_t    random_size;        /* Bytes per random request */
+    uint32_t    depth;              /* Directory depth for deep lookups */
+    uint32_t    lookups;            /* Deep lookups performed */
+} fat32_bench_params_t;
+
+/**
+ * Run the benchmark against a freshly formatted image
+ * @param path Scratch image file
+ * @param size Image size in bytes
+ * @param params Benchmark parameters
+ * @return 0 on success, -1 if a phase failed
+ */
+int fat32_host_run_bench(const char *path, uint64_t size, const fat32_bench_params_t *params);
+
+#endif /* _AAAOS_TESTS_FAT32_HOST_H */
@@ -0,0 +1,192 @@
+/**
+ * AAAos FAT32 Host Harness - Host I/O
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "host_io.h"
+
+int host_open_image(const char *path, unsigned long long create_size) {
+    int flags = O_RDWR;
+    if (create_size) {
+        flags |= O_CREAT | O_TRUNC;
+    }
+
+    int fd = open(path, flags, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    if (create_size && ftruncate(fd, (off_t)create_size) != 0) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+unsigned long long host_image_size(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        return 0;
+    }
+    return (unsigned long long)st.st_size;
+}
+
+int host_pread(int fd, void *buf, unsigned long len, unsigned long long offset) {
+    char *p = buf;
+    while (len > 0) {
+        ssize_t n = pread(fd, p, len, (off_t)offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= (unsigned long)n;
+        offset += (unsigned long long)n;
+    }
+    return 0;
+}
+
+int host_pwrite(int fd, const void *buf, unsigned long len, unsigned long long offset) {
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t n = pwrite(fd, p, len, (off_t)offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= (unsigned long)n;
+        offset += (unsigned long long)n;
+    }
+    return 0;
+}
+
+int host_fsync(int fd) {
+    return fsync(fd) == 0 ? 0 : -1;
+}
+
+void host_close(int fd) {
+    close(fd);
+}
+
+void host_unlink(const char *path) {
+    unlink(path);
+}
+
+int host_read_file(const char *path, void **data, unsigned long *len) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    void *buf = malloc(size > 0 ? (size_t)size : 1);
+    if (!buf || (size > 0 && fread(buf, 1, (size_t)size, f) != (size_t)size)) {
+        free(buf);
+        fclose(f);
+        return -1;
+    }
+
+    fclose(f);
+    *data = buf;
+    *len = (unsigned long)size;
+    return 0;
+}
+
+int host_write_file(const char *path, const void *data, unsigned long len) {
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    int ok = fwrite(data, 1, len, f) == len;
+    return (fclose(f) == 0 && ok) ? 0 : -1;
+}
+
+void* host_alloc_pages(unsigned long count) {
+    void *ptr = NULL;
+    if (posix_memalign(&ptr, 4096, count * 4096) != 0) {
+        return NULL;
+    }
+    return ptr;
+}
+
+void* host_alloc(unsigned long size) {
+    return malloc(size);
+}
+
+void host_free(void *ptr) {
+    free(ptr);
+}
+
+unsigned long long host_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+void host_print(const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    vprintf(fmt, ap);
+    va_end(ap);
+}
+
+void host_vprint(const char *fmt, __builtin_va_list ap) {
+    vprintf(fmt, ap);
+}
+
+int host_snprintf(char *buf, unsigned long size, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, size, fmt, ap);
+    va_end(ap);
+    return n;
+}
+
+int host_parse_size(const char *s, unsigned long long *out) {
+    char *end;
+    errno = 0;
+    unsigned long long v = strtoull(s, &end, 10);
+    if (errno || end == s) {
+        return -1;
+    }
+
+    switch (*end) {
+        case 'k': case 'K': v <<= 10; end++; break;
+        case 'm': case 'M': v <<= 20; end++; break;
+        case 'g': case 'G': v <<= 30; end++; break;
+        default: break;
+    }
+    if (*end) {
+        return -1;
+    }
+
+    *out = v;
+    return 0;
+}
+
+int host_strcmp(const char *a, const char *b) {
+    return strcmp(a, b);
+}
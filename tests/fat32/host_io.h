@@ -0,0 +1,94 @@
+/**
+ * AAAos FAT32 Host Harness - Host I/O
+ *
+ * The only part of the harness built against the host C library. The
+ * filesystem code and the harness around it use the kernel's types.h,
+ * which clashes with <stdint.h>, so this interface sticks to plain C
+ * types.
+ */
+
+#ifndef _AAAOS_TESTS_HOST_IO_H
+#define _AAAOS_TESTS_HOST_IO_H
+
+/**
+ * Open a disk image
+ * @param path Image file
+ * @param create_size If nonzero, create or truncate the file to this many bytes
+ * @return File descriptor, or -1 on error
+ */
+int host_open_image(const char *path, unsigned long long create_size);
+
+/**
+ * Get the size of an open image in bytes
+ */
+unsigned long long host_image_size(int fd);
+
+/**
+ * Read or write a whole range of an image
+ * @return 0 on success, -1 on error or short transfer
+ */
+int host_pread(int fd, void *buf, unsigned long len, unsigned long long offset);
+int host_pwrite(int fd, const void *buf, unsigned long len, unsigned long long offset);
+
+/**
+ * Flush an image to stable storage
+ */
+int host_fsync(int fd);
+
+void host_close(int fd);
+
+/**
+ * Remove a file (temporary images)
+ */
+void host_unlink(const char *path);
+
+/**
+ * Read a host file into a new buffer (free with host_free)
+ * @return 0 on success, -1 on error
+ */
+int host_read_file(const char *path, void **data, unsigned long *len);
+
+/**
+ * Write a buffer to a host file, replacing it
+ * @return 0 on success, -1 on error
+ */
+int host_write_file(const char *path, const void *data, unsigned long len);
+
+/**
+ * Allocate page-aligned memory (not zeroed)
+ */
+void* host_alloc_pages(unsigned long count);
+
+void* host_alloc(unsigned long size);
+void host_free(void *ptr);
+
+/**
+ * Monotonic clock in nanoseconds
+ */
+unsigned long long host_now_ns(void);
+
+/**
+ * Formatted output to stdout; the kernel's %llu/%u/%x/%s/%p all map
+ * directly onto printf
+ */
+void host_print(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+void host_vprint(const char *fmt, __builtin_va_list ap);
+
+/**
+ * Formatted output to a buffer (snprintf)
+ */
+int host_snprintf(char *buf, unsigned long size, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+/**
+ * Parse an unsigned decimal number, with an optional K/M/G suffix
+ * @return 0 on success, -1 if the string is not a number
+ */
+int host_parse_size(const char *s, unsigned long long *out);
+
+/**
+ * Compare two strings
+ */
+int host_strcmp(const char *a, const char *b);
+
+#endif /* _AAAOS_TESTS_HOST_IO_H */
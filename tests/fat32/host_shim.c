@@ -0,0 +1,131 @@
+/**
+ * AAAos FAT32 Host Harness - Kernel Shims
+ *
+ * Stand-ins for the kernel services the filesystem and block layers link
+ * against. Physical pages come from the host heap and are handed out as
+ * "physical" addresses relative to VMM_KERNEL_PHYS_MAP, so the callers'
+ * phys + VMM_KERNEL_PHYS_MAP arithmetic lands back on the host pointer.
+ * There is no scheduler: background threads are never started and every
+ * wait falls back to polling, which the layers already support for early
+ * boot.
+ */
+
+#include "fat32_host.h"
+#include "../../kernel/mm/pmm.h"
+#include "../../kernel/mm/vmm.h"
+#include "../../kernel/mm/heap.h"
+#include "../../kernel/arch/x86_64/include/idt.h"
+#include "../../kernel/proc/process.h"
+#include "../../kernel/sched/scheduler.h"
+#include "../../drivers/timer/pit.h"
+
+bool fat32_host_verbose = false;
+
+/* ============================================================================
+ * Console
+ * ============================================================================ */
+
+/**
+ * Check whether a message is test framework output
+ */
+static bool shim_is_test_output(const char *fmt) {
+    static const char *tags[] = { "[PASS]", "[FAIL]", "[SKIP]", "[TEST]" };
+
+    if (fmt[0] != '[') {
+        return true;
+    }
+    for (size_t i = 0; i < sizeof(tags) / sizeof(tags[0]); i++) {
+        if (__builtin_strncmp(fmt, tags[i], 6) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Kernel log lines ("[TAG] ...") are shown only in verbose mode; the test
+ * framework reports through kprintf as well and is always shown.
+ */
+void serial_printf(uint16_t port, const char *fmt, ...) {
+    UNUSED(port);
+    if (!fat32_host_verbose && !shim_is_test_output(fmt)) {
+        return;
+    }
+
+    __builtin_va_list ap;
+    __builtin_va_start(ap, fmt);
+    host_vprint(fmt, ap);
+    __builtin_va_end(ap);
+}
+
+/* ============================================================================
+ * Memory
+ * ============================================================================ */
+
+physaddr_t pmm_alloc_pages(size_t count) {
+    void *ptr = host_alloc_pages(count);
+    if (!ptr) {
+        return 0;
+    }
+    return (physaddr_t)(uintptr_t)ptr - VMM_KERNEL_PHYS_MAP;
+}
+
+void pmm_free_pages(physaddr_t addr, size_t count) {
+    UNUSED(count);
+    if (addr) {
+        host_free((void *)(uintptr_t)(addr + VMM_KERNEL_PHYS_MAP));
+    }
+}
+
+void *kmalloc(size_t size) {
+    return host_alloc(size);
+}
+
+void kfree(void *ptr) {
+    host_free(ptr);
+}
+
+/* ============================================================================
+ * Processes and Scheduling
+ * ============================================================================ */
+
+process_t* process_create(const char *name, process_entry_t entry) {
+    UNUSED(name);
+    UNUSED(entry);
+    return NULL;
+}
+
+/* Only threads that were never started call this */
+void process_exit(int status) {
+    UNUSED(status);
+    __builtin_trap();
+}
+
+process_t* process_get_current(void) {
+    return NULL;
+}
+
+void process_set_state(process_t *proc, process_state_t state) {
+    UNUSED(proc);
+    UNUSED(state);
+}
+
+bool scheduler_add(process_t *proc) {
+    UNUSED(proc);
+    return false;
+}
+
+bool scheduler_is_running(void) {
+    return false;
+}
+
+void scheduler_yield(void) {
+}
+
+/* ============================================================================
+ * Time
+ * ============================================================================ */
+
+uint64_t pit_get_uptime_ms(void) {
+    return host_now_ns() / 1000000;
+}
@@ -0,0 +1,128 @@
+#!/bin/sh
+# AAAos FAT32 host harness - reference image checks
+#
+# Cross-checks the driver against dosfstools and mtools:
+#   1. files put on a mkfs.fat image by mtools read back identically
+#      through the driver, long names included
+#   2. files the driver writes to that image pass fsck.fat and read back
+#      identically through mtools
+#   3. an image formatted by the harness passes fsck.fat and works with
+#      mtools
+# The checks are skipped when the tools are not installed.
+#
+# Usage: reference.sh [path/to/fat32_host]
+
+set -u
+
+HOST=${1:-build/fat32_host}
+
+for tool in mkfs.fat fsck.fat mcopy mmd mdir; do
+    if ! command -v "$tool" >/dev/null 2>&1; then
+        echo "[SKIP] reference images: $tool not found (install dosfstools and mtools)"
+        exit 0
+    fi
+done
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT INT TERM
+
+FAILED=0
+SIZES="0 1 511 512 4097 65536 1048579"
+
+check() {
+    desc=$1
+    shift
+    if "$@" >"$WORK/log" 2>&1; then
+        echo "[PASS] $desc"
+    else
+        echo "[FAIL] $desc"
+        sed 's/^/    /' "$WORK/log"
+        FAILED=1
+    fi
+}
+
+# Compare a file in an image, read through the driver, with a host file
+driver_reads() {
+    "$HOST" get "$1" "$2" "$WORK/out" && cmp "$3" "$WORK/out"
+}
+
+# Compare a file in an image, read through mtools, with a host file
+mtools_reads() {
+    rm -f "$WORK/out"
+    mcopy -n -i "$1" "::$2" "$WORK/out" && cmp "$3" "$WORK/out"
+}
+
+# Directory listing through the driver: names only, lower case, sorted
+driver_names() {
+    "$HOST" ls "$1" "$2" | sed 's/ [0-9]*$//; s|/$||' | tr 'A-Z' 'a-z' | sort
+}
+
+for n in $SIZES; do
+    head -c "$n" /dev/urandom >"$WORK/data$n"
+done
+
+# --- 1. mkfs.fat + mtools image, read by the driver ---------------------------
+
+REF="$WORK/ref.img"
+check "mkfs.fat creates the reference image" mkfs.fat -F 32 -C "$REF" 65536
+mmd -i "$REF" ::/dir ::/dir/sub
+
+: >"$WORK/expected"
+for n in $SIZES; do
+    mcopy -i "$REF" "$WORK/data$n" "::/dir/sub/F$n.BIN"
+    mcopy -i "$REF" "$WORK/data$n" "::/dir/sub/long_file_name_$n.data"
+    echo "f$n.bin" >>"$WORK/expected"
+    echo "long_file_name_$n.data" >>"$WORK/expected"
+done
+sort -o "$WORK/expected" "$WORK/expected"
+
+for n in $SIZES; do
+    check "driver reads $n-byte file written by mtools" \
+        driver_reads "$REF" "/dir/sub/F$n.BIN" "$WORK/data$n"
+    check "driver reads $n-byte long-named file written by mtools" \
+        driver_reads "$REF" "/dir/sub/long_file_name_$n.data" "$WORK/data$n"
+done
+
+driver_names "$REF" /dir/sub >"$WORK/listed"
+check "driver lists the directory written by mtools" cmp "$WORK/expected" "$WORK/listed"
+
+# --- 2. driver writes to the reference image ----------------------------------
+
+check "driver creates a directory" "$HOST" mkdir "$REF" /new
+for n in $SIZES; do
+    check "driver writes $n-byte file" "$HOST" put "$REF" "$WORK/data$n" "/new/W$n.BIN"
+done
+check "fsck.fat accepts the image after driver writes" fsck.fat -n "$REF"
+for n in $SIZES; do
+    check "mtools reads $n-byte file written by the driver" \
+        mtools_reads "$REF" "/new/W$n.BIN" "$WORK/data$n"
+done
+
+check "driver deletes a file" "$HOST" rm "$REF" /new/W65536.BIN
+check "fsck.fat accepts the image after a delete" fsck.fat -n "$REF"
+check "mtools no longer sees the deleted file" \
+    sh -c "! mdir -b -i '$REF' ::/new | grep -qi 'W65536.BIN'"
+
+# --- 3. image formatted by the harness -----------------------------------------
+
+OWN="$WORK/own.img"
+check "harness formats an image" "$HOST" mkfs "$OWN" 64M
+check "fsck.fat accepts the harness-formatted image" fsck.fat -n "$OWN"
+check "mtools creates a directory on the harness-formatted image" mmd -i "$OWN" ::/m
+for n in $SIZES; do
+    "$HOST" put "$OWN" "$WORK/data$n" "/D$n.BIN" >/dev/null
+    mcopy -i "$OWN" "$WORK/data$n" "::/m/M$n.BIN"
+done
+check "fsck.fat accepts the harness-formatted image after writes" fsck.fat -n "$OWN"
+for n in $SIZES; do
+    check "mtools reads $n-byte file on the harness-formatted image" \
+        mtools_reads "$OWN" "/D$n.BIN" "$WORK/data$n"
+    check "driver reads $n-byte file mtools wrote to the harness-formatted image" \
+        driver_reads "$OWN" "/m/M$n.BIN" "$WORK/data$n"
+done
+
+if [ "$FAILED" -ne 0 ]; then
+    echo "Reference image checks failed."
+    exit 1
+fi
+echo "Reference image checks passed."
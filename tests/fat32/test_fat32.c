@@ -0,0 +1,740 @@
+/**
+ * AAAos FAT32 Host Harness - Tests
+ *
+ * Filesystem tests run through the VFS on a scratch image formatted like
+ * mkfs.fat formats one. Besides checking data read back through the
+ * driver, the on-disk structures are re-read raw after unmounting: both
+ * FAT copies must match and the FSInfo free count must agree with the FAT.
+ */
+
+#include "fat32_host.h"
+#include "../framework/test.h"
+
+#define TEST_IMAGE_SIZE     (64ULL * MB)
+#define TEST_BUFFER_SIZE    (4 * MB)
+
+static uint8_t test_wbuf[TEST_BUFFER_SIZE];
+static uint8_t test_rbuf[TEST_BUFFER_SIZE];
+
+/* ============================================================================
+ * Helpers
+ * ============================================================================ */
+
+/**
+ * Fill a buffer with a reproducible pattern
+ */
+static void test_pattern(uint8_t *buf, size_t len, uint32_t seed) {
+    uint32_t x = seed * 2654435761u + 1;
+    for (size_t i = 0; i < len; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        buf[i] = (uint8_t)x;
+    }
+}
+
+static char test_tolower(char c) {
+    return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+}
+
+/**
+ * Compare names case-insensitively (the driver stores 8.3 names in upper case)
+ */
+static bool test_name_eq(const char *a, const char *b) {
+    while (*a && test_tolower(*a) == test_tolower(*b)) {
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+/**
+ * Write a whole file in chunks of the given size
+ */
+static int test_write_file(const char *path, const uint8_t *data, size_t len, size_t chunk) {
+    vfs_file_t *file = vfs_open(path, VFS_O_WRONLY | VFS_O_CREAT | VFS_O_TRUNC);
+    if (!file) {
+        return -1;
+    }
+
+    int result = 0;
+    for (size_t off = 0; off < len; off += chunk) {
+        size_t n = MIN(chunk, len - off);
+        if (vfs_write(file, data + off, n) != (ssize_t)n) {
+            result = -1;
+            break;
+        }
+    }
+
+    vfs_close(file);
+    return result;
+}
+
+/**
+ * Read a whole file
+ * @return Bytes read, or -1 on error
+ */
+static ssize_t test_read_file(const char *path, uint8_t *buf, size_t max) {
+    vfs_file_t *file = vfs_open(path, VFS_O_RDONLY);
+    if (!file) {
+        return -1;
+    }
+
+    ssize_t n = vfs_read(file, buf, max);
+    vfs_close(file);
+    return n;
+}
+
+/**
+ * Count directory entries, not counting "." and ".."
+ */
+static int test_count_entries(const char *path) {
+    vfs_dir_t *dir = vfs_opendir(path);
+    if (!dir) {
+        return -1;
+    }
+
+    int count = 0;
+    vfs_dirent_t *ent;
+    while ((ent = vfs_readdir(dir)) != NULL) {
+        if (!test_name_eq(ent->d_name, ".") && !test_name_eq(ent->d_name, "..")) {
+            count++;
+        }
+    }
+
+    vfs_closedir(dir);
+    return count;
+}
+
+static bool test_dir_contains(const char *path, const char *name) {
+    vfs_dir_t *dir = vfs_opendir(path);
+    if (!dir) {
+        return false;
+    }
+
+    bool found = false;
+    vfs_dirent_t *ent;
+    while (!found && (ent = vfs_readdir(dir)) != NULL) {
+        found = test_name_eq(ent->d_name, name);
+    }
+
+    vfs_closedir(dir);
+    return found;
+}
+
+/**
+ * Split a buffer into I/O vector segments of the given sizes
+ * @return Total length of the segments
+ */
+static size_t test_iov_split(vfs_iovec_t *iov, uint8_t *buf, const size_t *sizes, int count) {
+    size_t off = 0;
+    for (int i = 0; i < count; i++) {
+        iov[i].iov_base = buf + off;
+        iov[i].iov_len = sizes[i];
+        off += sizes[i];
+    }
+    return off;
+}
+
+static fat32_fs_t* test_fs(void) {
+    vfs_mount_t *mount = vfs_get_mount(FAT32_HOST_MOUNT);
+    return mount ? (fat32_fs_t *)mount->fs_data : NULL;
+}
+
+static uint64_t test_free_bytes(void) {
+    fat32_statfs_t st;
+    if (fat32_statfs(test_fs(), &st) != 0) {
+        return 0;
+    }
+    return st.free_bytes;
+}
+
+static uint32_t test_cluster_size(void) {
+    fat32_statfs_t st;
+    if (fat32_statfs(test_fs(), &st) != 0) {
+        return 0;
+    }
+    return st.cluster_size;
+}
+
+/**
+ * Check the on-disk FATs and FSInfo of the unmounted image
+ * @return NULL if consistent, otherwise what is wrong
+ */
+static const char* test_check_image(void) {
+    block_device_t *dev = blkdev_find(FAT32_HOST_DEVICE);
+    fat32_bpb_t bpb;
+    fat32_fsinfo_t fsinfo;
+    static uint8_t fat_a[BLKDEV_SECTOR_SIZE];
+    static uint8_t fat_b[BLKDEV_SECTOR_SIZE];
+
+    if (!dev || blkdev_read(dev, 0, 1, &bpb) != 0 ||
+        blkdev_read(dev, bpb.fs_info_sector, 1, &fsinfo) != 0) {
+        return "cannot read boot sector";
+    }
+
+    uint32_t data_start = bpb.reserved_sectors + bpb.num_fats * bpb.fat_size_32;
+    uint32_t clusters = (bpb.total_sectors_32 - data_start) / bpb.sectors_per_cluster;
+    uint32_t free_count = 0;
+    uint32_t cluster = 0;
+
+    for (uint32_t s = 0; s < bpb.fat_size_32; s++) {
+        if (blkdev_read(dev, bpb.reserved_sectors + s, 1, fat_a) != 0) {
+            return "cannot read FAT";
+        }
+        for (uint32_t f = 1; f < bpb.num_fats; f++) {
+            if (blkdev_read(dev, bpb.reserved_sectors + f * bpb.fat_size_32 + s, 1, fat_b) != 0) {
+                return "cannot read FAT copy";
+            }
+            if (test_memcmp(fat_a, fat_b, BLKDEV_SECTOR_SIZE) != 0) {
+                return "FAT copies differ";
+            }
+        }
+
+        uint32_t *entries = (uint32_t *)fat_a;
+        for (uint32_t i = 0; i < BLKDEV_SECTOR_SIZE / sizeof(uint32_t); i++, cluster++) {
+            if (cluster >= FAT32_FIRST_DATA_CLUSTER &&
+                cluster < FAT32_FIRST_DATA_CLUSTER + clusters &&
+                (entries[i] & FAT32_CLUSTER_MASK) == FAT32_CLUSTER_FREE) {
+                free_count++;
+            }
+        }
+    }
+
+    if (fsinfo.lead_sig != FAT32_FSINFO_LEAD_SIG || fsinfo.trail_sig != FAT32_FSINFO_TRAIL_SIG) {
+        return "FSInfo signature damaged";
+    }
+    if (fsinfo.free_count != 0xFFFFFFFF && fsinfo.free_count != free_count) {
+        return "FSInfo free count does not match the FAT";
+    }
+    return NULL;
+}
+
+/* ============================================================================
+ * Tests
+ * ============================================================================ */
+
+/**
+ * Test: a fresh volume is empty with all but the root cluster free
+ */
+TEST_CASE(test_fat32_empty_volume) {
+    fat32_statfs_t st;
+    TEST_ASSERT_EQ(fat32_statfs(test_fs(), &st), 0);
+    TEST_ASSERT_EQ(st.free_bytes, st.total_bytes - st.cluster_size);
+    TEST_ASSERT_EQ(test_count_entries("/"), 0);
+
+    TEST_PASS();
+}
+
+/**
+ * Test: create, write and read back a small file
+ */
+TEST_CASE(test_fat32_write_read) {
+    test_pattern(test_wbuf, 10000, 1);
+    TEST_ASSERT_EQ(test_write_file("/hello.txt", test_wbuf, 10000, 10000), 0);
+
+    vfs_stat_t st;
+    TEST_ASSERT_EQ(vfs_stat("/hello.txt", &st), VFS_OK);
+    TEST_ASSERT_EQ(st.st_size, 10000);
+    TEST_ASSERT(vfs_is_file("/hello.txt"));
+
+    TEST_ASSERT_EQ(test_read_file("/hello.txt", test_rbuf, TEST_BUFFER_SIZE), 10000);
+    TEST_ASSERT_MEM_EQ(test_rbuf, test_wbuf, 10000);
+
+    TEST_PASS();
+}
+
+/**
+ * Test: a multi-megabyte file written in odd-sized chunks
+ */
+TEST_CASE(test_fat32_large_file) {
+    size_t len = 3 * MB + 777;
+    test_pattern(test_wbuf, len, 2);
+    TEST_ASSERT_EQ(test_write_file("/large.bin", test_wbuf, len, 12345), 0);
+
+    TEST_ASSERT_EQ(test_read_file("/large.bin", test_rbuf, TEST_BUFFER_SIZE), (ssize_t)len);
+    TEST_ASSERT_MEM_EQ(test_rbuf, test_wbuf, len);
+
+    /* Unaligned positioned reads across cluster boundaries */
+    vfs_file_t *file = vfs_open("/large.bin", VFS_O_RDONLY);
+    TEST_ASSERT_NOT_NULL(file);
+    for (uint64_t off = 1; off < len; off += 300007) {
+        size_t n = MIN((size_t)5000, len - off);
+        ssize_t got = vfs_pread(file, test_rbuf, n, off);
+        if (got != (ssize_t)n || test_memcmp(test_rbuf, test_wbuf + off, n) != 0) {
+            vfs_close(file);
+            TEST_FAIL("positioned read mismatch");
+        }
+    }
+    vfs_close(file);
+
+    TEST_PASS();
+}
+
+/**
+ * Test: overwrite the middle of a file and append to it
+ */
+TEST_CASE(test_fat32_overwrite_append) {
+    size_t len = 100000;
+    test_pattern(test_wbuf, len, 3);
+    TEST_ASSERT_EQ(test_write_file("/edit.bin", test_wbuf, len, 4096), 0);
+
+    vfs_file_t *file = vfs_open("/edit.bin", VFS_O_RDWR);
+    TEST_ASSERT_NOT_NULL(file);
+    test_pattern(test_wbuf + 40000, 9000, 4);
+    TEST_ASSERT_EQ(vfs_pwrite(file, test_wbuf + 40000, 9000, 40000), 9000);
+    vfs_close(file);
+
+    file = vfs_open("/edit.bin", VFS_O_WRONLY | VFS_O_APPEND);
+    TEST_ASSERT_NOT_NULL(file);
+    test_pattern(test_wbuf + len, 5000, 5);
+    TEST_ASSERT_EQ(vfs_write(file, test_wbuf + len, 5000), 5000);
+    vfs_close(file);
+
+    TEST_ASSERT_EQ(test_read_file("/edit.bin", test_rbuf, TEST_BUFFER_SIZE), (ssize_t)(len + 5000));
+    TEST_ASSERT_MEM_EQ(test_rbuf, test_wbuf, len + 5000);
+
+    TEST_PASS();
+}
+
+/**
+ * Test: gathered writes and scattered reads with segments that straddle
+ * each other and cluster boundaries, appending and in place
+ */
+TEST_CASE(test_fat32_vectored_io) {
+    static const size_t wsizes[] = { 7, 4096, 1, 0, 33333, 600, 70000, 511, 513 };
+    static const size_t rsizes[] = { 1000, 1, 65536, 3, 0, 41521 };
+    static const size_t psizes[] = { 1, 511, 1024, 2, 4093 };
+    vfs_iovec_t iov[16];
+
+    size_t len = test_iov_split(iov, test_wbuf, wsizes, 9);
+    test_pattern(test_wbuf, len, 14);
+
+    vfs_file_t *file = vfs_open("/vec.bin", VFS_O_RDWR | VFS_O_CREAT | VFS_O_TRUNC);
+    TEST_ASSERT_NOT_NULL(file);
+    TEST_ASSERT_EQ(vfs_writev(file, iov, 9), (ssize_t)len);
+    TEST_ASSERT_EQ(vfs_seek(file, 0, VFS_SEEK_CUR), (int64_t)len);
+
+    /* Read back in a different segmentation, advancing the position */
+    size_t rlen = test_iov_split(iov, test_rbuf, rsizes, 6);
+    TEST_ASSERT_EQ(rlen, len - 1000);
+    TEST_ASSERT_EQ(vfs_seek(file, 0, VFS_SEEK_SET), 0);
+    TEST_ASSERT_EQ(vfs_readv(file, iov, 6), (ssize_t)rlen);
+    TEST_ASSERT_MEM_EQ(test_rbuf, test_wbuf, rlen);
+    TEST_ASSERT_EQ(vfs_seek(file, 0, VFS_SEEK_CUR), (int64_t)rlen);
+
+    /* Overwrite across cluster boundaries, leaving the position alone */
+    size_t plen = test_iov_split(iov, test_wbuf + 20000, psizes, 5);
+    test_pattern(test_wbuf + 20000, plen, 15);
+    TEST_ASSERT_EQ(vfs_pwritev(file, iov, 5, 20000), (ssize_t)plen);
+    TEST_ASSERT_EQ(vfs_seek(file, 0, VFS_SEEK_CUR), (int64_t)rlen);
+    vfs_close(file);
+
+    TEST_ASSERT_EQ(test_read_file("/vec.bin", test_rbuf, TEST_BUFFER_SIZE), (ssize_t)len);
+    TEST_ASSERT_MEM_EQ(test_rbuf, test_wbuf, len);
+
+    TEST_PASS();
+}
+
+/**
+ * Test: a vectored read reaching past EOF returns the bytes up to it
+ * and leaves later segments untouched
+ */
+TEST_CASE(test_fat32_vectored_eof) {
+    static const size_t sizes[] = { 60, 60, 60 };
+    vfs_iovec_t iov[3];
+
+    test_pattern(test_wbuf, 5000, 16);
+    TEST_ASSERT_EQ(test_write_file("/veof.bin", test_wbuf, 5000, 5000), 0);
+
+    vfs_file_t *file = vfs_open("/veof.bin", VFS_O_RDONLY);
+    TEST_ASSERT_NOT_NULL(file);
+
+    for (int i = 0; i < 180; i++) {
+        test_rbuf[i] = 0xAA;
+    }
+    test_iov_split(iov, test_rbuf, sizes, 3);
+    TEST_ASSERT_EQ(vfs_preadv(file, iov, 3, 4900), 100);
+    TEST_ASSERT_MEM_EQ(test_rbuf, test_wbuf + 4900, 100);
+    TEST_ASSERT_EQ(test_rbuf[100], 0xAA);
+    TEST_ASSERT_EQ(test_rbuf[179], 0xAA);
+
+    TEST_ASSERT_EQ(vfs_preadv(file, iov, 3, 5000), 0);
+    TEST_ASSERT_EQ(vfs_seek(file, 4990, VFS_SEEK_SET), 4990);
+    TEST_ASSERT_EQ(vfs_readv(file, iov, 3), 10);
+    TEST_ASSERT_EQ(vfs_readv(file, iov, 3), 0);
+    vfs_close(file);
+
+    TEST_PASS();
+}
+
+/**
+ * Test: vectors with more than VFS_IOV_MAX segments are rejected whole
+ */
+TEST_CASE(test_fat32_vectored_limit) {
+    static vfs_iovec_t iov[VFS_IOV_MAX + 1];
+
+    test_pattern(test_wbuf, VFS_IOV_MAX + 1, 17);
+    for (int i = 0; i <= VFS_IOV_MAX; i++) {
+        iov[i].iov_base = test_wbuf + i;
+        iov[i].iov_len = 1;
+    }
+
+    vfs_file_t *file = vfs_open("/vmax.bin", VFS_O_RDWR | VFS_O_CREAT | VFS_O_TRUNC);
+    TEST_ASSERT_NOT_NULL(file);
+    TEST_ASSERT_EQ(vfs_writev(file, iov, VFS_IOV_MAX + 1), VFS_ERR_INVAL);
+    TEST_ASSERT_EQ(vfs_seek(file, 0, VFS_SEEK_END), 0);
+    TEST_ASSERT_EQ(vfs_writev(file, iov, VFS_IOV_MAX), VFS_IOV_MAX);
+
+    for (int i = 0; i <= VFS_IOV_MAX; i++) {
+        iov[i].iov_base = test_rbuf + i;
+    }
+    TEST_ASSERT_EQ(vfs_preadv(file, iov, VFS_IOV_MAX + 1, 0), VFS_ERR_INVAL);
+    TEST_ASSERT_EQ(vfs_preadv(file, iov, VFS_IOV_MAX, 0), VFS_IOV_MAX);
+    TEST_ASSERT_MEM_EQ(test_rbuf, test_wbuf, VFS_IOV_MAX);
+    TEST_ASSERT_EQ(vfs_preadv(file, iov, 0, 0), VFS_ERR_INVAL);
+    vfs_close(file);
+
+    TEST_PASS();
+}
+
+/**
+ * Test: without readv/writev operations the VFS falls back to one read
+ * or write per segment, with the same results
+ */
+TEST_CASE(test_fat32_vectored_fallback) {
+    static const size_t sizes[] = { 3, 1500, 0, 20000, 77 };
+    vfs_iovec_t iov[5];
+    vfs_mount_t *mount = vfs_get_mount(FAT32_HOST_MOUNT);
+    TEST_ASSERT_NOT_NULL(mount);
+
+    vfs_ops_t *ops = mount->ops;
+    vfs_ops_t plain = *ops;
+    plain.readv = NULL;
+    plain.writev = NULL;
+    mount->ops = &plain;
+
+    size_t len = test_iov_split(iov, test_wbuf, sizes, 5);
+    test_pattern(test_wbuf, len, 18);
+
+    vfs_file_t *file = vfs_open("/vplain.bin", VFS_O_RDWR | VFS_O_CREAT | VFS_O_TRUNC);
+    ssize_t written = file ? vfs_writev(file, iov, 5) : -1;
+    ssize_t overwritten = file ? vfs_pwritev(file, iov, 5, 1000) : -1;
+
+    test_iov_split(iov, test_rbuf, sizes, 5);
+    ssize_t read = file ? vfs_preadv(file, iov, 5, 0) : -1;
+    ssize_t tail = file ? vfs_preadv(file, iov, 5, 1000 + len - 50) : -1;
+    if (file) {
+        vfs_close(file);
+    }
+    mount->ops = ops;
+
+    TEST_ASSERT_EQ(written, (ssize_t)len);
+    TEST_ASSERT_EQ(overwritten, (ssize_t)len);
+    TEST_ASSERT_EQ(read, (ssize_t)len);
+    TEST_ASSERT_EQ(tail, 50);
+    TEST_ASSERT_MEM_EQ(test_rbuf, test_wbuf + len - 50, 50);
+
+    /* Bytes 0..999 from the first write, the rest from the second */
+    TEST_ASSERT_EQ(test_read_file("/vplain.bin", test_rbuf, TEST_BUFFER_SIZE),
+                   (ssize_t)(1000 + len));
+    TEST_ASSERT_MEM_EQ(test_rbuf, test_wbuf, 1000);
+    TEST_ASSERT_MEM_EQ(test_rbuf + 1000, test_wbuf, len);
+
+    TEST_PASS();
+}
+
+/**
+ * Test: reopening with O_TRUNC empties a file and frees its clusters
+ */
+TEST_CASE(test_fat32_truncate_on_open) {
+    test_pattern(test_wbuf, 200000, 6);
+    TEST_ASSERT_EQ(test_write_file("/trunc.bin", test_wbuf, 200000, 65536), 0);
+    fat32_host_sync(false);
+    uint64_t free_before = test_free_bytes();
+
+    vfs_file_t *file = vfs_open("/trunc.bin", VFS_O_WRONLY | VFS_O_TRUNC);
+    TEST_ASSERT_NOT_NULL(file);
+    vfs_close(file);
+    fat32_host_sync(false);
+
+    vfs_stat_t st;
+    TEST_ASSERT_EQ(vfs_stat("/trunc.bin", &st), VFS_OK);
+    TEST_ASSERT_EQ(st.st_size, 0);
+    TEST_ASSERT_GT(test_free_bytes(), free_before);
+
+    TEST_PASS();
+}
+
+/**
+ * Test: nested directories and lookups through them
+ */
+TEST_CASE(test_fat32_nested_dirs) {
+    TEST_ASSERT_EQ(vfs_mkdir("/a", 0755), VFS_OK);
+    TEST_ASSERT_EQ(vfs_mkdir("/a/b", 0755), VFS_OK);
+    TEST_ASSERT_EQ(vfs_mkdir("/a/b/c", 0755), VFS_OK);
+    TEST_ASSERT_EQ(vfs_mkdir("/a/b/c/d", 0755), VFS_OK);
+    TEST_ASSERT(vfs_is_directory("/a/b/c/d"));
+    TEST_ASSERT_NE(vfs_mkdir("/a/b", 0755), VFS_OK);
+
+    test_pattern(test_wbuf, 1000, 7);
+    TEST_ASSERT_EQ(test_write_file("/a/b/c/d/deep.txt", test_wbuf, 1000, 1000), 0);
+    TEST_ASSERT_EQ(test_read_file("/a/b/c/d/deep.txt", test_rbuf, TEST_BUFFER_SIZE), 1000);
+    TEST_ASSERT_MEM_EQ(test_rbuf, test_wbuf, 1000);
+
+    TEST_ASSERT_EQ(test_count_entries("/a/b/c/d"), 1);
+    TEST_ASSERT(test_dir_contains("/a/b/c/d", "deep.txt"));
+    TEST_ASSERT(!vfs_exists("/a/b/x/d/deep.txt"));
+
+    TEST_PASS();
+}
+
+/**
+ * Test: a directory spanning many clusters lists every entry
+ */
+TEST_CASE(test_fat32_large_dir) {
+    char path[64];
+
+    TEST_ASSERT_EQ(vfs_mkdir("/many", 0755), VFS_OK);
+    for (int i = 0; i < 300; i++) {
+        host_snprintf(path, sizeof(path), "/many/f%05d.dat", i);
+        TEST_ASSERT_EQ(vfs_create(path, 0644), VFS_OK);
+    }
+
+    TEST_ASSERT_EQ(test_count_entries("/many"), 300);
+    TEST_ASSERT(test_dir_contains("/many", "f00000.dat"));
+    TEST_ASSERT(test_dir_contains("/many", "f00299.dat"));
+    TEST_ASSERT(vfs_exists("/many/f00150.dat"));
+
+    TEST_PASS();
+}
+
+/**
+ * Test: unlinking removes the entry and returns the space
+ */
+TEST_CASE(test_fat32_unlink) {
+    fat32_host_sync(false);
+    uint64_t free_before = test_free_bytes();
+
+    test_pattern(test_wbuf, 50000, 8);
+    TEST_ASSERT_EQ(test_write_file("/gone.bin", test_wbuf, 50000, 50000), 0);
+    fat32_host_sync(false);
+    TEST_ASSERT_LT(test_free_bytes(), free_before);
+
+    TEST_ASSERT_EQ(vfs_unlink("/gone.bin"), VFS_OK);
+    fat32_host_sync(false);
+    TEST_ASSERT(!vfs_exists("/gone.bin"));
+    TEST_ASSERT(!test_dir_contains("/", "gone.bin"));
+    TEST_ASSERT_EQ(test_free_bytes(), free_before);
+    TEST_ASSERT_NE(vfs_unlink("/gone.bin"), VFS_OK);
+
+    TEST_PASS();
+}
+
+/**
+ * Test: unlinking a name also forgets cached lookups of its other
+ * spellings, which resolve to separate nodes
+ */
+TEST_CASE(test_fat32_unlink_case_alias) {
+    TEST_ASSERT_EQ(vfs_create("/alias.txt", 0644), VFS_OK);
+    TEST_ASSERT(vfs_exists("/alias.txt"));
+    TEST_ASSERT(vfs_exists("/ALIAS.TXT"));
+
+    TEST_ASSERT_EQ(vfs_unlink("/alias.txt"), VFS_OK);
+    TEST_ASSERT(!vfs_exists("/ALIAS.TXT"));
+    TEST_ASSERT(!vfs_exists("/Alias.Txt"));
+
+    TEST_PASS();
+}
+
+/**
+ * Test: appended data left pending on an open file is allocated by the
+ * background write-back once it has aged
+ */
+TEST_CASE(test_fat32_delalloc_writeback) {
+    fat32_host_sync(false);
+    uint64_t free_before = test_free_bytes();
+
+    test_pattern(test_wbuf, 3000, 10);
+    vfs_file_t *file = vfs_open("/pending.bin", VFS_O_WRONLY | VFS_O_CREAT | VFS_O_TRUNC);
+    TEST_ASSERT_NOT_NULL(file);
+    TEST_ASSERT_EQ(vfs_write(file, test_wbuf, 3000), 3000);
+    TEST_ASSERT_EQ(test_free_bytes(), free_before);
+
+    TEST_ASSERT_EQ(fat32_writeback(test_fs(), 0), 0);
+    TEST_ASSERT_LT(test_free_bytes(), free_before);
+    vfs_close(file);
+
+    TEST_ASSERT_EQ(test_read_file("/pending.bin", test_rbuf, TEST_BUFFER_SIZE), 3000);
+    TEST_ASSERT_MEM_EQ(test_rbuf, test_wbuf, 3000);
+
+    TEST_PASS();
+}
+
+/**
+ * Test: a file unlinked while open keeps its data until the last close,
+ * then frees all of it, pending data included, without touching a new
+ * file created under the same name
+ */
+TEST_CASE(test_fat32_unlink_while_open) {
+    TEST_ASSERT_EQ(vfs_create("/open.bin", 0644), VFS_OK);
+    fat32_host_sync(false);
+    uint64_t free_before = test_free_bytes();
+
+    test_pattern(test_wbuf, 200000, 12);
+    vfs_file_t *file = vfs_open("/open.bin", VFS_O_RDWR);
+    TEST_ASSERT_NOT_NULL(file);
+    TEST_ASSERT_EQ(vfs_write(file, test_wbuf, 150000), 150000);
+    TEST_ASSERT_EQ(vfs_unlink("/open.bin"), VFS_OK);
+    TEST_ASSERT(!vfs_exists("/open.bin"));
+
+    /* The name is free for a new file */
+    test_pattern(test_rbuf, 3000, 13);
+    TEST_ASSERT_EQ(test_write_file("/open.bin", test_rbuf, 3000, 3000), 0);
+
+    /* The unlinked file still reads and writes its own data */
+    TEST_ASSERT_EQ(vfs_write(file, test_wbuf + 150000, 50000), 50000);
+    TEST_ASSERT_EQ(vfs_seek(file, 0, VFS_SEEK_SET), 0);
+    TEST_ASSERT_EQ(vfs_read(file, test_rbuf + 3000, 200000), 200000);
+    TEST_ASSERT_MEM_EQ(test_rbuf + 3000, test_wbuf, 200000);
+    TEST_ASSERT_EQ(vfs_write(file, test_wbuf, 1000), 1000);
+    vfs_close(file);
+    fat32_host_sync(false);
+
+    test_pattern(test_wbuf, 3000, 13);
+    TEST_ASSERT_EQ(test_read_file("/open.bin", test_rbuf, TEST_BUFFER_SIZE), 3000);
+    TEST_ASSERT_MEM_EQ(test_rbuf, test_wbuf, 3000);
+
+    TEST_ASSERT_EQ(vfs_unlink("/open.bin"), VFS_OK);
+    fat32_host_sync(false);
+    TEST_ASSERT_EQ(test_free_bytes(), free_before);
+
+    TEST_PASS();
+}
+
+/**
+ * Test: space is allocated in whole clusters
+ */
+TEST_CASE(test_fat32_space_accounting) {
+    fat32_host_sync(false);
+    uint64_t free_before = test_free_bytes();
+    uint32_t cluster = test_cluster_size();
+    TEST_ASSERT_GT(cluster, 0);
+
+    size_t len = MB + 1;
+    test_pattern(test_wbuf, len, 9);
+    TEST_ASSERT_EQ(test_write_file("/space.bin", test_wbuf, len, 65536), 0);
+    fat32_host_sync(false);
+
+    uint64_t used = ((len + cluster - 1) / cluster) * cluster;
+    TEST_ASSERT_EQ(free_before - test_free_bytes(), used);
+
+    TEST_PASS();
+}
+
+/**
+ * Test: error codes for missing files and exclusive create
+ */
+TEST_CASE(test_fat32_errors) {
+    TEST_ASSERT_NULL(vfs_open("/missing.txt", VFS_O_RDONLY));
+    TEST_ASSERT_EQ(vfs_get_error(), VFS_ERR_NOENT);
+
+    TEST_ASSERT_EQ(vfs_create("/excl.txt", 0644), VFS_OK);
+    TEST_ASSERT_NULL(vfs_open("/excl.txt", VFS_O_WRONLY | VFS_O_CREAT | VFS_O_EXCL));
+    TEST_ASSERT(!vfs_exists("/missing/dir/file"));
+
+    TEST_PASS();
+}
+
+/**
+ * Test: everything survives an unmount and a cold remount, the on-disk
+ * FATs and FSInfo are consistent, and statfs does not scan the whole FAT
+ */
+TEST_CASE(test_fat32_remount) {
+    fat32_host_sync(false);
+    uint64_t free_before = test_free_bytes();
+    int root_entries = test_count_entries("/");
+
+    TEST_ASSERT_EQ(fat32_host_unmount(), VFS_OK);
+    const char *problem = test_check_image();
+    if (problem) {
+        fat32_host_mount();
+        TEST_FAIL(problem);
+    }
+    TEST_ASSERT_EQ(fat32_host_mount(), VFS_OK);
+
+    /* Answered from FSInfo, leaving the FAT scan unfinished */
+    TEST_ASSERT_EQ(test_free_bytes(), free_before);
+    TEST_ASSERT_LT(test_fs()->bitmap_scanned, test_fs()->total_clusters);
+    TEST_ASSERT_EQ(test_count_entries("/"), root_entries);
+    TEST_ASSERT_EQ(test_count_entries("/many"), 300);
+
+    test_pattern(test_wbuf, 3 * MB + 777, 2);
+    TEST_ASSERT_EQ(test_read_file("/large.bin", test_rbuf, TEST_BUFFER_SIZE), 3 * MB + 777);
+    TEST_ASSERT_MEM_EQ(test_rbuf, test_wbuf, 3 * MB + 777);
+
+    test_pattern(test_wbuf, 1000, 7);
+    TEST_ASSERT_EQ(test_read_file("/a/b/c/d/deep.txt", test_rbuf, TEST_BUFFER_SIZE), 1000);
+    TEST_ASSERT_MEM_EQ(test_rbuf, test_wbuf, 1000);
+
+    TEST_PASS();
+}
+
+/**
+ * Test: clusters freed before the bitmap scan reaches them, while their
+ * FAT sectors are still only in the FAT cache, can be allocated again
+ */
+TEST_CASE(test_fat32_scan_sees_cached_frees) {
+    TEST_ASSERT_EQ(vfs_create("/fill.bin", 0644), VFS_OK);
+    fat32_host_sync(false);
+    TEST_ASSERT_EQ(fat32_host_unmount(), VFS_OK);
+    TEST_ASSERT_EQ(fat32_host_mount(), VFS_OK);
+    TEST_ASSERT_EQ(test_fs()->bitmap_scanned, 0);
+
+    /* The unlink only reaches the FAT cache; the scan has not started */
+    TEST_ASSERT_EQ(vfs_unlink("/large.bin"), VFS_OK);
+    uint64_t free_bytes = test_free_bytes();
+
+    /* Filling the volume needs every free cluster, the unlinked ones too */
+    vfs_file_t *file = vfs_open("/fill.bin", VFS_O_WRONLY);
+    TEST_ASSERT_NOT_NULL(file);
+    test_pattern(test_wbuf, TEST_BUFFER_SIZE, 11);
+    uint64_t written = 0;
+    while (written < free_bytes) {
+        size_t n = (size_t)MIN((uint64_t)TEST_BUFFER_SIZE, free_bytes - written);
+        if (vfs_write(file, test_wbuf, n) != (ssize_t)n) {
+            break;
+        }
+        written += n;
+    }
+    vfs_close(file);
+    fat32_host_sync(false);
+
+    TEST_ASSERT_EQ(written, free_bytes);
+    TEST_ASSERT_EQ(test_free_bytes(), 0);
+    TEST_ASSERT_EQ(vfs_unlink("/fill.bin"), VFS_OK);
+
+    TEST_PASS();
+}
+
+/* ============================================================================
+ * Runner
+ * ============================================================================ */
+
+int fat32_host_run_tests(const char *path) {
+    if (!fat32_host_attach(path, TEST_IMAGE_SIZE)) {
+        return 1;
+    }
+    if (fat32_host_mkfs(0) != 0 || fat32_host_mount() != VFS_OK) {
+        host_print("test: cannot format and mount %s\n", path);
+        fat32_host_detach();
+        return 1;
+    }
+
+    size_t failed = test_run_all();
+
+    fat32_host_unmount();
+    fat32_host_detach();
+    host_unlink(path);
+    return (int)failed;
+}
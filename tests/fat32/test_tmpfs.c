@@ -0,0 +1,340 @@
+/**
+ * AAAos FAT32 Host Harness - tmpfs Tests
+ *
+ * Each test mounts a small tmpfs at TMPFS_MOUNT_POINT beside the FAT32
+ * image and unmounts it again. Space and inode accounting is read back
+ * through the mount's statfs callback, so leaks and missed charges show
+ * up as counts that do not return to their starting values.
+ */
+
+#include "fat32_host.h"
+#include "../framework/test.h"
+
+#define TEST_TMPFS_BUFFER_SIZE  (64 * KB)
+
+static uint8_t test_tmpfs_wbuf[TEST_TMPFS_BUFFER_SIZE];
+static uint8_t test_tmpfs_rbuf[TEST_TMPFS_BUFFER_SIZE];
+
+/* ============================================================================
+ * Helpers
+ * ============================================================================ */
+
+static void test_tmpfs_fill(uint8_t *buf, size_t len, uint8_t seed) {
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = (uint8_t)(seed + i * 7);
+    }
+}
+
+/**
+ * Get the tmpfs mount (vfs_get_mount falls back to the FAT32 root)
+ */
+static vfs_mount_t* test_tmpfs_get_mount(void) {
+    vfs_mount_t *mount = vfs_get_mount(TMPFS_MOUNT_POINT);
+    if (!mount || host_strcmp(mount->type, "tmpfs") != 0) {
+        return NULL;
+    }
+    return mount;
+}
+
+/**
+ * Mount a tmpfs with the given limits (0 selects the default), replacing
+ * one left behind by a failed test
+ */
+static int test_tmpfs_mount(uint64_t max_bytes, uint32_t max_inodes) {
+    tmpfs_options_t options = { .max_bytes = max_bytes, .max_inodes = max_inodes };
+
+    if (test_tmpfs_get_mount()) {
+        vfs_unmount(TMPFS_MOUNT_POINT);
+    }
+    return vfs_mount(TMPFS_MOUNT_POINT, "tmpfs", &options);
+}
+
+static tmpfs_statfs_t test_tmpfs_stats(void) {
+    tmpfs_statfs_t stats = { 0 };
+    vfs_mount_t *mount = test_tmpfs_get_mount();
+    if (mount) {
+        mount->ops->statfs(mount, &stats);
+    }
+    return stats;
+}
+
+static int test_tmpfs_write(const char *path, const uint8_t *data, size_t len) {
+    vfs_file_t *file = vfs_open(path, VFS_O_WRONLY | VFS_O_CREAT | VFS_O_TRUNC);
+    if (!file) {
+        return -1;
+    }
+
+    ssize_t n = vfs_write(file, data, len);
+    vfs_close(file);
+    return n == (ssize_t)len ? 0 : -1;
+}
+
+static ssize_t test_tmpfs_read(const char *path, uint8_t *buf, size_t max) {
+    vfs_file_t *file = vfs_open(path, VFS_O_RDONLY);
+    if (!file) {
+        return -1;
+    }
+
+    ssize_t n = vfs_read(file, buf, max);
+    vfs_close(file);
+    return n;
+}
+
+static int test_tmpfs_count_entries(const char *path) {
+    vfs_dir_t *dir = vfs_opendir(path);
+    if (!dir) {
+        return -1;
+    }
+
+    int count = 0;
+    while (vfs_readdir(dir) != NULL) {
+        count++;
+    }
+
+    vfs_closedir(dir);
+    return count;
+}
+
+/**
+ * Forget cached lookups under a directory, so the next lookup of a name
+ * builds a fresh node for the same inode
+ */
+static void test_tmpfs_drop_dentries(const char *dir_path) {
+    vfs_node_t *dir = vfs_lookup(dir_path);
+    if (dir) {
+        vfs_dcache_invalidate(dir, NULL);
+        vfs_unref_node(dir);
+    }
+}
+
+/* ============================================================================
+ * Tests
+ * ============================================================================ */
+
+/**
+ * Test: holes read as zeros and take no pages, whether made by writing
+ * past the end or by extending with truncate
+ */
+TEST_CASE(test_tmpfs_sparse) {
+    TEST_ASSERT_EQ(test_tmpfs_mount(0, 0), VFS_OK);
+
+    test_tmpfs_fill(test_tmpfs_wbuf, 100, 1);
+    vfs_file_t *file = vfs_open("/tmp/sparse", VFS_O_RDWR | VFS_O_CREAT);
+    TEST_ASSERT_NOT_NULL(file);
+    TEST_ASSERT_EQ(vfs_pwrite(file, test_tmpfs_wbuf, 100, 3 * PAGE_SIZE + 50), 100);
+    TEST_ASSERT_EQ(vfs_truncate(file, 8 * PAGE_SIZE), VFS_OK);
+
+    /* One data page and one page-table page */
+    tmpfs_statfs_t stats = test_tmpfs_stats();
+    TEST_ASSERT_EQ(stats.used_bytes, 2 * PAGE_SIZE);
+
+    vfs_stat_t st;
+    TEST_ASSERT_EQ(vfs_fstat(file, &st), VFS_OK);
+    TEST_ASSERT_EQ(st.st_size, 8 * PAGE_SIZE);
+    TEST_ASSERT_EQ(st.st_blocks, PAGE_SIZE / 512);
+
+    for (size_t i = 0; i < TEST_TMPFS_BUFFER_SIZE; i++) {
+        test_tmpfs_rbuf[i] = 0xAA;
+    }
+    TEST_ASSERT_EQ(vfs_pread(file, test_tmpfs_rbuf, TEST_TMPFS_BUFFER_SIZE, 0),
+                   8 * PAGE_SIZE);
+    for (size_t i = 0; i < 8 * PAGE_SIZE; i++) {
+        if (i >= 3 * PAGE_SIZE + 50 && i < 3 * PAGE_SIZE + 150) {
+            continue;
+        }
+        TEST_ASSERT_EQ(test_tmpfs_rbuf[i], 0);
+    }
+    TEST_ASSERT_MEM_EQ(test_tmpfs_rbuf + 3 * PAGE_SIZE + 50, test_tmpfs_wbuf, 100);
+
+    /* Shrinking into the data page and growing again leaves zeros behind */
+    TEST_ASSERT_EQ(vfs_truncate(file, 3 * PAGE_SIZE + 60), VFS_OK);
+    TEST_ASSERT_EQ(vfs_truncate(file, 4 * PAGE_SIZE), VFS_OK);
+    TEST_ASSERT_EQ(vfs_pread(file, test_tmpfs_rbuf, 100, 3 * PAGE_SIZE + 50), 100);
+    TEST_ASSERT_MEM_EQ(test_tmpfs_rbuf, test_tmpfs_wbuf, 10);
+    for (size_t i = 10; i < 100; i++) {
+        TEST_ASSERT_EQ(test_tmpfs_rbuf[i], 0);
+    }
+    vfs_close(file);
+
+    TEST_ASSERT_EQ(vfs_unlink("/tmp/sparse"), VFS_OK);
+    TEST_ASSERT_EQ(test_tmpfs_stats().used_bytes, 0);
+    TEST_ASSERT_EQ(vfs_unmount(TMPFS_MOUNT_POINT), VFS_OK);
+    TEST_PASS();
+}
+
+/**
+ * Test: the page limit covers page tables as well as data, and a write
+ * stops short at the limit
+ */
+TEST_CASE(test_tmpfs_nospc_pages) {
+    TEST_ASSERT_EQ(test_tmpfs_mount(8 * PAGE_SIZE, 0), VFS_OK);
+    TEST_ASSERT_EQ(test_tmpfs_stats().total_bytes, 8 * PAGE_SIZE);
+
+    /* A far sparse write needs a 16-page table: refused before any data */
+    vfs_file_t *file = vfs_open("/tmp/far", VFS_O_RDWR | VFS_O_CREAT);
+    TEST_ASSERT_NOT_NULL(file);
+    test_tmpfs_fill(test_tmpfs_wbuf, TEST_TMPFS_BUFFER_SIZE, 2);
+    TEST_ASSERT_EQ(vfs_pwrite(file, test_tmpfs_wbuf, 1, 4096ULL * PAGE_SIZE), VFS_ERR_NOSPC);
+    TEST_ASSERT_EQ(test_tmpfs_stats().used_bytes, 0);
+
+    /* A 4-page table and one data page fit */
+    TEST_ASSERT_EQ(vfs_pwrite(file, test_tmpfs_wbuf, 1, 1024ULL * PAGE_SIZE), 1);
+    TEST_ASSERT_EQ(test_tmpfs_stats().used_bytes, 5 * PAGE_SIZE);
+    vfs_close(file);
+    TEST_ASSERT_EQ(vfs_unlink("/tmp/far"), VFS_OK);
+    TEST_ASSERT_EQ(test_tmpfs_stats().used_bytes, 0);
+
+    /* Eight pages of data do not fit next to their page table */
+    file = vfs_open("/tmp/big", VFS_O_WRONLY | VFS_O_CREAT);
+    TEST_ASSERT_NOT_NULL(file);
+    TEST_ASSERT_EQ(vfs_write(file, test_tmpfs_wbuf, 8 * PAGE_SIZE), 7 * PAGE_SIZE);
+    TEST_ASSERT_EQ(vfs_write(file, test_tmpfs_wbuf, 1), VFS_ERR_NOSPC);
+    vfs_close(file);
+
+    tmpfs_statfs_t stats = test_tmpfs_stats();
+    TEST_ASSERT_EQ(stats.used_bytes, 8 * PAGE_SIZE);
+    TEST_ASSERT_EQ(stats.free_bytes, 0);
+
+    /* A new file cannot get its page table either */
+    TEST_ASSERT_EQ(test_tmpfs_write("/tmp/more", test_tmpfs_wbuf, 1), -1);
+
+    /* The data written before the limit is intact */
+    TEST_ASSERT_EQ(test_tmpfs_read("/tmp/big", test_tmpfs_rbuf, TEST_TMPFS_BUFFER_SIZE),
+                   7 * PAGE_SIZE);
+    TEST_ASSERT_MEM_EQ(test_tmpfs_rbuf, test_tmpfs_wbuf, 7 * PAGE_SIZE);
+
+    /* Freeing space makes room again */
+    TEST_ASSERT_EQ(vfs_unlink("/tmp/big"), VFS_OK);
+    TEST_ASSERT_EQ(test_tmpfs_write("/tmp/more", test_tmpfs_wbuf, 1), 0);
+    TEST_ASSERT_EQ(vfs_unlink("/tmp/more"), VFS_OK);
+    TEST_ASSERT_EQ(test_tmpfs_stats().used_bytes, 0);
+
+    TEST_ASSERT_EQ(vfs_unmount(TMPFS_MOUNT_POINT), VFS_OK);
+    TEST_PASS();
+}
+
+/**
+ * Test: creating past the inode limit fails with NOSPC; the root
+ * directory counts as one inode
+ */
+TEST_CASE(test_tmpfs_nospc_inodes) {
+    TEST_ASSERT_EQ(test_tmpfs_mount(0, 4), VFS_OK);
+    TEST_ASSERT_EQ(test_tmpfs_stats().used_inodes, 1);
+
+    TEST_ASSERT_EQ(vfs_create("/tmp/a", 0644), VFS_OK);
+    TEST_ASSERT_EQ(vfs_mkdir("/tmp/d", 0755), VFS_OK);
+    TEST_ASSERT_EQ(vfs_create("/tmp/d/b", 0644), VFS_OK);
+    TEST_ASSERT_EQ(vfs_create("/tmp/c", 0644), VFS_ERR_NOSPC);
+    TEST_ASSERT_EQ(vfs_mkdir("/tmp/e", 0755), VFS_ERR_NOSPC);
+    TEST_ASSERT_NULL(vfs_open("/tmp/c", VFS_O_WRONLY | VFS_O_CREAT));
+
+    tmpfs_statfs_t stats = test_tmpfs_stats();
+    TEST_ASSERT_EQ(stats.total_inodes, 4);
+    TEST_ASSERT_EQ(stats.used_inodes, 4);
+
+    TEST_ASSERT_EQ(vfs_unlink("/tmp/a"), VFS_OK);
+    TEST_ASSERT_EQ(vfs_create("/tmp/c", 0644), VFS_OK);
+    TEST_ASSERT_EQ(test_tmpfs_stats().used_inodes, 4);
+
+    TEST_ASSERT_EQ(vfs_unmount(TMPFS_MOUNT_POINT), VFS_OK);
+    TEST_PASS();
+}
+
+/**
+ * Test: rename over an existing file replaces it and frees the old
+ * target; directories are only replaced by empty directories
+ */
+TEST_CASE(test_tmpfs_rename_replace) {
+    TEST_ASSERT_EQ(test_tmpfs_mount(0, 0), VFS_OK);
+
+    test_tmpfs_fill(test_tmpfs_wbuf, 3 * PAGE_SIZE, 3);
+    TEST_ASSERT_EQ(test_tmpfs_write("/tmp/src", test_tmpfs_wbuf, 3 * PAGE_SIZE), 0);
+    test_tmpfs_fill(test_tmpfs_wbuf + 3 * PAGE_SIZE, 5 * PAGE_SIZE, 4);
+    TEST_ASSERT_EQ(test_tmpfs_write("/tmp/dst", test_tmpfs_wbuf + 3 * PAGE_SIZE,
+                                    5 * PAGE_SIZE), 0);
+
+    tmpfs_statfs_t stats = test_tmpfs_stats();
+    TEST_ASSERT_EQ(stats.used_inodes, 3);
+    TEST_ASSERT_EQ(stats.used_bytes, (3 + 1 + 5 + 1) * PAGE_SIZE);
+
+    /* Cache the old target so a stale lookup would show up */
+    vfs_stat_t st;
+    TEST_ASSERT_EQ(vfs_stat("/tmp/dst", &st), VFS_OK);
+    TEST_ASSERT_EQ(st.st_size, 5 * PAGE_SIZE);
+
+    TEST_ASSERT_EQ(vfs_rename("/tmp/src", "/tmp/dst"), VFS_OK);
+    TEST_ASSERT_EQ(vfs_stat("/tmp/src", &st), VFS_ERR_NOENT);
+    TEST_ASSERT_EQ(vfs_stat("/tmp/dst", &st), VFS_OK);
+    TEST_ASSERT_EQ(st.st_size, 3 * PAGE_SIZE);
+    TEST_ASSERT_EQ(test_tmpfs_read("/tmp/dst", test_tmpfs_rbuf, TEST_TMPFS_BUFFER_SIZE),
+                   3 * PAGE_SIZE);
+    TEST_ASSERT_MEM_EQ(test_tmpfs_rbuf, test_tmpfs_wbuf, 3 * PAGE_SIZE);
+
+    stats = test_tmpfs_stats();
+    TEST_ASSERT_EQ(stats.used_inodes, 2);
+    TEST_ASSERT_EQ(stats.used_bytes, (3 + 1) * PAGE_SIZE);
+
+    /* Directory targets */
+    TEST_ASSERT_EQ(vfs_mkdir("/tmp/full", 0755), VFS_OK);
+    TEST_ASSERT_EQ(vfs_create("/tmp/full/x", 0644), VFS_OK);
+    TEST_ASSERT_EQ(vfs_mkdir("/tmp/empty", 0755), VFS_OK);
+    TEST_ASSERT_EQ(vfs_rename("/tmp/dst", "/tmp/empty"), VFS_ERR_ISDIR);
+    TEST_ASSERT_EQ(vfs_rename("/tmp/empty", "/tmp/dst"), VFS_ERR_NOTDIR);
+    TEST_ASSERT_EQ(vfs_rename("/tmp/empty", "/tmp/full"), VFS_ERR_NOTEMPTY);
+    TEST_ASSERT_EQ(vfs_rename("/tmp/full", "/tmp/empty"), VFS_OK);
+    TEST_ASSERT_EQ(vfs_stat("/tmp/empty/x", &st), VFS_OK);
+    TEST_ASSERT_EQ(vfs_stat("/tmp/full", &st), VFS_ERR_NOENT);
+    TEST_ASSERT_EQ(test_tmpfs_stats().used_inodes, 4);
+
+    TEST_ASSERT_EQ(vfs_unmount(TMPFS_MOUNT_POINT), VFS_OK);
+    TEST_PASS();
+}
+
+/**
+ * Test: an unlinked file stays readable through open handles and is freed
+ * only once no handle or node refers to it
+ */
+TEST_CASE(test_tmpfs_unlink_while_open) {
+    TEST_ASSERT_EQ(test_tmpfs_mount(0, 0), VFS_OK);
+
+    test_tmpfs_fill(test_tmpfs_wbuf, 2 * PAGE_SIZE, 5);
+    TEST_ASSERT_EQ(test_tmpfs_write("/tmp/victim", test_tmpfs_wbuf, 2 * PAGE_SIZE), 0);
+
+    vfs_file_t *file = vfs_open("/tmp/victim", VFS_O_RDWR);
+    TEST_ASSERT_NOT_NULL(file);
+
+    /* A second node for the same inode, referenced but never opened */
+    test_tmpfs_drop_dentries("/tmp");
+    vfs_node_t *alias = vfs_lookup("/tmp/victim");
+    TEST_ASSERT_NOT_NULL(alias);
+    TEST_ASSERT_NE(alias, file->node);
+
+    TEST_ASSERT_EQ(vfs_unlink("/tmp/victim"), VFS_OK);
+    vfs_stat_t st;
+    TEST_ASSERT_EQ(vfs_stat("/tmp/victim", &st), VFS_ERR_NOENT);
+    TEST_ASSERT_EQ(test_tmpfs_count_entries("/tmp"), 0);
+
+    /* Still readable and writable through the handle */
+    TEST_ASSERT_EQ(vfs_pread(file, test_tmpfs_rbuf, TEST_TMPFS_BUFFER_SIZE, 0),
+                   2 * PAGE_SIZE);
+    TEST_ASSERT_MEM_EQ(test_tmpfs_rbuf, test_tmpfs_wbuf, 2 * PAGE_SIZE);
+    TEST_ASSERT_EQ(vfs_pwrite(file, test_tmpfs_wbuf, 10, 2 * PAGE_SIZE), 10);
+    TEST_ASSERT_EQ(test_tmpfs_stats().used_inodes, 2);
+
+    /* The last close leaves the inode to the remaining node */
+    vfs_close(file);
+    TEST_ASSERT_EQ(test_tmpfs_stats().used_inodes, 2);
+    TEST_ASSERT_EQ(alias->mount->ops->stat(alias, &st), VFS_OK);
+    TEST_ASSERT_EQ(st.st_size, 2 * PAGE_SIZE + 10);
+    TEST_ASSERT_EQ(st.st_nlink, 0);
+
+    vfs_unref_node(alias);
+    tmpfs_statfs_t stats = test_tmpfs_stats();
+    TEST_ASSERT_EQ(stats.used_inodes, 1);
+    TEST_ASSERT_EQ(stats.used_bytes, 0);
+
+    /* The name is free for a new file */
+    TEST_ASSERT_EQ(test_tmpfs_write("/tmp/victim", test_tmpfs_wbuf, 1), 0);
+    TEST_ASSERT_EQ(vfs_unmount(TMPFS_MOUNT_POINT), VFS_OK);
+    TEST_PASS();
+}
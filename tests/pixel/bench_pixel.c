@@ -0,0 +1,302 @@
+/**
+ * AAAos Pixel Kernels - Host Check and Benchmark
+ *
+ * Runs the span kernels from drivers/video/pixel.h, built with the
+ * kernel's code generation flags (no SSE), against the per-pixel loops
+ * the framebuffer driver and compositor used before them.
+ *
+ *   check                  compare every kernel with its reference
+ *   bench [-w W] [-h H]    megapixels per second for a W x H frame
+ *
+ * Timings are host wall-clock time and only comparable between runs on
+ * the same machine.
+ */
+
+#include "../../kernel/include/types.h"
+#include "../../drivers/video/pixel.h"
+#include "../fat32/host_io.h"
+
+#define BENCH_MIN_NS        200000000ULL    /* Run each kernel at least 0.2 s */
+#define CHECK_SPAN_MAX      67
+
+static uint64_t bench_rng = 0x9E3779B97F4A7C15ULL;
+
+static uint32_t bench_random(void) {
+    bench_rng ^= bench_rng << 13;
+    bench_rng ^= bench_rng >> 7;
+    bench_rng ^= bench_rng << 17;
+    return (uint32_t)(bench_rng >> 16);
+}
+
+/* ============================================================================
+ * Reference Implementations
+ * ============================================================================ */
+
+/*
+ * The loops pixel.h replaced. noinline keeps the compiler from folding
+ * them into the timing loop.
+ */
+static __attribute__((noinline)) void ref_copy_span(uint32_t *dst, const uint32_t *src,
+                                                    size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = src[i];
+    }
+}
+
+static __attribute__((noinline)) void ref_fill_span(uint32_t *dst, uint32_t color,
+                                                    size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = color;
+    }
+}
+
+static uint32_t ref_blend(uint32_t fg, uint32_t bg) {
+    uint32_t a = fg >> 24;
+    uint32_t inv_a = 255 - a;
+    uint32_t r = (((fg >> 16) & 0xFF) * a + ((bg >> 16) & 0xFF) * inv_a) / 255;
+    uint32_t g = (((fg >> 8) & 0xFF) * a + ((bg >> 8) & 0xFF) * inv_a) / 255;
+    uint32_t b = ((fg & 0xFF) * a + (bg & 0xFF) * inv_a) / 255;
+    return 0xFF000000 | (r << 16) | (g << 8) | b;
+}
+
+static __attribute__((noinline)) void ref_blend_span(uint32_t *dst, const uint32_t *src,
+                                                     size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        uint32_t alpha = src[i] >> 24;
+        if (alpha == 255) {
+            dst[i] = src[i];
+        } else if (alpha != 0) {
+            dst[i] = ref_blend(src[i], dst[i]);
+        }
+    }
+}
+
+/* The kernels themselves, out of line like the references */
+static __attribute__((noinline)) void new_copy_span(uint32_t *dst, const uint32_t *src,
+                                                    size_t count) {
+    pixel_copy_span(dst, src, count);
+}
+
+static __attribute__((noinline)) void new_fill_span(uint32_t *dst, uint32_t color,
+                                                    size_t count) {
+    pixel_fill_span(dst, color, count);
+}
+
+static __attribute__((noinline)) void new_blend_span(uint32_t *dst, const uint32_t *src,
+                                                     size_t count) {
+    pixel_blend_span(dst, src, count);
+}
+
+/* ============================================================================
+ * Check
+ * ============================================================================ */
+
+/**
+ * Exact rounded blend of one channel
+ */
+static uint32_t check_blend_channel(uint32_t f, uint32_t b, uint32_t a) {
+    return (f * a + b * (255 - a) + 127) / 255;
+}
+
+static int check_blend(void) {
+    /* Every alpha and every channel pair, one channel per lane position */
+    for (uint32_t a = 0; a < 256; a++) {
+        for (uint32_t f = 0; f < 256; f++) {
+            for (uint32_t b = 0; b < 256; b++) {
+                uint32_t fg = (a << 24) | (f << 16) | (b << 8) | f;
+                uint32_t bg = 0xFF000000 | (b << 16) | (f << 8) | b;
+                uint32_t out = pixel_blend(fg, bg);
+                uint32_t want = 0xFF000000 |
+                                (check_blend_channel(f, b, a) << 16) |
+                                (check_blend_channel(b, f, a) << 8) |
+                                check_blend_channel(f, b, a);
+                if (out != want) {
+                    host_print("blend: a=%u f=%u b=%u: got %08x, want %08x\n",
+                               a, f, b, out, want);
+                    return -1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+static int check_spans(void) {
+    uint32_t src[CHECK_SPAN_MAX + 2];
+    uint32_t got[CHECK_SPAN_MAX + 2];
+    uint32_t want[CHECK_SPAN_MAX + 2];
+
+    /* Every length, with guard pixels on both sides */
+    for (size_t len = 0; len <= CHECK_SPAN_MAX; len++) {
+        for (size_t i = 0; i < len + 2; i++) {
+            src[i] = bench_random();
+            got[i] = want[i] = bench_random();
+        }
+
+        new_copy_span(got + 1, src + 1, len);
+        ref_copy_span(want + 1, src + 1, len);
+        for (size_t i = 0; i < len + 2; i++) {
+            if (got[i] != want[i]) {
+                host_print("copy: length %lu differs at %lu\n",
+                           (unsigned long)len, (unsigned long)i);
+                return -1;
+            }
+        }
+
+        uint32_t color = bench_random();
+        new_fill_span(got + 1, color, len);
+        ref_fill_span(want + 1, color, len);
+        for (size_t i = 0; i < len + 2; i++) {
+            if (got[i] != want[i]) {
+                host_print("fill: length %lu differs at %lu\n",
+                           (unsigned long)len, (unsigned long)i);
+                return -1;
+            }
+        }
+
+        /* Opaque and transparent pixels must match exactly */
+        for (size_t i = 0; i < len + 2; i++) {
+            src[i] = (bench_random() & 1) ? (src[i] | 0xFF000000) : (src[i] & 0x00FFFFFF);
+        }
+        new_blend_span(got + 1, src + 1, len);
+        ref_blend_span(want + 1, src + 1, len);
+        for (size_t i = 0; i < len + 2; i++) {
+            if (got[i] != want[i]) {
+                host_print("blend span: length %lu differs at %lu\n",
+                           (unsigned long)len, (unsigned long)i);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * Benchmark
+ * ============================================================================ */
+
+typedef enum {
+    KERNEL_COPY,
+    KERNEL_BLEND,
+    KERNEL_FILL,
+} bench_kernel_t;
+
+/**
+ * Run one kernel over whole frames, row by row, for at least BENCH_MIN_NS
+ * @return Megapixels per second
+ */
+static uint64_t bench_run(bench_kernel_t kernel, bool reference, uint32_t *dst,
+                          const uint32_t *src, uint32_t width, uint32_t height) {
+    uint64_t pixels = 0;
+    uint64_t start = host_now_ns();
+    uint64_t ns;
+
+    do {
+        for (uint32_t row = 0; row < height; row++) {
+            uint32_t *d = dst + (size_t)row * width;
+            const uint32_t *s = src + (size_t)row * width;
+
+            switch (kernel) {
+                case KERNEL_COPY:
+                    reference ? ref_copy_span(d, s, width) : new_copy_span(d, s, width);
+                    break;
+                case KERNEL_BLEND:
+                    reference ? ref_blend_span(d, s, width) : new_blend_span(d, s, width);
+                    break;
+                case KERNEL_FILL:
+                    reference ? ref_fill_span(d, 0xFF2B5278, width)
+                              : new_fill_span(d, 0xFF2B5278, width);
+                    break;
+            }
+        }
+        pixels += (uint64_t)width * height;
+        ns = host_now_ns() - start;
+    } while (ns < BENCH_MIN_NS);
+
+    return pixels * 1000 / ns;
+}
+
+static int bench(uint32_t width, uint32_t height) {
+    size_t count = (size_t)width * height;
+    uint32_t *src = host_alloc(count * sizeof(uint32_t));
+    uint32_t *dst = host_alloc(count * sizeof(uint32_t));
+    if (!src || !dst) {
+        host_print("bench: out of memory\n");
+        return 1;
+    }
+
+    /* Window content with alpha spread evenly over 0..255 */
+    for (size_t i = 0; i < count; i++) {
+        src[i] = bench_random();
+        dst[i] = bench_random() | 0xFF000000;
+    }
+
+    static const struct {
+        const char      *name;
+        bench_kernel_t  kernel;
+    } kernels[] = {
+        { "opaque-copy", KERNEL_COPY },
+        { "alpha-blend", KERNEL_BLEND },
+        { "fill",        KERNEL_FILL },
+    };
+
+    host_print("Pixel kernels: %u x %u frame, megapixels/s\n", width, height);
+    host_print("%-14s %10s %10s %8s\n", "kernel", "per-pixel", "pixel.h", "speedup");
+    for (size_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++) {
+        uint64_t before = bench_run(kernels[i].kernel, true, dst, src, width, height);
+        uint64_t after = bench_run(kernels[i].kernel, false, dst, src, width, height);
+        uint64_t speedup = before ? after * 100 / before : 0;
+        host_print("%-14s %10llu %10llu %5llu.%02llux\n", kernels[i].name,
+                   before, after, speedup / 100, speedup % 100);
+    }
+
+    host_free(src);
+    host_free(dst);
+    return 0;
+}
+
+static void usage(void) {
+    host_print("usage: bench_pixel <command>\n"
+               "  check                  compare the kernels with the reference loops\n"
+               "  bench [-w W] [-h H]    megapixels/s for a W x H frame (default 1920 x 1080)\n");
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        usage();
+        return 2;
+    }
+
+    if (host_strcmp(argv[1], "check") == 0) {
+        if (check_spans() != 0 || check_blend() != 0) {
+            return 1;
+        }
+        host_print("pixel kernels: all checks passed\n");
+        return 0;
+    }
+
+    if (host_strcmp(argv[1], "bench") == 0) {
+        unsigned long long width = 1920;
+        unsigned long long height = 1080;
+
+        for (int i = 2; i < argc; i += 2) {
+            unsigned long long v;
+            if (i + 1 >= argc || host_parse_size(argv[i + 1], &v) != 0 || v == 0) {
+                host_print("bench: bad value for %s\n", argv[i]);
+                return 2;
+            }
+            if (host_strcmp(argv[i], "-w") == 0) {
+                width = v;
+            } else if (host_strcmp(argv[i], "-h") == 0) {
+                height = v;
+            } else {
+                host_print("bench: unknown option %s\n", argv[i]);
+                return 2;
+            }
+        }
+        return bench((uint32_t)width, (uint32_t)height);
+    }
+
+    usage();
+    return 2;
+}